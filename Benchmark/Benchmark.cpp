@@ -0,0 +1,219 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+// Headless benchmark: renders every patch of a corpus offline, without an editor, and prints the results as JSON
+//
+// Benchmark --corpus <folder or patch> [--seconds 10] [--samplerate 48000] [--blocksizes 64,512]
+//           [--channels 2] [--oversampling 0,1] [--output results.json]
+//
+// Oversampling is given as a power of two, like in the statusbar. Allocations are the calls to operator new
+// made while a block was processed, pd's own allocations go through malloc and aren't counted.
+
+// Workaround for naming issue on windows
+#include <juce_graphics/juce_graphics.h>
+#define Rectangle juce::Rectangle
+
+#include <PluginProcessor.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <numeric>
+
+static std::atomic<bool> countAllocations = false;
+static std::atomic<int64> numAllocations = 0;
+
+// The real-time checker replaces operator new itself, allocations aren't counted then
+#if !PLUGDATA_REALTIME_CHECK
+static void* allocate(std::size_t size)
+{
+    if (countAllocations.load(std::memory_order_relaxed))
+        numAllocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (auto* ptr = std::malloc(size ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+#endif
+
+struct BenchmarkSettings {
+    double seconds = 10.0;
+    double sampleRate = 48000.0;
+    Array<int> blockSizes = { 64, 512 };
+    Array<int> channels = { 2 };
+    Array<int> oversampling = { 0 };
+};
+
+static Array<int> parseList(String const& list)
+{
+    Array<int> result;
+    for (auto const& item : StringArray::fromTokens(list, ",", ""))
+        result.add(item.getIntValue());
+
+    return result;
+}
+
+// Enables as many stereo buses as needed for the number of channels, the last one is mono if it's odd
+static bool setChannels(PlugDataAudioProcessor& processor, int numChannels)
+{
+    auto layout = processor.getBusesLayout();
+    for (auto* buses : { &layout.inputBuses, &layout.outputBuses }) {
+        for (int i = 0; i < buses->size(); i++) {
+            auto const remaining = numChannels - i * 2;
+            buses->getReference(i) = remaining >= 2 ? AudioChannelSet::stereo() : remaining == 1 ? AudioChannelSet::mono()
+                                                                                                  : AudioChannelSet::disabled();
+        }
+    }
+
+    return processor.setBusesLayout(layout);
+}
+
+static var renderPatch(File const& patchFile, BenchmarkSettings const& settings, int blockSize, int numChannels, int oversampling)
+{
+    auto result = new DynamicObject();
+    result->setProperty("patch", patchFile.getFileName());
+    result->setProperty("blocksize", blockSize);
+    result->setProperty("channels", numChannels);
+    result->setProperty("oversampling", 1 << oversampling);
+
+    auto processor = std::make_unique<PlugDataAudioProcessor>();
+    auto const previousOversampling = processor->oversampling;
+
+    if (!setChannels(*processor, numChannels)) {
+        result->setProperty("error", "unsupported channel count");
+        return var(result);
+    }
+
+    processor->setNonRealtime(true);
+    processor->setOversampling(oversampling);
+    processor->setRateAndBufferSizeDetails(settings.sampleRate, blockSize);
+    processor->prepareToPlay(settings.sampleRate, blockSize);
+
+    if (!processor->loadPatch(patchFile)) {
+        result->setProperty("error", "couldn't open patch");
+        processor->setOversampling(previousOversampling);
+        return var(result);
+    }
+
+    processor->startDSP();
+
+    auto const numBlocks = jmax(1, roundToInt(settings.seconds * settings.sampleRate / blockSize));
+    auto const numWarmupBlocks = jmax(1, roundToInt(0.5 * settings.sampleRate / blockSize));
+    auto const budget = blockSize / settings.sampleRate;
+
+    AudioBuffer<float> buffer(jmax(processor->getTotalNumInputChannels(), processor->getTotalNumOutputChannels()), blockSize);
+    MidiBuffer midi;
+
+    std::vector<double> blockTimes;
+    blockTimes.reserve(static_cast<size_t>(numBlocks));
+
+    for (int i = 0; i < numWarmupBlocks; i++) {
+        buffer.clear();
+        midi.clear();
+        processor->processBlock(buffer, midi);
+    }
+
+    numAllocations = 0;
+    int64 maxBlockAllocations = 0;
+
+    for (int i = 0; i < numBlocks; i++) {
+        buffer.clear();
+        midi.clear();
+
+        auto const allocationsBefore = numAllocations.load();
+        countAllocations = true;
+        auto const start = Time::getHighResolutionTicks();
+
+        processor->processBlock(buffer, midi);
+
+        auto const end = Time::getHighResolutionTicks();
+        countAllocations = false;
+
+        blockTimes.push_back(Time::highResolutionTicksToSeconds(end - start));
+        maxBlockAllocations = jmax(maxBlockAllocations, numAllocations.load() - allocationsBefore);
+    }
+
+    processor->releaseResources();
+    processor->setOversampling(previousOversampling);
+
+    auto const total = std::accumulate(blockTimes.begin(), blockTimes.end(), 0.0);
+    auto const numOverBudget = std::count_if(blockTimes.begin(), blockTimes.end(), [budget](double time) { return time > budget; });
+
+    std::sort(blockTimes.begin(), blockTimes.end());
+    auto percentile = [&blockTimes](double p) {
+        return blockTimes[jmin(blockTimes.size() - 1, static_cast<size_t>(p * static_cast<double>(blockTimes.size())))];
+    };
+
+    result->setProperty("seconds", numBlocks * blockSize / settings.sampleRate);
+    result->setProperty("ns_per_sample", total * 1e9 / (static_cast<double>(numBlocks) * blockSize));
+    result->setProperty("realtime_factor", numBlocks * budget / total);
+    result->setProperty("block_ns_p50", percentile(0.5) * 1e9);
+    result->setProperty("block_ns_p99", percentile(0.99) * 1e9);
+    result->setProperty("block_ns_max", blockTimes.back() * 1e9);
+    result->setProperty("blocks_over_budget", static_cast<int64>(numOverBudget));
+    result->setProperty("allocations", numAllocations.load());
+    result->setProperty("max_block_allocations", maxBlockAllocations);
+
+    return var(result);
+}
+
+int main(int argc, char* argv[])
+{
+    ScopedJuceInitialiser_GUI gui;
+    ArgumentList arguments(argc, argv);
+
+    if (!arguments.containsOption("--corpus")) {
+        std::cerr << "usage: Benchmark --corpus <folder or patch> [--seconds 10] [--samplerate 48000] [--blocksizes 64,512] [--channels 2] [--oversampling 0] [--output results.json]" << std::endl;
+        return 1;
+    }
+
+    BenchmarkSettings settings;
+    if (arguments.containsOption("--seconds"))
+        settings.seconds = arguments.getValueForOption("--seconds").getDoubleValue();
+    if (arguments.containsOption("--samplerate"))
+        settings.sampleRate = arguments.getValueForOption("--samplerate").getDoubleValue();
+    if (arguments.containsOption("--blocksizes"))
+        settings.blockSizes = parseList(arguments.getValueForOption("--blocksizes"));
+    if (arguments.containsOption("--channels"))
+        settings.channels = parseList(arguments.getValueForOption("--channels"));
+    if (arguments.containsOption("--oversampling"))
+        settings.oversampling = parseList(arguments.getValueForOption("--oversampling"));
+
+    auto const corpus = arguments.getExistingFileForOption("--corpus");
+    auto patches = corpus.isDirectory() ? corpus.findChildFiles(File::findFiles, true, "*.pd") : Array<File> { corpus };
+    patches.sort();
+
+    Array<var> results;
+    for (auto const& patch : patches) {
+        for (auto const blockSize : settings.blockSizes) {
+            for (auto const numChannels : settings.channels) {
+                for (auto const oversampling : settings.oversampling) {
+                    results.add(renderPatch(patch, settings, blockSize, numChannels, jlimit(0, 3, oversampling)));
+                }
+            }
+        }
+    }
+
+    auto const json = JSON::toString(var(results));
+    if (arguments.containsOption("--output")) {
+        if (!arguments.getFileForOption("--output").replaceWithText(json))
+            return 1;
+    } else {
+        std::cout << json << std::endl;
+    }
+
+    return 0;
+}
@@ -24,11 +24,22 @@ typedef struct _adsr{
     int      x_gate_status;
     int      x_retrigger;
     int      x_log;
+    t_float  x_log_n;
+    double   x_log_coef;
 }t_adsr;
 
 
 static t_class *adsr_class;
 
+// coefficient of a log segment of n samples, kept since n rarely changes from one sample to the next
+static double adsr_log_coef(t_adsr *x, t_float n){
+    if(n != x->x_log_n){
+        x->x_log_n = n;
+        x->x_log_coef = exp(LOG001 / n);
+    }
+    return(x->x_log_coef);
+}
+
 static void adsr_log(t_adsr *x, t_floatarg f){
     x->x_log = (int)(f != 0);
 }
@@ -120,12 +131,12 @@ static t_int *adsr_perform(t_int *w){
                 }
                 else{
                     if(nleft <= n_decay){ // decay
-                        double a = exp(LOG001 / n_decay);
+                        double a = adsr_log_coef(x, n_decay);
                         *out++ = last = (target * sustain_point) +
                             a*(last - (target * sustain_point));
                     }
                     else{
-                        double a = exp(LOG001 / n_attack);
+                        double a = adsr_log_coef(x, n_attack);
                         *out++ = last = target + a*(last - target);
                     }
                 }
@@ -148,7 +159,7 @@ static t_int *adsr_perform(t_int *w){
                 }
             }
             else{
-                double a = exp(LOG001 / n_release);
+                double a = adsr_log_coef(x, n_release);
                 *out++ = last = target + a*(last - target);
             }
         }
@@ -180,6 +191,7 @@ static void *adsr_new(t_symbol *sym, int ac, t_atom *av){
     x->x_gate_status = 0;
     x->x_last_gate = 1;
     x->x_log = 0;
+    x->x_log_n = 0;
     
     float a = 0, d = 0, s = 0, r = 0;
     int symarg = 0;
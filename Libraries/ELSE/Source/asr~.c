@@ -18,6 +18,8 @@ typedef struct _asr{
     t_outlet *x_out2;
     double   x_incr;
     int      x_log;
+    t_float  x_log_n;
+    double   x_log_coef;
     int      x_nleft;
     int      x_gate_status;
 } t_asr;
@@ -30,6 +32,15 @@ static void asr_float(t_asr *x, t_floatarg f){
     x->x_f_gate = f;
 }
 
+// coefficient of a log segment of n samples, kept since n rarely changes from one sample to the next
+static double asr_log_coef(t_asr *x, t_float n){
+    if(n != x->x_log_n){
+        x->x_log_n = n;
+        x->x_log_coef = exp(LOG001 / n);
+    }
+    return(x->x_log_coef);
+}
+
 static void asr_log(t_asr *x, t_floatarg f){
     x->x_log = (int)(f != 0);
 }
@@ -87,7 +98,7 @@ static t_int *asr_perform(t_int *w){
                     *out++ = last = target;
             }
             else{
-                double a = exp(LOG001 / n_attack);
+                double a = asr_log_coef(x, n_attack);
                 *out++ = last = target + a*(last - target);
             }
         }
@@ -105,7 +116,7 @@ static t_int *asr_perform(t_int *w){
                 }
             }
             else{
-                double a = exp(LOG001 / n_release);
+                double a = asr_log_coef(x, n_release);
                 *out++ = last = target + a*(last - target);
             }
         }
@@ -135,6 +146,7 @@ static void *asr_new(t_symbol *s, int ac, t_atom *av){
     x->x_nleft = 0;
     x->x_gate_status = 0;
     x->x_log = 0;
+    x->x_log_n = 0;
     float a = 0, r = 0;
     int symarg = 0;
     int argnum = 0;
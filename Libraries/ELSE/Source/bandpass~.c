@@ -1,6 +1,8 @@
 // Porres 2017
 
 #include "m_pd.h"
+#include "biquad.h"
+#include "magic.h"
 #include <math.h>
 
 #define PI 3.14159265358979323846
@@ -12,8 +14,12 @@ typedef struct _bandpass {
     t_inlet    *x_inlet_freq;
     t_inlet    *x_inlet_q;
     t_outlet   *x_out;
+    t_glist    *x_glist;
+    t_float    *x_freq_scalar; // NULL when a signal is connected
+    t_float    *x_q_scalar; // NULL when a signal is connected
     t_float     x_nyq;
     int         x_bypass;
+    int         x_rate; // samples between coefficient updates, they glide in between
     int         x_bw;
     double      x_xnm1;
     double      x_xnm2;
@@ -65,6 +71,28 @@ static t_int *bandpass_perform(t_int *w){
     double ynm1 = x->x_ynm1;
     double ynm2 = x->x_ynm2;
     t_float nyq = x->x_nyq;
+    if(x->x_rate > 1 && !x->x_bypass){ // coefficients are worked out every x_rate samples
+        t_biquad b = {xnm1, xnm2, ynm1, ynm2};
+        for(int i = 0; i < nblock; i += x->x_rate){
+            int n = nblock - i < x->x_rate ? nblock - i : x->x_rate;
+            double f = in2[i+n-1], reson = in3[i+n-1];
+            if(f < 0.000001)
+                f = 0.000001;
+            if(f > nyq - 0.000001)
+                f = nyq - 0.000001;
+            double from[biquad_NCOEFS] = {x->x_b1, x->x_b2, x->x_a0, 0, x->x_a2};
+            if(f != x->x_f || reson != x->x_reson){
+                update_coeffs(x, f, reson);
+                double to[biquad_NCOEFS] = {x->x_b1, x->x_b2, x->x_a0, 0, x->x_a2};
+                biquad_ramp(&b, from, to, in1 + i, out + i, n);
+            }
+            else
+                biquad_run(&b, from, in1 + i, out + i, n);
+        }
+        x->x_xnm1 = b.b_xnm1, x->x_xnm2 = b.b_xnm2;
+        x->x_ynm1 = b.b_ynm1, x->x_ynm2 = b.b_ynm2;
+        return(w+7);
+    }
     while(nblock--){
         double xn = *in1++, f = *in2++, reson = *in3++, yn;
         if(f < 0.000001)
@@ -91,13 +119,48 @@ static t_int *bandpass_perform(t_int *w){
     return(w+7);
 }
 
+// the parameters have no signal connected, so they're read once per block
+static t_int *bandpass_perform_scalar(t_int *w){
+    t_bandpass *x = (t_bandpass *)(w[1]);
+    int nblock = (int)(w[2]);
+    t_float *in = (t_float *)(w[3]);
+    t_float *out = (t_float *)(w[4]);
+    if(x->x_bypass){
+        if(in != out)
+            for(int i = 0; i < nblock; i++)
+                out[i] = in[i];
+        return(w+5);
+    }
+    t_float nyq = x->x_nyq;
+    double f = *x->x_freq_scalar, reson = *x->x_q_scalar;
+    if(f < 0.000001)
+        f = 0.000001;
+    if(f > nyq - 0.000001)
+        f = nyq - 0.000001;
+    double from[biquad_NCOEFS] = {x->x_b1, x->x_b2, x->x_a0, 0, x->x_a2};
+    int changed = f != x->x_f || reson != x->x_reson;
+    if(changed)
+        update_coeffs(x, f, reson);
+    double to[biquad_NCOEFS] = {x->x_b1, x->x_b2, x->x_a0, 0, x->x_a2};
+    t_biquad b = {x->x_xnm1, x->x_xnm2, x->x_ynm1, x->x_ynm2};
+    biquad_block(&b, from, changed ? to : NULL, x->x_rate, in, out, nblock);
+    x->x_xnm1 = b.b_xnm1, x->x_xnm2 = b.b_xnm2;
+    x->x_ynm1 = b.b_ynm1, x->x_ynm2 = b.b_ynm2;
+    return(w+5);
+}
+
 static void bandpass_dsp(t_bandpass *x, t_signal **sp){
     t_float nyq = sp[0]->s_sr / 2;
     if(nyq != x->x_nyq){
         x->x_nyq = nyq;
         update_coeffs(x, x->x_f, x->x_reson);
     }
-    dsp_add(bandpass_perform, 6, x, sp[0]->s_n, sp[0]->s_vec,
+    x->x_freq_scalar = magic_inlet_scalar((t_object *)x, x->x_glist, 1);
+    x->x_q_scalar = magic_inlet_scalar((t_object *)x, x->x_glist, 2);
+    if(x->x_freq_scalar && x->x_q_scalar)
+        dsp_add(bandpass_perform_scalar, 4, x, sp[0]->s_n, sp[0]->s_vec, sp[3]->s_vec);
+    else
+        dsp_add(bandpass_perform, 6, x, sp[0]->s_n, sp[0]->s_vec,
             sp[1]->s_vec, sp[2]->s_vec, sp[3]->s_vec);
 }
 
@@ -109,6 +172,10 @@ static void bandpass_bypass(t_bandpass *x, t_floatarg f){
     x->x_bypass = (int)(f != 0);
 }
 
+static void bandpass_rate(t_bandpass *x, t_floatarg f){
+    x->x_rate = f < 1 ? 1 : (int)f;
+}
+
 static void bandpass_bw(t_bandpass *x){
     x->x_bw = 1;
     update_coeffs(x, x->x_f, x->x_reson);
@@ -154,6 +221,7 @@ static void *bandpass_new(t_symbol *s, int argc, t_atom *argv){
             goto errstate;
     };
     x->x_bw = bw;
+    x->x_glist = canvas_getcurrent();
     x->x_nyq = sys_getsr()/2;
     update_coeffs(x, (double)freq, (double)reson);
     x->x_inlet_freq = inlet_new((t_object *)x, (t_pd *)x, &s_signal, &s_signal);
@@ -174,6 +242,7 @@ void bandpass_tilde_setup(void){
     class_addmethod(bandpass_class, nullfn, gensym("signal"), 0);
     class_addmethod(bandpass_class, (t_method)bandpass_clear, gensym("clear"), 0);
     class_addmethod(bandpass_class, (t_method)bandpass_bypass, gensym("bypass"), A_DEFFLOAT, 0);
+    class_addmethod(bandpass_class, (t_method)bandpass_rate, gensym("rate"), A_FLOAT, 0);
     class_addmethod(bandpass_class, (t_method)bandpass_bw, gensym("bw"), 0);
     class_addmethod(bandpass_class, (t_method)bandpass_q, gensym("q"), 0);
 }
@@ -1,4 +1,5 @@
 #include "m_pd.h"
+#include "biquad.h"
 
 #define COEFFS 5   // number of coeffs per filter stage
 #define MAX_COEFFS 250 // defining max number of coeffs to take
@@ -10,12 +11,11 @@ typedef struct _biquads{
     t_object  x_obj;
     t_inlet  *x_coefflet;
     t_outlet *x_outlet;
-    double    x_xnm1[STAGES];
-    double    x_xnm2[STAGES];
-    double    x_ynm1[STAGES];
-    double    x_ynm2[STAGES];
+    t_biquad  x_stage[STAGES];
     t_int     x_bypass;
     int 	  x_numfilt; // number of biquad filters
+    double   *x_buf;     // the block between sections, made in dsp
+    int       x_bufsize;
 	double 	  x_coeff[MAX_COEFFS]; // array of coeffs
 // the coeff array is an easy/cheap way of doing this
 // without malloc/calloc-ing - maybe worth changing in the future
@@ -25,7 +25,7 @@ void *biquads_new(void);
 
 void biquads_clear(t_biquads *x){
     for(int i = 0; i < x->x_numfilt; i++)
-        x->x_xnm1[i] = x->x_xnm2[i] = x->x_ynm1[i] = x->x_ynm2[i] = 0.f;
+        x->x_stage[i].b_xnm1 = x->x_stage[i].b_xnm2 = x->x_stage[i].b_ynm1 = x->x_stage[i].b_ynm2 = 0.f;
 }
 
 void biquads_bypass(t_biquads *x, t_floatarg f){
@@ -60,45 +60,43 @@ static t_int * biquads_perform(t_int *w){
     int nblock = (int)(w[2]);
     t_float *in = (t_float *)(w[3]);
     t_float *out = (t_float *)(w[4]);
-    t_int bypass = x->x_bypass;
     int numfilt = x->x_numfilt;
-    while(nblock--){
-      if(bypass)
-          *out++ = *in++;
-      else{
-          double xn = *in++;
-          int curfilt = 0; // filter section counter
-          while(curfilt < numfilt){
-              int curidx = COEFFS*curfilt; // current starting index
-              double b1 = x->x_coeff[curidx];
-              double b2 = x->x_coeff[curidx+1];
-              double a0 = x->x_coeff[curidx+2];
-              double a1 = x->x_coeff[curidx+3];
-              double a2 = x->x_coeff[curidx+4];
-              double xnm1 = x->x_xnm1[curfilt];
-              double xnm2 = x->x_xnm2[curfilt];
-              double ynm1 = x->x_ynm1[curfilt];
-              double ynm2 = x->x_ynm2[curfilt];
-              double yn = a0*xn + a1*xnm1 + a2*xnm2 + b1*ynm1 + b2*ynm2; // biquad section
-              x->x_xnm2[curfilt] = xnm1;
-              x->x_xnm1[curfilt] = xn;
-              x->x_ynm2[curfilt] = ynm1;
-              x->x_ynm1[curfilt] = yn;
-              xn = yn; // next stage's xn is previous yn!
-              curfilt++; // iterate the filter section counter
-        };
-        *out++ = xn; // xn is the cascaded output
-      };
-  };
-  return(w + 5);
+    if(x->x_bypass || !numfilt){
+        if(in != out){
+            while(nblock--)
+                *out++ = *in++;
+        }
+        return(w + 5);
+    }
+    if(numfilt == 1){
+        biquad_run(&x->x_stage[0], x->x_coeff, in, out, nblock);
+        return(w + 5);
+    }
+// a whole block goes through one section before the next, keeping each section's state in registers,
+// in between it stays in double like it did when every sample went through all sections at once
+    double *buf = x->x_buf;
+    for(int i = 0; i < nblock; i++)
+        buf[i] = in[i];
+    for(int curfilt = 0; curfilt < numfilt; curfilt++) // next stage's input is previous output
+        biquad_run_double(&x->x_stage[curfilt], x->x_coeff + COEFFS*curfilt, buf, buf, nblock);
+    for(int i = 0; i < nblock; i++)
+        out[i] = buf[i];
+    return(w + 5);
 }
 
 static void biquads_dsp(t_biquads *x, t_signal **sp){
+  int n = sp[0]->s_n;
+  if(n != x->x_bufsize){
+      x->x_buf = (double *)resizebytes(x->x_buf, x->x_bufsize * sizeof(double), n * sizeof(double));
+      x->x_bufsize = n;
+  }
   dsp_add(biquads_perform, 4, x, sp[0]->s_n, sp[0]->s_vec, sp[1]->s_vec);
 }
 
 static void *biquads_free(t_biquads *x){
 	outlet_free(x->x_outlet);
+	if(x->x_buf)
+		freebytes(x->x_buf, x->x_bufsize * sizeof(double));
 	return (void *)x;
 }
 
@@ -107,11 +105,13 @@ void *biquads_new(void){
   x->x_outlet = outlet_new(&x->x_obj, &s_signal);
   x->x_bypass = 0;
   x->x_numfilt = 0; // setting number of filters to 0 initially bc no coeffs
+  x->x_buf = NULL;
+  x->x_bufsize = 0;
   int i;
   for(i = 0; i < MAX_COEFFS; i++) // zeroing out coeff array
 	x->x_coeff[i] = 0.f;
   for(i = 0; i < STAGES; i++) // zeroing out filter's memory
-	x->x_xnm1[i] = x->x_xnm2[i] = x->x_ynm1[i] = x->x_ynm2[i] = 0.f;
+	x->x_stage[i].b_xnm1 = x->x_stage[i].b_xnm2 = x->x_stage[i].b_ynm1 = x->x_stage[i].b_ynm2 = 0.f;
   return(x);
 }
 
@@ -6,6 +6,8 @@
 // Valimaki. http://www.acoustics.hut.fi/publications/papers/smc2010-phaseshaping/
 
 #include "m_pd.h"
+#include "magic.h"
+#include "blwave.h"
 #include <math.h>
 #include <stdint.h>
 
@@ -18,12 +20,17 @@ typedef struct _polyblep{
     t_float freq_in_seconds_per_sample;
     t_float sr;
     t_float last_phase_offset;
+    t_blwave wave;          // the tables, when reading them instead of correcting with polyBLEP
 }t_polyblep;
 
 typedef struct blsaw{
     t_object    x_obj;
     t_float     x_f;
-    t_polyblep  x_polyblep;
+    t_polyblep *x_polyblep; // one oscillator per channel
+    int         x_nchans;
+    int         x_sync_nchans;
+    int         x_phase_nchans;
+    int         x_table;    // read the shared band-limited tables
     t_inlet*    x_inlet_sync;
     t_inlet*    x_inlet_phase;
 }t_blsaw;
@@ -59,13 +66,8 @@ static t_float saw(const t_polyblep* x){
     return(y);
 }
 
-static t_int* blsaw_perform(t_int *w) {
-    t_polyblep* x      = (t_polyblep*)(w[1]);
-    t_int n            = (t_int)(w[2]);
-    t_float* freq_vec  = (t_float *)(w[3]);
-    t_float* sync_vec  = (t_float *)(w[4]);
-    t_float* phase_vec = (t_float *)(w[5]);
-    t_float* out       = (t_float *)(w[6]);
+static void blsaw_run(t_polyblep* x, int table, t_int n, t_float* freq_vec, t_float* sync_vec,
+t_float* phase_vec, t_float* out){
     while(n--){
         t_float freq = *freq_vec++;
         t_float sync = *sync_vec++;
@@ -82,38 +84,79 @@ static t_int* blsaw_perform(t_int *w) {
                 phase_dev = fmod(phase_dev, 1);
             x->phase = phasewrap(x->phase + phase_dev);
         }
-        y = saw(x);
+        if(table){
+            blwave_setdt(&x->wave, x->freq_in_seconds_per_sample);
+            y = blwave_saw(&x->wave, x->phase);
+        }
+        else
+            y = saw(x);
         x->phase += x->freq_in_seconds_per_sample;
         x->phase = phasewrap(x->phase);
         x->last_phase_offset = phase_offset;
         *out++ = y;  // Send to output
     }
+}
+
+// one call for all channels, sync and phase inputs with fewer channels are reused
+static t_int* blsaw_perform(t_int *w) {
+    t_blsaw* x         = (t_blsaw*)(w[1]);
+    t_int n            = (t_int)(w[2]);
+    t_float* freq_vec  = (t_float *)(w[3]);
+    t_float* sync_vec  = (t_float *)(w[4]);
+    t_float* phase_vec = (t_float *)(w[5]);
+    t_float* out       = (t_float *)(w[6]);
+    for(int ch = 0; ch < x->x_nchans; ch++){
+        blsaw_run(&x->x_polyblep[ch], x->x_table, n, freq_vec + ch*n,
+            sync_vec + (ch % x->x_sync_nchans)*n,
+            phase_vec + (ch % x->x_phase_nchans)*n, out + ch*n);
+    }
     return(w+7);
 }
 
 static void blsaw_dsp(t_blsaw *x, t_signal **sp){
-    x->x_polyblep.sr = sp[0]->s_sr;
-    dsp_add(blsaw_perform, 6, &x->x_polyblep, sp[0]->s_n, sp[0]->s_vec,
+    int nchans = magic_nchans(sp[0]);
+    if(nchans != x->x_nchans){
+        x->x_polyblep = (t_polyblep *)resizebytes(x->x_polyblep,
+            x->x_nchans * sizeof(t_polyblep), nchans * sizeof(t_polyblep));
+        for(int ch = x->x_nchans; ch < nchans; ch++) // new oscillators start like the first one
+            x->x_polyblep[ch] = x->x_polyblep[0];
+        x->x_nchans = nchans;
+    }
+    x->x_sync_nchans = magic_nchans(sp[1]);
+    x->x_phase_nchans = magic_nchans(sp[2]);
+    magic_setmultiout(&sp[3], nchans);
+    for(int ch = 0; ch < nchans; ch++)
+        x->x_polyblep[ch].sr = sp[0]->s_sr;
+    dsp_add(blsaw_perform, 6, x, sp[0]->s_n, sp[0]->s_vec,
             sp[1]->s_vec, sp[2]->s_vec, sp[3]->s_vec);
  }
 
+static void blsaw_table(t_blsaw *x, t_floatarg f){
+    x->x_table = f != 0;
+}
+
 static void blsaw_free(t_blsaw *x){
     inlet_free(x->x_inlet_sync);
     inlet_free(x->x_inlet_phase);
+    freebytes(x->x_polyblep, x->x_nchans * sizeof(t_polyblep));
 }
 
 static void* blsaw_new(t_symbol *s, int ac, t_atom *av){
     s = NULL;
     t_blsaw* x = (t_blsaw *)pd_new(bl_saw);
-    x->x_polyblep.pulse_width = 0;
-    x->x_polyblep.freq_in_seconds_per_sample = 0;
-    x->x_polyblep.phase = 0.0;
+    x->x_polyblep = (t_polyblep *)getbytes(sizeof(t_polyblep));
+    x->x_nchans = x->x_sync_nchans = x->x_phase_nchans = 1;
+    x->x_polyblep->pulse_width = 0;
+    x->x_polyblep->freq_in_seconds_per_sample = 0;
+    x->x_polyblep->phase = 0.0;
+    blwave_reset(&x->x_polyblep->wave);
+    x->x_table = 0;
     t_float init_freq = 0, init_phase = 0;
     if(ac && av->a_type == A_FLOAT){
         init_freq = av->a_w.w_float;
         ac--; av++;
         if(ac && av->a_type == A_FLOAT){
-            x->x_polyblep.pulse_width = av->a_w.w_float;
+            x->x_polyblep->pulse_width = av->a_w.w_float;
             ac--; av++;
         }
         if(ac && av->a_type == A_FLOAT){
@@ -132,7 +175,9 @@ static void* blsaw_new(t_symbol *s, int ac, t_atom *av){
 
 void setup_bl0x2esaw_tilde(void){
     bl_saw = class_new(gensym("bl.saw~"), (t_newmethod)blsaw_new,
-        (t_method)blsaw_free, sizeof(t_blsaw), 0, A_GIMME, A_NULL);
+        (t_method)blsaw_free, sizeof(t_blsaw), MAGIC_MULTICHANNEL, A_GIMME, A_NULL);
     CLASS_MAINSIGNALIN(bl_saw, t_blsaw, x_f);
     class_addmethod(bl_saw, (t_method)blsaw_dsp, gensym("dsp"), A_NULL);
+    class_addmethod(bl_saw, (t_method)blsaw_table, gensym("table"), A_FLOAT, 0);
+    blwave_init();
 }
@@ -6,6 +6,7 @@
 // Valimaki. http://www.acoustics.hut.fi/publications/papers/smc2010-phaseshaping/
 
 #include "m_pd.h"
+#include "blwave.h"
 #include <math.h>
 #include <stdint.h>
 
@@ -18,6 +19,8 @@ typedef struct _polyblep{
     t_float freq_in_seconds_per_sample;
     t_float sr;
     t_float last_phase_offset;
+    int table;              // read the shared band-limited saw tables instead
+    t_blwave wave;
 }t_polyblep;
 
 typedef struct blsquare{
@@ -88,7 +91,13 @@ static t_int* blsquare_perform(t_int *w) {
                 phase_dev = fmod(phase_dev, 1);
             x->phase = phasewrap(x->phase + phase_dev);
         }
-        y = sqr(x);
+        if(x->table){ // the difference of two saws pulse_width apart
+            t_float t2 = phasewrap(x->phase - x->pulse_width);
+            blwave_setdt(&x->wave, x->freq_in_seconds_per_sample);
+            y = blwave_saw(&x->wave, x->phase) - blwave_saw(&x->wave, t2) + 2 * x->pulse_width - 1;
+        }
+        else
+            y = sqr(x);
         x->phase += x->freq_in_seconds_per_sample;
         x->phase = phasewrap(x->phase);
         x->last_phase_offset = phase_offset;
@@ -103,6 +112,10 @@ static void blsquare_dsp(t_blsquare *x, t_signal **sp){
         sp[1]->s_vec, sp[2]->s_vec, sp[3]->s_vec, sp[4]->s_vec);
  }
 
+static void blsquare_table(t_blsquare *x, t_floatarg f){
+    x->x_polyblep.table = f != 0;
+}
+
 static void blsquare_free(t_blsquare *x){
     inlet_free(x->x_inlet_sync);
     inlet_free(x->x_inlet_phase);
@@ -115,6 +128,8 @@ static void* blsquare_new(t_symbol *s, int ac, t_atom *av){
     x->x_polyblep.pulse_width = 0.5;
     x->x_polyblep.freq_in_seconds_per_sample = 0;
     x->x_polyblep.phase = 0.0;
+    x->x_polyblep.table = 0;
+    blwave_reset(&x->x_polyblep.wave);
     t_float init_freq = 0, init_phase = 0;
     if(ac && av->a_type == A_FLOAT){
         init_freq = av->a_w.w_float;
@@ -144,4 +159,6 @@ void setup_bl0x2esquare_tilde(void){
         (t_method)blsquare_free, sizeof(t_blsquare), 0, A_GIMME, A_NULL);
     CLASS_MAINSIGNALIN(bl_square, t_blsquare, x_f);
     class_addmethod(bl_square, (t_method)blsquare_dsp, gensym("dsp"), A_NULL);
+    class_addmethod(bl_square, (t_method)blsquare_table, gensym("table"), A_FLOAT, 0);
+    blwave_init();
 }
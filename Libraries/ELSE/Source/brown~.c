@@ -35,8 +35,8 @@ static t_int *brown_perform(t_int *w){
     uint32_t *s2 = &x->x_rstate.s2;
     uint32_t *s3 = &x->x_rstate.s3;
     t_float lastout = x->x_lastout;
-    while(nblock--){
-        if(x->x_inmode){
+    if(x->x_inmode){
+        while(nblock--){
             t_float impulse = (*in++ != 0);
             if(impulse){
                 t_float noise = random_frand(s1, s2, s3);
@@ -48,14 +48,16 @@ static t_int *brown_perform(t_int *w){
             }
             *out++ = lastout;
         }
-        else{
-            t_float noise = random_frand(s1, s2, s3);
-            lastout += (noise * x->x_step);
+    }
+    else{ // every sample takes a step, the noise is made in one go and integrated in place
+        random_frand_block(&x->x_rstate, out, nblock);
+        for(int i = 0; i < nblock; i++){
+            lastout += (out[i] * x->x_step);
             if(lastout > 1)
                 lastout = 2 - lastout;
             if(lastout < -1)
                 lastout = -2 - lastout;
-            *out++ = lastout;
+            out[i] = lastout;
         }
     }
     x->x_lastout = lastout;
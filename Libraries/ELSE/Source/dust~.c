@@ -24,18 +24,21 @@ static t_int *dust_perform(t_int *w){
     t_float *in1 = (t_float *)(w[3]);
     t_float *out = (t_sample *)(w[4]);
     t_float lastout = x->x_lastout;
-    uint32_t *s1 = &x->x_rstate.s1;
-    uint32_t *s2 = &x->x_rstate.s2;
-    uint32_t *s3 = &x->x_rstate.s3;
-    while(n--){
-        t_float density = *in1++;
-        t_float thresh = density * x->x_sample_dur;
-        t_float scale = thresh > 0 ? 1./thresh : 0;
-        t_float random = (t_float)(random_frand(s1, s2, s3) * 0.5 + 0.5);
-        t_float output = random < thresh ? random * scale : 0;
-        if(output != 0 && lastout != 0)
-            output = 0;
-        *out++ = lastout = output;
+    t_sample noise[random_BLOCK]; // the input and output can share a buffer
+    while(n > 0){
+        int chunk = n < random_BLOCK ? n : random_BLOCK;
+        random_frand_block(&x->x_rstate, noise, chunk);
+        for(int i = 0; i < chunk; i++){
+            t_float density = *in1++;
+            t_float thresh = density * x->x_sample_dur;
+            t_float scale = thresh > 0 ? 1./thresh : 0;
+            t_float random = (t_float)(noise[i] * 0.5 + 0.5);
+            t_float output = random < thresh ? random * scale : 0;
+            if(output != 0 && lastout != 0)
+                output = 0;
+            *out++ = lastout = output;
+        }
+        n -= chunk;
     }
     x->x_lastout = lastout;
     return(w+5);
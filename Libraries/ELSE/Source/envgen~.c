@@ -344,20 +344,43 @@ static void envgen_suspoint(t_envgen *x, t_floatarg f){
     x->x_suspoint = f < 0 ? 0 : (int)f;
 }
 
+// linear line for n samples, that many are left in it, each step comes from its index
+// like in envgen_get_step() instead of the sample before, so the loop vectorises
+static void envgen_line(t_envgen *x, t_float *out, int n){
+    float last_target = x->x_last_target, delta = x->x_delta, size = (float)x->x_n;
+    int done = x->x_n - x->x_nleft;
+    out[0] = last_target + x->x_inc;
+    for(int i = 1; i < n; i++)
+        out[i] = last_target + (float)(done + i) / size * delta;
+    x->x_nleft -= n;
+    x->x_value = out[n-1];
+    x->x_inc = delta != 0 ? (float)(done + n) / size * delta : 0;
+}
+
 static t_int *envgen_perform(t_int *w){
     t_envgen *x = (t_envgen *)(w[1]);
     int n = (int)(w[2]);
     t_float *in = (t_float *)(w[3]);
     t_float *out = (t_float *)(w[4]);
     float lastin = x->x_lastin;
-    while(n--){
-        t_float f = *in++;
+    while(n > 0){
+        t_float f = *in;
         if(f != 0 && lastin == 0){ // set attack ramp
             x->x_gain = f;
             envgen_attack(x, x->x_ac, x->x_av);
         }
         else if(x->x_release && f == 0 && lastin != 0) // set release ramp
             envgen_release(x, x->x_ac_rel, x->x_av_rel);
+        if(!x->x_pause && x->x_status && x->x_nleft > 0 && fabs(x->x_power) == 1){
+            // a linear line, up to its end or until the gate opens or closes
+            int span = 1;
+            while(span < n && span < x->x_nleft && (in[span] != 0) == (f != 0))
+                span++;
+            envgen_line(x, out, span);
+            lastin = f; // in can be out, the span has the zeroness of f
+            in += span, out += span, n -= span;
+            continue;
+        }
         if(PD_BIGORSMALL(x->x_value)) // ??????????????
             x->x_value = 0;
         *out++ = x->x_value = x->x_last_target + x->x_inc;
@@ -376,6 +399,7 @@ static t_int *envgen_perform(t_int *w){
             }
         }
         lastin = f;
+        in++, n--;
     }
     x->x_lastin = lastin;
     return(w+5);
@@ -1,6 +1,8 @@
 // Porres 2017
 
 #include "m_pd.h"
+#include "biquad.h"
+#include "magic.h"
 #include <math.h>
 
 #define PI 3.14159265358979323846
@@ -13,9 +15,14 @@ typedef struct _eq{
     t_inlet    *x_inlet_q;
     t_inlet    *x_inlet_amp;
     t_outlet   *x_out;
+    t_glist    *x_glist;
+    t_float    *x_freq_scalar; // NULL when a signal is connected
+    t_float    *x_q_scalar; // NULL when a signal is connected
+    t_float    *x_amp_scalar; // NULL when a signal is connected
     t_float     x_nyq;
     int         x_bw;
     int         x_bypass;
+    int         x_rate; // samples between coefficient updates, they glide in between
     double      x_xnm1;
     double      x_xnm2;
     double      x_ynm1;
@@ -69,6 +76,30 @@ static t_int *eq_perform(t_int *w){
     double ynm1 = x->x_ynm1;
     double ynm2 = x->x_ynm2;
     t_float nyq = x->x_nyq;
+    if(x->x_rate > 1 && !x->x_bypass){ // coefficients are worked out every x_rate samples
+        t_biquad b = {xnm1, xnm2, ynm1, ynm2};
+        for(int i = 0; i < nblock; i += x->x_rate){
+            int n = nblock - i < x->x_rate ? nblock - i : x->x_rate;
+            double f = in2[i+n-1], reson = in3[i+n-1], db = in4[i+n-1];
+            if(f < 0.1)
+                f = 0.1;
+            if(f > nyq - 0.1)
+                f = nyq - 0.1;
+            if(reson < 0.000001)
+                reson = 0.000001;
+            double from[biquad_NCOEFS] = {x->x_b1, x->x_b2, x->x_a0, x->x_a1, x->x_a2};
+            if(f != x->x_f || reson != x->x_reson || db != x->x_db){
+                update_coeffs(x, f, reson, db);
+                double to[biquad_NCOEFS] = {x->x_b1, x->x_b2, x->x_a0, x->x_a1, x->x_a2};
+                biquad_ramp(&b, from, to, in1 + i, out + i, n);
+            }
+            else
+                biquad_run(&b, from, in1 + i, out + i, n);
+        }
+        x->x_xnm1 = b.b_xnm1, x->x_xnm2 = b.b_xnm2;
+        x->x_ynm1 = b.b_ynm1, x->x_ynm2 = b.b_ynm2;
+        return(w+8);
+    }
     while(nblock--){
         double xn = *in1++, f = *in2++, reson = *in3++, db = *in4++, yn;
         if(x->x_bypass)
@@ -97,13 +128,51 @@ static t_int *eq_perform(t_int *w){
     return(w+8);
 }
 
+// the parameters have no signal connected, so they're read once per block
+static t_int *eq_perform_scalar(t_int *w){
+    t_eq *x = (t_eq *)(w[1]);
+    int nblock = (int)(w[2]);
+    t_float *in = (t_float *)(w[3]);
+    t_float *out = (t_float *)(w[4]);
+    if(x->x_bypass){
+        if(in != out)
+            for(int i = 0; i < nblock; i++)
+                out[i] = in[i];
+        return(w+5);
+    }
+    t_float nyq = x->x_nyq;
+    double f = *x->x_freq_scalar, reson = *x->x_q_scalar, db = *x->x_amp_scalar;
+    if(f < 0.1)
+        f = 0.1;
+    if(f > nyq - 0.1)
+        f = nyq - 0.1;
+    if(reson < 0.000001)
+        reson = 0.000001;
+    double from[biquad_NCOEFS] = {x->x_b1, x->x_b2, x->x_a0, x->x_a1, x->x_a2};
+    int changed = f != x->x_f || reson != x->x_reson || db != x->x_db;
+    if(changed)
+        update_coeffs(x, f, reson, db);
+    double to[biquad_NCOEFS] = {x->x_b1, x->x_b2, x->x_a0, x->x_a1, x->x_a2};
+    t_biquad b = {x->x_xnm1, x->x_xnm2, x->x_ynm1, x->x_ynm2};
+    biquad_block(&b, from, changed ? to : NULL, x->x_rate, in, out, nblock);
+    x->x_xnm1 = b.b_xnm1, x->x_xnm2 = b.b_xnm2;
+    x->x_ynm1 = b.b_ynm1, x->x_ynm2 = b.b_ynm2;
+    return(w+5);
+}
+
 static void eq_dsp(t_eq *x, t_signal **sp){
     t_float nyq = sp[0]->s_sr / 2;
     if(nyq != x->x_nyq){
         x->x_nyq = nyq;
         update_coeffs(x, x->x_f, x->x_reson, x->x_db);
     }
-    dsp_add(eq_perform, 7, x, sp[0]->s_n, sp[0]->s_vec,
+    x->x_freq_scalar = magic_inlet_scalar((t_object *)x, x->x_glist, 1);
+    x->x_q_scalar = magic_inlet_scalar((t_object *)x, x->x_glist, 2);
+    x->x_amp_scalar = magic_inlet_scalar((t_object *)x, x->x_glist, 3);
+    if(x->x_freq_scalar && x->x_q_scalar && x->x_amp_scalar)
+        dsp_add(eq_perform_scalar, 4, x, sp[0]->s_n, sp[0]->s_vec, sp[4]->s_vec);
+    else
+        dsp_add(eq_perform, 7, x, sp[0]->s_n, sp[0]->s_vec,
             sp[1]->s_vec, sp[2]->s_vec, sp[3]->s_vec, sp[4]->s_vec);
 }
 
@@ -115,6 +184,10 @@ static void eq_bypass(t_eq *x, t_floatarg f){
     x->x_bypass = (int)(f != 0);
 }
 
+static void eq_rate(t_eq *x, t_floatarg f){
+    x->x_rate = f < 1 ? 1 : (int)f;
+}
+
 static void eq_bw(t_eq *x){
     x->x_bw = 1;
     update_coeffs(x, x->x_f, x->x_reson, x->x_db);
@@ -164,6 +237,7 @@ static void *eq_new(t_symbol *s, int argc, t_atom *argv){
             goto errstate;
     };
     x->x_bw = bw;
+    x->x_glist = canvas_getcurrent();
     x->x_nyq = sys_getsr()/2;
     update_coeffs(x, (double)freq, (double)reson, (double)db);
     x->x_inlet_freq = inlet_new((t_object *)x, (t_pd *)x, &s_signal, &s_signal);
@@ -186,6 +260,7 @@ void eq_tilde_setup(void){
     class_addmethod(eq_class, nullfn, gensym("signal"), 0);
     class_addmethod(eq_class, (t_method)eq_clear, gensym("clear"), 0);
     class_addmethod(eq_class, (t_method)eq_bypass, gensym("bypass"), A_DEFFLOAT, 0);
+    class_addmethod(eq_class, (t_method)eq_rate, gensym("rate"), A_FLOAT, 0);
     class_addmethod(eq_class, (t_method)eq_bw, gensym("bw"), 0);
     class_addmethod(eq_class, (t_method)eq_q, gensym("q"), 0);
 }
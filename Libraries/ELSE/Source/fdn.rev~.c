@@ -23,17 +23,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
 
-typedef  union _isdenorm{
-    t_float f;
-    uint32_t ui;
-}t_isdenorm;
-
-static inline int denorm_check(t_float f){
-    t_isdenorm mask;
-    mask.f = f;
-    return((mask.ui & 0x07f800000) == 0);
-}
+#define FDN_MAXOUTS 8
 
 // por mim essa merda toda vem pra baixo
 typedef struct fdnctl{
@@ -48,9 +40,11 @@ typedef struct fdnctl{
     t_int   *c_tap;         // cirular feed: N+1 pointers: 1 read, (N-1)r/w, 1 write
     t_float *c_time_ms;
     t_int    c_bufsize;
-    t_float *c_vector[2];
+    t_float *c_state;       // decay filter outputs, one per line
+    t_float *c_read;        // line outputs of the current sample, plus the first one again
     t_float *c_vectorbuffer;
-    t_int    c_curvector;
+    t_int    c_nouts;
+    t_float *c_outs[FDN_MAXOUTS];
 }t_fdnctl;
 
 typedef struct fdn{
@@ -194,84 +188,71 @@ static void fdn_clear(t_fdn *x){
     if(x->x_ctl.c_buf)
         memset(x->x_ctl.c_buf, 0, x->x_ctl.c_bufsize * sizeof(float));
     if(x->x_ctl.c_vectorbuffer)
-        memset(x->x_ctl.c_vectorbuffer, 0, x->x_ctl.c_maxorder * 2 * sizeof(float));
+        memset(x->x_ctl.c_vectorbuffer, 0, (x->x_ctl.c_maxorder * 2 + 1) * sizeof(float));
 }
 
+// Every step is a loop over all lines that doesn't depend on the previous line, so the
+// compiler can vectorise them. Only reading and writing the delay memory is scattered.
 static t_int *fdn_perform(t_int *w){
     t_fdnctl *ctl       = (t_fdnctl *)(w[1]);
     t_int n             = (t_int)(w[2]);
     t_float *in         = (float *)(w[3]);
-    t_float *outl       = (float *)(w[4]);
-    t_float *outr       = (float *)(w[5]);
     t_float *gain_in    = ctl->c_gain_in;
     t_float *gain_state = ctl->c_gain_state;
     t_int order         = ctl->c_order;
     t_int *tap          = ctl->c_tap;
     t_float *buf        = ctl->c_buf;
+    t_float *state      = ctl->c_state;
+    t_float *z          = ctl->c_read;
+    t_int nouts         = ctl->c_nouts;
     t_int mask          = ctl->c_bufsize - 1;
-    t_int i, j;
-    t_float x, y, left, right, z;
-    t_float *cvec, *lvec;
-    t_float save;
+    t_int i, j, k;
+    t_float x, y, feed, save;
+    t_float sums[FDN_MAXOUTS];
     for(i = 0; i < n; i++){
-        x = *in++;
+        x = in[i]; // before writing outputs, they can share the buffer
+// read input vector
+        for(j = 0; j < order; j++)
+            z[j] = buf[tap[j]];
+        z[order] = z[0];
+// get sum and outputs, 2 outputs are the same as before: + - + - and + + - -
         y = 0;
-        left = 0;
-        right = 0;
-// get temporary vector buffers
-        cvec = ctl->c_vector[ctl->c_curvector];
-        lvec = ctl->c_vector[ctl->c_curvector ^ 1];
-        ctl->c_curvector ^= 1;
-// read input vector + get sum and left/right output
-        for(j = 0; j < order;){
-            z = buf[tap[j]];
-            cvec[j] = z;
-            y     += z;
-            left  += z;
-            right += z;
-            j++;
-            z = buf[tap[j]];
-            cvec[j] = z;
-            y     += z;
-            left  -= z;
-            right += z;
-            j++;
-            z = buf[tap[j]];
-            cvec[j] = z;
-            y     += z;
-            left  += z;
-            right -= z;
-            j++;
-            z = buf[tap[j]];
-            cvec[j] = z;
-            y     += z;
-            left  -= z;
-            right -= z;
-            j++;
+        for(j = 0; j < order; j++)
+            y += z[j];
+        for(k = 0; k < nouts; k++)
+            sums[k] = 0;
+        if(nouts == 2){
+            for(j = 0; j < order; j += 4){
+                sums[0] += z[j] - z[j+1] + z[j+2] - z[j+3];
+                sums[1] += z[j] + z[j+1] - z[j+2] - z[j+3];
+            }
+        }
+        else{ // every output has its own lines, signs alternate every nouts lines
+            for(j = 0; j < order; j++)
+                sums[j & (nouts - 1)] += (j & nouts) ? -z[j] : z[j];
         }
-        *outl++ = left;
-        *outr++ = right;
-        y *=  ctl->c_leak; // y == leak to all inputs
-// perform feedback (todo: decouple feedback & permutation)
-        save = cvec[0];
-        for(j = 0; j < order-1; j++)
-            cvec[j] = cvec[j+1] + y + x;
-        cvec[order-1] = save + y + x;
-// apply gain + store result vector in delay lines + increment taps
+        for(k = 0; k < nouts; k++)
+            ctl->c_outs[k][i] = sums[k];
+// perform feedback: leak to all inputs, rotated by one line, then the decay filter
+        feed = y * ctl->c_leak + x;
+        for(j = 0; j < order; j++){
+            save = gain_in[j] * (z[j+1] + feed) + gain_state[j] * state[j];
+            state[j] = fabsf(save) < FLT_MIN ? 0 : save; // denormals
+        }
+// store result vector in delay lines + increment taps
         tap[0] = (tap[0] + 1)&mask;
         for(j = 0; j < order; j++){
-            save = gain_in[j] * cvec[j] + gain_state[j] * lvec[j];
-            save = denorm_check(save) ? 0 : save;
-            cvec[j] = save;
-            buf[tap[j+1]] = save;
+            buf[tap[j+1]] = state[j];
             tap[j+1] = (tap[j+1] + 1) & mask;
         }
     }
-    return(w+6);
+    return(w+4);
 }
 
 static void fdn_dsp(t_fdn *x, t_signal **sp){
-  dsp_add(fdn_perform, 5, &x->x_ctl, sp[0]->s_n, sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec);
+    for(t_int k = 0; k < x->x_ctl.c_nouts; k++)
+        x->x_ctl.c_outs[k] = sp[k+1]->s_vec;
+    dsp_add(fdn_perform, 3, &x->x_ctl, sp[0]->s_n, sp[0]->s_vec);
 }
 
 static void fdn_free(t_fdn *x){
@@ -296,6 +277,7 @@ static void *fdn_new(t_symbol *s, int ac, t_atom *av){
 ////////
     t_int order = 1024; // maximum order is 1024
     t_int size = 23;
+    t_int nouts = 2;
     t_float t60 = 4;
     t_float damping = 0;
     x->x_exp = 0;
@@ -359,6 +341,15 @@ static void *fdn_new(t_symbol *s, int ac, t_atom *av){
                 else
                     goto errstate;
             }
+            else if(!strcmp(cursym->s_name, "-outs")){
+                if(ac >= 2 && (av+1)->a_type == A_FLOAT){
+                    nouts = (int)atom_getfloatarg(1, ac, av);
+                    ac -= 2;
+                    av += 2;
+                }
+                else
+                    goto errstate;
+            }
             else if(!strcmp(cursym->s_name, "-exp"))
                 x->x_exp = 1;
             else
@@ -371,6 +362,7 @@ static void *fdn_new(t_symbol *s, int ac, t_atom *av){
      if(order < 4)
          order = 4;
     order = ((int)order) & 0xfffffffc; // clip to powers of 2
+    nouts = nouts <= 2 ? 2 : nouts <= 4 ? 4 : FDN_MAXOUTS;
     if(size < 16) // size in samples
         size = 16;
     if(size > 30) // size in samples
@@ -387,11 +379,11 @@ static void *fdn_new(t_symbol *s, int ac, t_atom *av){
     x->x_ctl.c_time_ms = (t_float *)malloc(order * sizeof(t_float));
     x->x_ctl.c_gain_in = (t_float *)malloc(order * sizeof(t_float));
     x->x_ctl.c_gain_state = (t_float *)malloc(order * sizeof(t_float));
-    x->x_ctl.c_vectorbuffer = (t_float *)malloc(order * 2 * sizeof(float));
-    memset(x->x_ctl.c_vectorbuffer, 0, order * 2 * sizeof(float));
-    x->x_ctl.c_curvector = 0;
-    x->x_ctl.c_vector[0] = &x->x_ctl.c_vectorbuffer[0];
-    x->x_ctl.c_vector[1] = &x->x_ctl.c_vectorbuffer[order];
+    x->x_ctl.c_vectorbuffer = (t_float *)malloc((order * 2 + 1) * sizeof(float));
+    memset(x->x_ctl.c_vectorbuffer, 0, (order * 2 + 1) * sizeof(float));
+    x->x_ctl.c_state = x->x_ctl.c_vectorbuffer;
+    x->x_ctl.c_read = x->x_ctl.c_vectorbuffer + order;
+    x->x_ctl.c_nouts = nouts;
 // default input list
     t_atom at[8];
     SETFLOAT(at, 7.f);
@@ -407,8 +399,8 @@ static void *fdn_new(t_symbol *s, int ac, t_atom *av){
     fdn_clear(x);
     inlet_new(&x->x_obj, &x->x_obj.ob_pd, gensym("float"), gensym("time"));
     inlet_new(&x->x_obj, &x->x_obj.ob_pd, gensym("float"), gensym("damping"));
-    outlet_new(&x->x_obj, gensym("signal"));
-    outlet_new(&x->x_obj, gensym("signal"));
+    for(t_int k = 0; k < nouts; k++)
+        outlet_new(&x->x_obj, gensym("signal"));
     return(void *)x;
 errstate:
     pd_error(x, "[fdn.rev~]: improper args");
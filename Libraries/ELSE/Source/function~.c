@@ -5,11 +5,23 @@
 
 #define MAX_SIZE  4096
 
+// a segment from point i-1 to point i, with what function_interpolate needs ready
+typedef struct _function_seg{
+    float       s_start;
+    float       s_dif;
+    float       s_x;        // where it starts
+    float       s_scale;    // 1 / its duration
+    float       s_power;
+    int         s_linear;
+    int         s_invert;   // the curve is 1 - (1 - frac)^power
+}t_function_seg;
+
 typedef struct _function{
     t_object    x_obj;
     float       x_f;
     float      *x_points;
     float      *x_durations;
+    t_function_seg *x_segs;
     float       x_power;
     t_atom      x_at_exp[MAX_SIZE];
     t_atom      x_at_av[MAX_SIZE];
@@ -20,52 +32,86 @@ typedef struct _function{
 
 static t_class *function_class;
 
-static t_sample function_interpolate(t_function* x, t_sample f){
-    float point_m1 = x->x_points[x->x_point-1];
-    float point = x->x_points[x->x_point];
-    float dif = point - point_m1;
-    float dur = x->x_durations[x->x_point];
-    float dur_m1 = x->x_durations[x->x_point-1];
-    float frac = (f-dur_m1)/(dur-dur_m1);
-    float power = x->x_at_exp[x->x_point-1].a_w.w_float;
-    if(fabs(power) == 1) // linear
-        return(point_m1 + frac * dif);
-    else{
-        if(power >= 0){ // positive exponential
-            if(point_m1 < point) // ascending
-                return(point_m1 + pow(frac, power) * dif);
-            else // descending` (invert)
-                return(point_m1 + (1-pow(1-frac, power)) * dif);
+// sets up the segments again after the points, durations or curves changed
+static void function_update(t_function *x){
+    for(int i = 1; i <= x->x_last_point && i < MAX_SIZE; i++){
+        t_function_seg *seg = x->x_segs + i;
+        float point_m1 = x->x_points[i-1];
+        float point = x->x_points[i];
+        float dur = x->x_durations[i] - x->x_durations[i-1];
+        float power = x->x_at_exp[i-1].a_w.w_float;
+        seg->s_start = point_m1;
+        seg->s_dif = point - point_m1;
+        seg->s_x = x->x_durations[i-1];
+        seg->s_scale = dur > 0 ? 1. / dur : 0; // empty segments are never interpolated
+        seg->s_linear = fabs(power) == 1;
+        seg->s_power = fabs(power);
+        // positive exponentials are inverted when descending, negative ones when ascending
+        seg->s_invert = power >= 0 ? !(point_m1 < point) : point_m1 < point;
+    }
+}
+
+static t_sample function_interpolate(t_function_seg *seg, t_sample f){
+    float frac = (f - seg->s_x) * seg->s_scale;
+    if(seg->s_linear)
+        return(seg->s_start + frac * seg->s_dif);
+    else if(seg->s_invert)
+        return(seg->s_start + (1-pow(1-frac, seg->s_power)) * seg->s_dif);
+    else
+        return(seg->s_start + pow(frac, seg->s_power) * seg->s_dif);
+}
+
+// the point whose segment f is in, starting from the segment of the last sample: it's kept while f is
+// in it and the next one is tried before searching, since ramps stay in a segment or move to the next
+static int function_find(t_function *x, int point, t_sample f){
+    float *dur = x->x_durations;
+    int last = x->x_last_point, lo, hi;
+    if(point > 0 && f < dur[point-1]){ // before the segment: last point whose start isn't after f
+        lo = 0, hi = point - 1;
+        while(lo < hi){
+            int mid = (lo + hi + 1) / 2;
+            if(dur[mid-1] <= f)
+                lo = mid;
+            else
+                hi = mid - 1;
         }
-        else{
-            if(point_m1 < point) // ascending
-                return(point_m1 + (1-pow(1-frac, -power)) * dif);
-            else // descending` (invert)
-                return(point_m1 + pow(frac, -power) * dif);
+        return(lo);
+    }
+    if(point < last && dur[point] < f){ // after it: first point whose end isn't before f
+        if(++point == last || f <= dur[point]) // mostly the next one
+            return(point);
+        lo = point + 1, hi = last;
+        while(lo < hi){
+            int mid = (lo + hi) / 2;
+            if(f <= dur[mid])
+                hi = mid;
+            else
+                lo = mid + 1;
         }
+        return(lo);
     }
+    return(point);
 }
-    
+
 static t_int *functionsig_perform(t_int *w){
 	t_function *x = (t_function *)(w[1]);
     t_sample *in = (t_float *)(w[2]);
     t_sample *out = (t_float *)(w[3]);
     int n = (int)(w[4]);
-    if(x->x_point > x->x_last_point)
-        x->x_point = x->x_last_point;
+    int point = x->x_point;
+    if(point > x->x_last_point)
+        point = x->x_last_point;
     while(n--){
         t_sample f = *in++;
         t_sample val;
-        while((x->x_point > 0) && (f < x->x_durations[x->x_point-1]))
-            x->x_point--;
-        while((x->x_point <  x->x_last_point) && (x->x_durations[x->x_point] < f))
-            x->x_point++;
-        if(x->x_point == 0 || f >= x->x_durations[x->x_last_point])
-            val = x->x_points[x->x_point];
+        point = function_find(x, point, f);
+        if(point == 0 || f >= x->x_durations[x->x_last_point])
+            val = x->x_points[point];
         else
-            val = function_interpolate(x, f);
+            val = function_interpolate(x->x_segs + point, f);
         *out++ = val;
     }
+    x->x_point = point;
     return(w+5);
 }
 
@@ -114,6 +160,7 @@ static void function_init(t_function *x, int ac, t_atom* av){ // ???
 static void function_expi(t_function *x, t_floatarg f1, t_floatarg f2){
     int i = f1 < 0 ? 0 : (int)f1;
     SETFLOAT(x->x_at_exp+i, f2);
+    function_update(x);
 }
 
 static void function_expl(t_function *x, t_symbol *s, int ac, t_atom *av){
@@ -122,6 +169,7 @@ static void function_expl(t_function *x, t_symbol *s, int ac, t_atom *av){
     s = NULL;
     for(int i = 0; i < ac; i++)
         SETFLOAT(x->x_at_exp+i, (av+i)->a_w.w_float);
+    function_update(x);
 }
 
 static void function_norm_dur(t_function* x){ // normalize duration
@@ -136,6 +184,7 @@ static void function_exp(t_function *x, t_symbol *s, int ac, t_atom *av){
     x->x_exp = 1;
     function_init(x, ac, av);
     function_norm_dur(x);
+    function_update(x);
 }
 
 static void function_list(t_function *x,t_symbol* s, int ac,t_atom* av){
@@ -143,6 +192,7 @@ static void function_list(t_function *x,t_symbol* s, int ac,t_atom* av){
     x->x_exp = 0;
     function_init(x, ac, av);
     function_norm_dur(x);
+    function_update(x);
 }
 
 static void *function_new(t_symbol *s,int ac,t_atom* av){
@@ -154,6 +204,7 @@ static void *function_new(t_symbol *s,int ac,t_atom* av){
     x->x_exp = 0;
     x->x_points = getbytes(MAX_SIZE*sizeof(float));
     x->x_durations = getbytes(MAX_SIZE*sizeof(float));
+    x->x_segs = getbytes(MAX_SIZE*sizeof(t_function_seg));
     if(ac){
         if(av->a_type == A_SYMBOL){
             if(atom_getsymbolarg(0, ac, av) == gensym("-exp")){
@@ -178,6 +229,7 @@ static void *function_new(t_symbol *s,int ac,t_atom* av){
             goto errstate;
     }
     function_norm_dur(x);
+    function_update(x);
     outlet_new(&x->x_obj, gensym("signal"));
     return(x);
 errstate:
@@ -185,8 +237,14 @@ errstate:
     return(NULL);
 }
 
+static void function_free(t_function *x){
+    freebytes(x->x_points, MAX_SIZE*sizeof(float));
+    freebytes(x->x_durations, MAX_SIZE*sizeof(float));
+    freebytes(x->x_segs, MAX_SIZE*sizeof(t_function_seg));
+}
+
 void function_tilde_setup(void){
-    function_class = class_new(gensym("function~"), (t_newmethod)function_new, 0,
+    function_class = class_new(gensym("function~"), (t_newmethod)function_new, (t_method)function_free,
     	sizeof(t_function), 0, A_GIMME, 0);
     CLASS_MAINSIGNALIN(function_class, t_function, x_f);
     class_addmethod(function_class, (t_method)functionsig_dsp, gensym("dsp"), 0);
@@ -107,19 +107,23 @@ static inline float diffuser_do(t_diffuser *d, float f){
     if(PD_BADFLOAT(f)) f = 0.0f;
     float y = d->buf[d->idx] + f*d->coeff;
     d->buf[d->idx] = f;
-    d->idx = (d->idx + 1) % d->size;
+    if(++d->idx >= d->size) // no modulo, an integer division per access adds up here
+        d->idx = 0;
     return(y);
 }
 
 static inline float fixeddelay_read(t_fixeddelay *d, int n){
-    int i = (d->idx - n + d->size) % d->size;
+    int i = d->idx - n;
+    while(i < 0) // taps can be longer than the tap delay in large rooms
+        i += d->size;
     return(d->buf[i]);
 }
 
 static inline void fixeddelay_write(t_fixeddelay *d, float f){
     if(PD_BADFLOAT(f)) f = 0.0f;
     d->buf[d->idx] = f;
-    d->idx = (d->idx + 1) % d->size;
+    if(++d->idx >= d->size)
+        d->idx = 0;
 }
 
 static inline void damper_set(t_damper *d, float f){
@@ -134,7 +138,7 @@ static inline float damper_do(t_damper *d, float f){
 static inline void gverb_do(t_gverb *x, float in, float *l, float *r){
     float z;
     unsigned int i;
-    float lsum, rsum, sum, sign;
+    float lsum, rsum, sum;
     if(PD_BADFLOAT(in) || fabsf(in) > 100000.0f) in = 0.0f;
     z = damper_do(x->x_in_damper, in);
     z = diffuser_do(x->x_ldifs[0], z);
@@ -147,10 +151,9 @@ static inline void gverb_do(t_gverb *x, float in, float *l, float *r){
                                                            x->x_fdnlens[i]));
     }
     sum = 0.0f;
-    sign = 1.0f;
-    for(i = 0; i < 4; i++){
-        sum += sign*(x->x_late*x->x_d[i] + x->x_early*x->x_u[i]);
-        sign = -sign;
+    for(i = 0; i < 4; i += 2){ // alternating signs, without a multiply per line
+        sum += x->x_late*x->x_d[i] + x->x_early*x->x_u[i];
+        sum -= x->x_late*x->x_d[i+1] + x->x_early*x->x_u[i+1];
     }
     lsum = rsum = (sum += in*x->x_early);
     gverb_fdn_matrix(x->x_d, x->x_f);
@@ -51,8 +51,20 @@ typedef struct _keyboard{
     t_symbol      *x_snd_raw;
     t_symbol      *x_bindsym;
     t_outlet      *x_out;
+    // one bit per midi note, set when x_tgl_notes is. Only whole words are stored,
+    // so a GUI on another thread can read it without locking pd
+    unsigned int   x_notes[4];
 }t_keyboard;
 
+static int keyboard_set_tgl(t_keyboard* x, int note, int on){
+    x->x_tgl_notes[note] = on;
+    if(note >= 0 && note < 128){
+        unsigned int word = x->x_notes[note >> 5], bit = 1u << (note & 31);
+        x->x_notes[note >> 5] = on ? (word | bit) : (word & ~bit);
+    }
+    return(on);
+}
+
 /* ------------------------- Keyboard Play ------------------------------*/
 static void keyboard_note_on(t_keyboard* x, int note){
     int i = note - x->x_first_c;
@@ -144,7 +156,7 @@ static void keyboard_get_snd_rcv(t_keyboard* x){
 static void keyboard_play_tgl(t_keyboard* x, int note){
     int i = note - x->x_first_c;
     t_canvas *cv =  glist_getcanvas(x->x_glist);
-    int on = x->x_tgl_notes[note] = x->x_tgl_notes[note] ? 0 : 1;
+    int on = keyboard_set_tgl(x, note, x->x_tgl_notes[note] ? 0 : 1);
     short key = i % 12;
     if(key == 1 || key == 3 || key == 6 || key == 8 || key == 10) // black
         sys_vgui(".x%lx.c itemconfigure %xrrk%d -fill %s\n", cv, x, i, on ? BLACK_ON : BLACK_OFF);
@@ -351,7 +363,7 @@ void keyboard_float(t_keyboard *x, t_floatarg f){
         x->x_vel_in = 0;
     if(x->x_vel_in > 127)
         x->x_vel_in = 127;
-    int on = x->x_tgl_notes[note] = x->x_vel_in > 0;
+    int on = keyboard_set_tgl(x, note, x->x_vel_in > 0);
     t_atom at[2];
     SETFLOAT(at, note);
     SETFLOAT(at+1, x->x_vel_in);
@@ -382,7 +394,7 @@ static void keyboard_on(t_keyboard *x, t_symbol *s, int ac, t_atom *av){
 static void keyboard_set(t_keyboard *x, t_floatarg f1, t_floatarg f2){
     int note = (int)f1;
     x->x_vel_in = f2 < 0 ? 0 : f2 > 127 ? 127 : (int)f2;
-    int on = x->x_tgl_notes[note] = x->x_vel_in > 0;
+    int on = keyboard_set_tgl(x, note, x->x_vel_in > 0);
     if(x->x_glist->gl_havewindow){
         t_canvas *cv =  glist_getcanvas(x->x_glist);
         if(note >= x->x_first_c && note < x->x_first_c + (x->x_octaves * 12)){
@@ -519,7 +531,7 @@ static void keyboard_flush(t_keyboard* x){
                 sys_vgui(".x%lx.c itemconfigure %xrrk%d -fill %s\n", cv, x, i, black ? BLACK_OFF : c4 ? MIDDLE_C : WHITE_OFF);
             }
             SETFLOAT(at, note);
-            SETFLOAT(at+1, x->x_tgl_notes[note] = 0);
+            SETFLOAT(at+1, keyboard_set_tgl(x, note, 0));
             outlet_list(x->x_out, &s_list, 2, at);
             if(x->x_send != &s_ && x->x_send->s_thing)
                 pd_list(x->x_send->s_thing, &s_list, 2, at);
@@ -814,6 +826,8 @@ void * keyboard_new(t_symbol *s, int ac, t_atom* av){
     x->x_tgl_notes = getbytes(sizeof(int) * 256);
     for(int i = 0; i < 256; i++)
         x->x_tgl_notes[i] = 0;
+    for(int i = 0; i < 4; i++)
+        x->x_notes[i] = 0;
     x->x_out = outlet_new(&x->x_obj, &s_list);
     floatinlet_new(&x->x_obj, &x->x_vel_in);
     return(void *)x;
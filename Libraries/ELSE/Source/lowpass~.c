@@ -1,38 +1,51 @@
 // Porres 2017
 
 #include "m_pd.h"
+#include "biquad.h"
+#include "magic.h"
 #include <math.h>
 
 #define PI 3.14159265358979323846
 #define HALF_LOG2 log(2)/2
 
+typedef struct _lowpass_ch{ // filter state and coefficients of each channel
+    double      c_xnm1;
+    double      c_xnm2;
+    double      c_ynm1;
+    double      c_ynm2;
+    double      c_f;
+    double      c_reson;
+    double      c_a0;
+    double      c_a1;
+    double      c_a2;
+    double      c_b1;
+    double      c_b2;
+}t_lowpass_ch;
+
 typedef struct _lowpass{
-    t_object    x_obj;
-    t_int       x_n;
-    t_inlet    *x_inlet_freq;
-    t_inlet    *x_inlet_q;
-    t_outlet   *x_out;
-    t_float     x_nyq;
-    int         x_bypass;
-    int         x_bw;
-    double      x_xnm1;
-    double      x_xnm2;
-    double      x_ynm1;
-    double      x_ynm2;
-    double      x_f;
-    double      x_reson;
-    double      x_a0;
-    double      x_a1;
-    double      x_a2;
-    double      x_b1;
-    double      x_b2;
+    t_object        x_obj;
+    t_int           x_n;
+    t_inlet        *x_inlet_freq;
+    t_inlet        *x_inlet_q;
+    t_outlet       *x_out;
+    t_glist        *x_glist;
+    t_float        *x_freq_scalar; // NULL when a signal is connected
+    t_float        *x_q_scalar; // NULL when a signal is connected
+    t_float         x_nyq;
+    int             x_bypass;
+    int             x_rate; // samples between coefficient updates, they glide in between
+    int             x_bw;
+    int             x_nchans;
+    int             x_freq_nchans;
+    int             x_q_nchans;
+    t_lowpass_ch   *x_ch;
 }t_lowpass;
 
 static t_class *lowpass_class;
 
-static void update_coeffs(t_lowpass *x, double f, double reson){
-    x->x_f = f;
-    x->x_reson = reson;
+static void update_coeffs(t_lowpass *x, t_lowpass_ch *c, double f, double reson){
+    c->c_f = f;
+    c->c_reson = reson;
     double q;
     double omega = f * PI/x->x_nyq;
     if(x->x_bw){ // reson is bw in octaves
@@ -43,31 +56,53 @@ static void update_coeffs(t_lowpass *x, double f, double reson){
     else
         q = reson;
     if(q < 0.000001) // force bypass
-        x->x_a0 = 1, x->x_a2 = x->x_b1 = x->x_b2 = 0;
+        c->c_a0 = 1, c->c_a2 = c->c_b1 = c->c_b2 = 0;
     else{
         double alphaQ = sin(omega) / (2*q);
         double cos_w = cos(omega);
         double b0 = alphaQ + 1;
-        x->x_a0 = (1 - cos_w) / (2 * b0);
-        x->x_a1 = (1 - cos_w) / b0;
-        x->x_a2 = x->x_a0;
-        x->x_b1 = 2*cos_w / b0;
-        x->x_b2 = (alphaQ - 1) / b0;
+        c->c_a0 = (1 - cos_w) / (2 * b0);
+        c->c_a1 = (1 - cos_w) / b0;
+        c->c_a2 = c->c_a0;
+        c->c_b1 = 2*cos_w / b0;
+        c->c_b2 = (alphaQ - 1) / b0;
     }
 }
 
-static t_int *lowpass_perform(t_int *w){
-    t_lowpass *x = (t_lowpass *)(w[1]);
-    int nblock = (int)(w[2]);
-    t_float *in1 = (t_float *)(w[3]);
-    t_float *in2 = (t_float *)(w[4]);
-    t_float *in3 = (t_float *)(w[5]);
-    t_float *out = (t_float *)(w[6]);
-    double xnm1 = x->x_xnm1;
-    double xnm2 = x->x_xnm2;
-    double ynm1 = x->x_ynm1;
-    double ynm2 = x->x_ynm2;
+static void update_all_coeffs(t_lowpass *x){
+    for(int ch = 0; ch < x->x_nchans; ch++)
+        update_coeffs(x, &x->x_ch[ch], x->x_ch[ch].c_f, x->x_ch[ch].c_reson);
+}
+
+static void lowpass_run(t_lowpass *x, t_lowpass_ch *c, int nblock, t_float *in1,
+t_float *in2, t_float *in3, t_float *out){
+    double xnm1 = c->c_xnm1;
+    double xnm2 = c->c_xnm2;
+    double ynm1 = c->c_ynm1;
+    double ynm2 = c->c_ynm2;
     t_float nyq = x->x_nyq;
+    if(x->x_rate > 1 && !x->x_bypass){ // coefficients are worked out every x_rate samples
+        t_biquad b = {xnm1, xnm2, ynm1, ynm2};
+        for(int i = 0; i < nblock; i += x->x_rate){
+            int n = nblock - i < x->x_rate ? nblock - i : x->x_rate;
+            double f = in2[i+n-1], reson = in3[i+n-1];
+            if(f < 0.000001)
+                f = 0.000001;
+            if(f > nyq - 0.000001)
+                f = nyq - 0.000001;
+            double from[biquad_NCOEFS] = {c->c_b1, c->c_b2, c->c_a0, c->c_a1, c->c_a2};
+            if(f != c->c_f || reson != c->c_reson){
+                update_coeffs(x, c, f, reson);
+                double to[biquad_NCOEFS] = {c->c_b1, c->c_b2, c->c_a0, c->c_a1, c->c_a2};
+                biquad_ramp(&b, from, to, in1 + i, out + i, n);
+            }
+            else
+                biquad_run(&b, from, in1 + i, out + i, n);
+        }
+        c->c_xnm1 = b.b_xnm1, c->c_xnm2 = b.b_xnm2;
+        c->c_ynm1 = b.b_ynm1, c->c_ynm2 = b.b_ynm2;
+        return;
+    }
     while (nblock--){
         double xn = *in1++, f = *in2++, reson = *in3++, yn;
         if(f < 0.000001)
@@ -77,9 +112,9 @@ static t_int *lowpass_perform(t_int *w){
         if(x->x_bypass)
             *out++ = xn;
         else{
-            if(f != x->x_f || reson != x->x_reson)
-                update_coeffs(x, (double)f, (double)reson);
-            yn = x->x_a0 * xn + x->x_a1 * xnm1 + x->x_a2 * xnm2 + x->x_b1 * ynm1 + x->x_b2 * ynm2;
+            if(f != c->c_f || reson != c->c_reson)
+                update_coeffs(x, c, (double)f, (double)reson);
+            yn = c->c_a0 * xn + c->c_a1 * xnm1 + c->c_a2 * xnm2 + c->c_b1 * ynm1 + c->c_b2 * ynm2;
             *out++ = yn;
             xnm2 = xnm1;
             xnm1 = xn;
@@ -87,39 +122,117 @@ static t_int *lowpass_perform(t_int *w){
             ynm1 = yn;
         }
     }
-    x->x_xnm1 = xnm1;
-    x->x_xnm2 = xnm2;
-    x->x_ynm1 = ynm1;
-    x->x_ynm2 = ynm2;
+    c->c_xnm1 = xnm1;
+    c->c_xnm2 = xnm2;
+    c->c_ynm1 = ynm1;
+    c->c_ynm2 = ynm2;
+}
+
+// one call for all channels, a control inlet with fewer channels is reused for the rest
+static t_int *lowpass_perform(t_int *w){
+    t_lowpass *x = (t_lowpass *)(w[1]);
+    int nblock = (int)(w[2]);
+    t_float *in1 = (t_float *)(w[3]);
+    t_float *in2 = (t_float *)(w[4]);
+    t_float *in3 = (t_float *)(w[5]);
+    t_float *out = (t_float *)(w[6]);
+    for(int ch = 0; ch < x->x_nchans; ch++){
+        lowpass_run(x, &x->x_ch[ch], nblock, in1 + ch*nblock,
+            in2 + (ch % x->x_freq_nchans)*nblock, in3 + (ch % x->x_q_nchans)*nblock,
+            out + ch*nblock);
+    }
     return(w+7);
 }
 
+// the parameters have no signal connected, so they're read once per block
+static t_int *lowpass_perform_scalar(t_int *w){
+    t_lowpass *x = (t_lowpass *)(w[1]);
+    int nblock = (int)(w[2]);
+    t_float *in = (t_float *)(w[3]);
+    t_float *out = (t_float *)(w[4]);
+    int n = x->x_nchans * nblock;
+    if(x->x_bypass){
+        if(in != out)
+            for(int i = 0; i < n; i++)
+                out[i] = in[i];
+        return(w+5);
+    }
+    t_float nyq = x->x_nyq;
+    double f = *x->x_freq_scalar, reson = *x->x_q_scalar;
+    if(f < 0.000001)
+        f = 0.000001;
+    if(f > nyq - 0.000001)
+        f = nyq - 0.000001;
+    for(int ch = 0; ch < x->x_nchans; ch++){
+        t_lowpass_ch *c = &x->x_ch[ch];
+        double from[biquad_NCOEFS] = {c->c_b1, c->c_b2, c->c_a0, c->c_a1, c->c_a2};
+        int changed = f != c->c_f || reson != c->c_reson;
+        if(changed)
+            update_coeffs(x, c, f, reson);
+        double to[biquad_NCOEFS] = {c->c_b1, c->c_b2, c->c_a0, c->c_a1, c->c_a2};
+        t_biquad b = {c->c_xnm1, c->c_xnm2, c->c_ynm1, c->c_ynm2};
+        biquad_block(&b, from, changed ? to : NULL, x->x_rate, in + ch*nblock, out + ch*nblock, nblock);
+        c->c_xnm1 = b.b_xnm1, c->c_xnm2 = b.b_xnm2;
+        c->c_ynm1 = b.b_ynm1, c->c_ynm2 = b.b_ynm2;
+    }
+    return(w+5);
+}
+
+static void lowpass_resize(t_lowpass *x, int nchans){
+    x->x_ch = (t_lowpass_ch *)resizebytes(x->x_ch,
+        x->x_nchans * sizeof(t_lowpass_ch), nchans * sizeof(t_lowpass_ch));
+    for(int ch = x->x_nchans; ch < nchans; ch++){ // new channels start like the first one
+        x->x_ch[ch] = x->x_ch[0];
+        x->x_ch[ch].c_xnm1 = x->x_ch[ch].c_xnm2 = 0.;
+        x->x_ch[ch].c_ynm1 = x->x_ch[ch].c_ynm2 = 0.;
+    }
+    x->x_nchans = nchans;
+}
+
 static void lowpass_dsp(t_lowpass *x, t_signal **sp){
+    int nchans = magic_nchans(sp[0]);
+    if(nchans != x->x_nchans)
+        lowpass_resize(x, nchans);
+    x->x_freq_nchans = magic_nchans(sp[1]);
+    x->x_q_nchans = magic_nchans(sp[2]);
+    magic_setmultiout(&sp[3], nchans);
     t_float nyq = sp[0]->s_sr / 2;
     if(nyq != x->x_nyq){
         x->x_nyq = nyq;
-        update_coeffs(x, x->x_f, x->x_reson);
+        update_all_coeffs(x);
     }
-    dsp_add(lowpass_perform, 6, x, sp[0]->s_n, sp[0]->s_vec,
+    x->x_freq_scalar = magic_inlet_scalar((t_object *)x, x->x_glist, 1);
+    x->x_q_scalar = magic_inlet_scalar((t_object *)x, x->x_glist, 2);
+    if(x->x_freq_scalar && x->x_q_scalar)
+        dsp_add(lowpass_perform_scalar, 4, x, sp[0]->s_n, sp[0]->s_vec, sp[3]->s_vec);
+    else
+        dsp_add(lowpass_perform, 6, x, sp[0]->s_n, sp[0]->s_vec,
             sp[1]->s_vec, sp[2]->s_vec, sp[3]->s_vec);
 }
 
 static void lowpass_clear(t_lowpass *x){
-    x->x_xnm1 = x->x_xnm2 = x->x_ynm1 = x->x_ynm2 = 0.;
+    for(int ch = 0; ch < x->x_nchans; ch++){
+        x->x_ch[ch].c_xnm1 = x->x_ch[ch].c_xnm2 = 0.;
+        x->x_ch[ch].c_ynm1 = x->x_ch[ch].c_ynm2 = 0.;
+    }
 }
 
 static void lowpass_bypass(t_lowpass *x, t_floatarg f){
     x->x_bypass = (int)(f != 0);
 }
 
+static void lowpass_rate(t_lowpass *x, t_floatarg f){
+    x->x_rate = f < 1 ? 1 : (int)f;
+}
+
 static void lowpass_bw(t_lowpass *x){
     x->x_bw = 1;
-    update_coeffs(x, x->x_f, x->x_reson);
+    update_all_coeffs(x);
 }
 
 static void lowpass_q(t_lowpass *x){
     x->x_bw = 0;
-    update_coeffs(x, x->x_f, x->x_reson);
+    update_all_coeffs(x);
 }
 
 static void *lowpass_new(t_symbol *s, int argc, t_atom *argv){
@@ -157,8 +270,11 @@ static void *lowpass_new(t_symbol *s, int argc, t_atom *argv){
             goto errstate;
     };
     x->x_bw = bw;
+    x->x_glist = canvas_getcurrent();
     x->x_nyq = sys_getsr()/2;
-    update_coeffs(x, (double)freq, (double)reson);
+    x->x_ch = (t_lowpass_ch *)getbytes(sizeof(t_lowpass_ch));
+    x->x_nchans = x->x_freq_nchans = x->x_q_nchans = 1;
+    update_coeffs(x, x->x_ch, (double)freq, (double)reson);
     x->x_inlet_freq = inlet_new((t_object *)x, (t_pd *)x, &s_signal, &s_signal);
     pd_float((t_pd *)x->x_inlet_freq, freq);
     x->x_inlet_q = inlet_new((t_object *)x, (t_pd *)x, &s_signal, &s_signal);
@@ -170,13 +286,18 @@ errstate:
     return(NULL);
 }
 
+static void lowpass_free(t_lowpass *x){
+    freebytes(x->x_ch, x->x_nchans * sizeof(t_lowpass_ch));
+}
+
 void lowpass_tilde_setup(void){
-    lowpass_class = class_new(gensym("lowpass~"), (t_newmethod)lowpass_new, 0,
-        sizeof(t_lowpass), CLASS_DEFAULT, A_GIMME, 0);
+    lowpass_class = class_new(gensym("lowpass~"), (t_newmethod)lowpass_new,
+        (t_method)lowpass_free, sizeof(t_lowpass), CLASS_DEFAULT | MAGIC_MULTICHANNEL, A_GIMME, 0);
     class_addmethod(lowpass_class, (t_method)lowpass_dsp, gensym("dsp"), A_CANT, 0);
     class_addmethod(lowpass_class, nullfn, gensym("signal"), 0);
     class_addmethod(lowpass_class, (t_method)lowpass_clear, gensym("clear"), 0);
     class_addmethod(lowpass_class, (t_method)lowpass_bypass, gensym("bypass"), A_DEFFLOAT, 0);
+    class_addmethod(lowpass_class, (t_method)lowpass_rate, gensym("rate"), A_FLOAT, 0);
     class_addmethod(lowpass_class, (t_method)lowpass_bw, gensym("bw"), 0);
     class_addmethod(lowpass_class, (t_method)lowpass_q, gensym("q"), 0);
 }
@@ -1,6 +1,8 @@
 // Porres 2017
 
 #include "m_pd.h"
+#include "biquad.h"
+#include "magic.h"
 #include <math.h>
 
 #define PI 3.14159265358979323846
@@ -12,8 +14,13 @@ typedef struct _lowshelf {
     t_inlet    *x_inlet_q;
     t_inlet    *x_inlet_amp;
     t_outlet   *x_out;
+    t_glist    *x_glist;
+    t_float    *x_freq_scalar; // NULL when a signal is connected
+    t_float    *x_q_scalar; // NULL when a signal is connected
+    t_float    *x_amp_scalar; // NULL when a signal is connected
     t_float     x_nyq;
     int     x_bypass;
+    int     x_rate; // samples between coefficient updates, they glide in between
     double  x_xnm1;
     double  x_xnm2;
     double  x_ynm1;
@@ -59,6 +66,32 @@ static t_int *lowshelf_perform(t_int *w){
     double ynm1 = x->x_ynm1;
     double ynm2 = x->x_ynm2;
     t_float nyq = x->x_nyq;
+    if(x->x_rate > 1 && !x->x_bypass){ // coefficients are worked out every x_rate samples
+        t_biquad b = {xnm1, xnm2, ynm1, ynm2};
+        for(int i = 0; i < nblock; i += x->x_rate){
+            int n = nblock - i < x->x_rate ? nblock - i : x->x_rate;
+            double f = in2[i+n-1], slope = in3[i+n-1], db = in4[i+n-1];
+            if(f < 0.1)
+                f = 0.1;
+            if(f > nyq - 0.1)
+                f = nyq - 0.1;
+            if(slope < 0.000001)
+                slope = 0.000001;
+            if(slope > 1)
+                slope = 1;
+            double from[biquad_NCOEFS] = {x->x_b1, x->x_b2, x->x_a0, x->x_a1, x->x_a2};
+            if(f != x->x_f || slope != x->x_slope || db != x->x_db){
+                update_coeffs(x, f, slope, db);
+                double to[biquad_NCOEFS] = {x->x_b1, x->x_b2, x->x_a0, x->x_a1, x->x_a2};
+                biquad_ramp(&b, from, to, in1 + i, out + i, n);
+            }
+            else
+                biquad_run(&b, from, in1 + i, out + i, n);
+        }
+        x->x_xnm1 = b.b_xnm1, x->x_xnm2 = b.b_xnm2;
+        x->x_ynm1 = b.b_ynm1, x->x_ynm2 = b.b_ynm2;
+        return(w+8);
+    }
     while (nblock--){
         double xn = *in1++, f = *in2++, slope = *in3++, db = *in4++, yn;
         if(x->x_bypass)
@@ -89,13 +122,53 @@ static t_int *lowshelf_perform(t_int *w){
     return(w+8);
 }
 
+// the parameters have no signal connected, so they're read once per block
+static t_int *lowshelf_perform_scalar(t_int *w){
+    t_lowshelf *x = (t_lowshelf *)(w[1]);
+    int nblock = (int)(w[2]);
+    t_float *in = (t_float *)(w[3]);
+    t_float *out = (t_float *)(w[4]);
+    if(x->x_bypass){
+        if(in != out)
+            for(int i = 0; i < nblock; i++)
+                out[i] = in[i];
+        return(w+5);
+    }
+    t_float nyq = x->x_nyq;
+    double f = *x->x_freq_scalar, slope = *x->x_q_scalar, db = *x->x_amp_scalar;
+    if(f < 0.1)
+        f = 0.1;
+    if(f > nyq - 0.1)
+        f = nyq - 0.1;
+    if(slope < 0.000001)
+        slope = 0.000001;
+    if(slope > 1)
+        slope = 1;
+    double from[biquad_NCOEFS] = {x->x_b1, x->x_b2, x->x_a0, x->x_a1, x->x_a2};
+    int changed = f != x->x_f || slope != x->x_slope || db != x->x_db;
+    if(changed)
+        update_coeffs(x, f, slope, db);
+    double to[biquad_NCOEFS] = {x->x_b1, x->x_b2, x->x_a0, x->x_a1, x->x_a2};
+    t_biquad b = {x->x_xnm1, x->x_xnm2, x->x_ynm1, x->x_ynm2};
+    biquad_block(&b, from, changed ? to : NULL, x->x_rate, in, out, nblock);
+    x->x_xnm1 = b.b_xnm1, x->x_xnm2 = b.b_xnm2;
+    x->x_ynm1 = b.b_ynm1, x->x_ynm2 = b.b_ynm2;
+    return(w+5);
+}
+
 static void lowshelf_dsp(t_lowshelf *x, t_signal **sp){
     t_float nyq = sp[0]->s_sr / 2;
     if(nyq != x->x_nyq){
         x->x_nyq = nyq;
         update_coeffs(x, x->x_f, x->x_slope, x->x_db);
     }
-    dsp_add(lowshelf_perform, 7, x, sp[0]->s_n, sp[0]->s_vec,
+    x->x_freq_scalar = magic_inlet_scalar((t_object *)x, x->x_glist, 1);
+    x->x_q_scalar = magic_inlet_scalar((t_object *)x, x->x_glist, 2);
+    x->x_amp_scalar = magic_inlet_scalar((t_object *)x, x->x_glist, 3);
+    if(x->x_freq_scalar && x->x_q_scalar && x->x_amp_scalar)
+        dsp_add(lowshelf_perform_scalar, 4, x, sp[0]->s_n, sp[0]->s_vec, sp[4]->s_vec);
+    else
+        dsp_add(lowshelf_perform, 7, x, sp[0]->s_n, sp[0]->s_vec,
             sp[1]->s_vec, sp[2]->s_vec, sp[3]->s_vec, sp[4]->s_vec);
 }
 
@@ -109,6 +182,11 @@ static void lowshelf_bypass(t_lowshelf *x, t_floatarg f)
     x->x_bypass = (int)(f != 0);
 }
 
+static void lowshelf_rate(t_lowshelf *x, t_floatarg f)
+{
+    x->x_rate = f < 1 ? 1 : (int)f;
+}
+
 static void *lowshelf_new(t_symbol *s, int argc, t_atom *argv)
 {
     s = NULL;
@@ -136,6 +214,7 @@ static void *lowshelf_new(t_symbol *s, int argc, t_atom *argv)
         else if(argv -> a_type == A_SYMBOL)
             goto errstate;
     };
+    x->x_glist = canvas_getcurrent();
     x->x_nyq = sys_getsr()/2;
     update_coeffs(x, freq, slope, db);
     x->x_inlet_freq = inlet_new((t_object *)x, (t_pd *)x, &s_signal, &s_signal);
@@ -159,4 +238,5 @@ void lowshelf_tilde_setup(void)
     class_addmethod(lowshelf_class, nullfn, gensym("signal"), 0);
     class_addmethod(lowshelf_class, (t_method)lowshelf_clear, gensym("clear"), 0);
     class_addmethod(lowshelf_class, (t_method)lowshelf_bypass, gensym("bypass"), A_DEFFLOAT, 0);
+    class_addmethod(lowshelf_class, (t_method)lowshelf_rate, gensym("rate"), A_FLOAT, 0);
 }
@@ -5,6 +5,20 @@
 
 static t_class *median_class;
 
+// Sliding window median, one output per input sample. The window is kept in a ring buffer and
+// in a single heap array centered on the median: positive indexes are a min heap of the larger
+// half, negative ones a max heap of the smaller half. Every ring entry knows its heap position,
+// so the oldest sample is replaced in place and only sifted, that's O(log w) per sample.
+typedef struct _slider{
+    t_float     *data;      // ring buffer of the window
+    int         *pos;       // heap position of every ring entry
+    int         *heap;      // ring indexes, centered on the median
+    int         *heapbuf;
+    int          size;
+    int          idx;       // next ring entry to replace
+    int          count;     // number of samples so far, until the window is full
+}t_slider;
+
 typedef struct _median {
     t_object     x_obj;
     t_inlet     *median;
@@ -12,6 +26,8 @@ typedef struct _median {
     t_float     *x_temp;
     t_int        x_block_size;
     t_outlet    *x_outlet;
+    int          x_slide;
+    t_slider     x_slider;
 }t_median;
 
 void median_sort(t_float *a, int n) {
@@ -44,11 +60,158 @@ t_float median_calculate(t_float * array, int begin, int end){
     return(median);
 }
 
+static void slider_free(t_slider *s){
+    free(s->data);
+    free(s->pos);
+    free(s->heapbuf);
+    s->data = NULL;
+    s->pos = s->heapbuf = s->heap = NULL;
+    s->size = 0;
+}
+
+// starts an empty window, positions are handed out alternating between both heaps
+static void slider_reset(t_slider *s){
+    s->idx = s->count = 0;
+    for(int i = s->size - 1; i >= 0; i--){
+        s->pos[i] = ((i + 1) / 2) * ((i & 1) ? -1 : 1);
+        s->heap[s->pos[i]] = i;
+    }
+}
+
+static int slider_resize(t_slider *s, int size){
+    if(size == s->size)
+        return(1);
+    slider_free(s);
+    s->data = (t_float *)calloc(size, sizeof(t_float));
+    s->pos = (int *)malloc(size * sizeof(int));
+    s->heapbuf = (int *)malloc(size * sizeof(int));
+    if(!s->data || !s->pos || !s->heapbuf){
+        slider_free(s);
+        return(0);
+    }
+    s->size = size;
+    s->heap = s->heapbuf + size / 2;
+    slider_reset(s);
+    return(1);
+}
+
+static int slider_mincount(t_slider *s){
+    return((s->count - 1) / 2);
+}
+
+static int slider_maxcount(t_slider *s){
+    return(s->count / 2);
+}
+
+// swaps heap entries i and j if the value at i is less than the one at j
+static int slider_exchange(t_slider *s, int i, int j){
+    int ri = s->heap[i], rj = s->heap[j];
+    if(!(s->data[ri] < s->data[rj]))
+        return(0);
+    s->heap[i] = rj;
+    s->heap[j] = ri;
+    s->pos[rj] = i;
+    s->pos[ri] = j;
+    return(1);
+}
+
+// moves entry i of the min heap down, while it's larger than one of its children
+static void slider_minsortdown(t_slider *s, int i){
+    int n = slider_mincount(s);
+    for(int c = 2 * i; c <= n; c = 2 * i){
+        if(c < n && s->data[s->heap[c + 1]] < s->data[s->heap[c]])
+            c++;
+        if(!slider_exchange(s, c, i))
+            break;
+        i = c;
+    }
+}
+
+static void slider_maxsortdown(t_slider *s, int i){
+    int n = slider_maxcount(s);
+    for(int c = 2 * i; c >= -n; c = 2 * i){
+        if(c > -n && s->data[s->heap[c]] < s->data[s->heap[c - 1]])
+            c--;
+        if(!slider_exchange(s, i, c))
+            break;
+        i = c;
+    }
+}
+
+// returns 1 if the entry made it to the median
+static int slider_minsortup(t_slider *s, int i){
+    while(i > 0 && slider_exchange(s, i, i / 2))
+        i /= 2;
+    return(i == 0);
+}
+
+static int slider_maxsortup(t_slider *s, int i){
+    while(i < 0 && slider_exchange(s, i / 2, i))
+        i /= 2;
+    return(i == 0);
+}
+
+// replaces the oldest sample of the window by f
+static void slider_insert(t_slider *s, t_float f){
+    int isnew = s->count < s->size;
+    int p = s->pos[s->idx];
+    t_float old = s->data[s->idx];
+    s->data[s->idx] = f;
+    if(++s->idx == s->size)
+        s->idx = 0;
+    s->count += isnew;
+    // when the median changes, it can belong into the other heap
+    if(p > 0){ // in the min heap
+        if(!isnew && old < f)
+            slider_minsortdown(s, p);
+        else if(slider_minsortup(s, p) && slider_maxcount(s) && slider_exchange(s, 0, -1))
+            slider_maxsortdown(s, -1);
+    }
+    else if(p < 0){ // in the max heap
+        if(!isnew && f < old)
+            slider_maxsortdown(s, p);
+        else if(slider_maxsortup(s, p) && slider_mincount(s) && slider_exchange(s, 1, 0))
+            slider_minsortdown(s, 1);
+    }
+    else{ // at the median
+        if(slider_maxcount(s) && slider_exchange(s, 0, -1))
+            slider_maxsortdown(s, -1);
+        else if(slider_mincount(s) && slider_exchange(s, 1, 0))
+            slider_minsortdown(s, 1);
+    }
+}
+
+static t_float slider_median(t_slider *s){
+    t_float median = s->data[s->heap[0]];
+    if((s->count & 1) == 0)
+        median = (median + s->data[s->heap[-1]]) / 2.0f;
+    return(median);
+}
+
+static void median_slide_perform(t_median *x, int n, t_float *in1, t_float *out1){
+    t_slider *s = &x->x_slider;
+    int size = x->x_samples < 1 ? 1 : (int)x->x_samples;
+    // the window is resized outside of perform, it's only different if that failed
+    if(size != s->size){
+        for(int i = 0; i < n; i++)
+            out1[i] = 0;
+        return;
+    }
+    for(int i = 0; i < n; i++){
+        slider_insert(s, in1[i]);
+        out1[i] = slider_median(s);
+    }
+}
+
 static t_int * median_perform(t_int *w){
     t_median *x = (t_median *)(w[1]);
     t_int n = (int)(w[2]);
     t_float *in1 = (t_float *)(w[3]);
     t_float *out1 = (t_float *)(w[4]);
+    if(x->x_slide){
+        median_slide_perform(x, n, in1, out1);
+        return(w+5);
+    }
     int i = 0;
     for(i = 0 ; i < n ; i++)
         x->x_temp[i] = in1[i];
@@ -70,32 +233,81 @@ static t_int * median_perform(t_int *w){
     return(w+5);
 }
 
+// allocates the sliding window for the current size, a new size starts over
+static void median_window(t_median *x){
+    if(x->x_slide){
+        int size = x->x_samples < 1 ? 1 : (int)x->x_samples;
+        if(!slider_resize(&x->x_slider, size))
+            pd_error(x, "[median~]: couldn't allocate a window of %d samples", size);
+    }
+}
+
+static void median_size(t_median *x, t_floatarg f){
+    x->x_samples = f;
+    median_window(x);
+}
+
+static void median_slide(t_median *x, t_floatarg f){
+    int slide = f != 0;
+    if(slide && !x->x_slide && x->x_slider.size)
+        slider_reset(&x->x_slider);
+    x->x_slide = slide;
+    median_window(x);
+}
+
+static void median_clear(t_median *x){
+    if(x->x_slider.size){
+        for(int i = 0; i < x->x_slider.size; i++)
+            x->x_slider.data[i] = 0;
+        slider_reset(&x->x_slider);
+    }
+}
+
 static void median_dsp(t_median *x, t_signal **sp){
     t_int block = (t_int)sp[0]->s_n;
     if(block != x->x_block_size){
         x->x_block_size = block;
         x->x_temp = realloc(x->x_temp, sizeof(t_float)*x->x_block_size);
     }
+    median_window(x);
     dsp_add(median_perform, 4, x, sp[0]->s_n, sp[0]->s_vec, sp[1]->s_vec);
 }
 
 void median_free(t_median *x){
     free(x->x_temp);
+    slider_free(&x->x_slider);
 }
 
-void * median_new(t_floatarg f) {
+void * median_new(t_symbol *s, int ac, t_atom *av){
     t_median *x = (t_median *) pd_new(median_class);
+    t_float f = 1;
+    x->x_slide = 0;
+    while(ac){
+        if(av->a_type == A_SYMBOL && atom_getsymbol(av) == gensym("-slide"))
+            x->x_slide = 1;
+        else if(av->a_type == A_FLOAT)
+            f = atom_getfloat(av);
+        else
+            goto errstate;
+        ac--, av++;
+    }
     x->x_samples = (f < 1) ? 1 : f;
     x->x_block_size = 64;
     x->x_temp = (t_float *)malloc(x->x_block_size * sizeof(t_float));
     x->x_outlet = outlet_new(&x->x_obj, &s_signal); // outlet
-    floatinlet_new(&x->x_obj, &x->x_samples);
+    inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_float, gensym("size"));
     return(void *)x;
+errstate:
+    pd_error(x, "[median~]: improper args");
+    return(NULL);
 }
 
 void median_tilde_setup(void) {
     median_class = class_new(gensym("median~"), (t_newmethod) median_new,
-        (t_method) median_free, sizeof (t_median), 0, A_DEFFLOAT, 0);
+        (t_method) median_free, sizeof (t_median), 0, A_GIMME, 0);
     class_addmethod(median_class, nullfn, gensym("signal"), 0);
     class_addmethod(median_class, (t_method) median_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(median_class, (t_method) median_slide, gensym("slide"), A_FLOAT, 0);
+    class_addmethod(median_class, (t_method) median_size, gensym("size"), A_FLOAT, 0);
+    class_addmethod(median_class, (t_method) median_clear, gensym("clear"), 0);
 }
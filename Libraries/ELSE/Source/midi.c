@@ -8,6 +8,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "m_pd.h"
 #include "elsefile.h"
 #include "mifi.h"
@@ -23,6 +24,7 @@
 #define MIDI_TEMPOEPSILON          .0001   // if inside: pause
 #define MIDI_ISRUNNING(x) ((x)->x_prevtime > (double).0001)
 #define MIDI_ISPAUSED(x) ((x)->x_prevtime <= (double).0001)
+#define MIDI_FOLLOWSLACK           50.     // ms the host may be off before we locate
 
 enum{MIDI_IDLEMODE, MIDI_RECMODE, MIDI_PLAYMODE, MIDI_SLAVEMODE};
 
@@ -65,6 +67,11 @@ typedef struct _midi{
     int            x_ntempi;        /* as used */
     t_miditempo    *x_tempomap;
     t_miditempo     x_tempomapini[MIDI_INITEMPOMAPSIZE];
+    double        *x_times;      // ms of each event from the start, for seeking
+    int            x_timessize;  // as allocated
+    int            x_timesvalid; // cleared whenever the sequence changes
+    struct _midifollow *x_follow; // bound to "playhead" while following the host
+    double         x_hostms;     // the host's last position
     t_clock       *x_clock;
     t_clock       *x_slaveclock;
     t_outlet      *x_bangout;
@@ -75,7 +82,13 @@ typedef struct _midi{
     unsigned char  x_notes[16][128]; // [channels][pitches]
 }t_midi;
 
+typedef struct _midifollow{ // receives the host's playhead for a [midi]
+    t_pd     f_pd;
+    t_midi  *f_owner;
+}t_midifollow;
+
 static t_class *midi_class;
+static t_class *midifollow_class;
 
 static void panic_input(t_midi *x, t_float f){
     if(f >= 0 && f < 256){
@@ -174,9 +187,11 @@ int inisize, void *bufini, size_t typesize){
 
 static void midi_clear(t_midi *x){
     x->x_nevents = x->x_ntempi = 0;
+    x->x_timesvalid = 0;
 }
 
 static int midi_dogrowing(t_midi *x, int nevents, int ntempi){
+    x->x_timesvalid = 0;
     if(nevents > x->x_midisize){
         int nrequested = nevents;
         x->x_sequence = grow_nodata(&nrequested, &x->x_midisize, x->x_sequence,
@@ -216,6 +231,7 @@ static void midi_complete(t_midi *x){
         if(x->x_evelength < 4)
             ep->e_bytes[x->x_evelength] = MIDI_META;
         x->x_nevents++;
+        x->x_timesvalid = 0;
         if(x->x_nevents >= x->x_midisize){
             int nexisting = x->x_midisize;
         // store-ahead scheme, LATER consider using x_currevent
@@ -584,37 +600,123 @@ static void midi_clocktick(t_midi *x){
     }
 }
 
-/*static void midi_goto(t_midi *x, t_floatarg f){ // takes time in seconds
-     if(x->x_nevents){
-         t_midievent *ev;
-         int ndx, nevents = x->x_nevents;
-         double ms = (double)f * 1000., sum;
-         if(ms <= MIDI_TICKEPSILON)
-             ms = 0.;
-         if(x->x_mode != MIDI_PLAYMODE){
-             midi_settimescale(x, x->x_timescale);
-             midi_setmode(x, MIDI_PLAYMODE);
-             // clock_delay() has been called in setmode, LATER avoid
-             clock_unset(x->x_clock);
-             x->x_prevtime = 0.;
-         }
-         for(ndx = 0, ev = x->x_sequence, sum = MIDI_TICKEPSILON; ndx < nevents; ndx++, ev++){
-             if((sum += ev->e_delta) >= ms){
-                 x->x_playhead = ndx;
-                 x->x_nextscoretime = sum;
-                 x->x_clockdelay = sum - MIDI_TICKEPSILON - ms;
-                 if(x->x_clockdelay < 0.)
-                     x->x_clockdelay = 0.;
-                 if(MIDI_ISRUNNING(x)){
-                     clock_delay(x->x_clock, x->x_clockdelay);
-                     x->x_prevtime = clock_getlogicaltime();
-                 }
-                 break;
-             }
-         }
-     }
- }*/
- 
+// the time of every event from the start, rebuilt after the sequence changed
+static double *midi_gettimes(t_midi *x){
+    if(!x->x_timesvalid){
+        if(x->x_nevents > x->x_timessize){
+            int newsize = x->x_nevents;
+            if(x->x_times)
+                x->x_times = resizebytes(x->x_times, x->x_timessize * sizeof(*x->x_times), newsize * sizeof(*x->x_times));
+            else
+                x->x_times = getbytes(newsize * sizeof(*x->x_times));
+            x->x_timessize = newsize;
+        }
+        double sum = 0.;
+        for(int i = 0; i < x->x_nevents; i++)
+            x->x_times[i] = sum += x->x_sequence[i].e_delta;
+        x->x_timesvalid = 1;
+    }
+    return(x->x_times);
+}
+
+// ms from the start that playback has reached
+static double midi_getms(t_midi *x){
+    if(x->x_mode != MIDI_PLAYMODE || !x->x_nevents)
+        return(0.);
+    double remaining = x->x_clockdelay;
+    if(MIDI_ISRUNNING(x))
+        remaining -= clock_gettimesince(x->x_prevtime);
+    return(x->x_nextscoretime - remaining / x->x_timescale);
+}
+
+// moves playback to ms from the start without sending what's skipped, paused if it wasn't playing
+static void midi_locate(t_midi *x, double ms){
+    if(!x->x_nevents)
+        return;
+    if(ms < 0.)
+        ms = 0.;
+    if(x->x_mode == MIDI_PLAYMODE)
+        midi_panic(x);
+    else{
+        midi_settimescale(x, x->x_timescale);
+        midi_setmode(x, MIDI_PLAYMODE);
+        clock_unset(x->x_clock); // started by setmode
+        x->x_prevtime = 0.;
+    }
+    double *times = midi_gettimes(x);
+    int lo = 0, hi = x->x_nevents; // the first event at or after ms
+    while(lo < hi){
+        int mid = lo + (hi - lo) / 2;
+        if(times[mid] < ms - MIDI_TICKEPSILON)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if(lo == x->x_nevents){ // past the end
+        midi_setmode(x, MIDI_IDLEMODE);
+        return;
+    }
+    x->x_playhead = lo;
+    x->x_nextscoretime = times[lo];
+    x->x_clockdelay = (times[lo] - ms) * x->x_timescale;
+    if(x->x_clockdelay < 0.)
+        x->x_clockdelay = 0.;
+    if(MIDI_ISRUNNING(x)){
+        clock_delay(x->x_clock, x->x_clockdelay);
+        x->x_prevtime = clock_getlogicaltime();
+    }
+}
+
+static void midi_goto(t_midi *x, t_floatarg f){ // takes time in seconds
+    midi_locate(x, (double)f * 1000.);
+}
+
+// [r playhead] position: ppq, samples, seconds. Only jumps are followed, so a
+// locate or a scrub in the host doesn't make us catch up on what's in between
+static void midifollow_position(t_midifollow *f, t_symbol *s, int ac, t_atom *av){
+    t_midi *x = f->f_owner;
+    s = NULL;
+    x->x_hostms = atom_getfloatarg(2, ac, av) * 1000.;
+    if(x->x_mode == MIDI_PLAYMODE){
+        double diff = midi_getms(x) - x->x_hostms;
+        if(diff > MIDI_FOLLOWSLACK || diff < -MIDI_FOLLOWSLACK)
+            midi_locate(x, x->x_hostms);
+    }
+}
+
+static void midifollow_playing(t_midifollow *f, t_floatarg playing){
+    t_midi *x = f->f_owner;
+    if(playing != 0){
+        if(x->x_mode != MIDI_PLAYMODE || fabs(midi_getms(x) - x->x_hostms) > MIDI_FOLLOWSLACK)
+            midi_locate(x, x->x_hostms);
+        if(x->x_mode == MIDI_PLAYMODE && MIDI_ISPAUSED(x)){
+            clock_delay(x->x_clock, x->x_clockdelay);
+            x->x_prevtime = clock_getlogicaltime();
+        }
+    }
+    else if(x->x_mode == MIDI_PLAYMODE){
+        midi_pause(x);
+        midi_panic(x);
+    }
+}
+
+static void midifollow_anything(t_midifollow *f, t_symbol *s, int ac, t_atom *av){
+    f = NULL, s = NULL, ac = 0, av = NULL; // the rest of the playhead isn't needed
+}
+
+static void midi_follow(t_midi *x, t_floatarg f){
+    if(f != 0 && !x->x_follow){
+        x->x_follow = (t_midifollow *)pd_new(midifollow_class);
+        x->x_follow->f_owner = x;
+        pd_bind(&x->x_follow->f_pd, gensym("playhead"));
+    }
+    else if(f == 0 && x->x_follow){
+        pd_unbind(&x->x_follow->f_pd, gensym("playhead"));
+        pd_free(&x->x_follow->f_pd);
+        x->x_follow = 0;
+    }
+}
+
  static void midi_speed(t_midi *x, t_floatarg f){
      if(f > MIDI_TEMPOEPSILON){
          midi_settimescale(x, 100./f);
@@ -868,6 +970,7 @@ static void midi_doread(t_midi *x, t_symbol *fn){
     if(!midi_mfread(x, fname))
         midi_textread(x, fname);
     x->x_playhead = 0;
+    x->x_timesvalid = 0;
 }
 
 static void midi_dowrite(t_midi *x, t_symbol *fn){
@@ -919,6 +1022,9 @@ static void midi_write(t_midi *x, t_symbol *s){
 }
 
 static void midi_free(t_midi *x){
+    midi_follow(x, 0);
+    if(x->x_times)
+        freebytes(x->x_times, x->x_timessize * sizeof(*x->x_times));
     if(x->x_clock)
         clock_free(x->x_clock);
     if(x->x_slaveclock)
@@ -946,6 +1052,11 @@ static void *midi_new(t_symbol * s, int ac, t_atom *av){
     x->x_tempomapsize = MIDI_INITEMPOMAPSIZE;
     x->x_ntempi = 0;
     x->x_tempomap = x->x_tempomapini;
+    x->x_times = 0;
+    x->x_timessize = 0;
+    x->x_timesvalid = 0;
+    x->x_follow = 0;
+    x->x_hostms = 0.;
     x->x_defname = &s_;
     int argn = 0;
     while(ac){
@@ -991,7 +1102,12 @@ void midi_setup(void){
     class_addmethod(midi_class, (t_method)midi_pause, gensym("pause"), 0);
     class_addmethod(midi_class, (t_method)midi_continue, gensym("continue"), 0);
     class_addmethod(midi_class, (t_method)midi_click, gensym("click"), A_FLOAT, A_FLOAT, A_FLOAT, A_FLOAT, A_FLOAT, 0);
-//    class_addmethod(midi_class, (t_method)midi_goto, gensym("goto"), A_DEFFLOAT, A_DEFFLOAT, 0);
+    class_addmethod(midi_class, (t_method)midi_goto, gensym("goto"), A_DEFFLOAT, 0);
+    class_addmethod(midi_class, (t_method)midi_follow, gensym("follow"), A_DEFFLOAT, 0);
     class_addmethod(midi_class, (t_method)midi_speed, gensym("speed"), A_FLOAT, 0);;
+    midifollow_class = class_new(gensym("midi follow"), 0, 0, sizeof(t_midifollow), CLASS_PD, 0);
+    class_addmethod(midifollow_class, (t_method)midifollow_position, gensym("position"), A_GIMME, 0);
+    class_addmethod(midifollow_class, (t_method)midifollow_playing, gensym("playing"), A_FLOAT, 0);
+    class_addanything(midifollow_class, (t_method)midifollow_anything);
     elsefile_setup();
 }
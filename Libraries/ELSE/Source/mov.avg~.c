@@ -11,6 +11,7 @@ typedef struct _mavg{
     unsigned int    x_last_n;                   // last # of samples for moving average
     unsigned int    x_count;                    // for 1st round of accumulation
     double          x_accum;                    // accumulation
+    double          x_fresh;                    // accumulated since bufrd last looped
     double         *x_buf;                      // buffer pointer
     double          x_stack[MAVG_DEF_BUFSIZE];  // buffer
     int             x_alloc;                    // if x_buf is allocated or stack ?????
@@ -22,7 +23,7 @@ typedef struct _mavg{
 static t_class *mavg_class;
 
 static void mavg_clear(t_mavg * x){ // clear buffer and reset things to 0
-    x->x_count = x->x_accum = x->x_bufrd = 0;;
+    x->x_count = x->x_accum = x->x_fresh = x->x_bufrd = 0;;
     for(unsigned int i = 0; i < x->x_size; i++)
         x->x_buf[i] = 0.;
 };
@@ -52,41 +53,70 @@ static void mavg_size(t_mavg *x, t_float f){ // deals with allocation issues if
     mavg_clear(x);
 }
 
+static unsigned int mavg_getn(t_mavg *x, t_float in_samples){
+    if(in_samples < 1)
+        in_samples = 1;
+    unsigned int n = in_samples;
+    if(n > x->x_size)
+        n = x->x_size;
+    return(n);
+}
+
+// runs nsamples with the same window size n, state is kept in locals meanwhile.
+// When bufrd loops, the samples added since it last looped are exactly the window,
+// so their sum replaces the moving sum and rounding errors from subtracting never pile up
+static void mavg_run(t_mavg *x, t_float *in1, t_float *out, int nsamples, unsigned int n){
+    int absolute = x->x_abs;
+    if(n <= 1){ // npoints = 1, just pass through
+        for(int i = 0; i < nsamples; i++)
+            out[i] = absolute ? fabs(in1[i]) : in1[i];
+        return;
+    }
+    double accum = x->x_accum, fresh = x->x_fresh, *buf = x->x_buf;
+    unsigned int count = x->x_count, bufrd = x->x_bufrd;
+    for(int i = 0; i < nsamples; i++){
+        double input = (double)in1[i];
+        if(absolute)
+            input = fabs(input);
+        accum += input;                // accumulate
+        fresh += input;
+        if(count < n)       // update count
+            count++;
+        else // subtract first sample out of bounds from the moving sum
+            accum -= buf[bufrd];
+        buf[bufrd++] = input; // store input, increment bufrd
+        if(bufrd >= n){ // loop bufrd
+            bufrd = 0;
+            accum = fresh;
+            fresh = 0;
+        }
+        out[i] = accum/(double)n; // get average
+    }
+    x->x_accum = accum;
+    x->x_fresh = fresh;
+    x->x_count = count;
+    x->x_bufrd = bufrd;
+}
+
 static t_int *mavg_perform(t_int *w){
     t_mavg *x = (t_mavg *)(w[1]);
     int nblock = (int)(w[2]);
     t_float *in1 = (t_float *)(w[3]);
     t_float *in2 = (t_float *)(w[4]);
     t_float *out = (t_float *)(w[5]);
-    float last_n = x->x_last_n;
-    for(int i = 0; i < nblock; i++){
-        double result, input = (double)in1[i];
-        float in_samples = in2[i];
-        if(x->x_abs)
-            input = fabs(input);
-        if(in_samples < 1)
-            in_samples = 1;
-        unsigned int n = in_samples;
-        if(n > x->x_size)
-            n = x->x_size;
+    unsigned int last_n = x->x_last_n;
+    int i = 0;
+    while(i < nblock){ // split the block where the number of samples changes
+        unsigned int n = mavg_getn(x, in2[i]);
+        int j = i + 1;
+        while(j < nblock && mavg_getn(x, in2[j]) == n)
+            j++;
         if(n != last_n)
             mavg_clear(x);
-        if(n > 1){ // do average
-            x->x_accum += input;                // accumulate
-            if(x->x_count < n)       // update count
-                x->x_count++;
-            else // subtract first sample out of bounds from the moving sum
-                x->x_accum -= x->x_buf[x->x_bufrd];
-            x->x_buf[x->x_bufrd++] = input; // store input, increment bufrd
-            if(x->x_bufrd >= n) // loop bufrd
-                x->x_bufrd = 0;
-            result = x->x_accum/(double)n; // get average
-        }
-        else // npoints = 1, just pass through
-            result = input;
-        out[i] = result;
+        mavg_run(x, in1 + i, out + i, j - i, n);
         last_n = n;
-    };
+        i = j;
+    }
     x->x_last_n = last_n;
     return(w + 6);
 }
@@ -12,6 +12,7 @@ typedef struct _mrms{
     unsigned int    x_last_n;                   // last # of samples for moving average
     unsigned int    x_count;                    // for 1st round of accumulation
     double          x_accum;                    // accumulation
+    double          x_fresh;                    // accumulated since bufrd last looped
     double         *x_buf;                      // buffer pointer
     double          x_stack[MRMS_DEF_BUFSIZE];  // buffer
     int             x_alloc;                    // if x_buf is allocated or stack ?????
@@ -23,7 +24,7 @@ typedef struct _mrms{
 static t_class *mrms_class;
 
 static void mrms_clear(t_mrms * x){ // clear buffer and reset things to 0
-    x->x_count = x->x_accum = x->x_bufrd = 0;;
+    x->x_count = x->x_accum = x->x_fresh = x->x_bufrd = 0;;
     for(unsigned int i = 0; i < x->x_size; i++)
         x->x_buf[i] = 0.;
 };
@@ -57,45 +58,74 @@ static void mrms_linear(t_mrms *x){
     x->x_db = 0;
 }
 
-static t_int *mrms_perform(t_int *w){
-    t_mrms *x = (t_mrms *)(w[1]);
-    int nblock = (int)(w[2]);
-    t_float *in1 = (t_float *)(w[3]);
-    t_float *in2 = (t_float *)(w[4]);
-    t_float *out = (t_float *)(w[5]);
-    float last_n = x->x_last_n;
-    for(int i = 0; i < nblock; i++){
+static unsigned int mrms_getn(t_mrms *x, t_float in_samples){
+    if(in_samples < 1)
+        in_samples = 1;
+    unsigned int n = in_samples;
+    if(n > x->x_size)
+        n = x->x_size;
+    return(n);
+}
+
+// runs nsamples with the same window size n, state is kept in locals meanwhile.
+// When bufrd loops, the samples added since it last looped are exactly the window,
+// so their sum replaces the moving sum and rounding errors from subtracting never pile up
+static void mrms_run(t_mrms *x, t_float *in1, t_float *out, int nsamples, unsigned int n){
+    double accum = x->x_accum, fresh = x->x_fresh, *buf = x->x_buf;
+    unsigned int count = x->x_count, bufrd = x->x_bufrd;
+    int db = x->x_db;
+    for(int i = 0; i < nsamples; i++){
         double result, input = (double)in1[i];
         double squared = input * input;
-        float in_samples = in2[i];
-        if(in_samples < 1)
-            in_samples = 1;
-        unsigned int n = in_samples;
-        if(n > x->x_size)
-            n = x->x_size;
-        if(n != last_n)
-            mrms_clear(x);
-        x->x_accum += squared;   // accumulate
-        if(x->x_count < n)       // update count
-            x->x_count++;
+        accum += squared;   // accumulate
+        fresh += squared;
+        if(count < n)       // update count
+            count++;
         else // subtract first sample out of bounds from the moving sum
-            x->x_accum -= x->x_buf[x->x_bufrd];
-        x->x_buf[x->x_bufrd++] = squared; // store input, increment bufrd
-        if(x->x_bufrd >= n) // loop bufrd
-            x->x_bufrd = 0;
-        result = x->x_accum/(double)n; // get average
+            accum -= buf[bufrd];
+        buf[bufrd++] = squared; // store input, increment bufrd
+        if(bufrd >= n){ // loop bufrd
+            bufrd = 0;
+            accum = fresh;
+            fresh = 0;
+        }
+        result = accum/(double)n; // get average
         if(result <= 0)
             result = 0;
         else
             result = sqrt(result);  // get rms
-        if(x->x_db){ // convert to db
+        if(db){ // convert to db
             result = 20. * log(result)/LOGTEN;
             if(result < -999)
                 result = -999;
         }
         out[i] = result;
+    }
+    x->x_accum = accum;
+    x->x_fresh = fresh;
+    x->x_count = count;
+    x->x_bufrd = bufrd;
+}
+
+static t_int *mrms_perform(t_int *w){
+    t_mrms *x = (t_mrms *)(w[1]);
+    int nblock = (int)(w[2]);
+    t_float *in1 = (t_float *)(w[3]);
+    t_float *in2 = (t_float *)(w[4]);
+    t_float *out = (t_float *)(w[5]);
+    unsigned int last_n = x->x_last_n;
+    int i = 0;
+    while(i < nblock){ // split the block where the number of samples changes
+        unsigned int n = mrms_getn(x, in2[i]);
+        int j = i + 1;
+        while(j < nblock && mrms_getn(x, in2[j]) == n)
+            j++;
+        if(n != last_n)
+            mrms_clear(x);
+        mrms_run(x, in1 + i, out + i, j - i, n);
         last_n = n;
-    };
+        i = j;
+    }
     x->x_last_n = last_n;
     return(w + 6);
 }
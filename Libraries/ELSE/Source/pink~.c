@@ -52,22 +52,25 @@ static t_int *pink_perform(t_int *w){
     float *signals = (float*)(w[4]);
     t_sample *out = (t_sample *)(w[5]);
     float total = x->x_total;
-    uint32_t *s1 = &rstate->s1;
-    uint32_t *s2 = &rstate->s2;
-    uint32_t *s3 = &rstate->s3;
-    while(n--){
-    	uint32_t rcounter = random_trand(s1, s2, s3);
-    	float newrand = random_frand(s1, s2, s3);
-    	int k = (CLZ(rcounter));
-    	if(k < (x->x_octaves-1)){
-    		float prevrand = signals[k];
-    		signals[k] = newrand;
-    		total += (newrand - prevrand);
-    	}
-    	newrand = (random_frand(s1, s2, s3));
-    	*out++ = (t_float)(total+newrand)/x->x_octaves;
-	}
-	x->x_total = total;
+    uint32_t words[3 * random_BLOCK]; // counter, octave and white noise of each sample
+    while(n > 0){
+        int chunk = n < random_BLOCK ? n : random_BLOCK;
+        random_trand_block(rstate, words, 3 * chunk);
+        for(int i = 0; i < chunk; i++){
+            uint32_t *r = words + 3 * i;
+            float newrand = random_tofloat(r[1]);
+            int k = (CLZ(r[0]));
+            if(k < (x->x_octaves-1)){
+                float prevrand = signals[k];
+                signals[k] = newrand;
+                total += (newrand - prevrand);
+            }
+            newrand = random_tofloat(r[2]);
+            *out++ = (t_float)(total+newrand)/x->x_octaves;
+        }
+        n -= chunk;
+    }
+    x->x_total = total;
     return(w+6);
 }
 
@@ -7,6 +7,7 @@
 
 #include <math.h>
 #include "m_pd.h"
+#include "magic.h"
 
 #ifndef M_PI
     #define M_PI 3.14159265358979323846
@@ -29,28 +30,24 @@ typedef struct _svfilter{
     t_inlet  *x_q_inlet;
     int    x_mode;
     float  x_srcoef;
-    float  x_band;
-    float  x_low;
+    int    x_nchans;
+    int    x_freq_nchans;
+    int    x_q_nchans;
+    float *x_band;  // state of each channel
+    float *x_low;
 }t_svfilter;
 
 static t_class *svfilter_class;
 
 static void svfilter_clear(t_svfilter *x){
-    x->x_band = x->x_low = 0.;
+    for(int ch = 0; ch < x->x_nchans; ch++)
+        x->x_band[ch] = x->x_low[ch] = 0.;
 }
 
-static t_int *svfilter_perform(t_int *w){
-    t_svfilter *x = (t_svfilter *)(w[1]);
-    int n = (int)(w[2]);
-    t_float *xin = (t_float *)(w[3]);
-    t_float fin0 = *(t_float *)(w[4]);
-    t_float rin0 = *(t_float *)(w[5]);
-    t_float *lout = (t_float *)(w[6]);
-    t_float *hout = (t_float *)(w[7]);
-    t_float *bout = (t_float *)(w[8]);
-    t_float *nout = (t_float *)(w[9]);
-    float band = x->x_band;
-    float low = x->x_low;
+static void svfilter_run(t_svfilter *x, int ch, int n, t_float *xin, t_float fin0,
+t_float rin0, t_float *lout, t_float *hout, t_float *bout, t_float *nout){
+    float band = x->x_band[ch];
+    float low = x->x_low[ch];
     while(n--){
         float c1, c2;
         float r = (1. - rin0) * SVFILTER_QSTRETCH;  /* CHECKED */
@@ -74,12 +71,43 @@ static t_int *svfilter_perform(t_int *w){
         *nout++ = low + high;
         band -= band * band * band * SVFILTER_DRIVE;
     }
-    x->x_band = (PD_BIGORSMALL(band) ? 0. : band);
-    x->x_low = (PD_BIGORSMALL(low) ? 0. : low);
+    x->x_band[ch] = (PD_BIGORSMALL(band) ? 0. : band);
+    x->x_low[ch] = (PD_BIGORSMALL(low) ? 0. : low);
+}
+
+// one call for all channels, a control inlet with fewer channels is reused for the rest
+static t_int *svfilter_perform(t_int *w){
+    t_svfilter *x = (t_svfilter *)(w[1]);
+    int n = (int)(w[2]);
+    t_float *xin = (t_float *)(w[3]);
+    t_float *fin = (t_float *)(w[4]);
+    t_float *rin = (t_float *)(w[5]);
+    t_float *lout = (t_float *)(w[6]);
+    t_float *hout = (t_float *)(w[7]);
+    t_float *bout = (t_float *)(w[8]);
+    t_float *nout = (t_float *)(w[9]);
+    for(int ch = 0; ch < x->x_nchans; ch++){
+        int offset = ch*n;
+        svfilter_run(x, ch, n, xin + offset, fin[(ch % x->x_freq_nchans)*n],
+            rin[(ch % x->x_q_nchans)*n], lout + offset, hout + offset,
+            bout + offset, nout + offset);
+    }
     return(w + 10);
 }
 
 static void svfilter_dsp(t_svfilter *x, t_signal **sp){
+    int nchans = magic_nchans(sp[0]);
+    if(nchans != x->x_nchans){
+        x->x_band = (float *)resizebytes(x->x_band,
+            x->x_nchans * sizeof(float), nchans * sizeof(float));
+        x->x_low = (float *)resizebytes(x->x_low,
+            x->x_nchans * sizeof(float), nchans * sizeof(float));
+        x->x_nchans = nchans;
+    }
+    x->x_freq_nchans = magic_nchans(sp[1]);
+    x->x_q_nchans = magic_nchans(sp[2]);
+    for(int i = 3; i < 7; i++)
+        magic_setmultiout(&sp[i], nchans);
     x->x_srcoef = TWO_PI / sp[0]->s_sr;
     svfilter_clear(x);
     dsp_add(svfilter_perform, 9, x, sp[0]->s_n,
@@ -98,6 +126,9 @@ static void *svfilter_new(t_symbol *s, int ac, t_atom *av){
             qcoef = av->a_w.w_float;
     }
     x->x_srcoef = M_PI / sys_getsr();
+    x->x_nchans = x->x_freq_nchans = x->x_q_nchans = 1;
+    x->x_band = (float *)getbytes(sizeof(float));
+    x->x_low = (float *)getbytes(sizeof(float));
     x->x_freq_inlet = inlet_new((t_object *)x, (t_pd *)x, &s_signal, &s_signal);
     pd_float((t_pd *)x->x_freq_inlet, freq);
     x->x_q_inlet = inlet_new((t_object *)x, (t_pd *)x, &s_signal, &s_signal);
@@ -110,9 +141,14 @@ static void *svfilter_new(t_symbol *s, int ac, t_atom *av){
     return (x);
 }
 
+static void svfilter_free(t_svfilter *x){
+    freebytes(x->x_band, x->x_nchans * sizeof(float));
+    freebytes(x->x_low, x->x_nchans * sizeof(float));
+}
+
 void svfilter_tilde_setup(void){
-    svfilter_class = class_new(gensym("svfilter~"),
-        (t_newmethod)svfilter_new, 0, sizeof(t_svfilter), 0, A_GIMME, 0);
+    svfilter_class = class_new(gensym("svfilter~"), (t_newmethod)svfilter_new,
+        (t_method)svfilter_free, sizeof(t_svfilter), MAGIC_MULTICHANNEL, A_GIMME, 0);
     class_addmethod(svfilter_class, nullfn, gensym("signal"), 0);
     class_addmethod(svfilter_class, (t_method)svfilter_dsp, gensym("dsp"), A_CANT, 0);
     class_addmethod(svfilter_class, (t_method)svfilter_clear, gensym("clear"), 0);
@@ -34,8 +34,16 @@ static t_int *table_perform_sig(t_int *w){
     t_float *out = (t_float *)(w[4]);
     t_word *vector = x->x_buffer->c_vectors[0];
     t_int nm1 = (t_int)(x->x_buffer->c_npts) - 1;
-    while(n--){
-        if(x->x_buffer->c_playable && vector){
+    if(!x->x_buffer->c_playable || !vector){
+        while(n--)
+            *out++ = 0;
+        return(w+5);
+    }
+    int ndx[4 * buffer_INTERPBLOCK];
+    double frac[buffer_INTERPBLOCK];
+    while(n > 0){ // the indexes of a part of the block first, then all its reads at once
+        int m = n < buffer_INTERPBLOCK ? (int)n : buffer_INTERPBLOCK;
+        for(int i = 0; i < m; i++){
             t_float phase = *in++;
             if(x->x_guard){ 
                 if(x->x_index) // like [tabread4~]
@@ -53,26 +61,17 @@ static t_int *table_perform_sig(t_int *w){
                     phase *= (float)nm1;
                 }
             }
-            t_int ndx = (t_int)(phase);
-            if((phase - ndx) == 0) // integer: no interpolation
-                *out++ = vector[ndx].w_float;
-            else{ // lagrange interpolation
-                double frac = (double)phase - (double)ndx;
-                t_int ndxm1 = ndx - 1, ndx1 = ndx + 1, ndx2 = ndx + 2;
-                if(ndxm1 < 0)
-                    ndxm1 = 0;
-                if(ndx2 > nm1)
-                    ndx2 = nm1;
-                double a = (double)vector[ndxm1].w_float;
-                double b = (double)vector[ndx].w_float;
-                double c = (double)vector[ndx1].w_float;
-                double d = (double)vector[ndx2].w_float;
-                double cmb = c-b;
-                *out++ = (t_float)(b+frac*(cmb-(1.-frac)/6. * ((d-a-3.0*cmb) * frac+d+2.0*a-3.0*b)));
-            }
+            t_int ndx0 = (t_int)(phase);
+            int *p = ndx + 4*i;
+            frac[i] = (double)phase - (double)ndx0; // 0 at integers, which reads the point itself
+            p[0] = ndx0 - 1 < 0 ? 0 : ndx0 - 1;
+            p[1] = ndx0;
+            p[2] = ndx0 + 1 > nm1 ? nm1 : ndx0 + 1; // only at the last point, where frac is 0
+            p[3] = ndx0 + 2 > nm1 ? nm1 : ndx0 + 2;
         }
-        else
-            *out++ = 0;
+        buffer_interp4(vector, ndx, frac, out, m); // lagrange interpolation
+        out += m;
+        n -= m;
     }
     return(w+5);
 }
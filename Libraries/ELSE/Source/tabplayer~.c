@@ -3,12 +3,13 @@
 #include "m_pd.h"
 #include "magic.h"
 #include "buffer.h"
+#include "sfstream.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #define HALF_PI (3.14159265358979323846 * 0.5)
 
-#define ONE_SIXTH 0.16666666666666666666667f
 #define SHARED_FLT_MAX  1E+36
 
 typedef struct _tabplayer{
@@ -47,6 +48,9 @@ typedef struct _tabplayer{
     t_float    *x_ivec;             // input vector
     t_float   **x_ovecs;            // output vectors
     t_outlet   *x_donelet;
+    t_sfstream *x_stream;           // playing from disk instead of the array
+    double      x_sphase;           // stream frames played
+    long long   x_nextwrap;         // stream frame of the next loop point
 }t_play;
 
 static t_class *tabplayer_class;
@@ -66,6 +70,17 @@ static void tabplayer_xfade(t_play *x, t_floatarg f){
     x->x_xfade = f != 0;
 }
 
+// the reader has to know about a new range or loop, so a stream starts again where it is
+static void tabplayer_stream_restart(t_play *x){
+    if(x->x_stream && x->x_playing && !x->x_playnew){
+        long long pos = sfstream_filepos(x->x_stream, (long long)x->x_sphase);
+        if(pos < 0)
+            return;
+        x->x_phase = (double)pos;
+        x->x_position = x->x_playnew = 1;
+    }
+}
+
 static void tabplayer_range_check(t_play *x){
     if(x->x_start > x->x_end){
         unsigned long long temp = x->x_start;
@@ -74,6 +89,7 @@ static void tabplayer_range_check(t_play *x){
     }
     x->x_rangesamp = x->x_end - x->x_start;
     tabplayer_fade_check(x, x->x_fadems);
+    tabplayer_stream_restart(x);
 }
 
 static void tabplayer_range(t_play *x, t_floatarg f1, t_floatarg f2){
@@ -125,12 +141,45 @@ static void tabplayer_arraysr(t_play *x, t_floatarg f){
     tabplayer_fade_check(x, x->x_fadems);
 }
 
+static void tabplayer_close(t_play *x){
+    if(x->x_stream){
+        sfstream_close(x->x_stream);
+        x->x_stream = NULL;
+        x->x_playing = x->x_playnew = 0;
+    }
+}
+
 static void tabplayer_set(t_play *x, t_symbol *s){
+    tabplayer_close(x);
     buffer_setarray(x->x_buffer, s);
     x->x_npts = x->x_buffer->c_npts;
     tabplayer_range(x, x->x_range_start, x->x_range_end);
 }
 
+// plays a WAV file from disk, 'set' goes back to the array
+static void tabplayer_open(t_play *x, t_symbol *s){
+    char path[MAXPDSTRING];
+    char *bufptr;
+    int fd = canvas_open(x->x_glist, s->s_name, "", path, &bufptr, MAXPDSTRING, 1);
+    if(fd < 0){
+        pd_error(x, "[tabplayer~]: file '%s' not found", s->s_name);
+        return;
+    }
+    sys_close(fd);
+    if(bufptr > path)
+        bufptr[-1] = '/';
+    t_sfstream *stream = sfstream_open(x, path);
+    if(!stream)
+        return;
+    tabplayer_close(x);
+    x->x_playing = x->x_playnew = 0;
+    x->x_stream = stream;
+    x->x_npts = stream->s_nframes;
+    x->x_array_sr_khz = stream->s_sr * 0.001;
+    x->x_sr_ratio = x->x_array_sr_khz/x->x_sr_khz;
+    tabplayer_range(x, x->x_range_start, x->x_range_end);
+}
+
 static void tabplayer_pos(t_play *x, t_floatarg f){
     x->x_position = 1;
     double position = f < 0 ? 0 : f > 1 ? 1 : (double)f;
@@ -197,6 +246,7 @@ static void tabplayer_resume(t_play *x){
 
 static void tabplayer_loop(t_play *x, t_floatarg f){
     x->x_loop = f > 0 ? 1 : 0;
+    tabplayer_stream_restart(x);
 }
 
 static void tabplayer_trigger(t_play *x, t_floatarg f){
@@ -246,7 +296,7 @@ static double tabplayer_interp(t_play *x, int ch, double phase){
     t_word **vectable = x->x_buffer->c_vectors; // ??
     t_word *vp = vectable[ch]; // ??
     if(vp){
-        float f,  a,  b,  c,  d, cmb;
+        float f,  a,  b,  c,  d;
         int maxindex = x->x_npts - 3;
         if(phase < 0 || phase > maxindex)
             phase = 0;  // CHECKED: a value 0, not ndx 0 (???)
@@ -266,12 +316,87 @@ static double tabplayer_interp(t_play *x, int ch, double phase){
         b = vp[0].w_float;
         c = vp[1].w_float;
         d = vp[2].w_float;
-        cmb = c-b;
-        out = b + f*(cmb - ONE_SIXTH*(1.-f)*((d - a - 3.0f*cmb)*f + (d + 2.0f*a - 3.0f*b)));
+        out = buffer_LAGRANGE4(a, b, c, d, f);
     }
     return(out);
 }
 
+static void tabplayer_stream_start(t_play *x){
+    long long start = x->x_position ? (long long)x->x_phase : (long long)x->x_start;
+    x->x_position = x->x_playnew = 0;
+    x->x_first = 1;
+    sfstream_seek(x->x_stream, start, x->x_start, x->x_end, x->x_loop);
+    x->x_sphase = 0;
+    x->x_nextwrap = (long long)x->x_end - start;
+    if(x->x_nextwrap <= 0) // started past the end
+        x->x_nextwrap = x->x_loop ? (long long)x->x_rangesamp : 0;
+}
+
+// Streaming plays forwards only and has no crossfade, there's only what's ahead in the file.
+// If the reader hasn't got the next samples yet, the stream waits instead of skipping them.
+static void tabplayer_stream_perform(t_play *x, int n){
+    t_sfstream *stream = x->x_stream;
+    t_float *xin = x->x_ivec;
+    float last_sig_input = x->x_lastin;
+    double inc = x->x_sr_ratio * x->x_rate;
+    if(inc < 0)
+        inc = 0;
+    sfstream_sync(stream);
+    for(int i = 0; i < n; i++){
+        int ch;
+        if(x->x_hasfeeders){ // gate
+            float sig_input = xin[i];
+            if(sig_input != 0 && last_sig_input == 0){
+                x->x_position = 0;
+                x->x_playing = x->x_playnew = 1;
+            }
+            else if(!x->x_trig_mode && sig_input == 0 && last_sig_input != 0 && x->x_playing){
+                x->x_playing = x->x_playnew = 0;
+                outlet_bang(x->x_donelet);
+            }
+            last_sig_input = sig_input;
+        }
+        if(x->x_playing && x->x_playnew)
+            tabplayer_stream_start(x);
+        if(x->x_playing && x->x_sphase >= x->x_nextwrap){
+            outlet_bang(x->x_donelet);
+            if(x->x_loop && x->x_rangesamp > 0){
+                x->x_nextwrap += x->x_rangesamp;
+                x->x_first = 0;
+            }
+            else
+                x->x_playing = 0;
+        }
+        long long frame = (long long)x->x_sphase;
+        float a, b, c, d;
+        if(!x->x_playing || !sfstream_get(stream, frame + 2, 0, &d)){
+            for(ch = 0; ch < x->x_n_ch; ch++)
+                x->x_ovecs[ch][i] = 0;
+            continue;
+        }
+        double fadegain = 1;
+        if(x->x_fadesamp > 0){
+            double pos = (double)sfstream_filepos(stream, frame) + (x->x_sphase - frame);
+            if(pos < x->x_start + x->x_fadesamp && (x->x_first || !x->x_loop))
+                fadegain = sin((pos - x->x_start) / x->x_fadesamp * HALF_PI);
+            else if(pos > x->x_end - x->x_fadesamp)
+                fadegain = cos((pos - (x->x_end - x->x_fadesamp)) / x->x_fadesamp * HALF_PI);
+        }
+        float f = x->x_sphase - frame;
+        for(ch = 0; ch < x->x_n_ch; ch++){
+            sfstream_get(stream, frame - 1, ch, &a);
+            sfstream_get(stream, frame, ch, &b);
+            sfstream_get(stream, frame + 1, ch, &c);
+            sfstream_get(stream, frame + 2, ch, &d);
+            x->x_ovecs[ch][i] = fadegain * buffer_LAGRANGE4(a, b, c, d, f);
+        }
+        x->x_sphase += inc;
+    }
+    if(x->x_playing)
+        sfstream_release(stream, (long long)x->x_sphase - 1);
+    x->x_lastin = last_sig_input;
+}
+
 static t_int *tabplayer_perform(t_int *w){
     t_play *x = (t_play *)(w[1]);
     t_buffer *buffer = x->x_buffer;
@@ -279,6 +404,10 @@ static t_int *tabplayer_perform(t_int *w){
     int ch, i;
     t_float *xin = x->x_ivec;
     float last_sig_input = x->x_lastin;
+    if(x->x_stream){
+        tabplayer_stream_perform(x, n);
+        return(w+3);
+    }
     if(buffer->c_playable){
         if(x->x_hasfeeders){ // signal input present
             for(i = 0; i < n; i++){
@@ -436,6 +565,7 @@ static t_int *tabplayer_perform(t_int *w){
                     *output++ = 0;
             };
     };
+    buffer_declick(buffer, x->x_ovecs, x->x_n_ch, n);
     x->x_lastin = last_sig_input;
     return(w+3);
 }
@@ -447,7 +577,7 @@ static void tabplayer_dsp(t_play *x, t_signal **sp){
     t_float pdksr = sp[0]->s_sr * 0.001;
     if(x->x_sr_khz != pdksr)
         x->x_sr_ratio = (double)(x->x_array_sr_khz/(x->x_sr_khz = pdksr));
-    if(npts != x->x_npts){
+    if(npts != x->x_npts && !x->x_stream){
         x->x_npts = npts;
         tabplayer_reset(x); // recalculate sample equivalents
     };
@@ -459,6 +589,7 @@ static void tabplayer_dsp(t_play *x, t_signal **sp){
 }
 
 static void *tabplayer_free(t_play *x){
+    tabplayer_close(x);
     buffer_free(x->x_buffer);
     freebytes(x->x_ovecs, x->x_n_ch * sizeof(*x->x_ovecs));
     outlet_free(x->x_donelet);
@@ -564,6 +695,7 @@ void tabplayer_tilde_setup(void){
     class_addfloat(tabplayer_class, tabplayer_float);
     class_addmethod(tabplayer_class, (t_method)tabplayer_dsp, gensym("dsp"), A_CANT, 0);
     class_addmethod(tabplayer_class, (t_method)tabplayer_set, gensym("set"), A_SYMBOL, 0);
+    class_addmethod(tabplayer_class, (t_method)tabplayer_open, gensym("open"), A_SYMBOL, 0);
     class_addmethod(tabplayer_class, (t_method)tabplayer_pos, gensym("pos"), A_FLOAT, 0);
     class_addmethod(tabplayer_class, (t_method)tabplayer_play, gensym("play"), A_GIMME, 0);
     class_addmethod(tabplayer_class, (t_method)tabplayer_stop, gensym("stop"), 0);
@@ -103,7 +103,7 @@ static t_int *tabwriter_perform(t_int *w){
     t_float *out = x->x_ovec;
     t_int i, j, bang = 0;
     unsigned long long phase, range;
-    buffer_validate(c, 0);
+    buffer_sync(c);
     t_float last_gate = x->x_last_gate;
     clock_delay(x->x_clock, 0);
     for(i = 0; i < nblock; i++){
@@ -1,17 +1,31 @@
 // porres 2018-2019
 
 #include "m_pd.h"
+#include <string.h>
 
 static t_class *voices_class;
 
+// Voices are found without going through all of them: used and unused voices are kept in two heaps,
+// ordered by their counter and then by their number, so the first one of each is on top. Used voices
+// are also kept in lists per hash of their pitch, for retriggers and note-offs
 typedef struct voice{
     t_clock        *v_clock;
+    struct voices  *v_owner;
     t_float         v_pitch;
     int             v_used;
     int             v_released;
     unsigned long   v_count;
+    int             v_idx;
+    int             v_heapidx;  // where it is in the heap of used or unused voices
+    struct voice   *v_pprev;    // used voices with the same hash of their pitch
+    struct voice   *v_pnext;
 }t_voice;
 
+typedef struct voiceheap{
+    t_voice       **h_vec;
+    int             h_n;
+}t_voiceheap;
+
 typedef struct voices{
     t_object        x_obj;
     t_voice        *x_vec;
@@ -19,6 +33,10 @@ typedef struct voices{
     t_outlet       *x_extra;
     t_clock        *x_clock; // clock to check voices
     unsigned long   x_count;
+    t_voiceheap     x_used;
+    t_voiceheap     x_unused;
+    t_voice       **x_hash;
+    int             x_hashsize;
     int             x_n;
     int             x_retrig;
     int             x_steal;
@@ -28,45 +46,174 @@ typedef struct voices{
     float           x_vel;
 }t_voices;
 
-static void voices_tick(t_voices *x){
-    if(x->x_count != 0){ // check if voices are unused, if so: reset counter
-        int used = 0;
-        int i;
-        t_voice *v;
-        for(v = x->x_vec, i = 0; i < x->x_n; v++, i++){ // search used voices
-            if(v->v_used){
-                used = 1;
-                break;
-            }
-        }
-        if(!used){ // all are unused, reset counter
-            for(v = x->x_vec, i = x->x_n; i--; v++)
-                v->v_count = 0;
-            x->x_count = 0;
-        }
+// the voice that the scans of the voices used to find first: lowest counter, then lowest number
+static int voice_before(t_voice *a, t_voice *b){
+    return(a->v_count < b->v_count || (a->v_count == b->v_count && a->v_idx < b->v_idx));
+}
+
+static void voiceheap_set(t_voiceheap *h, int i, t_voice *v){
+    h->h_vec[i] = v;
+    v->v_heapidx = i;
+}
+
+static void voiceheap_fix(t_voiceheap *h, int i){
+    t_voice *v = h->h_vec[i];
+    while(i > 0 && voice_before(v, h->h_vec[(i - 1) / 2])){
+        voiceheap_set(h, i, h->h_vec[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    while(2 * i + 1 < h->h_n){
+        int c = 2 * i + 1;
+        if(c + 1 < h->h_n && voice_before(h->h_vec[c + 1], h->h_vec[c]))
+            c++;
+        if(!voice_before(h->h_vec[c], v))
+            break;
+        voiceheap_set(h, i, h->h_vec[c]);
+        i = c;
+    }
+    voiceheap_set(h, i, v);
+}
+
+static void voiceheap_add(t_voiceheap *h, t_voice *v){
+    voiceheap_set(h, h->h_n++, v);
+    voiceheap_fix(h, v->v_heapidx);
+}
+
+static void voiceheap_remove(t_voiceheap *h, t_voice *v){
+    int i = v->v_heapidx;
+    if(i != --h->h_n){
+        voiceheap_set(h, i, h->h_vec[h->h_n]);
+        voiceheap_fix(h, i);
+    }
+}
+
+static t_voice **voices_bucket(t_voices *x, t_float pitch){
+    union{
+        t_float f;
+        unsigned int i;
+    }u;
+    unsigned int h;
+    u.i = 0;
+    u.f = pitch == 0 ? 0 : pitch; // -0 is the same pitch as 0
+    h = u.i * 2654435761u;
+    return(x->x_hash + ((h ^ (h >> 16)) & (x->x_hashsize - 1)));
+}
+
+static void voices_hash(t_voices *x, t_voice *v){
+    t_voice **bucket = voices_bucket(x, v->v_pitch);
+    v->v_pprev = 0;
+    if((v->v_pnext = *bucket))
+        v->v_pnext->v_pprev = v;
+    *bucket = v;
+}
+
+static void voices_unhash(t_voices *x, t_voice *v){
+    if(v->v_pprev)
+        v->v_pprev->v_pnext = v->v_pnext;
+    else
+        *voices_bucket(x, v->v_pitch) = v->v_pnext;
+    if(v->v_pnext)
+        v->v_pnext->v_pprev = v->v_pprev;
+}
+
+// marks a voice as used, with a pitch and the next counter
+static void voices_use(t_voices *x, t_voice *v, t_float f){
+    voiceheap_remove(&x->x_unused, v);
+    v->v_used = 1;
+    v->v_pitch = f;
+    v->v_count = x->x_count++;
+    voiceheap_add(&x->x_used, v);
+    voices_hash(x, v);
+}
+
+static void voices_unuse(t_voices *x, t_voice *v){
+    voices_unhash(x, v);
+    voiceheap_remove(&x->x_used, v);
+    v->v_used = v->v_pitch = 0;
+    voiceheap_add(&x->x_unused, v);
+}
+
+// all voices unused, in order
+static void voices_reorder(t_voices *x){
+    int i;
+    memset(x->x_hash, 0, x->x_hashsize * sizeof(*x->x_hash));
+    x->x_used.h_n = 0;
+    for(i = 0; i < x->x_n; i++)
+        voiceheap_set(&x->x_unused, i, x->x_vec + i);
+    x->x_unused.h_n = x->x_n;
+}
+
+// the first used voice with a pitch, or the first with the lowest counter that isn't released
+static t_voice *voices_find(t_voices *x, t_float pitch, int unreleased){
+    t_voice *v, *found = 0;
+    for(v = *voices_bucket(x, pitch); v; v = v->v_pnext){
+        if(v->v_pitch != pitch || (unreleased && v->v_released))
+            continue;
+        if(!found || (unreleased ? voice_before(v, found) : v->v_idx < found->v_idx))
+            found = v;
     }
+    return(found);
+}
+
+static void voices_resetcount(t_voices *x){
+    t_voice *v;
+    int i;
+    for(v = x->x_vec, i = x->x_n; i--; v++)
+        v->v_count = 0;
+    x->x_count = 0;
+    voices_reorder(x);
+}
+
+static void voices_tick(t_voices *x){
+    if(x->x_count != 0 && !x->x_used.h_n) // check if voices are unused, if so: reset counter
+        voices_resetcount(x);
 }
 
 static void voice_tick(t_voice *v_n){ //    post("free voice");
-    v_n->v_used = v_n->v_released = v_n->v_pitch = 0.;
+    if(v_n->v_used)
+        voices_unuse(v_n->v_owner, v_n);
+    v_n->v_released = 0;
 }
 
-static void voices_noteon(t_voices *x, t_float f){
-    t_voice *v, *first_used = 0, *first_unused = 0;
-    unsigned int used_idx = 0, unused_idx = 0;
+// voices and the table of their pitches, after the old ones were freed
+static void voices_alloc(t_voices *x, int n){
+    t_voice *v;
     int i;
-    unsigned int count_used = 0xffffffff, count_unused = 0xffffffff;
-// find first_used (on) / first_unused (off)
-    for(v = x->x_vec, i = 0; i < x->x_n; v++, i++){
-        if(v->v_used && v->v_count < count_used) // find first used (on) voice
-            first_used = v, count_used = (unsigned int)v->v_count, used_idx = i;
-        else if(!v->v_used && v->v_count < count_unused) // find first unused (off) voice
-            first_unused = v, count_unused = (unsigned int)v->v_count, unused_idx = i;
+    x->x_n = n;
+    x->x_vec = (t_voice *)getbytes(n * sizeof(*x->x_vec));
+    x->x_used.h_vec = (t_voice **)getbytes(n * sizeof(*x->x_used.h_vec));
+    x->x_unused.h_vec = (t_voice **)getbytes(n * sizeof(*x->x_unused.h_vec));
+    for(x->x_hashsize = 1; x->x_hashsize < 2 * n; x->x_hashsize *= 2)
+        ;
+    x->x_hash = (t_voice **)getbytes(x->x_hashsize * sizeof(*x->x_hash));
+    for(v = x->x_vec, i = 0; i < n; v++, i++){ // initialize voices
+        v->v_pitch = v->v_used = v->v_released = v->v_count = 0;
+        v->v_owner = x;
+        v->v_idx = i;
+        v->v_clock = clock_new(v, (t_method)voice_tick);
     }
+    voices_reorder(x);
+}
+
+static void voices_dealloc(t_voices *x){
+    t_voice *v;
+    int i;
+    for(v = x->x_vec, i = x->x_n; i--; v++)
+        clock_free(v->v_clock);
+    freebytes(x->x_vec, x->x_n * sizeof(*x->x_vec));
+    freebytes(x->x_used.h_vec, x->x_n * sizeof(*x->x_used.h_vec));
+    freebytes(x->x_unused.h_vec, x->x_n * sizeof(*x->x_unused.h_vec));
+    freebytes(x->x_hash, x->x_hashsize * sizeof(*x->x_hash));
+}
+
+static void voices_noteon(t_voices *x, t_float f){
+// find first_used (on) / first_unused (off)
+    t_voice *first_used = x->x_used.h_n ? x->x_used.h_vec[0] : 0;
+    t_voice *first_unused = x->x_unused.h_n ? x->x_unused.h_vec[0] : 0;
+    unsigned int used_idx = first_used ? first_used->v_idx : 0;
+    unsigned int unused_idx = first_unused ? first_unused->v_idx : 0;
     if(first_unused){ // if there's an unused voice, use it
-        first_unused->v_used = 1; // mark as used
-        first_unused->v_pitch = f; // set pitch
-        first_unused->v_count = x->x_count++; // increase counter
+        voices_use(x, first_unused, f); // mark as used, set pitch, increase counter
         if(x->x_list_mode){
             t_atom at[3];
             SETFLOAT(at, unused_idx + x->x_offset);             // voice number
@@ -110,8 +257,11 @@ static void voices_noteon(t_voices *x, t_float f){
                 outlet_list(x->x_outs[used_idx], &s_list, 2, at2);
                 
             }
+            voices_unhash(x, first_used);
             first_used->v_pitch = f; // set new pitch
             first_used->v_count = x->x_count++; // increase counter
+            voiceheap_fix(&x->x_used, first_used->v_heapidx);
+            voices_hash(x, first_used);
         }
         else{ // don't steal, output in extra outlet
             t_atom at[2];
@@ -123,21 +273,13 @@ static void voices_noteon(t_voices *x, t_float f){
 }
 
 static void voices_float(t_voices *x, t_float f){
-    int i;
-    t_voice *v;
     if(x->x_vel > 0){ // Note-on
         if(x->x_retrig == 2){ // retrigger mode 2: different output
             voices_noteon(x, f); // add new note, nothing different
         }
         else{ // retrigger mode 0 & 1
-            t_voice *prev = 0;
-            unsigned int prev_idx = 0;
-            for(v = x->x_vec, i = 0; i < x->x_n; v++, i++){
-                if(v->v_used && v->v_pitch == f){ // find previous pitch
-                    prev = v, prev_idx = i;
-                    break;
-                }
-            }
+            t_voice *prev = voices_find(x, f, 0); // find previous pitch
+            unsigned int prev_idx = prev ? prev->v_idx : 0;
             if(prev){ // note already in voice allocation
                 if(x->x_retrig == 1){ // retrigger
                     if(x->x_list_mode){
@@ -166,12 +308,8 @@ static void voices_float(t_voices *x, t_float f){
         }
     }
     else{ // Note off (x->x_vel = 0)
-        t_voice *used_pitch = 0;
-        unsigned int used_idx = 0, count = 0xffffffff;
-        for(v = x->x_vec, i = 0; i < x->x_n; v++, i++){ // search pitch in oldest entry
-            if(v->v_used && !v->v_released && v->v_pitch == f && v->v_count < count)
-                used_pitch = v, count = (unsigned int)v->v_count, used_idx = i;
-        }
+        t_voice *used_pitch = voices_find(x, f, 1); // search pitch in oldest entry
+        unsigned int used_idx = used_pitch ? used_pitch->v_idx : 0;
         if(used_pitch){ // pitch was found in a used and unreleased voice
             // send note-off
             if(x->x_list_mode){
@@ -194,21 +332,8 @@ static void voices_float(t_voices *x, t_float f){
                 used_pitch->v_released = 1;
             }
             else{
-                used_pitch->v_used = used_pitch->v_pitch = 0;
-                if(x->x_count != 0){ // check if all are unused, if so: reset counter
-                    int used = 0;
-                    for(v = x->x_vec, i = 0; i < x->x_n; v++, i++){ // search used voices
-                        if(v->v_used){
-                            used = 1;
-                            break;
-                        }
-                    }
-                    if(!used){ // all are unused, reset counter
-                        for(v = x->x_vec, i = x->x_n; i--; v++)
-                            v->v_count = 0;
-                        x->x_count = 0;
-                    }
-                }
+                voices_unuse(x, used_pitch);
+                voices_tick(x); // check if all are unused, if so: reset counter
             }
         }
         else{ // pitch not found, send note-off in extra outlet
@@ -268,8 +393,11 @@ static void voices_flush(t_voices *x){
                 clock_delay(x->x_clock, x->x_release);
                 v->v_released = 1;
             }
-            else
-                v->v_used = v->v_count = v->v_pitch = 0;
+            else{
+                voices_unuse(x, v);
+                v->v_count = 0;
+                voiceheap_fix(&x->x_unused, v->v_heapidx);
+            }
         }
     }
     x->x_count = 0;
@@ -277,20 +405,12 @@ static void voices_flush(t_voices *x){
 
 static void voices_voices(t_voices *x, t_float f){
     if(x->x_list_mode){
-        t_voice *v;
         int n = (int)f < 1 ? 1 : (int)f;
         if(n == x->x_n)
             return;
         voices_flush(x);
-        if(x->x_vec)
-            freebytes(x->x_vec, x->x_n * sizeof(*x->x_vec));
-        x->x_vec = (t_voice *)getbytes(n * sizeof(*x->x_vec));
-        x->x_n = n;
-        int i;
-        for(v = x->x_vec, i = n; i--; v++){ // initialize voices
-            v->v_pitch = v->v_used = v->v_count = 0;
-            v->v_clock = clock_new(v, (t_method)voice_tick);
-        }
+        voices_dealloc(x);
+        voices_alloc(x, n);
     }
     else
         post("[voices]: 'voices' is not pertinent when not in list mode");
@@ -302,17 +422,12 @@ static void voices_clear(t_voices *x){
     for(v = x->x_vec, i = x->x_n; i--; v++)
         v->v_pitch = v->v_used = v->v_released = v->v_count = 0; // zero voices
     x->x_count = 0;
+    voices_reorder(x);
 }
 
 static void voices_free(t_voices *x){
-    t_voice *v;
-    int i;
-    for(v = x->x_vec, i = x->x_n; i--; v++){
-        if(v->v_clock) // needed ???
-            clock_free(v->v_clock);
-    }
+    voices_dealloc(x);
     clock_free(x->x_clock);
-    freebytes(x->x_vec, x->x_n * sizeof (*x->x_vec));
     if(x->x_outs)
         freebytes(x->x_outs, x->x_n * sizeof(*x->x_outs));
 }
@@ -321,7 +436,6 @@ static void *voices_new(t_symbol *s, int argc, t_atom *argv){
     t_symbol *dummy = s;
     dummy = NULL;
     t_voices *x = (t_voices *)pd_new(voices_class);
-    t_voice *v;
 // default
     x->x_offset = 0;
     x->x_list_mode = 0;
@@ -385,13 +499,8 @@ static void *voices_new(t_symbol *s, int argc, t_atom *argv){
     x->x_retrig = retrig;
     if(n < 1)
         n = 1;
-    x->x_n = n;
-    x->x_vec = (t_voice *)getbytes(n * sizeof(*x->x_vec));
+    voices_alloc(x, n);
     int i;
-    for(v = x->x_vec, i = n; i--; v++){ // initialize voices
-        v->v_pitch = v->v_used = v->v_count = 0;
-        v->v_clock = clock_new(v, (t_method)voice_tick);
-    }
     x->x_clock = clock_new(x, (t_method)voices_tick);
     x->x_vel = x->x_count = 0;
     floatinlet_new(&x->x_obj, &x->x_vel);
@@ -28,19 +28,37 @@ static void wavetable_set(t_wavetable *x, t_symbol *s){
     buffer_setarray(x->x_buffer, s);
 }
 
-#define INDEX_4PT() \
-    int ndxm1, ndx1, ndx2; \
-    double a, b, c, d; \
-    double xpos = phase*(double)size + (double)start; \
-    ndx = (int)xpos; \
-    double frac = xpos - ndx; \
-    if(ndx == endi) ndx = starti; \
-    ndxm1 = ndx - 1; \
-    if(ndxm1 < starti) ndxm1 = endi - 1; \
-    ndx1 = ndx + 1; \
-    if(ndx1 == endi) ndx1 = starti; \
-    ndx2 = ndx1 + 1; \
-    if(ndx2 == endi) ndx2 = starti;
+// reads the table at n phases (0-1), wrapping around its ends
+static void wavetable_read(t_word *vector, int npts, double *phases, t_float *out, int n){
+    int ndx[4 * buffer_INTERPBLOCK];
+    double frac[buffer_INTERPBLOCK];
+    int start = 0;
+    int end = npts - 1;
+    if(start > end)
+        start = end;
+    int size = end - start + 1;
+    int starti = start;
+    int endi = starti + size;
+    for(int i = 0; i < n; i++){
+        int *p = ndx + 4*i;
+        double xpos = phases[i]*(double)size + (double)start;
+        int ndx0 = (int)xpos;
+        frac[i] = xpos - ndx0;
+        if(ndx0 == endi)
+            ndx0 = starti;
+        p[0] = ndx0 - 1;
+        if(p[0] < starti)
+            p[0] = endi - 1;
+        p[1] = ndx0;
+        p[2] = ndx0 + 1;
+        if(p[2] == endi)
+            p[2] = starti;
+        p[3] = p[2] + 1;
+        if(p[3] == endi)
+            p[3] = starti;
+    }
+    buffer_interp4(vector, ndx, frac, out, n); // lagrange interpolation
+}
 
 static t_int *wavetable_perform(t_int *w){
     t_wavetable *x = (t_wavetable *)(w[1]);
@@ -60,11 +78,18 @@ static t_int *wavetable_perform(t_int *w){
         magic_setnan(x->x_signalscalar);
     }
 // Magic End
+    if(!x->x_buffer->c_playable){
+        while(n--)
+            *out++ = 0;
+        return (w + 7);
+    }
     double phase = x->x_phase;
     double last_phase_offset = x->x_last_phase_offset;
     double sr = x->x_sr;
-    while(n--){
-        if(x->x_buffer->c_playable){
+    double phases[buffer_INTERPBLOCK];
+    while(n > 0){ // the phases of a part of the block first, then all its reads at once
+        int m = n < buffer_INTERPBLOCK ? n : buffer_INTERPBLOCK;
+        for(int i = 0; i < m; i++){
             double hz = *in1++;
             double phase_offset = (double)*in3++;
             double phase_step = hz / sr; // phase_step
@@ -77,30 +102,17 @@ static t_int *wavetable_perform(t_int *w){
                 phase = phase + 1.; // wrap deviated phase
             if(phase >= 1)
                 phase = phase - 1.; // wrap deviated phase
-            t_int start = 0;
-            t_int end = (t_int)(x->x_buffer->c_npts - 1);
-            if(start > end)
-                start = end;
-            int ndx;
-            int size = end - start + 1;
-            int starti = start;
-            int endi = starti + size;
-            INDEX_4PT(); // read table
-            if(vector){ // lagrange interpolation
-                a = (double)vector[ndxm1].w_float;
-                b = (double)vector[ndx].w_float;
-                c = (double)vector[ndx1].w_float;
-                d = (double)vector[ndx2].w_float;
-                double cmb = c-b;
-                *out++ = (t_float)(b+frac*(cmb-(1.-frac)/6. * ((d-a-3.0*cmb) * frac+d+2.0*a-3.0*b)));
-            }
-            else // ??? maybe we dont need "playable"?
-                *out++ = 0;
+            phases[i] = phase;
             phase = phase + phase_step; // next phase
             last_phase_offset = phase_offset; // last phase offset
         }
-        else
-            *out++ = 0;
+        if(vector)
+            wavetable_read(vector, x->x_buffer->c_npts, phases, out, m);
+        else // ??? maybe we dont need "playable"?
+            for(int i = 0; i < m; i++)
+                out[i] = 0;
+        out += m;
+        n -= m;
     }
     x->x_phase = phase;
     x->x_last_phase_offset = last_phase_offset;
@@ -115,11 +127,18 @@ static t_int *wavetable_perform_sig(t_int *w){
     t_float *in3 = (t_float *)(w[5]); // phase
     t_float *out = (t_float *)(w[6]);
     t_word *vector = x->x_buffer->c_vectors[0];
+    if(!x->x_buffer->c_playable){
+        while(n--)
+            *out++ = 0;
+        return(w + 7);
+    }
     double phase = x->x_phase;
     double last_phase_offset = x->x_last_phase_offset;
     double sr = x->x_sr;
-    while(n--){
-        if(x->x_buffer->c_playable){
+    double phases[buffer_INTERPBLOCK];
+    while(n > 0){
+        int m = n < buffer_INTERPBLOCK ? n : buffer_INTERPBLOCK;
+        for(int i = 0; i < m; i++){
             double hz = *in1++;
             t_float trig = *in2++;
             double phase_offset = (double)*in3++;
@@ -137,30 +156,17 @@ static t_int *wavetable_perform_sig(t_int *w){
                 if(phase >= 1)
                     phase = phase - 1.; // wrap deviated phase
             }
-            t_int start = 0;
-            t_int end = (t_int)(x->x_buffer->c_npts - 1);
-            if(start > end)
-                start = end;
-            int ndx;
-            int size = end - start + 1;
-            int starti = start;
-            int endi = starti + size;
-            INDEX_4PT(); // read table
-            if(vector){ // lagrange interpolation
-                a = (double)vector[ndxm1].w_float;
-                b = (double)vector[ndx].w_float;
-                c = (double)vector[ndx1].w_float;
-                d = (double)vector[ndx2].w_float;
-                double cmb = c-b;
-                *out++ = (t_float)(b+frac*(cmb-(1.-frac)/6. * ((d-a-3.0*cmb) * frac+d+2.0*a-3.0*b)));
-            }
-            else // ??? maybe we dont need "playable"?
-                *out++ = 0;
+            phases[i] = phase;
             phase += phase_step; // next phase
             last_phase_offset = phase_offset; // last phase offset
         }
+        if(vector)
+            wavetable_read(vector, x->x_buffer->c_npts, phases, out, m);
         else
-            *out++ = 0;
+            for(int i = 0; i < m; i++)
+                out[i] = 0;
+        out += m;
+        n -= m;
     }
     x->x_phase = phase;
     x->x_last_phase_offset = last_phase_offset;
@@ -23,6 +23,16 @@
 #include "fluid_rvoice.h"
 #include "fluid_rvoice_dsp_tables.inc.h"
 
+/* SSE2 and NEON are part of every x86_64 and arm64 CPU, so they are picked when
+ * compiling rather than at runtime. Only used when fluid_real_t is double. */
+#if !defined(WITH_FLOAT) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FLUID_RVOICE_DSP_SSE2 1
+#elif !defined(WITH_FLOAT) && (defined(__aarch64__) || defined(_M_ARM64))
+#include <arm_neon.h>
+#define FLUID_RVOICE_DSP_NEON 1
+#endif
+
 /* Purpose:
  *
  * Interpolates audio data (obtains values between the samples of the original
@@ -54,6 +64,71 @@ fluid_rvoice_get_float_sample(const short int *dsp_msb, const char *dsp_lsb, uns
     return (fluid_real_t)sample;
 }
 
+#if defined(FLUID_RVOICE_DSP_SSE2) || defined(FLUID_RVOICE_DSP_NEON)
+
+/* Vectorised versions of the inner loops of the 4th and 7th order interpolation,
+ * for 16 bit samples (dsp_data24 == NULL), which are read as 4 int16 at a time.
+ * Samples are scaled to 24 bit like fluid_rvoice_get_sample() does, multiplying
+ * by 256 is exact so only the order of the additions differs from the scalar code. */
+#define FLUID_RVOICE_DSP_SIMD 1
+
+/* Sum of coeffs[0..3] times data[0..3] */
+static FLUID_INLINE fluid_real_t
+fluid_rvoice_dsp_dot4(const fluid_real_t *coeffs, const short int *data)
+{
+#if defined(FLUID_RVOICE_DSP_SSE2)
+    __m128i s = _mm_loadl_epi64((const __m128i *)data);
+    __m128d lo, hi, sum;
+
+    s = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+    lo = _mm_cvtepi32_pd(s);
+    hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+
+    sum = _mm_add_pd(_mm_mul_pd(lo, _mm_loadu_pd(coeffs)), _mm_mul_pd(hi, _mm_loadu_pd(coeffs + 2)));
+    sum = _mm_add_sd(sum, _mm_unpackhi_pd(sum, sum));
+    return _mm_cvtsd_f64(sum) * 256.0;
+#else
+    int32x4_t s = vmovl_s16(vld1_s16(data));
+    float64x2_t lo = vcvtq_f64_s64(vmovl_s32(vget_low_s32(s)));
+    float64x2_t hi = vcvtq_f64_s64(vmovl_s32(vget_high_s32(s)));
+
+    return vaddvq_f64(vfmaq_f64(vmulq_f64(lo, vld1q_f64(coeffs)), hi, vld1q_f64(coeffs + 2))) * 256.0;
+#endif
+}
+
+/* Sum of coeffs[0..6] times data[0..6], without reading past data[6] */
+static FLUID_INLINE fluid_real_t
+fluid_rvoice_dsp_dot7(const fluid_real_t *coeffs, const short int *data)
+{
+#if defined(FLUID_RVOICE_DSP_SSE2)
+    __m128i a = _mm_loadl_epi64((const __m128i *)data);
+    __m128i b = _mm_srli_epi64(_mm_loadl_epi64((const __m128i *)(data + 3)), 16); /* data[4..6], 0 */
+    __m128d sum;
+
+    a = _mm_srai_epi32(_mm_unpacklo_epi16(a, a), 16);
+    b = _mm_srai_epi32(_mm_unpacklo_epi16(b, b), 16);
+
+    sum = _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(a), _mm_loadu_pd(coeffs)),
+                     _mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(a, _MM_SHUFFLE(1, 0, 3, 2))), _mm_loadu_pd(coeffs + 2)));
+    sum = _mm_add_pd(sum, _mm_mul_pd(_mm_cvtepi32_pd(b), _mm_loadu_pd(coeffs + 4)));
+    sum = _mm_add_pd(sum, _mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2))), _mm_load_sd(coeffs + 6)));
+    sum = _mm_add_sd(sum, _mm_unpackhi_pd(sum, sum));
+    return _mm_cvtsd_f64(sum) * 256.0;
+#else
+    int32x4_t a = vmovl_s16(vld1_s16(data));
+    int32x4_t b = vmovl_s16(vext_s16(vld1_s16(data + 3), vdup_n_s16(0), 1)); /* data[4..6], 0 */
+    float64x2_t sum;
+
+    sum = vmulq_f64(vcvtq_f64_s64(vmovl_s32(vget_low_s32(a))), vld1q_f64(coeffs));
+    sum = vfmaq_f64(sum, vcvtq_f64_s64(vmovl_s32(vget_high_s32(a))), vld1q_f64(coeffs + 2));
+    sum = vfmaq_f64(sum, vcvtq_f64_s64(vmovl_s32(vget_low_s32(b))), vld1q_f64(coeffs + 4));
+    sum = vfmaq_f64(sum, vcvtq_f64_s64(vmovl_s32(vget_high_s32(b))), vcombine_f64(vld1_f64(coeffs + 6), vdup_n_f64(0.0)));
+    return vaddvq_f64(sum) * 256.0;
+#endif
+}
+
+#endif
+
 /* No interpolation. Just take the sample, which is closest to
   * the playback pointer.  Questionable quality, but very
   * efficient. */
@@ -284,6 +359,22 @@ fluid_rvoice_dsp_interpolate_4th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
             dsp_amp += dsp_amp_incr;
         }
 
+#ifdef FLUID_RVOICE_DSP_SIMD
+        if(dsp_data24 == NULL)
+        {
+            for(; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++)
+            {
+                coeffs = interp_coeff[fluid_phase_fract_to_tablerow(dsp_phase)];
+                dsp_buf[dsp_i] = dsp_amp * fluid_rvoice_dsp_dot4(coeffs, dsp_data + dsp_phase_index - 1);
+
+                /* increment phase and amplitude */
+                fluid_phase_incr(dsp_phase, dsp_phase_incr);
+                dsp_phase_index = fluid_phase_index(dsp_phase);
+                dsp_amp += dsp_amp_incr;
+            }
+        }
+#endif
+
         /* interpolate the sequence of sample points */
         for(; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++)
         {
@@ -503,6 +594,21 @@ fluid_rvoice_dsp_interpolate_7th_order(fluid_rvoice_dsp_t *voice, fluid_real_t *
 
         start_index -= 2;	/* set back to original start index */
 
+#ifdef FLUID_RVOICE_DSP_SIMD
+        if(dsp_data24 == NULL)
+        {
+            for(; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++)
+            {
+                coeffs = sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase)];
+                dsp_buf[dsp_i] = dsp_amp * fluid_rvoice_dsp_dot7(coeffs, dsp_data + dsp_phase_index - 3);
+
+                /* increment phase and amplitude */
+                fluid_phase_incr(dsp_phase, dsp_phase_incr);
+                dsp_phase_index = fluid_phase_index(dsp_phase);
+                dsp_amp += dsp_amp_incr;
+            }
+        }
+#endif
 
         /* interpolate the sequence of sample points */
         for(; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++)
@@ -216,6 +216,7 @@ fluid_defsfont_t *new_fluid_defsfont(fluid_settings_t *settings)
 
     fluid_settings_getint(settings, "synth.lock-memory", &defsfont->mlock);
     fluid_settings_getint(settings, "synth.dynamic-sample-loading", &defsfont->dynamic_samples);
+    fluid_settings_getint(settings, "synth.sample-disk-cache", &defsfont->disk_cache);
 
     return defsfont;
 }
@@ -366,6 +367,103 @@ int fluid_defsfont_load_sampledata(fluid_defsfont_t *defsfont, SFData *sfdata, f
     return FLUID_OK;
 }
 
+#ifndef _OPENMP
+
+#define FLUID_DEFSFONT_MAX_DECODERS 16
+
+/* Without OpenMP, the samples of SF3 files are decoded by threads of our own, which take
+ * the next sample that is left until there are none */
+typedef struct
+{
+    fluid_defsfont_t *defsfont;
+    SFData *sfdata;
+    fluid_sample_t **samples;
+    int count;
+    fluid_atomic_int_t next;
+    fluid_atomic_int_t failed;
+} fluid_defsfont_decoder_t;
+
+static fluid_thread_return_t fluid_defsfont_decode_samples(void *data)
+{
+    fluid_defsfont_decoder_t *decoder = data;
+    fluid_sample_t *sample;
+    int i;
+
+    while((i = fluid_atomic_int_exchange_and_add(&decoder->next, 1)) < decoder->count)
+    {
+        sample = decoder->samples[i];
+
+        if(fluid_defsfont_load_sampledata(decoder->defsfont, decoder->sfdata, sample) == FLUID_FAILED)
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to load sample '%s'", sample->name);
+            fluid_atomic_int_set(&decoder->failed, 1);
+        }
+        else
+        {
+            fluid_sample_sanitize_loop(sample, (sample->end + 1) * sizeof(short));
+            fluid_voice_optimize_sample(sample);
+        }
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+static int fluid_defsfont_load_sf3_sampledata(fluid_defsfont_t *defsfont, SFData *sfdata)
+{
+    fluid_defsfont_decoder_t decoder;
+    fluid_thread_t *threads[FLUID_DEFSFONT_MAX_DECODERS];
+    fluid_list_t *list;
+    int i, num_threads;
+
+    decoder.defsfont = defsfont;
+    decoder.sfdata = sfdata;
+    decoder.count = fluid_list_size(defsfont->sample);
+    decoder.samples = FLUID_ARRAY(fluid_sample_t *, decoder.count + 1);
+    fluid_atomic_int_set(&decoder.next, 0);
+    fluid_atomic_int_set(&decoder.failed, 0);
+
+    if(decoder.samples == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    for(i = 0, list = defsfont->sample; list; list = fluid_list_next(list), i++)
+    {
+        decoder.samples[i] = fluid_list_get(list);
+    }
+
+    /* This thread decodes as well */
+    num_threads = (int)fluid_thread_get_num_cpus() - 1;
+    num_threads = num_threads < decoder.count - 1 ? num_threads : decoder.count - 1;
+    num_threads = num_threads < FLUID_DEFSFONT_MAX_DECODERS ? num_threads : FLUID_DEFSFONT_MAX_DECODERS;
+
+    for(i = 0; i < num_threads; i++)
+    {
+        threads[i] = new_fluid_thread("sf3-decoder", fluid_defsfont_decode_samples, &decoder, 0, FALSE);
+
+        if(threads[i] == NULL)
+        {
+            break;
+        }
+    }
+
+    num_threads = i;
+    fluid_defsfont_decode_samples(&decoder);
+
+    for(i = 0; i < num_threads; i++)
+    {
+        fluid_thread_join(threads[i]);
+        delete_fluid_thread(threads[i]);
+    }
+
+    FLUID_FREE(decoder.samples);
+
+    return fluid_atomic_int_get(&decoder.failed) ? FLUID_FAILED : FLUID_OK;
+}
+
+#endif
+
 /* Loads the sample data for all samples from the Soundfont file. For SF2 files, it loads the data in
  * one large block. For SF3 files, each compressed sample gets loaded individually.
  * Returns FLUID_OK on success, otherwise FLUID_FAILED
@@ -393,6 +491,12 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
             return FLUID_FAILED;
         }
     }
+#ifndef _OPENMP
+    else
+    {
+        return fluid_defsfont_load_sf3_sampledata(defsfont, sfdata);
+    }
+#endif
 
     #pragma omp parallel
     #pragma omp single
@@ -468,6 +572,8 @@ int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t
         return FLUID_FAILED;
     }
 
+    sfdata->disk_cache = defsfont->disk_cache;
+
     if(fluid_sffile_parse_presets(sfdata) == FLUID_FAILED)
     {
         FLUID_LOG(FLUID_ERR, "Couldn't parse presets from soundfont file");
@@ -2215,6 +2321,8 @@ static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *prese
                             FLUID_LOG(FLUID_ERR, "Unable to open Soundfont file");
                             return FLUID_FAILED;
                         }
+
+                        sffile->disk_cache = defsfont->disk_cache;
                     }
 
                     if(fluid_defsfont_load_sampledata(defsfont, sffile, sample) == FLUID_OK)
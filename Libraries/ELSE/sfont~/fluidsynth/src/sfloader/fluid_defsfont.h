@@ -118,6 +118,7 @@ struct _fluid_defsfont_t
     fluid_list_t *inst;        /* the instruments of this soundfont */
     int mlock;                 /* Should we try memlock (avoid swapping)? */
     int dynamic_samples;       /* Enables dynamic sample loading if set */
+    int disk_cache;            /* Keeps decoded SF3 samples in the sample disk cache if set */
 
     fluid_list_t *preset_iter_cur;       /* the current preset in the iteration */
 };
@@ -0,0 +1,229 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+/* DISK CACHE OF DECODED SAMPLES
+ *
+ * Decoding the Ogg Vorbis samples of SF3 files takes a lot longer than reading
+ * them, so the decoded samples are kept in the user's cache folder, in a file per
+ * sample named after a hash of its compressed data. Samples that are the same in
+ * several Soundfonts share a file, and a Soundfont that was changed can't get stale
+ * samples. A file is a 16 byte header followed by the sample words as they are in
+ * memory, so it only needs to be read into place.
+ */
+
+#include "fluid_samplediskcache.h"
+#include "fluid_sys.h"
+
+#if defined(WIN32)
+#include <direct.h>
+#endif
+
+#define SAMPLEDISKCACHE_MAGIC "FLSMPL01"
+
+typedef struct
+{
+    char magic[8];
+    uint32_t size;        /* size of the compressed data, as a check of the hash */
+    int32_t num_samples;
+} fluid_samplediskcache_header_t;
+
+static int fluid_samplediskcache_get_path(char *path, size_t len, const char *compressed, unsigned int size, int create);
+
+
+/* PUBLIC INTERFACE */
+
+int fluid_samplediskcache_load(const char *compressed, unsigned int size, short **data)
+{
+    char path[1024];
+    fluid_samplediskcache_header_t header;
+    short *samples;
+    FILE *file;
+
+    if(fluid_samplediskcache_get_path(path, sizeof(path), compressed, size, FALSE) == FLUID_FAILED)
+    {
+        return -1;
+    }
+
+    file = FLUID_FOPEN(path, "rb");
+
+    if(file == NULL)
+    {
+        return -1;
+    }
+
+    if(FLUID_FREAD(&header, sizeof(header), 1, file) != 1
+            || memcmp(header.magic, SAMPLEDISKCACHE_MAGIC, sizeof(header.magic)) != 0
+            || header.size != size || header.num_samples <= 0)
+    {
+        FLUID_FCLOSE(file);
+        return -1;
+    }
+
+    samples = FLUID_ARRAY(short, header.num_samples);
+
+    if(samples == NULL)
+    {
+        FLUID_FCLOSE(file);
+        return -1;
+    }
+
+    if(FLUID_FREAD(samples, sizeof(short), header.num_samples, file) != (size_t)header.num_samples)
+    {
+        FLUID_LOG(FLUID_DBG, "Ignoring truncated sample cache file '%s'", path);
+        FLUID_FREE(samples);
+        FLUID_FCLOSE(file);
+        return -1;
+    }
+
+    FLUID_FCLOSE(file);
+
+    *data = samples;
+    return header.num_samples;
+}
+
+void fluid_samplediskcache_store(const char *compressed, unsigned int size, const short *data, int num_samples)
+{
+    char path[1024], temp_path[1024 + 32];
+    fluid_samplediskcache_header_t header;
+    FILE *file;
+    int ok;
+
+    if(num_samples <= 0
+            || fluid_samplediskcache_get_path(path, sizeof(path), compressed, size, TRUE) == FLUID_FAILED)
+    {
+        return;
+    }
+
+    /* Written under another name first, so that no one reads a file that is half written */
+    FLUID_SNPRINTF(temp_path, sizeof(temp_path), "%s.%x.tmp", path,
+                   (unsigned int)(uintptr_t)fluid_thread_get_id() ^ (unsigned int)(uintptr_t)data);
+
+    file = FLUID_FOPEN(temp_path, "wb");
+
+    if(file == NULL)
+    {
+        return;
+    }
+
+    FLUID_MEMCPY(header.magic, SAMPLEDISKCACHE_MAGIC, sizeof(header.magic));
+    header.size = size;
+    header.num_samples = num_samples;
+
+    ok = fwrite(&header, sizeof(header), 1, file) == 1
+         && fwrite(data, sizeof(short), num_samples, file) == (size_t)num_samples;
+    ok = (FLUID_FCLOSE(file) == 0) && ok;
+
+    /* Another thread or process might have stored the same sample in the meantime */
+    if(!ok || rename(temp_path, path) != 0)
+    {
+        remove(temp_path);
+    }
+}
+
+
+/* Private functions */
+
+/* The folder the samples are cached in, which is made when create is set */
+static int fluid_samplediskcache_get_folder(char *path, size_t len, int create)
+{
+    const char *base;
+    char *sep, c;
+    int n;
+
+#if defined(WIN32)
+    base = getenv("LOCALAPPDATA");
+    n = base ? FLUID_SNPRINTF(path, len, "%s\\fluidsynth\\samples", base) : -1;
+#elif defined(__APPLE__)
+    base = getenv("HOME");
+    n = base ? FLUID_SNPRINTF(path, len, "%s/Library/Caches/fluidsynth/samples", base) : -1;
+#else
+    base = getenv("XDG_CACHE_HOME");
+
+    if(base != NULL && base[0] == '/')
+    {
+        n = FLUID_SNPRINTF(path, len, "%s/fluidsynth/samples", base);
+    }
+    else
+    {
+        base = getenv("HOME");
+        n = base ? FLUID_SNPRINTF(path, len, "%s/.cache/fluidsynth/samples", base) : -1;
+    }
+#endif
+
+    if(n < 0 || (size_t)n >= len)
+    {
+        return FLUID_FAILED;
+    }
+
+    if(!create)
+    {
+        return FLUID_OK;
+    }
+
+    /* Makes every folder of the path below the base, the ones that exist already fail */
+    for(sep = path + FLUID_STRLEN(base) + 1; *sep != '\0'; sep++)
+    {
+        if(*sep == '/' || *sep == '\\')
+        {
+            c = *sep;
+            *sep = '\0';
+#if defined(WIN32)
+            _mkdir(path);
+#else
+            mkdir(path, 0755);
+#endif
+            *sep = c;
+        }
+    }
+
+#if defined(WIN32)
+    _mkdir(path);
+#else
+    mkdir(path, 0755);
+#endif
+
+    return FLUID_OK;
+}
+
+/* The file the decoded samples of the compressed data are kept in, named after a 64 bit FNV-1a hash of it */
+static int fluid_samplediskcache_get_path(char *path, size_t len, const char *compressed, unsigned int size, int create)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t folder_len;
+    unsigned int i;
+    int n;
+
+    if(fluid_samplediskcache_get_folder(path, len, create) == FLUID_FAILED)
+    {
+        return FLUID_FAILED;
+    }
+
+    for(i = 0; i < size; i++)
+    {
+        hash ^= (unsigned char)compressed[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    folder_len = FLUID_STRLEN(path);
+    n = FLUID_SNPRINTF(path + folder_len, len - folder_len, "/%08x%08x-%x.pcm",
+                       (unsigned int)(hash >> 32), (unsigned int)hash, size);
+
+    return (n < 0 || (size_t)n >= len - folder_len) ? FLUID_FAILED : FLUID_OK;
+}
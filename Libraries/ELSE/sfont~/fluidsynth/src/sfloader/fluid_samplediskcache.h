@@ -0,0 +1,32 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA
+ */
+
+
+#ifndef _FLUID_SAMPLEDISKCACHE_H
+#define _FLUID_SAMPLEDISKCACHE_H
+
+/* Returns the number of decoded sample words stored for the compressed sample data,
+ * with data pointing to a copy of them, or -1 if they aren't cached */
+int fluid_samplediskcache_load(const char *compressed, unsigned int size, short **data);
+
+/* Stores the decoded sample words of the compressed sample data, failing silently */
+void fluid_samplediskcache_store(const char *compressed, unsigned int size, const short *data, int num_samples);
+
+#endif /* _FLUID_SAMPLEDISKCACHE_H */
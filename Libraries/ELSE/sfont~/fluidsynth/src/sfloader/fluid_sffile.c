@@ -25,6 +25,7 @@
 #include "fluid_sffile.h"
 #include "fluid_sfont.h"
 #include "fluid_sys.h"
+#include "fluid_samplediskcache.h"
 
 #if LIBSNDFILE_SUPPORT
 #include <sndfile.h>
@@ -2322,6 +2323,7 @@ typedef struct _sfvio_data_t
     sf_count_t start;  /* start byte offset of compressed data */
     sf_count_t end;    /* end byte offset of compressed data */
     sf_count_t offset; /* current virtual file offset from start byte offset */
+    const char *mem;   /* the compressed data if it was read into memory already, or NULL */
 
 } sfvio_data_t;
 
@@ -2357,6 +2359,17 @@ static sf_count_t sfvio_seek(sf_count_t offset, int whence, void *user_data)
     }
 
     new_offset += data->start;
+
+    if(data->mem != NULL)
+    {
+        if(data->start <= new_offset && new_offset <= data->end)
+        {
+            data->offset = new_offset - data->start;
+        }
+
+        return data->offset;
+    }
+
     fluid_rec_mutex_lock(sf->mtx);
     if (data->start <= new_offset && new_offset <= data->end &&
         sf->fcbs->fseek(sf->sffd, new_offset, SEEK_SET) != FLUID_FAILED)
@@ -2387,6 +2400,13 @@ static sf_count_t sfvio_read(void *ptr, sf_count_t count, void *user_data)
         return count;
     }
 
+    if(data->mem != NULL)
+    {
+        FLUID_MEMCPY(ptr, data->mem + data->offset, count);
+        data->offset += count;
+        return count;
+    }
+
     fluid_rec_mutex_lock(sf->mtx);
     if (sf->fcbs->fseek(sf->sffd, data->start + data->offset, SEEK_SET) == FLUID_FAILED)
     {
@@ -2439,6 +2459,9 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
     };
     sfvio_data_t sfdata;
     short *wav_data = NULL;
+    char *compressed = NULL;
+    unsigned int compressed_size = 0;
+    int num_samples;
 
     if((start_byte > sf->samplesize) || (end_byte > sf->samplesize))
     {
@@ -2451,12 +2474,49 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
     sfdata.start = sf->samplepos + start_byte;
     sfdata.end = sf->samplepos + end_byte;
     sfdata.offset = -1;
+    sfdata.mem = NULL;
+
+    /* With the disk cache the compressed data is read at once, the decoded samples are looked
+     * up by it, and decoding it from memory doesn't need the lock of the file */
+    if(sf->disk_cache)
+    {
+        compressed_size = end_byte - start_byte + 1;
+        compressed = FLUID_MALLOC(compressed_size);
+
+        if(compressed != NULL)
+        {
+            fluid_rec_mutex_lock(sf->mtx);
+
+            if(sf->fcbs->fseek(sf->sffd, sfdata.start, SEEK_SET) == FLUID_FAILED
+                    || sf->fcbs->fread(compressed, compressed_size, sf->sffd) == FLUID_FAILED)
+            {
+                FLUID_FREE(compressed);
+                compressed = NULL;
+            }
+
+            fluid_rec_mutex_unlock(sf->mtx);
+        }
+
+        if(compressed != NULL)
+        {
+            num_samples = fluid_samplediskcache_load(compressed, compressed_size, data);
+
+            if(num_samples >= 0)
+            {
+                FLUID_FREE(compressed);
+                return num_samples;
+            }
+
+            sfdata.mem = compressed;
+        }
+    }
 
     /* Seek to sfdata.start, the beginning of Ogg Vorbis data in Soundfont */
     sfvio_seek(0, SEEK_SET, &sfdata);
     if (sfdata.offset != 0)
     {
         FLUID_LOG(FLUID_ERR, "Failed to seek to compressed sample position");
+        FLUID_FREE(compressed);
         return -1;
     }
 
@@ -2468,6 +2528,7 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
     if(!sndfile)
     {
         FLUID_LOG(FLUID_ERR, "sf_open_virtual(): %s", sf_strerror(sndfile));
+        FLUID_FREE(compressed);
         return -1;
     }
 
@@ -2477,6 +2538,7 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
         FLUID_LOG(FLUID_DBG, "Empty decompressed sample");
         *data = NULL;
         sf_close(sndfile);
+        FLUID_FREE(compressed);
         return 0;
     }
 
@@ -2510,12 +2572,19 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
 
     sf_close(sndfile);
 
+    if(compressed != NULL)
+    {
+        fluid_samplediskcache_store(compressed, compressed_size, wav_data, (int)sfinfo.frames);
+        FLUID_FREE(compressed);
+    }
+
     *data = wav_data;
 
     return sfinfo.frames;
 
 error_exit:
     FLUID_FREE(wav_data);
+    FLUID_FREE(compressed);
     sf_close(sndfile);
     return -1;
 }
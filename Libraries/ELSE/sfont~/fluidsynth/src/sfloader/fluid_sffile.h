@@ -153,6 +153,7 @@ struct _SFData
     const fluid_file_callbacks_t *fcbs; /* file callbacks used to read this file */
 
     fluid_rec_mutex_t mtx; /* this mutex can be used to synchronize calls to fcbs when using multiple threads (e.g. SF3 loading) */
+    int disk_cache; /* keep decoded Ogg Vorbis samples in the sample disk cache */
 
     fluid_list_t *info; /* linked list of info strings (1st byte is ID) */
     fluid_list_t *preset; /* linked list of preset info */
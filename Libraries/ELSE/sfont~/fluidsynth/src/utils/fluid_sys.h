@@ -363,6 +363,7 @@ typedef fluid_thread_return_t (*fluid_thread_func_t)(void *data);
 #define FLUID_THREAD_ID_NULL            NULL                    /* A NULL "ID" value */
 #define fluid_thread_id_t               _thread *               /* Data type for a thread ID */
 #define fluid_thread_get_id()           _thread_get_id()         /* Get unique "ID" for current thread */
+#define fluid_thread_get_num_cpus()     _thread_get_num_cpus()   /* Number of threads the CPU runs at once */
 
 fluid_thread_t *new_fluid_thread(const char *name, fluid_thread_func_t func, void *data,
                                  int prio_level, int detach);
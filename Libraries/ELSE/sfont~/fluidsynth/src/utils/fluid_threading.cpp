@@ -89,6 +89,11 @@ unsigned _thread_get_id(void)
 	std::hash<std::thread::id>h;
 	return h(std::this_thread::get_id());
 }
+unsigned _thread_get_num_cpus(void)
+{
+	unsigned n=std::thread::hardware_concurrency();
+	return n?n:1;
+}
 void _thread_create(_thread *th,_thread_func_t func,void* data)
 {
 	th->thrd=(void*)(new std::thread(func,data));
@@ -39,6 +39,7 @@ void* _private_get(_private *priv);
 void _private_set(_private *priv,void *val);
 
 unsigned _thread_get_id(void);
+unsigned _thread_get_num_cpus(void);
 void _thread_create(_thread *th,_thread_func_t func,void* data);
 void _thread_detach(_thread *th);
 void _thread_join(_thread *th);
@@ -25,6 +25,7 @@ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include <stdlib.h>
 #include <fluidsynth.h>
 #include <string.h>
+#include <pthread.h>
 
 
 #ifdef _MSC_VER
@@ -34,6 +35,22 @@ Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #endif
 
 #define MAXSYSEXSIZE 1024 // Size of sysex data list (excluding the F0 [240] and F7 [247] bytes)
+#define SFLOAD_POLL 20 // ms between checks for a soundfont that is still loading
+
+enum{SFLOAD_LOADING, SFLOAD_READY, SFLOAD_FAILED};
+
+// Soundfonts are loaded on a thread of their own, into a holder synth that only exists
+// for that. The font is then taken out of the holder and the object adds it to its own
+// synth when it's ready, so every synth has a font of its own and unloads it itself.
+// FluidSynth's sample cache still shares the sample data between loads of the same file.
+typedef struct _sfload{
+    char                l_path[MAXPDSTRING];
+    int                 l_state;
+    int                 l_abandoned;    // the object went away or asked for another file
+    fluid_sfont_t      *l_sfont;
+}t_sfload;
+
+static pthread_mutex_t sfload_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static t_class *sfont_class;
  
@@ -46,6 +63,10 @@ typedef struct _sfont{
     fluid_sfont_t      *x_sfont;
     fluid_preset_t     *x_preset;
     t_elsefile         *x_elsefilehandle;
+    int                 x_sfid;         // id of x_sfont in the synth
+    t_sfload           *x_pending;      // font that is loading
+    t_symbol           *x_pendname;
+    t_clock            *x_clock;
     t_outlet           *x_out_left;
     t_outlet           *x_out_right;
     t_canvas           *x_canvas;
@@ -474,6 +495,107 @@ static void sfont_info(t_sfont *x){
     post("\n");
 }
 
+static void *sfload_thread(void *z){
+    t_sfload *l = (t_sfload *)z;
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *holder = NULL;
+    fluid_sfont_t *sfont = NULL;
+    if(settings){
+        fluid_settings_setint(settings, "synth.ladspa.active", 0);
+        fluid_settings_setint(settings, "synth.polyphony", 1); // never plays
+        if((holder = new_fluid_synth(settings))){
+            int id = fluid_synth_sfload(holder, l->l_path, 0);
+            // out of the holder, so it doesn't delete it with itself
+            if(id >= 0 && (sfont = fluid_synth_get_sfont_by_id(holder, id)))
+                fluid_synth_remove_sfont(holder, sfont);
+        }
+    }
+    pthread_mutex_lock(&sfload_mutex);
+    int abandoned = l->l_abandoned;
+    if(!abandoned){
+        l->l_sfont = sfont;
+        l->l_state = sfont ? SFLOAD_READY : SFLOAD_FAILED;
+    }
+    pthread_mutex_unlock(&sfload_mutex);
+    if(abandoned && sfont) // nobody wants it anymore, back in so the holder deletes it
+        fluid_synth_add_sfont(holder, sfont);
+    if(holder)
+        delete_fluid_synth(holder);
+    if(settings)
+        delete_fluid_settings(settings);
+    if(abandoned)
+        freebytes(l, sizeof(*l));
+    return(NULL);
+}
+
+static t_sfload *sfload_start(const char *path){
+    t_sfload *l = (t_sfload *)getbytes(sizeof(*l));
+    strncpy(l->l_path, path, MAXPDSTRING - 1);
+    l->l_state = SFLOAD_LOADING;
+    l->l_abandoned = 0;
+    l->l_sfont = NULL;
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, sfload_thread, l)){
+        freebytes(l, sizeof(*l));
+        return(NULL);
+    }
+    pthread_detach(thread);
+    return(l);
+}
+
+static int sfload_state(t_sfload *l){
+    pthread_mutex_lock(&sfload_mutex);
+    int state = l->l_state;
+    pthread_mutex_unlock(&sfload_mutex);
+    return(state);
+}
+
+// gives up on a load that is still running, the thread frees it then, returns 0 if it's done
+static int sfload_abandon(t_sfload *l){
+    pthread_mutex_lock(&sfload_mutex);
+    int loading = l->l_state == SFLOAD_LOADING;
+    if(loading)
+        l->l_abandoned = 1;
+    pthread_mutex_unlock(&sfload_mutex);
+    return(loading);
+}
+
+// swaps the loaded font into the synth, here in the scheduler's thread perform
+// never sees the synth in between fonts
+static void sfont_attach(t_sfont *x, fluid_sfont_t *sfont, t_symbol *name){
+    if(x->x_sfont) // the voices that still play it keep its samples until they're done
+        fluid_synth_sfunload(x->x_synth, x->x_sfid, 0);
+    x->x_sfid = fluid_synth_add_sfont(x->x_synth, sfont);
+    x->x_sfont = sfont;
+    x->x_sfname = name;
+    if(x->x_verbosity)
+        sfont_info(x);
+    fluid_preset_t* preset = fluid_sfont_get_preset(x->x_sfont, x->x_bank = 0, x->x_pgm = 0);
+    if(preset){
+        const char* pname = fluid_preset_get_name(preset);
+        t_atom at[1];
+        SETSYMBOL(&at[0], gensym(pname));
+        outlet_anything(x->x_info_out, gensym("pname"), 1, at);
+    }
+}
+
+static void sfont_tick(t_sfont *x){
+    t_sfload *l = x->x_pending;
+    if(!l)
+        return;
+    int state = sfload_state(l);
+    if(state == SFLOAD_LOADING){
+        clock_delay(x->x_clock, SFLOAD_POLL);
+        return;
+    }
+    x->x_pending = NULL;
+    if(state == SFLOAD_READY)
+        sfont_attach(x, l->l_sfont, x->x_pendname);
+    else
+        pd_error(x, "[sfont~]: couldn't load %s", l->l_path);
+    freebytes(l, sizeof(*l));
+}
+
 static void fluid_do_load(t_sfont *x, t_symbol *name){
     const char* filename = name->s_name;
     const char* ext = strrchr(filename, '.');
@@ -500,24 +622,18 @@ static void fluid_do_load(t_sfont *x, t_symbol *name){
         }
     }
     sys_close(fd);
-    chdir(realdir);
-    int id = fluid_synth_sfload(x->x_synth, realname, 0);
-    if(id >= 0){
-        fluid_synth_program_reset(x->x_synth);
-        x->x_sfont = fluid_synth_get_sfont_by_id(x->x_synth, id);
-        x->x_sfname = name;
-        if(x->x_verbosity)
-            sfont_info(x);
-        fluid_preset_t* preset = fluid_sfont_get_preset(x->x_sfont, x->x_bank = 0, x->x_pgm = 0);
-        if(preset){
-            const char* pname = fluid_preset_get_name(preset);
-            t_atom at[1];
-            SETSYMBOL(&at[0], gensym(pname));
-            outlet_anything(x->x_info_out, gensym("pname"), 1, at);
-        }
+    char path[MAXPDSTRING];
+    snprintf(path, MAXPDSTRING, "%s/%s", realdir, realname);
+    t_sfload *l = sfload_start(path);
+    if(!l){
+        pd_error(x, "[sfont~]: couldn't load %s", path);
+        return;
     }
-    else
-        post("[sfont~]: couldn't load %d", realname);
+    if(x->x_pending && !sfload_abandon(x->x_pending))
+        sfont_tick(x); // it's done, take it anyway
+    x->x_pending = l; // the last request wins
+    x->x_pendname = name;
+    sfont_tick(x);
 }
 
 static void sfont_readhook(t_pd *z, t_symbol *fn, int ac, t_atom *av){
@@ -551,12 +667,19 @@ static void sfont_dsp(t_sfont *x, t_signal **sp){
 }
 
 static void sfont_free(t_sfont *x){
-    if(x->x_synth)
+    t_sfload *l = x->x_pending;
+    if(l && !sfload_abandon(l)){
+        if(l->l_sfont && x->x_synth) // so it goes with the synth
+            fluid_synth_add_sfont(x->x_synth, l->l_sfont);
+        freebytes(l, sizeof(*l));
+    }
+    if(x->x_synth) // deletes the fonts with it
         delete_fluid_synth(x->x_synth);
     if(x->x_settings)
         delete_fluid_settings(x->x_settings);
     if(x->x_elsefilehandle)
         elsefile_free(x->x_elsefilehandle);
+    clock_free(x->x_clock);
 }
 
 static void *sfont_new(t_symbol *s, int ac, t_atom *av){
@@ -566,6 +689,9 @@ static void *sfont_new(t_symbol *s, int ac, t_atom *av){
     x->x_synth = NULL;
     x->x_settings = NULL;
     x->x_sfname = NULL;
+    x->x_sfont = NULL;
+    x->x_pending = NULL;
+    x->x_clock = clock_new(x, (t_method)sfont_tick);
     x->x_tune_name = gensym("custom-tuning");
     x->x_base = 60;
     x->x_tune_ch = 1;
@@ -582,7 +708,7 @@ static void *sfont_new(t_symbol *s, int ac, t_atom *av){
         return(NULL);
     }
     x->x_ch = 16;
-    int arg = 0;
+    int arg = 0, cores = 1;
     double g = 0.4;
     t_symbol *filename = NULL;
     while(ac){
@@ -606,6 +732,16 @@ static void *sfont_new(t_symbol *s, int ac, t_atom *av){
                 else
                     goto errstate;
             }
+            else if(sym == gensym("-cores") && !arg){
+                ac--, av++;
+                if(ac && av->a_type == A_FLOAT){
+                    int n = atom_getfloatarg(0, ac, av);
+                    cores = n < 1 ? 1 : n > 256 ? 256 : n;
+                    ac--, av++;
+                }
+                else
+                    goto errstate;
+            }
             else if(sym == gensym("-g") && !arg){
                 ac--, av++;
                 if(ac && av->a_type == A_FLOAT){
@@ -633,6 +769,12 @@ static void *sfont_new(t_symbol *s, int ac, t_atom *av){
     fluid_settings_setint(x->x_settings, "synth.ladspa.active", 0);
     fluid_settings_setint(x->x_settings, "synth.midi-channels", x->x_ch);
     fluid_settings_setnum(x->x_settings, "synth.gain", g);
+    // with more than one core, fluidsynth renders the voices in worker threads while
+    // perform waits for them, so dense parts are spread over the cores
+    fluid_settings_setint(x->x_settings, "synth.cpu-cores", cores);
+    // only pd's thread talks to the synth, events reach the mixer through fluidsynth's
+    // lock free queue without taking the api mutex on every call
+    fluid_settings_setint(x->x_settings, "synth.threadsafe-api", 0);
     fluid_settings_setnum(x->x_settings, "synth.sample-rate", sys_getsr());
     fluid_settings_setnum(x->x_settings, "synth.sample-rate", sys_getsr());
 //  fluid_settings_setint(x->x_settings, "synth.polyphony", 256);
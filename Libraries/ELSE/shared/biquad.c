@@ -0,0 +1,69 @@
+// biquad sections for ELSE's filters
+
+#include "m_pd.h"
+#include "biquad.h"
+
+void biquad_run(t_biquad *b, const double *coef, const t_float *in, t_float *out, int n){
+    double fb1 = coef[0], fb2 = coef[1], ff1 = coef[2], ff2 = coef[3], ff3 = coef[4];
+    double xnm1 = b->b_xnm1, xnm2 = b->b_xnm2, ynm1 = b->b_ynm1, ynm2 = b->b_ynm2;
+    for(int i = 0; i < n; i++){
+        double xn = in[i];
+        double yn = ff1 * xn + ff2 * xnm1 + ff3 * xnm2 + fb1 * ynm1 + fb2 * ynm2;
+        out[i] = yn;
+        xnm2 = xnm1;
+        xnm1 = xn;
+        ynm2 = ynm1;
+        ynm1 = yn;
+    }
+    b->b_xnm1 = xnm1, b->b_xnm2 = xnm2, b->b_ynm1 = ynm1, b->b_ynm2 = ynm2;
+}
+
+void biquad_run_double(t_biquad *b, const double *coef, const double *in, double *out, int n){
+    double fb1 = coef[0], fb2 = coef[1], ff1 = coef[2], ff2 = coef[3], ff3 = coef[4];
+    double xnm1 = b->b_xnm1, xnm2 = b->b_xnm2, ynm1 = b->b_ynm1, ynm2 = b->b_ynm2;
+    for(int i = 0; i < n; i++){
+        double xn = in[i];
+        double yn = ff1 * xn + ff2 * xnm1 + ff3 * xnm2 + fb1 * ynm1 + fb2 * ynm2;
+        out[i] = yn;
+        xnm2 = xnm1;
+        xnm1 = xn;
+        ynm2 = ynm1;
+        ynm1 = yn;
+    }
+    b->b_xnm1 = xnm1, b->b_xnm2 = xnm2, b->b_ynm1 = ynm1, b->b_ynm2 = ynm2;
+}
+
+void biquad_ramp(t_biquad *b, const double *from, const double *to, const t_float *in,
+t_float *out, int n){
+    double c[biquad_NCOEFS], inc[biquad_NCOEFS];
+    for(int k = 0; k < biquad_NCOEFS; k++){
+        c[k] = from[k];
+        inc[k] = (to[k] - from[k]) / n;
+    }
+    double xnm1 = b->b_xnm1, xnm2 = b->b_xnm2, ynm1 = b->b_ynm1, ynm2 = b->b_ynm2;
+    for(int i = 0; i < n; i++){
+        for(int k = 0; k < biquad_NCOEFS; k++)
+            c[k] += inc[k];
+        double xn = in[i];
+        double yn = c[2] * xn + c[3] * xnm1 + c[4] * xnm2 + c[0] * ynm1 + c[1] * ynm2;
+        out[i] = yn;
+        xnm2 = xnm1;
+        xnm1 = xn;
+        ynm2 = ynm1;
+        ynm1 = yn;
+    }
+    b->b_xnm1 = xnm1, b->b_xnm2 = xnm2, b->b_ynm1 = ynm1, b->b_ynm2 = ynm2;
+}
+
+void biquad_block(t_biquad *b, const double *from, const double *to, int rate, const t_float *in,
+t_float *out, int n){
+    if(!to)
+        biquad_run(b, from, in, out, n);
+    else if(rate > 1){
+        int m = rate < n ? rate : n;
+        biquad_ramp(b, from, to, in, out, m);
+        biquad_run(b, to, in + m, out + m, n - m);
+    }
+    else
+        biquad_run(b, to, in, out, n);
+}
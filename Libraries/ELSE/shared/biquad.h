@@ -0,0 +1,30 @@
+// biquad sections for ELSE's filters
+// coefficients are in the order of pd's [biquad~]: fb1, fb2, ff1, ff2, ff3, so
+// y[n] = ff1*x[n] + ff2*x[n-1] + ff3*x[n-2] + fb1*y[n-1] + fb2*y[n-2]
+
+#ifndef __biquad_H__
+#define __biquad_H__
+
+#define biquad_NCOEFS 5
+
+typedef struct _biquad{
+    double  b_xnm1;
+    double  b_xnm2;
+    double  b_ynm1;
+    double  b_ynm2;
+}t_biquad;
+
+// in and out may be the same vector
+void biquad_run(t_biquad *b, const double *coef, const t_float *in, t_float *out, int n);
+// the same on doubles, for cascades that keep the signal in double between sections
+void biquad_run_double(t_biquad *b, const double *coef, const double *in, double *out, int n);
+// coefficients glide linearly from 'from' so that the last of the n samples uses 'to'
+void biquad_ramp(t_biquad *b, const double *from, const double *to, const t_float *in,
+    t_float *out, int n);
+// a block whose coefficients change from 'from' to 'to' at its start, or not at all when 'to' is NULL,
+// the same as the per-sample paths of the filters give for parameters that are constant over the block:
+// with rate > 1 they glide over the first rate samples, otherwise 'to' is used from the first sample on
+void biquad_block(t_biquad *b, const double *from, const double *to, int rate, const t_float *in,
+    t_float *out, int n);
+
+#endif
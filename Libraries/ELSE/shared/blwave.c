@@ -0,0 +1,68 @@
+
+#include "m_pd.h"
+#include "blwave.h"
+#include <math.h>
+
+#define PI     3.1415926535897931
+#define TWO_PI 6.2831853071795862
+
+// each table has a guard point for the interpolation
+static t_float blwave_tables[blwave_NTABLES][blwave_SIZE + 1];
+static int blwave_ready;
+
+void blwave_init(void){
+    if(blwave_ready)
+        return;
+    static double sine[blwave_SIZE], sum[blwave_SIZE];
+    int i, h = 512, t;
+    for(i = 0; i < blwave_SIZE; i++){
+        sine[i] = sin(TWO_PI * i / blwave_SIZE);
+        sum[i] = 0;
+    }
+    // from the sine up, every table adds the harmonics the one after it doesn't have
+    int have = 0;
+    for(t = blwave_NTABLES - 1; t >= 0; t--){
+        int nharm = h >> t;
+        for(int k = have + 1; k <= nharm; k++){
+            double amp = 2. / (PI * k); // 1 - 2 * phase = sum of sin(2pi * k * phase) * 2 / (pi * k)
+            for(i = 0; i < blwave_SIZE; i++)
+                sum[i] += amp * sine[(i * k) % blwave_SIZE];
+        }
+        have = nharm;
+        for(i = 0; i < blwave_SIZE; i++)
+            blwave_tables[t][i] = (t_float)sum[i];
+        blwave_tables[t][blwave_SIZE] = blwave_tables[t][0];
+    }
+    blwave_ready = 1;
+}
+
+void blwave_reset(t_blwave *w){
+    w->w_dt = -1;
+    blwave_setdt(w, 0);
+}
+
+void blwave_setdt(t_blwave *w, t_float dt){
+    if(dt < 0)
+        dt = -dt;
+    if(dt == w->w_dt)
+        return;
+    w->w_dt = dt;
+    // table t has 512 >> t harmonics, which stay below nyquist up to dt = 2^t / 1024,
+    // over each octave the tables fade to the next one so the timbre doesn't jump
+    double octave = dt > 0 ? log2(dt * 1024.) : -2;
+    double below = floor(octave);
+    int t = (int)below + 1;
+    if(t < 0){
+        w->w_lo = w->w_hi = blwave_tables[0];
+        w->w_fade = 0;
+    }
+    else if(t >= blwave_NTABLES - 1){
+        w->w_lo = w->w_hi = blwave_tables[blwave_NTABLES - 1];
+        w->w_fade = 0;
+    }
+    else{
+        w->w_lo = blwave_tables[t];
+        w->w_hi = blwave_tables[t + 1];
+        w->w_fade = (t_float)(octave - below);
+    }
+}
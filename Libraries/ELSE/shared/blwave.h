@@ -0,0 +1,32 @@
+// band-limited saw wavetables, one per octave, shared by every oscillator that reads them
+
+#ifndef __blwave_H__
+#define __blwave_H__
+
+#define blwave_SIZE    2048 // points per period
+#define blwave_NTABLES 10   // 512 harmonics in the first, half as many in each next one
+
+// a reader's choice of tables, only redone when the phase increment changes
+typedef struct _blwave{
+    t_float  w_dt;
+    t_float *w_lo;   // the table with the most harmonics that can't alias
+    t_float *w_hi;   // the next one, faded in towards the top of the octave
+    t_float  w_fade;
+}t_blwave;
+
+// builds the tables once for the whole process, call from the class setup
+void blwave_init(void);
+void blwave_reset(t_blwave *w);
+void blwave_setdt(t_blwave *w, t_float dt);
+
+// a saw falling from 1 to -1 over the period, band-limited for the increment of the last setdt
+static inline t_float blwave_saw(const t_blwave *w, t_float phase){
+    t_float pos = phase * blwave_SIZE;
+    int i = (int)pos;
+    t_float frac = pos - i;
+    t_float lo = w->w_lo[i] + frac * (w->w_lo[i+1] - w->w_lo[i]);
+    t_float hi = w->w_hi[i] + frac * (w->w_hi[i+1] - w->w_hi[i]);
+    return(lo + w->w_fade * (hi - lo));
+}
+
+#endif
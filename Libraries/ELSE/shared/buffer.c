@@ -29,16 +29,20 @@ t_word *buffer_get(t_buffer *c, t_symbol * name, int *bufsize, int indsp, int co
     return (0);
 }
 
+// bumps the epoch if the vectors or the size differ from the old ones
+static void buffer_publish(t_buffer *c, t_word **old, int oldnpts){
+    if(c->c_npts != oldnpts || memcmp(old, c->c_vectors, c->c_numchans * sizeof(*old)))
+        c->c_epoch++;
+}
+
 //making peek~ work with channel number choosing, assuming 1-indexed
-void buffer_getchannel(t_buffer *c, int chan_num, int complain){
+static void buffer_dogetchannel(t_buffer *c, int chan_num, int complain){
     int chan_idx;
     char buf[MAXPDSTRING];
-    t_symbol * curname; //name of the current channel we want
     int vsz = c->c_npts;  
     t_word *retvec = NULL;//pointer to the corresponding channel to return
     //1-indexed bounds checking
     chan_num = chan_num < 1 ? 1 : (chan_num > buffer_MAXCHANS ? buffer_MAXCHANS : chan_num);
-    c->c_single = chan_num;
     //convert to 0-indexing, separate steps and diff variable for sanity's sake
     chan_idx = chan_num - 1;
     //making the buffer channel name string we'll be looking for
@@ -48,20 +52,33 @@ void buffer_getchannel(t_buffer *c, int chan_num, int complain){
             //since checking for 0-bufname as well, don't complain here
             retvec = buffer_get(c, c->c_bufname, &vsz, 1, 0);
             if(retvec){
+                c->c_single = chan_num;
                 c->c_vectors[0] = retvec;
                 if (vsz < c->c_npts) c->c_npts = vsz;
                 return;
             };
         };
-        sprintf(buf, "%d-%s", chan_idx, c->c_bufname->s_name);
-        curname =  gensym(buf);
-        retvec = buffer_get(c, curname, &vsz, 1, complain);
+        // this runs every block for poke~, only build the name when it changes
+        if(!c->c_singlename || c->c_singlefor != c->c_bufname || c->c_single != chan_num){
+            sprintf(buf, "%d-%s", chan_idx, c->c_bufname->s_name);
+            c->c_singlename = gensym(buf);
+            c->c_singlefor = c->c_bufname;
+        }
+        c->c_single = chan_num;
+        retvec = buffer_get(c, c->c_singlename, &vsz, 1, complain);
         //if channel found and less than c_npts, reset c_npts
         if (vsz < c->c_npts) c->c_npts = vsz;
         c->c_vectors[0] = retvec;
         return;
     };
+    c->c_single = chan_num;
+}
 
+void buffer_getchannel(t_buffer *c, int chan_num, int complain){
+    t_word *old = c->c_vectors[0];
+    int oldnpts = c->c_npts;
+    buffer_dogetchannel(c, chan_num, complain);
+    buffer_publish(c, &old, oldnpts);
 }
 
 void buffer_bug(char *fmt, ...){ // from loud.c
@@ -130,6 +147,9 @@ void buffer_redraw(t_buffer *c){
 }
 
 void buffer_validate(t_buffer *c, int complain){
+    t_word *old[buffer_MAXCHANS];
+    int oldnpts = c->c_npts;
+    memcpy(old, c->c_vectors, c->c_numchans * sizeof(*old));
     buffer_clear(c);
     c->c_npts = SHARED_INT_MAX;
     if(!c->c_single){
@@ -155,9 +175,10 @@ void buffer_validate(t_buffer *c, int complain){
         };
     }
     else
-        buffer_getchannel(c, c->c_single, complain);
+        buffer_dogetchannel(c, c->c_single, complain);
     if(c->c_npts == SHARED_INT_MAX)
         c->c_npts = 0;
+    buffer_publish(c, old, oldnpts);
 }
 
 void buffer_playcheck(t_buffer *c){
@@ -192,7 +213,46 @@ void buffer_setminsize(t_buffer *c, int i){
 void buffer_checkdsp(t_buffer *c){
     buffer_validate(c, 1);
     buffer_playcheck(c);
+    c->c_fadelen = (int)(sys_getsr() * buffer_DECLICKMS * 0.001);
+}
 
+int buffer_sync(t_buffer *c){
+    unsigned int epoch = c->c_epoch;
+    buffer_validate(c, 0);
+    buffer_playcheck(c);
+    return(c->c_epoch != epoch);
+}
+
+void buffer_declick(t_buffer *c, t_float **outs, int nch, int n){
+    if(c->c_seen != c->c_epoch){
+        c->c_seen = c->c_epoch;
+        c->c_fade = c->c_fadelen;
+    }
+    if(nch > c->c_numchans)
+        nch = c->c_numchans;
+    for(int ch = 0; ch < nch; ch++){
+        t_float *out = outs[ch];
+        t_float last = c->c_last[ch];
+        for(int i = 0; i < n && i < c->c_fade; i++){
+            t_float gain = (t_float)(c->c_fade - i) / (t_float)c->c_fadelen;
+            out[i] += gain * (last - out[i]);
+        }
+        c->c_last[ch] = out[n-1];
+    }
+    c->c_fade = c->c_fade > n ? c->c_fade - n : 0;
+}
+
+void buffer_interp4(t_word *vec, int const *ndx, double const *frac, t_float *out, int n){
+    double a[buffer_INTERPBLOCK], b[buffer_INTERPBLOCK], c[buffer_INTERPBLOCK], d[buffer_INTERPBLOCK];
+    int i;
+    for(i = 0; i < n; i++, ndx += 4){
+        a[i] = vec[ndx[0]].w_float;
+        b[i] = vec[ndx[1]].w_float;
+        c[i] = vec[ndx[2]].w_float;
+        d[i] = vec[ndx[3]].w_float;
+    }
+    for(i = 0; i < n; i++)
+        out[i] = (t_float)buffer_LAGRANGE4(a[i], b[i], c[i], d[i], frac[i]);
 }
 
 void buffer_free(t_buffer *c){
@@ -200,6 +260,8 @@ void buffer_free(t_buffer *c){
         freebytes(c->c_vectors, c->c_numchans * sizeof(*c->c_vectors));
     if (c->c_channames)
         freebytes(c->c_channames, c->c_numchans * sizeof(*c->c_channames));
+    if (c->c_last)
+        freebytes(c->c_last, c->c_numchans * sizeof(*c->c_last));
     freebytes(c, sizeof(t_buffer));
 }
 
@@ -224,6 +286,7 @@ void *buffer_init(t_class *owner, t_symbol *bufname, int numchans, int singlemod
 		freebytes(vectors, numchans * sizeof(*vectors));
         return(0);
     };
+    c->c_last = (t_float *)getbytes(numchans * sizeof(*c->c_last));
     c->c_single = singlemode;
     c->c_owner = owner;
     c->c_npts = 0;
@@ -233,6 +296,9 @@ void *buffer_init(t_class *owner, t_symbol *bufname, int numchans, int singlemod
     c->c_playable = 0;
     c->c_minsize = 1;
     c->c_numchans = numchans;
+    c->c_singlename = c->c_singlefor = 0;
+    c->c_epoch = c->c_seen = 0;
+    c->c_fade = c->c_fadelen = 0;
     if(bufname != &s_)
         buffer_initarray(c, bufname, 0);
     return(c);
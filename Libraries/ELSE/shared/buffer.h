@@ -9,6 +9,7 @@
 #endif
 
 #define buffer_MAXCHANS 64 //max number of channels
+#define buffer_DECLICKMS 5  //crossfade when the arrays are swapped under a player
 
 typedef struct _buffer{
     //t_sic       s_sic;
@@ -26,6 +27,16 @@ typedef struct _buffer{
     int         c_single; //flag for single channel mode
                         //0-regular mode, 1-load this particular channel (1-idx)
                         //should be used with c_numchans == 1
+    t_symbol   *c_singlename; //array name of c_single, so it's not rebuilt every block
+    t_symbol   *c_singlefor;  //c_bufname that c_singlename was built for
+    // c_vectors and c_npts are a snapshot, only replaced while validating. c_epoch
+    // changes when a validation finds other vectors or another size, readers use it
+    // to notice the arrays were resized or reloaded and declick the swap
+    unsigned int c_epoch;
+    unsigned int c_seen;    //epoch the declick has last seen
+    int         c_fade;     //samples left of the declick ramp
+    int         c_fadelen;
+    t_float    *c_last;     //last output of each channel, the ramp starts from it
 }t_buffer;
 
 void buffer_bug(char *fmt, ...);
@@ -55,4 +66,23 @@ void buffer_free(t_buffer *c);
 void buffer_checkdsp(t_buffer *c);
 void buffer_getchannel(t_buffer *c, int chan_num, int complain);
 
+//once per block from perform routines, instead of buffer_validate: revalidates
+//quietly and returns nonzero if a new snapshot was published
+int buffer_sync(t_buffer *c);
+//at the end of a player's perform routine: after a swap, crossfades the outputs
+//from the last samples played before it
+void buffer_declick(t_buffer *c, t_float **outs, int nch, int n);
+
+//4-point lagrange interpolation between b and c, f is the fraction from b
+#define buffer_LAGRANGE4(a, b, c, d, f) \
+    ((b) + (f)*(((c)-(b)) - (1.-(f))/6. * (((d)-(a)-3.0*((c)-(b)))*(f) + (d) + 2.0*(a) - 3.0*(b))))
+
+//reads per call of buffer_interp4
+#define buffer_INTERPBLOCK 64
+
+//interpolates n reads of vec (n <= buffer_INTERPBLOCK), ndx has the 4 indexes of each read
+//(the point before, at, and the two after the read position) and frac its fraction.
+//gathers the points first, so the arithmetic runs in a loop the compiler can vectorize
+void buffer_interp4(t_word *vec, int const *ndx, double const *frac, t_float *out, int n);
+
 #endif
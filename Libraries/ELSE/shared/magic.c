@@ -15,6 +15,12 @@ int magic_inlet_connection(t_object *x, t_glist *glist, int inno, t_symbol *outs
     return (0);
 }
 
+t_float *magic_inlet_scalar(t_object *x, t_glist *glist, int inno){
+    if(!glist || magic_inlet_connection(x, glist, inno, &s_signal))
+        return(NULL);
+    return(obj_findsignalscalar(x, inno));
+}
+
 void magic_setnan(t_float *in) {
 	union magic_ui32_fl input_u;
 	input_u.uif_uint32 = MAGIC_NAN;
@@ -9,6 +9,23 @@ union magic_ui32_fl{
 
 int magic_inlet_connection(t_object *x, t_glist *glist, int inno, t_symbol *outsym);
 
+// the value of signal inlet 'inno' when no signal is connected to it, NULL when one is; call it in the
+// dsp method, then a perform routine can read the value once per block instead of pd's copy of it.
+// Only for objects whose inlets are all signal inlets, pd counts the others differently
+t_float *magic_inlet_scalar(t_object *x, t_glist *glist, int inno);
+
 void magic_setnan (t_float *in);
 int magic_isnan (t_float in);
 
+
+// multichannel connections, for pd versions that have them (0.54 on), signals have
+// one channel otherwise and pd sets up the outlets as always
+#ifdef CLASS_MULTICHANNEL
+#define MAGIC_MULTICHANNEL CLASS_MULTICHANNEL
+#define magic_nchans(sig) ((sig)->s_nchans)
+#define magic_setmultiout(sig, nchans) signal_setmultiout(sig, nchans)
+#else
+#define MAGIC_MULTICHANNEL 0
+#define magic_nchans(sig) 1
+#define magic_setmultiout(sig, nchans)
+#endif
@@ -67,9 +67,29 @@ uint32_t random_trand(uint32_t *s1, uint32_t *s2, uint32_t *s3){
 
 float random_frand(uint32_t *s1, uint32_t *s2, uint32_t *s3){
     // return a float from -1.0 to +0.999...
-    union { uint32_t i; float f; } u; // union for floating point conversion of result
-    u.i = 0x40000000 | (random_trand(s1, s2, s3) >> 9);
-    return(u.f - 3.f);
+    return(random_tofloat(random_trand(s1, s2, s3)));
+}
+
+void random_trand_block(t_random_state *rstate, uint32_t *out, int n){
+    uint32_t s1 = rstate->s1, s2 = rstate->s2, s3 = rstate->s3;
+    for(int i = 0; i < n; i++){
+        s1 = ((s1 & (uint32_t)- 2) << 12) ^ (((s1 << 13) ^ s1) >> 19);
+        s2 = ((s2 & (uint32_t)- 8) <<  4) ^ (((s2 <<  2) ^ s2) >> 25);
+        s3 = ((s3 & (uint32_t)-16) << 17) ^ (((s3 <<  3) ^ s3) >> 11);
+        out[i] = s1 ^ s2 ^ s3;
+    }
+    rstate->s1 = s1, rstate->s2 = s2, rstate->s3 = s3;
+}
+
+void random_frand_block(t_random_state *rstate, t_sample *out, int n){
+    uint32_t s1 = rstate->s1, s2 = rstate->s2, s3 = rstate->s3;
+    for(int i = 0; i < n; i++){
+        s1 = ((s1 & (uint32_t)- 2) << 12) ^ (((s1 << 13) ^ s1) >> 19);
+        s2 = ((s2 & (uint32_t)- 8) <<  4) ^ (((s2 <<  2) ^ s2) >> 25);
+        s3 = ((s3 & (uint32_t)-16) << 17) ^ (((s3 <<  3) ^ s3) >> 11);
+        out[i] = random_tofloat(s1 ^ s2 ^ s3);
+    }
+    rstate->s1 = s1, rstate->s2 = s2, rstate->s3 = s3;
 }
 
 int32_t random_hash(int32_t inKey){
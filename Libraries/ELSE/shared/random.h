@@ -15,9 +15,21 @@ void random_init(t_random_state* rstate, int seed);
 int get_seed(t_symbol *s, int ac, t_atom *av, int n);
 uint32_t random_trand(uint32_t* s1, uint32_t* s2, uint32_t* s3);
 float random_frand(uint32_t* s1, uint32_t* s2, uint32_t* s3);
+// Same numbers as n calls of random_trand/random_frand, with the state kept in registers
+void random_trand_block(t_random_state* rstate, uint32_t* out, int n);
+void random_frand_block(t_random_state* rstate, t_sample* out, int n);
 int rand_int(unsigned int *statep, int range);
 void rand_seed(unsigned int *statep, unsigned int seed);
 
+// Samples per call when a perform routine fills a buffer of its own
+#define random_BLOCK 64
+
+// The float from -1.0 to +0.999... that random_frand makes of a random word
+static inline float random_tofloat(uint32_t r){
+    union { uint32_t i; float f; } u; // union for floating point conversion of result
+    u.i = 0x40000000 | (r >> 9);
+    return(u.f - 3.f);
+}
 // These are for [pink~]
 
 #if defined(__GNUC__)
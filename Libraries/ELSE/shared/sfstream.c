@@ -0,0 +1,351 @@
+#include "m_pd.h"
+#include "sfstream.h"
+#include <string.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#define sfstream_sleep(ms) Sleep(ms)
+#define sfstream_seekfile(fp, pos) _fseeki64(fp, pos, SEEK_SET)
+#define sfstream_tellfile(fp) _ftelli64(fp)
+#else
+#include <unistd.h>
+#define sfstream_sleep(ms) usleep((ms) * 1000)
+#define sfstream_seekfile(fp, pos) fseeko(fp, pos, SEEK_SET)
+#define sfstream_tellfile(fp) ftello(fp)
+#endif
+
+// everything the owner and the reader share goes through these
+#ifdef _MSC_VER
+#define sfstream_load(p) InterlockedOr64((volatile LONG64 *)(p), 0)
+#define sfstream_store(p, v) InterlockedExchange64((volatile LONG64 *)(p), (v))
+#define sfstream_fence() MemoryBarrier()
+#else
+#define sfstream_load(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define sfstream_store(p, v) __atomic_store_n(p, (long long)(v), __ATOMIC_RELEASE)
+#define sfstream_fence() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+#define SFSTREAM_MASK   (SFSTREAM_RINGSIZE - 1)
+#define SFSTREAM_CHUNK  4096    // frames read at once
+
+// only held to add to sfstream_new, never while reading
+static pthread_mutex_t sfstream_listmutex = PTHREAD_MUTEX_INITIALIZER;
+static t_sfstream *sfstream_new; // opened, not picked up by the reader yet
+static int sfstream_running;
+
+// WAV data is little endian, so is every platform we build for
+static void sfstream_convert(t_sfstream *s, unsigned char *raw, float *out, int nsamples){
+    int i;
+    if(s->s_float){
+        if(s->s_bytes == 4){
+            memcpy(out, raw, nsamples * sizeof(float));
+        }
+        else for(i = 0; i < nsamples; i++){
+            double d;
+            memcpy(&d, raw + 8 * i, sizeof(double));
+            out[i] = (float)d;
+        }
+        return;
+    }
+    switch(s->s_bytes){
+        case 1:
+            for(i = 0; i < nsamples; i++)
+                out[i] = ((int)raw[i] - 128) * (1.f / 128.f);
+            break;
+        case 2:
+            for(i = 0; i < nsamples; i++, raw += 2)
+                out[i] = (short)(raw[0] | (raw[1] << 8)) * (1.f / 32768.f);
+            break;
+        case 3:
+            for(i = 0; i < nsamples; i++, raw += 3)
+                out[i] = (int)(((unsigned int)raw[0] << 8) | ((unsigned int)raw[1] << 16) |
+                    ((unsigned int)raw[2] << 24)) * (1.f / 2147483648.f);
+            break;
+        default:
+            for(i = 0; i < nsamples; i++, raw += 4)
+                out[i] = (int)((unsigned int)raw[0] | ((unsigned int)raw[1] << 8) |
+                    ((unsigned int)raw[2] << 16) | ((unsigned int)raw[3] << 24)) * (1.f / 2147483648.f);
+            break;
+    }
+}
+
+static int sfstream_read(t_sfstream *s, long long pos, long long n, float *out){
+    int framesize = s->s_nch * s->s_bytes;
+    if(sfstream_seekfile(s->s_fp, s->s_dataoffset + pos * framesize))
+        return(0);
+    n = (long long)fread(s->s_raw, framesize, (size_t)n, s->s_fp);
+    if(n <= 0)
+        return(0);
+    sfstream_convert(s, s->s_raw, out, (int)n * s->s_nch);
+    return((int)n);
+}
+
+// reads one chunk if there's room, returns 1 if it did
+static int sfstream_fill(t_sfstream *s){
+    if(!s->s_headdone){ // the head cache comes first
+        long long headframes = s->s_headframes, n = s->s_headsize - headframes;
+        if(n > SFSTREAM_CHUNK)
+            n = SFSTREAM_CHUNK;
+        if(n > 0 && (n = sfstream_read(s, headframes, n, s->s_head + headframes * s->s_nch)))
+            sfstream_store(&s->s_headframes, headframes + n);
+        else // done, or the file is shorter than it said
+            s->s_headdone = 1;
+        return(1);
+    }
+    long long gen = sfstream_load(&s->s_reqseq);
+    if(gen & 1)
+        return(0); // the owner is writing a request
+    long long start = sfstream_load(&s->s_start);
+    long long loopstart = sfstream_load(&s->s_loopstart), loopend = sfstream_load(&s->s_loopend);
+    long long loop = sfstream_load(&s->s_loop);
+    long long consumed = sfstream_load(&s->s_consumed);
+    sfstream_fence();
+    if(sfstream_load(&s->s_reqseq) != gen)
+        return(0); // changed while we read it, next time
+    if(s->s_readgen != gen){
+        s->s_readgen = gen;
+        s->s_filled = 0;
+        s->s_filepos = start;
+        // reset before the owner can see the new request acknowledged
+        sfstream_store(&s->s_written, 0);
+        sfstream_store(&s->s_ack, gen);
+    }
+    long long written = s->s_filled;
+    long long space = SFSTREAM_RINGSIZE - (written - consumed);
+    long long pos = s->s_filepos;
+    if(pos >= loopend){
+        if(!loop || loopend <= loopstart)
+            return(0); // nothing left to read
+        pos = loopstart;
+    }
+    long long n = SFSTREAM_CHUNK;
+    if(n > space)
+        n = space;
+    if(n > loopend - pos)
+        n = loopend - pos;
+    if(n > SFSTREAM_RINGSIZE - (written & SFSTREAM_MASK))
+        n = SFSTREAM_RINGSIZE - (written & SFSTREAM_MASK);
+    if(n < SFSTREAM_CHUNK && n < loopend - pos && space < SFSTREAM_CHUNK)
+        return(0); // wait until a whole chunk fits
+    n = sfstream_read(s, pos, n, s->s_ring + (written & SFSTREAM_MASK) * s->s_nch);
+    if(!n)
+        return(0);
+    if(sfstream_load(&s->s_reqseq) == gen){ // or it was for a position nobody wants anymore
+        s->s_filled = written + n;
+        s->s_filepos = pos + n;
+        sfstream_store(&s->s_written, s->s_filled);
+    }
+    return(1);
+}
+
+static void sfstream_free(t_sfstream *s){
+    fclose(s->s_fp);
+    freebytes(s->s_ring, SFSTREAM_RINGSIZE * s->s_nch * sizeof(float));
+    freebytes(s->s_raw, SFSTREAM_CHUNK * s->s_nch * s->s_bytes);
+    freebytes(s->s_head, (s->s_headsize ? s->s_headsize : 1) * s->s_nch * sizeof(float));
+    freebytes(s, sizeof(t_sfstream));
+}
+
+// the list is the reader's own, it frees closed streams and stops when there are none
+static void *sfstream_thread(void *arg){
+    t_sfstream *list = NULL;
+    while(1){
+        int busy = 0;
+        pthread_mutex_lock(&sfstream_listmutex);
+        while(sfstream_new){
+            t_sfstream *s = sfstream_new;
+            sfstream_new = s->s_next;
+            s->s_next = list;
+            list = s;
+        }
+        if(!list){
+            sfstream_running = 0;
+            pthread_mutex_unlock(&sfstream_listmutex);
+            return(NULL);
+        }
+        pthread_mutex_unlock(&sfstream_listmutex);
+        for(t_sfstream **sp = &list; *sp;){
+            t_sfstream *s = *sp;
+            if(sfstream_load(&s->s_closed)){
+                *sp = s->s_next;
+                sfstream_free(s);
+                continue;
+            }
+            busy |= sfstream_fill(s);
+            sp = &s->s_next;
+        }
+        if(!busy)
+            sfstream_sleep(2);
+    }
+}
+
+static unsigned int sfstream_u16(unsigned char *p){
+    return(p[0] | (p[1] << 8));
+}
+
+static unsigned int sfstream_u32(unsigned char *p){
+    return(p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24));
+}
+
+static int sfstream_readheader(t_sfstream *s, void *owner, const char *path){
+    unsigned char buf[40];
+    int format = 0, bits = 0, gotfmt = 0;
+    if(fread(buf, 1, 12, s->s_fp) != 12 || memcmp(buf, "RIFF", 4) || memcmp(buf + 8, "WAVE", 4)){
+        pd_error(owner, "%s: not a WAV file", path);
+        return(0);
+    }
+    while(fread(buf, 1, 8, s->s_fp) == 8){
+        unsigned int size = sfstream_u32(buf + 4);
+        long long next = sfstream_tellfile(s->s_fp) + size + (size & 1);
+        if(!memcmp(buf, "fmt ", 4)){
+            if(size < 16 || fread(buf, 1, size < 40 ? size : 40, s->s_fp) < 16)
+                break;
+            format = sfstream_u16(buf);
+            s->s_nch = sfstream_u16(buf + 2);
+            s->s_sr = (float)sfstream_u32(buf + 4);
+            bits = sfstream_u16(buf + 14);
+            if(format == 0xFFFE && size >= 40) // extensible, the subformat starts like a format tag
+                format = sfstream_u16(buf + 24);
+            gotfmt = 1;
+        }
+        else if(!memcmp(buf, "data", 4)){
+            long long filesize;
+            s->s_dataoffset = sfstream_tellfile(s->s_fp);
+            fseek(s->s_fp, 0, SEEK_END);
+            filesize = sfstream_tellfile(s->s_fp);
+            // the size is often wrong in files that were never finished
+            if(size == 0xFFFFFFFF || s->s_dataoffset + size > filesize)
+                size = (unsigned int)(filesize - s->s_dataoffset);
+            if(!gotfmt)
+                break;
+            s->s_bytes = bits / 8;
+            s->s_float = format == 3;
+            if(s->s_nch < 1 || (format != 1 && format != 3) || (s->s_float && s->s_bytes != 4 && s->s_bytes != 8)
+               || (!s->s_float && (s->s_bytes < 1 || s->s_bytes > 4))){
+                pd_error(owner, "%s: unsupported WAV format", path);
+                return(0);
+            }
+            s->s_nframes = size / (s->s_nch * s->s_bytes);
+            return(1);
+        }
+        if(sfstream_seekfile(s->s_fp, next))
+            break;
+    }
+    pd_error(owner, "%s: bad WAV header", path);
+    return(0);
+}
+
+t_sfstream *sfstream_open(void *owner, const char *path){
+    FILE *fp = sys_fopen(path, "rb");
+    if(!fp){
+        pd_error(owner, "%s: can't open", path);
+        return(NULL);
+    }
+    t_sfstream *s = (t_sfstream *)getbytes(sizeof(t_sfstream));
+    s->s_fp = fp;
+    if(!sfstream_readheader(s, owner, path)){
+        fclose(fp);
+        freebytes(s, sizeof(t_sfstream));
+        return(NULL);
+    }
+    s->s_ring = (float *)getbytes(SFSTREAM_RINGSIZE * s->s_nch * sizeof(float));
+    s->s_raw = (unsigned char *)getbytes(SFSTREAM_CHUNK * s->s_nch * s->s_bytes);
+    // the reader fills the head cache before anything else
+    s->s_headsize = (long long)(s->s_sr * SFSTREAM_HEADMS * 0.001f);
+    if(s->s_headsize > s->s_nframes)
+        s->s_headsize = s->s_nframes;
+    s->s_head = (float *)getbytes((s->s_headsize ? s->s_headsize : 1) * s->s_nch * sizeof(float));
+    s->s_loopend = s->s_nframes;
+    s->s_reqseq = s->s_gen = s->s_readgen = 2; // nothing to read until the first seek
+    s->s_filepos = s->s_nframes;
+    pthread_mutex_lock(&sfstream_listmutex);
+    s->s_next = sfstream_new;
+    sfstream_new = s;
+    if(!sfstream_running){
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        // nobody waits for it, it ends by itself once the last stream is closed
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if(!pthread_create(&thread, &attr, sfstream_thread, NULL))
+            sfstream_running = 1;
+        else
+            pd_error(owner, "%s: can't start the reader thread", path);
+        pthread_attr_destroy(&attr);
+    }
+    pthread_mutex_unlock(&sfstream_listmutex);
+    return(s);
+}
+
+void sfstream_close(t_sfstream *s){
+    sfstream_store(&s->s_closed, 1);
+}
+
+void sfstream_seek(t_sfstream *s, long long start, long long loopstart, long long loopend, int loop){
+    if(loopend > s->s_nframes)
+        loopend = s->s_nframes;
+    if(loopstart < 0)
+        loopstart = 0;
+    if(loopstart > loopend)
+        loopstart = loopend;
+    if(start < 0)
+        start = 0;
+    if(start >= loopend && loop && loopend > loopstart)
+        start = loopstart + (start - loopend) % (loopend - loopstart);
+    sfstream_store(&s->s_reqseq, s->s_gen + 1);
+    sfstream_fence();
+    sfstream_store(&s->s_start, start);
+    sfstream_store(&s->s_loopstart, loopstart);
+    sfstream_store(&s->s_loopend, loopend);
+    sfstream_store(&s->s_loop, loop);
+    sfstream_store(&s->s_consumed, 0);
+    sfstream_store(&s->s_reqseq, s->s_gen += 2);
+    s->s_avail = s->s_release = 0;
+}
+
+void sfstream_sync(t_sfstream *s){
+    // s_written only counts if it's for this request all along
+    if(sfstream_load(&s->s_ack) == s->s_gen){
+        long long written = sfstream_load(&s->s_written);
+        if(sfstream_load(&s->s_ack) == s->s_gen)
+            s->s_avail = written;
+    }
+    s->s_headavail = sfstream_load(&s->s_headframes);
+    if(s->s_release > s->s_consumed)
+        sfstream_store(&s->s_consumed, s->s_release);
+}
+
+long long sfstream_filepos(t_sfstream *s, long long frame){
+    long long pos = s->s_start + frame;
+    if(pos < s->s_loopend)
+        return(pos);
+    if(!s->s_loop || s->s_loopend <= s->s_loopstart)
+        return(-1);
+    return(s->s_loopstart + (pos - s->s_loopend) % (s->s_loopend - s->s_loopstart));
+}
+
+int sfstream_get(t_sfstream *s, long long frame, int ch, float *f){
+    *f = 0;
+    if(frame < 0)
+        frame = 0;
+    if(ch >= s->s_nch)
+        return(1);
+    if(frame < s->s_avail){
+        *f = s->s_ring[(frame & SFSTREAM_MASK) * s->s_nch + ch];
+        return(1);
+    }
+    long long pos = sfstream_filepos(s, frame);
+    if(pos < 0) // past the end, silence
+        return(1);
+    if(pos < s->s_headavail){
+        *f = s->s_head[pos * s->s_nch + ch];
+        return(1);
+    }
+    return(0);
+}
+
+void sfstream_release(t_sfstream *s, long long frame){
+    if(frame > s->s_release)
+        s->s_release = frame;
+}
@@ -0,0 +1,76 @@
+
+#ifndef __sfstream_H__
+#define __sfstream_H__
+
+#include <stdio.h>
+
+// Streams a WAV file from disk, for players that can't afford loading the whole file
+// into an array. One reader thread serves all streams and fills a ring buffer per stream.
+// The owner calls everything from pd's thread and never waits for the reader: they only
+// exchange positions through atomic loads and stores, and the reader never holds a lock
+// while it reads. The reader also reads the beginning of the file into a head cache
+// first, so playback from there starts as soon as that's in while it catches up.
+
+#define SFSTREAM_RINGSIZE   65536   // frames, a power of 2
+#define SFSTREAM_HEADMS     1000    // length of the head cache
+
+typedef struct _sfstream{
+    // file, fixed after opening
+    FILE               *s_fp;
+    int                 s_nch;
+    int                 s_bytes;        // bytes per sample
+    int                 s_float;        // ieee float data
+    long long           s_dataoffset;
+    long long           s_nframes;
+    float               s_sr;
+    float              *s_head;         // first frames of the file
+    long long           s_headsize;
+    float              *s_ring;
+    // requests from the owner, written between two increments of s_reqseq: it's odd
+    // while the owner writes one, so the reader can tell it only got part of it
+    long long           s_reqseq;
+    long long           s_start;        // file frame of stream frame 0
+    long long           s_loopstart;
+    long long           s_loopend;
+    long long           s_loop;
+    long long           s_consumed;     // stream frames that won't be read anymore
+    long long           s_closed;       // the reader frees the stream
+    // published by the reader
+    long long           s_ack;          // request the ring is filled for
+    long long           s_written;      // stream frames in the ring
+    long long           s_headframes;   // frames in the head cache
+    // owner side copies, only touched from pd's thread
+    long long           s_gen;          // s_reqseq of the last request
+    long long           s_avail;        // frames known to be written for s_gen
+    long long           s_headavail;
+    long long           s_release;      // consumed, not published yet
+    // reader side
+    int                 s_headdone;
+    long long           s_readgen;
+    long long           s_filled;
+    long long           s_filepos;
+    unsigned char      *s_raw;
+    struct _sfstream   *s_next;
+}t_sfstream;
+
+// opens a WAV file, returns NULL and complains through owner if that fails
+t_sfstream *sfstream_open(void *owner, const char *path);
+// hands the stream over to the reader, which closes and frees it
+void sfstream_close(t_sfstream *s);
+
+// starts streaming from file frame start, looping over [loopstart, loopend) or stopping there
+void sfstream_seek(t_sfstream *s, long long start, long long loopstart, long long loopend, int loop);
+
+// once per block, before reading: exchanges positions with the reader
+void sfstream_sync(t_sfstream *s);
+
+// file frame of stream frame, -1 when past the end
+long long sfstream_filepos(t_sfstream *s, long long frame);
+
+// sample of channel ch at stream frame, returns 0 if it's not there yet
+int sfstream_get(t_sfstream *s, long long frame, int ch, float *f);
+
+// everything before this stream frame can be dropped
+void sfstream_release(t_sfstream *s, long long frame);
+
+#endif
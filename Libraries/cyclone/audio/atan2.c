@@ -5,6 +5,7 @@
 #include <math.h>
 #include "m_pd.h"
 #include <common/api.h>
+#include "signal/fastmath.h"
 
 
 typedef struct _atan2 {
@@ -13,31 +14,50 @@ typedef struct _atan2 {
     t_inlet    *x_inlet_y;  // main 1st inlet
     t_inlet    *x_inlet_x;  // 2nd inlet
     t_outlet   *x_outlet;
+    int         x_fast;
 } t_atan2;
 
 static t_class *atan2_class;
 
 static t_int *atan2_perform(t_int *w)
 {
-    int nblock = (int)(w[1]);
-    t_float *in1 = (t_float *)(w[2]);
-    t_float *in2 = (t_float *)(w[3]);
-    t_float *out = (t_float *)(w[4]);
-    while (nblock--)
-    {
-	float f1 = *in1++;
-	float f2 = *in2++;
-	*out++ = atan2f(f1, f2);
-    }
-    return (w + 5);
+    t_atan2 *x = (t_atan2 *)(w[1]);
+    int nblock = (int)(w[2]);
+    t_float *in1 = (t_float *)(w[3]);
+    t_float *in2 = (t_float *)(w[4]);
+    t_float *out = (t_float *)(w[5]);
+    if (x->x_fast)
+        while (nblock--)
+        {
+            float f1 = *in1++;
+            float f2 = *in2++;
+            *out++ = fastmath_atan2(f1, f2);
+        }
+    else
+        while (nblock--)
+        {
+            float f1 = *in1++;
+            float f2 = *in2++;
+            *out++ = atan2f(f1, f2);
+        }
+    return (w + 6);
 }
 
 static void atan2_dsp(t_atan2 *x, t_signal **sp)
 {
-    dsp_add(atan2_perform, 4, sp[0]->s_n,
+    dsp_add(atan2_perform, 5, x, sp[0]->s_n,
         sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec);
 }
 
+static void atan2_precision(t_atan2 *x, t_symbol *s)
+{
+    int fast = fastmath_precision(s);
+    if (fast < 0)
+        pd_error(x, "atan2~: precision is 'full' or 'fast'");
+    else
+        x->x_fast = fast;
+}
+
 static void *atan2_new(t_floatarg f) // arg = x (not documented in max)
 {
     t_atan2 *x = (t_atan2 *)pd_new(atan2_class);
@@ -52,5 +72,6 @@ CYCLONE_OBJ_API void atan2_tilde_setup(void)
     atan2_class = class_new(gensym("atan2~"), (t_newmethod)atan2_new, 0,
         sizeof(t_atan2), CLASS_DEFAULT, A_DEFFLOAT, 0);
     class_addmethod(atan2_class, (t_method)atan2_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(atan2_class, (t_method)atan2_precision, gensym("precision"), A_SYMBOL, 0);
     CLASS_MAINSIGNALIN(atan2_class, t_atan2, x_input);
 }
@@ -6,9 +6,48 @@
 #include "m_pd.h"
 #include <common/api.h>
 #include "signal/cybuf.h"
+#include "x_libpd_fft.h"
 
 #define BUFFIR_DEFSIZE    0
 #define BUFFIR_MAXSIZE  4096
+/* longer kernels than this are convolved in the frequency domain, up to BUFFIR_MAXFFTSIZE */
+#define BUFFIR_MINFFTSIZE  256
+#define BUFFIR_MINFFTBLOCK  32
+#define BUFFIR_MAXFFTSIZE  (1 << 16)
+/* partitions transformed per block after the kernel changed, until all of them are */
+#define BUFFIR_CATCHUPRATE  8
+
+typedef struct _buffir_fft
+{
+    int         f_blocksize;    /* partition length, the fft is twice as long */
+    int         f_npartitions;  /* room for this many, also the length of the delay line */
+    int         f_active;       /* the delay line follows the input */
+    int         f_head;         /* slot of the newest input spectrum */
+    int         f_nplaying;     /* partitions of the kernel that is heard */
+    int         f_npending;     /* partitions of the kernel that replaces it */
+    int         f_changed;      /* the pending kernel differs from the one that is heard */
+    t_word     *f_vec;          /* kernel the pending spectra are made from */
+    int         f_off;
+    int         f_npoints;
+    t_sample   *f_kernel;       /* copy of the pending kernel, to notice changes to the array */
+    char       *f_state;        /* BUFFIR_DIRTY and BUFFIR_NEWER per partition */
+    t_sample   *f_kre;          /* spectra of the kernel that is heard, one per partition */
+    t_sample   *f_kim;
+    t_sample   *f_pre;          /* spectra of the pending kernel */
+    t_sample   *f_pim;
+    t_sample   *f_xre;          /* delay line of input spectra */
+    t_sample   *f_xim;
+    t_sample   *f_work;         /* fft buffer */
+    t_sample   *f_prev;         /* previous input block */
+    t_sample   *f_yre;          /* output spectrum */
+    t_sample   *f_yim;
+    t_sample   *f_fade;         /* output of the kernel that is replaced, while crossfading */
+} t_buffir_fft;
+
+/* the pending spectrum of a partition still has to be made from the copy of the kernel */
+#define BUFFIR_DIRTY  1
+/* the pending spectrum of a partition differs from the one that is heard */
+#define BUFFIR_NEWER  2
 
 typedef struct _buffir
 {
@@ -22,10 +61,16 @@ typedef struct _buffir
     t_float *x_histhi;
     t_float  x_histbuf[2 * BUFFIR_MAXSIZE];
     int      x_checked;
+    int      x_toolong;     /* kernel size that was cut short, reported by x_clock */
+    int      x_reported;
+    t_clock *x_clock;
+    t_buffir_fft x_fft;
 } t_buffir;
 
 static t_class *buffir_class;
 
+static void buffir_fft_reserve(t_buffir *x);
+
 static void buffir_setrange(t_buffir *x, t_floatarg f1, t_floatarg f2)
 {
     int off = (int)f1;
@@ -34,8 +79,8 @@ static void buffir_setrange(t_buffir *x, t_floatarg f1, t_floatarg f2)
 	off = 0;
     if (siz <= 0)
 	siz = BUFFIR_DEFSIZE;
-	if (siz > BUFFIR_MAXSIZE)
-	siz = BUFFIR_MAXSIZE;
+	if (siz > BUFFIR_MAXFFTSIZE)
+	siz = BUFFIR_MAXFFTSIZE;
 	pd_float((t_pd *)x->x_offlet, off);
 	pd_float((t_pd *)x->x_sizlet, siz);
 }
@@ -45,11 +90,13 @@ static void buffir_clear(t_buffir *x)
     memset(x->x_histlo, 0, 2 * BUFFIR_MAXSIZE * sizeof(*x->x_histlo));
     x->x_lohead = x->x_histlo;
     x->x_hihead = x->x_histhi = x->x_histlo + BUFFIR_MAXSIZE;
+    x->x_fft.f_active = 0;
 }
 
 static void buffir_set(t_buffir *x, t_symbol *s, t_floatarg f1, t_floatarg f2)
 {
     cybuf_setarray(x->x_cybuf, s);
+    buffir_fft_reserve(x);
     buffir_setrange(x, f1, f2);
 }
 
@@ -59,15 +106,361 @@ static void buffir_float(t_buffir *x, t_float f)
     pd_error(x, "buffir~: no method for 'float'");
 }
 
+/* Kernels that stay the same for a whole block are convolved in the frequency domain, which
+   lets them be much longer. Uniformly partitioned overlap-save: the kernel is split into
+   partitions of one dsp block, and every block the spectrum of the last two input blocks goes
+   into a delay line. The output is the sum of every delayed input spectrum times the spectrum
+   of its partition, so there is no latency. Spectra are kept as separate real and imaginary
+   arrays, which keeps the multiply-accumulate loop simple enough to be vectorised. The transforms
+   are libpd's, in pd's layout, their plan is made in the dsp method. Room for the longest kernel
+   the array allows is made there as well, and whenever the array is set, never in perform.
+   The whole kernel is compared with the array every block, which costs less than multiplying
+   its spectra, so edits are noticed right away. Partitions that changed are transformed into a
+   second set of spectra, BUFFIR_CATCHUPRATE per block so no block transforms all of a new kernel,
+   while the previous kernel keeps playing. Once every partition is done, that block crossfades
+   from the previous kernel to the new one, so a kernel is never heard half updated. */
+
+static void buffir_fft_free(t_buffir_fft *f)
+{
+    int nbins = f->f_blocksize + 1;
+    if (f->f_kernel)
+        freebytes(f->f_kernel, f->f_npartitions * f->f_blocksize * sizeof(t_sample));
+    if (f->f_state)
+        freebytes(f->f_state, f->f_npartitions);
+    if (f->f_xre)
+        freebytes(f->f_xre, 6 * f->f_npartitions * nbins * sizeof(t_sample));
+    if (f->f_work)
+        freebytes(f->f_work, (4 * f->f_blocksize + 2 * nbins) * sizeof(t_sample));
+    f->f_kernel = f->f_kre = f->f_kim = f->f_pre = f->f_pim = f->f_xre = f->f_xim = 0;
+    f->f_work = f->f_prev = f->f_yre = f->f_yim = f->f_fade = 0;
+    f->f_state = 0;
+    f->f_npartitions = 0;
+    f->f_active = 0;
+}
+
+/* Makes room for a kernel of npartitions, the delay line has to be filled again after this */
+static int buffir_fft_alloc(t_buffir_fft *f, int blocksize, int npartitions)
+{
+    int nbins = blocksize + 1;
+    buffir_fft_free(f);
+    f->f_blocksize = blocksize;
+    if (!(f->f_kernel = (t_sample *)getbytes(npartitions * blocksize * sizeof(t_sample))) ||
+        !(f->f_state = (char *)getbytes(npartitions)) ||
+        !(f->f_xre = (t_sample *)getbytes(6 * npartitions * nbins * sizeof(t_sample))) ||
+        !(f->f_work = (t_sample *)getbytes((4 * blocksize + 2 * nbins) * sizeof(t_sample))))
+    {
+        buffir_fft_free(f);
+        return (0);
+    }
+    /* the delay line comes first, the kernel spectra are swapped */
+    f->f_npartitions = npartitions;
+    f->f_xim = f->f_xre + npartitions * nbins;
+    f->f_kre = f->f_xim + npartitions * nbins;
+    f->f_kim = f->f_kre + npartitions * nbins;
+    f->f_pre = f->f_kim + npartitions * nbins;
+    f->f_pim = f->f_pre + npartitions * nbins;
+    f->f_prev = f->f_work + 2 * blocksize;
+    f->f_yre = f->f_prev + blocksize;
+    f->f_yim = f->f_yre + nbins;
+    f->f_fade = f->f_yim + nbins;
+    f->f_nplaying = 0;
+    f->f_changed = 0;
+    f->f_vec = 0;
+    f->f_off = f->f_npoints = -1;
+    return (1);
+}
+
+/* spectrum of the 2 * blocksize samples in f_work, unpacked from pd's real fft layout */
+static void buffir_fft_forward(t_buffir_fft *f, t_sample *re, t_sample *im)
+{
+    int n = f->f_blocksize, k;
+    t_sample *work = f->f_work;
+    libpd_fft_real(2 * n, work);
+    re[0] = work[0];
+    im[0] = 0;
+    for (k = 1; k < n; k++)
+    {
+        re[k] = work[k];
+        im[k] = work[2 * n - k];
+    }
+    re[n] = work[n];
+    im[n] = 0;
+}
+
+static void buffir_fft_setpartition(t_buffir_fft *f, int p)
+{
+    int n = f->f_blocksize, nbins = n + 1;
+    memcpy(f->f_work, f->f_kernel + p * n, n * sizeof(t_sample));
+    memset(f->f_work + n, 0, n * sizeof(t_sample));
+    buffir_fft_forward(f, f->f_pre + p * nbins, f->f_pim + p * nbins);
+    f->f_state[p] = BUFFIR_NEWER;
+}
+
+/* copies partition p of the kernel from the array, returns 1 if it was different */
+static int buffir_fft_readpartition(t_buffir_fft *f, t_word *vec, int p)
+{
+    int n = f->f_blocksize, i, changed = 0;
+    int start = p * n;
+    t_sample *dst = f->f_kernel + start;
+    for (i = 0; i < n; i++)
+    {
+        t_sample v = (start + i < f->f_npoints) ? vec[f->f_off + start + i].w_float : 0;
+        if (dst[i] != v)
+        {
+            dst[i] = v;
+            changed = 1;
+        }
+    }
+    return (changed);
+}
+
+/* Reads the kernel and transforms what changed into the pending spectra, returns 1 once
+   they are complete and differ from the ones that are heard */
+static int buffir_fft_update(t_buffir_fft *f, t_word *vec, int off, int npoints)
+{
+    int n = f->f_blocksize, npartitions = (npoints + n - 1) / n, p;
+    int ntransforms = 0, ndirty = 0;
+    f->f_vec = vec;
+    f->f_off = off;
+    f->f_npoints = npoints;
+    if (npartitions != f->f_nplaying)
+        f->f_changed = 1;
+    for (p = 0; p < npartitions; p++)
+    {
+        if (buffir_fft_readpartition(f, vec, p))
+            f->f_state[p] |= BUFFIR_DIRTY;
+        if (!(f->f_state[p] & BUFFIR_DIRTY))
+            continue;
+        if (ntransforms < BUFFIR_CATCHUPRATE)
+        {
+            buffir_fft_setpartition(f, p);
+            f->f_changed = 1;
+            ntransforms++;
+        }
+        else ndirty++;
+    }
+    return (f->f_changed && !ndirty);
+}
+
+/* The pending spectra become the ones that are heard, the partitions that differed are
+   copied back, so the pending spectra are complete again */
+static void buffir_fft_swap(t_buffir_fft *f)
+{
+    int n = f->f_blocksize, nbins = n + 1, p;
+    t_sample *re = f->f_kre, *im = f->f_kim;
+    f->f_kre = f->f_pre;
+    f->f_kim = f->f_pim;
+    f->f_pre = re;
+    f->f_pim = im;
+    for (p = 0; p < f->f_npartitions; p++)
+    {
+        if (!(f->f_state[p] & BUFFIR_NEWER))
+            continue;
+        memcpy(f->f_pre + p * nbins, f->f_kre + p * nbins, nbins * sizeof(t_sample));
+        memcpy(f->f_pim + p * nbins, f->f_kim + p * nbins, nbins * sizeof(t_sample));
+        f->f_state[p] &= ~BUFFIR_NEWER;
+    }
+    f->f_nplaying = (f->f_npoints + n - 1) / n;
+    f->f_changed = 0;
+}
+
+/* Makes room for the longest kernel the array allows, the delay line is filled again after this */
+static void buffir_fft_reserve(t_buffir *x)
+{
+    t_buffir_fft *f = &x->x_fft;
+    int n = f->f_blocksize, npoints = x->x_cybuf->c_npts;
+    if (n < BUFFIR_MINFFTBLOCK || n > BUFFIR_MAXFFTSIZE)
+        return;
+    if (npoints > BUFFIR_MAXFFTSIZE)
+        npoints = BUFFIR_MAXFFTSIZE;
+    if (npoints >= BUFFIR_MINFFTSIZE && (npoints + n - 1) / n > f->f_npartitions)
+        buffir_fft_alloc(f, n, (npoints + n - 1) / n);
+}
+
+/* Fills the delay line with what is left of the input in the direct form's history,
+   called before the current block is added to it.  Only the slots the kernel reaches
+   are transformed, the others are cleared and fill up as blocks come in. */
+static void buffir_fft_fillhistory(t_buffir *x, int npartitions)
+{
+    t_buffir_fft *f = &x->x_fft;
+    int n = f->f_blocksize, nbins = n + 1, q, i;
+    t_float *hp = x->x_hihead;
+    /* the spectrum of q blocks ago is of the blocks that ended q + 1 and q blocks ago,
+       and the current block goes into slot 0 */
+    for (q = npartitions; q < f->f_npartitions; q++)
+    {
+        int slot = f->f_npartitions - q;
+        memset(f->f_xre + slot * nbins, 0, nbins * sizeof(t_sample));
+        memset(f->f_xim + slot * nbins, 0, nbins * sizeof(t_sample));
+    }
+    for (q = 1; q < npartitions; q++)
+    {
+        int slot = f->f_npartitions - q;
+        for (i = 0; i < 2 * n; i++)
+        {
+            int delay = (q + 1) * n - i;
+            f->f_work[i] = delay <= BUFFIR_MAXSIZE ? hp[-delay] : 0;
+        }
+        buffir_fft_forward(f, f->f_xre + slot * nbins, f->f_xim + slot * nbins);
+    }
+    for (i = 0; i < n; i++)
+        f->f_prev[i] = n - i <= BUFFIR_MAXSIZE ? hp[i - n] : 0;
+    f->f_head = f->f_npartitions - 1;
+}
+
+/* the direct form's history is kept up to date, so it can take over at any block */
+static void buffir_pushhistory(t_buffir *x, t_sample *in, int nblock)
+{
+    t_float *lohead = x->x_lohead;
+    t_float *hihead = x->x_hihead;
+    while (nblock--)
+    {
+        *lohead++ = *hihead++ = *in++;
+        if (lohead >= x->x_histhi)
+        {
+            lohead = x->x_histlo;
+            hihead = x->x_histhi;
+        }
+    }
+    x->x_lohead = lohead;
+    x->x_hihead = hihead;
+}
+
+/* output of npartitions of the spectra kre and kim, for the input spectra in the delay line */
+static void buffir_fft_convolve(t_buffir_fft *f, t_sample *kre, t_sample *kim, int npartitions,
+    t_sample *out)
+{
+    int n = f->f_blocksize, nbins = n + 1, p, k;
+    t_sample *yre = f->f_yre, *yim = f->f_yim, *work = f->f_work;
+    t_sample scale = 1. / (2 * n);
+    memset(yre, 0, nbins * sizeof(t_sample));
+    memset(yim, 0, nbins * sizeof(t_sample));
+    for (p = 0; p < npartitions; p++)
+    {
+        int slot = f->f_head - p;
+        t_sample *xre, *xim, *hre, *him;
+        if (slot < 0)
+            slot += f->f_npartitions;
+        xre = f->f_xre + slot * nbins;
+        xim = f->f_xim + slot * nbins;
+        hre = kre + p * nbins;
+        him = kim + p * nbins;
+        for (k = 0; k < nbins; k++)
+        {
+            yre[k] += xre[k] * hre[k] - xim[k] * him[k];
+            yim[k] += xre[k] * him[k] + xim[k] * hre[k];
+        }
+    }
+    /* back to pd's layout, only the second half is a valid linear convolution */
+    for (k = 0; k <= n; k++)
+        work[k] = yre[k];
+    for (k = 1; k < n; k++)
+        work[2 * n - k] = yim[k];
+    libpd_fft_realinverse(2 * n, work);
+    for (k = 0; k < n; k++)
+        out[k] = work[n + k] * scale;
+}
+
+static void buffir_fft_perform(t_buffir *x, t_word *vec, int off, int npoints,
+    t_sample *in, t_sample *out)
+{
+    t_buffir_fft *f = &x->x_fft;
+    int n = f->f_blocksize, nbins = n + 1, k, ready;
+    int npartitions = (npoints + n - 1) / n;
+    if (!f->f_active)
+    {
+        buffir_fft_fillhistory(x,
+            npartitions > f->f_nplaying ? npartitions : f->f_nplaying);
+        f->f_active = 1;
+    }
+    buffir_pushhistory(x, in, n);
+    ready = buffir_fft_update(f, vec, off, npoints);
+    /* newest input spectrum, from the previous and this block */
+    memcpy(f->f_work, f->f_prev, n * sizeof(t_sample));
+    memcpy(f->f_work + n, in, n * sizeof(t_sample));
+    memcpy(f->f_prev, in, n * sizeof(t_sample));
+    if (++f->f_head >= f->f_npartitions)
+        f->f_head = 0;
+    buffir_fft_forward(f, f->f_xre + f->f_head * nbins, f->f_xim + f->f_head * nbins);
+    if (!ready)
+    {
+        buffir_fft_convolve(f, f->f_kre, f->f_kim, f->f_nplaying, out);
+        return;
+    }
+    buffir_fft_convolve(f, f->f_kre, f->f_kim, f->f_nplaying, f->f_fade);
+    buffir_fft_swap(f);
+    buffir_fft_convolve(f, f->f_kre, f->f_kim, f->f_nplaying, out);
+    for (k = 0; k < n; k++)
+        out[k] = f->f_fade[k] + (out[k] - f->f_fade[k]) * (k + 1) / n;
+}
+
+/* The frequency domain is used when offset and size are the same over the whole block,
+   and the kernel is long enough for it to be cheaper than the direct form */
+static int buffir_fft_getrange(t_buffir *x, t_sample *oin, t_sample *sin, int nblock,
+    int *offp, int *npointsp)
+{
+    int i, off, npoints, bufnpts = x->x_cybuf->c_npts;
+    if (nblock != x->x_fft.f_blocksize || nblock < BUFFIR_MINFFTBLOCK ||
+        nblock > BUFFIR_MAXFFTSIZE)
+        return (0);
+    for (i = 1; i < nblock; i++)
+        if (oin[i] != oin[0] || sin[i] != sin[0])
+            return (0);
+    off = (int)oin[0];
+    npoints = (int)sin[0];
+    if (off < 0)
+        off = 0;
+    if (npoints > bufnpts - off)
+        npoints = bufnpts - off;
+    if (npoints > BUFFIR_MAXFFTSIZE)
+    {
+        x->x_toolong = npoints;
+        npoints = BUFFIR_MAXFFTSIZE;
+    }
+    if (npoints < BUFFIR_MINFFTSIZE)
+        return (0);
+    /* longer than there is room for, until the dsp method or 'set' made more,
+       the direct form only plays the start of it */
+    if ((npoints + nblock - 1) / nblock > x->x_fft.f_npartitions)
+    {
+        if (npoints > BUFFIR_MAXSIZE)
+            x->x_toolong = npoints;
+        return (0);
+    }
+    *offp = off;
+    *npointsp = npoints;
+    return (1);
+}
+
 static t_int *buffir_perform(t_int *w)
 {
     t_buffir *x = (t_buffir *)(w[1]);
     int nblock = (int)(w[2]);
     t_float *xin = (t_float *)(w[3]);
     t_float *out = (t_float *)(w[6]);
-    t_float *lohead = x->x_lohead;
-    t_float *hihead = x->x_hihead;
+    t_float *lohead, *hihead;
     t_cybuf *c = x->x_cybuf;
+    int fftoff, fftnpoints, usefft;
+    x->x_toolong = 0;
+    usefft = c->c_playable && buffir_fft_getrange(x, (t_float *)(w[4]), (t_float *)(w[5]),
+        nblock, &fftoff, &fftnpoints);
+    /* reported once every time the kernel is cut short */
+    if (!x->x_toolong)
+        x->x_reported = 0;
+    else if (!x->x_reported)
+    {
+        x->x_reported = 1;
+        clock_delay(x->x_clock, 0);
+    }
+    if (usefft)
+    {
+        buffir_fft_perform(x, c->c_vectors[0], fftoff, fftnpoints, xin, out);
+        return (w + 7);
+    }
+    /* the delay line has to be filled again when coming back */
+    x->x_fft.f_active = 0;
+    lohead = x->x_lohead;
+    hihead = x->x_hihead;
     if (c->c_playable)
     {	
 
@@ -131,10 +524,28 @@ static t_int *buffir_perform(t_int *w)
     return (w + 7);
 }
 
+static void buffir_tick(t_buffir *x)
+{
+    if (x->x_toolong > BUFFIR_MAXFFTSIZE)
+        pd_error(x, "buffir~: kernel of %d points cut to %d, the longest there can be",
+            x->x_toolong, BUFFIR_MAXFFTSIZE);
+    else if (x->x_toolong)
+        pd_error(x, "buffir~: kernel of %d points cut to %d, the array grew after it was set or dsp started",
+            x->x_toolong, BUFFIR_MAXSIZE);
+}
+
 static void buffir_dsp(t_buffir *x, t_signal **sp)
 {
 	x->x_checked = 0;
+    if (sp[0]->s_n != x->x_fft.f_blocksize)
+    {
+        buffir_fft_free(&x->x_fft);
+        x->x_fft.f_blocksize = sp[0]->s_n;
+    }
+    if (sp[0]->s_n >= BUFFIR_MINFFTBLOCK && sp[0]->s_n <= BUFFIR_MAXFFTSIZE)
+        libpd_fft_prepare(2 * sp[0]->s_n);
     cybuf_checkdsp(x->x_cybuf); 
+    buffir_fft_reserve(x);
     dsp_add(buffir_perform, 6, x, sp[0]->s_n, sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, sp[3]->s_vec);
 }
 
@@ -143,6 +554,9 @@ static void buffir_free(t_buffir *x)
     inlet_free(x->x_offlet);
     inlet_free(x->x_sizlet);
     cybuf_free(x->x_cybuf);
+    buffir_fft_free(&x->x_fft);
+    if (x->x_clock)
+        clock_free(x->x_clock);
 }
 
 static void *buffir_new(t_symbol *s, t_floatarg f1, t_floatarg f2)
@@ -164,6 +578,9 @@ static void *buffir_new(t_symbol *s, t_floatarg f1, t_floatarg f2)
 	x->x_histlo = x->x_histbuf;
 	x->x_histhi = x->x_histbuf+BUFFIR_MAXSIZE;
 	x->x_checked = 0;
+	x->x_toolong = x->x_reported = 0;
+	x->x_clock = clock_new(x, (t_method)buffir_tick);
+	memset(&x->x_fft, 0, sizeof(x->x_fft));
 	buffir_clear(x);
 	buffir_setrange(x, f1, f2);
     }
@@ -6,6 +6,7 @@
 #include "m_pd.h"
 #include <common/api.h>
 #include "common/magicbit.h"
+#include "signal/fastmath.h"
 
 typedef struct _cartopol
 {
@@ -16,6 +17,7 @@ typedef struct _cartopol
     t_glist *x_glist;
     t_float *x_signalscalar;
     t_int      x_hasfeeders;
+    int        x_fast;
 } t_cartopol;
 
 static t_class *cartopol_class;
@@ -38,21 +40,26 @@ static t_int *cartopol_perform(t_int *w)
         pd_error(x, "cartopol~: doesn't understand 'float'");
     }
     
-    while (nblock--)
-    {
-        float re, im, amp, ph;
-        // MAGIC
-        if (x->x_hasfeeders)
-            {
-            re = *in1++;
-            im = *in2++;
-            amp = hypotf(re, im);
-            ph = atan2f(im, re);
-            }
-        else amp = ph = 0.0;
-        *out1++ = amp;
-        *out2++ = ph;
-    }
+    // MAGIC
+    if (!x->x_hasfeeders)
+        while (nblock--)
+            *out1++ = *out2++ = 0.0;
+    else if (x->x_fast)
+        while (nblock--)
+        {
+            float re = *in1++;
+            float im = *in2++;
+            *out1++ = sqrtf(re * re + im * im);
+            *out2++ = fastmath_atan2(im, re);
+        }
+    else
+        while (nblock--)
+        {
+            float re = *in1++;
+            float im = *in2++;
+            *out1++ = hypotf(re, im);
+            *out2++ = atan2f(im, re);
+        }
     return (w + 7);
 }
 
@@ -71,21 +78,24 @@ static t_int *cartopol_perform_nophase(t_int *w)
         pd_error(x, "cartopol~: doesn't understand 'float'"); // i think it's this one...
     }
     
-    while (nblock--)
-    {
-        float re, im, amp;
-
-        // MAGIC
-        if (x->x_hasfeeders)
-            {
-            re = *in1++;
-            im = *in2++;
-            amp = hypotf(re, im);
-            }
-        else amp = 0.0;
-        
-        *out1++ = amp;
-    }
+    // MAGIC
+    if (!x->x_hasfeeders)
+        while (nblock--)
+            *out1++ = 0.0;
+    else if (x->x_fast)
+        while (nblock--)
+        {
+            float re = *in1++;
+            float im = *in2++;
+            *out1++ = sqrtf(re * re + im * im);
+        }
+    else
+        while (nblock--)
+        {
+            float re = *in1++;
+            float im = *in2++;
+            *out1++ = hypotf(re, im);
+        }
     return (w + 6);
 }
 
@@ -101,6 +111,15 @@ static void cartopol_dsp(t_cartopol *x, t_signal **sp)
                 sp[1]->s_vec, sp[2]->s_vec);
 }
 
+static void cartopol_precision(t_cartopol *x, t_symbol *s)
+{
+    int fast = fastmath_precision(s);
+    if (fast < 0)
+        pd_error(x, "cartopol~: precision is 'full' or 'fast'");
+    else
+        x->x_fast = fast;
+}
+
 static void *cartopol_new(void)
 {
     t_cartopol *x = (t_cartopol *)pd_new(cartopol_class);
@@ -119,4 +138,5 @@ CYCLONE_OBJ_API void cartopol_tilde_setup(void)
             sizeof(t_cartopol), 0, 0);
     class_addmethod(cartopol_class, nullfn, gensym("signal"), 0);
     class_addmethod(cartopol_class, (t_method) cartopol_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(cartopol_class, (t_method) cartopol_precision, gensym("precision"), A_SYMBOL, 0);
 }
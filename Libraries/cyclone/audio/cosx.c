@@ -5,11 +5,13 @@
 #include <math.h>
 #include "m_pd.h"
 #include <common/api.h>
+#include "signal/fastmath.h"
 
 typedef struct _cosx {
     t_object x_obj;
     t_inlet *cosx;
     t_outlet *x_outlet;
+    int       x_fast;
 } t_cosx;
 
 void *cosx_new(void);
@@ -20,20 +22,31 @@ static t_class *cosx_class;
 
 static t_int *cosx_perform(t_int *w)
 {
-    int nblock = (int)(w[1]);
-    t_float *in = (t_float *)(w[2]);
-    t_float *out = (t_float *)(w[3]);
-    while (nblock--)
-    {
-        float f = *in++;
-        *out++ = cosf(f);  /* CHECKED no protection against NaNs */
-    }
-    return (w + 4);
+    t_cosx *x = (t_cosx *)(w[1]);
+    int nblock = (int)(w[2]);
+    t_float *in = (t_float *)(w[3]);
+    t_float *out = (t_float *)(w[4]);
+    if (x->x_fast)
+        while (nblock--)
+            *out++ = fastmath_cos(*in++);
+    else
+        while (nblock--)
+            *out++ = cosf(*in++);  /* CHECKED no protection against NaNs */
+    return (w + 5);
 }
 
 static void cosx_dsp(t_cosx *x, t_signal **sp)
 {
-    dsp_add(cosx_perform, 3, sp[0]->s_n, sp[0]->s_vec, sp[1]->s_vec);
+    dsp_add(cosx_perform, 4, x, sp[0]->s_n, sp[0]->s_vec, sp[1]->s_vec);
+}
+
+static void cosx_precision(t_cosx *x, t_symbol *s)
+{
+    int fast = fastmath_precision(s);
+    if (fast < 0)
+        pd_error(x, "cosx~: precision is 'full' or 'fast'");
+    else
+        x->x_fast = fast;
 }
 
 void *cosx_new(void)
@@ -49,4 +62,5 @@ CYCLONE_OBJ_API void cosx_tilde_setup(void)
                            sizeof(t_cosx), CLASS_DEFAULT, 0);
     class_addmethod(cosx_class, nullfn, gensym("signal"), 0);
     class_addmethod(cosx_class, (t_method) cosx_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(cosx_class, (t_method) cosx_precision, gensym("precision"), A_SYMBOL, 0);
 }
@@ -44,6 +44,15 @@ static void line_tick(t_line *x)
     outlet_bang(x->x_bangout);
 }
 
+/* the ramp from curval on, sample i is worked out from i rather than added up
+   from the sample before, so the compiler can vectorise the loop */
+static void line_fill(t_float *out, int n, float curval, float inc)
+{
+    int i;
+    for (i = 0; i < n; i++)
+	out[i] = curval + i * inc;
+}
+
 static t_int *line_perform(t_int *w)
 {
     t_line *x = (t_line *)(w[1]);
@@ -108,15 +117,13 @@ retarget:
 	    x->x_value = x->x_target;
 	}
 	else x->x_value += biginc;
-    	while (nblock--)
-	    *out++ = curval, curval += inc;
+	line_fill(out, nblock, curval, inc);
     }
     else if (nxfer > 0)
     {
 	nblock -= nxfer;
-	do
-	    *out++ = curval, curval += inc;
-	while (--nxfer);
+	line_fill(out, nxfer, curval, inc);
+	out += nxfer;
 	curval = x->x_value = x->x_target;
 	if (x->x_nsegs)
 	{
@@ -11,6 +11,7 @@
 #include <math.h>
 #include "m_pd.h"
 #include <common/api.h>
+#include "common/magicbit.h"
 
 /* CHECKME negative loresance */
 /* CHECKME max loresance, esp. at low freqs (watch out, gain not normalized) */
@@ -25,29 +26,29 @@ typedef struct _lores
     t_inlet  *x_freq_inlet;
     t_inlet  *x_q_inlet;
     float  x_srcoef;
-    float  x_ynm1;
-    float  x_ynm2;
+    int    x_nchans;
+    int    x_freq_nchans;
+    int    x_q_nchans;
+    float *x_ynm1;  /* state of each channel */
+    float *x_ynm2;
 } t_lores;
 
 static t_class *lores_class;
 
 static void lores_clear(t_lores *x)
 {
-    x->x_ynm1 = x->x_ynm2 = 0.;
+    int ch;
+    for (ch = 0; ch < x->x_nchans; ch++)
+	x->x_ynm1[ch] = x->x_ynm2[ch] = 0.;
 }
 
 /* LATER make ready for optional audio-rate modulation
    (separate scalar case routines, use sic_makecostable(), etc.) */
-static t_int *lores_perform(t_int *w)
+static void lores_run(t_lores *x, int ch, int nblock, t_float *xin,
+		      t_float fin0, t_float rin0, t_float *out)
 {
-    t_lores *x = (t_lores *)(w[1]);
-    int nblock = (int)(w[2]);
-    t_float *xin = (t_float *)(w[3]);
-    t_float fin0 = *(t_float *)(w[4]);
-    t_float rin0 = *(t_float *)(w[5]);
-    t_float *out = (t_float *)(w[6]);
-    float ynm1 = x->x_ynm1;
-    float ynm2 = x->x_ynm2;
+    float ynm1 = x->x_ynm1[ch];
+    float ynm2 = x->x_ynm2[ch];
     /* CHECKME sampled once per block */
     float omega = fin0 * x->x_srcoef;
     float radius, c1, c2, b0;
@@ -71,13 +72,42 @@ static t_int *lores_perform(t_int *w)
 	ynm1 = yn;
     }
     /* LATER rethink */
-    x->x_ynm1 = (PD_BIGORSMALL(ynm1) ? 0. : ynm1);
-    x->x_ynm2 = (PD_BIGORSMALL(ynm2) ? 0. : ynm2);
+    x->x_ynm1[ch] = (PD_BIGORSMALL(ynm1) ? 0. : ynm1);
+    x->x_ynm2[ch] = (PD_BIGORSMALL(ynm2) ? 0. : ynm2);
+}
+
+/* one call for all channels, a control inlet with fewer channels
+   is reused for the rest */
+static t_int *lores_perform(t_int *w)
+{
+    t_lores *x = (t_lores *)(w[1]);
+    int nblock = (int)(w[2]);
+    t_float *xin = (t_float *)(w[3]);
+    t_float *fin = (t_float *)(w[4]);
+    t_float *rin = (t_float *)(w[5]);
+    t_float *out = (t_float *)(w[6]);
+    int ch;
+    for (ch = 0; ch < x->x_nchans; ch++)
+	lores_run(x, ch, nblock, xin + ch * nblock,
+		  fin[(ch % x->x_freq_nchans) * nblock],
+		  rin[(ch % x->x_q_nchans) * nblock], out + ch * nblock);
     return (w + 7);
 }
 
 static void lores_dsp(t_lores *x, t_signal **sp)
 {
+    int nchans = magic_nchans(sp[0]);
+    if (nchans != x->x_nchans)
+    {
+	x->x_ynm1 = (float *)resizebytes(x->x_ynm1,
+	    x->x_nchans * sizeof(float), nchans * sizeof(float));
+	x->x_ynm2 = (float *)resizebytes(x->x_ynm2,
+	    x->x_nchans * sizeof(float), nchans * sizeof(float));
+	x->x_nchans = nchans;
+    }
+    x->x_freq_nchans = magic_nchans(sp[1]);
+    x->x_q_nchans = magic_nchans(sp[2]);
+    magic_setmultiout(&sp[3], nchans);
     x->x_srcoef = TWO_PI / sp[0]->s_sr;
     lores_clear(x);
     dsp_add(lores_perform, 6, x, sp[0]->s_n,
@@ -88,6 +118,9 @@ static void *lores_new(t_floatarg f1, t_floatarg f2)
 {
     t_lores *x = (t_lores *)pd_new(lores_class);
     x->x_srcoef = TWO_PI / sys_getsr();
+    x->x_nchans = x->x_freq_nchans = x->x_q_nchans = 1;
+    x->x_ynm1 = (float *)getbytes(sizeof(float));
+    x->x_ynm2 = (float *)getbytes(sizeof(float));
     x->x_freq_inlet = inlet_new((t_object *)x, (t_pd *)x, &s_signal, &s_signal);
     pd_float((t_pd *)x->x_freq_inlet, f1);
     x->x_q_inlet = inlet_new((t_object *)x, (t_pd *)x, &s_signal, &s_signal);
@@ -97,11 +130,17 @@ static void *lores_new(t_floatarg f1, t_floatarg f2)
     return (x);
 }
 
+static void lores_free(t_lores *x)
+{
+    freebytes(x->x_ynm1, x->x_nchans * sizeof(float));
+    freebytes(x->x_ynm2, x->x_nchans * sizeof(float));
+}
+
 CYCLONE_OBJ_API void lores_tilde_setup(void)
 {
     lores_class = class_new(gensym("lores~"),
-			    (t_newmethod)lores_new, 0,
-			    sizeof(t_lores), 0,
+			    (t_newmethod)lores_new, (t_method)lores_free,
+			    sizeof(t_lores), MAGIC_MULTICHANNEL,
 			    A_DEFFLOAT, A_DEFFLOAT, 0);
     class_addmethod(lores_class, nullfn, gensym("signal"), 0);
     class_addmethod(lores_class, (t_method)lores_dsp, gensym("dsp"), A_CANT, 0);
@@ -22,6 +22,7 @@ dependencies, changed indentation
 #include "m_pd.h"
 #include <common/api.h>
 #include "common/magicbit.h"
+#include <string.h>
 
 #define MATRIX_DEFGAIN      0.      // CHECKED
 #define MATRIX_DEFRAMP      10.     // CHECKED
@@ -43,6 +44,13 @@ typedef struct _matrix{
     t_float  **x_osums;
     int        x_ncells;
     int       *x_cells;
+    /* Cells that take part in the mix, in the order of the cell array, so that
+       the cost of a block grows with the connections instead of ins times outs.
+       A cell is active while it's on or still ramping, the list is rebuilt
+       after a message changed the cells. */
+    int       *x_active;
+    int        x_nactive;
+    int        x_activedirty;
     t_outlet  *x_dumpout;
     /* The following fields are specific to nonbinary mode, i.e. we keep them
        unallocated in binary mode.  This is CHECKED to be incompatible:  c74
@@ -76,6 +84,7 @@ static void matrix_retarget(t_matrix *x, int cellndx){
     else{
     	x->x_remains[cellndx] =
 	    x->x_ramps[cellndx] * x->x_ksr + 0.5;  // LATER rethink
+        x->x_activedirty = 1;
     	x->x_incrs[cellndx] = (target - x->x_coefs[cellndx]) / (float)x->x_remains[cellndx];
         x->x_bigincrs[cellndx] = x->x_nblock * x->x_incrs[cellndx];
     }
@@ -90,6 +99,7 @@ static void matrix_retarget_connect(t_matrix *x, int cellndx){
     }
     else{
         x->x_remains[cellndx] = x->x_ramps[cellndx] * x->x_ksr + 0.5;  // LATER rethink
+        x->x_activedirty = 1;
         x->x_incrs[cellndx] = (target - x->x_coefs[cellndx]) / (float)x->x_remains[cellndx];
         x->x_bigincrs[cellndx] = x->x_nblock * x->x_incrs[cellndx];
     }
@@ -144,6 +154,7 @@ static void matrix_list(t_matrix *x, t_symbol *s, int argc, t_atom *argv){
 // negative gain used in nonbinary mode, accepted as 1 in binary (legacy code)
     onoff = (gain < -MATRIX_GAINEPSILON || gain > MATRIX_GAINEPSILON);
     x->x_cells[cell_idx] = onoff;
+    x->x_activedirty = 1;
     if(x->x_gains){ //if in nonbinary mode
         if(onoff) // CHECKME
 		    x->x_gains[cell_idx] = gain;
@@ -155,6 +166,7 @@ static void matrix_list(t_matrix *x, t_symbol *s, int argc, t_atom *argv){
 
 static void matrix_clear(t_matrix *x){
     int i;
+    x->x_activedirty = 1;
     for(i = 0; i < x->x_ncells; i++){
         x->x_cells[i] = 0;
         if(x->x_gains)
@@ -187,6 +199,7 @@ static void matrix_connect(t_matrix *x, t_symbol *s, int argc, t_atom *argv){
 		argc--, argv++;
 		cell_idx = celloffset + outlet_idx;
 		x->x_cells[cell_idx] = onoff;
+		x->x_activedirty = 1;
 		if(x->x_gains) // if in non-binary mode
 			matrix_retarget_connect(x, cell_idx);
     };
@@ -200,132 +213,112 @@ static void matrix_ramp(t_matrix *x, t_floatarg f){ // CHECKED active ramps are
     }
 }
 
-static t_int *matrix01_perform(t_int *w){
-    t_matrix *x = (t_matrix *)(w[1]);
-    int nblock = (int)(w[2]);
-    t_float **ivecs = x->x_ivecs;
-    t_float **ovecs = x->x_ovecs;
-    t_float **osums = x->x_osums;
-    int *cellp = x->x_cells;
+static void matrix_updateactive(t_matrix *x){
+    int i, n = 0;
+    for(i = 0; i < x->x_ncells; i++)
+        if(x->x_cells[i] || (x->x_remains && x->x_remains[i] > 0))
+            x->x_active[n++] = i;
+    x->x_nactive = n;
+    x->x_activedirty = 0;
+}
+
+// the kernels are plain loops over a block, so that the compiler can vectorize them
+static void matrix_add(t_float *out, t_float *in, int n){
+    int i;
+    for(i = 0; i < n; i++)
+        out[i] += in[i];
+}
+
+static void matrix_addgain(t_float *out, t_float *in, t_float gain, int n){
+    int i;
+    for(i = 0; i < n; i++)
+        out[i] += in[i] * gain;
+}
+
+static void matrix_addramp(t_float *out, t_float *in, t_float coef, t_float incr, int n){
+    int i;
+    for(i = 0; i < n; i++)
+        out[i] += in[i] * (coef + incr * i);
+}
+
+static void matrix_checkscalars(t_matrix *x){
     int indx;
-    for(indx = 0; indx < x->x_numinlets; indx++){
-        t_float *ivec = *ivecs++;
-        t_float **ovecp = osums;
-        if(indx){
-            if(!magic_isnan(*x->x_signalscalars[indx])){
-                pd_error(x, "matrix~: doesn't understand 'float'");
-                magic_setnan(x->x_signalscalars[indx]);
-            }
-            if(!(x->x_hasfeeders[indx]))
-                ivec = x->x_zerovec;
-        }
-        int ondx = x->x_numoutlets;
-        while(ondx--){
-            if(*cellp++){
-                t_float *in = ivec;
-                t_float *out = *ovecp;
-                int sndx = nblock;
-                while(sndx--)
-                    *out++ += *in++;
-            }
-            ovecp++;
+    for(indx = 1; indx < x->x_numinlets; indx++){
+        if(!magic_isnan(*x->x_signalscalars[indx])){
+            pd_error(x, "matrix~: doesn't understand 'float'");
+            magic_setnan(x->x_signalscalars[indx]);
         }
     }
-    osums = x->x_osums;
-    indx = x->x_numoutlets;
-    while(indx--){
-        t_float *in = *osums++;
-        t_float *out = *ovecs++;
-        int sndx = nblock;
-        while(sndx--){
-            *out++ = *in;
-            *in++ = 0.;
-        }
+}
+
+static void matrix_output(t_matrix *x, int nblock){
+    int indx;
+    for(indx = 0; indx < x->x_numoutlets; indx++){
+        memcpy(x->x_ovecs[indx], x->x_osums[indx], nblock * sizeof(t_float));
+        memset(x->x_osums[indx], 0, nblock * sizeof(t_float));
+    }
+}
+
+static t_int *matrix01_perform(t_int *w){
+    t_matrix *x = (t_matrix *)(w[1]);
+    int nblock = (int)(w[2]);
+    int i;
+    matrix_checkscalars(x);
+    if(x->x_activedirty)
+        matrix_updateactive(x);
+    for(i = 0; i < x->x_nactive; i++){
+        int cell = x->x_active[i];
+        t_float *in = x->x_ivecs[cell / x->x_numoutlets];
+        if(in != x->x_zerovec)
+            matrix_add(x->x_osums[cell % x->x_numoutlets], in, nblock);
     }
+    matrix_output(x, nblock);
     return(w+3);
 }
 
 static t_int *matrixnb_perform(t_int *w){
     t_matrix *x = (t_matrix *)(w[1]);
     int nblock = (int)(w[2]);
-    t_float **ivecs = x->x_ivecs;
-    t_float **ovecs = x->x_ovecs;
-    t_float **osums = x->x_osums;
-    int *cellp = x->x_cells;
-    float *gainp = x->x_gains;
-    float *coefp = x->x_coefs;
-    float *incrp = x->x_incrs;
-    float *bigincrp = x->x_bigincrs;
-    int *nleftp = x->x_remains;
-    int indx;
-    for(indx = 0; indx < x->x_numinlets; indx++){
-        t_float *ivec = *ivecs++;
-        t_float **ovecp = osums;
-        if(indx){
-            if(!magic_isnan(*x->x_signalscalars[indx])){
-                pd_error(x, "matrix~: doesn't understand 'float'");
-                magic_setnan(x->x_signalscalars[indx]);
-            }
-            if(!(x->x_hasfeeders[indx]))
-                ivec = x->x_zerovec;
+    int i, nactive = 0;
+    matrix_checkscalars(x);
+    if(x->x_activedirty)
+        matrix_updateactive(x);
+    for(i = 0; i < x->x_nactive; i++){
+        int cell = x->x_active[i];
+        t_float *in = x->x_ivecs[cell / x->x_numoutlets];
+        t_float *out = x->x_osums[cell % x->x_numoutlets];
+        // inlets without signal are silent, but their ramps still move on
+        int live = (in != x->x_zerovec);
+        int nleft = x->x_remains[cell];
+        float coef = x->x_coefs[cell];
+        if(nleft >= nblock){
+            if((x->x_remains[cell] -= nblock) == 0)
+                x->x_coefs[cell] = (x->x_cells[cell] ? x->x_gains[cell] : 0.);
+            else
+                x->x_coefs[cell] += x->x_bigincrs[cell];
+            if(live)
+                matrix_addramp(out, in, coef, x->x_incrs[cell], nblock);
         }
-        int ondx = x->x_numoutlets;
-        while(ondx--){
-            t_float *in = ivec;
-            t_float *out = *ovecp;
-            float nleft = *nleftp;
-            int sndx = nblock;
-            if(nleft >= nblock){
-                float coef = *coefp;
-                float incr = *incrp;
-                if((*nleftp -= nblock) == 0)
-                    *coefp = (*cellp ? *gainp : 0.);
-                else
-                    *coefp += *bigincrp;
-                while(sndx--)
-                     *out++ += *in++ * coef, coef += incr;
+        else if(nleft > 0){
+            if(live)
+                matrix_addramp(out, in, coef, x->x_incrs[cell], nleft);
+            x->x_remains[cell] = 0;
+            if(x->x_cells[cell]){
+                coef = x->x_coefs[cell] = x->x_gains[cell];
+                if(live)
+                    matrix_addgain(out + nleft, in + nleft, coef, nblock - nleft);
             }
-            else if(nleft > 0){
-                float coef = *coefp;
-                float incr = *incrp;
-                sndx -= nleft;
-                do{
-                    *out++ += *in++ * coef, coef += incr;
-                }while(--nleft);
-                if(*cellp){
-                    coef = *coefp = *gainp;
-                    while(sndx--)
-                        *out++ += *in++ * coef;
-                }
-                else
-                    *coefp = 0.;
-                *nleftp = 0;
-            }
-            else if(*cellp){
-                float coef = *coefp;
-                while(sndx--)
-                    *out++ += *in++ * coef;
-            }
-            cellp++;
-            ovecp++;
-            gainp++;
-            coefp++;
-            incrp++;
-            bigincrp++;
-            nleftp++;
-        }
-    }
-    osums = x->x_osums;
-    indx = x->x_numoutlets;
-    while(indx--){
-        t_float *in = *osums++;
-        t_float *out = *ovecs++;
-        int sndx = nblock;
-        while(sndx--){
-            *out++ = *in;
-            *in++ = 0.;
+            else
+                x->x_coefs[cell] = 0.;
         }
+        else if(x->x_cells[cell] && live)
+            matrix_addgain(out, in, coef, nblock);
+        // cells that are off and done ramping drop out of the list
+        if(x->x_cells[cell] || x->x_remains[cell] > 0)
+            x->x_active[nactive++] = cell;
     }
+    x->x_nactive = nactive;
+    matrix_output(x, nblock);
     return(w+3);
 }
 
@@ -353,6 +346,10 @@ static void matrix_dsp(t_matrix *x, t_signal **sp){
 		};
         x->x_nblock = nblock;
     }
+    // secondary inlets without signal connections read silence, the zerovec may have moved above
+    for(i = 1; i < x->x_numinlets; i++)
+        if(!(x->x_hasfeeders[i]))
+            x->x_ivecs[i] = x->x_zerovec;
     if(x->x_gains){
 		x->x_ksr = sp[0]->s_sr * .001;
 		dsp_add(matrixnb_perform, 2, x, nblock);
@@ -443,6 +440,8 @@ static void *matrix_free(t_matrix *x){
     }
     if(x->x_cells)
         freebytes(x->x_cells, x->x_ncells * sizeof(*x->x_cells));
+    if(x->x_active)
+        freebytes(x->x_active, x->x_ncells * sizeof(*x->x_active));
     if(x->x_gains)
         freebytes(x->x_gains, x->x_ncells * sizeof(*x->x_gains));
     if(x->x_ramps)
@@ -530,6 +529,8 @@ static void *matrix_new(t_symbol *s, int argc, t_atom *argv){
 	for(i = 0; i < x->x_numoutlets; i++)
 	    x->x_osums[i] = getbytes(x->x_maxblock * sizeof(*x->x_osums[i]));
 	x->x_cells = getbytes(x->x_ncells * sizeof(*x->x_cells));
+	x->x_active = getbytes(x->x_ncells * sizeof(*x->x_active));
+	x->x_nactive = 0;
 	// zerovec for filtering float inputs
 	x->x_zerovec = getbytes(x->x_maxblock * sizeof(*x->x_zerovec));
 	matrix_clear(x);
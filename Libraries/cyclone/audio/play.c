@@ -538,6 +538,7 @@ static t_int *play_perform(t_int *w)
                 while (n--) *out++ = 0;
             };
     };
+    cybuf_declick(cybuf, x->x_ovecs, nch, nblock);
     return (w + 3);
 }
 
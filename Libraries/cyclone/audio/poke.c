@@ -98,9 +98,9 @@ static void poke_redraw_lim(t_poke *x)
 static void poke_float(t_poke *x, t_float f)
     {
     t_cybuf *c = x->x_cybuf;
-    t_word *vp = c->c_vectors[0];
     //second arg is to allow error posting
     cybuf_validate(c, 1);  // LATER rethink (efficiency, and complaining)
+    t_word *vp = c->c_vectors[0]; // after validating, the old vector may be gone
     if (vp)
         {
         int index = (int)*x->x_indexptr;
@@ -6,6 +6,7 @@
 #include "m_pd.h"
 #include <common/api.h>
 #include "common/magicbit.h"
+#include "signal/fastmath.h"
 
 typedef struct _poltocar
 {
@@ -15,6 +16,7 @@ typedef struct _poltocar
     t_glist  *x_glist;
     t_float *x_signalscalar;
     t_int      x_hasfeeders;
+    int        x_fast;
 } t_poltocar;
 
 static t_class *poltocar_class;
@@ -33,23 +35,26 @@ static t_int *poltocar_perform(t_int *w)
 		magic_setnan(x->x_signalscalar);
         pd_error(x, "poltocar~: doesn't understand 'float'");
     }
-    while (nblock--)
-    {
-        float amp, ph, re, im;
-        // MAGIC
-        if (x->x_hasfeeders)
-            {
-            amp = *in1++;
-            ph = *in2++;
-            re = amp * cosf(ph);
-            im = amp * sinf(ph);
-            }
-        else {
-            re = im = 0.0; // CHECKED
-            }
-	*out1++ = re;
-	*out2++ = im;
-    }
+    // MAGIC
+    if (!x->x_hasfeeders)
+        while (nblock--)
+            *out1++ = *out2++ = 0.0; // CHECKED
+    else if (x->x_fast)
+        while (nblock--)
+        {
+            float amp = *in1++;
+            float ph = *in2++;
+            *out1++ = amp * fastmath_cos(ph);
+            *out2++ = amp * fastmath_sin(ph);
+        }
+    else
+        while (nblock--)
+        {
+            float amp = *in1++;
+            float ph = *in2++;
+            *out1++ = amp * cosf(ph);
+            *out2++ = amp * sinf(ph);
+        }
     return (w + 7);
 }
 
@@ -60,6 +65,15 @@ static void poltocar_dsp(t_poltocar *x, t_signal **sp)
 		sp[1]->s_vec, sp[2]->s_vec, sp[3]->s_vec);
 }
 
+static void poltocar_precision(t_poltocar *x, t_symbol *s)
+{
+    int fast = fastmath_precision(s);
+    if (fast < 0)
+        pd_error(x, "poltocar~: precision is 'full' or 'fast'");
+    else
+        x->x_fast = fast;
+}
+
 static void *poltocar_new(void)
 {
     t_poltocar *x = (t_poltocar *)pd_new(poltocar_class);
@@ -79,4 +93,5 @@ CYCLONE_OBJ_API void poltocar_tilde_setup(void)
             sizeof(t_poltocar), 0, 0);
     class_addmethod(poltocar_class, nullfn, gensym("signal"), 0);
     class_addmethod(poltocar_class, (t_method) poltocar_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(poltocar_class, (t_method) poltocar_precision, gensym("precision"), A_SYMBOL, 0);
 }
@@ -5,34 +5,61 @@
 #include <math.h>
 #include "m_pd.h"
 #include <common/api.h>
+#include "signal/fastmath.h"
 
 static t_class *pow_class;
 
 typedef struct _pow{
     t_object x_obj;
     t_inlet  *x_inlet;
+    int       x_fast;
 }t_pow;
 
 static t_int *pow_perform(t_int *w){
-    int nblock = (int)(w[1]);
-    t_float *in1 = (t_float *)(w[2]);
-    t_float *in2 = (t_float *)(w[3]);
-    t_float *out = (t_float *)(w[4]);
-    while (nblock--){
-        float f1 = *in1++;
-        float f2 = *in2++;
-        *out++ = (f2 == 0 && f1 < 0) ||
-            (f2 < 0 && (f1 - (int)f1) != 0) ?
-            0 : pow(f2, f1);
+    t_pow *x = (t_pow *)(w[1]);
+    int nblock = (int)(w[2]);
+    t_float *in1 = (t_float *)(w[3]);
+    t_float *in2 = (t_float *)(w[4]);
+    t_float *out = (t_float *)(w[5]);
+    if(x->x_fast){
+        while (nblock--){
+            float f1 = *in1++;
+            float f2 = *in2++;
+            float a = f2 < 0 ? -f2 : f2;
+            // the exponent is an integer if the base is negative
+            float y = fastmath_pow(a > 0 ? a : 1, f1);
+            y = (f2 < 0 && ((int)f1 & 1)) ? -y : y;
+            y = f2 == 0 ? (f1 == 0) : y;
+            *out++ = (f2 == 0 && f1 < 0) ||
+                (f2 < 0 && (f1 - (int)f1) != 0) ?
+                0 : y;
+        }
     }
-    return (w + 5);
+    else{
+        while (nblock--){
+            float f1 = *in1++;
+            float f2 = *in2++;
+            *out++ = (f2 == 0 && f1 < 0) ||
+                (f2 < 0 && (f1 - (int)f1) != 0) ?
+                0 : pow(f2, f1);
+        }
+    }
+    return (w + 6);
 }
 
 static void pow_dsp(t_pow *x, t_signal **sp){
-    dsp_add(pow_perform, 4, sp[0]->s_n,
+    dsp_add(pow_perform, 5, x, sp[0]->s_n,
             sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec);
 }
 
+static void pow_precision(t_pow *x, t_symbol *s){
+    int fast = fastmath_precision(s);
+    if(fast < 0)
+        pd_error(x, "pow~: precision is 'full' or 'fast'");
+    else
+        x->x_fast = fast;
+}
+
 static void *pow_free(t_pow *x){
     inlet_free(x->x_inlet);
     return (void *)x;
@@ -53,6 +80,7 @@ CYCLONE_OBJ_API void pow_tilde_setup(void){
     class_addcreator((t_newmethod)pow_new, gensym("cyclone/Pow~"), A_GIMME, 0);
     class_addmethod(pow_class, nullfn, gensym("signal"), 0);
     class_addmethod(pow_class, (t_method)pow_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(pow_class, (t_method)pow_precision, gensym("precision"), A_SYMBOL, 0);
 }
 
 void Pow_tilde_setup(void){
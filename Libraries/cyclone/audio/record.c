@@ -163,7 +163,7 @@ static t_int *record_perform(t_int *w){
     t_float startms, endms, sync;
     long long int startsamp, endsamp, phase, range;
     int i, j;
-    cybuf_validate(c, 0);
+    cybuf_sync(c);
     clock_delay(x->x_clock, 0); // calculate a redraw
     for(i = 0; i < nblock; i++){
         startms = startin[i] < 0 ? 0 : startin[i];
@@ -5,11 +5,13 @@
 #include <math.h>
 #include "m_pd.h"
 #include <common/api.h>
+#include "signal/fastmath.h"
 
 typedef struct _sinx {
     t_object x_obj;
     t_inlet *sinx;
     t_outlet *x_outlet;
+    int       x_fast;
 } t_sinx;
 
 void *sinx_new(void);
@@ -20,20 +22,31 @@ static t_class *sinx_class;
 
 static t_int *sinx_perform(t_int *w)
 {
-    int nblock = (int)(w[1]);
-    t_float *in = (t_float *)(w[2]);
-    t_float *out = (t_float *)(w[3]);
-    while (nblock--)
-    {
-        float f = *in++;
-        *out++ = sinf(f);  /* CHECKED no protection against NaNs */
-    }
-    return (w + 4);
+    t_sinx *x = (t_sinx *)(w[1]);
+    int nblock = (int)(w[2]);
+    t_float *in = (t_float *)(w[3]);
+    t_float *out = (t_float *)(w[4]);
+    if (x->x_fast)
+        while (nblock--)
+            *out++ = fastmath_sin(*in++);
+    else
+        while (nblock--)
+            *out++ = sinf(*in++);  /* CHECKED no protection against NaNs */
+    return (w + 5);
 }
 
 static void sinx_dsp(t_sinx *x, t_signal **sp)
 {
-    dsp_add(sinx_perform, 3, sp[0]->s_n, sp[0]->s_vec, sp[1]->s_vec);
+    dsp_add(sinx_perform, 4, x, sp[0]->s_n, sp[0]->s_vec, sp[1]->s_vec);
+}
+
+static void sinx_precision(t_sinx *x, t_symbol *s)
+{
+    int fast = fastmath_precision(s);
+    if (fast < 0)
+        pd_error(x, "sinx~: precision is 'full' or 'fast'");
+    else
+        x->x_fast = fast;
 }
 
 void *sinx_new(void)
@@ -49,4 +62,5 @@ CYCLONE_OBJ_API void sinx_tilde_setup(void)
                            sizeof(t_sinx), CLASS_DEFAULT, 0);
     class_addmethod(sinx_class, nullfn, gensym("signal"), 0);
     class_addmethod(sinx_class, (t_method) sinx_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(sinx_class, (t_method) sinx_precision, gensym("precision"), A_SYMBOL, 0);
 }
@@ -13,6 +13,7 @@
 #include <math.h>
 #include "m_pd.h"
 #include <common/api.h>
+#include "common/magicbit.h"
 
 #define SVF_HZ        0
 #define SVF_LINEAR    1
@@ -36,8 +37,11 @@ typedef struct _svf
     t_inlet  *x_q_inlet;
     int    x_mode;
     float  x_srcoef;
-    float  x_band;
-    float  x_low;
+    int    x_nchans;
+    int    x_freq_nchans;
+    int    x_q_nchans;
+    float *x_band;  /* state of each channel */
+    float *x_low;
 } t_svf;
 
 static t_class *svf_class;
@@ -48,7 +52,9 @@ static t_symbol *ps_radians;
 
 static void svf_clear(t_svf *x)
 {
-    x->x_band = x->x_low = 0.;
+    int ch;
+    for (ch = 0; ch < x->x_nchans; ch++)
+	x->x_band[ch] = x->x_low[ch] = 0.;
 }
 
 static void svf_hz(t_svf *x)
@@ -68,19 +74,12 @@ static void svf_radians(t_svf *x)
 
 /* LATER make ready for optional audio-rate modulation
    (separate scalar case routines, use sic_makecostable(), etc.) */
-static t_int *svf_perform(t_int *w)
+static void svf_run(t_svf *x, int ch, int nblock, t_float *xin, t_float fin0,
+		    t_float rin0, t_float *lout, t_float *hout, t_float *bout,
+		    t_float *nout)
 {
-    t_svf *x = (t_svf *)(w[1]);
-    int nblock = (int)(w[2]);
-    t_float *xin = (t_float *)(w[3]);
-    t_float fin0 = *(t_float *)(w[4]);
-    t_float rin0 = *(t_float *)(w[5]);
-    t_float *lout = (t_float *)(w[6]);
-    t_float *hout = (t_float *)(w[7]);
-    t_float *bout = (t_float *)(w[8]);
-    t_float *nout = (t_float *)(w[9]);
-    float band = x->x_band;
-    float low = x->x_low;
+    float band = x->x_band[ch];
+    float low = x->x_low[ch];
     /* CHECKME sampled once per block */
     float c1, c2;
     float r = (1. - rin0) * SVF_QSTRETCH;  /* CHECKED */
@@ -113,13 +112,49 @@ static t_int *svf_perform(t_int *w)
 	band -= band * band * band * SVF_DRIVE;
     }
     /* LATER rethink */
-    x->x_band = (PD_BIGORSMALL(band) ? 0. : band);
-    x->x_low = (PD_BIGORSMALL(low) ? 0. : low);
+    x->x_band[ch] = (PD_BIGORSMALL(band) ? 0. : band);
+    x->x_low[ch] = (PD_BIGORSMALL(low) ? 0. : low);
+}
+
+/* one call for all channels, a control inlet with fewer channels
+   is reused for the rest */
+static t_int *svf_perform(t_int *w)
+{
+    t_svf *x = (t_svf *)(w[1]);
+    int nblock = (int)(w[2]);
+    t_float *xin = (t_float *)(w[3]);
+    t_float *fin = (t_float *)(w[4]);
+    t_float *rin = (t_float *)(w[5]);
+    t_float *lout = (t_float *)(w[6]);
+    t_float *hout = (t_float *)(w[7]);
+    t_float *bout = (t_float *)(w[8]);
+    t_float *nout = (t_float *)(w[9]);
+    int ch;
+    for (ch = 0; ch < x->x_nchans; ch++)
+    {
+	int offset = ch * nblock;
+	svf_run(x, ch, nblock, xin + offset, fin[(ch % x->x_freq_nchans) * nblock],
+		rin[(ch % x->x_q_nchans) * nblock], lout + offset, hout + offset,
+		bout + offset, nout + offset);
+    }
     return (w + 10);
 }
 
 static void svf_dsp(t_svf *x, t_signal **sp)
 {
+    int i, nchans = magic_nchans(sp[0]);
+    if (nchans != x->x_nchans)
+    {
+	x->x_band = (float *)resizebytes(x->x_band,
+	    x->x_nchans * sizeof(float), nchans * sizeof(float));
+	x->x_low = (float *)resizebytes(x->x_low,
+	    x->x_nchans * sizeof(float), nchans * sizeof(float));
+	x->x_nchans = nchans;
+    }
+    x->x_freq_nchans = magic_nchans(sp[1]);
+    x->x_q_nchans = magic_nchans(sp[2]);
+    for (i = 3; i < 7; i++)
+	magic_setmultiout(&sp[i], nchans);
     x->x_srcoef = TWO_PI / sp[0]->s_sr;
     svf_clear(x);
     dsp_add(svf_perform, 9, x, sp[0]->s_n,
@@ -148,6 +183,9 @@ static void *svf_new(t_symbol *s, int ac, t_atom *av)
 	    qcoef = av->a_w.w_float;
     }
     x->x_srcoef = M_PI / sys_getsr();
+    x->x_nchans = x->x_freq_nchans = x->x_q_nchans = 1;
+    x->x_band = (float *)getbytes(sizeof(float));
+    x->x_low = (float *)getbytes(sizeof(float));
 //  sic_newinlet((t_sic *)x, freq);
 //  sic_newinlet((t_sic *)x, qcoef);
     x->x_freq_inlet = inlet_new((t_object *)x, (t_pd *)x, &s_signal, &s_signal);
@@ -175,14 +213,20 @@ static void *svf_new(t_symbol *s, int ac, t_atom *av)
     return (x);
 }
 
+static void svf_free(t_svf *x)
+{
+    freebytes(x->x_band, x->x_nchans * sizeof(float));
+    freebytes(x->x_low, x->x_nchans * sizeof(float));
+}
+
 CYCLONE_OBJ_API void svf_tilde_setup(void)
 {
     ps_hz = gensym("hz");
     ps_linear = gensym("linear");
     ps_radians = gensym("radians");
     svf_class = class_new(gensym("svf~"),
-			  (t_newmethod)svf_new, 0,
-			  sizeof(t_svf), 0, A_GIMME, 0);
+			  (t_newmethod)svf_new, (t_method)svf_free,
+			  sizeof(t_svf), MAGIC_MULTICHANNEL, A_GIMME, 0);
     class_addmethod(svf_class, nullfn, gensym("signal"), 0);
     class_addmethod(svf_class, (t_method)svf_dsp, gensym("dsp"), A_CANT, 0);
     class_addmethod(svf_class, (t_method)svf_clear, gensym("clear"), 0);
@@ -46,6 +46,11 @@ typedef struct _collelem{
     struct _collelem  *e_next;
     int                e_size;
     t_atom            *e_data;
+    struct _collelem  *e_numnext;   /* next in the bucket of the key index */
+    struct _collelem  *e_symnext;
+    int                e_idxhasnum; /* the keys the element was indexed with */
+    int                e_idxnum;
+    t_symbol          *e_idxsym;
 }t_collelem;
 
 typedef struct _collcommon{
@@ -64,6 +69,11 @@ typedef struct _collcommon{
     t_collelem    *c_last;
     t_collelem    *c_head;
     int            c_headstate;
+    int            c_nelems;
+    t_collelem   **c_numindex;   /* hash index of the keys, the list keeps the order */
+    t_collelem   **c_symindex;
+    int            c_nbuckets;
+    int            c_indexdirty; /* keys changed in bulk, rebuilt on the next lookup */
 }t_collcommon;
 
 typedef struct _coll_q{    		/* element in a linked list of stored messages waiting to be sent out */
@@ -290,8 +300,102 @@ static int collelem_less(t_collelem *ep1, t_collelem *ep2, int ndx, int swap){
     return(isless);
 }
 
-static t_collelem *collcommon_numkey(t_collcommon *cc, int numkey){
+/* The index only speeds up lookups, the first element in the list with a key
+   is still the one found. Elements are indexed as they are linked in, changes
+   to the keys of many elements at once just mark the index for a rebuild. */
+
+#define COLL_MINBUCKETS 64
+
+static unsigned int coll_numhash(int numkey){
+    unsigned int h = (unsigned int)numkey * 2654435761u;
+    return(h ^ (h >> 16));
+}
+
+static unsigned int coll_symhash(t_symbol *s){
+    unsigned int h = (unsigned int)((size_t)s >> 3) * 2654435761u;
+    return(h ^ (h >> 16));
+}
+
+static void collcommon_index(t_collcommon *cc, t_collelem *ep){
+    if(cc->c_indexdirty)
+        return;
+    if(cc->c_nelems > cc->c_nbuckets){ // grown out of it
+        cc->c_indexdirty = 1;
+        return;
+    }
+    unsigned int mask = cc->c_nbuckets - 1;
+    if((ep->e_idxhasnum = ep->e_hasnumkey)){
+        t_collelem **bucket = cc->c_numindex + (coll_numhash(ep->e_numkey) & mask);
+        ep->e_idxnum = ep->e_numkey;
+        ep->e_numnext = *bucket;
+        *bucket = ep;
+    }
+    if((ep->e_idxsym = ep->e_symkey)){
+        t_collelem **bucket = cc->c_symindex + (coll_symhash(ep->e_symkey) & mask);
+        ep->e_symnext = *bucket;
+        *bucket = ep;
+    }
+}
+
+static void collcommon_unindex(t_collcommon *cc, t_collelem *ep){
+    if(cc->c_indexdirty)
+        return;
+    unsigned int mask = cc->c_nbuckets - 1;
+    t_collelem **epp;
+    if(ep->e_idxhasnum){
+        for(epp = cc->c_numindex + (coll_numhash(ep->e_idxnum) & mask); *epp; epp = &(*epp)->e_numnext){
+            if(*epp == ep){
+                *epp = ep->e_numnext;
+                break;
+            }
+        }
+    }
+    if(ep->e_idxsym){
+        for(epp = cc->c_symindex + (coll_symhash(ep->e_idxsym) & mask); *epp; epp = &(*epp)->e_symnext){
+            if(*epp == ep){
+                *epp = ep->e_symnext;
+                break;
+            }
+        }
+    }
+}
+
+static void collcommon_rebuildindex(t_collcommon *cc){
+    int nbuckets = COLL_MINBUCKETS;
+    while(nbuckets < 2 * cc->c_nelems)
+        nbuckets *= 2;
+    if(nbuckets != cc->c_nbuckets){
+        if(cc->c_nbuckets){
+            freebytes(cc->c_numindex, cc->c_nbuckets * sizeof(*cc->c_numindex));
+            freebytes(cc->c_symindex, cc->c_nbuckets * sizeof(*cc->c_symindex));
+        }
+        cc->c_numindex = getbytes(nbuckets * sizeof(*cc->c_numindex));
+        cc->c_symindex = getbytes(nbuckets * sizeof(*cc->c_symindex));
+        cc->c_nbuckets = nbuckets;
+    }
+    else{
+        memset(cc->c_numindex, 0, nbuckets * sizeof(*cc->c_numindex));
+        memset(cc->c_symindex, 0, nbuckets * sizeof(*cc->c_symindex));
+    }
+    cc->c_indexdirty = 0;
     t_collelem *ep;
+    for(ep = cc->c_first; ep; ep = ep->e_next)
+        collcommon_index(cc, ep);
+}
+
+static t_collelem *collcommon_numkey(t_collcommon *cc, int numkey){
+    t_collelem *ep, *found = 0;
+    if(cc->c_indexdirty)
+        collcommon_rebuildindex(cc);
+    for(ep = cc->c_numindex[coll_numhash(numkey) & (cc->c_nbuckets - 1)]; ep; ep = ep->e_numnext){
+        if(ep->e_hasnumkey && ep->e_numkey == numkey){
+            if(found) // more than one, find the first one in the list
+                break;
+            found = ep;
+        }
+    }
+    if(!ep)
+        return(found);
     for(ep = cc->c_first; ep; ep = ep->e_next)
 	if(ep->e_hasnumkey && ep->e_numkey == numkey)
 	    return(ep);
@@ -299,7 +403,18 @@ static t_collelem *collcommon_numkey(t_collcommon *cc, int numkey){
 }
 
 static t_collelem *collcommon_symkey(t_collcommon *cc, t_symbol *symkey){
-    t_collelem *ep;
+    t_collelem *ep, *found = 0;
+    if(cc->c_indexdirty)
+        collcommon_rebuildindex(cc);
+    for(ep = cc->c_symindex[coll_symhash(symkey) & (cc->c_nbuckets - 1)]; ep; ep = ep->e_symnext){
+        if(ep->e_symkey == symkey){
+            if(found)
+                break;
+            found = ep;
+        }
+    }
+    if(!ep)
+        return(found);
     for(ep = cc->c_first; ep; ep = ep->e_next)
 	if(ep->e_symkey == symkey)
         return(ep);
@@ -307,6 +422,8 @@ static t_collelem *collcommon_symkey(t_collcommon *cc, t_symbol *symkey){
 }
 
 static void collcommon_takeout(t_collcommon *cc, t_collelem *ep){
+    collcommon_unindex(cc, ep);
+    cc->c_nelems--;
     if(ep->e_prev)
         ep->e_prev->e_next = ep->e_next;
     else
@@ -346,6 +463,8 @@ static void collcommon_clearall(t_collcommon *cc){
         }
         while((ep1 = ep2));
             cc->c_first = cc->c_last = 0;
+        cc->c_nelems = 0;
+        cc->c_indexdirty = 1;
         cc->c_head = 0;
         cc->c_headstate = COLL_HEADRESET;
         collcommon_modified(cc, 1);
@@ -359,9 +478,11 @@ static void collcommon_remove(t_collcommon *cc, t_collelem *ep){
 }
 
 static void collcommon_replace(t_collcommon *cc, t_collelem *ep, int ac, t_atom *av, int *np, t_symbol *s){
+    collcommon_unindex(cc, ep);
     if((ep->e_hasnumkey = (np != 0)))
 	ep->e_numkey = *np;
     ep->e_symkey = s;
+    collcommon_index(cc, ep);
     if(ac){
         int i = ac;
         t_atom *ap;
@@ -402,6 +523,8 @@ static void collcommon_putbefore(t_collcommon *cc, t_collelem *ep, t_collelem *n
         bug("collcommon_putbefore");
     else
         cc->c_first = cc->c_last = ep;
+    cc->c_nelems++;
+    collcommon_index(cc, ep);
     collcommon_modified(cc, 1);
 }
 
@@ -418,6 +541,8 @@ static void collcommon_putafter(t_collcommon *cc, t_collelem *ep, t_collelem *pr
         bug("collcommon_putafter");
     else
         cc->c_first = cc->c_last = ep;
+    cc->c_nelems++;
+    collcommon_index(cc, ep);
     collcommon_modified(cc, 1);
 }
 
@@ -462,6 +587,10 @@ static void collcommon_swaplinks(t_collcommon *cc, t_collelem *ep1, t_collelem *
 }
 
 static void collcommon_swapkeys(t_collcommon *cc, t_collelem *ep1, t_collelem *ep2){
+    if(ep1 == ep2)
+        return;
+    collcommon_unindex(cc, ep1);
+    collcommon_unindex(cc, ep2);
     int hasnumkey = ep2->e_hasnumkey, numkey = ep2->e_numkey;
     t_symbol *symkey = ep2->e_symkey;
     ep2->e_hasnumkey = ep1->e_hasnumkey;
@@ -470,11 +599,23 @@ static void collcommon_swapkeys(t_collcommon *cc, t_collelem *ep1, t_collelem *e
     ep1->e_hasnumkey = hasnumkey;
     ep1->e_numkey = numkey;
     ep1->e_symkey = symkey;
+    collcommon_index(cc, ep1);
+    collcommon_index(cc, ep2);
     collcommon_modified(cc, 0);
 }
 
 static void collcommon_changesymkey(t_collcommon *cc, t_collelem *ep, t_symbol *s){
+    collcommon_unindex(cc, ep);
     ep->e_symkey = s;
+    collcommon_index(cc, ep);
+    collcommon_modified(cc, 0);
+}
+
+static void collcommon_changenumkey(t_collcommon *cc, t_collelem *ep, int numkey){
+    collcommon_unindex(cc, ep);
+    ep->e_hasnumkey = 1;
+    ep->e_numkey = numkey;
+    collcommon_index(cc, ep);
     collcommon_modified(cc, 0);
 }
 
@@ -488,6 +629,7 @@ static void collcommon_renumber2(t_collcommon *cc, int startkey){
             };
         };
     };
+    cc->c_indexdirty = 1;
     //i have no idea what this does but renumber does it so i'm doing it too - DK
     collcommon_modified(cc, 0);
 }
@@ -497,6 +639,7 @@ static void collcommon_renumber(t_collcommon *cc, int startkey){
     for(ep = cc->c_first; ep; ep = ep->e_next)
         if(ep->e_hasnumkey)
             ep->e_numkey = startkey++;
+    cc->c_indexdirty = 1;
     collcommon_modified(cc, 0);
 }
 
@@ -625,13 +768,11 @@ static t_collelem *collcommon_tonumkey(t_collcommon *cc, int numkey, int ac, t_a
                     //  elements with numkey == 0 not incremented (a bug?)
                     old->e_numkey++;
                 while((old = old->e_next));
+            cc->c_indexdirty = 1;
         };
         // CHECKED negative numkey always put before the last element,
         //  zero numkey always becomes the new head
-        t_collelem *closest = 0, *ep;
-        for(ep = cc->c_first; ep; ep = ep->e_next)
-            closest = ep;
-        collcommon_putafter(cc, new, closest);
+        collcommon_putafter(cc, new, cc->c_last);
 	}
     return(new);
 }
@@ -897,6 +1038,10 @@ static void collcommon_free(t_collcommon *cc){
         ep2 = ep1->e_next;
         collelem_free(ep1);
     }
+    if(cc->c_nbuckets){
+        freebytes(cc->c_numindex, cc->c_nbuckets * sizeof(*cc->c_numindex));
+        freebytes(cc->c_symindex, cc->c_nbuckets * sizeof(*cc->c_symindex));
+    }
 }
 
 static void *collcommon_new(void){
@@ -905,6 +1050,10 @@ static void *collcommon_new(void){
     cc->c_first = cc->c_last = 0;
     cc->c_head = 0;
     cc->c_headstate = COLL_HEADRESET;
+    cc->c_nelems = 0;
+    cc->c_numindex = cc->c_symindex = 0;
+    cc->c_nbuckets = 0;
+    cc->c_indexdirty = 1;
     cc->c_fileoninit = 0; //loaded file on init, change when successful loading
     return (cc);
 }
@@ -1245,7 +1394,7 @@ static void coll_nstore(t_coll *x, t_symbol *s, int ac, t_atom *av){
                 if((ep = collcommon_symkey(cc, av[1].a_w.w_symbol)))
                     collcommon_remove(cc, ep);
                 ep = collcommon_tonumkey(cc, numkey, ac-2, av+2, 1);
-                ep->e_symkey = av[1].a_w.w_symbol;
+                collcommon_changesymkey(cc, ep, av[1].a_w.w_symbol);
 			}
             coll_update(x);
 		}
@@ -1254,8 +1403,7 @@ static void coll_nstore(t_coll *x, t_symbol *s, int ac, t_atom *av){
                 if((ep = collcommon_numkey(cc, numkey)))
                     collcommon_remove(cc, ep);
                 ep = collcommon_tosymkey(cc, av->a_w.w_symbol, ac-2, av+2, 1);
-                ep->e_hasnumkey = 1;
-                ep->e_numkey = numkey;
+                collcommon_changenumkey(cc, ep, numkey);
 			}
             coll_update(x);
 		}
@@ -1288,6 +1436,7 @@ static void coll_insert2(t_coll *x, t_symbol *s, int ac, t_atom *av){
                     };
                 };
             };
+            cc->c_indexdirty = 1;
             //it looks like you use this when you don't change data, just keys? -DK
             collcommon_modified(cc, 0);
         }
@@ -1328,6 +1477,7 @@ static void coll_insert(t_coll *x, t_symbol *s, int ac, t_atom *av){
                 };
             };
         };
+        cc->c_indexdirty = 1;
         // it looks like you use this when you don't change data, just keys? -DK
         collcommon_modified(cc, 0);
         coll_update(x);
@@ -1357,6 +1507,7 @@ static void coll_delete(t_coll *x, t_symbol *s, int ac, t_atom *av){
 				for(next = ep->e_next; next; next = next->e_next)
 					if(next->e_hasnumkey && next->e_numkey > numkey)
                         next->e_numkey--;
+                x->x_common->c_indexdirty = 1;
             }
             collcommon_remove(x->x_common, ep);
             coll_update(x);
@@ -1593,11 +1744,7 @@ static void coll_nth(t_coll *x, t_symbol *s, int ac, t_atom *av){
 }
 
 static void coll_length(t_coll *x){
-    t_collcommon *cc = x->x_common;
-    t_collelem *ep = cc->c_first;
-    int result = 0;
-    while(ep) result++, ep = ep->e_next;
-    outlet_float(((t_object *)x)->ob_outlet, result);
+    outlet_float(((t_object *)x)->ob_outlet, x->x_common->c_nelems);
 }
 
 static void coll_min(t_coll *x, t_floatarg f){
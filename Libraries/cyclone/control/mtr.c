@@ -13,10 +13,12 @@
 #include <common/api.h>
 #include "common/shared.h"
 #include "common/file.h"
+#include "common/arena.h"
 
 #define MTR_C74MAXTRACKS    64
 #define MTR_FILEBUFSIZE   4096
 #define MTR_FILEMAXCOLUMNS  78
+#define MTR_RECBLOCKSIZE  1024  /* atoms per block while recording */
 
 enum { MTR_STEPMODE, MTR_RECMODE, MTR_PLAYMODE };
 
@@ -32,6 +34,7 @@ typedef struct _mtrack
     t_atom        *tr_atdelta;
     int            tr_ixnext;
     t_binbuf      *tr_binbuf;
+    t_arena        tr_recorded;  /* atoms recorded, until compacted */
     float          tr_tempo;
     double         tr_clockdelay;
     double         tr_prevtime;
@@ -55,8 +58,35 @@ typedef struct _mtr
 static t_class *mtrack_class;
 static t_class *mtr_class;
 
+/* appends the atoms recorded so far to the track's binbuf, they are kept apart
+   while recording, so that the binbuf isn't resized with every message, and stay
+   apart after it, until something reads the track.  They are added at once if
+   they fit in one buffer, so that the binbuf is resized only once */
+static void mtrack_compact(t_mtrack *tp)
+{
+    t_arena *a = &tp->tr_recorded;
+    size_t nbytes = a->a_count * sizeof(t_atom);
+    t_atom *buf;
+    if (!a->a_count)
+	return;
+    if ((buf = getbytes(nbytes)))
+    {
+	arena_copy(a, buf);
+	binbuf_add(tp->tr_binbuf, a->a_count, buf);
+	freebytes(buf, nbytes);
+    }
+    else
+    {
+	t_arenablock *b;
+	for (b = a->a_head; b; b = b->b_next)
+	    binbuf_add(tp->tr_binbuf, b->b_count, ARENA_ELEMENTS(b));
+    }
+    arena_clear(a);
+}
+
 static void mtrack_donext(t_mtrack *tp)
 {
+    mtrack_compact(tp);
     if (tp->tr_ixnext < 0)
 	goto endoftrack;
     while (1)
@@ -155,11 +185,15 @@ static void mtrack_setmode(t_mtrack *tp, int newmode){
         clock_unset(tp->tr_clock);
         tp->tr_ixnext = 0;
     }
+    else if (tp->tr_mode == MTR_RECMODE)
+        arena_stop(&tp->tr_recorded);
     switch(tp->tr_mode = newmode){
         case MTR_STEPMODE:
             break;
         case MTR_RECMODE:
             binbuf_clear(tp->tr_binbuf);
+            arena_clear(&tp->tr_recorded);
+            arena_start(&tp->tr_recorded);
             tp->tr_prevtime = clock_getlogicaltime();
             break;
         case MTR_PLAYMODE:
@@ -177,14 +211,16 @@ static void mtrack_doadd(t_mtrack *tp, int ac, t_atom *av)
 {
     if (tp->tr_prevtime > 0.)
     {
-	t_binbuf *bb = tp->tr_binbuf;
-	t_atom at;
+	t_arena *a = &tp->tr_recorded;
+	t_atom *ap;
     	float elapsed = clock_gettimesince(tp->tr_prevtime);
-	SETFLOAT(&at, elapsed);
-	binbuf_add(bb, 1, &at);
-	binbuf_add(bb, ac, av);
-	SETSEMI(&at);
-	binbuf_add(bb, 1, &at);
+	if ((ap = arena_add(a)))
+	    SETFLOAT(ap, elapsed);
+	while (ac--)
+	    if ((ap = arena_add(a)))
+		*ap = *av++;
+	if ((ap = arena_add(a)))
+	    SETSEMI(ap);
 	tp->tr_prevtime = clock_getlogicaltime();
     }
 }
@@ -295,10 +331,13 @@ static void mtrack_unmute(t_mtrack *tp)
 static void mtrack_clear(t_mtrack *tp)
 {
     binbuf_clear(tp->tr_binbuf);
+    arena_clear(&tp->tr_recorded);
 }
 
 static t_atom *mtrack_getdelay(t_mtrack *tp){
-    int natoms = binbuf_getnatom(tp->tr_binbuf);
+    int natoms;
+    mtrack_compact(tp);
+    natoms = binbuf_getnatom(tp->tr_binbuf);
     if (natoms){
         t_atom *ap = binbuf_getvec(tp->tr_binbuf);
         while (natoms--){
@@ -564,6 +603,7 @@ static void mtr_doread(t_mtr *x, t_mtrack *target, t_symbol *fname){
 		    if (tp)
 		    {
 			binbuf_clear(tp->tr_binbuf);
+			arena_clear(&tp->tr_recorded);
 		    }
 		}
 	    }
@@ -581,7 +621,9 @@ static void mtr_doread(t_mtr *x, t_mtrack *target, t_symbol *fname){
 
 static int mtr_writetrack(t_mtr *x, t_mtrack *tp, FILE *fp)
 {
-    int natoms = binbuf_getnatom(tp->tr_binbuf);
+    int natoms;
+    mtrack_compact(tp);
+    natoms = binbuf_getnatom(tp->tr_binbuf);
     if (natoms)  /* CHECKED empty tracks not stored */
     {
 	char sbuf[MTR_FILEBUFSIZE], *bp = sbuf, *ep = sbuf + MTR_FILEBUFSIZE;
@@ -711,6 +753,7 @@ static void mtr_free(t_mtr *x)
 	    t_mtrack *tp = *tpp++;
 	    if (tp->tr_binbuf) binbuf_free(tp->tr_binbuf);
 	    if (tp->tr_clock) clock_free(tp->tr_clock);
+	    arena_free(&tp->tr_recorded);
 	    pd_free((t_pd *)tp);
 	}
 	freebytes(x->x_tracks, x->x_ntracks * sizeof(*x->x_tracks));
@@ -770,6 +813,7 @@ static void *mtr_new(t_floatarg f)
 		    file_new((t_pd *)tp, 0,
 				   mtrack_readhook, mtrack_writehook, 0);
 		tp->tr_mode = MTR_STEPMODE;
+		arena_init(&tp->tr_recorded, sizeof(t_atom), MTR_RECBLOCKSIZE);
 		tp->tr_muted = 0;
 		tp->tr_restarted = 0;
 		tp->tr_atdelta = 0;
@@ -11,6 +11,7 @@
 //#include "g_canvas.h"
 #include <common/api.h>
 #include "common/grow.h"
+#include "common/arena.h"
 #include "common/file.h"
 #include "control/mifi.h"
 
@@ -19,6 +20,7 @@
 #endif */
 
 #define SEQ_INISEQSIZE           256   /* LATER rethink */
+#define SEQ_RECBLOCKSIZE        1024   /* events per block while recording */
 #define SEQ_INITEMPOMAPSIZE      128   /* LATER rethink */
 #define SEQ_EOM                  255   /* end of message marker, LATER rethink */
 #define SEQ_TICKSPERSEC          48
@@ -62,6 +64,8 @@ typedef struct _seq{
     int            x_evelength;
     int            x_expectedlength;
     int            x_eventreadhead;
+    t_seqevent     x_recevent;  /* the one being recorded */
+    t_arena        x_recorded;  /* recorded events, until compacted */
     int            x_seqsize;  /* as allocated */
     int            x_nevents;  /* as used */
     t_seqevent    *x_sequence;
@@ -103,13 +107,22 @@ static void seq_update(t_seq *x){
     sys_gui(" }\n");
     t_seqevent *ep = x->x_sequence;
     int nevents = x->x_nevents;
+    t_arenablock *bp = x->x_recorded.a_head;
     char buf[MAXPDSTRING+2];
     t_float sum = 0;
-    while(nevents--){  // LATER rethink sysex continuation
-        seq_eventstring(x, buf, ep, 1, &sum);
-        strcat(buf, ";\n");
-        editor_append(x->x_filehandle, buf);
-        ep++;
+    while(1){  // LATER rethink sysex continuation
+        while(nevents--){
+            seq_eventstring(x, buf, ep, 1, &sum);
+            strcat(buf, ";\n");
+            editor_append(x->x_filehandle, buf);
+            ep++;
+        }
+        if(!bp)
+            break;
+    /* events still being recorded are shown from where they are */
+        ep = ARENA_ELEMENTS(bp);
+        nevents = bp->b_count;
+        bp = bp->b_next;
     }
     editor_setdirty(x->x_filehandle, 0);
 }
@@ -127,6 +140,7 @@ static void seq_doclear(t_seq *x, int dofree){
             x->x_tempomapsize = SEQ_INITEMPOMAPSIZE;
         }
     }
+    arena_clear(&x->x_recorded);
     x->x_nevents = x->x_ntempi = 0;
 }
 
@@ -135,7 +149,31 @@ static void seq_clear(t_seq *x){
     seq_update(x);
 }
 
+/* appends the events recorded so far to the sequence, they are kept apart while
+   recording, so that the sequence isn't grown (and copied) on the way, and stay
+   apart after it, until something reads the sequence */
+static void seq_compact(t_seq *x){
+    int nrecorded = x->x_recorded.a_count;
+    if(nrecorded){
+        int nrequested = x->x_nevents + nrecorded;
+        if(nrequested > x->x_seqsize){
+            int nexisting = x->x_nevents;
+            x->x_sequence = grow_withdata(&nrequested, &nexisting, &x->x_seqsize, x->x_sequence,
+                SEQ_INISEQSIZE, x->x_seqini, sizeof(*x->x_sequence));
+            if(nrequested < x->x_nevents + nrecorded){
+                x->x_nevents = 0;
+                arena_clear(&x->x_recorded);
+                return;
+            }
+        }
+        arena_copy(&x->x_recorded, &x->x_sequence[x->x_nevents]);
+        x->x_nevents += nrecorded;
+        arena_clear(&x->x_recorded);
+    }
+}
+
 static int seq_dogrowing(t_seq *x, int nevents, int ntempi){
+    arena_clear(&x->x_recorded);
     if(nevents > x->x_seqsize){
         int nrequested = nevents;
 /* #ifdef SEQ_DEBUG
@@ -174,24 +212,13 @@ static void seq_complete(t_seq *x){
     /* CHECKED nothing stored */
     }
     else{
-        t_seqevent *ep = &x->x_sequence[x->x_nevents];
+        t_seqevent *ep = &x->x_recevent;
         ep->e_delta = clock_gettimesince(x->x_prevtime);
         x->x_prevtime = clock_getlogicaltime();
         if(x->x_evelength < 4)
             ep->e_bytes[x->x_evelength] = SEQ_EOM;
-        x->x_nevents++;
-        if(x->x_nevents >= x->x_seqsize){
-            int nexisting = x->x_seqsize;
-        /* store-ahead scheme, LATER consider using x_currevent */
-            int nrequested = x->x_nevents + 1;
-/* #ifdef SEQ_DEBUG
-        loudbug_post("growing...");
-#endif */
-            x->x_sequence = grow_withdata(&nrequested, &nexisting, &x->x_seqsize, x->x_sequence,
-                  SEQ_INISEQSIZE, x->x_seqini, sizeof(*x->x_sequence));
-            if(nrequested <= x->x_nevents)
-                x->x_nevents = 0;
-        }
+        if((ep = arena_add(&x->x_recorded)))
+            *ep = x->x_recevent;
     }
     x->x_evelength = 0;
 }
@@ -210,21 +237,21 @@ static void seq_checkstatus(t_seq *x, unsigned char c){
         x->x_expectedlength = -1;
     }
     else{
-        x->x_sequence[x->x_nevents].e_bytes[0] = c;
+        x->x_recevent.e_bytes[0] = c;
         x->x_evelength = x->x_expectedlength = 1;
         seq_complete(x);
         return;
     }
-    x->x_status = x->x_sequence[x->x_nevents].e_bytes[0] = c;
+    x->x_status = x->x_recevent.e_bytes[0] = c;
     x->x_evelength = 1;
 }
 
 static void seq_addbyte(t_seq *x, unsigned char c, int docomplete){
-    x->x_sequence[x->x_nevents].e_bytes[x->x_evelength++] = c;
+    x->x_recevent.e_bytes[x->x_evelength++] = c;
     if(x->x_evelength == x->x_expectedlength){
         seq_complete(x);
         if(x->x_status){
-            x->x_sequence[x->x_nevents].e_bytes[0] = x->x_status;
+            x->x_recevent.e_bytes[0] = x->x_status;
             x->x_evelength = 1;
         }
     }
@@ -253,6 +280,7 @@ static void seq_stoprecording(t_seq *x){
         seq_complete(x);
     /* CHECKED running status used in recording, but not across recordings */
     x->x_status = 0;
+    arena_stop(&x->x_recorded);
 }
 
 static void seq_stopplayback(t_seq *x){
@@ -278,6 +306,7 @@ static void seq_startrecording(t_seq *x){
     x->x_status = 0;
     x->x_evelength = 0;
     x->x_expectedlength = -1;  /* LATER rethink */
+    arena_start(&x->x_recorded);
 }
 
 /* CHECKED running status not used in playback */
@@ -285,6 +314,7 @@ static void seq_startplayback(t_seq *x, int modechanged){
     clock_unset(x->x_clock);
     x->x_playhead = 0;
     x->x_nextscoretime = 0.;
+    seq_compact(x);
     
     /* CHECKED bang not sent if sequence is empty */
     if(x->x_nevents){
@@ -310,6 +340,7 @@ static void seq_startplayback(t_seq *x, int modechanged){
 }
 
 static void seq_startslavery(t_seq *x){
+    seq_compact(x);
     if(x->x_nevents){
         x->x_playhead = 0;
         x->x_nextscoretime = 0.;
@@ -514,6 +545,7 @@ static void seq_stop(t_seq *x){
 
 // CHECKED first delta time is set permanently (it is stored in a file)
 static void seq_delay(t_seq *x, t_floatarg f){
+    seq_compact(x);
     if(x->x_nevents){ // CHECKED signed/unsigned bug (not emulated)
         t_float total_delay;
         x->x_delay = (f > SEQ_TICKEPSILON ? f : 0.);
@@ -523,6 +555,7 @@ static void seq_delay(t_seq *x, t_floatarg f){
 }
 
 static void seq_eventdelay(t_seq *x, t_floatarg f){
+    seq_compact(x);
     if(x->x_nevents){ // CHECKED signed/unsigned bug (not emulated)
         x->x_event_delay += f;
         t_float total_delay = (x->x_delay + x->x_event_delay);
@@ -533,6 +566,7 @@ static void seq_eventdelay(t_seq *x, t_floatarg f){
 // CHECKED all delta times are set permanently (they are stored in a file)
 static void seq_hook(t_seq *x, t_floatarg f){
     int nevents;
+    seq_compact(x);
     if((nevents = x->x_nevents)){
         t_seqevent *ev = x->x_sequence;
         if(f < 0)
@@ -564,6 +598,7 @@ static void seq_continue(t_seq *x){
 
 static void seq_click(t_seq *x, t_floatarg xpos, t_floatarg ypos, t_floatarg shift, t_floatarg ctrl, t_floatarg alt){
     ctrl = alt = xpos = ypos = shift = 0;
+    seq_compact(x);
     t_seqevent *ep = x->x_sequence;
     int nevents = x->x_nevents;
     char buf[MAXPDSTRING+2];
@@ -585,6 +620,7 @@ static void seq_click(t_seq *x, t_floatarg xpos, t_floatarg ypos, t_floatarg shi
 
 
  static void seq_goto(t_seq *x, t_floatarg f1, t_floatarg f2){ // takes sec / ms
+     seq_compact(x);
      if(x->x_nevents){
          t_seqevent *ev;
          int ndx, nevents = x->x_nevents;
@@ -928,6 +964,7 @@ static void seq_dowrite(t_seq *x, t_symbol *fn){
         buf[MAXPDSTRING-1] = 0;
     }
 //    post("seq: writing %s", fn->s_name);
+    seq_compact(x);
     /* save as text for any extension other then ".mid" */
     if((dotp = strrchr(fn->s_name, '.')) && strcmp(dotp + 1, "mid"))
         seq_textwrite(x, buf);
@@ -963,7 +1000,9 @@ static void seq_write(t_seq *x, t_symbol *s){
 }
 
 static void seq_print(t_seq *x){
-    int nevents = x->x_nevents;
+    int nevents;
+    seq_compact(x);
+    nevents = x->x_nevents;
     startpost("midiseq:");  // CHECKED
     if(nevents){
         t_seqevent *ep = x->x_sequence;
@@ -1003,6 +1042,7 @@ static void seq_free(t_seq *x){
         freebytes(x->x_sequence, x->x_seqsize * sizeof(*x->x_sequence));
     if(x->x_tempomap != x->x_tempomapini)
         freebytes(x->x_tempomap, x->x_tempomapsize * sizeof(*x->x_tempomap));
+    arena_free(&x->x_recorded);
 }
 
 static void *seq_new(t_symbol *s){
@@ -1017,6 +1057,7 @@ static void *seq_new(t_symbol *s){
     x->x_nevents = 0;
     x->x_delay = x->x_event_delay = 0;
     x->x_sequence = x->x_seqini;
+    arena_init(&x->x_recorded, sizeof(t_seqevent), SEQ_RECBLOCKSIZE);
     x->x_tempomapsize = SEQ_INITEMPOMAPSIZE;
     x->x_ntempi = 0;
     x->x_tempomap = x->x_tempomapini;
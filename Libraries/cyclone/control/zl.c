@@ -759,26 +759,90 @@ static int zl_sort_cmp(t_zl *x, t_atom *a1, t_atom *a2){
         return(0);
 }
 
-static void zl_sort_qsort(t_zl *x, t_atom *av1, t_atom *av2, int left, int right, int dir) {
-    int i, last;
-    if(left >= right)
-        return;
-    zl_swap(av1, left, (left + right)/2);
+/* introsort: quicksort with a median of three pivot, heapsort for ranges where
+   the partitions keep coming out lopsided, and insertion sort for short ranges.
+   av2, if given, is permuted along with av1 */
+
+#define ZL_SORT_SHORT 16
+
+static void zl_sort_swap(t_atom *av1, t_atom *av2, int i, int j){
+    zl_swap(av1, i, j);
     if(av2)
-    	zl_swap(av2, left, (left + right)/2);
-    last = left;
-    for (i = left+1; i <= right; i++) {
-        if((dir * zl_sort_cmp(x, av1 + i, av1 + left)) < 0){
-            zl_swap(av1, ++last, i);
-            if (av2)
-            	zl_swap(av2, last, i);
+        zl_swap(av2, i, j);
+}
+
+static void zl_sort_insertion(t_zl *x, t_atom *av1, t_atom *av2, int left, int right, int dir){
+    int i, j;
+    for(i = left + 1; i <= right; i++)
+        for(j = i; j > left && dir * zl_sort_cmp(x, av1 + j, av1 + j - 1) < 0; j--)
+            zl_sort_swap(av1, av2, j, j - 1);
+}
+
+static void zl_sort_siftdown(t_zl *x, t_atom *av1, t_atom *av2, int base, int root, int n, int dir){
+    int child;
+    while((child = 2 * root + 1) < n){
+        if(child + 1 < n && dir * zl_sort_cmp(x, av1 + base + child, av1 + base + child + 1) < 0)
+            child++;
+        if(dir * zl_sort_cmp(x, av1 + base + root, av1 + base + child) >= 0)
+            return;
+        zl_sort_swap(av1, av2, base + root, base + child);
+        root = child;
+    }
+}
+
+static void zl_sort_heapsort(t_zl *x, t_atom *av1, t_atom *av2, int left, int right, int dir){
+    int n = right - left + 1, i;
+    for(i = n / 2 - 1; i >= 0; i--)
+        zl_sort_siftdown(x, av1, av2, left, i, n, dir);
+    for(i = n - 1; i > 0; i--){
+        zl_sort_swap(av1, av2, left, left + i);
+        zl_sort_siftdown(x, av1, av2, left, 0, i, dir);
+    }
+}
+
+static void zl_sort_introsort(t_zl *x, t_atom *av1, t_atom *av2, int left, int right, int dir, int depth){
+    while(right - left >= ZL_SORT_SHORT){
+        if(depth-- <= 0){
+            zl_sort_heapsort(x, av1, av2, left, right, dir);
+            return;
+        }
+        int mid = left + (right - left) / 2, i = left, j = right + 1;
+        if(dir * zl_sort_cmp(x, av1 + mid, av1 + left) < 0)
+            zl_sort_swap(av1, av2, mid, left);
+        if(dir * zl_sort_cmp(x, av1 + right, av1 + left) < 0)
+            zl_sort_swap(av1, av2, right, left);
+        if(dir * zl_sort_cmp(x, av1 + right, av1 + mid) < 0)
+            zl_sort_swap(av1, av2, right, mid);
+        zl_sort_swap(av1, av2, left, mid); // the pivot waits at the left
+        // stopping at equal atoms keeps lists with many repeats balanced
+        for(;;){
+            do i++;
+            while(i < right && dir * zl_sort_cmp(x, av1 + i, av1 + left) < 0);
+            do j--;
+            while(j > left && dir * zl_sort_cmp(x, av1 + left, av1 + j) < 0);
+            if(i >= j)
+                break;
+            zl_sort_swap(av1, av2, i, j);
+        }
+        zl_sort_swap(av1, av2, left, j);
+        // recursing into the smaller side only keeps the stack shallow
+        if(j - left < right - j){
+            zl_sort_introsort(x, av1, av2, left, j - 1, dir, depth);
+            left = j + 1;
+        }
+        else{
+            zl_sort_introsort(x, av1, av2, j + 1, right, dir, depth);
+            right = j - 1;
         }
     }
-    zl_swap(av1, left, last);
-    if (av2)
-    	zl_swap(av2, left, last);
-    zl_sort_qsort(x, av1, av2, left, last-1, dir);
-    zl_sort_qsort(x, av1, av2, last+1, right, dir);
+    zl_sort_insertion(x, av1, av2, left, right, dir);
+}
+
+static void zl_sort_sort(t_zl *x, t_atom *av1, t_atom *av2, int natoms, int dir){
+    int depth = 0, n;
+    for(n = natoms; n > 1; n >>= 1)
+        depth += 2;
+    zl_sort_introsort(x, av1, av2, 0, natoms - 1, dir, depth);
 }
 
 static void zl_sort_rev(t_zl *x, int natoms, t_atom *av) {
@@ -806,7 +870,7 @@ static void zl_sort(t_zl *x, int natoms, t_atom *buf, int banged){
 			memcpy(buf, x->x_inbuf1.d_buf, natoms * sizeof(*buf));
 			for (int i = 0; i < natoms; i++)
     			SETFLOAT(&buf2[i], i);
-    		zl_sort_qsort(x, buf, buf2, 0, natoms - 1, x->x_modearg);
+    		zl_sort_sort(x, buf, buf2, natoms, x->x_modearg);
     		//
     		x->x_inbuf1.d_sorted = x->x_modearg;
     		zl_output2(x, natoms, buf2);
@@ -1092,7 +1156,7 @@ static void zl_median(t_zl *x, int natoms, t_atom *buf, int banged){
 			//post ("total %d", total);
 		}
 		if (total) {
-			zl_sort_qsort(x, buf, 0, 0, total - 1, 1);
+			zl_sort_sort(x, buf, 0, total, 1);
 			//zl_output2(x,total,buf);
 			if (total % 2)
 				outlet_float(((t_object *)x)->ob_outlet, buf[total/2].a_w.w_float);
@@ -0,0 +1,236 @@
+/* Copyright (c) 2002-2003 krzYszcz and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "m_pd.h"
+#include "arena.h"
+
+#define ARENA_NSPARE  2  /* blocks kept ahead of each write head */
+
+/* One thread serves every arena.  It is started the first time an arena
+   is, and runs for as long as the process does, so that nothing has to
+   wait for it to finish.  The pd thread only ever holds the mutex for a few
+   pointer moves, and doesn't wait for it when adding. */
+static pthread_once_t arena_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t arena_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t arena_cond = PTHREAD_COND_INITIALIZER;
+static int arena_threaded;
+static t_arena *arena_started;        /* arenas being recorded into */
+static t_arenablock *arena_garbage;   /* blocks for the thread to free */
+
+/* blocks are malloc'ed, since the thread makes and frees them too */
+static t_arenablock *arena_newblock(size_t nbytes)
+{
+    return ((t_arenablock *)malloc(sizeof(t_arenablock) + nbytes));
+}
+
+static void arena_freeblocks(t_arenablock *b)
+{
+    while (b)
+    {
+	t_arenablock *next = b->b_next;
+	free(b);
+	b = next;
+    }
+}
+
+static t_arena *arena_findhungry(size_t nbytes)
+{
+    t_arena *a;
+    for (a = arena_started; a; a = a->a_next)
+	if (a->a_nspare < ARENA_NSPARE &&
+	    (!nbytes || a->a_blocksize * a->a_typesize == nbytes))
+	    return (a);
+    return (0);
+}
+
+/* the mutex is let go of while allocating and freeing, so the arena that
+   wanted a block is looked for again, it might have been stopped meanwhile */
+static void *arena_refill(void *dummy)
+{
+    pthread_mutex_lock(&arena_mutex);
+    while (1)
+    {
+	t_arena *a;
+	if (arena_garbage)
+	{
+	    t_arenablock *garbage = arena_garbage;
+	    arena_garbage = 0;
+	    pthread_mutex_unlock(&arena_mutex);
+	    arena_freeblocks(garbage);
+	    pthread_mutex_lock(&arena_mutex);
+	}
+	else if ((a = arena_findhungry(0)))
+	{
+	    size_t nbytes = a->a_blocksize * a->a_typesize;
+	    t_arenablock *b;
+	    pthread_mutex_unlock(&arena_mutex);
+	    b = arena_newblock(nbytes);
+	    pthread_mutex_lock(&arena_mutex);
+	    if (!b)
+		pthread_cond_wait(&arena_cond, &arena_mutex);
+	    else if ((a = arena_findhungry(nbytes)))
+	    {
+		b->b_next = a->a_spare;
+		a->a_spare = b;
+		a->a_nspare++;
+	    }
+	    else
+	    {
+		b->b_next = arena_garbage;
+		arena_garbage = b;
+	    }
+	}
+	else pthread_cond_wait(&arena_cond, &arena_mutex);
+    }
+    return (dummy);
+}
+
+static void arena_startthread(void)
+{
+    pthread_t thread;
+    if (pthread_create(&thread, 0, arena_refill, 0) == 0)
+    {
+	pthread_detach(thread);
+	arena_threaded = 1;
+    }
+}
+
+/* takes a spare block, only allocating if the thread fell behind, couldn't
+   be started, or is holding the mutex right now */
+static t_arenablock *arena_takeblock(t_arena *a)
+{
+    t_arenablock *b = 0;
+    if (a->a_started && arena_threaded &&
+	pthread_mutex_trylock(&arena_mutex) == 0)
+    {
+	if ((b = a->a_spare))
+	{
+	    a->a_spare = b->b_next;
+	    a->a_nspare--;
+	}
+	pthread_cond_signal(&arena_cond);
+	pthread_mutex_unlock(&arena_mutex);
+    }
+    return (b ? b : arena_newblock(a->a_blocksize * a->a_typesize));
+}
+
+/* hands a chain of blocks to the thread, which frees them */
+static void arena_discard(t_arenablock *head, t_arenablock *tail)
+{
+    if (!head)
+	return;
+    pthread_once(&arena_once, arena_startthread);
+    if (arena_threaded)
+    {
+	pthread_mutex_lock(&arena_mutex);
+	tail->b_next = arena_garbage;
+	arena_garbage = head;
+	pthread_cond_signal(&arena_cond);
+	pthread_mutex_unlock(&arena_mutex);
+    }
+    else arena_freeblocks(head);
+}
+
+void arena_init(t_arena *a, size_t typesize, int blocksize)
+{
+    a->a_typesize = typesize;
+    a->a_blocksize = blocksize;
+    a->a_count = 0;
+    a->a_head = a->a_tail = 0;
+    a->a_spare = 0;
+    a->a_nspare = 0;
+    a->a_started = 0;
+    a->a_next = 0;
+}
+
+void arena_free(t_arena *a)
+{
+    arena_stop(a);
+    arena_clear(a);
+}
+
+/* called when recording starts, the thread is asked for spares */
+void arena_start(t_arena *a)
+{
+    if (a->a_started)
+	return;
+    pthread_once(&arena_once, arena_startthread);
+    if (!arena_threaded)
+	return;
+    pthread_mutex_lock(&arena_mutex);
+    a->a_next = arena_started;
+    arena_started = a;
+    a->a_started = 1;
+    pthread_cond_signal(&arena_cond);
+    pthread_mutex_unlock(&arena_mutex);
+}
+
+/* called when recording stops, the spares go back to the thread */
+void arena_stop(t_arena *a)
+{
+    t_arena **ap;
+    t_arenablock *spare, *last;
+    if (!a->a_started)
+	return;
+    pthread_mutex_lock(&arena_mutex);
+    for (ap = &arena_started; *ap; ap = &(*ap)->a_next)
+    {
+	if (*ap == a)
+	{
+	    *ap = a->a_next;
+	    break;
+	}
+    }
+    a->a_next = 0;
+    a->a_started = 0;
+    spare = a->a_spare;
+    a->a_spare = 0;
+    a->a_nspare = 0;
+    pthread_mutex_unlock(&arena_mutex);
+    for (last = spare; last && last->b_next; last = last->b_next);
+    arena_discard(spare, last);
+}
+
+/* returns room for one more element, or 0 if out of memory */
+void *arena_add(t_arena *a)
+{
+    t_arenablock *b = a->a_tail;
+    if (!b || b->b_count == a->a_blocksize)
+    {
+	if (!(b = arena_takeblock(a)))
+	    return (0);
+	b->b_next = 0;
+	b->b_count = 0;
+	if (a->a_tail)
+	    a->a_tail->b_next = b;
+	else
+	    a->a_head = b;
+	a->a_tail = b;
+    }
+    a->a_count++;
+    return ((char *)ARENA_ELEMENTS(b) + a->a_typesize * b->b_count++);
+}
+
+void arena_clear(t_arena *a)
+{
+    arena_discard(a->a_head, a->a_tail);
+    a->a_head = a->a_tail = 0;
+    a->a_count = 0;
+}
+
+/* copies the elements, in order, to dest, which has room for a_count of them */
+void arena_copy(t_arena *a, void *dest)
+{
+    t_arenablock *b;
+    char *cp = dest;
+    for (b = a->a_head; b; b = b->b_next)
+    {
+	size_t nbytes = b->b_count * a->a_typesize;
+	memcpy(cp, ARENA_ELEMENTS(b), nbytes);
+	cp += nbytes;
+    }
+}
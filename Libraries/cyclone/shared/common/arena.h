@@ -0,0 +1,47 @@
+/* Copyright (c) 2002-2003 krzYszcz and others.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* Recording storage: a chain of fixed-size blocks, so that adding an element
+   never moves the ones stored already.  While an arena is started, a thread
+   shared by all arenas keeps a few spare blocks ahead of its write head, and
+   frees the blocks of cleared arenas, so adding and clearing don't allocate
+   or free either.  Readers walk the blocks, or copy them out into one
+   contiguous buffer when they need one. */
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+typedef struct _arenablock
+{
+    struct _arenablock  *b_next;
+    int                  b_count;  /* elements used */
+    /* the elements follow */
+} t_arenablock;
+
+#define ARENA_ELEMENTS(b)  ((void *)((t_arenablock *)(b) + 1))
+
+typedef struct _arena
+{
+    size_t           a_typesize;
+    int              a_blocksize;  /* elements per block */
+    int              a_count;      /* elements stored */
+    t_arenablock    *a_head;
+    t_arenablock    *a_tail;
+    t_arenablock    *a_spare;      /* blocks ready for the write head */
+    int              a_nspare;
+    int              a_started;
+    struct _arena   *a_next;       /* in the list the thread refills */
+} t_arena;
+
+void arena_init(t_arena *a, size_t typesize, int blocksize);
+void arena_free(t_arena *a);
+void arena_start(t_arena *a);
+void arena_stop(t_arena *a);
+void *arena_add(t_arena *a);
+void arena_clear(t_arena *a);
+void arena_copy(t_arena *a, void *dest);
+
+#endif
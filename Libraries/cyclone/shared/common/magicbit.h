@@ -43,3 +43,15 @@ static inline int BITWISE_ISDENORM(t_float f)
 	mask.f = f;
 	return ((mask.ui & 0x07f800000) == 0);
 }
+
+// multichannel connections, for pd versions that have them (0.54 on), signals have
+// one channel otherwise and pd sets up the outlets as always
+#ifdef CLASS_MULTICHANNEL
+#define MAGIC_MULTICHANNEL CLASS_MULTICHANNEL
+#define magic_nchans(sig) ((sig)->s_nchans)
+#define magic_setmultiout(sig, nchans) signal_setmultiout(sig, nchans)
+#else
+#define MAGIC_MULTICHANNEL 0
+#define magic_nchans(sig) 1
+#define magic_setmultiout(sig, nchans)
+#endif
@@ -42,16 +42,21 @@ t_word *cybuf_get(t_cybuf *c, t_symbol * name, int *bufsize, int indsp, int comp
     return (0);
 }
 
+/* bumps the epoch if the vectors or the size differ from the old ones */
+static void cybuf_publish(t_cybuf *c, t_word **old, int oldnpts)
+{
+    if (c->c_npts != oldnpts || memcmp(old, c->c_vectors, c->c_numchans * sizeof(*old)))
+        c->c_epoch++;
+}
+
 //making peek~ work with channel number choosing, assuming 1-indexed
-void cybuf_getchannel(t_cybuf *c, int chan_num, int complain){
+static void cybuf_dogetchannel(t_cybuf *c, int chan_num, int complain){
     int chan_idx;
     char buf[MAXPDSTRING];
-    t_symbol * curname; //name of the current channel we want
     int vsz = c->c_npts;  
     t_word *retvec = NULL;//pointer to the corresponding channel to return
     //1-indexed bounds checking
     chan_num = chan_num < 1 ? 1 : (chan_num > CYBUF_MAXCHANS ? CYBUF_MAXCHANS : chan_num);
-    c->c_single = chan_num;
     //convert to 0-indexing, separate steps and diff variable for sanity's sake
     chan_idx = chan_num - 1;
     //making the buffer channel name string we'll be looking for
@@ -61,20 +66,33 @@ void cybuf_getchannel(t_cybuf *c, int chan_num, int complain){
             //since checking for 0-bufname as well, don't complain here
             retvec = cybuf_get(c, c->c_bufname, &vsz, 1, 0);
             if(retvec){
+                c->c_single = chan_num;
                 c->c_vectors[0] = retvec;
                 if (vsz < c->c_npts) c->c_npts = vsz;
                 return;
             };
         };
-        sprintf(buf, "%d-%s", chan_idx, c->c_bufname->s_name);
-        curname =  gensym(buf);
-        retvec = cybuf_get(c, curname, &vsz, 1, complain);
+        //this runs every block for poke~, only build the name when it changes
+        if(!c->c_singlename || c->c_singlefor != c->c_bufname || c->c_single != chan_num){
+            sprintf(buf, "%d-%s", chan_idx, c->c_bufname->s_name);
+            c->c_singlename = gensym(buf);
+            c->c_singlefor = c->c_bufname;
+        };
+        c->c_single = chan_num;
+        retvec = cybuf_get(c, c->c_singlename, &vsz, 1, complain);
         //if channel found and less than c_npts, reset c_npts
         if (vsz < c->c_npts) c->c_npts = vsz;
         c->c_vectors[0] = retvec;
         return;
     };
+    c->c_single = chan_num;
+}
 
+void cybuf_getchannel(t_cybuf *c, int chan_num, int complain){
+    t_word *old = c->c_vectors[0];
+    int oldnpts = c->c_npts;
+    cybuf_dogetchannel(c, chan_num, complain);
+    cybuf_publish(c, &old, oldnpts);
 }
 
 void cybuf_bug(char *fmt, ...)
@@ -147,6 +165,9 @@ void cybuf_redraw(t_cybuf *c)
 
 void cybuf_validate(t_cybuf *c, int complain)
 {
+    t_word *old[CYBUF_MAXCHANS];
+    int oldnpts = c->c_npts;
+    memcpy(old, c->c_vectors, c->c_numchans * sizeof(*old));
     cybuf_clear(c);
     c->c_npts = SHARED_INT_MAX;
     if(!c->c_single){
@@ -174,9 +195,10 @@ void cybuf_validate(t_cybuf *c, int complain)
         };
     }
     else{
-        cybuf_getchannel(c, c->c_single, complain);
+        cybuf_dogetchannel(c, c->c_single, complain);
     };
     if (c->c_npts == SHARED_INT_MAX) c->c_npts = 0;
+    cybuf_publish(c, old, oldnpts);
 }
 
 void cybuf_playcheck(t_cybuf *c){
@@ -244,7 +266,35 @@ void cybuf_dsp(t_cybuf *x, t_signal **sp, t_perfroutine perf, int complain)
 void cybuf_checkdsp(t_cybuf *c){
     cybuf_validate(c, 1);
     cybuf_playcheck(c);
+    c->c_fadelen = (int)(sys_getsr() * CYBUF_DECLICKMS * 0.001);
+}
+
+int cybuf_sync(t_cybuf *c)
+{
+    unsigned int epoch = c->c_epoch;
+    cybuf_validate(c, 0);
+    cybuf_playcheck(c);
+    return (c->c_epoch != epoch);
+}
 
+void cybuf_declick(t_cybuf *c, t_float **outs, int nch, int n)
+{
+    int ch, i;
+    if (c->c_seen != c->c_epoch){
+        c->c_seen = c->c_epoch;
+        c->c_fade = c->c_fadelen;
+    };
+    if (nch > c->c_numchans) nch = c->c_numchans;
+    for (ch = 0; ch < nch; ch++){
+        t_float *out = outs[ch];
+        t_float last = c->c_last[ch];
+        for (i = 0; i < n && i < c->c_fade; i++){
+            t_float gain = (t_float)(c->c_fade - i) / (t_float)c->c_fadelen;
+            out[i] += gain * (last - out[i]);
+        };
+        c->c_last[ch] = out[n-1];
+    };
+    c->c_fade = c->c_fade > n ? c->c_fade - n : 0;
 }
 
 
@@ -256,6 +306,9 @@ void cybuf_free(t_cybuf *c)
     if (c->c_channames){
         freebytes(c->c_channames, c->c_numchans * sizeof(*c->c_channames));
     };
+    if (c->c_last){
+        freebytes(c->c_last, c->c_numchans * sizeof(*c->c_last));
+    };
     freebytes(c, sizeof(t_cybuf));
 }
 
@@ -284,6 +337,7 @@ void *cybuf_init(t_class *owner, t_symbol *bufname, int numchans, int singlemode
 		freebytes(vectors, numchans * sizeof(*vectors));
 	return (0);
     };
+    c->c_last = (t_float *)getbytes(numchans * sizeof(*c->c_last));
     c->c_single = singlemode;
     c->c_owner = owner;
     c->c_npts = 0;
@@ -293,6 +347,9 @@ void *cybuf_init(t_class *owner, t_symbol *bufname, int numchans, int singlemode
     c->c_playable = 0;
     c->c_minsize = 1;
     c->c_numchans = numchans;
+    c->c_singlename = c->c_singlefor = 0;
+    c->c_epoch = c->c_seen = 0;
+    c->c_fade = c->c_fadelen = 0;
     if(bufname != &s_){
             cybuf_initarray(c, bufname, 0);
     };
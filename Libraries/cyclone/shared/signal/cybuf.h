@@ -15,6 +15,7 @@
 #endif
 
 #define CYBUF_MAXCHANS 64 //max number of channels
+#define CYBUF_DECLICKMS 5  //crossfade when the arrays are swapped under a player
 
 typedef struct _cybuf
 {
@@ -33,6 +34,16 @@ typedef struct _cybuf
     int         c_single; //flag for single channel mode
                         //0-regular mode, 1-load this particular channel (1-idx)
                         //should be used with c_numchans == 1
+    t_symbol   *c_singlename; //array name of c_single, so it's not rebuilt every block
+    t_symbol   *c_singlefor;  //c_bufname that c_singlename was built for
+    /* c_vectors and c_npts are a snapshot, only replaced while validating.  c_epoch
+       changes when a validation finds other vectors or another size, readers use it
+       to notice the arrays were resized or reloaded and declick the swap */
+    unsigned int c_epoch;
+    unsigned int c_seen;    //epoch the declick has last seen
+    int         c_fade;     //samples left of the declick ramp
+    int         c_fadelen;
+    t_float    *c_last;     //last output of each channel, the ramp starts from it
 } t_cybuf;
 
 void cybuf_bug(char *fmt, ...);
@@ -62,4 +73,11 @@ void cybuf_free(t_cybuf *c);
 void cybuf_checkdsp(t_cybuf *c);
 void cybuf_getchannel(t_cybuf *c, int chan_num, int complain);
 
+//once per block from perform routines, instead of cybuf_validate: revalidates
+//quietly and returns nonzero if a new snapshot was published
+int cybuf_sync(t_cybuf *c);
+//at the end of a player's perform routine: after a swap, crossfades the outputs
+//from the last samples played before it
+void cybuf_declick(t_cybuf *c, t_float **outs, int nch, int n);
+
 #endif
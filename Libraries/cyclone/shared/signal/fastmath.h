@@ -0,0 +1,173 @@
+/* Copyright (c) 2022 the cyclone authors.
+ * For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ * WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* Polynomial approximations for the signal math objects, used with
+   'precision fast'.  The coefficients are Cephes' single precision ones,
+   and the range reductions select instead of branching, so the loop over
+   a block vectorizes.  Errors are against double precision libm, measured
+   over the ranges given:
+
+   fastmath_sin, fastmath_cos   abs error < 1e-7 for |x| < 8192
+   fastmath_tan                 rel error < 3e-7 for |x| < 8192
+   fastmath_atan2               abs error < 3e-7
+   fastmath_exp                 rel error < 1.5e-7, x is clamped to [-87, 88]
+   fastmath_log                 abs error < 2e-7 * max(1, |log(x)|), x > 0
+   fastmath_tanh                abs error < 1e-7
+   fastmath_pow                 rel error < 2e-7 * (1 + |y * log(x)|), x > 0
+
+   NaNs and infinities aren't handled, the objects don't protect against
+   them either. */
+
+#ifndef __FASTMATH_H__
+#define __FASTMATH_H__
+
+#include <stdint.h>
+
+#define FASTMATH_PI     3.14159265358979323846f
+#define FASTMATH_PIO2   1.57079632679489661923f
+#define FASTMATH_PIO4   0.78539816339744830962f
+#define FASTMATH_FOPI   1.27323954473516268615f /* 4/pi */
+
+typedef union _fastmath_bits
+{
+    float    b_f;
+    int32_t  b_i;
+} t_fastmath_bits;
+
+/* reduces |x| to r in [-pi/4, pi/4], j is the octant rounded to even. The
+   subtraction is done in double, a Cody-Waite split would be undone by
+   -ffast-math reassociating it */
+static inline float fastmath_reduce(float ax, int *j)
+{
+    int k = (int)(ax * FASTMATH_FOPI);
+    k += k & 1;
+    *j = k;
+    return ((float)((double)ax - (double)k * 0.785398163397448309616));
+}
+
+static inline float fastmath_sinpoly(float r)
+{
+    float z = r * r;
+    return (((-1.9515295891e-4f * z + 8.3321608736e-3f) * z
+        - 1.6666654611e-1f) * z * r + r);
+}
+
+static inline float fastmath_cospoly(float r)
+{
+    float z = r * r;
+    return (((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z
+        + 4.166664568298827e-2f) * z * z - 0.5f * z + 1.f);
+}
+
+static inline float fastmath_sin(float x)
+{
+    int j;
+    float r = fastmath_reduce(x < 0 ? -x : x, &j);
+    float y = (j & 2) ? fastmath_cospoly(r) : fastmath_sinpoly(r);
+    return (((j & 4) != 0) != (x < 0) ? -y : y);
+}
+
+static inline float fastmath_cos(float x)
+{
+    int j;
+    float r = fastmath_reduce(x < 0 ? -x : x, &j);
+    float y = (j & 2) ? fastmath_sinpoly(r) : fastmath_cospoly(r);
+    return (((j + 2) & 4) ? -y : y);
+}
+
+static inline float fastmath_tan(float x)
+{
+    int j;
+    float r = fastmath_reduce(x < 0 ? -x : x, &j);
+    float z = r * r;
+    float y = (((((9.38540185543e-3f * z + 3.11992232697e-3f) * z
+        + 2.44301354525e-2f) * z + 5.34112807005e-2f) * z
+        + 1.33387994085e-1f) * z + 3.33331568548e-1f) * z * r + r;
+    y = (j & 2) ? -1.f / y : y;
+    return (x < 0 ? -y : y);
+}
+
+/* atan of a in [0, 1] */
+static inline float fastmath_atan01(float a)
+{
+    int big = a > 0.4142135623730950f;
+    float t = big ? (a - 1.f) / (a + 1.f) : a;
+    float z = t * t;
+    float y = (((8.05374449538e-2f * z - 1.38776856032e-1f) * z
+        + 1.99777106478e-1f) * z - 3.33329491539e-1f) * z * t + t;
+    return (big ? y + FASTMATH_PIO4 : y);
+}
+
+static inline float fastmath_atan2(float y, float x)
+{
+    float ax = x < 0 ? -x : x, ay = y < 0 ? -y : y;
+    float hi = ax > ay ? ax : ay, lo = ax > ay ? ay : ax;
+    float a = fastmath_atan01(hi > 0 ? lo / hi : 0.f);
+    a = ay > ax ? FASTMATH_PIO2 - a : a;
+    a = x < 0 ? FASTMATH_PI - a : a;
+    return (y < 0 ? -a : a);
+}
+
+static inline float fastmath_exp(float x)
+{
+    x = x < -87.f ? -87.f : x > 88.f ? 88.f : x;
+    int n = (int)(x * 1.44269504088896341f + (x < 0 ? -0.5f : 0.5f));
+    x = (float)((double)x - (double)n * 0.693147180559945309417);
+    float z = x * x;
+    float y = ((((((1.9875691500e-4f * x + 1.3981999507e-3f) * x
+        + 8.3334519073e-3f) * x + 4.1665795894e-2f) * x
+        + 1.6666665459e-1f) * x + 5.0000001201e-1f) * z + x + 1.f);
+    t_fastmath_bits b;
+    b.b_i = (n + 127) << 23;
+    return (y * b.b_f);
+}
+
+/* x > 0 */
+static inline float fastmath_log(float x)
+{
+    t_fastmath_bits b;
+    b.b_f = x;
+    float e = (float)(((b.b_i >> 23) & 0xff) - 126);
+    b.b_i = (b.b_i & 0x807fffff) | 0x3f000000; /* mantissa in [0.5, 1) */
+    int small = b.b_f < 0.707106781186547524f;
+    e = small ? e - 1.f : e;
+    float m = small ? b.b_f + b.b_f - 1.f : b.b_f - 1.f;
+    float z = m * m;
+    float y = ((((((((7.0376836292e-2f * m - 1.1514610310e-1f) * m
+        + 1.1676998740e-1f) * m - 1.2420140846e-1f) * m
+        + 1.4249322787e-1f) * m - 1.6668057665e-1f) * m
+        + 2.0000714765e-1f) * m - 2.4999993993e-1f) * m
+        + 3.3333331174e-1f) * m * z;
+    y += e * -2.12194440e-4f - 0.5f * z;
+    return (m + y + e * 0.693359375f);
+}
+
+static inline float fastmath_tanh(float x)
+{
+    float ax = x < 0 ? -x : x;
+    /* near 0 the series, away from it 1 - 2 / (exp(2x) + 1) */
+    float z = x * x;
+    float s = ((((-5.70498872745e-3f * z + 2.06390887954e-2f) * z
+        - 5.37397155531e-2f) * z + 1.33314422036e-1f) * z
+        - 3.33332819422e-1f) * z * x + x;
+    float e = fastmath_exp(2.f * (ax > 9.f ? 9.f : ax));
+    float t = 1.f - 2.f / (e + 1.f);
+    t = x < 0 ? -t : t;
+    return (ax < 0.625f ? s : t);
+}
+
+/* x to the power of y */
+static inline float fastmath_pow(float x, float y)
+{
+    return (fastmath_exp(y * fastmath_log(x)));
+}
+
+/* the argument of the 'precision' message, 1 for fast, 0 for full and -1 for
+   anything else, include after m_pd.h */
+static inline int fastmath_precision(t_symbol *s)
+{
+    return (s == gensym("fast") ? 1 : s == gensym("full") ? 0 : -1);
+}
+
+#endif /* __FASTMATH_H__ */
@@ -133,7 +133,11 @@ struct _instanceinter {
     pd_gui_callback gui_callback;
     pd_panel_callback panel_callback;
     pd_synchronise_callback synchronise_callback;
+    pd_canvas_event_callback canvas_event_callback;
     void* callback_target;
+
+    int dsp_update_depth;
+    int dsp_update_state;
 };
 
 void register_gui_triggers(t_pdinstance* instance, void* target, pd_gui_callback gui_callback, pd_panel_callback panel_callback, pd_synchronise_callback synchronise_callback, pd_parameter_callback parameter_callback)
@@ -150,6 +154,16 @@ void register_gui_triggers(t_pdinstance* instance, void* target, pd_gui_callback
     instance->pd_inter->callback_target = target;
 }
 
+void register_canvas_event_hook(t_pdinstance* instance, pd_canvas_event_callback canvas_event_callback)
+{
+
+#if !PDINSTANCE
+    instance = &pd_maininstance;
+#endif
+
+    instance->pd_inter->canvas_event_callback = canvas_event_callback;
+}
+
 void update_gui_parameters()
 {
     if (pd_this->pd_inter->parameter_callback) {
@@ -171,6 +185,32 @@ void synchronise_canvas(void* cnv_target)
     }
 }
 
+void canvas_event(void const* event)
+{
+    if (pd_this->pd_inter->canvas_event_callback) {
+        pd_this->pd_inter->canvas_event_callback(pd_this->pd_inter->callback_target, event);
+    }
+}
+
+void suspend_dsp_updates(void)
+{
+    t_instanceinter* inter = pd_this->pd_inter;
+    if (inter->dsp_update_depth++ == 0) {
+        inter->dsp_update_state = canvas_suspend_dsp();
+    }
+}
+
+void resume_dsp_updates(void)
+{
+    t_instanceinter* inter = pd_this->pd_inter;
+    if (inter->dsp_update_depth <= 0)
+        return;
+
+    if (--inter->dsp_update_depth == 0) {
+        canvas_resume_dsp(inter->dsp_update_state);
+    }
+}
+
 void create_panel(int openpanel, char const* path, char const* snd)
 {
     if (pd_this->pd_inter->panel_callback) {
@@ -5,5 +5,14 @@ typedef void (*pd_parameter_callback)(void*);
 typedef void (*pd_gui_callback)(void*, void*);
 typedef void (*pd_panel_callback)(void*, int, char const*, char const*);
 typedef void (*pd_synchronise_callback)(void*, void*);
+typedef void (*pd_canvas_event_callback)(void*, void const*);
 
 void register_gui_triggers(t_pdinstance* instance, void* target, pd_gui_callback gui_callback, pd_panel_callback panel_callback, pd_synchronise_callback synchronise_callback, pd_parameter_callback parameter_callback);
+
+// Receives a t_libpd_canvas_event for every structural change, calls go to the target of the gui triggers
+void register_canvas_event_hook(t_pdinstance* instance, pd_canvas_event_callback canvas_event_callback);
+void canvas_event(void const* event);
+
+// Defers rebuilding the DSP graph until the outermost resume, calls can be nested
+void suspend_dsp_updates(void);
+void resume_dsp_updates(void);
@@ -0,0 +1,198 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <m_pd.h>
+#include <m_imp.h>
+#include <g_canvas.h>
+
+#include "x_libpd_abscache.h"
+
+void glob_setfilename(void* dummy, t_symbol* filesym, t_symbol* dirsym);
+
+// A parsed abstraction file, valid as long as the file has the same modification time and size
+typedef struct _abscache_entry {
+    t_symbol* e_path;
+    time_t e_mtime;
+    off_t e_size;
+    t_binbuf* e_binbuf;
+    struct _abscache_entry* e_next;
+} t_abscache_entry;
+
+// Per instance state, bound to a symbol since symbols are local to each pd instance,
+// and so are the symbols in the parsed files
+typedef struct _abscache {
+    t_pd x_pd;
+    t_abscache_entry* x_entries;
+} t_abscache;
+
+static t_class* abscache_class;
+static t_anymethod abscache_new_anything;
+
+static t_symbol* abscache_symbol(void)
+{
+    return gensym("#plugdata_abscache");
+}
+
+static t_abscache* abscache_get(int create)
+{
+    t_abscache* x = (t_abscache*)pd_findbyclass(abscache_symbol(), abscache_class);
+    if (!x && create) {
+        x = (t_abscache*)pd_new(abscache_class);
+        x->x_entries = 0;
+        pd_bind(&x->x_pd, abscache_symbol());
+    }
+    return x;
+}
+
+static t_symbol* abscache_path(char const* dir, char const* name)
+{
+    char path[MAXPDSTRING];
+    snprintf(path, MAXPDSTRING, "%s/%s", dir, name);
+    return gensym(path);
+}
+
+static void abscache_remove(t_abscache* x, t_symbol* path)
+{
+    t_abscache_entry **p = &x->x_entries, *e;
+    while ((e = *p)) {
+        if (e->e_path == path) {
+            *p = e->e_next;
+            binbuf_free(e->e_binbuf);
+            freebytes(e, sizeof(*e));
+            return;
+        }
+        p = &e->e_next;
+    }
+}
+
+// Returns the parsed file, reading it when it isn't cached or changed since
+static t_binbuf* abscache_read(char const* dir, char const* name)
+{
+    t_abscache* x = abscache_get(1);
+    t_symbol* path = abscache_path(dir, name);
+    t_abscache_entry* e;
+    struct stat st;
+
+    if (stat(path->s_name, &st) != 0)
+        return 0;
+
+    for (e = x->x_entries; e; e = e->e_next) {
+        if (e->e_path == path) {
+            if (e->e_mtime == st.st_mtime && e->e_size == st.st_size)
+                return e->e_binbuf;
+            abscache_remove(x, path);
+            break;
+        }
+    }
+
+    e = (t_abscache_entry*)getbytes(sizeof(*e));
+    e->e_binbuf = binbuf_new();
+    if (binbuf_read(e->e_binbuf, (char*)name, (char*)dir, 0)) {
+        binbuf_free(e->e_binbuf);
+        freebytes(e, sizeof(*e));
+        return 0;
+    }
+
+    e->e_path = path;
+    e->e_mtime = st.st_mtime;
+    e->e_size = st.st_size;
+    e->e_next = x->x_entries;
+    x->x_entries = e;
+    return e->e_binbuf;
+}
+
+// Same as pd's do_create_abstraction and binbuf_evalfile, but the file comes from the cache
+static void* abscache_create_abstraction(t_symbol* s, int argc, t_atom* argv)
+{
+    char dirbuf[MAXPDSTRING], classslashclass[MAXPDSTRING], aliased[MAXPDSTRING], *nameptr;
+    t_canvas* canvas = glist_getcanvas((t_glist*)canvas_getcurrent());
+    t_pd *was = s__X.s_thing, *bounda, *boundn;
+    t_binbuf* b = 0;
+    int fd, dspstate;
+
+    snprintf(classslashclass, MAXPDSTRING, "%s/%s", s->s_name, s->s_name);
+    if ((fd = canvas_open(canvas, s->s_name, ".pd", dirbuf, &nameptr, MAXPDSTRING, 0)) >= 0
+        || (fd = canvas_open(canvas, classslashclass, ".pd", dirbuf, &nameptr, MAXPDSTRING, 0)) >= 0) {
+        sys_close(fd);
+        b = abscache_read(dirbuf, nameptr);
+    }
+
+    // Anything we can't read, like a .pat file, is left to pd's own creator
+    if (!b) {
+        snprintf(aliased, MAXPDSTRING, "%s_aliased", s->s_name);
+        pd_typedmess(&pd_objectmaker, gensym(aliased), argc, argv);
+        return pd_newest();
+    }
+
+    if (pd_setloadingabstraction(s))
+        return 0;
+
+    canvas_setargs(argc, argv);
+    dspstate = canvas_suspend_dsp();
+    glob_setfilename(0, gensym(nameptr), gensym(dirbuf));
+
+    // Save the bindings of #N and #A, like binbuf_evalfile does
+    bounda = gensym("#A")->s_thing;
+    boundn = s__N.s_thing;
+    gensym("#A")->s_thing = 0;
+    s__N.s_thing = &pd_canvasmaker;
+
+    binbuf_eval(b, 0, 0, 0);
+
+    gensym("#A")->s_thing = bounda;
+    s__N.s_thing = boundn;
+
+    glob_setfilename(0, &s_, &s_);
+    canvas_resume_dsp(dspstate);
+
+    if (s__X.s_thing && was != s__X.s_thing)
+        canvas_popabstraction((t_canvas*)(s__X.s_thing));
+    else
+        s__X.s_thing = was;
+    canvas_setargs(0, 0);
+
+    return pd_newest();
+}
+
+// pd registers a creator for every abstraction it loads, ours takes its place once the first instance exists
+static void abscache_anything(t_pd* dummy, t_symbol* s, int argc, t_atom* argv)
+{
+    t_pd* newest;
+
+    abscache_new_anything(dummy, s, argc, argv);
+
+    newest = pd_newest();
+    if (newest && pd_class(newest) == canvas_class && canvas_isabstraction((t_canvas*)newest)
+        && zgetfn(&pd_objectmaker, s) != (t_gotfn)abscache_create_abstraction) {
+        class_addcreator((t_newmethod)abscache_create_abstraction, s, A_GIMME, 0);
+    }
+}
+
+void libpd_abscache_setup(void)
+{
+    abscache_class = class_new(gensym("abstraction cache"), 0, 0, sizeof(t_abscache), CLASS_PD, 0);
+
+    abscache_new_anything = pd_objectmaker->c_anymethod;
+    pd_objectmaker->c_anymethod = abscache_anything;
+}
+
+void libpd_abscache_invalidate(t_symbol* name, t_symbol* dir)
+{
+    t_abscache* x = abscache_get(0);
+    if (x)
+        abscache_remove(x, abscache_path(dir->s_name, name->s_name));
+}
+
+void libpd_abscache_clear(void)
+{
+    t_abscache* x = abscache_get(0);
+    while (x && x->x_entries)
+        abscache_remove(x, x->x_entries->e_path);
+}
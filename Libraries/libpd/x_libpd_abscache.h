@@ -0,0 +1,29 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <m_pd.h>
+
+// Installs the cache of parsed abstraction files, needs to be called once after libpd_init
+// pd reads and parses the file of an abstraction again for every instance, and for every copy of a [clone].
+// Once pd has loaded an abstraction, its creator is replaced by one that keeps the parsed file per instance,
+// keyed by path and checked against the file's modification time and size. .pat files aren't cached.
+void libpd_abscache_setup(void);
+
+// Drops the parsed file of dir/name for the current instance, so the next instance reads it again
+void libpd_abscache_invalidate(t_symbol* name, t_symbol* dir);
+
+// Drops all parsed files of the current instance
+void libpd_abscache_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
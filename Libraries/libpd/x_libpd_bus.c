@@ -0,0 +1,133 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <string.h>
+
+#include <m_pd.h>
+
+#include "x_libpd_bus.h"
+
+typedef struct _bus_tilde {
+    t_object x_obj;
+    t_float x_f;
+    t_symbol* x_name;
+    void* x_endpoint;
+    int x_issender;
+} t_bus_tilde;
+
+static t_class* sendbus_tilde_class;
+static t_class* receivebus_tilde_class;
+
+static t_libpd_bus_registry const* bus_registry;
+
+static void bus_tilde_release(t_bus_tilde* x)
+{
+    if (x->x_endpoint && bus_registry)
+        bus_registry->release(x->x_endpoint);
+    x->x_endpoint = 0;
+}
+
+static void bus_tilde_acquire(t_bus_tilde* x)
+{
+    if (!bus_registry || x->x_name == &s_)
+        return;
+
+    x->x_endpoint = bus_registry->acquire(x->x_name->s_name, x->x_issender);
+    if (!x->x_endpoint && x->x_issender)
+        pd_error(x, "sendbus~ %s: bus already has a sender", x->x_name->s_name);
+}
+
+static t_int* sendbus_tilde_perform(t_int* w)
+{
+    t_bus_tilde* x = (t_bus_tilde*)(w[1]);
+    t_sample* in = (t_sample*)(w[2]);
+    int n = (int)(w[3]);
+
+    if (x->x_endpoint)
+        bus_registry->write(x->x_endpoint, in, n);
+
+    return w + 4;
+}
+
+static t_int* receivebus_tilde_perform(t_int* w)
+{
+    t_bus_tilde* x = (t_bus_tilde*)(w[1]);
+    t_sample* out = (t_sample*)(w[2]);
+    int n = (int)(w[3]);
+
+    if (x->x_endpoint)
+        bus_registry->read(x->x_endpoint, out, n);
+    else
+        memset(out, 0, n * sizeof(t_sample));
+
+    return w + 4;
+}
+
+static void sendbus_tilde_dsp(t_bus_tilde* x, t_signal** sp)
+{
+    dsp_add(sendbus_tilde_perform, 3, x, sp[0]->s_vec, (t_int)sp[0]->s_n);
+}
+
+static void receivebus_tilde_dsp(t_bus_tilde* x, t_signal** sp)
+{
+    dsp_add(receivebus_tilde_perform, 3, x, sp[0]->s_vec, (t_int)sp[0]->s_n);
+}
+
+// Switches to another bus, the DSP chain is only rebuilt by pd, so this can be done while audio runs
+// The endpoint is swapped with the instance locked, which the audio thread also holds while it runs
+static void bus_tilde_set(t_bus_tilde* x, t_symbol* s)
+{
+    bus_tilde_release(x);
+    x->x_name = s;
+    bus_tilde_acquire(x);
+}
+
+static void* bus_tilde_new(t_class* c, t_symbol* s, int issender)
+{
+    t_bus_tilde* x = (t_bus_tilde*)pd_new(c);
+    x->x_f = 0;
+    x->x_name = s;
+    x->x_endpoint = 0;
+    x->x_issender = issender;
+    bus_tilde_acquire(x);
+    return x;
+}
+
+static void* sendbus_tilde_new(t_symbol* s)
+{
+    return bus_tilde_new(sendbus_tilde_class, s, 1);
+}
+
+static void* receivebus_tilde_new(t_symbol* s)
+{
+    t_bus_tilde* x = (t_bus_tilde*)bus_tilde_new(receivebus_tilde_class, s, 0);
+    outlet_new(&x->x_obj, &s_signal);
+    return x;
+}
+
+static void bus_tilde_free(t_bus_tilde* x)
+{
+    bus_tilde_release(x);
+}
+
+void libpd_bus_setup(void)
+{
+    sendbus_tilde_class = class_new(gensym("sendbus~"), (t_newmethod)sendbus_tilde_new, (t_method)bus_tilde_free,
+        sizeof(t_bus_tilde), 0, A_DEFSYM, 0);
+    CLASS_MAINSIGNALIN(sendbus_tilde_class, t_bus_tilde, x_f);
+    class_addmethod(sendbus_tilde_class, (t_method)sendbus_tilde_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(sendbus_tilde_class, (t_method)bus_tilde_set, gensym("set"), A_DEFSYM, 0);
+
+    receivebus_tilde_class = class_new(gensym("receivebus~"), (t_newmethod)receivebus_tilde_new, (t_method)bus_tilde_free,
+        sizeof(t_bus_tilde), CLASS_NOINLET, A_DEFSYM, 0);
+    class_addmethod(receivebus_tilde_class, (t_method)receivebus_tilde_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(receivebus_tilde_class, (t_method)bus_tilde_set, gensym("set"), A_DEFSYM, 0);
+}
+
+void libpd_bus_set_registry(t_libpd_bus_registry const* registry)
+{
+    bus_registry = registry;
+}
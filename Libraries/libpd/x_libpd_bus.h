@@ -0,0 +1,38 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <m_pd.h>
+
+// Audio buses shared by every instance in the process, which pd can't do itself since each instance has its own symbols
+// An endpoint is a sender or a receiver of the bus with that name. A bus has one sender at a time, acquire
+// returns NULL for a second one. Acquire and release are called from the pd thread of an instance, read and
+// write from its audio thread, and they must not lock or allocate.
+typedef struct _libpd_bus_registry {
+    void* (*acquire)(char const* name, int issender);
+    void (*release)(void* endpoint);
+    void (*write)(void* endpoint, t_sample const* in, int n);
+    void (*read)(void* endpoint, t_sample* out, int n);
+} t_libpd_bus_registry;
+
+// Adds [sendbus~ name] and [receivebus~ name], needs to be called once after libpd_init
+// They work like [send~] and [receive~], but between all instances in the process, like the tracks of a
+// host that each have a plugdata on them. A receiver gets what was sent in the same block when the sender's
+// instance ran first, a block later otherwise.
+void libpd_bus_setup(void);
+
+// Sets the registry that the buses live in, or removes it when registry is NULL
+// Objects created without a registry are silent
+void libpd_bus_set_registry(t_libpd_bus_registry const* registry);
+
+#ifdef __cplusplus
+}
+#endif
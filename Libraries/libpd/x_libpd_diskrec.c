@@ -0,0 +1,184 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <string.h>
+
+#include <m_pd.h>
+#include <g_canvas.h>
+
+#include "x_libpd_diskrec.h"
+
+#define DISKREC_MAXCHANS 64
+#define DISKREC_POLLTIME 100 // ms between looks at the writer while recording
+
+typedef struct _diskrec_tilde {
+    t_object x_obj;
+    t_float x_f;
+    t_canvas* x_canvas;
+    int x_nchans;
+    t_sample** x_vecs;
+    void* x_recorder;
+    char x_path[MAXPDSTRING]; // empty when no file is open
+    int x_bits;
+    int x_recording;
+    double x_dropped;
+    t_clock* x_clock;
+    t_outlet* x_out;
+} t_diskrec_tilde;
+
+static t_class* diskrec_tilde_class;
+
+static t_libpd_diskrec_registry const* diskrec_registry;
+
+static t_int* diskrec_tilde_perform(t_int* w)
+{
+    t_diskrec_tilde* x = (t_diskrec_tilde*)(w[1]);
+    int n = (int)(w[2]);
+
+    if (x->x_recording && diskrec_registry)
+        diskrec_registry->write(x->x_recorder, (t_sample const* const*)x->x_vecs, n);
+
+    return w + 3;
+}
+
+static void diskrec_tilde_dsp(t_diskrec_tilde* x, t_signal** sp)
+{
+    for (int i = 0; i < x->x_nchans; i++)
+        x->x_vecs[i] = sp[i]->s_vec;
+
+    dsp_add(diskrec_tilde_perform, 2, x, (t_int)sp[0]->s_n);
+}
+
+// Ends the recording and closes the file, the writer finishes it in the background
+static void diskrec_tilde_close(t_diskrec_tilde* x)
+{
+    if (x->x_recording && diskrec_registry)
+        diskrec_registry->stop(x->x_recorder);
+    x->x_recording = 0;
+    x->x_path[0] = 0;
+    clock_unset(x->x_clock);
+}
+
+// Reports what the writer ran into since the last look, it fails on its own thread so this can only poll
+static void diskrec_tilde_tick(t_diskrec_tilde* x)
+{
+    double dropped = 0;
+    if (!x->x_recording || !diskrec_registry)
+        return;
+
+    if (!diskrec_registry->status(x->x_recorder, &dropped)) {
+        pd_error(x, "diskrec~: couldn't write the file");
+        diskrec_tilde_close(x);
+        return;
+    }
+
+    if (dropped != x->x_dropped) {
+        x->x_dropped = dropped;
+        outlet_float(x->x_out, dropped);
+    }
+
+    clock_delay(x->x_clock, DISKREC_POLLTIME);
+}
+
+// Only remembers the file, it's created when recording starts
+static void diskrec_tilde_open(t_diskrec_tilde* x, t_symbol* s, t_floatarg bits)
+{
+    char path[MAXPDSTRING];
+
+    diskrec_tilde_close(x);
+
+    if (!x->x_recorder || !diskrec_registry || s == &s_)
+        return;
+
+    canvas_makefilename(x->x_canvas, s->s_name, path, MAXPDSTRING);
+    sys_bashfilename(path, path);
+
+    x->x_bits = bits > 0 ? (int)bits : 24;
+    if (!diskrec_registry->check(path, x->x_bits)) {
+        pd_error(x, "diskrec~: can't write '%s', use a .wav, .flac or .aiff file with 16, 24 or 32 bits", s->s_name);
+        return;
+    }
+
+    strcpy(x->x_path, path);
+}
+
+static void diskrec_tilde_start(t_diskrec_tilde* x)
+{
+    if (!x->x_path[0]) {
+        pd_error(x, "diskrec~: no file open");
+        return;
+    }
+
+    if (x->x_recording || !diskrec_registry)
+        return;
+
+    if (!diskrec_registry->start(x->x_recorder, x->x_path, sys_getsr(), x->x_bits)) {
+        pd_error(x, "diskrec~: still finishing the previous files");
+        return;
+    }
+
+    x->x_recording = 1;
+    x->x_dropped = 0;
+    clock_delay(x->x_clock, DISKREC_POLLTIME);
+}
+
+static void diskrec_tilde_stop(t_diskrec_tilde* x)
+{
+    diskrec_tilde_tick(x);
+    diskrec_tilde_close(x);
+}
+
+static void* diskrec_tilde_new(t_floatarg f)
+{
+    t_diskrec_tilde* x = (t_diskrec_tilde*)pd_new(diskrec_tilde_class);
+    int nchans = f < 1 ? 1 : (f > DISKREC_MAXCHANS ? DISKREC_MAXCHANS : (int)f);
+
+    x->x_f = 0;
+    x->x_canvas = canvas_getcurrent();
+    x->x_nchans = nchans;
+    x->x_vecs = (t_sample**)getbytes(nchans * sizeof(t_sample*));
+    // The buffer is allocated here, so nothing that records has to
+    x->x_recorder = diskrec_registry ? diskrec_registry->create(nchans, sys_getsr()) : 0;
+    x->x_path[0] = 0;
+    x->x_bits = 24;
+    x->x_recording = 0;
+    x->x_dropped = 0;
+    x->x_clock = clock_new(x, (t_method)diskrec_tilde_tick);
+
+    if (!x->x_recorder)
+        pd_error(x, "diskrec~: can't record here");
+
+    for (int i = 1; i < nchans; i++)
+        inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
+    x->x_out = outlet_new(&x->x_obj, &s_float);
+
+    return x;
+}
+
+static void diskrec_tilde_free(t_diskrec_tilde* x)
+{
+    diskrec_tilde_close(x);
+    if (x->x_recorder && diskrec_registry)
+        diskrec_registry->release(x->x_recorder);
+    clock_free(x->x_clock);
+    freebytes(x->x_vecs, x->x_nchans * sizeof(t_sample*));
+}
+
+void libpd_diskrec_setup(void)
+{
+    diskrec_tilde_class = class_new(gensym("diskrec~"), (t_newmethod)diskrec_tilde_new, (t_method)diskrec_tilde_free,
+        sizeof(t_diskrec_tilde), 0, A_DEFFLOAT, 0);
+    CLASS_MAINSIGNALIN(diskrec_tilde_class, t_diskrec_tilde, x_f);
+    class_addmethod(diskrec_tilde_class, (t_method)diskrec_tilde_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(diskrec_tilde_class, (t_method)diskrec_tilde_open, gensym("open"), A_SYMBOL, A_DEFFLOAT, 0);
+    class_addmethod(diskrec_tilde_class, (t_method)diskrec_tilde_start, gensym("start"), 0);
+    class_addmethod(diskrec_tilde_class, (t_method)diskrec_tilde_stop, gensym("stop"), 0);
+}
+
+void libpd_diskrec_set_registry(t_libpd_diskrec_registry const* registry)
+{
+    diskrec_registry = registry;
+}
@@ -0,0 +1,47 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <m_pd.h>
+
+// Writes recordings to disk on a thread of its own, so the audio thread never waits for the disk
+// Every object gets a recorder when it's created, which is the only call that allocates, and nothing locks.
+// Write is called from the audio thread of an instance, everything else from its pd thread. The files are
+// created by the writer once recording starts, and it keeps going after stop and release until everything
+// that was written is on disk.
+typedef struct _libpd_diskrec_registry {
+    // Returns NULL when there's no memory for a buffer of a few seconds at this samplerate
+    void* (*create)(int nchans, double samplerate);
+    // The writer deletes the recorder once it's done with it
+    void (*release)(void* recorder);
+    // Returns 0 when files with this path's extension can't be written with this many bits
+    int (*check)(char const* path, int bits);
+    // Returns 0 when the writer still has too many earlier recordings of this recorder to finish
+    int (*start)(void* recorder, char const* path, double samplerate, int bits);
+    void (*stop)(void* recorder);
+    void (*write)(void* recorder, t_sample const* const* in, int n);
+    // Returns 0 when the file couldn't be created or written, and the samples that didn't fit in the buffer since start
+    int (*status)(void* recorder, double* dropped);
+} t_libpd_diskrec_registry;
+
+// Adds [diskrec~ nchans], needs to be called once after libpd_init
+// It records its signal inlets to a file, "open file [bits]" picks it, wav, flac or aiff by the extension, and
+// "start" and "stop" record. While it records, the outlet reports the samples that were dropped because the disk
+// fell behind, whenever that changes.
+void libpd_diskrec_setup(void);
+
+// Sets the registry that writes the files, or removes it when registry is NULL
+// Objects created without a registry can't record
+void libpd_diskrec_set_registry(t_libpd_diskrec_registry const* registry);
+
+#ifdef __cplusplus
+}
+#endif
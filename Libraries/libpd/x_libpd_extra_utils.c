@@ -4,8 +4,14 @@
  // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
  */
 
+#include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
 
 #include <m_pd.h>
 #include <m_imp.h>
@@ -14,6 +20,7 @@
 #include <m_imp.h>
 #include <g_all_guis.h>
 #include "x_libpd_multi.h"
+#include "x_libpd_mod_utils.h"
 
 // False GARRAY
 typedef struct _fake_garray {
@@ -60,6 +67,185 @@ void* libpd_create_canvas(char const* name, char const* path)
     return cnv;
 }
 
+void glob_setfilename(void* dummy, t_symbol* filesym, t_symbol* dirsym);
+void pd_doloadbang(void);
+
+// Pointer past the semicolon that ends the message at buf, or end
+static char const* libpd_message_end(char const* buf, char const* end)
+{
+    while (buf < end) {
+        if (*buf == '\\')
+            buf++;
+        else if (*buf == ';')
+            return buf + 1;
+        buf++;
+    }
+    return end;
+}
+
+// Reads the next number of a message into f. Returns 0 at the end of the message,
+// -1 for anything that pd's parser wouldn't make a plain float of
+static int libpd_parse_float(char const** buf, char const* end, t_float* f)
+{
+    char token[64];
+    char const* p = *buf;
+    int n = 0;
+
+    while (p < end && isspace((unsigned char)*p))
+        p++;
+
+    if (p == end || *p == ';') {
+        *buf = p;
+        return 0;
+    }
+
+    while (p < end && !isspace((unsigned char)*p) && *p != ';') {
+        if (!strchr("0123456789+-.eE", *p) || n == sizeof(token) - 1)
+            return -1;
+        token[n++] = *p++;
+    }
+    token[n] = 0;
+
+    *f = atof(token);
+    *buf = p;
+    return 1;
+}
+
+// Applies a "#A <onset> <values>" message to the array bound to #A, like garray_list does
+// buf points after the #A. Returns 0 when the message has to go through pd instead
+static int libpd_set_array_contents(char const* buf, char const* end)
+{
+    t_pd* target = gensym("#A")->s_thing;
+    t_word* vec;
+    t_float f;
+    int size, onset, result;
+
+    if (!target || (*target)->c_name != gensym("array") || !garray_getfloatwords((t_garray*)target, &size, &vec))
+        return 0;
+
+    if (libpd_parse_float(&buf, end, &f) != 1)
+        return 0;
+
+    // Values that are written before finding something we can't parse are written again by pd
+    for (onset = f; (result = libpd_parse_float(&buf, end, &f)) == 1; onset++) {
+        if (onset >= 0 && onset < size)
+            vec[onset].w_float = f;
+    }
+
+    if (result < 0)
+        return 0;
+
+    garray_redraw((t_garray*)target);
+    return 1;
+}
+
+// Evaluates the text of a patch file, like binbuf_evalfile does after reading it
+static void libpd_eval_patch_text(char const* buf, size_t size)
+{
+    t_binbuf* b = binbuf_new();
+    char const* end = buf + size;
+    char const* pending = buf; // start of the messages that weren't evaluated yet
+    char const* msg = buf;
+
+    while (msg < end) {
+        char const* next;
+
+        while (msg < end && isspace((unsigned char)*msg))
+            msg++;
+
+        next = libpd_message_end(msg, end);
+
+        if (end - msg > 3 && msg[0] == '#' && msg[1] == 'A' && isspace((unsigned char)msg[2])) {
+            // The array it belongs to is created by the messages before it
+            if (msg > pending) {
+                binbuf_text(b, pending, (int)(msg - pending));
+                binbuf_eval(b, 0, 0, 0);
+            }
+
+            if (!libpd_set_array_contents(msg + 2, next)) {
+                binbuf_text(b, msg, (int)(next - msg));
+                binbuf_eval(b, 0, 0, 0);
+            }
+
+            pending = next;
+        }
+
+        msg = next;
+    }
+
+    if (end > pending) {
+        binbuf_text(b, pending, (int)(end - pending));
+        binbuf_eval(b, 0, 0, 0);
+    }
+
+    binbuf_free(b);
+}
+
+// Same as pd's glob_evalfile and binbuf_evalfile, without reading the file
+// Evaluates b when given, the text in buf otherwise
+static void* libpd_create_canvas_from(char const* name, char const* path, t_binbuf* b, char const* buf, size_t size)
+{
+    t_pd *x = 0, *boundx, *bounda, *boundn;
+    int dspstate;
+
+    sys_lock();
+
+    dspstate = canvas_suspend_dsp();
+    boundx = s__X.s_thing;
+    s__X.s_thing = 0;
+
+    // Set the filename so that new canvases can pick it up
+    glob_setfilename(0, gensym(name), gensym(path));
+
+    bounda = gensym("#A")->s_thing;
+    boundn = s__N.s_thing;
+    gensym("#A")->s_thing = 0;
+    s__N.s_thing = &pd_canvasmaker;
+
+    if (b)
+        binbuf_eval(b, 0, 0, 0);
+    else
+        libpd_eval_patch_text(buf, size);
+
+    gensym("#A")->s_thing = bounda;
+    s__N.s_thing = boundn;
+    glob_setfilename(0, &s_, &s_);
+
+    while ((x != s__X.s_thing) && s__X.s_thing) {
+        x = s__X.s_thing;
+        vmess(x, gensym("pop"), "i", 1);
+    }
+    pd_doloadbang();
+    canvas_resume_dsp(dspstate);
+    s__X.s_thing = boundx;
+
+    if (x) {
+        canvas_vis((t_canvas*)x, 1.f);
+        canvas_rename((t_canvas*)x, gensym(name), gensym(path));
+    }
+
+    sys_unlock();
+
+    return x;
+}
+
+void* libpd_create_canvas_from_memory(char const* name, char const* path, char const* buf, size_t size)
+{
+    return libpd_create_canvas_from(name, path, 0, buf, size);
+}
+
+void* libpd_create_canvas_from_binary(char const* name, char const* path, char const* buf, size_t size)
+{
+    t_binbuf* b = binbuf_new();
+    void* cnv = 0;
+
+    if (libpd_binbuf_setbinary(b, buf, size))
+        cnv = libpd_create_canvas_from(name, path, b, 0, 0);
+
+    binbuf_free(b);
+    return cnv;
+}
+
 char const* libpd_get_object_class_name(void* ptr)
 {
     return class_getname(pd_class((t_pd*)ptr));
@@ -229,9 +415,12 @@ int libpd_array_resize(void* garray, long size)
     return 0;
 }
 
+// unlocks before returning on a range error, pd would stay locked otherwise
 #define MEMCPY(_x, _y)                                              \
-    if (n < 0 || offset < 0 || offset + n > garray_npoints(garray)) \
+    if (n < 0 || offset < 0 || offset + n > garray_npoints(garray)) { \
+        sys_unlock();                                               \
         return -2;                                                  \
+    }                                                               \
     t_word* vec = ((t_word*)garray_vec(garray)) + offset;           \
     int i;                                                          \
     for (i = 0; i < n; i++)                                         \
@@ -253,20 +442,51 @@ int libpd_array_write(void* garray, int offset, float const* src, int n)
     return 0;
 }
 
+int libpd_array_read_changes(float* dest, void* garray, int n, int* start, int* end)
+{
+    t_word* vec;
+    int i, first = -1, last = -1;
+    *start = *end = 0;
+
+    sys_lock();
+    if (n != garray_npoints(garray)) {
+        sys_unlock();
+        return -2;
+    }
+
+    vec = (t_word*)garray_vec(garray);
+    for (i = 0; i < n; i++) {
+        if (dest[i] != vec[i].w_float) {
+            dest[i] = vec[i].w_float;
+            if (first < 0)
+                first = i;
+            last = i;
+        }
+    }
+    sys_unlock();
+
+    if (first >= 0) {
+        *start = first;
+        *end = last + 1;
+    }
+    return 0;
+}
+
 #define PROCESS_NODSP()                                      \
     size_t n_in = STUFF->st_inchannels * DEFDACBLKSIZE;      \
     size_t n_out = STUFF->st_outchannels * DEFDACBLKSIZE;    \
     t_sample* p;                                             \
     size_t i;                                                \
+    int nclocks;                                             \
     sys_lock();                                              \
     sys_pollgui();                                           \
     for (p = STUFF->st_soundin, i = 0; i < n_in; i++) {      \
         *p++ = 0.0;                                          \
     }                                                        \
     memset(STUFF->st_soundout, 0, n_out * sizeof(t_sample)); \
-    sched_tick_nodsp();                                      \
+    nclocks = sched_tick_nodsp();                            \
     sys_unlock();                                            \
-    return 0;
+    return nclocks;
 
 #define TIMEUNITPERMSEC (32. * 441.)
 #define TIMEUNITPERSECOND (TIMEUNITPERMSEC * 1000.)
@@ -281,25 +501,468 @@ struct _clock {
     t_float c_unit; // >0 if in TIMEUNITS; <0 if in samples
 };
 
-static void sched_tick_nodsp(void)
+static int sched_tick_nodsp(void)
 {
     double next_sys_time = pd_this->pd_systime + SYSTIMEPERTICK;
     int countdown = 5000;
+    int nclocks = 0;
     while (pd_this->pd_clock_setlist && pd_this->pd_clock_setlist->c_settime < next_sys_time) {
         t_clock* c = pd_this->pd_clock_setlist;
         pd_this->pd_systime = c->c_settime;
         clock_unset(pd_this->pd_clock_setlist);
         outlet_setstacklim();
         (*c->c_fn)(c->c_owner);
+        nclocks++;
         if (!countdown--) {
             countdown = 5000;
             (void)sys_pollgui();
         }
     }
     pd_this->pd_systime = next_sys_time;
+    return nclocks;
 }
 
 int libpd_process_nodsp(void)
 {
     PROCESS_NODSP()
 }
+
+int libpd_process_channels(float const** inputs, int nins, float** outputs, int nouts, int offset)
+{
+    int const n_in = nins < STUFF->st_inchannels ? nins : STUFF->st_inchannels;
+    int const n_out = nouts < STUFF->st_outchannels ? nouts : STUFF->st_outchannels;
+    int ch;
+
+    sys_lock();
+    sys_pollgui();
+
+    // Read all inputs before writing any output, so the channels may be processed in-place
+    for (ch = 0; ch < n_in; ch++) {
+        if (inputs[ch])
+            memcpy(STUFF->st_soundin + ch * DEFDACBLKSIZE, inputs[ch] + offset, DEFDACBLKSIZE * sizeof(t_sample));
+        else
+            memset(STUFF->st_soundin + ch * DEFDACBLKSIZE, 0, DEFDACBLKSIZE * sizeof(t_sample));
+    }
+    for (; ch < STUFF->st_inchannels; ch++) {
+        memset(STUFF->st_soundin + ch * DEFDACBLKSIZE, 0, DEFDACBLKSIZE * sizeof(t_sample));
+    }
+
+    // Output the previous tick, which is still in pd's output buffer
+    for (ch = 0; ch < n_out; ch++) {
+        if (outputs[ch])
+            memcpy(outputs[ch] + offset, STUFF->st_soundout + ch * DEFDACBLKSIZE, DEFDACBLKSIZE * sizeof(t_sample));
+    }
+
+    memset(STUFF->st_soundout, 0, STUFF->st_outchannels * DEFDACBLKSIZE * sizeof(t_sample));
+    sched_tick();
+    sys_unlock();
+    return 0;
+}
+
+int libpd_process_channels_direct(float const** inputs, int nins, float** outputs, int nouts, int offset)
+{
+    int const n_in = nins < STUFF->st_inchannels ? nins : STUFF->st_inchannels;
+    int const n_out = nouts < STUFF->st_outchannels ? nouts : STUFF->st_outchannels;
+    int ch;
+
+    sys_lock();
+    sys_pollgui();
+
+    for (ch = 0; ch < n_in; ch++) {
+        if (inputs[ch])
+            memcpy(STUFF->st_soundin + ch * DEFDACBLKSIZE, inputs[ch] + offset, DEFDACBLKSIZE * sizeof(t_sample));
+        else
+            memset(STUFF->st_soundin + ch * DEFDACBLKSIZE, 0, DEFDACBLKSIZE * sizeof(t_sample));
+    }
+    for (; ch < STUFF->st_inchannels; ch++) {
+        memset(STUFF->st_soundin + ch * DEFDACBLKSIZE, 0, DEFDACBLKSIZE * sizeof(t_sample));
+    }
+
+    memset(STUFF->st_soundout, 0, STUFF->st_outchannels * DEFDACBLKSIZE * sizeof(t_sample));
+    sched_tick();
+
+    for (ch = 0; ch < n_out; ch++) {
+        if (outputs[ch])
+            memcpy(outputs[ch] + offset, STUFF->st_soundout + ch * DEFDACBLKSIZE, DEFDACBLKSIZE * sizeof(t_sample));
+    }
+    sys_unlock();
+    return 0;
+}
+
+int libpd_process_raw_ticks(float const* inputs, float* outputs, int ticks)
+{
+    int const stride = ticks * DEFDACBLKSIZE;
+    int tick, ch;
+
+    sys_lock();
+    sys_pollgui();
+
+    for (tick = 0; tick < ticks; tick++) {
+        int const offset = tick * DEFDACBLKSIZE;
+
+        for (ch = 0; ch < STUFF->st_inchannels; ch++) {
+            memcpy(STUFF->st_soundin + ch * DEFDACBLKSIZE, inputs + ch * stride + offset, DEFDACBLKSIZE * sizeof(t_sample));
+        }
+
+        memset(STUFF->st_soundout, 0, STUFF->st_outchannels * DEFDACBLKSIZE * sizeof(t_sample));
+        sched_tick();
+
+        for (ch = 0; ch < STUFF->st_outchannels; ch++) {
+            memcpy(outputs + ch * stride + offset, STUFF->st_soundout + ch * DEFDACBLKSIZE, DEFDACBLKSIZE * sizeof(t_sample));
+        }
+    }
+
+    sys_unlock();
+    return 0;
+}
+
+void libpd_set_pending_output(float const* buffer)
+{
+    memcpy(STUFF->st_soundout, buffer, STUFF->st_outchannels * DEFDACBLKSIZE * sizeof(t_sample));
+}
+
+void libpd_get_pending_output(float* buffer)
+{
+    memcpy(buffer, STUFF->st_soundout, STUFF->st_outchannels * DEFDACBLKSIZE * sizeof(t_sample));
+    memset(STUFF->st_soundout, 0, STUFF->st_outchannels * DEFDACBLKSIZE * sizeof(t_sample));
+}
+
+void libpd_dispatch_midi(int port, unsigned char const* data, int size)
+{
+    int i, status, channel;
+
+    if (size <= 0)
+        return;
+
+    status = data[0] & 0xf0;
+    channel = data[0] & 0x0f;
+
+    if (data[0] == 0xf0) {
+        // [sysexin] gets the data between the start and end bytes
+        int end = data[size - 1] == 0xf7 ? size - 1 : size;
+        for (i = 1; i < end; i++)
+            inmidi_sysex(port, data[i]);
+    } else if (data[0] == 0xf8 || data[0] == 0xfa || data[0] == 0xfb || data[0] == 0xfc || data[0] == 0xfe || data[0] == 0xff) {
+        inmidi_realtimein(port, data[0]);
+    } else if (size >= 3 && status == 0x90) {
+        inmidi_noteon(port, channel, data[1], data[2]);
+    } else if (size >= 3 && status == 0x80) {
+        inmidi_noteon(port, channel, data[1], 0);
+    } else if (size >= 3 && status == 0xb0) {
+        inmidi_controlchange(port, channel, data[1], data[2]);
+    } else if (size >= 3 && status == 0xe0) {
+        inmidi_pitchbend(port, channel, data[1] | (data[2] << 7));
+    } else if (size >= 2 && status == 0xd0) {
+        inmidi_aftertouch(port, channel, data[1]);
+    } else if (size >= 3 && status == 0xa0) {
+        inmidi_polyaftertouch(port, channel, data[1], data[2]);
+    } else if (size >= 2 && status == 0xc0) {
+        inmidi_programchange(port, channel, data[1]);
+    }
+
+    for (i = 0; i < size; i++)
+        inmidi_byte(port, data[i]);
+}
+
+static int midi_message_size(unsigned char const* data, int size)
+{
+    int i;
+
+    if (data[0] == 0xf0) {
+        for (i = 1; i < size; i++) {
+            if (data[i] == 0xf7)
+                return i + 1;
+        }
+        return size;
+    }
+
+    switch (data[0] & 0xf0) {
+    case 0xc0:
+    case 0xd0:
+        return 2;
+    case 0xf0:
+        return (data[0] == 0xf1 || data[0] == 0xf3) ? 2 : (data[0] == 0xf2 ? 3 : 1);
+    default:
+        return 3;
+    }
+}
+
+void libpd_dispatch_midi_stream(int port, unsigned char const* data, int size)
+{
+    unsigned char message[3];
+    unsigned char status = 0;
+    int pos = 0;
+
+    while (pos < size) {
+        int length;
+
+        if (data[pos] & 0x80) {
+            length = midi_message_size(data + pos, size - pos);
+            if (length > size - pos)
+                break;
+
+            // realtime and system messages don't change the running status
+            if (data[pos] < 0xf0)
+                status = data[pos];
+
+            libpd_dispatch_midi(port, data + pos, length);
+            pos += length;
+        } else if (status) {
+            // running status: the data bytes reuse the last channel status
+            message[0] = status;
+            length = midi_message_size(message, 1) - 1;
+            if (length > size - pos)
+                break;
+
+            memcpy(message + 1, data + pos, length);
+            libpd_dispatch_midi(port, message, length + 1);
+            pos += length;
+        } else {
+            pos++;
+        }
+    }
+}
+
+// False INSTANCEUGEN, only the start of struct _instanceugen in d_ugen.c
+typedef struct _fake_ugenchain {
+    t_int* u_dspchain;
+    int u_dspchainsize;
+} t_fake_ugenchain;
+
+// Per instance profiler state, bound to a symbol like the parallel clone context
+typedef struct _profiler {
+    t_pd x_pd;
+    int x_enabled;
+    t_int* x_chain;     // copy of pd's DSP chain, this is what runs while profiling
+    int x_chainsize;
+    t_int* x_installed; // pd's chain that starts with profiler_perform
+    double* x_time;     // seconds spent in the perform routine that starts at each offset of x_chain
+    int* x_calls;
+    int x_ticks;
+} t_profiler;
+
+static t_class* profiler_class;
+
+static t_symbol* profiler_symbol(void)
+{
+    return gensym("#plugdata_profiler");
+}
+
+static t_profiler* profiler_get(int create)
+{
+    t_profiler* x;
+    if (!profiler_class) {
+        if (!create)
+            return 0;
+        profiler_class = class_new(gensym("plugdata_profiler"), 0, 0, sizeof(t_profiler), CLASS_PD, 0);
+    }
+    x = (t_profiler*)pd_findbyclass(profiler_symbol(), profiler_class);
+    if (!x && create) {
+        x = (t_profiler*)pd_new(profiler_class);
+        x->x_enabled = 0;
+        x->x_chain = 0;
+        x->x_chainsize = 0;
+        x->x_installed = 0;
+        x->x_time = 0;
+        x->x_calls = 0;
+        x->x_ticks = 0;
+        pd_bind(&x->x_pd, profiler_symbol());
+    }
+    return x;
+}
+
+static double profiler_now(void)
+{
+#ifdef _WIN32
+    static double period = 0;
+    LARGE_INTEGER count;
+    if (period == 0) {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        period = 1. / (double)frequency.QuadPart;
+    }
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart * period;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+// Replaces the first perform routine of pd's chain, runs the copy of the chain and times every routine in it
+// Routines return the start of the next one, so the routines are found while running, just like dsp_tick does
+static t_int* profiler_perform(t_int* w)
+{
+    t_profiler* x = profiler_get(0);
+    t_int* ip = x->x_chain;
+    double last = profiler_now();
+    while (ip) {
+        int offset = (int)(ip - x->x_chain);
+        double now;
+        ip = (*(t_perfroutine)(*ip))(ip);
+        now = profiler_now();
+        x->x_time[offset] += now - last;
+        x->x_calls[offset]++;
+        last = now;
+    }
+    x->x_ticks++;
+
+    // the copy ends with pd's dsp_done, which returns 0 as well
+    return 0;
+}
+
+static void profiler_uninstall(t_profiler* x)
+{
+    t_fake_ugenchain* ugen = (t_fake_ugenchain*)pd_this->pd_ugen;
+    if (x->x_installed && x->x_installed == ugen->u_dspchain && x->x_installed[0] == (t_int)profiler_perform)
+        x->x_installed[0] = x->x_chain[0];
+
+    if (x->x_chain) {
+        freebytes(x->x_chain, x->x_chainsize * sizeof(*x->x_chain));
+        freebytes(x->x_time, x->x_chainsize * sizeof(*x->x_time));
+        freebytes(x->x_calls, x->x_chainsize * sizeof(*x->x_calls));
+    }
+    x->x_chain = 0;
+    x->x_chainsize = 0;
+    x->x_installed = 0;
+    x->x_ticks = 0;
+}
+
+void libpd_profiler_enable(int enable)
+{
+    t_profiler* x;
+
+    sys_lock();
+    x = profiler_get(enable);
+    if (x) {
+        x->x_enabled = enable;
+        if (!enable)
+            profiler_uninstall(x);
+    }
+    sys_unlock();
+}
+
+void libpd_profiler_update(void)
+{
+    t_fake_ugenchain* ugen;
+    t_profiler* x;
+    t_int* chain;
+
+    sys_lock();
+    ugen = (t_fake_ugenchain*)pd_this->pd_ugen;
+    x = profiler_get(0);
+    chain = ugen->u_dspchain;
+    if (!x || !x->x_enabled || !chain || (chain == x->x_installed && chain[0] == (t_int)profiler_perform)) {
+        sys_unlock();
+        return;
+    }
+
+    // pd rebuilt its chain, the old copy belongs to the chain that was freed
+    profiler_uninstall(x);
+
+    x->x_chainsize = ugen->u_dspchainsize;
+    x->x_chain = (t_int*)getbytes(x->x_chainsize * sizeof(*x->x_chain));
+    x->x_time = (double*)getbytes(x->x_chainsize * sizeof(*x->x_time));
+    x->x_calls = (int*)getbytes(x->x_chainsize * sizeof(*x->x_calls));
+    memcpy(x->x_chain, chain, x->x_chainsize * sizeof(*x->x_chain));
+
+    chain[0] = (t_int)profiler_perform;
+    x->x_installed = chain;
+    sys_unlock();
+}
+
+int libpd_profiler_collect(t_libpd_profiler_callback fn, void* data)
+{
+    t_profiler* x;
+    double budget;
+    int i, ticks = 0;
+
+    sys_lock();
+    x = profiler_get(0);
+    if (x && x->x_chain && x->x_ticks) {
+        ticks = x->x_ticks;
+        budget = ticks * (double)DEFDACBLKSIZE / sys_getsr();
+        for (i = 0; i < x->x_chainsize; i++) {
+            if (!x->x_calls[i])
+                continue;
+
+            // the first argument, or the next routine if this one has none, dsp_done at the end has neither
+            if (i + 1 < x->x_chainsize)
+                fn(data, (void*)x->x_chain[i + 1], (float)(x->x_time[i] / budget));
+
+            x->x_time[i] = 0;
+            x->x_calls[i] = 0;
+        }
+        x->x_ticks = 0;
+    }
+    sys_unlock();
+    return ticks;
+}
+
+// False TEXTBUF, the start of [text define], [qlist] and [textfile], mirrors struct _textbuf in x_text.c
+typedef struct _fake_textbuf {
+    t_object b_ob;
+    t_binbuf* b_binbuf;
+} t_fake_textbuf;
+
+t_glist* clone_get_instance(t_gobj*, int);
+int clone_get_n(t_gobj*);
+
+static size_t memory_binbuf_size(t_binbuf* b)
+{
+    return b ? sizeof(t_atom) * (size_t)binbuf_getnatom(b) : 0;
+}
+
+static void memory_add_canvas(t_canvas* cnv, t_libpd_memory_report* report)
+{
+    t_symbol* text_define = gensym("text define");
+    t_symbol* qlist = gensym("qlist");
+    t_symbol* textfile = gensym("textfile");
+    t_symbol* clone = gensym("clone");
+    t_gobj* y;
+
+    for (y = cnv->gl_list; y; y = y->g_next) {
+        t_class* c = pd_class(&y->g_pd);
+        t_symbol* name = c->c_name;
+        t_object* ob = pd_checkobject(&y->g_pd);
+
+        report->r_objects += c->c_size;
+        report->r_numobjects++;
+
+        if (ob)
+            report->r_text += memory_binbuf_size(ob->te_binbuf);
+
+        if (c == canvas_class) {
+            memory_add_canvas((t_canvas*)y, report);
+        } else if (c == garray_class) {
+            t_array* a = garray_getarray((t_garray*)y);
+            report->r_arrays += (size_t)a->a_n * (size_t)a->a_elemsize;
+            report->r_numarrays++;
+        } else if (c == scalar_class) {
+            t_template* tmpl = template_findbyname(((t_scalar*)y)->sc_template);
+            if (tmpl)
+                report->r_objects += sizeof(t_word) * (size_t)tmpl->t_n;
+        } else if (name == text_define || name == qlist || name == textfile) {
+            report->r_text += memory_binbuf_size(((t_fake_textbuf*)y)->b_binbuf);
+        } else if (name == clone) {
+            int i, n = clone_get_n(y);
+            for (i = 0; i < n; i++) {
+                t_libpd_memory_report copy;
+                memset(&copy, 0, sizeof(copy));
+                memory_add_canvas(clone_get_instance(y, i), &copy);
+
+                report->r_clones += sizeof(t_canvas) + copy.r_objects + copy.r_text + copy.r_arrays + copy.r_clones;
+                report->r_numclones += 1 + copy.r_numclones;
+                report->r_numarrays += copy.r_numarrays;
+            }
+        }
+    }
+}
+
+void libpd_canvas_get_memory(t_canvas* cnv, t_libpd_memory_report* report)
+{
+    memset(report, 0, sizeof(*report));
+    report->r_objects = sizeof(t_canvas);
+    memory_add_canvas(cnv, report);
+}
@@ -15,6 +15,13 @@ extern "C" {
 
 void* libpd_create_canvas(char const* name, char const* path);
 
+// Same as libpd_create_canvas, but the file is already in memory, for example mapped by the caller
+// The contents of saved arrays are parsed straight into the arrays, without making atoms of them first
+void* libpd_create_canvas_from_memory(char const* name, char const* path, char const* buf, size_t size);
+
+// Same as libpd_create_canvas, from the binary form made by libpd_getcontent_binary
+void* libpd_create_canvas_from_binary(char const* name, char const* path, char const* buf, size_t size);
+
 char const* libpd_get_object_class_name(void* ptr);
 void libpd_get_object_text(void* ptr, char** text, int* size);
 void libpd_get_object_bounds(void* patch, void* ptr, int* x, int* y, int* w, int* h);
@@ -47,6 +54,12 @@ EXTERN int libpd_array_read(float* dest, void* garray, int offset, int n);
 EXTERN int libpd_array_write(void* garray, int offset,
     float const* src, int n);
 
+// bring dest, a copy of all n values of the array, up to date with the array
+// only the values that differ are written, and the changed range is stored in [start, end)
+// start and end are equal when nothing changed
+// returns 0 on success or a negative error code if n isn't the size of the array
+EXTERN int libpd_array_read_changes(float* dest, void* garray, int n, int* start, int* end);
+
 unsigned int libpd_iemgui_get_background_color(void* ptr);
 unsigned int libpd_iemgui_get_foreground_color(void* ptr);
 unsigned int libpd_iemgui_get_label_color(void* ptr);
@@ -57,8 +70,60 @@ void libpd_iemgui_set_label_color(void* ptr, char const* hex);
 
 float libpd_get_canvas_font_height(t_canvas* cnv);
 
+// runs one tick of pd's scheduler without DSP, returns the number of clocks that went off
 int libpd_process_nodsp(void);
 
+// like libpd_process_raw, but processes one tick straight from and to separate channel buffers, starting at offset
+// the output lags one tick behind: the result of the previous tick gets written, the new result stays in pd's output buffer
+// inputs and outputs may point to the same channels, a NULL input is silent and a NULL output isn't written
+int libpd_process_channels(float const** inputs, int nins, float** outputs, int nouts, int offset);
+
+// like libpd_process_channels, but the output of the tick is written straight away, without the tick of delay
+// the output of a previous libpd_process_channels call that's still in pd's output buffer is dropped
+int libpd_process_channels_direct(float const** inputs, int nins, float** outputs, int nouts, int offset);
+
+// like libpd_process_raw, but runs several ticks in a row, with ticks * blocksize samples per channel
+// pd is locked and the gui is polled once for all of them
+int libpd_process_raw_ticks(float const* inputs, float* outputs, int ticks);
+
+// move the output that libpd_process_channels keeps in pd's output buffer from and to a non-interleaved buffer
+// this allows switching between libpd_process_raw and libpd_process_channels without a gap
+void libpd_set_pending_output(float const* buffer);
+void libpd_get_pending_output(float* buffer);
+
+// parse a raw midi message and pass it to pd's midi objects, for callers that already hold pd's lock
+// like clock callbacks during a tick
+void libpd_dispatch_midi(int port, unsigned char const* data, int size);
+
+// same for a contiguous stream of midi messages, with support for running status
+void libpd_dispatch_midi_stream(int port, unsigned char const* data, int size);
+
+// Opt-in profiler for the DSP chain of the current instance, which times every perform routine separately
+// While it's enabled, libpd_profiler_update has to be called before each block is processed, so it can install
+// itself again when pd rebuilds its DSP chain. These take pd's lock themselves
+void libpd_profiler_enable(int enable);
+void libpd_profiler_update(void);
+
+// Reports the time spent in each perform routine since the last call, as a share of the time available for the
+// ticks that ran. The owner is the first argument of the routine, which is the object for nearly all of them,
+// routines with more than one entry per object are reported separately. Returns the number of ticks measured
+typedef void (*t_libpd_profiler_callback)(void* data, void* owner, float load);
+int libpd_profiler_collect(t_libpd_profiler_callback fn, void* data);
+
+// Memory used by a canvas and everything in it, as far as pd knows the size of it: anything objects
+// allocate for themselves, like delay lines and tables of externals, isn't included. Call while holding pd's lock
+typedef struct _libpd_memory_report {
+    size_t r_objects; // object structures and the data of scalars
+    size_t r_text;    // contents of the object boxes, [text define], [qlist] and [textfile]
+    size_t r_arrays;  // array data
+    size_t r_clones;  // everything inside the copies of [clone]
+    int r_numobjects;
+    int r_numarrays;
+    int r_numclones;  // copies, including those of nested clones
+} t_libpd_memory_report;
+
+void libpd_canvas_get_memory(t_canvas* cnv, t_libpd_memory_report* report);
+
 unsigned int convert_from_iem_color(int const color);
 unsigned int convert_to_iem_color(char const* hex);
 
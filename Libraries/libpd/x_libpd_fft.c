@@ -0,0 +1,479 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <m_pd.h>
+
+#include "x_libpd_fft.h"
+
+#define FFT_MINLOG 2
+#define FFT_MAXLOG 24
+
+#ifdef _MSC_VER
+#    define FFT_INLINE static __forceinline
+#    define FFT_RESTRICT __restrict
+#    define FFT_THREADLOCAL __declspec(thread)
+#else
+#    define FFT_INLINE static inline __attribute__((always_inline))
+#    define FFT_RESTRICT __restrict__
+#    define FFT_THREADLOCAL __thread
+#endif
+
+#ifndef M_PI
+#    define M_PI 3.14159265358979323846
+#endif
+
+// A complex transform of p_n points, which is also the half of a real transform of 2 * p_n points
+typedef struct _fft_plan {
+    int p_n;
+    int p_npasses;
+    t_sample* p_twiddles[FFT_MAXLOG]; // of each radix 4 pass, w^p, w^2p and w^3p, each split into real and imaginary parts
+    t_sample* p_realre;               // e^(-2 pi i k / 2n) for k up to n / 2, which splits the real transform
+    t_sample* p_realim;
+} t_fft_plan;
+
+// Values that are b_step apart, 2 for the real and imaginary parts of pd's buffers that follow each other
+typedef struct _fft_buf {
+    t_sample* b_re;
+    t_sample* b_im;
+    int b_step;
+} t_fft_buf;
+
+static t_fft_plan* fft_plans[FFT_MAXLOG + 1];
+static pthread_mutex_t fft_planlock = PTHREAD_MUTEX_INITIALIZER;
+
+// The passes go back and forth between the caller's buffer and this one
+static FFT_THREADLOCAL t_sample* fft_scratch;
+static FFT_THREADLOCAL int fft_scratchsize;
+
+// Sizes this thread prepared already, so pd's glue below only takes the lock the first time
+static FFT_THREADLOCAL char fft_ready[FFT_MAXLOG + 1];
+
+static int fft_log2(int n)
+{
+    int log = 0;
+    if (n < 1 || (n & (n - 1)))
+        return -1;
+    while ((1 << log) < n)
+        log++;
+    return log;
+}
+
+static t_fft_plan* fft_plan_new(int log)
+{
+    t_fft_plan* plan = (t_fft_plan*)getbytes(sizeof(*plan));
+    int n = 1 << log, len, pass, p, k;
+    size_t size = 0;
+    t_sample* mem;
+
+    // a radix 4 pass for every two bits, and a radix 2 pass for the last one when there's a bit left
+    plan->p_n = n;
+    plan->p_npasses = log / 2 + (log & 1);
+    for (len = n; len >= 4; len /= 4)
+        size += 6 * (len / 4);
+    size += 2 * (n / 2 + 1);
+
+    // plans stay until the process ends, like pd's own tables
+    mem = (t_sample*)getbytes(size * sizeof(*mem));
+
+    for (len = n, pass = 0; len >= 4; len /= 4, pass++) {
+        int m = len / 4;
+        plan->p_twiddles[pass] = mem;
+        for (p = 0; p < m; p++) {
+            double a = -2 * M_PI * p / len;
+            mem[p] = (t_sample)cos(a);
+            mem[m + p] = (t_sample)sin(a);
+            mem[2 * m + p] = (t_sample)cos(2 * a);
+            mem[3 * m + p] = (t_sample)sin(2 * a);
+            mem[4 * m + p] = (t_sample)cos(3 * a);
+            mem[5 * m + p] = (t_sample)sin(3 * a);
+        }
+        mem += 6 * m;
+    }
+
+    plan->p_realre = mem;
+    plan->p_realim = mem + n / 2 + 1;
+    for (k = 0; k <= n / 2; k++) {
+        double a = -M_PI * k / n;
+        plan->p_realre[k] = (t_sample)cos(a);
+        plan->p_realim[k] = (t_sample)sin(a);
+    }
+
+    return plan;
+}
+
+static t_sample* fft_getscratch(int size)
+{
+    // only grows the first time a thread runs a larger transform, libpd_fft_prepare already did it for its own thread
+    if (size > fft_scratchsize) {
+        fft_scratch = (t_sample*)resizebytes(fft_scratch, fft_scratchsize * sizeof(*fft_scratch), size * sizeof(*fft_scratch));
+        fft_scratchsize = size;
+    }
+    return fft_scratch;
+}
+
+// The butterflies of a radix 4 pass that share their twiddles, x0 to x3 are the four quarters of the input and
+// y0 to y3 the four outputs of each butterfly, n of them with the values xstep and ystep apart
+FFT_INLINE void fft_butterflies(int n, t_sample const* FFT_RESTRICT x0r, t_sample const* FFT_RESTRICT x0i,
+    t_sample const* FFT_RESTRICT x1r, t_sample const* FFT_RESTRICT x1i, t_sample const* FFT_RESTRICT x2r,
+    t_sample const* FFT_RESTRICT x2i, t_sample const* FFT_RESTRICT x3r, t_sample const* FFT_RESTRICT x3i, int const xstep,
+    t_sample* FFT_RESTRICT y0r, t_sample* FFT_RESTRICT y0i, t_sample* FFT_RESTRICT y1r, t_sample* FFT_RESTRICT y1i,
+    t_sample* FFT_RESTRICT y2r, t_sample* FFT_RESTRICT y2i, t_sample* FFT_RESTRICT y3r, t_sample* FFT_RESTRICT y3i,
+    int const ystep, t_sample const* w1r, t_sample const* w1i, t_sample const* w2r, t_sample const* w2i,
+    t_sample const* w3r, t_sample const* w3i, int const wstep)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        t_sample ar = x0r[i * xstep], ai = x0i[i * xstep];
+        t_sample br = x1r[i * xstep], bi = x1i[i * xstep];
+        t_sample cr = x2r[i * xstep], ci = x2i[i * xstep];
+        t_sample dr = x3r[i * xstep], di = x3i[i * xstep];
+        t_sample t1r = w1r[i * wstep], t1i = w1i[i * wstep];
+        t_sample t2r = w2r[i * wstep], t2i = w2i[i * wstep];
+        t_sample t3r = w3r[i * wstep], t3i = w3i[i * wstep];
+        t_sample apcr = ar + cr, apci = ai + ci, amcr = ar - cr, amci = ai - ci;
+        t_sample bpdr = br + dr, bpdi = bi + di, bmdr = br - dr, bmdi = bi - di;
+        t_sample r1 = amcr + bmdi, i1 = amci - bmdr;
+        t_sample r2 = apcr - bpdr, i2 = apci - bpdi;
+        t_sample r3 = amcr - bmdi, i3 = amci + bmdr;
+        y0r[i * ystep] = apcr + bpdr;
+        y0i[i * ystep] = apci + bpdi;
+        y1r[i * ystep] = r1 * t1r - i1 * t1i;
+        y1i[i * ystep] = r1 * t1i + i1 * t1r;
+        y2r[i * ystep] = r2 * t2r - i2 * t2i;
+        y2i[i * ystep] = r2 * t2i + i2 * t2r;
+        y3r[i * ystep] = r3 * t3r - i3 * t3i;
+        y3i[i * ystep] = r3 * t3i + i3 * t3r;
+    }
+}
+
+// One radix 4 pass of a Stockham transform, for len points that are s apart, from x to y
+// The loops can be vectorised by the compiler, along the points when s is 1, and along s otherwise
+FFT_INLINE void fft_radix4(int len, int s, t_sample const* w, t_sample const* xr, t_sample const* xi, int const xstep,
+    t_sample* yr, t_sample* yi, int const ystep)
+{
+    int m = len / 4, sm = s * m, p;
+    t_sample const* w1r = w;
+    t_sample const* w1i = w + m;
+    t_sample const* w2r = w + 2 * m;
+    t_sample const* w2i = w + 3 * m;
+    t_sample const* w3r = w + 4 * m;
+    t_sample const* w3i = w + 5 * m;
+
+    // the outputs of each butterfly are s apart, and the next butterfly's are 4 * s further
+    if (s == 1) {
+        fft_butterflies(m, xr, xi, xr + m * xstep, xi + m * xstep, xr + 2 * m * xstep, xi + 2 * m * xstep, xr + 3 * m * xstep,
+            xi + 3 * m * xstep, xstep, yr, yi, yr + ystep, yi + ystep, yr + 2 * ystep, yi + 2 * ystep, yr + 3 * ystep,
+            yi + 3 * ystep, 4 * ystep, w1r, w1i, w2r, w2i, w3r, w3i, 1);
+        return;
+    }
+
+    for (p = 0; p < m; p++) {
+        t_sample const* x = xr + s * p * xstep;
+        t_sample const* xx = xi + s * p * xstep;
+        t_sample* y = yr + 4 * s * p * ystep;
+        t_sample* yy = yi + 4 * s * p * ystep;
+        fft_butterflies(s, x, xx, x + sm * xstep, xx + sm * xstep, x + 2 * sm * xstep, xx + 2 * sm * xstep, x + 3 * sm * xstep,
+            xx + 3 * sm * xstep, xstep, y, yy, y + s * ystep, yy + s * ystep, y + 2 * s * ystep, yy + 2 * s * ystep,
+            y + 3 * s * ystep, yy + 3 * s * ystep, ystep, w1r + p, w1i + p, w2r + p, w2i + p, w3r + p, w3i + p, 0);
+    }
+}
+
+// The last pass when there's a bit left, two points s apart
+FFT_INLINE void fft_radix2(int s, t_sample const* xr, t_sample const* xi, int const xstep, t_sample* yr, t_sample* yi, int const ystep)
+{
+    int q;
+    for (q = 0; q < s; q++) {
+        t_sample ar = xr[q * xstep], ai = xi[q * xstep];
+        t_sample br = xr[(q + s) * xstep], bi = xi[(q + s) * xstep];
+        yr[q * ystep] = ar + br;
+        yi[q * ystep] = ai + bi;
+        yr[(q + s) * ystep] = ar - br;
+        yi[(q + s) * ystep] = ai - bi;
+    }
+}
+
+static void fft_pass(int len, int s, t_sample const* w, t_fft_buf src, t_fft_buf dst)
+{
+    // a copy of the pass for each layout, so the steps are constants in its loops
+    if (len >= 4) {
+        if (src.b_step == 2)
+            fft_radix4(len, s, w, src.b_re, src.b_im, 2, dst.b_re, dst.b_im, 1);
+        else if (dst.b_step == 2)
+            fft_radix4(len, s, w, src.b_re, src.b_im, 1, dst.b_re, dst.b_im, 2);
+        else
+            fft_radix4(len, s, w, src.b_re, src.b_im, 1, dst.b_re, dst.b_im, 1);
+    } else {
+        if (src.b_step == 2)
+            fft_radix2(s, src.b_re, src.b_im, 2, dst.b_re, dst.b_im, 1);
+        else if (dst.b_step == 2)
+            fft_radix2(s, src.b_re, src.b_im, 1, dst.b_re, dst.b_im, 2);
+        else
+            fft_radix2(s, src.b_re, src.b_im, 1, dst.b_re, dst.b_im, 1);
+    }
+}
+
+// Runs every pass of a forward transform from in, the last one writes last, the ones before it go back and forth
+// between out and tmp, so the one before the last writes tmp. A pass can't write the buffer it reads
+static void fft_passes(t_fft_plan const* plan, t_fft_buf in, t_fft_buf out, t_fft_buf last, t_fft_buf tmp)
+{
+    t_fft_buf src = in;
+    int pass, len = plan->p_n, s = 1;
+
+    for (pass = 0; pass < plan->p_npasses; pass++) {
+        t_fft_buf dst = pass == plan->p_npasses - 1 ? last : ((plan->p_npasses - 1 - pass) & 1) ? tmp : out;
+        fft_pass(len, s, plan->p_twiddles[pass], src, dst);
+        if (len >= 4) {
+            len /= 4;
+            s *= 4;
+        } else {
+            len /= 2;
+            s *= 2;
+        }
+        src = dst;
+    }
+}
+
+static t_fft_buf fft_buf(t_sample* re, t_sample* im, int step)
+{
+    t_fft_buf buf;
+    buf.b_re = re;
+    buf.b_im = im;
+    buf.b_step = step;
+    return buf;
+}
+
+static void fft_complex(t_fft_plan const* plan, t_sample* re, t_sample* im, int inverse)
+{
+    int n = plan->p_n;
+    t_sample* tmp;
+    t_fft_buf buf, scratch;
+
+    // the inverse is the forward transform with the real and imaginary parts swapped, on the way in and out
+    if (inverse) {
+        t_sample* swap = re;
+        re = im;
+        im = swap;
+    }
+
+    buf = fft_buf(re, im, 1);
+    tmp = fft_getscratch(2 * n);
+    scratch = fft_buf(tmp, tmp + n, 1);
+    // with an odd number of passes, the last one writes the scratch buffer, since the first one can't write buf
+    if (plan->p_npasses & 1) {
+        fft_passes(plan, buf, scratch, scratch, buf);
+        memcpy(re, tmp, n * sizeof(*re));
+        memcpy(im, tmp + n, n * sizeof(*im));
+    } else
+        fft_passes(plan, buf, buf, buf, scratch);
+}
+
+// The real transform is a complex transform of half the size, of the even samples as the real parts and the odd
+// ones as the imaginary parts. The halves of that are split into the real transform here.
+// Each pair of bins is read from and written to the same four places of buf, so z can be buf's halves
+static void fft_realsplit(t_fft_plan const* plan, t_sample const* zr, t_sample const* zi, t_sample* buf, t_sample sign)
+{
+    int n = plan->p_n, k;
+    t_sample const* wr = plan->p_realre;
+    t_sample const* wi = plan->p_realim;
+    t_sample z0r = zr[0], z0i = zi[0];
+
+    for (k = 1; k <= n / 2; k++) {
+        t_sample ar = zr[k], ai = zi[k], br = zr[n - k], bi = -zi[n - k];
+        // the transforms of the even and odd samples, and the odd one turned by w^k
+        t_sample er = (t_sample)0.5 * (ar + br), ei = (t_sample)0.5 * (ai + bi);
+        t_sample or = (t_sample)0.5 * (ai - bi), oi = (t_sample)-0.5 * (ar - br);
+        t_sample tr = or * wr[k] - oi * wi[k], ti = or * wi[k] + oi * wr[k];
+        buf[k] = er + tr;
+        buf[2 * n - k] = sign * (ei + ti);
+        buf[n - k] = er - tr;
+        buf[n + k] = sign * (ti - ei);
+    }
+
+    buf[0] = z0r + z0i;
+    buf[n] = z0r - z0i;
+}
+
+// Undoes fft_realsplit, twice as large, so the inverse of the half sized transform gives n times the signal
+static void fft_realmerge(t_fft_plan const* plan, t_sample const* buf, t_sample* zr, t_sample* zi, t_sample sign)
+{
+    int n = plan->p_n, k;
+    t_sample const* wr = plan->p_realre;
+    t_sample const* wi = plan->p_realim;
+    t_sample x0 = buf[0], xn = buf[n];
+
+    for (k = 1; k <= n / 2; k++) {
+        t_sample ar = buf[k], ai = sign * buf[2 * n - k], br = buf[n - k], bi = -sign * buf[n + k];
+        t_sample er = ar + br, ei = ai + bi;
+        // the odd half is turned back by the conjugate of w^k
+        t_sample dr = ar - br, di = ai - bi;
+        t_sample or = dr * wr[k] + di * wi[k], oi = di * wr[k] - dr * wi[k];
+        zr[k] = er - oi;
+        zi[k] = ei + or;
+        zr[n - k] = er + oi;
+        zi[n - k] = or - ei;
+    }
+
+    zr[0] = x0 + xn;
+    zi[0] = x0 - xn;
+}
+
+static void fft_real(t_fft_plan const* plan, t_sample* buf, t_sample sign)
+{
+    int n = plan->p_n;
+    t_sample* tmp = fft_getscratch(2 * n);
+    t_fft_buf samples = fft_buf(buf, buf + 1, 2), halves = fft_buf(buf, buf + n, 1), scratch = fft_buf(tmp, tmp + n, 1);
+
+    // the first pass reads the samples as pairs, the transform ends up in the scratch buffer or in buf's halves
+    if (plan->p_npasses & 1) {
+        fft_passes(plan, samples, scratch, scratch, halves);
+        fft_realsplit(plan, tmp, tmp + n, buf, sign);
+    } else {
+        fft_passes(plan, samples, halves, halves, scratch);
+        fft_realsplit(plan, buf, buf + n, buf, sign);
+    }
+}
+
+static void fft_realinverse(t_fft_plan const* plan, t_sample* buf, t_sample sign)
+{
+    int n = plan->p_n;
+    t_sample* tmp = fft_getscratch(2 * n);
+    t_fft_buf samples = fft_buf(buf + 1, buf, 2), halves = fft_buf(buf + n, buf, 1), scratch = fft_buf(tmp + n, tmp, 1);
+
+    // the inverse is the forward transform with the real and imaginary parts swapped, and the last pass
+    // writes the samples as pairs, so the one before it has to write the scratch buffer
+    if (plan->p_npasses & 1) {
+        fft_realmerge(plan, buf, tmp, tmp + n, sign);
+        fft_passes(plan, scratch, halves, samples, scratch);
+    } else {
+        fft_realmerge(plan, buf, buf, buf + n, sign);
+        fft_passes(plan, halves, halves, samples, scratch);
+    }
+}
+
+static t_fft_plan* fft_getplan(int n)
+{
+    int log = fft_log2(n);
+    return log >= 1 && log <= FFT_MAXLOG ? fft_plans[log] : 0;
+}
+
+int libpd_fft_prepare(int n)
+{
+    int log = fft_log2(n), i;
+    if (log < FFT_MINLOG || log > FFT_MAXLOG)
+        return 0;
+
+    // the complex transform of n points, and the one of n / 2 points for the real transform
+    pthread_mutex_lock(&fft_planlock);
+    for (i = log - 1; i <= log; i++) {
+        if (!fft_plans[i])
+            fft_plans[i] = fft_plan_new(i);
+    }
+    pthread_mutex_unlock(&fft_planlock);
+
+    fft_getscratch(2 * n);
+    return 1;
+}
+
+void libpd_fft_real(int n, t_sample* buf)
+{
+    fft_real(fft_getplan(n / 2), buf, 1);
+}
+
+void libpd_fft_realinverse(int n, t_sample* buf)
+{
+    fft_realinverse(fft_getplan(n / 2), buf, 1);
+}
+
+void libpd_fft_complex(int n, t_sample* re, t_sample* im, int inverse)
+{
+    fft_complex(fft_getplan(n), re, im, inverse);
+}
+
+// pd's FFT glue, built in place of pd's d_fft_fftsg.c, so [fft~], [rfft~] and the rest, and pd's extras,
+// all run the transforms above. The layouts and signs are the ones of Mayer's routines that pd started with:
+// the forward transforms are X[k] = sum x[j] e^(-2 pi i jk / n), and the real ones keep -Im(X[k]) at n - k.
+// Neither direction is scaled. Sizes that aren't supported are left as they are
+
+// Prepares n points the first time this thread transforms them
+static int fft_use(int n)
+{
+    int log = fft_log2(n);
+    if (log < FFT_MINLOG || log > FFT_MAXLOG)
+        return 0;
+    if (!fft_ready[log]) {
+        if (!libpd_fft_prepare(n))
+            return 0;
+        fft_ready[log] = 1;
+    }
+    return 1;
+}
+
+void mayer_fft(int n, t_sample* real, t_sample* imag)
+{
+    if (fft_use(n))
+        fft_complex(fft_getplan(n), real, imag, 0);
+}
+
+void mayer_ifft(int n, t_sample* real, t_sample* imag)
+{
+    if (fft_use(n))
+        fft_complex(fft_getplan(n), real, imag, 1);
+}
+
+void mayer_realfft(int n, t_sample* real)
+{
+    if (fft_use(n))
+        fft_real(fft_getplan(n / 2), real, -1);
+}
+
+void mayer_realifft(int n, t_sample* real)
+{
+    if (fft_use(n))
+        fft_realinverse(fft_getplan(n / 2), real, -1);
+}
+
+// The Hartley transform, H[k] = sum x[j] (cos(2 pi jk / n) + sin(2 pi jk / n)), from the real transform
+void mayer_fht(t_sample* fz, int n)
+{
+    int k;
+    if (!fft_use(n))
+        return;
+
+    fft_real(fft_getplan(n / 2), fz, 1);
+    for (k = 1; k < n / 2; k++) {
+        t_sample re = fz[k], im = fz[n - k];
+        fz[k] = re - im;
+        fz[n - k] = re + im;
+    }
+}
+
+// n complex points, with the real and imaginary parts of each one next to each other
+void pd_fft(t_float* buf, int npoints, int inverse)
+{
+    t_sample* split;
+    int i;
+
+    if (!fft_use(npoints))
+        return;
+
+    split = (t_sample*)getbytes(2 * npoints * sizeof(*split));
+    for (i = 0; i < npoints; i++) {
+        split[i] = buf[2 * i];
+        split[npoints + i] = buf[2 * i + 1];
+    }
+
+    fft_complex(fft_getplan(npoints), split, split + npoints, inverse);
+
+    for (i = 0; i < npoints; i++) {
+        buf[2 * i] = split[i];
+        buf[2 * i + 1] = split[npoints + i];
+    }
+    freebytes(split, 2 * npoints * sizeof(*split));
+}
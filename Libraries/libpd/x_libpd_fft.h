@@ -0,0 +1,34 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <m_pd.h>
+
+// Sizes are powers of 2 from 4 points up to 2^24. Plans are shared by every instance and made once
+// per size, call libpd_fft_prepare from a dsp method before the transforms of a size run, since it
+// allocates the first time. Returns 0 for sizes that aren't supported
+// The same transforms run pd's FFT objects: this file provides pd's mayer_fft, mayer_realfft and the
+// rest of the FFT glue, and is built in place of pd's d_fft_fftsg.c
+int libpd_fft_prepare(int n);
+
+// Real transform of n points in place, in the layout of pd's [rfft~]: the real parts of the bins 0 to n/2,
+// followed by the imaginary parts of the bins n/2 - 1 down to 1, signed as in X[k] = sum x[j] e^(-2 pi i jk / n)
+void libpd_fft_real(int n, t_sample* buf);
+
+// Inverse of libpd_fft_real without the scaling, the result is n times the signal
+void libpd_fft_realinverse(int n, t_sample* buf);
+
+// Complex transform of n points in place, the inverse is not scaled either
+void libpd_fft_complex(int n, t_sample* re, t_sample* im, int inverse);
+
+#ifdef __cplusplus
+}
+#endif
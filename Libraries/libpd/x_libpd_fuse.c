@@ -0,0 +1,255 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <m_pd.h>
+#include <m_imp.h>
+
+#include "x_libpd_fuse.h"
+
+// Samples that each routine of a fused run processes before the next one takes over
+#define FUSE_CHUNK 16
+
+// The marker that the dsp methods add, fuse_marker and eight arguments
+#define FUSE_MARKER_SIZE 9
+
+// pd's routines of these objects take up five t_ints of the chain, itself and four arguments
+#define FUSE_ROUTINE_SIZE 5
+
+#define FUSE_STRIDE (FUSE_MARKER_SIZE + FUSE_ROUTINE_SIZE)
+
+#define FUSE_MAXCLASSES 8
+
+enum {
+    FUSE_PLUS,
+    FUSE_MINUS,
+    FUSE_TIMES,
+    FUSE_OVER,
+    FUSE_SCALARPLUS,
+    FUSE_SCALARMINUS,
+    FUSE_SCALARTIMES,
+    FUSE_SCALAROVER
+};
+
+// What the marker in front of each routine holds, the object comes first so the profiler counts the marker to it
+enum {
+    FUSE_OWNER = 1,
+    FUSE_STATE,
+    FUSE_KIND,
+    FUSE_RUN, // routines fused from here on, 0 before the marker first ran and -1 when there's nothing to fuse
+    FUSE_IN1,
+    FUSE_IN2, // the second input, or the scalar once the routine was checked
+    FUSE_OUT,
+    FUSE_N
+};
+
+// A class whose dsp method was wrapped, pd renamed its own one to "dsp_aliased"
+typedef struct _fuse_class {
+    t_class* c_class;
+    int c_kind;
+} t_fuse_class;
+
+// Per instance state, bound to a symbol like the profiler
+typedef struct _fuse {
+    t_pd x_pd;
+    int x_enabled;
+} t_fuse;
+
+static t_class* fuse_class;
+
+static t_fuse_class fuse_classes[FUSE_MAXCLASSES];
+static int fuse_nclasses;
+
+static t_fuse* fuse_get(void)
+{
+    t_symbol* s = gensym("#plugdata_fuse");
+    t_fuse* x = (t_fuse*)pd_findbyclass(s, fuse_class);
+    if (!x) {
+        x = (t_fuse*)pd_new(fuse_class);
+        x->x_enabled = 1;
+        pd_bind(&x->x_pd, s);
+    }
+    return x;
+}
+
+static t_int* fuse_marker(t_int* w);
+
+// Whether the routine behind a marker takes the arguments the marker expects, which pd's routines of these
+// objects do. The scalar is inside the object, its address is kept in the marker from then on
+static int fuse_check(t_int* m)
+{
+    t_int const* w = m + FUSE_MARKER_SIZE;
+    t_object* owner = (t_object*)m[FUSE_OWNER];
+    char const* scalar = (char const*)w[2];
+
+    if (m[0] != (t_int)fuse_marker || w[1] != m[FUSE_IN1] || w[3] != m[FUSE_OUT] || w[4] != m[FUSE_N])
+        return 0;
+
+    if (m[FUSE_KIND] < FUSE_SCALARPLUS)
+        return w[2] == m[FUSE_IN2];
+
+    if (scalar < (char const*)owner || scalar + sizeof(t_float) > (char const*)owner + pd_class(&owner->ob_pd)->c_size)
+        return 0;
+    m[FUSE_IN2] = w[2];
+    return 1;
+}
+
+// Does the same as the routine behind marker m, for k samples from i on
+static void fuse_op_run(t_int const* m, int i, int k)
+{
+    t_sample const* in1 = (t_sample const*)m[FUSE_IN1] + i;
+    t_sample const* in2 = (t_sample const*)m[FUSE_IN2] + i;
+    t_sample* out = (t_sample*)m[FUSE_OUT] + i;
+    t_sample g;
+    int j;
+
+    switch (m[FUSE_KIND]) {
+    case FUSE_PLUS:
+        for (j = 0; j < k; j++)
+            out[j] = in1[j] + in2[j];
+        break;
+    case FUSE_MINUS:
+        for (j = 0; j < k; j++)
+            out[j] = in1[j] - in2[j];
+        break;
+    case FUSE_TIMES:
+        for (j = 0; j < k; j++)
+            out[j] = in1[j] * in2[j];
+        break;
+    case FUSE_OVER:
+        for (j = 0; j < k; j++) {
+            t_sample f = in1[j], d = in2[j];
+            out[j] = d ? f / d : 0;
+        }
+        break;
+    case FUSE_SCALARPLUS:
+        g = *(t_float const*)m[FUSE_IN2];
+        for (j = 0; j < k; j++)
+            out[j] = in1[j] + g;
+        break;
+    case FUSE_SCALARMINUS:
+        g = *(t_float const*)m[FUSE_IN2];
+        for (j = 0; j < k; j++)
+            out[j] = in1[j] - g;
+        break;
+    case FUSE_SCALARTIMES:
+        g = *(t_float const*)m[FUSE_IN2];
+        for (j = 0; j < k; j++)
+            out[j] = in1[j] * g;
+        break;
+    case FUSE_SCALAROVER:
+        g = *(t_float const*)m[FUSE_IN2];
+        if (g)
+            g = (t_sample)(1. / g);
+        for (j = 0; j < k; j++)
+            out[j] = in1[j] * g;
+        break;
+    }
+}
+
+// Runs in front of pd's routine of each wrapped object. The first time, it counts the markers and routines
+// that follow each other from here on with the same size. Then it runs every routine of that run over a chunk
+// before going on to the next chunk, so the chunk is still in the cache, or in registers, when the next routine
+// reads it, and skips pd's routines. Every output is written, since other objects might read any of them.
+// Markers further on in a run never run, unless [switch~] or [block~] jump there
+static t_int* fuse_marker(t_int* w)
+{
+    t_fuse const* x = (t_fuse const*)w[FUSE_STATE];
+    int n = (int)w[FUSE_N], nops, i, j;
+
+    if (!w[FUSE_RUN]) {
+        t_int* m = w;
+        nops = 0;
+        while (m[FUSE_N] == n && fuse_check(m)) {
+            nops++;
+            m += FUSE_STRIDE;
+        }
+        w[FUSE_RUN] = nops ? nops : -1;
+    }
+
+    nops = (int)w[FUSE_RUN];
+    if (!x->x_enabled || nops < 0)
+        return w + FUSE_MARKER_SIZE;
+
+    for (i = 0; i < n; i += FUSE_CHUNK) {
+        int k = n - i < FUSE_CHUNK ? n - i : FUSE_CHUNK;
+        for (j = 0; j < nops; j++)
+            fuse_op_run(w + j * FUSE_STRIDE, i, k);
+    }
+
+    return w + nops * FUSE_STRIDE;
+}
+
+static t_fuse_class const* fuse_findclass(t_class* c)
+{
+    int i;
+    for (i = 0; i < fuse_nclasses; i++) {
+        if (fuse_classes[i].c_class == c)
+            return fuse_classes + i;
+    }
+    return 0;
+}
+
+// Puts a marker in front of the routine that the object's own dsp method adds
+static void fuse_dsp(t_object* x, t_signal** sp)
+{
+    t_fuse_class const* c = fuse_findclass(pd_class(&x->ob_pd));
+    t_gotfn fn = zgetfn(&x->ob_pd, gensym("dsp_aliased"));
+    int scalar = c->c_kind >= FUSE_SCALARPLUS;
+
+    dsp_add(fuse_marker, 8, x, fuse_get(), (t_int)c->c_kind, (t_int)0, sp[0]->s_vec, scalar ? 0 : sp[1]->s_vec,
+        sp[scalar ? 1 : 2]->s_vec, (t_int)sp[0]->s_n);
+
+    if (fn)
+        (*(void (*)(t_object*, t_signal**))fn)(x, sp);
+}
+
+// Their classes are private to pd, an object tells us which one it is
+static void fuse_wrap(char const* name, t_float const* args, int nargs, int kind)
+{
+    t_atom argv[1];
+    t_pd* probe;
+    int i;
+
+    for (i = 0; i < nargs; i++)
+        SETFLOAT(argv + i, args[i]);
+
+    pd_typedmess(&pd_objectmaker, gensym(name), nargs, argv);
+    probe = pd_newest();
+    if (!probe)
+        return;
+
+    if (zgetfn(probe, gensym("dsp")) && !fuse_findclass(pd_class(probe)) && fuse_nclasses < FUSE_MAXCLASSES) {
+        fuse_classes[fuse_nclasses].c_class = pd_class(probe);
+        fuse_classes[fuse_nclasses].c_kind = kind;
+        fuse_nclasses++;
+        class_addmethod(pd_class(probe), (t_method)fuse_dsp, gensym("dsp"), A_CANT, 0);
+    }
+
+    pd_free(probe);
+}
+
+void libpd_fuse_setup(void)
+{
+    static t_float const scalar[] = { 3 };
+
+    fuse_class = class_new(gensym("plugdata_fuse"), 0, 0, sizeof(t_fuse), CLASS_PD, 0);
+
+    fuse_wrap("+~", 0, 0, FUSE_PLUS);
+    fuse_wrap("-~", 0, 0, FUSE_MINUS);
+    fuse_wrap("*~", 0, 0, FUSE_TIMES);
+    fuse_wrap("/~", 0, 0, FUSE_OVER);
+    fuse_wrap("+~", scalar, 1, FUSE_SCALARPLUS);
+    fuse_wrap("-~", scalar, 1, FUSE_SCALARMINUS);
+    fuse_wrap("*~", scalar, 1, FUSE_SCALARTIMES);
+    fuse_wrap("/~", scalar, 1, FUSE_SCALAROVER);
+}
+
+void libpd_fuse_enable(int enable)
+{
+    sys_lock();
+    fuse_get()->x_enabled = enable;
+    sys_unlock();
+}
@@ -0,0 +1,27 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <m_pd.h>
+
+// Wraps the dsp methods of [+~], [-~], [*~] and [/~], needs to be called once after libpd_init
+// Each of them puts a marker in front of pd's own routine, so runs of them are found in the DSP chain
+// Routines whose arguments don't look like they're expected are never fused
+void libpd_fuse_setup(void);
+
+// Runs of those routines that follow each other in the DSP chain are run by the first marker,
+// all of them over a few samples at a time. It's on by default, turn it off while profiling,
+// so every object is measured on its own. Locks pd
+void libpd_fuse_enable(int enable);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,47 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <string.h>
+
+#include <m_pd.h>
+#include <m_imp.h>
+#include <s_stuff.h>
+
+#include "x_libpd_libpaths.h"
+
+static t_anymethod libpaths_new_anything;
+static t_libpd_libpaths_resolver libpaths_resolver;
+
+// Called for every name pd has no creator for yet
+static void libpaths_anything(t_pd* dummy, t_symbol* s, int argc, t_atom* argv)
+{
+    char dir[MAXPDSTRING];
+
+    libpaths_new_anything(dummy, s, argc, argv);
+
+    // Names with a folder in them are left to pd, it looks for those relative to the search path
+    if (pd_newest() || !libpaths_resolver || strchr(s->s_name, '/'))
+        return;
+
+    if (!libpaths_resolver(s->s_name, dir, MAXPDSTRING))
+        return;
+
+    // The folder stays on the search path, so other objects, abstractions and files from the same library
+    // are found the usual way. namelist_append leaves out folders that are already on it
+    STUFF->st_searchpath = namelist_append(STUFF->st_searchpath, dir, 0);
+    libpaths_new_anything(dummy, s, argc, argv);
+}
+
+void libpd_libpaths_setup(void)
+{
+    libpaths_new_anything = pd_objectmaker->c_anymethod;
+    pd_objectmaker->c_anymethod = libpaths_anything;
+}
+
+void libpd_libpaths_set_resolver(t_libpd_libpaths_resolver resolver)
+{
+    libpaths_resolver = resolver;
+}
@@ -0,0 +1,29 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <m_pd.h>
+
+// Library folders that only join pd's search path once an object is loaded from them
+// pd probes every folder on its search path with every extension it knows for each name it hasn't loaded yet,
+// so the cost of loading a patch grows with the number of installed libraries. Folders that are left off the
+// search path are looked up by the resolver instead, which writes the folder that has name into dir and returns
+// nonzero. It's only asked after pd couldn't find name itself, and is called from every instance's thread.
+typedef int (*t_libpd_libpaths_resolver)(char const* name, char* dir, int size);
+
+// Installs the lookup, needs to be called once after libpd_init
+void libpd_libpaths_setup(void);
+
+void libpd_libpaths_set_resolver(t_libpd_libpaths_resolver resolver);
+
+#ifdef __cplusplus
+}
+#endif
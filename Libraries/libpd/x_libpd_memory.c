@@ -0,0 +1,72 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+// pd's allocator, built in place of pd's m_memory.c. It's the same as pd's, except that the values of
+// arrays can be storage that arrays of several instances share (see x_libpd_sharedarray.h), which is
+// never freed or resized in place here
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <m_pd.h>
+
+#include "x_libpd_sharedarray.h"
+
+void* getbytes(size_t nbytes)
+{
+    void* ret;
+    if (nbytes < 1)
+        nbytes = 1;
+    ret = calloc(nbytes, 1);
+    if (!ret)
+        post("pd: getbytes() failed -- out of memory");
+    return ret;
+}
+
+void* getzbytes(size_t nbytes)
+{
+    return getbytes(nbytes);
+}
+
+void* copybytes(void const* src, size_t nbytes)
+{
+    void* ret = getbytes(nbytes);
+    if (nbytes && ret)
+        memcpy(ret, src, nbytes);
+    return ret;
+}
+
+void* resizebytes(void* old, size_t oldsize, size_t newsize)
+{
+    void* ret;
+    if (newsize < 1)
+        newsize = 1;
+    if (oldsize < 1)
+        oldsize = 1;
+
+    // Shared storage stays with the other arrays, the resized one gets a copy
+    if (libpd_sharedarray_owns(old)) {
+        ret = getbytes(newsize);
+        if (ret)
+            memcpy(ret, old, oldsize < newsize ? oldsize : newsize);
+        libpd_sharedarray_release(old);
+        return ret;
+    }
+
+    ret = realloc(old, newsize);
+    if (ret && newsize > oldsize)
+        memset((char*)ret + oldsize, 0, newsize - oldsize);
+    if (!ret)
+        post("pd: resizebytes() failed -- out of memory");
+    return ret;
+}
+
+void freebytes(void* fatso, size_t nbytes)
+{
+    (void)nbytes;
+    if (!libpd_sharedarray_release(fatso))
+        free(fatso);
+}
@@ -10,9 +10,14 @@
 #include <g_undo.h>
 
 #include <errno.h>
+#include <limits.h>
 
 #include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
 #include "x_libpd_mod_utils.h"
+#include "x_libpd_abscache.h"
+#include "s_libpd_inter.h"
 
 struct _instanceeditor {
     t_binbuf* copy_binbuf;
@@ -82,6 +87,72 @@ static void canvas_collecttemplatesfor(t_canvas* x, int* ntemplatesp,
     }
 }
 
+static void libpd_object_event(t_libpd_canvas_event_type type, t_canvas* cnv, t_gobj* obj, t_gobj* previous)
+{
+    t_libpd_canvas_event event = { type, cnv, obj, previous, 0, 0, 0, 0 };
+    canvas_event(&event);
+}
+
+static void libpd_connection_event(t_libpd_canvas_event_type type, t_canvas* cnv, t_object* src, int nout, t_object* sink, int nin)
+{
+    t_libpd_canvas_event event = { type, cnv, 0, 0, src, nout, sink, nin };
+    canvas_event(&event);
+}
+
+static int libpd_compare_pointers(void const* a, void const* b)
+{
+    uintptr_t const x = (uintptr_t)(*(void* const*)a);
+    uintptr_t const y = (uintptr_t)(*(void* const*)b);
+    return (x > y) - (x < y);
+}
+
+static int libpd_contains_pointer(t_gobj** sorted, int n, void* obj)
+{
+    return bsearch(&obj, sorted, n, sizeof(t_gobj*), libpd_compare_pointers) != 0;
+}
+
+/* report every object after "last" as created, along with the connections
+ that start or end at one of them */
+static void libpd_report_objects_after(t_canvas* cnv, t_gobj* last)
+{
+    t_gobj* first = last ? last->g_next : cnv->gl_list;
+    t_gobj** created;
+    t_gobj* y;
+    t_outconnect* oc;
+    t_linetraverser t;
+    int n = 0, i = 0;
+
+    for (y = first; y; y = y->g_next)
+        n++;
+
+    if (!n)
+        return;
+
+    created = (t_gobj**)getbytes(n * sizeof(t_gobj*));
+    for (y = first; y; y = y->g_next) {
+        libpd_object_event(LIBPD_OBJECT_CREATED, cnv, y, 0);
+        created[i++] = y;
+    }
+
+    qsort(created, n, sizeof(t_gobj*), libpd_compare_pointers);
+
+    linetraverser_start(&t, cnv);
+    while ((oc = linetraverser_next(&t))) {
+        if (libpd_contains_pointer(created, n, &t.tr_ob->ob_g) || libpd_contains_pointer(created, n, &t.tr_ob2->ob_g))
+            libpd_connection_event(LIBPD_CONNECTION_ADDED, cnv, t.tr_ob, t.tr_outno, t.tr_ob2, t.tr_inno);
+    }
+
+    freebytes(created, n * sizeof(t_gobj*));
+}
+
+static t_gobj* libpd_last(t_canvas* cnv)
+{
+    t_gobj* y;
+    for (y = cnv->gl_list; y && y->g_next; y = y->g_next) {
+    }
+    return y;
+}
+
 /* displace the selection by (dx, dy) pixels */
 void libpd_moveselection(t_canvas* cnv, int dx, int dy)
 {
@@ -97,6 +168,7 @@ void libpd_moveselection(t_canvas* cnv, int dx, int dy)
 
         t_class* cl = pd_class(&y->sel_what->g_pd);
         gobj_displace(y->sel_what, cnv, dx, dy);
+        libpd_object_event(LIBPD_OBJECT_MOVED, cnv, y->sel_what, 0);
         if (cl == vinlet_class)
             resortin = 1;
         else if (cl == voutlet_class)
@@ -141,6 +213,8 @@ void libpd_canvas_doclear(t_canvas* cnv)
      the glist to reselect. */
     if (cnv->gl_editor->e_textedfor) {
         // t_gobj *selwas = x->gl_editor->e_selection->sel_what;
+        // The deselected object might have been recreated, which we can't describe
+        libpd_object_event(LIBPD_CANVAS_CHANGED, cnv, 0, 0);
         pd_this->pd_newest = 0;
         glist_noselect(cnv);
         if (pd_this->pd_newest) {
@@ -154,6 +228,7 @@ void libpd_canvas_doclear(t_canvas* cnv)
         for (y = cnv->gl_list; y; y = y2) {
             y2 = y->g_next;
             if (glist_isselected(cnv, y)) {
+                libpd_object_event(LIBPD_OBJECT_DELETED, cnv, y, 0);
                 glist_delete(cnv, y);
                 goto next;
             }
@@ -186,11 +261,15 @@ void libpd_removeselection(t_canvas* cnv)
 void libpd_start_undo_sequence(t_canvas* cnv, char const* name)
 {
     canvas_undo_add(cnv, UNDO_SEQUENCE_START, name, 0);
+
+    // Everything in the sequence only causes one DSP rebuild, when it ends
+    suspend_dsp_updates();
 }
 
 void libpd_end_undo_sequence(t_canvas* cnv, char const* name)
 {
     canvas_undo_add(cnv, UNDO_SEQUENCE_END, name, 0);
+    resume_dsp_updates();
 }
 
 void canvas_savedeclarationsto(t_canvas* cnv, t_binbuf* b);
@@ -250,6 +329,7 @@ int libpd_tryconnect(t_canvas* cnv, t_object* src, int nout, t_object* sink, int
                 oc);
             canvas_undo_add(cnv, UNDO_CONNECT, "connect", canvas_undo_set_connect(cnv, canvas_getindex(cnv, &src->ob_g), nout, canvas_getindex(cnv, &sink->ob_g), nin));
             canvas_dirty(cnv, 1);
+            libpd_connection_event(LIBPD_CONNECTION_ADDED, cnv, src, nout, sink, nin);
             return 1;
         }
     }
@@ -346,20 +426,45 @@ char const* libpd_copy(t_canvas* cnv, int* size)
     return text;
 }
 
-void libpd_paste(t_canvas* cnv, char const* buf)
+void libpd_copy_binary(char** buf, int* bufsize)
+{
+    libpd_binbuf_getbinary(pd_this->pd_gui->i_editor->copy_binbuf, buf, bufsize);
+}
+
+static void libpd_dopaste(t_canvas* cnv)
 {
-    size_t len = strlen(buf);
-    binbuf_text(pd_this->pd_gui->i_editor->copy_binbuf, buf, len);
-    
     sys_lock();
+    t_gobj* last = libpd_last(cnv);
+    suspend_dsp_updates();
     pd_typedmess((t_pd*)cnv, gensym("paste"), 0, NULL);
+    resume_dsp_updates();
+    libpd_report_objects_after(cnv, last);
     sys_unlock();
 }
 
+void libpd_paste(t_canvas* cnv, char const* buf)
+{
+    size_t len = strlen(buf);
+    binbuf_text(pd_this->pd_gui->i_editor->copy_binbuf, buf, len);
+    libpd_dopaste(cnv);
+}
+
+int libpd_paste_binary(t_canvas* cnv, char const* buf, size_t bufsize)
+{
+    if (!libpd_binbuf_setbinary(pd_this->pd_gui->i_editor->copy_binbuf, buf, bufsize))
+        return 0;
+
+    libpd_dopaste(cnv);
+    return 1;
+}
+
 void libpd_undo(t_canvas* cnv)
 {
     sys_lock();
+    suspend_dsp_updates();
     pd_typedmess((t_pd*)cnv, gensym("undo"), 0, NULL);
+    resume_dsp_updates();
+    libpd_object_event(LIBPD_CANVAS_CHANGED, cnv, 0, 0);
     sys_unlock();
 }
 
@@ -371,17 +476,111 @@ void libpd_redo(t_canvas* cnv)
         return;
 
     sys_lock();
+    suspend_dsp_updates();
     pd_typedmess((t_pd*)cnv, gensym("redo"), 0, NULL);
+    resume_dsp_updates();
+    libpd_object_event(LIBPD_CANVAS_CHANGED, cnv, 0, 0);
     sys_unlock();
 }
 
 void libpd_duplicate(t_canvas* cnv)
 {
     sys_lock();
+    t_gobj* last = libpd_last(cnv);
+    suspend_dsp_updates();
     pd_typedmess((t_pd*)cnv, gensym("duplicate"), 0, NULL);
+    resume_dsp_updates();
+    libpd_report_objects_after(cnv, last);
     sys_unlock();
 }
 
+t_gobj* libpd_encapsulate(t_canvas* cnv, int x, int y, t_libpd_encapsulate_edge const* edges, int nedges,
+    t_libpd_encapsulate_connection const* connections, int nconnections)
+{
+    t_binbuf* copy = pd_this->pd_gui->i_editor->copy_binbuf;
+    t_binbuf* saved;
+    t_binbuf* b;
+    t_gobj* subpatch;
+    t_gobj* obj;
+    int* iolets;
+    int i, nselected = 0, ninlets = 0, noutlets = 0;
+    int lastinletx = INT_MIN, lastoutletx = INT_MIN;
+
+    if (!cnv->gl_editor || !cnv->gl_editor->e_selection)
+        return NULL;
+
+    for (obj = cnv->gl_list; obj; obj = obj->g_next) {
+        if (glist_isselected(cnv, obj))
+            nselected++;
+    }
+
+    // pd's own clipboard is only borrowed
+    saved = binbuf_duplicate(copy);
+    pd_typedmess((t_pd*)cnv, gensym("copy"), 0, NULL);
+
+    // The copied atoms go into the subpatch as they are, followed by its inlets, outlets and their connections
+    b = binbuf_new();
+    binbuf_addv(b, "ssiiiisi;", gensym("#N"), gensym("canvas"), 0, 50, 450, 300, gensym("pd"), 0);
+    binbuf_add(b, binbuf_getnatom(copy), binbuf_getvec(copy));
+
+    // A subpatch orders its inlets and outlets by their x position, keep them in the order of the edges
+    iolets = (int*)getbytes(sizeof(int) * (nedges ? nedges : 1));
+    for (i = 0; i < nedges; i++) {
+        t_libpd_encapsulate_edge const* edge = edges + i;
+        int* lastx = edge->is_inlet ? &lastinletx : &lastoutletx;
+        int ex = edge->x > *lastx ? edge->x : *lastx + 1;
+        char const* name = edge->is_inlet ? (edge->is_signal ? "inlet~" : "inlet") : (edge->is_signal ? "outlet~" : "outlet");
+
+        *lastx = ex;
+        iolets[i] = edge->is_inlet ? ninlets++ : noutlets++;
+        binbuf_addv(b, "ssiis;", gensym("#X"), gensym("obj"), ex, edge->y, gensym(name));
+    }
+
+    for (i = 0; i < nedges; i++) {
+        t_libpd_encapsulate_edge const* edge = edges + i;
+        if (edge->is_inlet)
+            binbuf_addv(b, "ssiiii;", gensym("#X"), gensym("connect"), nselected + i, 0, edge->object, edge->iolet);
+        else
+            binbuf_addv(b, "ssiiii;", gensym("#X"), gensym("connect"), edge->object, edge->iolet, nselected + i, 0);
+    }
+
+    binbuf_addv(b, "ssiis;", gensym("#X"), gensym("restore"), x, y, gensym("pd"));
+
+    // One undo step and one DSP rebuild for all of it
+    libpd_start_undo_sequence(cnv, "encapsulate");
+    libpd_removeselection(cnv);
+
+    binbuf_clear(copy);
+    binbuf_add(copy, binbuf_getnatom(b), binbuf_getvec(b));
+    libpd_dopaste(cnv);
+    subpatch = libpd_last(cnv);
+
+    if (subpatch && pd_checkobject(&subpatch->g_pd)) {
+        for (i = 0; i < nconnections; i++) {
+            t_libpd_encapsulate_connection const* connection = connections + i;
+            t_libpd_encapsulate_edge const* edge;
+            if (connection->edge < 0 || connection->edge >= nedges)
+                continue;
+
+            edge = edges + connection->edge;
+            if (edge->is_inlet)
+                libpd_createconnection(cnv, connection->object, connection->iolet, (t_object*)subpatch, iolets[connection->edge]);
+            else
+                libpd_createconnection(cnv, (t_object*)subpatch, iolets[connection->edge], connection->object, connection->iolet);
+        }
+    }
+
+    libpd_end_undo_sequence(cnv, "encapsulate");
+
+    binbuf_clear(copy);
+    binbuf_add(copy, binbuf_getnatom(saved), binbuf_getvec(saved));
+    binbuf_free(saved);
+    binbuf_free(b);
+    freebytes(iolets, sizeof(int) * (nedges ? nedges : 1));
+
+    return subpatch;
+}
+
 void libpd_canvas_saveto(t_canvas* cnv, t_binbuf* b)
 {
     t_gobj* y;
@@ -520,6 +719,7 @@ void libpd_savetofile(t_canvas* cnv, t_symbol* filename, t_symbol* dir)
     t_binbuf* b = binbuf_new();
     libpd_savetemplatesto(cnv, b);
     libpd_canvas_saveto(cnv, b);
+    libpd_abscache_invalidate(filename, dir);
     if (binbuf_write(b, filename->s_name, dir->s_name, 0))
         post("%s/%s: %s", dir->s_name, filename->s_name,
             (errno ? strerror(errno) : "write failed"));
@@ -578,6 +778,8 @@ t_pd* libpd_creategraphonparent(t_canvas* cnv, int x, int y)
     t_pd* result = libpd_newest(cnv);
     ((t_glist*)result)->gl_hidetext = 1;
 
+    libpd_object_event(LIBPD_OBJECT_CREATED, cnv, (t_gobj*)result, 0);
+
     return result;
 }
 
@@ -603,6 +805,8 @@ t_pd* libpd_creategraph(t_canvas* cnv, char const* name, int size, int x, int y)
 
     gobj_setposition(pd_checkobject(arr), cnv, x, y);
 
+    libpd_object_event(LIBPD_OBJECT_CREATED, cnv, (t_gobj*)arr, 0);
+
     return arr;
 }
 
@@ -620,6 +824,8 @@ t_pd* libpd_createobj(t_canvas* cnv, t_symbol* s, int argc, t_atom* argv)
     t_pd* new_object = libpd_newest(cnv);
 
     if (new_object) {
+        libpd_object_event(LIBPD_OBJECT_CREATED, cnv, (t_gobj*)new_object, 0);
+
         if (pd_class(new_object) == canvas_class)
             canvas_loadbang(new_object);
         else if (zgetfn(new_object, gensym("loadbang")))
@@ -674,6 +880,37 @@ struct _rtext {
     struct _rtext* x_next;
 };
 
+/* pd recreates an object when its text changes, the new one ends up last */
+static void libpd_report_retyped(t_canvas* cnv, t_gobj* obj)
+{
+    t_gobj* y;
+    t_gobj* replacement;
+    t_outconnect* oc;
+    t_linetraverser t;
+
+    for (y = cnv->gl_list; y; y = y->g_next) {
+        if (y == obj) {
+            libpd_object_event(LIBPD_OBJECT_RETYPED, cnv, obj, obj);
+            return;
+        }
+    }
+
+    replacement = libpd_last(cnv);
+    if (!replacement) {
+        libpd_object_event(LIBPD_OBJECT_DELETED, cnv, obj, 0);
+        return;
+    }
+
+    libpd_object_event(LIBPD_OBJECT_RETYPED, cnv, replacement, obj);
+
+    // Connections of the old object were restored to the new one
+    linetraverser_start(&t, cnv);
+    while ((oc = linetraverser_next(&t))) {
+        if (&t.tr_ob->ob_g == replacement || &t.tr_ob2->ob_g == replacement)
+            libpd_connection_event(LIBPD_CONNECTION_ADDED, cnv, t.tr_ob, t.tr_outno, t.tr_ob2, t.tr_inno);
+    }
+}
+
 void libpd_renameobj(t_canvas* cnv, t_gobj* obj, char const* buf, size_t bufsize)
 {
     sys_lock();
@@ -698,9 +935,26 @@ void libpd_renameobj(t_canvas* cnv, t_gobj* obj, char const* buf, size_t bufsize
     cnv->gl_editor->e_textdirty = 0;
 
     canvas_editmode(cnv, 0);
+
+    libpd_report_retyped(cnv, obj);
     sys_unlock();
 }
 
+size_t libpd_undo_get_position(t_canvas* cnv)
+{
+    t_undo* udo = canvas_undo_get(cnv);
+    size_t position = udo ? (size_t)udo->u_last : 0;
+    t_gobj* y;
+
+    // Subpatches have an undo history of their own, abstractions are saved separately
+    for (y = cnv->gl_list; y; y = y->g_next) {
+        if (pd_class(&y->g_pd) == canvas_class && !canvas_isabstraction((t_canvas*)y))
+            position = position * 31 + libpd_undo_get_position((t_canvas*)y);
+    }
+
+    return position;
+}
+
 int libpd_can_undo(t_canvas* cnv)
 {
 
@@ -725,6 +979,292 @@ int libpd_can_redo(t_canvas* cnv)
     return 0;
 }
 
+/* ------- undo history compaction -------- */
+
+// Mirrors of the undo data in g_editor.c and g_undo.c that holds the bulk of the history
+typedef struct _fake_undo_move_elem {
+    int e_index;
+    int e_xpix;
+    int e_ypix;
+} t_fake_undo_move_elem;
+
+typedef struct _fake_undo_move {
+    t_fake_undo_move_elem* u_vec;
+    int u_n;
+} t_fake_undo_move;
+
+typedef struct _fake_undo_cut {
+    t_binbuf* u_objectbuf;
+    t_binbuf* u_reconnectbuf;
+    t_binbuf* u_redotextbuf;
+    int u_mode;
+} t_fake_undo_cut;
+
+typedef struct _fake_undo_paste {
+    int u_index;
+    int u_sel_index;
+    int u_offset;
+    t_binbuf* u_objectbuf;
+} t_fake_undo_paste;
+
+typedef struct _fake_undo_apply {
+    t_binbuf* u_objectbuf;
+    t_binbuf* u_reconnectbuf;
+    int u_index;
+} t_fake_undo_apply;
+
+typedef struct _fake_undo_create {
+    int u_index;
+    t_binbuf* u_objectbuf;
+    t_binbuf* u_reconnectbuf;
+} t_fake_undo_create;
+
+static size_t undo_binbuf_size(t_binbuf* b)
+{
+    return b ? sizeof(t_atom) * (size_t)binbuf_getnatom(b) : 0;
+}
+
+static size_t undo_action_size(t_undo_action* a)
+{
+    size_t size = sizeof(*a);
+    if (!a->data)
+        return size;
+
+    switch (a->type) {
+    case UNDO_MOTION: {
+        t_fake_undo_move* m = (t_fake_undo_move*)a->data;
+        size += sizeof(*m) + sizeof(t_fake_undo_move_elem) * (size_t)m->u_n;
+        break;
+    }
+    case UNDO_CUT: {
+        t_fake_undo_cut* c = (t_fake_undo_cut*)a->data;
+        size += sizeof(*c) + undo_binbuf_size(c->u_objectbuf) + undo_binbuf_size(c->u_reconnectbuf) + undo_binbuf_size(c->u_redotextbuf);
+        break;
+    }
+    case UNDO_PASTE: {
+        t_fake_undo_paste* p = (t_fake_undo_paste*)a->data;
+        size += sizeof(*p) + undo_binbuf_size(p->u_objectbuf);
+        break;
+    }
+    case UNDO_APPLY: {
+        t_fake_undo_apply* p = (t_fake_undo_apply*)a->data;
+        size += sizeof(*p) + undo_binbuf_size(p->u_objectbuf) + undo_binbuf_size(p->u_reconnectbuf);
+        break;
+    }
+    case UNDO_CREATE:
+    case UNDO_RECREATE: {
+        t_fake_undo_create* c = (t_fake_undo_create*)a->data;
+        size += sizeof(*c) + undo_binbuf_size(c->u_objectbuf) + undo_binbuf_size(c->u_reconnectbuf);
+        break;
+    }
+    default:
+        break;
+    }
+    return size;
+}
+
+// Frees an action that's already unlinked, the way canvas_undo_free does
+static void undo_free_action(t_canvas* cnv, t_undo_action* a)
+{
+    switch (a->type) {
+    case UNDO_CONNECT:
+        canvas_undo_connect(cnv, a->data, UNDO_FREE);
+        break;
+    case UNDO_DISCONNECT:
+        canvas_undo_disconnect(cnv, a->data, UNDO_FREE);
+        break;
+    case UNDO_CUT:
+        canvas_undo_cut(cnv, a->data, UNDO_FREE);
+        break;
+    case UNDO_MOTION:
+        canvas_undo_move(cnv, a->data, UNDO_FREE);
+        break;
+    case UNDO_PASTE:
+        canvas_undo_paste(cnv, a->data, UNDO_FREE);
+        break;
+    case UNDO_APPLY:
+        canvas_undo_apply(cnv, a->data, UNDO_FREE);
+        break;
+    case UNDO_ARRANGE:
+        canvas_undo_arrange(cnv, a->data, UNDO_FREE);
+        break;
+    case UNDO_CANVAS_APPLY:
+        canvas_undo_canvas_apply(cnv, a->data, UNDO_FREE);
+        break;
+    case UNDO_CREATE:
+        canvas_undo_create(cnv, a->data, UNDO_FREE);
+        break;
+    case UNDO_RECREATE:
+        canvas_undo_recreate(cnv, a->data, UNDO_FREE);
+        break;
+    case UNDO_FONT:
+        canvas_undo_font(cnv, a->data, UNDO_FREE);
+        break;
+    default:
+        break;
+    }
+    freebytes(a, sizeof(*a));
+}
+
+// Two moves in a row of the same objects: undoing the first one restores the positions from before both
+static int undo_is_same_move(t_undo_action* a, t_undo_action* b)
+{
+    t_fake_undo_move *m1, *m2;
+    int i;
+
+    if (a->type != UNDO_MOTION || b->type != UNDO_MOTION || !a->data || !b->data)
+        return 0;
+
+    m1 = (t_fake_undo_move*)a->data;
+    m2 = (t_fake_undo_move*)b->data;
+    if (m1->u_n != m2->u_n)
+        return 0;
+
+    for (i = 0; i < m1->u_n; i++) {
+        if (m1->u_vec[i].e_index != m2->u_vec[i].e_index)
+            return 0;
+    }
+    return 1;
+}
+
+size_t libpd_undo_get_memory(t_canvas* cnv, int* nactions)
+{
+    t_undo* udo = canvas_undo_get(cnv);
+    t_undo_action* a;
+    size_t size = 0;
+    int n = 0;
+
+    if (udo) {
+        for (a = udo->u_queue; a; a = a->next) {
+            size += undo_action_size(a);
+            n++;
+        }
+    }
+
+    if (nactions)
+        *nactions = n;
+    return size;
+}
+
+size_t libpd_undo_compact(t_canvas* cnv, size_t budget)
+{
+    t_undo* udo = canvas_undo_get(cnv);
+    t_undo_action *a, *next, *head;
+    size_t size;
+
+    if (!udo || !udo->u_queue || udo->u_doing)
+        return 0;
+
+    head = udo->u_queue;
+
+    // Only the actions that can be undone are merged, the redo side is freed by pd once something new is done
+    for (a = head; a && a != udo->u_last; a = next) {
+        next = a->next;
+        if (!next || !undo_is_same_move(a, next) || udo->u_cleanstate == a)
+            continue;
+
+        a->next = next->next;
+        if (a->next)
+            a->next->prev = a;
+        if (udo->u_last == next)
+            udo->u_last = a;
+        if (udo->u_cleanstate == next)
+            udo->u_cleanstate = a;
+
+        undo_free_action(cnv, next);
+        next = a;
+    }
+
+    size = libpd_undo_get_memory(cnv, 0);
+
+    // Drop the oldest actions until it fits, but always keep the last one so it can still be undone
+    // A sequence is dropped as a whole, or not at all when it isn't closed yet
+    while (size > budget) {
+        t_undo_action *first = head->next, *last = first;
+        int depth = 0;
+
+        if (!first || first == udo->u_last)
+            break;
+
+        for (; last && last != udo->u_last; last = last->next) {
+            if (last->type == UNDO_SEQUENCE_START)
+                depth++;
+            else if (last->type == UNDO_SEQUENCE_END)
+                depth--;
+            if (depth <= 0)
+                break;
+        }
+
+        if (!last || last == udo->u_last)
+            break;
+
+        head->next = last->next;
+        last->next->prev = head;
+
+        for (a = first; a; a = next) {
+            next = (a == last) ? 0 : a->next;
+            if (udo->u_cleanstate == a)
+                udo->u_cleanstate = 0;
+
+            size -= undo_action_size(a);
+            undo_free_action(cnv, a);
+        }
+    }
+
+    return size;
+}
+
+/* ------- abstraction reloading -------- */
+
+static int abstraction_is_instance(t_canvas* cnv, t_symbol* name, t_symbol* dir)
+{
+    return canvas_isabstraction(cnv) && cnv->gl_name == name && canvas_getdir(cnv) == dir;
+}
+
+// Reports every canvas that directly contains an instance, instances themselves were just replaced
+static int abstraction_notify_containers(t_canvas* cnv, t_symbol* name, t_symbol* dir)
+{
+    t_gobj* y;
+    int found = 0, contains = 0;
+
+    for (y = cnv->gl_list; y; y = y->g_next) {
+        if (pd_class(&y->g_pd) != canvas_class)
+            continue;
+
+        if (abstraction_is_instance((t_canvas*)y, name, dir))
+            contains++;
+        else
+            found += abstraction_notify_containers((t_canvas*)y, name, dir);
+    }
+
+    if (contains)
+        libpd_object_event(LIBPD_CANVAS_CHANGED, cnv, 0, 0);
+
+    return found + contains;
+}
+
+int libpd_is_inside_abstraction(t_canvas* cnv, t_symbol* name, t_symbol* dir)
+{
+    for (; cnv; cnv = cnv->gl_owner) {
+        if (abstraction_is_instance(cnv, name, dir))
+            return 1;
+    }
+    return 0;
+}
+
+int libpd_reload_abstraction(t_symbol* name, t_symbol* dir)
+{
+    t_canvas* cnv;
+    int found = 0;
+
+    canvas_reload(name, dir, 0);
+
+    for (cnv = pd_getcanvaslist(); cnv; cnv = cnv->gl_next)
+        found += abstraction_notify_containers(cnv, name, dir);
+
+    return found;
+}
+
 // Can probably be used as a general purpose undo action on an object?
 void libpd_undo_apply(t_canvas* cnv, t_gobj* obj)
 {
@@ -737,6 +1277,8 @@ void libpd_moveobj(t_canvas* cnv, t_gobj* obj, int x, int y)
 {
     ((t_object*)obj)->te_xpix = x;
     ((t_object*)obj)->te_ypix = y;
+
+    libpd_object_event(LIBPD_OBJECT_MOVED, cnv, obj, 0);
 }
 
 void libpd_createconnection(t_canvas* cnv, t_object* src, int nout, t_object* sink, int nin)
@@ -767,6 +1309,7 @@ void libpd_removeconnection(t_canvas* cnv, t_object* src, int nout, t_object* si
     }
 
     obj_disconnect(src, nout, sink, nin);
+    libpd_connection_event(LIBPD_CONNECTION_REMOVED, cnv, src, nout, sink, nin);
 
     int dest_i = canvas_getindex(cnv, &(sink->te_g));
     int src_i = canvas_getindex(cnv, &(src->te_g));
@@ -780,6 +1323,320 @@ void libpd_getcontent(t_canvas* cnv, char** buf, int* bufsize)
     t_binbuf* b = binbuf_new();
     libpd_canvas_saveto(cnv, b);
     binbuf_gettext(b, buf, bufsize);
+    binbuf_free(b);
+}
+
+void libpd_binbuf_settext(t_binbuf* b, char const* buf, size_t bufsize)
+{
+    // binbuf_text clears b and parses straight into it, so no intermediate binbuf is needed
+    binbuf_text(b, buf, (int)bufsize);
+}
+
+/* same output as binbuf_gettext, but written into a buffer that the caller keeps between calls */
+int libpd_binbuf_gettext(t_binbuf const* b, char** buf, int* bufsize)
+{
+    char string[MAXPDSTRING];
+    t_atom const* ap = binbuf_getvec(b);
+    int natom = binbuf_getnatom(b);
+    int length = 0;
+
+    for (; natom--; ap++) {
+        int atomlength, needed;
+        if ((ap->a_type == A_SEMI || ap->a_type == A_COMMA) && length && (*buf)[length - 1] == ' ')
+            length--;
+
+        atom_string(ap, string, MAXPDSTRING);
+        atomlength = (int)strlen(string);
+
+        // room for the atom, its separator and the terminator
+        needed = length + atomlength + 2;
+        if (needed > *bufsize) {
+            int newsize = *bufsize > 64 ? *bufsize : 64;
+            while (newsize < needed)
+                newsize *= 2;
+
+            char* newbuf = resizebytes(*buf, *bufsize, newsize);
+            if (!newbuf)
+                break;
+
+            *buf = newbuf;
+            *bufsize = newsize;
+        }
+
+        memcpy(*buf + length, string, atomlength);
+        length += atomlength;
+        (*buf)[length++] = ap->a_type == A_SEMI ? '\n' : ' ';
+    }
+
+    if (length && (*buf)[length - 1] == ' ')
+        length--;
+
+    if (*buf)
+        (*buf)[length] = 0;
+
+    return length;
+}
+
+/* binary form of a binbuf: "PDB", the size of t_float, the symbols, then the atoms
+   integers are 32 bit little endian, floats are stored with their bits as an integer of the same size */
+
+enum {
+    BINBUF_FLOAT,
+    BINBUF_SYMBOL,
+    BINBUF_SEMI,
+    BINBUF_COMMA,
+    BINBUF_DOLLAR,
+    BINBUF_DOLLSYM
+};
+
+typedef struct _binwriter {
+    char* w_buf;
+    size_t w_size;
+    size_t w_capacity;
+} t_binwriter;
+
+static void binwriter_put(t_binwriter* w, void const* data, size_t n)
+{
+    if (w->w_size + n > w->w_capacity) {
+        size_t newcapacity = w->w_capacity > 256 ? w->w_capacity : 256;
+        while (newcapacity < w->w_size + n)
+            newcapacity *= 2;
+
+        w->w_buf = resizebytes(w->w_buf, w->w_capacity, newcapacity);
+        w->w_capacity = newcapacity;
+    }
+    memcpy(w->w_buf + w->w_size, data, n);
+    w->w_size += n;
+}
+
+static void binwriter_put_u32(t_binwriter* w, uint32_t v)
+{
+    unsigned char bytes[4] = { v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, (v >> 24) & 0xff };
+    binwriter_put(w, bytes, 4);
+}
+
+static uint32_t binreader_get_u32(unsigned char const* p)
+{
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void binwriter_put_float(t_binwriter* w, t_float f)
+{
+#if PD_FLOATSIZE == 64
+    uint64_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    binwriter_put_u32(w, (uint32_t)bits);
+    binwriter_put_u32(w, (uint32_t)(bits >> 32));
+#else
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    binwriter_put_u32(w, bits);
+#endif
+}
+
+static t_float binreader_get_float(unsigned char const* p)
+{
+    t_float f;
+#if PD_FLOATSIZE == 64
+    uint64_t bits = binreader_get_u32(p) | ((uint64_t)binreader_get_u32(p + 4) << 32);
+#else
+    uint32_t bits = binreader_get_u32(p);
+#endif
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+/* index of every symbol in the table, open addressing on the symbol pointer */
+typedef struct _symtable {
+    t_symbol** t_keys;
+    uint32_t* t_indices;
+    size_t t_capacity;
+    t_symbol** t_symbols;
+    uint32_t t_nsymbols;
+} t_symtable;
+
+static uint32_t symtable_index(t_symtable* t, t_symbol* s)
+{
+    size_t slot = (((uintptr_t)s >> 4) * 2654435761u) & (t->t_capacity - 1);
+    while (t->t_keys[slot] && t->t_keys[slot] != s)
+        slot = (slot + 1) & (t->t_capacity - 1);
+
+    if (!t->t_keys[slot]) {
+        t->t_keys[slot] = s;
+        t->t_indices[slot] = t->t_nsymbols;
+        t->t_symbols[t->t_nsymbols++] = s;
+    }
+    return t->t_indices[slot];
+}
+
+void libpd_binbuf_getbinary(t_binbuf const* b, char** buf, int* bufsize)
+{
+    t_atom const* vec = binbuf_getvec(b);
+    int natom = binbuf_getnatom(b), i;
+    t_binwriter w = { 0, 0, 0 };
+    t_symtable t;
+    char header[4] = { 'P', 'D', 'B', (char)sizeof(t_float) };
+
+    t.t_capacity = 16;
+    while (t.t_capacity < (size_t)natom * 2)
+        t.t_capacity *= 2;
+    t.t_keys = getbytes(t.t_capacity * sizeof(t_symbol*));
+    t.t_indices = getbytes(t.t_capacity * sizeof(uint32_t));
+    t.t_symbols = getbytes((natom + 1) * sizeof(t_symbol*));
+    t.t_nsymbols = 0;
+
+    for (i = 0; i < natom; i++) {
+        if (vec[i].a_type == A_SYMBOL || vec[i].a_type == A_DOLLSYM)
+            symtable_index(&t, vec[i].a_w.w_symbol);
+    }
+
+    binwriter_put(&w, header, 4);
+    binwriter_put_u32(&w, t.t_nsymbols);
+    for (i = 0; i < (int)t.t_nsymbols; i++) {
+        size_t length = strlen(t.t_symbols[i]->s_name);
+        binwriter_put_u32(&w, (uint32_t)length);
+        binwriter_put(&w, t.t_symbols[i]->s_name, length);
+    }
+
+    binwriter_put_u32(&w, (uint32_t)natom);
+    for (i = 0; i < natom; i++) {
+        unsigned char type;
+        switch (vec[i].a_type) {
+        case A_FLOAT:
+            type = BINBUF_FLOAT;
+            binwriter_put(&w, &type, 1);
+            binwriter_put_float(&w, vec[i].a_w.w_float);
+            break;
+        case A_SYMBOL:
+        case A_DOLLSYM:
+            type = vec[i].a_type == A_SYMBOL ? BINBUF_SYMBOL : BINBUF_DOLLSYM;
+            binwriter_put(&w, &type, 1);
+            binwriter_put_u32(&w, symtable_index(&t, vec[i].a_w.w_symbol));
+            break;
+        case A_DOLLAR:
+            type = BINBUF_DOLLAR;
+            binwriter_put(&w, &type, 1);
+            binwriter_put_u32(&w, (uint32_t)vec[i].a_w.w_index);
+            break;
+        case A_COMMA:
+            type = BINBUF_COMMA;
+            binwriter_put(&w, &type, 1);
+            break;
+        default:
+            type = BINBUF_SEMI;
+            binwriter_put(&w, &type, 1);
+            break;
+        }
+    }
+
+    freebytes(t.t_keys, t.t_capacity * sizeof(t_symbol*));
+    freebytes(t.t_indices, t.t_capacity * sizeof(uint32_t));
+    freebytes(t.t_symbols, (natom + 1) * sizeof(t_symbol*));
+
+    /* shrink to fit, so the caller can free it with the size it got */
+    *buf = resizebytes(w.w_buf, w.w_capacity, w.w_size);
+    *bufsize = (int)w.w_size;
+}
+
+int libpd_binbuf_setbinary(t_binbuf* b, char const* buf, size_t bufsize)
+{
+    unsigned char const* p = (unsigned char const*)buf;
+    unsigned char const* end = p + bufsize;
+    t_symbol** symbols = 0;
+    t_atom* atoms = 0;
+    uint32_t nsymbols = 0, natom = 0, i;
+    int ok = 0;
+
+    if (bufsize < 12 || memcmp(p, "PDB", 3) || p[3] != sizeof(t_float))
+        return 0;
+    p += 4;
+
+    nsymbols = binreader_get_u32(p);
+    p += 4;
+    if (nsymbols > (size_t)(end - p) / 4)
+        return 0;
+
+    symbols = getbytes((nsymbols + 1) * sizeof(t_symbol*));
+    for (i = 0; i < nsymbols; i++) {
+        uint32_t length;
+        char* name;
+
+        if (end - p < 4)
+            goto done;
+        length = binreader_get_u32(p);
+        p += 4;
+        if (length > (size_t)(end - p))
+            goto done;
+
+        name = getbytes(length + 1);
+        memcpy(name, p, length);
+        symbols[i] = gensym(name);
+        freebytes(name, length + 1);
+        p += length;
+    }
+
+    if (end - p < 4)
+        goto done;
+    natom = binreader_get_u32(p);
+    p += 4;
+    if (natom > (size_t)(end - p))
+        goto done;
+
+    atoms = getbytes((natom + 1) * sizeof(t_atom));
+    for (i = 0; i < natom; i++) {
+        unsigned char type = *p++;
+        size_t payload = type == BINBUF_FLOAT ? sizeof(t_float) : (type == BINBUF_SEMI || type == BINBUF_COMMA) ? 0 : 4;
+        uint32_t index;
+
+        if ((size_t)(end - p) < payload)
+            goto done;
+
+        switch (type) {
+        case BINBUF_FLOAT:
+            SETFLOAT(atoms + i, binreader_get_float(p));
+            break;
+        case BINBUF_SYMBOL:
+        case BINBUF_DOLLSYM:
+            index = binreader_get_u32(p);
+            if (index >= nsymbols)
+                goto done;
+            if (type == BINBUF_SYMBOL)
+                SETSYMBOL(atoms + i, symbols[index]);
+            else
+                SETDOLLSYM(atoms + i, symbols[index]);
+            break;
+        case BINBUF_DOLLAR:
+            SETDOLLAR(atoms + i, (int)binreader_get_u32(p));
+            break;
+        case BINBUF_COMMA:
+            SETCOMMA(atoms + i);
+            break;
+        case BINBUF_SEMI:
+            SETSEMI(atoms + i);
+            break;
+        default:
+            goto done;
+        }
+        p += payload;
+    }
+
+    binbuf_clear(b);
+    binbuf_add(b, (int)natom, atoms);
+    ok = 1;
+
+done:
+    freebytes(symbols, (nsymbols + 1) * sizeof(t_symbol*));
+    if (atoms)
+        freebytes(atoms, (natom + 1) * sizeof(t_atom));
+    return ok;
+}
+
+void libpd_getcontent_binary(t_canvas* cnv, char** buf, int* bufsize)
+{
+    t_binbuf* b = binbuf_new();
+    libpd_canvas_saveto(cnv, b);
+    libpd_binbuf_getbinary(b, buf, bufsize);
+    binbuf_free(b);
 }
 
 typedef t_pd* (*t_newgimme)(t_symbol* s, int argc, t_atom* argv);
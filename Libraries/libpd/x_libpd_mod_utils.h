@@ -15,6 +15,29 @@ extern "C" {
 #include <z_libpd.h>
 #include <g_canvas.h>
 
+// Structural changes made through these functions are reported as events
+// Changes that are too involved to describe, like undo and redo, are reported as LIBPD_CANVAS_CHANGED
+typedef enum _libpd_canvas_event_type {
+    LIBPD_OBJECT_CREATED,
+    LIBPD_OBJECT_DELETED,
+    LIBPD_OBJECT_MOVED,
+    LIBPD_OBJECT_RETYPED,
+    LIBPD_CONNECTION_ADDED,
+    LIBPD_CONNECTION_REMOVED,
+    LIBPD_CANVAS_CHANGED
+} t_libpd_canvas_event_type;
+
+typedef struct _libpd_canvas_event {
+    t_libpd_canvas_event_type type;
+    t_canvas* canvas;
+    t_gobj* object;   // the new object when retyped
+    t_gobj* previous; // the object it replaced when retyped
+    t_object* src;    // connection events only
+    int nout;
+    t_object* sink;
+    int nin;
+} t_libpd_canvas_event;
+
 t_pd* libpd_newest(t_canvas* cnv);
 
 t_pd* libpd_createobj(t_canvas* cnv, t_symbol* s, int argc, t_atom* argv);
@@ -29,11 +52,41 @@ void libpd_moveobj(t_canvas* cnv, t_gobj* obj, int x, int y);
 char const* libpd_copy(t_canvas* cnv, int* size);
 void libpd_paste(t_canvas* cnv, char const*);
 
+// What was last copied in this instance, in binary form (see libpd_binbuf_getbinary). Free it with freebytes
+// The binary form doesn't depend on the instance, so what one instance copied can be pasted in another
+void libpd_copy_binary(char** buf, int* bufsize);
+
+// Same as libpd_paste, from the binary form. Returns 0 if buf isn't valid, nothing is pasted then
+int libpd_paste_binary(t_canvas* cnv, char const* buf, size_t bufsize);
+
 void libpd_duplicate(t_canvas* x);
 
+// A connection between an object in the selection and one outside of it, which becomes an [inlet] or [outlet]
+typedef struct _libpd_encapsulate_edge {
+    int is_inlet; // an [inlet] when the connection comes in from outside
+    int is_signal;
+    int x, y;   // where the [inlet] or [outlet] goes in the subpatch
+    int object; // the object inside, by its position among the selected objects in the patch
+    int iolet;  // its inlet or outlet
+} t_libpd_encapsulate_edge;
+
+// A connection from outside to one of the edges, it connects to the subpatch instead
+typedef struct _libpd_encapsulate_connection {
+    int edge;
+    t_object* object;
+    int iolet;
+} t_libpd_encapsulate_connection;
+
+// Moves the selection into a new [pd] subpatch at x, y and connects that in its place, in one undo step
+// Goes through pd's copy and paste in binary form, so it keeps everything pd's copy keeps. The DSP graph
+// is only rebuilt once. Returns the subpatch, or NULL when nothing is selected
+t_gobj* libpd_encapsulate(t_canvas* cnv, int x, int y, t_libpd_encapsulate_edge const* edges, int nedges,
+    t_libpd_encapsulate_connection const* connections, int nconnections);
+
 void libpd_undo(t_canvas* cnv);
 void libpd_redo(t_canvas* cnv);
 
+// The DSP graph isn't rebuilt between the start and end of an undo sequence
 void libpd_start_undo_sequence(t_canvas* cnv, char const* name);
 void libpd_end_undo_sequence(t_canvas* cnv, char const* name);
 
@@ -47,6 +100,25 @@ void libpd_createconnection(t_canvas* cnv, t_object* src, int nout, t_object* si
 void libpd_removeconnection(t_canvas* cnv, t_object* src, int nout, t_object* sink, int nin);
 
 void libpd_getcontent(t_canvas* cnv, char** buf, int* bufsize);
+
+// Replaces the contents of b with the atoms parsed from UTF-8 text, in one pass
+void libpd_binbuf_settext(t_binbuf* b, char const* buf, size_t bufsize);
+
+// Writes b as text into *buf, growing it when needed so it can be reused between calls
+// *bufsize is the capacity of *buf, free it with freebytes. Returns the length of the text
+int libpd_binbuf_gettext(t_binbuf const* b, char** buf, int* bufsize);
+
+// Compact binary form of a binbuf, a table of the symbols it uses followed by the packed atoms
+// Going to and from pd's text through a binbuf loses nothing, so it can always be turned into a .pd file
+// Writes the binary form of b into a new buffer, free it with freebytes
+void libpd_binbuf_getbinary(t_binbuf const* b, char** buf, int* bufsize);
+
+// Replaces the contents of b with the atoms in buf. Returns 0 if buf isn't valid, b is left alone then
+int libpd_binbuf_setbinary(t_binbuf* b, char const* buf, size_t bufsize);
+
+// Same as libpd_getcontent, in binary form
+void libpd_getcontent_binary(t_canvas* cnv, char** buf, int* bufsize);
+
 void libpd_savetofile(t_canvas* cnv, t_symbol* filename, t_symbol* dir);
 
 int libpd_type_exists(char const* type);
@@ -58,8 +130,27 @@ int libpd_ninlets(t_object const* x);
 int libpd_can_undo(t_canvas* cnv);
 int libpd_can_redo(t_canvas* cnv);
 
+// Size of the undo history of a canvas in bytes, as far as pd knows the size of it
+size_t libpd_undo_get_memory(t_canvas* cnv, int* nactions);
+
+// Merges moves in a row of the same objects into one action, then drops the oldest actions until the
+// history fits in budget bytes. Returns the size of the history afterwards
+size_t libpd_undo_compact(t_canvas* cnv, size_t budget);
+
+// Changes with every edit, undo and redo in cnv or its subpatches, so it can be told cheaply whether cnv changed
+// since it was last seen. Changes that pd doesn't keep undo for, like the contents of arrays, aren't noticed
+size_t libpd_undo_get_position(t_canvas* cnv);
+
 void libpd_undo_apply(t_canvas* cnv, t_gobj* obj);
 
+// Whether cnv is an instance of the abstraction in file dir/name, or is inside one
+int libpd_is_inside_abstraction(t_canvas* cnv, t_symbol* name, t_symbol* dir);
+
+// Reopens every instance of the abstraction in file dir/name in place, keeping its connections, like pd does
+// after saving an abstraction. Instances are freed, so no canvas inside one may be in use. The canvases that
+// contain an instance get a LIBPD_CANVAS_CHANGED event. Returns the number of instances
+int libpd_reload_abstraction(t_symbol* name, t_symbol* dir);
+
 int libpd_issignalinlet(t_object const* x, int m);
 int libpd_issignaloutlet(t_object const* x, int m);
 
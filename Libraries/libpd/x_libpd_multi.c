@@ -12,6 +12,15 @@
 #include <string.h>
 #include <assert.h>
 #include "x_libpd_multi.h"
+#include "x_libpd_parallel.h"
+#include "x_libpd_abscache.h"
+#include "x_libpd_libpaths.h"
+#include "x_libpd_param.h"
+#include "x_libpd_bus.h"
+#include "x_libpd_sharedarray.h"
+#include "x_libpd_fuse.h"
+#include "x_libpd_diskrec.h"
+#include "x_libpd_tableload.h"
 
 
 static t_class* libpd_multi_receiver_class;
@@ -31,31 +40,31 @@ typedef struct _libpd_multi_receiver {
 static void libpd_multi_receiver_bang(t_libpd_multi_receiver* x)
 {
     if (x->x_hook_bang)
-        x->x_hook_bang(x->x_ptr, x->x_sym->s_name);
+        x->x_hook_bang(x->x_ptr, x->x_sym);
 }
 
 static void libpd_multi_receiver_float(t_libpd_multi_receiver* x, t_float f)
 {
     if (x->x_hook_float)
-        x->x_hook_float(x->x_ptr, x->x_sym->s_name, f);
+        x->x_hook_float(x->x_ptr, x->x_sym, f);
 }
 
 static void libpd_multi_receiver_symbol(t_libpd_multi_receiver* x, t_symbol* s)
 {
     if (x->x_hook_symbol)
-        x->x_hook_symbol(x->x_ptr, x->x_sym->s_name, s->s_name);
+        x->x_hook_symbol(x->x_ptr, x->x_sym, s);
 }
 
 static void libpd_multi_receiver_list(t_libpd_multi_receiver* x, t_symbol* s, int argc, t_atom* argv)
 {
     if (x->x_hook_list)
-        x->x_hook_list(x->x_ptr, x->x_sym->s_name, argc, argv);
+        x->x_hook_list(x->x_ptr, x->x_sym, argc, argv);
 }
 
 static void libpd_multi_receiver_anything(t_libpd_multi_receiver* x, t_symbol* s, int argc, t_atom* argv)
 {
     if (x->x_hook_message)
-        x->x_hook_message(x->x_ptr, x->x_sym->s_name, s->s_name, argc, argv);
+        x->x_hook_message(x->x_ptr, x->x_sym, s, argc, argv);
 }
 
 static void libpd_multi_receiver_free(t_libpd_multi_receiver* x)
@@ -83,20 +92,19 @@ void* libpd_multi_receiver_new(void* ptr, char const* s,
     t_libpd_multi_listhook hook_list,
     t_libpd_multi_messagehook hook_message)
 {
-
+    sys_lock();
     t_libpd_multi_receiver* x = (t_libpd_multi_receiver*)pd_new(libpd_multi_receiver_class);
     if (x) {
-        sys_lock();
         x->x_sym = gensym(s);
-        sys_unlock();
-        pd_bind(&x->x_obj.ob_pd, x->x_sym);
         x->x_ptr = ptr;
         x->x_hook_bang = hook_bang;
         x->x_hook_float = hook_float;
         x->x_hook_symbol = hook_symbol;
         x->x_hook_list = hook_list;
         x->x_hook_message = hook_message;
+        pd_bind(&x->x_obj.ob_pd, x->x_sym);
     }
+    sys_unlock();
     return x;
 }
 
@@ -1218,6 +1226,15 @@ void libpd_multi_init(void)
         libpd_multi_receiver_setup();
         libpd_multi_midi_setup();
         libpd_multi_print_setup();
+        libpd_parallel_setup();
+        libpd_abscache_setup();
+        libpd_libpaths_setup();
+        libpd_param_setup();
+        libpd_bus_setup();
+        libpd_sharedarray_setup();
+        libpd_fuse_setup();
+        libpd_diskrec_setup();
+        libpd_tableload_setup();
         libpd_defaultfont_init();
         libpd_set_verbose(4);
 
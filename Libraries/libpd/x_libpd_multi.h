@@ -16,12 +16,14 @@ void libpd_multi_init(void);
 void libpd_init_else(void);
 void libpd_init_cyclone(void);
 
-typedef void (*t_libpd_multi_banghook)(void* ptr, char const* recv);
-typedef void (*t_libpd_multi_floathook)(void* ptr, char const* recv, float f);
-typedef void (*t_libpd_multi_symbolhook)(void* ptr, char const* recv, char const* s);
-typedef void (*t_libpd_multi_listhook)(void* ptr, char const* recv, int argc, t_atom* argv);
-typedef void (*t_libpd_multi_messagehook)(void* ptr, char const* recv, char const* msg, int argc, t_atom* argv);
-
+// The receiver and the symbols are passed as pd's symbols, so they can be told apart by their pointer
+typedef void (*t_libpd_multi_banghook)(void* ptr, t_symbol* recv);
+typedef void (*t_libpd_multi_floathook)(void* ptr, t_symbol* recv, float f);
+typedef void (*t_libpd_multi_symbolhook)(void* ptr, t_symbol* recv, t_symbol* s);
+typedef void (*t_libpd_multi_listhook)(void* ptr, t_symbol* recv, int argc, t_atom* argv);
+typedef void (*t_libpd_multi_messagehook)(void* ptr, t_symbol* recv, t_symbol* msg, int argc, t_atom* argv);
+
+// Binds to s in the current instance, takes pd's lock, free it with pd_free while holding the lock
 void* libpd_multi_receiver_new(void* ptr, char const* s,
     t_libpd_multi_banghook hook_bang,
     t_libpd_multi_floathook hook_float,
@@ -0,0 +1,674 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <string.h>
+
+#include <m_pd.h>
+#include <m_imp.h>
+#include <g_canvas.h>
+
+#include "x_libpd_parallel.h"
+
+// False CLONE, keep in sync with Source/Objects/CloneObject.h
+typedef struct _fake_copy {
+    t_glist* c_gl;
+    int c_on;
+} t_fake_copy;
+
+typedef struct _fake_in {
+    t_class* i_pd;
+    struct _fake_clone* i_owner;
+    int i_signal;
+    int i_n;
+} t_fake_in;
+
+typedef struct _fake_out {
+    t_class* o_pd;
+    t_outlet* o_outlet;
+    int o_signal;
+    int o_n;
+} t_fake_out;
+
+typedef struct _fake_clone {
+    t_object x_obj;
+    int x_n;
+    t_fake_copy* x_vec;
+    int x_nin;
+    t_fake_in* x_invec;
+    int x_nout;
+    t_fake_out** x_outvec;
+    t_symbol* x_s;
+    int x_argc;
+    t_atom* x_argv;
+    int x_phase;
+    int x_startvoice;
+    int x_suppressvoice;
+} t_fake_clone;
+
+// False INSTANCEUGEN, mirrors struct _instanceugen in d_ugen.c
+#define MAXLOGSIG 32
+
+typedef struct _fake_instanceugen {
+    t_int* u_dspchain;
+    int u_dspchainsize;
+    t_signal* u_signals;
+    t_signal* u_freelist[MAXLOGSIG + 1];
+    t_signal* u_freeborrowed;
+    int u_phase;
+    int u_loud;
+    void* u_context;
+} t_fake_instanceugen;
+
+// DSP state of a clone that was created with -parallel
+typedef struct _clone_voices {
+    t_fake_clone* v_owner;
+    struct _parallel_context* v_context;
+    t_pdinstance* v_instance;
+    int v_n;
+    t_int** v_chains;
+    int* v_chainsizes;
+    struct _clone_voices* v_next;
+} t_clone_voices;
+
+// A subpatch that was created with -parallel, and runs concurrently with its siblings
+typedef struct _parallel_subpatch {
+    t_canvas* s_owner;
+    struct _parallel_group* s_group;
+    t_int* s_chain;
+    int s_chainsize;
+    struct _parallel_subpatch* s_next;
+} t_parallel_subpatch;
+
+// The parallel subpatches inside one canvas, they all run when the first one is reached in the DSP chain
+typedef struct _parallel_group {
+    t_canvas* g_parent;
+    struct _parallel_context* g_context;
+    t_pdinstance* g_instance;
+    t_parallel_subpatch** g_members;
+    int g_n;
+    int g_seen; // members whose place in the DSP chain was passed in this tick
+    struct _parallel_group* g_next;
+} t_parallel_group;
+
+// Per instance state, bound to a symbol since symbols are local to each pd instance
+typedef struct _parallel_context {
+    t_pd x_pd;
+    void* x_executor;
+    t_libpd_parallel_executor x_run;
+    t_clone_voices* x_clones;
+    t_parallel_subpatch* x_subpatches;
+    t_parallel_group* x_groups;
+    int x_running; // the executor doesn't run tasks from within its own tasks
+} t_parallel_context;
+
+static t_class* parallel_context_class;
+static t_class* parallel_clone_class;
+static t_method parallel_clone_freemethod;
+static t_method parallel_canvas_freemethod;
+
+static t_symbol* parallel_context_symbol(void)
+{
+    return gensym("#plugdata_parallel");
+}
+
+static t_parallel_context* parallel_context_get(int create)
+{
+    t_parallel_context* x = (t_parallel_context*)pd_findbyclass(parallel_context_symbol(), parallel_context_class);
+    if (!x && create) {
+        x = (t_parallel_context*)pd_new(parallel_context_class);
+        x->x_executor = 0;
+        x->x_run = 0;
+        x->x_clones = 0;
+        x->x_subpatches = 0;
+        x->x_groups = 0;
+        x->x_running = 0;
+        pd_bind(&x->x_pd, parallel_context_symbol());
+    }
+    return x;
+}
+
+static t_clone_voices* clone_voices_find(t_parallel_context* ctx, t_fake_clone* owner)
+{
+    t_clone_voices* v;
+    for (v = ctx->x_clones; v; v = v->v_next) {
+        if (v->v_owner == owner)
+            return v;
+    }
+    return 0;
+}
+
+static void clone_voices_clear(t_clone_voices* v)
+{
+    int i;
+    for (i = 0; i < v->v_n; i++)
+        freebytes(v->v_chains[i], v->v_chainsizes[i] * sizeof(t_int));
+
+    if (v->v_n) {
+        freebytes(v->v_chains, v->v_n * sizeof(*v->v_chains));
+        freebytes(v->v_chainsizes, v->v_n * sizeof(*v->v_chainsizes));
+    }
+
+    v->v_chains = 0;
+    v->v_chainsizes = 0;
+    v->v_n = 0;
+}
+
+static void clone_voices_run(void* data, int index)
+{
+    t_clone_voices* v = (t_clone_voices*)data;
+    t_int* ip = v->v_chains[index];
+
+    // perform routines may look up the current instance
+    pd_setinstance(v->v_instance);
+
+    while (ip)
+        ip = (*(t_perfroutine)(*ip))(ip);
+}
+
+static t_int* clone_voices_perform(t_int* w)
+{
+    t_clone_voices* v = (t_clone_voices*)(w[1]);
+    t_parallel_context* ctx = v->v_context;
+    int i;
+
+    if (ctx->x_run && !ctx->x_running) {
+        ctx->x_running = 1;
+        ctx->x_run(ctx->x_executor, clone_voices_run, v, v->v_n);
+        ctx->x_running = 0;
+    } else {
+        for (i = 0; i < v->v_n; i++)
+            clone_voices_run(v, i);
+    }
+
+    return (w + 2);
+}
+
+static void signal_list_append(t_signal** list, t_signal* tail)
+{
+    while (*list)
+        list = &(*list)->s_nextfree;
+    *list = tail;
+}
+
+// Moves all reusable signals out of pd's free lists,
+// so buffers that one copy is done with can't be handed to the next copy
+static void parallel_stash_signals(t_fake_instanceugen* ugen, t_signal** freelist, t_signal** freeborrowed)
+{
+    int i;
+    for (i = 0; i <= MAXLOGSIG; i++) {
+        signal_list_append(&freelist[i], ugen->u_freelist[i]);
+        ugen->u_freelist[i] = 0;
+    }
+    signal_list_append(freeborrowed, ugen->u_freeborrowed);
+    ugen->u_freeborrowed = 0;
+}
+
+static void parallel_restore_signals(t_fake_instanceugen* ugen, t_signal** freelist, t_signal* freeborrowed)
+{
+    int i;
+    for (i = 0; i <= MAXLOGSIG; i++)
+        signal_list_append(&ugen->u_freelist[i], freelist[i]);
+    signal_list_append(&ugen->u_freeborrowed, freeborrowed);
+}
+
+static void clone_serial_dsp(t_fake_clone* x, t_signal** sp)
+{
+    t_gotfn fn = zgetfn(&x->x_obj.ob_pd, gensym("dsp_aliased"));
+    if (fn)
+        (*(void (*)(t_fake_clone*, t_signal**))fn)(x, sp);
+}
+
+static int canvas_is_independent(t_canvas* x);
+
+static void clone_parallel_dsp(t_fake_clone* x, t_signal** sp)
+{
+    t_parallel_context* ctx = parallel_context_get(0);
+    t_clone_voices* v = ctx ? clone_voices_find(ctx, x) : 0;
+    t_fake_instanceugen* ugen = (t_fake_instanceugen*)pd_this->pd_ugen;
+    t_signal* freelist[MAXLOGSIG + 1] = { 0 };
+    t_signal* freeborrowed = 0;
+    t_signal **io, **outs;
+    t_int *mainchain, done;
+    int i, j, nin, nout, mainchainsize;
+
+    // the previous chains were only referenced by the DSP chain pd just freed
+    if (v)
+        clone_voices_clear(v);
+
+    if (!v || x->x_n < 2) {
+        clone_serial_dsp(x, sp);
+        return;
+    }
+
+    for (i = nin = 0; i < x->x_nin; i++) {
+        if (x->x_invec[i].i_signal)
+            nin++;
+    }
+    for (i = nout = 0; i < x->x_nout; i++) {
+        if (x->x_outvec[0][i].o_signal)
+            nout++;
+    }
+
+    // let the original method report copies that are being edited, and run copies that
+    // might share state with each other or with the rest of the patch one after the other
+    for (j = 0; j < x->x_n; j++) {
+        t_object* copy = &x->x_vec[j].c_gl->gl_obj;
+        if (obj_ninlets(copy) != x->x_nin || obj_noutlets(copy) != x->x_nout || obj_nsiginlets(copy) != nin || obj_nsigoutlets(copy) != nout
+            || !canvas_is_independent(x->x_vec[j].c_gl)) {
+            clone_serial_dsp(x, sp);
+            return;
+        }
+    }
+
+    io = (t_signal**)getbytes((nin + nout) * sizeof(*io));
+    outs = (t_signal**)getbytes(x->x_n * nout * sizeof(*outs));
+
+    v->v_n = x->x_n;
+    v->v_instance = pd_this;
+    v->v_chains = (t_int**)getbytes(v->v_n * sizeof(*v->v_chains));
+    v->v_chainsizes = (int*)getbytes(v->v_n * sizeof(*v->v_chainsizes));
+
+    // every copy takes a reference to the inputs
+    for (i = 0; i < nin; i++)
+        sp[i]->s_refcount += x->x_n - 1;
+
+    // compile each copy into a chain of its own, which ends with pd's dsp_done
+    mainchain = ugen->u_dspchain;
+    mainchainsize = ugen->u_dspchainsize;
+    done = mainchain[mainchainsize - 1];
+
+    for (j = 0; j < x->x_n; j++) {
+        for (i = 0; i < nin; i++)
+            io[i] = sp[i];
+        for (i = 0; i < nout; i++)
+            io[nin + i] = outs[j * nout + i] = signal_newfromcontext(1);
+
+        ugen->u_dspchain = (t_int*)getbytes(sizeof(t_int));
+        ugen->u_dspchain[0] = done;
+        ugen->u_dspchainsize = 1;
+
+        mess1(&x->x_vec[j].c_gl->gl_pd, gensym("dsp"), io);
+
+        v->v_chains[j] = ugen->u_dspchain;
+        v->v_chainsizes[j] = ugen->u_dspchainsize;
+
+        parallel_stash_signals(ugen, freelist, &freeborrowed);
+    }
+
+    ugen->u_dspchain = mainchain;
+    ugen->u_dspchainsize = mainchainsize;
+    parallel_restore_signals(ugen, freelist, freeborrowed);
+
+    dsp_add(clone_voices_perform, 1, v);
+
+    // sum the outputs in voice order once all copies are done
+    for (i = 0; i < nout; i++) {
+        t_signal* out = sp[nin + i];
+        dsp_add_copy(outs[i]->s_vec, out->s_vec, out->s_n);
+        for (j = 1; j < x->x_n; j++)
+            dsp_add_plus(outs[j * nout + i]->s_vec, out->s_vec, out->s_vec, out->s_n);
+    }
+
+    for (i = 0; i < x->x_n * nout; i++)
+        signal_makereusable(outs[i]);
+
+    freebytes(io, (nin + nout) * sizeof(*io));
+    freebytes(outs, x->x_n * nout * sizeof(*outs));
+}
+
+static void clone_parallel_free(t_fake_clone* x)
+{
+    t_parallel_context* ctx = parallel_context_get(0);
+    if (ctx) {
+        t_clone_voices** v;
+        for (v = &ctx->x_clones; *v; v = &(*v)->v_next) {
+            if ((*v)->v_owner == x) {
+                t_clone_voices* found = *v;
+                *v = found->v_next;
+                clone_voices_clear(found);
+                freebytes(found, sizeof(*found));
+                break;
+            }
+        }
+    }
+
+    if (parallel_clone_freemethod)
+        (*(void (*)(t_fake_clone*))parallel_clone_freemethod)(x);
+}
+
+// Wraps pd's clone creator, strips our flag before the original parses the arguments
+static void* clone_parallel_new(t_symbol* s, int argc, t_atom* argv)
+{
+    t_atom* args = (t_atom*)getbytes((argc ? argc : 1) * sizeof(t_atom));
+    int i, nargs = 0, parallel = 0, flags = 1;
+    t_pd* x;
+
+    for (i = 0; i < argc; i++) {
+        if (flags && argv[i].a_type == A_SYMBOL && !strcmp(argv[i].a_w.w_symbol->s_name, "-parallel")) {
+            parallel = 1;
+            continue;
+        }
+        if (argv[i].a_type != A_SYMBOL || argv[i].a_w.w_symbol->s_name[0] != '-')
+            flags = 0;
+        args[nargs++] = argv[i];
+    }
+
+    pd_typedmess(&pd_objectmaker, gensym("clone_aliased"), nargs, args);
+    x = pd_newest();
+
+    freebytes(args, (argc ? argc : 1) * sizeof(t_atom));
+
+    if (x && parallel && pd_class(x) == parallel_clone_class) {
+        t_parallel_context* ctx = parallel_context_get(1);
+        t_clone_voices* v = (t_clone_voices*)getbytes(sizeof(*v));
+        v->v_owner = (t_fake_clone*)x;
+        v->v_context = ctx;
+        v->v_instance = pd_this;
+        v->v_next = ctx->x_clones;
+        ctx->x_clones = v;
+    }
+
+    return x;
+}
+
+// Only subpatches typed as [pd name -parallel]
+static int canvas_is_parallel(t_canvas* x)
+{
+    t_binbuf* b = x->gl_obj.te_binbuf;
+    int i, n = b ? binbuf_getnatom(b) : 0;
+    t_atom* vec = b ? binbuf_getvec(b) : 0;
+
+    if (!n || vec[0].a_type != A_SYMBOL || strcmp(vec[0].a_w.w_symbol->s_name, "pd"))
+        return 0;
+
+    for (i = 1; i < n; i++) {
+        if (vec[i].a_type == A_SYMBOL && !strcmp(vec[i].a_w.w_symbol->s_name, "-parallel"))
+            return 1;
+    }
+    return 0;
+}
+
+// Signal objects whose routines only touch their own state and signals. Any other signal object,
+// including every external, keeps the subpatch serial, since it might share state with the rest of the patch
+static char const* parallel_pure_classes[] = {
+    "inlet", "outlet", "block~", "switch~",
+    "+~", "-~", "*~", "/~", "max~", "min~", "clip~", "wrap~", "abs~", "sqrt~", "rsqrt~",
+    "exp~", "log~", "pow~", "mtof~", "ftom~", "dbtorms~", "rmstodb~", "dbtopow~", "powtodb~",
+    "sig~", "line~", "osc~", "cos~", "phasor~", "noise~", "samphold~", "lrshift~",
+    "lop~", "hip~", "bp~", "vcf~", "biquad~", "slop~", "bob~",
+    "rpole~", "rzero~", "rzero_rev~", "cpole~", "czero~", "czero_rev~",
+    "fft~", "ifft~", "rfft~", "rifft~", 0
+};
+
+static int canvas_is_independent(t_canvas* x)
+{
+    t_symbol* dsp = gensym("dsp");
+    t_gobj* y;
+    int i;
+
+    for (y = x->gl_list; y; y = y->g_next) {
+        char const* name = class_getname(pd_class(&y->g_pd));
+
+        if (pd_class(&y->g_pd) == canvas_class) {
+            if (!canvas_is_independent((t_canvas*)y))
+                return 0;
+            continue;
+        }
+
+        // control objects only run on pd's thread, between ticks
+        if (!zgetfn(&y->g_pd, dsp))
+            continue;
+
+        for (i = 0; parallel_pure_classes[i]; i++) {
+            if (!strcmp(name, parallel_pure_classes[i]))
+                break;
+        }
+        if (!parallel_pure_classes[i])
+            return 0;
+    }
+    return 1;
+}
+
+static t_parallel_subpatch* subpatch_find(t_parallel_context* ctx, t_canvas* owner)
+{
+    t_parallel_subpatch* s;
+    for (s = ctx->x_subpatches; s; s = s->s_next) {
+        if (s->s_owner == owner)
+            return s;
+    }
+    return 0;
+}
+
+static void subpatch_leave_group(t_parallel_context* ctx, t_parallel_subpatch* s)
+{
+    t_parallel_group** g;
+    t_parallel_group* group = s->s_group;
+    int i, j;
+
+    if (!group)
+        return;
+
+    for (i = j = 0; i < group->g_n; i++) {
+        if (group->g_members[i] != s)
+            group->g_members[j++] = group->g_members[i];
+    }
+    group->g_members = (t_parallel_subpatch**)resizebytes(group->g_members, group->g_n * sizeof(*group->g_members), (j ? j : 1) * sizeof(*group->g_members));
+    group->g_n = j;
+    group->g_seen = 0;
+    s->s_group = 0;
+
+    if (group->g_n)
+        return;
+
+    for (g = &ctx->x_groups; *g; g = &(*g)->g_next) {
+        if (*g == group) {
+            *g = group->g_next;
+            freebytes(group->g_members, sizeof(*group->g_members));
+            freebytes(group, sizeof(*group));
+            break;
+        }
+    }
+}
+
+static void subpatch_join_group(t_parallel_context* ctx, t_parallel_subpatch* s, t_canvas* parent)
+{
+    t_parallel_group* group;
+
+    for (group = ctx->x_groups; group; group = group->g_next) {
+        if (group->g_parent == parent)
+            break;
+    }
+
+    if (!group) {
+        group = (t_parallel_group*)getbytes(sizeof(*group));
+        group->g_parent = parent;
+        group->g_context = ctx;
+        group->g_members = (t_parallel_subpatch**)getbytes(sizeof(*group->g_members));
+        group->g_next = ctx->x_groups;
+        ctx->x_groups = group;
+    } else {
+        group->g_members = (t_parallel_subpatch**)resizebytes(group->g_members, (group->g_n ? group->g_n : 1) * sizeof(*group->g_members), (group->g_n + 1) * sizeof(*group->g_members));
+    }
+
+    group->g_instance = pd_this;
+    group->g_members[group->g_n++] = s;
+    group->g_seen = 0;
+    s->s_group = group;
+}
+
+static void subpatch_remove(t_parallel_context* ctx, t_parallel_subpatch* s)
+{
+    t_parallel_subpatch** p;
+
+    subpatch_leave_group(ctx, s);
+
+    for (p = &ctx->x_subpatches; *p; p = &(*p)->s_next) {
+        if (*p == s) {
+            *p = s->s_next;
+            break;
+        }
+    }
+
+    if (s->s_chain)
+        freebytes(s->s_chain, s->s_chainsize * sizeof(t_int));
+    freebytes(s, sizeof(*s));
+}
+
+static void group_run(void* data, int index)
+{
+    t_parallel_group* group = (t_parallel_group*)data;
+    t_int* ip = group->g_members[index]->s_chain;
+
+    pd_setinstance(group->g_instance);
+
+    while (ip)
+        ip = (*(t_perfroutine)(*ip))(ip);
+}
+
+// The first member that's reached runs all of them, the others find their output ready
+static t_int* subpatch_perform(t_int* w)
+{
+    t_parallel_subpatch* s = (t_parallel_subpatch*)(w[1]);
+    t_parallel_group* group = s->s_group;
+    t_parallel_context* ctx = group->g_context;
+    int i;
+
+    if (group->g_seen++ == 0) {
+        if (ctx->x_run && !ctx->x_running && group->g_n > 1) {
+            ctx->x_running = 1;
+            ctx->x_run(ctx->x_executor, group_run, group, group->g_n);
+            ctx->x_running = 0;
+        } else {
+            for (i = 0; i < group->g_n; i++)
+                group_run(group, i);
+        }
+    }
+
+    if (group->g_seen >= group->g_n)
+        group->g_seen = 0;
+
+    return (w + 2);
+}
+
+static void canvas_serial_dsp(t_canvas* x, t_signal** sp)
+{
+    t_gotfn fn = zgetfn(&x->gl_pd, gensym("dsp_aliased"));
+    if (fn)
+        (*(void (*)(t_canvas*, t_signal**))fn)(x, sp);
+}
+
+// A member runs earlier than its own place in the chain, so it can't share buffers with anything:
+// it's compiled into a chain of its own without pd's free signals, and it writes to outputs of its own
+// that are copied to the real outputs at its place in the chain
+static void canvas_parallel_dsp(t_canvas* x, t_signal** sp)
+{
+    t_parallel_context* ctx = parallel_context_get(0);
+    t_parallel_subpatch* s = ctx ? subpatch_find(ctx, x) : 0;
+    t_fake_instanceugen* ugen = (t_fake_instanceugen*)pd_this->pd_ugen;
+    t_signal* freelist[MAXLOGSIG + 1] = { 0 };
+    t_signal* freeborrowed = 0;
+    t_signal** outs;
+    t_int *mainchain, done;
+    int i, nout, mainchainsize;
+
+    if (s)
+        subpatch_remove(ctx, s);
+
+    if (!ctx || !x->gl_owner || !canvas_is_parallel(x) || obj_nsiginlets(&x->gl_obj) || !canvas_is_independent(x)) {
+        canvas_serial_dsp(x, sp);
+        return;
+    }
+
+    s = (t_parallel_subpatch*)getbytes(sizeof(*s));
+    s->s_owner = x;
+    s->s_next = ctx->x_subpatches;
+    ctx->x_subpatches = s;
+
+    nout = obj_nsigoutlets(&x->gl_obj);
+    outs = (t_signal**)getbytes((nout ? nout : 1) * sizeof(*outs));
+
+    // not made reusable, they're only freed when pd rebuilds the chain
+    for (i = 0; i < nout; i++)
+        outs[i] = signal_newfromcontext(1);
+
+    mainchain = ugen->u_dspchain;
+    mainchainsize = ugen->u_dspchainsize;
+    done = mainchain[mainchainsize - 1];
+
+    ugen->u_dspchain = (t_int*)getbytes(sizeof(t_int));
+    ugen->u_dspchain[0] = done;
+    ugen->u_dspchainsize = 1;
+
+    parallel_stash_signals(ugen, freelist, &freeborrowed);
+    canvas_serial_dsp(x, outs);
+    parallel_stash_signals(ugen, freelist, &freeborrowed);
+
+    s->s_chain = ugen->u_dspchain;
+    s->s_chainsize = ugen->u_dspchainsize;
+
+    ugen->u_dspchain = mainchain;
+    ugen->u_dspchainsize = mainchainsize;
+    parallel_restore_signals(ugen, freelist, freeborrowed);
+
+    subpatch_join_group(ctx, s, x->gl_owner);
+
+    dsp_add(subpatch_perform, 1, s);
+    for (i = 0; i < nout; i++)
+        dsp_add_copy(outs[i]->s_vec, sp[i]->s_vec, sp[i]->s_n);
+
+    freebytes(outs, (nout ? nout : 1) * sizeof(*outs));
+}
+
+static void canvas_parallel_free(t_canvas* x)
+{
+    t_parallel_context* ctx = parallel_context_get(0);
+    t_parallel_subpatch* s = ctx ? subpatch_find(ctx, x) : 0;
+
+    if (s)
+        subpatch_remove(ctx, s);
+
+    if (parallel_canvas_freemethod)
+        (*(void (*)(t_canvas*))parallel_canvas_freemethod)(x);
+}
+
+void libpd_parallel_setup(void)
+{
+    t_pd* probe;
+
+    parallel_context_class = class_new(gensym("parallel context"), 0, 0, sizeof(t_parallel_context), CLASS_PD, 0);
+
+    // the original canvas method is renamed to "dsp_aliased"
+    class_addmethod(canvas_class, (t_method)canvas_parallel_dsp, gensym("dsp"), A_CANT, 0);
+    parallel_canvas_freemethod = canvas_class->c_freemethod;
+    canvas_class->c_freemethod = (t_method)canvas_parallel_free;
+
+    // clone's class is private to g_clone.c, an empty clone tells us which one it is
+    pd_typedmess(&pd_objectmaker, gensym("clone"), 0, 0);
+    probe = pd_newest();
+    if (!probe)
+        return;
+
+    parallel_clone_class = pd_class(probe);
+    pd_free(probe);
+
+    // the original methods are renamed to "clone_aliased" and "dsp_aliased"
+    class_addcreator((t_newmethod)clone_parallel_new, gensym("clone"), A_GIMME, 0);
+    class_addmethod(parallel_clone_class, (t_method)clone_parallel_dsp, gensym("dsp"), A_CANT, 0);
+
+    parallel_clone_freemethod = parallel_clone_class->c_freemethod;
+    parallel_clone_class->c_freemethod = (t_method)clone_parallel_free;
+}
+
+void libpd_set_parallel_executor(void* executor, t_libpd_parallel_executor fn)
+{
+    t_parallel_context* ctx;
+
+    sys_lock();
+    ctx = parallel_context_get(1);
+    ctx->x_executor = executor;
+    ctx->x_run = fn;
+    sys_unlock();
+}
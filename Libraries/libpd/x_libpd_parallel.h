@@ -0,0 +1,37 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <m_pd.h>
+
+// Runs task(data, index) for every index in [0, ntasks) and returns once all of them are done
+typedef void (*t_libpd_parallel_task)(void* data, int index);
+typedef void (*t_libpd_parallel_executor)(void* executor, t_libpd_parallel_task task, void* data, int ntasks);
+
+// Installs the parallel mode for [clone], needs to be called once after libpd_init
+// Creating a clone with the "-parallel" flag, like [clone -parallel 16 voice], compiles every
+// copy into its own DSP chain. The chains are run by the executor of the current instance,
+// and the outlets are summed in voice order afterwards, so the result doesn't depend on scheduling.
+// Only copies whose signal objects are all known to keep to their own state run in parallel, the same
+// ones as for subpatches below. Otherwise the clone runs its copies one after the other, like pd does.
+// Subpatches typed as [pd name -parallel] that have no signal inlets all run at the same time, as soon
+// as the first of them is reached in the DSP chain of the patch that contains them. Only subpatches whose
+// signal objects are all known to keep to their own state, like [osc~], [*~] or [lop~], run in parallel.
+// Any other signal object, including every external, makes the subpatch run like any other subpatch.
+void libpd_parallel_setup(void);
+
+// Sets the executor that runs parallel clones for the current instance, or removes it when fn is NULL
+// Clones fall back to serial processing while no executor is set
+void libpd_set_parallel_executor(void* executor, t_libpd_parallel_executor fn);
+
+#ifdef __cplusplus
+}
+#endif
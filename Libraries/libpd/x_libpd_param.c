@@ -0,0 +1,126 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <m_pd.h>
+
+#include "x_libpd_param.h"
+
+// Ramp from start to target, which started at logical time starttime and takes length ms
+typedef struct _param_ramp {
+    t_float r_start;
+    t_float r_target;
+    double r_starttime;
+    double r_length;
+} t_param_ramp;
+
+// Per instance state, bound to a symbol since symbols are local to each pd instance
+typedef struct _paramstate {
+    t_pd x_pd;
+    t_param_ramp x_ramps[LIBPD_NUM_PARAMS];
+} t_paramstate;
+
+typedef struct _param_tilde {
+    t_object x_obj;
+    t_param_ramp* x_ramp;
+    double x_mspersample;
+} t_param_tilde;
+
+static t_class* paramstate_class;
+static t_class* param_tilde_class;
+
+static t_paramstate* paramstate_get(void)
+{
+    t_symbol* s = gensym("#plugdata_params");
+    t_paramstate* x = (t_paramstate*)pd_findbyclass(s, paramstate_class);
+    if (!x) {
+        x = (t_paramstate*)pd_new(paramstate_class);
+        memset(x->x_ramps, 0, sizeof(x->x_ramps));
+        pd_bind(&x->x_pd, s);
+    }
+    return x;
+}
+
+static t_float param_ramp_value(t_param_ramp const* r, double elapsed)
+{
+    if (elapsed >= r->r_length)
+        return r->r_target;
+
+    return r->r_start + (r->r_target - r->r_start) * (t_float)(elapsed / r->r_length);
+}
+
+void libpd_param_set(int index, t_float value, t_float ramptime)
+{
+    t_param_ramp* r;
+
+    if (index < 0 || index >= LIBPD_NUM_PARAMS)
+        return;
+
+    r = paramstate_get()->x_ramps + index;
+    r->r_start = param_ramp_value(r, clock_gettimesince(r->r_starttime));
+    r->r_target = value;
+    r->r_starttime = clock_getlogicaltime();
+    r->r_length = ramptime > 0 ? ramptime : 0;
+}
+
+static t_int* param_tilde_perform(t_int* w)
+{
+    t_param_tilde* x = (t_param_tilde*)(w[1]);
+    t_sample* out = (t_sample*)(w[2]);
+    int n = (int)(w[3]), i;
+    t_param_ramp const* r = x->x_ramp;
+    double elapsed = clock_gettimesince(r->r_starttime);
+
+    if (elapsed >= r->r_length) {
+        t_sample value = r->r_target;
+        for (i = 0; i < n; i++)
+            out[i] = value;
+    } else {
+        for (i = 0; i < n; i++)
+            out[i] = param_ramp_value(r, elapsed + i * x->x_mspersample);
+    }
+
+    return w + 4;
+}
+
+static void param_tilde_dsp(t_param_tilde* x, t_signal** sp)
+{
+    x->x_mspersample = 1000.0 / sp[0]->s_sr;
+    dsp_add(param_tilde_perform, 3, x, sp[0]->s_vec, (t_int)sp[0]->s_n);
+}
+
+// Takes the parameter as a number, or by its name like "param3"
+static void* param_tilde_new(t_symbol* s, int argc, t_atom* argv)
+{
+    t_param_tilde* x = (t_param_tilde*)pd_new(param_tilde_class);
+    int index = 1;
+
+    if (argc && argv->a_type == A_FLOAT)
+        index = (int)atom_getfloat(argv);
+    else if (argc && argv->a_type == A_SYMBOL && !strncmp(atom_getsymbol(argv)->s_name, "param", 5))
+        index = atoi(atom_getsymbol(argv)->s_name + 5);
+
+    if (index < 1 || index > LIBPD_NUM_PARAMS) {
+        pd_error(x, "param~: no parameter %d, there are %d", index, LIBPD_NUM_PARAMS);
+        index = index < 1 ? 1 : LIBPD_NUM_PARAMS;
+    }
+
+    x->x_ramp = paramstate_get()->x_ramps + index - 1;
+    x->x_mspersample = 1000.0 / sys_getsr();
+    outlet_new(&x->x_obj, &s_signal);
+    return x;
+}
+
+void libpd_param_setup(void)
+{
+    paramstate_class = class_new(gensym("parameter state"), 0, 0, sizeof(t_paramstate), CLASS_PD, 0);
+
+    param_tilde_class = class_new(gensym("param~"), (t_newmethod)param_tilde_new, 0,
+        sizeof(t_param_tilde), CLASS_NOINLET, A_GIMME, 0);
+    class_addmethod(param_tilde_class, (t_method)param_tilde_dsp, gensym("dsp"), A_CANT, 0);
+}
@@ -0,0 +1,26 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <m_pd.h>
+
+#define LIBPD_NUM_PARAMS 512
+
+// Adds [param~ n], which outputs parameter n (1 to 512) as a signal, needs to be called once after libpd_init
+// The value ramps from where it is to each new value in the time given with it, so automation needs no [line~]
+void libpd_param_setup(void);
+
+// Ramps parameter index (0 based) of the current instance to value in ramptime ms, starting at the current logical time
+void libpd_param_set(int index, t_float value, t_float ramptime);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,114 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <string.h>
+
+#include <m_pd.h>
+#include <g_canvas.h>
+
+#include "x_libpd_sharedarray.h"
+
+#ifdef _MSC_VER
+#    include <intrin.h>
+#    define SHAREDARRAY_LOAD(p) _InterlockedOr((long volatile*)(p), 0)
+#    define SHAREDARRAY_ADD(p, v) _InterlockedExchangeAdd((long volatile*)(p), (v))
+#else
+#    define SHAREDARRAY_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#    define SHAREDARRAY_ADD(p, v) __atomic_fetch_add((p), (v), __ATOMIC_ACQ_REL)
+#endif
+
+// The start of pd's t_garray
+typedef struct _fake_garray {
+    t_gobj x_gobj;
+    t_scalar* x_scalar;
+    t_glist* x_glist;
+    t_symbol* x_name;
+    t_symbol* x_realname;
+} t_fake_garray;
+
+static t_libpd_sharedarray_registry const* sharedarray_registry;
+
+// Arrays of every instance that use shared storage, so freebytes only asks the registry when there are any
+static long sharedarray_nusers;
+
+int libpd_sharedarray_owns(void const* vec)
+{
+    return vec && SHAREDARRAY_LOAD(&sharedarray_nusers) && sharedarray_registry && sharedarray_registry->contains((t_word const*)vec);
+}
+
+int libpd_sharedarray_release(void* vec)
+{
+    if (!vec || !SHAREDARRAY_LOAD(&sharedarray_nusers) || !sharedarray_registry || !sharedarray_registry->release((t_word*)vec))
+        return 0;
+
+    SHAREDARRAY_ADD(&sharedarray_nusers, -1);
+    return 1;
+}
+
+// Gives the array a copy of its values to keep as its own, if it was sharing
+static void sharedarray_unshare(t_garray* garray)
+{
+    t_array* a = garray_getarray(garray);
+    t_word* own;
+
+    if (!libpd_sharedarray_owns(a->a_vec))
+        return;
+
+    own = (t_word*)getbytes(a->a_n * a->a_elemsize);
+    memcpy(own, a->a_vec, a->a_n * a->a_elemsize);
+    libpd_sharedarray_release(a->a_vec);
+    a->a_vec = (char*)own;
+
+    // Signal objects keep the address of the values they read and write
+    canvas_update_dsp();
+}
+
+static void sharedarray_share(t_garray* garray, t_symbol* key)
+{
+    t_array* a = garray_getarray(garray);
+    t_word* storage;
+
+    if (!sharedarray_registry) {
+        pd_error(garray, "array: can't share arrays here");
+        return;
+    }
+
+    // Only arrays of floats, the storage has no room for the fields of a template
+    if (a->a_elemsize != sizeof(t_word)) {
+        pd_error(garray, "array: only arrays of floats can be shared");
+        return;
+    }
+
+    if (key == &s_)
+        key = ((t_fake_garray*)garray)->x_realname;
+
+    sharedarray_unshare(garray);
+
+    // Counted before the array points at the storage, so freebytes never misses it
+    SHAREDARRAY_ADD(&sharedarray_nusers, 1);
+    storage = sharedarray_registry->acquire(key->s_name, (t_word const*)a->a_vec, a->a_n);
+    if (!storage) {
+        SHAREDARRAY_ADD(&sharedarray_nusers, -1);
+        pd_error(garray, "array: %s is shared with another size", key->s_name);
+        return;
+    }
+
+    freebytes(a->a_vec, a->a_n * sizeof(t_word));
+    a->a_vec = (char*)storage;
+    garray_redraw(garray);
+    canvas_update_dsp();
+}
+
+void libpd_sharedarray_setup(void)
+{
+    class_addmethod(garray_class, (t_method)sharedarray_share, gensym("share"), A_DEFSYM, 0);
+    class_addmethod(garray_class, (t_method)sharedarray_unshare, gensym("unshare"), 0);
+}
+
+void libpd_sharedarray_set_registry(t_libpd_sharedarray_registry const* registry)
+{
+    sharedarray_registry = registry;
+}
@@ -0,0 +1,46 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <m_pd.h>
+
+// Storage for arrays that every instance in the process shares, kept while any array uses it
+// acquire returns the storage of key, creating it from the n values of vec if it doesn't exist yet, or NULL
+// when it exists with another size. The storage stays at the same address until the last release.
+// contains and release return 0 when storage isn't shared storage. They are called from any thread that frees pd's memory,
+// audio threads included, so they must not lock.
+typedef struct _libpd_sharedarray_registry {
+    t_word* (*acquire)(char const* key, t_word const* vec, int n);
+    int (*contains)(t_word const* storage);
+    int (*release)(t_word* storage);
+} t_libpd_sharedarray_registry;
+
+// Adds the "share" and "unshare" messages to arrays, needs to be called once after libpd_init
+// [; array1 share drumkit/kick( makes array1 use the storage named drumkit/kick, so the same sample loaded by
+// every instance is only kept once. The first array to share a key gives its values, later ones of the same
+// size take them over. Writes are seen by every array that shares the storage. Without a key, the name of the array is used.
+// An array that's resized gets a copy of its own, whatever resizes it, see libpd_sharedarray_release
+void libpd_sharedarray_setup(void);
+
+// Sets the registry that shared storage comes from, or removes it when registry is NULL
+// Arrays can't be shared without a registry
+void libpd_sharedarray_set_registry(t_libpd_sharedarray_registry const* registry);
+
+// Called by pd's freebytes and resizebytes in x_libpd_memory.c, so no path can free shared storage
+// Whether vec is shared storage, these only ask the registry while any array is shared
+int libpd_sharedarray_owns(void const* vec);
+
+// Lets go of one array's use of vec and returns 1 if it's shared storage, or returns 0
+int libpd_sharedarray_release(void* vec);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,323 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <m_pd.h>
+#include <m_imp.h>
+#include <g_canvas.h>
+
+#include "x_libpd_tableload.h"
+
+#define TABLELOAD_MAXCHANS 64
+#define TABLELOAD_MAXSIZE 0x7fffffff
+#define TABLELOAD_POLLTIME 20 // ms between looks at a file that is still decoded
+
+// A file that is decoded for the arrays of a [soundfiler]
+typedef struct _tableload {
+    t_object* l_owner;
+    void* l_load;
+    t_clock* l_clock;
+    t_symbol* l_file;
+    int l_resize;
+    int l_nchans;
+    t_symbol* l_arrays[TABLELOAD_MAXCHANS];
+    long l_sizes[TABLELOAD_MAXCHANS];
+    struct _tableload* l_next;
+} t_tableload;
+
+// Per instance state, bound to a symbol since symbols are local to each pd instance
+typedef struct _tableload_state {
+    t_pd x_pd;
+    t_tableload* x_loads;
+} t_tableload_state;
+
+static t_class* tableload_state_class;
+static t_libpd_tableload_registry const* tableload_registry;
+
+static t_method tableload_soundfiler_freemethod;
+
+static t_tableload_state* tableload_state_get(int create)
+{
+    t_symbol* s = gensym("#plugdata_tableloads");
+    t_tableload_state* x = (t_tableload_state*)pd_findbyclass(s, tableload_state_class);
+    if (!x && create) {
+        x = (t_tableload_state*)pd_new(tableload_state_class);
+        x->x_loads = 0;
+        pd_bind(&x->x_pd, s);
+    }
+    return x;
+}
+
+static void tableload_free(t_tableload* l)
+{
+    t_tableload_state* x = tableload_state_get(0);
+    t_tableload** p;
+
+    for (p = &x->x_loads; *p != l; p = &(*p)->l_next)
+        ;
+    *p = l->l_next;
+
+    if (tableload_registry)
+        tableload_registry->close(l->l_load);
+    clock_free(l->l_clock);
+    freebytes(l, sizeof(*l));
+}
+
+// Stops the loads of a [soundfiler]
+static void tableload_cancel(t_object* owner)
+{
+    t_tableload_state* x = tableload_state_get(0);
+    t_tableload *l, *next;
+
+    if (!x)
+        return;
+
+    for (l = x->x_loads; l; l = next) {
+        next = l->l_next;
+        if (l->l_owner == owner)
+            tableload_free(l);
+    }
+}
+
+// Puts vec in place of the values of garray, in one go between two ticks of the DSP
+static void tableload_swap(t_garray* garray, t_word* vec, long n, int resize)
+{
+    t_array* a = garray_getarray(garray);
+    if (a->a_elemsize != sizeof(t_word)) {
+        freebytes(vec, n * sizeof(t_word));
+        return;
+    }
+
+    if (a->a_n != n)
+        resize = 1;
+
+    // Storage that's shared with other arrays is only let go of, see x_libpd_sharedarray.h
+    freebytes(a->a_vec, a->a_n * a->a_elemsize);
+    a->a_vec = (char*)vec;
+    a->a_n = (int)n;
+
+    // The vector has the size already, resizing only fits the graph to it and redraws
+    if (resize)
+        garray_resize_long(garray, n);
+    else {
+        // Makes pointers into the old values invalid
+        array_resize(a, (int)n);
+        garray_redraw(garray);
+    }
+}
+
+static void tableload_tick(t_tableload* l)
+{
+    t_object* owner = l->l_owner;
+    t_outlet* out2;
+    t_atom info[2];
+    double samplerate;
+    long frames;
+    int nchans, i;
+
+    if (!tableload_registry) {
+        tableload_free(l);
+        return;
+    }
+
+    if (!tableload_registry->poll(l->l_load, &frames, &samplerate, &nchans)) {
+        clock_delay(l->l_clock, TABLELOAD_POLLTIME);
+        return;
+    }
+
+    if (frames < 0) {
+        pd_error(owner, "soundfiler: %s: couldn't read the file", l->l_file->s_name);
+        tableload_free(l);
+        return;
+    }
+
+    for (i = 0; i < l->l_nchans; i++) {
+        t_garray* garray = (t_garray*)pd_findbyclass(l->l_arrays[i], garray_class);
+        t_word* vec = tableload_registry->take(l->l_load, i);
+        long n = l->l_sizes[i] ? l->l_sizes[i] : (frames > 0 ? frames : 1);
+
+        if (!vec)
+            continue;
+
+        // The array might be gone by now
+        if (garray)
+            tableload_swap(garray, vec, n, l->l_resize);
+        else
+            freebytes(vec, n * sizeof(t_word));
+    }
+
+    // Signal objects keep the address of the values they read and write
+    canvas_update_dsp();
+
+    SETFLOAT(info, samplerate);
+    SETFLOAT(info + 1, nchans);
+    tableload_free(l);
+
+    obj_starttraverse_outlet(owner, &out2, 1);
+    outlet_list(out2, &s_list, 2, info);
+    outlet_float(owner->ob_outlet, frames);
+}
+
+// The canvas that has x in it, if it's in gl or one of its subpatches
+static t_canvas* tableload_findcanvas(t_glist* gl, t_gobj* x)
+{
+    t_gobj* y;
+    t_canvas* found;
+
+    for (y = gl->gl_list; y; y = y->g_next) {
+        if (y == x)
+            return gl;
+        if (pd_class(&y->g_pd) == canvas_class && (found = tableload_findcanvas((t_glist*)y, x)))
+            return found;
+    }
+    return 0;
+}
+
+static void tableload_read(t_object* x, t_symbol* s, int argc, t_atom* argv)
+{
+    t_tableload_state* state;
+    t_tableload* l;
+    t_canvas* canvas = 0;
+    t_symbol* file;
+    char dir[MAXPDSTRING], path[MAXPDSTRING], *name;
+    long skip = 0, maxsize = TABLELOAD_MAXSIZE, finalsize = TABLELOAD_MAXSIZE;
+    int resize = 0, resample = 0, fd, i;
+    void* load;
+
+    tableload_cancel(x);
+
+    if (!tableload_registry) {
+        pd_error(x, "soundfiler: can't read in the background here");
+        return;
+    }
+
+    while (argc > 0 && argv->a_type == A_SYMBOL && *argv->a_w.w_symbol->s_name == '-') {
+        char const* flag = argv->a_w.w_symbol->s_name + 1;
+        if (!strcmp(flag, "resize"))
+            resize = 1, argc--, argv++;
+        else if (!strcmp(flag, "resample"))
+            resample = 1, argc--, argv++;
+        else if (!strcmp(flag, "skip") && argc > 1 && argv[1].a_type == A_FLOAT && argv[1].a_w.w_float >= 0)
+            skip = (long)argv[1].a_w.w_float, argc -= 2, argv += 2;
+        else if (!strcmp(flag, "maxsize") && argc > 1 && argv[1].a_type == A_FLOAT && argv[1].a_w.w_float >= 0) {
+            maxsize = argv[1].a_w.w_float > TABLELOAD_MAXSIZE ? TABLELOAD_MAXSIZE : (long)argv[1].a_w.w_float;
+            resize = 1; // as for "read"
+            argc -= 2, argv += 2;
+        } else
+            goto usage;
+    }
+
+    if (argc < 2 || argc > TABLELOAD_MAXCHANS + 1 || argv->a_type != A_SYMBOL)
+        goto usage;
+
+    file = argv->a_w.w_symbol;
+    argc--, argv++;
+
+    l = (t_tableload*)getbytes(sizeof(*l));
+    l->l_owner = x;
+    l->l_file = file;
+    l->l_resize = resize;
+    l->l_nchans = argc;
+
+    for (i = 0; i < argc; i++) {
+        t_garray* garray;
+        t_array* a;
+
+        if (argv[i].a_type != A_SYMBOL) {
+            freebytes(l, sizeof(*l));
+            goto usage;
+        }
+
+        l->l_arrays[i] = argv[i].a_w.w_symbol;
+        if (!(garray = (t_garray*)pd_findbyclass(l->l_arrays[i], garray_class))) {
+            pd_error(x, "soundfiler: %s: no such table", l->l_arrays[i]->s_name);
+            freebytes(l, sizeof(*l));
+            return;
+        }
+
+        // Only arrays of floats, the buffers have no room for the fields of a template
+        a = garray_getarray(garray);
+        if (a->a_elemsize != sizeof(t_word)) {
+            pd_error(x, "soundfiler: %s: only arrays of floats can be read into", l->l_arrays[i]->s_name);
+            freebytes(l, sizeof(*l));
+            return;
+        }
+
+        l->l_sizes[i] = resize ? 0 : a->a_n;
+        if (a->a_n < finalsize)
+            finalsize = a->a_n;
+    }
+
+    // [soundfiler] keeps its canvas to itself, so it's looked for
+    for (canvas = pd_getcanvaslist(); canvas; canvas = canvas->gl_next) {
+        t_canvas* found = tableload_findcanvas(canvas, &x->te_g);
+        if (found) {
+            canvas = found;
+            break;
+        }
+    }
+
+    if ((fd = canvas_open(canvas, file->s_name, "", dir, &name, MAXPDSTRING, 1)) < 0) {
+        pd_error(x, "soundfiler: %s: can't open", file->s_name);
+        freebytes(l, sizeof(*l));
+        return;
+    }
+    sys_close(fd);
+    snprintf(path, MAXPDSTRING, "%s/%s", dir, name);
+
+    load = tableload_registry->open(path, l->l_nchans, l->l_sizes, skip, resize ? maxsize : finalsize, resample ? sys_getsr() : 0);
+    if (!load) {
+        pd_error(x, "soundfiler: %s: can't read the file", path);
+        freebytes(l, sizeof(*l));
+        return;
+    }
+
+    state = tableload_state_get(1);
+    l->l_load = load;
+    l->l_clock = clock_new(l, (t_method)tableload_tick);
+    l->l_next = state->x_loads;
+    state->x_loads = l;
+
+    clock_delay(l->l_clock, TABLELOAD_POLLTIME);
+    return;
+
+usage:
+    pd_error(x, "usage: readasync [flags] filename tablename...");
+    post("flags: -skip <n> -resize -maxsize <n> -resample");
+}
+
+static void tableload_soundfiler_free(t_object* x)
+{
+    tableload_cancel(x);
+
+    if (tableload_soundfiler_freemethod)
+        (*(void (*)(t_object*))tableload_soundfiler_freemethod)(x);
+}
+
+void libpd_tableload_setup(void)
+{
+    t_pd* probe;
+
+    tableload_state_class = class_new(gensym("table load state"), 0, 0, sizeof(t_tableload_state), CLASS_PD, 0);
+
+    // Its class is private to pd, an object without arguments tells us which one it is
+    pd_typedmess(&pd_objectmaker, gensym("soundfiler"), 0, 0);
+    if ((probe = pd_newest())) {
+        t_class* c = pd_class(probe);
+        pd_free(probe);
+
+        class_addmethod(c, (t_method)tableload_read, gensym("readasync"), A_GIMME, 0);
+        tableload_soundfiler_freemethod = c->c_freemethod;
+        c->c_freemethod = (t_method)tableload_soundfiler_free;
+    }
+}
+
+void libpd_tableload_set_registry(t_libpd_tableload_registry const* registry)
+{
+    tableload_registry = registry;
+}
@@ -0,0 +1,45 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <m_pd.h>
+
+// Decodes sound files for arrays on a thread of its own, so the pd thread never waits for the disk
+// open starts decoding the first nchans channels of the file at path, from frame skip on, up to maxframes frames,
+// and returns NULL when the file can't be read. With samplerate > 0 the file is resampled to it.
+// Channel ch goes into a buffer of sizes[ch] words, or of as many as were decoded when that is 0, padded with
+// zeros, so every buffer can replace the vector of a float array as it is. Called from the pd thread of any instance.
+typedef struct _libpd_tableload_registry {
+    void* (*open)(char const* path, int nchans, long const* sizes, long skip, long maxframes, double samplerate);
+    // Returns 0 while the file is decoded. Afterwards frames is what was decoded, -1 when it failed,
+    // and samplerate and nchans are those of the file
+    int (*poll)(void* load, long* frames, double* samplerate, int* nchans);
+    // The buffer of channel ch once the load is done, which the caller owns and frees with freebytes
+    t_word* (*take)(void* load, int ch);
+    // Ends the load, stopping it when it's still decoding, and frees the buffers that weren't taken
+    void (*close)(void* load);
+} t_libpd_tableload_registry;
+
+// Adds the "readasync" message to [soundfiler], needs to be called once after libpd_init
+// [readasync -resize file.wav array1 array2( reads like "read", but the file is decoded in the background, and
+// the arrays get its samples all at once in a later tick, so signal objects see either the old or the new values.
+// The flags are -resize, -skip and -maxsize, as for "read", and -resample, which converts the file to pd's
+// sample rate. When it's done the left outlet gets the number of frames, and the right one the sample rate and
+// channels of the file. Another "readasync" to the same object stops the one before.
+void libpd_tableload_setup(void);
+
+// Sets the registry that decodes the files, or removes it when registry is NULL
+// Without a registry, "readasync" fails
+void libpd_tableload_set_registry(t_libpd_tableload_registry const* registry);
+
+#ifdef __cplusplus
+}
+#endif
@@ -5,6 +5,9 @@
  */
 #include "Canvas.h"
 
+#include <unordered_map>
+#include <unordered_set>
+
 extern "C"
 {
 #include <m_pd.h>
@@ -15,12 +18,148 @@ extern "C"
 #include "Connection.h"
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "Utility/Trace.h"
 #include "LookAndFeel.h"
 
 #include "Utility/GraphArea.h"
 #include "Utility/SuggestionComponent.h"
 
-Canvas::Canvas(PlugDataPluginEditor& parent, pd::Patch& p, Component* parentGraph) : main(parent), pd(&parent.pd), patch(p), storage(patch.getPointer(), pd)
+// Tells the canvas when another part of it becomes visible
+struct CanvasViewport : public Viewport
+{
+    explicit CanvasViewport(Canvas* parent) : cnv(parent)
+    {
+    }
+    
+    void visibleAreaChanged(const Rectangle<int>& newVisibleArea) override
+    {
+        cnv->realiseVisibleObjects();
+    }
+    
+    Canvas* cnv;
+};
+
+// Creates the objects of a large patch a batch per frame, so the editor keeps painting while it's opened
+struct CanvasLoader : public FrameScheduler::Client
+{
+    explicit CanvasLoader(Canvas& canvas) : cnv(canvas), statusbar(&canvas.main.statusbar)
+    {
+        statusbar->setLoadingProgress(cnv.loadNextBatch());
+        cnv.main.frameScheduler.addClient(this, 0);
+    }
+
+    ~CanvasLoader() override
+    {
+        cnv.main.frameScheduler.removeClient(this);
+
+        // The statusbar goes before the canvases when the editor closes
+        if (statusbar) statusbar->setLoadingProgress(-1.0f);
+    }
+
+    void frameUpdate() override
+    {
+        auto progress = cnv.loadNextBatch();
+        statusbar->setLoadingProgress(progress);
+
+        // Deletes this, so nothing can come after it
+        if (progress >= 1.0f) cnv.finishLoading();
+    }
+
+    Canvas& cnv;
+    Component::SafePointer<Statusbar> statusbar;
+};
+
+// Waits for the next frame to show the selection in the sidebar, see Canvas::updateSidebarSelection
+struct SidebarUpdater : public FrameScheduler::Client
+{
+    explicit SidebarUpdater(Canvas& canvas) : cnv(canvas)
+    {
+        cnv.main.frameScheduler.addClient(this, 0);
+    }
+
+    ~SidebarUpdater() override
+    {
+        cnv.main.frameScheduler.removeClient(this);
+    }
+
+    void frameUpdate() override
+    {
+        // Deletes this, so nothing can come after it
+        cnv.showSelectionInSidebar();
+    }
+
+    Canvas& cnv;
+};
+
+// Which objects in the content of a graph are shown, shared by every graph with the same content
+//! @details Only the GUIs of a graph are shown, the rest of its content is hidden (see ObjectBase::hideInGraph).
+//! Which kind of object is made for a pd object only depends on its class, its type and whether it's a graph,
+//! so all instances of an abstraction have the same layout. It's learned from the first instance that's made,
+//! the others only make the objects that are shown, instead of a hidden box for every object inside.
+struct GraphLayouts
+{
+    // Class, type and graph flag of every object, in pd's order
+    using Signature = std::vector<uintptr_t>;
+
+    static Signature getSignature(std::vector<void*> const& pdObjects)
+    {
+        Signature signature;
+        signature.reserve(pdObjects.size() * 2);
+
+        for (auto* obj : pdObjects)
+        {
+            auto* pdClass = pd_class(static_cast<t_pd*>(obj));
+
+            uintptr_t type = 0;
+            if (auto* object = pd_checkobject(static_cast<t_pd*>(obj))) type = 1 + object->te_type;
+            if (pdClass == canvas_class) type |= static_cast<t_canvas*>(obj)->gl_isgraph ? 32 : 16;
+
+            signature.push_back(reinterpret_cast<uintptr_t>(pdClass));
+            signature.push_back(type);
+        }
+
+        return signature;
+    }
+
+    // Whether each object is shown, or nullptr when this content wasn't seen yet
+    static std::vector<bool> const* find(Signature const& signature)
+    {
+        auto it = getLayouts().find(signature);
+        return it != getLayouts().end() ? &it->second : nullptr;
+    }
+
+    static void add(Signature signature, std::vector<bool> shown)
+    {
+        auto& layouts = getLayouts();
+
+        // Patches that are edited a lot leave layouts behind that nothing has anymore
+        if (layouts.size() >= maxLayouts) layouts.clear();
+
+        layouts.emplace(std::move(signature), std::move(shown));
+    }
+
+private:
+    struct SignatureHash
+    {
+        size_t operator()(Signature const& signature) const
+        {
+            size_t hash = signature.size();
+            for (auto value : signature) hash = hash * 31 + std::hash<uintptr_t>()(value);
+            return hash;
+        }
+    };
+
+    static constexpr size_t maxLayouts = 1024;
+
+    // Only used from the message thread
+    static std::unordered_map<Signature, std::vector<bool>, SignatureHash>& getLayouts()
+    {
+        static std::unordered_map<Signature, std::vector<bool>, SignatureHash> layouts;
+        return layouts;
+    }
+};
+
+Canvas::Canvas(PlugDataPluginEditor& parent, pd::Patch& p, Component* parentGraph, bool withContent) : main(parent), pd(&parent.pd), patch(p), sharedStorage(pd::Storage::getShared(patch.getPointer(), pd)), storage(*sharedStorage)
 {
     isGraphChild = glist_isgraph(p.getPointer());
     hideNameAndArgs = static_cast<bool>(p.getPointer()->gl_hidetext);
@@ -53,6 +192,9 @@ Canvas::Canvas(PlugDataPluginEditor& parent, pd::Patch& p, Component* parentGrap
 
     gridEnabled.referTo(pd->settingsTree.getPropertyAsValue("GridEnabled", nullptr));
 
+    renderCache.referTo(pd->settingsTree.getPropertyAsValue("RenderCache", nullptr));
+    renderCache.addListener(this);
+
     locked.referTo(pd->locked);
     locked.addListener(this);
 
@@ -76,7 +218,7 @@ Canvas::Canvas(PlugDataPluginEditor& parent, pd::Patch& p, Component* parentGrap
 
     if (!isGraph)
     {
-        viewport = new Viewport;  // Owned by the tabbar, but doesn't exist for graph!
+        viewport = new CanvasViewport(this);  // Owned by the tabbar, but doesn't exist for graph!
         viewport->setViewedComponent(this, false);
 
         presentationMode.referTo(parent.statusbar.presentationMode);
@@ -87,11 +229,18 @@ Canvas::Canvas(PlugDataPluginEditor& parent, pd::Patch& p, Component* parentGrap
         presentationMode = false;
     }
 
-    synchronise();
+    // Graphs always have content, they're made with their parent
+    if (withContent || isGraph)
+    {
+        loadContent();
+    }
 }
 
 Canvas::~Canvas()
 {
+    loader.reset();
+    sidebarUpdater.reset();
+
     isBeingDeleted = true;
     delete graphArea;
     delete suggestor;
@@ -137,17 +286,46 @@ void Canvas::paint(Graphics& g)
 // Used for loading and for complicated actions like undo/redo
 void Canvas::synchronise(bool updatePosition)
 {
+    TRACE_ZONE("Canvas::synchronise");
+
+    // Made from scratch when the content is loaded
+    if (!contentLoaded) return;
+
     pd->waitForStateUpdate();
     deselectAll();
 
     patch.setCurrent(true);
 
-    auto pdObjects = patch.getObjects();
+    // Everything is laid out from this, so the audio lock is only taken once, and pd can't change the patch halfway
+    auto snapshot = patch.getSnapshot();
+    auto const& pdObjects = snapshot->objects;
+
+    // Connection ids are made from the positions of their objects, those are looked up in the snapshot now
+    pd::Patch::IndexScope indexScope(patch, *snapshot);
+
+    objectStates = snapshot->states;
+    std::sort(objectStates.begin(), objectStates.end(), [](auto const& a, auto const& b) { return std::less<void*>()(a.object, b.object); });
+
+    // Position of every pd object, so we never have to search the object list
+    auto const& pdIndices = snapshot->indices;
+
     auto isObjectDeprecated = [&](void* obj)
     {
-        return std::all_of(pdObjects.begin(), pdObjects.end(), [obj](const auto* obj2){
-            return obj != obj2;
-        });
+        return !pdIndices.contains(obj);
+    };
+
+    // A graph only makes the objects it shows, once it knows which ones those are
+    GraphLayouts::Signature graphSignature;
+    std::vector<bool> const* shownInGraph = nullptr;
+    if (isGraph)
+    {
+        graphSignature = GraphLayouts::getSignature(pdObjects);
+        shownInGraph = GraphLayouts::find(graphSignature);
+    }
+
+    auto isHiddenInGraph = [&](void* obj)
+    {
+        return shownInGraph && !(*shownInGraph)[pdIndices.at(obj)];
     };
 
     if (!(isGraph || presentationMode == var(true)))
@@ -178,18 +356,27 @@ void Canvas::synchronise(bool updatePosition)
     for (int n = objects.size() - 1; n >= 0; n--)
     {
         auto* object = objects[n];
-        if (object->gui && isObjectDeprecated(object->getPointer()))
+        if (object->gui && (isObjectDeprecated(object->getPointer()) || isHiddenInGraph(object->getPointer())))
         {
             objects.remove(n);
         }
     }
 
+    std::unordered_map<void*, Object*> existingObjects;
+    existingObjects.reserve(objects.size());
+    for (auto* object : objects)
+    {
+        if (object->getPointer()) existingObjects.emplace(object->getPointer(), object);
+    }
+
     for (auto* object : pdObjects)
     {
-        auto* it = std::find_if(objects.begin(), objects.end(), [&object](Object* b) { return b->getPointer() && b->getPointer() == object; });
+        auto it = existingObjects.find(object);
 
-        if (it == objects.end())
+        if (it == existingObjects.end())
         {
+            if (isHiddenInGraph(object)) continue;
+
             auto* newBox = objects.add(new Object(object, this));
             newBox->toFront(false);
 
@@ -198,7 +385,7 @@ void Canvas::synchronise(bool updatePosition)
         }
         else
         {
-            auto* object = *it;
+            auto* object = it->second;
 
             // Check if number of inlets/outlets is correct
             object->updatePorts();
@@ -212,58 +399,100 @@ void Canvas::synchronise(bool updatePosition)
         }
     }
 
-    // Make sure objects have the same order
-    std::sort(objects.begin(), objects.end(),
-              [&pdObjects](Object* first, Object* second) mutable
-              {
-                  size_t idx1 = std::find(pdObjects.begin(), pdObjects.end(), first->getPointer()) - pdObjects.begin();
-                  size_t idx2 = std::find(pdObjects.begin(), pdObjects.end(), second->getPointer()) - pdObjects.begin();
+    objectStates.clear();
 
-                  return idx1 < idx2;
+    // Make sure objects have the same order, objects that pd doesn't know go last
+    auto getPdIndex = [&pdIndices, numObjects = pdObjects.size()](Object* object)
+    {
+        auto it = pdIndices.find(object->getPointer());
+        return it != pdIndices.end() ? it->second : numObjects;
+    };
+
+    std::stable_sort(objects.begin(), objects.end(),
+              [&getPdIndex](Object* first, Object* second)
+              {
+                  return getPdIndex(first) < getPdIndex(second);
               });
 
-    auto pdConnections = patch.getConnections();
+    // The first graph with this content made all of its objects, remember which ones it shows and drop the rest
+    if (isGraph && !shownInGraph)
+    {
+        std::vector<bool> shown(pdObjects.size(), true);
+        for (int n = objects.size() - 1; n >= 0; n--)
+        {
+            auto* object = objects[n];
+            auto it = pdIndices.find(object->getPointer());
+            if (!object->gui || it == pdIndices.end() || !object->gui->hideInGraph()) continue;
+
+            shown[it->second] = false;
+            objects.remove(n);
+        }
+
+        GraphLayouts::add(std::move(graphSignature), std::move(shown));
+    }
+
+    auto const& pdConnections = snapshot->connections;
 
     if (!(isGraph || presentationMode == var(true)))
     {
+        // Existing connections by their ends, to find them without scanning all connections
+        struct ConnectionKey
+        {
+            Object* outobj;
+            Object* inobj;
+            int outIdx;
+            int inIdx;
+
+            bool operator==(ConnectionKey const& other) const = default;
+        };
+
+        struct ConnectionKeyHash
+        {
+            size_t operator()(ConnectionKey const& key) const
+            {
+                auto hash = std::hash<void*>()(key.outobj);
+                hash = hash * 31 + std::hash<void*>()(key.inobj);
+                return hash * 31 + static_cast<size_t>(key.outIdx) * 1024 + static_cast<size_t>(key.inIdx);
+            }
+        };
+
+        std::unordered_map<ConnectionKey, Connection*, ConnectionKeyHash> existingConnections;
+        existingConnections.reserve(connections.size());
+        for (auto* c : connections)
+        {
+            if (c->inlet && c->outlet) existingConnections.emplace(ConnectionKey{c->outobj.getComponent(), c->inobj.getComponent(), c->outIdx, c->inIdx}, c);
+        }
+
         for (auto& connection : pdConnections)
         {
             auto& [inno, inobj, outno, outobj] = connection;
 
-            int srcno = patch.getIndex(&inobj->te_g);
-            int sinkno = patch.getIndex(&outobj->te_g);
+            auto srcIt = pdIndices.find(&inobj->te_g);
+            auto sinkIt = pdIndices.find(&outobj->te_g);
 
-            auto& srcEdges = objects[srcno]->iolets;
-            auto& sinkEdges = objects[sinkno]->iolets;
+            int srcno = srcIt != pdIndices.end() ? static_cast<int>(srcIt->second) : -1;
+            int sinkno = sinkIt != pdIndices.end() ? static_cast<int>(sinkIt->second) : -1;
 
             // TEMP: remove when we're sure this works
-            if (srcno >= objects.size() || sinkno >= objects.size() || outno >= srcEdges.size() || inno >= sinkEdges.size())
+            if (srcno < 0 || sinkno < 0 || srcno >= objects.size() || sinkno >= objects.size() || outno >= objects[srcno]->iolets.size() || inno >= objects[sinkno]->iolets.size())
             {
                 pd->logError("Error: impossible connection");
                 continue;
             }
 
-            auto* it = std::find_if(connections.begin(), connections.end(),
-                                   [this, &connection, &srcno, &sinkno](Connection* c)
-                                   {
-                                       auto& [inno, inobj, outno, outobj] = connection;
-
-                                       if (!c->inlet || !c->outlet) return false;
-
-                                       bool sameStart = c->outobj == objects[srcno];
-                                       bool sameEnd = c->inobj == objects[sinkno];
+            auto& srcEdges = objects[srcno]->iolets;
+            auto& sinkEdges = objects[sinkno]->iolets;
 
-                                       return c->inIdx == inno && c->outIdx == outno && sameStart && sameEnd;
-                                   });
+            auto it = existingConnections.find(ConnectionKey{objects[srcno], objects[sinkno], outno, inno});
 
-            if (it == connections.end())
+            if (it == existingConnections.end())
             {
                 connections.add(new Connection(this, srcEdges[objects[srcno]->numInputs + outno], sinkEdges[inno], true));
             }
             else
             {
                 // Update storage ids for connections
-                auto& c = *(*it);
+                auto& c = *it->second;
 
                 c.inIdx = c.inlet->ioletIdx;
                 c.outIdx = c.outlet->ioletIdx;
@@ -296,6 +525,316 @@ void Canvas::synchronise(bool updatePosition)
         _this->checkBounds();
     });
     
+    realiseVisibleObjects();
+
+    main.updateCommandStatus();
+    repaint();
+}
+
+bool Canvas::isLoading() const
+{
+    return loader != nullptr;
+}
+
+bool Canvas::hasContent() const
+{
+    return contentLoaded;
+}
+
+void Canvas::loadContent()
+{
+    lastShown = Time::getMillisecondCounterHiRes();
+
+    if (contentLoaded) return;
+
+    contentLoaded = true;
+
+    // Graphs are loaded in one go with their parent
+    if (!isGraph && patch.getObjects().size() > incrementalLoadThreshold)
+    {
+        setInterceptsMouseClicks(false, false);
+        loader = std::make_unique<CanvasLoader>(*this);
+    }
+    else
+    {
+        synchronise();
+    }
+}
+
+void Canvas::releaseContent()
+{
+    if (!contentLoaded || isGraph || hasOpenSubpatches()) return;
+
+    loader.reset();
+    setInterceptsMouseClicks(true, true);
+
+    deselectAll();
+
+    // Connection paths stay in storage, so they come back with the connections
+    connections.clear();
+    objects.clear();
+
+    objectStates.clear();
+    pendingConnectionUpdates.clear();
+    dspLoad.clear();
+    objectIndexValid = false;
+    connectionIndexValid = false;
+
+    contentLoaded = false;
+}
+
+bool Canvas::hasOpenSubpatches() const
+{
+    for (auto* cnv : main.canvases)
+    {
+        if (cnv == this || !cnv->patch.getPointer()) continue;
+
+        for (auto* owner = cnv->patch.getPointer()->gl_owner; owner; owner = owner->gl_owner)
+        {
+            if (owner == patch.getPointer()) return true;
+        }
+    }
+
+    return false;
+}
+
+float Canvas::loadNextBatch()
+{
+    TRACE_ZONE("Canvas::loadNextBatch");
+
+    auto const deadline = Time::getMillisecondCounterHiRes() + loadBudgetMs;
+
+    patch.setCurrent(true);
+
+    // Read again every batch, pd could have changed the patch in between
+    objectStates = patch.getObjectStates();
+
+    std::vector<void*> pdObjects;
+    pdObjects.reserve(objectStates.size());
+    for (auto& state : objectStates)
+    {
+        pdObjects.push_back(state.object);
+    }
+
+    std::sort(objectStates.begin(), objectStates.end(), [](auto const& a, auto const& b) { return std::less<void*>()(a.object, b.object); });
+
+    // Objects that pd freed since the last batch can't wait for the end
+    for (int n = objects.size() - 1; n >= 0; n--)
+    {
+        if (!getObjectState(objects[n]->getPointer())) objects.remove(n);
+    }
+
+    std::unordered_set<void*> existingObjects;
+    existingObjects.reserve(objects.size());
+    for (auto* object : objects)
+    {
+        existingObjects.insert(object->getPointer());
+    }
+
+    size_t numLoaded = 0;
+    bool hasTime = true;
+    for (auto* object : pdObjects)
+    {
+        if (existingObjects.contains(object))
+        {
+            numLoaded++;
+            continue;
+        }
+
+        if (!hasTime) continue;
+
+        objects.add(new Object(object, this));
+        numLoaded++;
+
+        hasTime = Time::getMillisecondCounterHiRes() < deadline;
+    }
+
+    objectStates.clear();
+
+    // Order and connections are sorted out by the synchronise at the end
+    return numLoaded == pdObjects.size() ? 1.0f : static_cast<float>(numLoaded) / pdObjects.size();
+}
+
+void Canvas::finishLoading()
+{
+    setInterceptsMouseClicks(true, true);
+
+    synchronise();
+
+    // Last, this is called by the loader
+    loader.reset();
+}
+
+pd::ObjectState const* Canvas::getObjectState(void* object) const
+{
+    auto it = std::lower_bound(objectStates.begin(), objectStates.end(), object, [](auto const& state, void* obj) { return std::less<void*>()(state.object, obj); });
+    return it != objectStates.end() && it->object == object ? &*it : nullptr;
+}
+
+void Canvas::realiseVisibleObjects()
+{
+    // A graph is only made when it's visible itself, and is never large
+    if (!viewport)
+    {
+        for (auto* object : objects)
+        {
+            if (object->gui) object->gui->realise();
+        }
+        return;
+    }
+    
+    if (viewport->getViewWidth() <= 0 || viewport->getViewHeight() <= 0) return;
+    
+    // The view area is in the coordinates of the viewed component, which is zoomed with our transform
+    auto viewArea = viewport->getViewArea().toFloat().transformedBy(getTransform().inverted()).getSmallestIntegerContainer();
+    
+    Array<Object*> nearby;
+    getObjectIndex().query(viewArea.expanded(realiseMargin), nearby);
+    
+    for (auto* object : nearby)
+    {
+        if (object->gui) object->gui->realise();
+    }
+}
+
+void Canvas::applyCanvasEvents(std::vector<pd::CanvasEvent> const& events)
+{
+    if (!contentLoaded) return;
+
+    auto* cnv = patch.getPointer();
+
+    bool hasEvents = false;
+    bool needsFullSync = isGraph || presentationMode == var(true);
+    for (auto const& event : events)
+    {
+        if (event.canvas != cnv) continue;
+
+        hasEvents = true;
+        needsFullSync = needsFullSync || event.type == LIBPD_CANVAS_CHANGED;
+    }
+
+    if (!hasEvents) return;
+
+    // The synchronise at the end of loading picks up everything
+    if (loader) return;
+
+    // Graphs and presentation mode show things differently, undo could have changed anything
+    if (needsFullSync)
+    {
+        synchronise();
+        return;
+    }
+
+    // Objects that still exist, events can refer to objects that were freed later on
+    std::unordered_set<void*> alive;
+    for (auto* object : patch.getObjects())
+    {
+        alive.insert(object);
+    }
+
+    auto findObject = [this](void* ptr) -> Object*
+    {
+        for (auto* object : objects)
+        {
+            if (object->getPointer() == ptr) return object;
+        }
+        return nullptr;
+    };
+
+    auto findConnection = [this](Object* src, int nout, Object* sink, int nin) -> Connection*
+    {
+        for (auto* c : connections)
+        {
+            if (c->outobj == src && c->inobj == sink && c->outIdx == nout && c->inIdx == nin) return c;
+        }
+        return nullptr;
+    };
+
+    auto addObject = [this, &alive, &findObject](void* ptr)
+    {
+        if (!alive.contains(ptr) || findObject(ptr)) return;
+
+        auto* newBox = objects.add(new Object(ptr, this));
+        newBox->toFront(false);
+        if (newBox->gui && newBox->gui->getLabel()) newBox->gui->getLabel()->toFront(false);
+    };
+
+    auto removeObject = [this, &findObject](void* ptr)
+    {
+        if (auto* object = findObject(ptr))
+        {
+            setSelected(object, false);
+            for (auto* connection : object->getConnections()) connections.removeObject(connection);
+            objects.removeObject(object);
+        }
+    };
+
+    for (auto const& event : events)
+    {
+        if (event.canvas != cnv) continue;
+
+        switch (event.type)
+        {
+            case LIBPD_OBJECT_CREATED:
+            {
+                addObject(event.object);
+                break;
+            }
+            case LIBPD_OBJECT_DELETED:
+            {
+                removeObject(event.object);
+                break;
+            }
+            case LIBPD_OBJECT_MOVED:
+            {
+                if (auto* object = alive.contains(event.object) ? findObject(event.object) : nullptr) object->updateBounds();
+                break;
+            }
+            case LIBPD_OBJECT_RETYPED:
+            {
+                if (event.object == event.previous)
+                {
+                    if (auto* object = alive.contains(event.object) ? findObject(event.object) : nullptr) object->updatePorts();
+                    break;
+                }
+                removeObject(event.previous);
+                addObject(event.object);
+                break;
+            }
+            case LIBPD_CONNECTION_ADDED:
+            {
+                if (!alive.contains(&event.src->te_g) || !alive.contains(&event.sink->te_g)) break;
+                if (!canvas_isconnected(cnv, event.src, event.nout, event.sink, event.nin)) break;
+
+                auto* src = findObject(event.src);
+                auto* sink = findObject(event.sink);
+                if (!src || !sink || findConnection(src, event.nout, sink, event.nin)) break;
+
+                if (event.nout >= src->numOutputs || event.nin >= sink->numInputs)
+                {
+                    pd->logError("Error: impossible connection");
+                    break;
+                }
+
+                connections.add(new Connection(this, src->iolets[src->numInputs + event.nout], sink->iolets[event.nin], true));
+                break;
+            }
+            case LIBPD_CONNECTION_REMOVED:
+            {
+                auto* src = findObject(event.src);
+                auto* sink = findObject(event.sink);
+                if (!src || !sink) break;
+
+                if (auto* connection = findConnection(src, event.nout, sink, event.nin)) connections.removeObject(connection);
+                break;
+            }
+            default: break;
+        }
+    }
+
+    storage.confirmIds();
+
+    realiseVisibleObjects();
 
     main.updateCommandStatus();
     repaint();
@@ -313,6 +852,23 @@ void Canvas::updateDrawables()
     }
 }
 
+void Canvas::updateDrawables(std::unordered_set<void*> const& changed)
+{
+    for (auto* object : objects)
+    {
+        if (!object->gui) continue;
+
+        if (changed.count(object->getPointer()))
+        {
+            object->gui->updateDrawables();
+        }
+        else if (auto* graph = object->gui->getCanvas())
+        {
+            graph->updateDrawables(changed);
+        }
+    }
+}
+
 void Canvas::updateGuiValues()
 {
     for (auto* object : objects)
@@ -324,6 +880,23 @@ void Canvas::updateGuiValues()
     }
 }
 
+void Canvas::updateGuiValues(std::unordered_set<void*> const& changed)
+{
+    for (auto* object : objects)
+    {
+        if (!object->gui) continue;
+
+        if (changed.count(object->getPointer()))
+        {
+            object->gui->updateValue();
+        }
+        else if (auto* graph = object->gui->getCanvas())
+        {
+            graph->updateGuiValues(changed);
+        }
+    }
+}
+
 void Canvas::updateGuiParameters()
 {
     for (auto& object : objects)
@@ -418,6 +991,7 @@ void Canvas::mouseDown(const MouseEvent& e)
         popupMenu.addItem(8, "To Front", object != nullptr);
         popupMenu.addSeparator();
         popupMenu.addItem(9, "Help", object != nullptr);
+        popupMenu.addItem(11, "Preview Help", object != nullptr);
         popupMenu.addSeparator();
         popupMenu.addItem(10, "Properties", e.originalComponent == this);
 
@@ -440,6 +1014,9 @@ void Canvas::mouseDown(const MouseEvent& e)
                 case 10:  // Open help
                     main.sidebar.showParameters("canvas", parameters);
                     break;
+                case 11:  // Preview help
+                    object->showHelpPreview();
+                    break;
                 default:
                     break;
             }
@@ -583,6 +1160,13 @@ void Canvas::mouseUp(const MouseEvent& e)
 
 void Canvas::updateSidebarSelection()
 {
+    if (!sidebarUpdater) sidebarUpdater = std::make_unique<SidebarUpdater>(*this);
+}
+
+void Canvas::showSelectionInSidebar()
+{
+    sidebarUpdater.reset();
+
     auto lassoSelection = getSelectionOfType<Object>();
 
     if (lassoSelection.size() == 1)
@@ -609,9 +1193,48 @@ void Canvas::updateSidebarSelection()
     }
 }
 
+void Canvas::setDSPLoad(std::unordered_map<void*, float> const& load)
+{
+    if (load.empty() && dspLoad.empty())
+        return;
+
+    dspLoad = load;
+    repaint();
+
+    auto lassoSelection = getSelectionOfType<Object>();
+    if (lassoSelection.size() == 1 && !dspLoad.empty())
+    {
+        auto it = dspLoad.find(lassoSelection.getFirst()->getPointer());
+        main.sidebar.showDSPLoad(it != dspLoad.end() ? it->second : 0.0f);
+    }
+    else
+    {
+        main.sidebar.showDSPLoad(-1.0f);
+    }
+}
+
 void Canvas::paintOverChildren(Graphics& g)
 {
     Point<float> mousePos = getMouseXYRelative().toFloat();
+
+    // DSP load heat map, the colour saturates at a quarter of the block time
+    if (!dspLoad.empty())
+    {
+        g.setFont(Font(11));
+        for (auto* object : objects)
+        {
+            auto it = dspLoad.find(object->getPointer());
+            if (it == dspLoad.end() || it->second < 0.001f)
+                continue;
+
+            auto bounds = object->getBounds().reduced(Object::margin);
+            g.setColour(Colours::red.withAlpha(jmap(jmin(it->second * 4.0f, 1.0f), 0.1f, 0.6f)));
+            g.fillRoundedRectangle(bounds.toFloat(), 2.0f);
+
+            g.setColour(findColour(PlugDataColour::canvasTextColourId));
+            g.drawText(String(it->second * 100.0f, 1) + "%", bounds.translated(0, -14).withHeight(14), Justification::centredRight);
+        }
+    }
     
     // Draw connections in the making over everything else
     for(auto& iolet : connectingEdges)
@@ -725,19 +1348,95 @@ void Canvas::copySelection()
     }
 
     // Tell pd to copy
-    patch.copy();
+    patch.copy(getSelectedConnectionInfo());
     patch.deselectAll();
 }
 
+std::vector<pd::Clipboard::ConnectionInfo> Canvas::getSelectedConnectionInfo()
+{
+    std::unordered_set<void*> selected;
+    for (auto* object : getSelectionOfType<Object>())
+    {
+        selected.insert(object->getPointer());
+    }
+
+    // pd copies the selected objects in the order of the patch
+    std::unordered_map<void*, int> positions;
+    for (auto* obj : patch.getObjects())
+    {
+        if (selected.count(obj)) positions.emplace(obj, static_cast<int>(positions.size()));
+    }
+
+    std::vector<pd::Clipboard::ConnectionInfo> infos;
+    for (auto* connection : connections)
+    {
+        if (!connection->inobj || !connection->outobj) continue;
+
+        auto in = positions.find(connection->inobj->getPointer());
+        auto out = positions.find(connection->outobj->getPointer());
+        if (in == positions.end() || out == positions.end()) continue;
+
+        auto id = connection->getId();
+        auto path = storage.getInfo(id, "Path");
+        auto segmented = storage.getInfo(id, "Segmented");
+        if (path.isEmpty() && segmented.isEmpty()) continue;
+
+        infos.push_back({ in->second, out->second, connection->inIdx, connection->outIdx, path, segmented });
+    }
+
+    return infos;
+}
+
+void Canvas::restoreConnectionInfo(std::vector<pd::Clipboard::ConnectionInfo> const& infos)
+{
+    if (infos.empty()) return;
+
+    // pd selects what it pasted, in the order it was copied
+    std::vector<int> indices;
+    std::vector<int> numInlets;
+
+    auto pdObjects = patch.getObjects();
+
+    sys_lock();
+    int index = 0;
+    for (auto* obj : pdObjects)
+    {
+        if (glist_isselected(patch.getPointer(), static_cast<t_gobj*>(obj)))
+        {
+            auto* object = pd::Patch::checkObject(obj);
+            indices.push_back(index);
+            numInlets.push_back(object ? libpd_ninlets(object) : 0);
+        }
+        index++;
+    }
+    sys_unlock();
+
+    auto const numPasted = static_cast<int>(indices.size());
+    for (auto const& info : infos)
+    {
+        if (!isPositiveAndBelow(info.inObject, numPasted) || !isPositiveAndBelow(info.outObject, numPasted)) continue;
+
+        auto id = Connection::getId(indices[info.inObject], indices[info.outObject], info.inlet, numInlets[info.outObject] + info.outlet);
+
+        // Part of pasting, which has its own undo step in pd
+        if (info.path.isNotEmpty()) storage.setInfo(id, "Path", info.path, false);
+        if (info.segmented.isNotEmpty()) storage.setInfo(id, "Segmented", info.segmented, false);
+    }
+}
+
 void Canvas::pasteSelection()
 {
     // Tell pd to paste
-    patch.paste();
+    auto const copiedHere = patch.paste();
     
-    int oldSize = objects.size();
+    // Only add what pd reports as new, don't update positions
+    pd->waitForStateUpdate();
 
-    // Load state from pd, don't update positions
-    synchronise(false);
+    // Before the connections are made, they read their info when they're created
+    if (copiedHere) restoreConnectionInfo(pd::Clipboard::get().connections);
+
+    deselectAll();
+    pd->dispatchCanvasEvents();
 
     patch.setCurrent();
     
@@ -756,6 +1455,8 @@ void Canvas::pasteSelection()
 
 void Canvas::duplicateSelection()
 {
+    auto connectionInfo = getSelectedConnectionInfo();
+
     // Tell pd to select all objects that are currently selected
     for (auto* object : getSelectionOfType<Object>())
     {
@@ -765,8 +1466,11 @@ void Canvas::duplicateSelection()
     // Tell pd to duplicate
     patch.duplicate();
 
-    // Load state from pd, don't update positions
-    synchronise(false);
+    // Only add what pd reports as new, don't update positions
+    pd->waitForStateUpdate();
+    restoreConnectionInfo(connectionInfo);
+    deselectAll();
+    pd->dispatchCanvasEvents();
 
     // Select the newly duplicated objects
     for (auto* object : objects)
@@ -828,21 +1532,23 @@ void Canvas::encapsulateSelection()
 {
     auto selectedBoxes = getSelectionOfType<Object>();
     
-    // Sort by index in pd patch
+    // Sort by index in pd patch, pd copies them in that order
+    std::unordered_map<void*, int> pdIndices;
+    int index = 0;
+    for (auto* obj : patch.getObjects()) pdIndices.emplace(obj, index++);
+
+    selectedBoxes.removeIf([&pdIndices](auto* object) { return !pdIndices.count(object->getPointer()); });
+    if (selectedBoxes.isEmpty()) return;
+
     std::sort(selectedBoxes.begin(), selectedBoxes.end(),
-        [this](auto* a, auto* b) -> bool
+        [&pdIndices](auto* a, auto* b) -> bool
     {
-        return objects.indexOf(a) < objects.indexOf(b);
+        return pdIndices[a->getPointer()] < pdIndices[b->getPointer()];
     });
     
     // If two connections have the same target inlet/outlet, we only need 1 [inlet/outlet] object
     auto usedEdges = Array<Iolet*>();
     auto targetEdges = std::map<Iolet*, Array<Iolet*>>();
-        
-    auto newInternalConnections = String();
-    auto newExternalConnections = std::map<int, Array<Iolet*>>();
-    
-    int subpatchIdx = (patch.getIndex(objects.getLast()->getPointer()) + 1) - selectedBoxes.size();
     
     // First, find all the incoming and outgoing connections
     for(auto* connection : connections) {
@@ -865,8 +1571,6 @@ void Canvas::encapsulateSelection()
         }
     }
     
-    auto newEdgeObjects = String();
-
     // Sort by position
     std::sort(usedEdges.begin(), usedEdges.end(),
         [](auto* a, auto* b) -> bool
@@ -884,84 +1588,40 @@ void Canvas::encapsulateSelection()
         return apos.x < bpos.x;
     });
     
-    int i = 0;
-    int numIn = 0;
+    std::vector<t_libpd_encapsulate_edge> edges;
+    std::vector<t_libpd_encapsulate_connection> externalConnections;
+    
     for(auto* iolet : usedEdges)
     {
-        auto type = String(iolet->isInlet ? "inlet" : "outlet") + String(iolet->isSignal ? "~" : "");
-        auto* targetEdge = targetEdges[iolet][0];
-        auto pos = targetEdge->object->getPosition();
-        newEdgeObjects += "#X obj " + String(pos.x) + " " + String(pos.y) + " " + type + ";\n";
-    
-        int objIdx = selectedBoxes.indexOf(iolet->object);
-        int ioletObjectIdx = selectedBoxes.size() + i;
-        if(iolet->isInlet) {
-            newInternalConnections += "#X connect " + String(ioletObjectIdx) + " 0 " + String(objIdx) + " " + String(iolet->ioletIdx) + ";\n";
-            numIn++;
-        }
-        else {
-            newInternalConnections += "#X connect " + String(objIdx) + " " + String(iolet->ioletIdx) + " " + String(ioletObjectIdx) + " 0;\n";
-        }
+        auto pos = targetEdges[iolet][0]->object->getPosition();
+        auto edgeIdx = static_cast<int>(edges.size());
+        edges.push_back({ iolet->isInlet, iolet->isSignal, pos.x, pos.y, selectedBoxes.indexOf(iolet->object), iolet->ioletIdx });
         
         for(auto* target : targetEdges[iolet]) {
-            newExternalConnections[i].add(target);
+            externalConnections.push_back({ edgeIdx, static_cast<t_object*>(target->object->getPointer()), target->ioletIdx });
         }
-        
-        i++;
     }
     
-    patch.deselectAll();
-    
     auto bounds = Rectangle<int>();
     for(auto* object : selectedBoxes) {
-        if(object->getPointer())  {
-            bounds = bounds.getUnion(object->getBounds());
-            patch.selectObject(object->getPointer()); // TODO: do this inside enqueue
-        }
+        bounds = bounds.getUnion(object->getBounds());
     }
     auto centre = bounds.getCentre();
     
-    auto copypasta =
-    String("#N canvas 733 172 450 300 0 1;\n") +
-    "$$_COPY_HERE_$$" +
-    newEdgeObjects +
-    newInternalConnections +
-    "#X restore " + String(centre.x) + " " + String(centre.y) + " pd;\n";
-    
-    // Apply the changed on Pd's thread
-    pd->enqueueFunction([this, copypasta, newExternalConnections, numIn]() mutable {
-        int size;
-        const char* text = libpd_copy(patch.getPointer(), &size);
-        auto copied = String::fromUTF8(text, size);
+    // Apply the changes on Pd's thread, in one go
+    pd->enqueueFunction([this, selected = std::vector<void*>(selectedBoxes.begin(), selectedBoxes.end()), edges, externalConnections, centre]() {
+        auto* cnv = patch.getPointer();
+        glist_noselect(cnv);
+        for (auto* obj : selected) glist_select(cnv, static_cast<t_gobj*>(obj));
         
-        // Wrap it in an undo sequence, to allow undoing everything in 1 step
-        patch.startUndoSequence("encapsulate");
-        
-        libpd_removeselection(patch.getPointer());
-        
-        auto replacement = copypasta.replace("$$_COPY_HERE_$$", copied);
-        SystemClipboard::copyTextToClipboard(replacement);
-        
-        libpd_paste(patch.getPointer(), replacement.toRawUTF8());
-        auto* newObject = static_cast<t_object*>(patch.getObjects().back());
-        
-        for(auto& [idx, iolets] : newExternalConnections) {
-            for(auto* iolet : iolets) {
-                auto* externalObject = static_cast<t_object*>(iolet->object->getPointer());
-                if(iolet->isInlet) {
-                    libpd_createconnection(patch.getPointer(), newObject, idx - numIn, externalObject, iolet->ioletIdx);
-                }
-                else {
-                    libpd_createconnection(patch.getPointer(), externalObject, iolet->ioletIdx, newObject, idx);
-                }
-            }
-        }
-        
-        patch.endUndoSequence("encapsulate");
+        libpd_encapsulate(cnv, centre.x, centre.y, edges.data(), static_cast<int>(edges.size()), externalConnections.data(), static_cast<int>(externalConnections.size()));
+        glist_noselect(cnv);
     });
     
-    synchronise(true);
-    patch.deselectAll();
+    // Only the removed objects, the subpatch and its connections change, pd reports those
+    pd->waitForStateUpdate();
+    deselectAll();
+    pd->dispatchCanvasEvents();
 }
 
 void Canvas::undo()
@@ -992,6 +1652,81 @@ void Canvas::redo()
     patch.deselectAll();
 }
 
+SpatialIndex<Object> const& Canvas::getObjectIndex()
+{
+    if (!objectIndexValid)
+    {
+        objectIndex.clear();
+        for (auto* object : objects)
+        {
+            objectIndex.insert(object, object->getBounds());
+        }
+        objectIndexValid = true;
+    }
+
+    return objectIndex;
+}
+
+SpatialIndex<Connection> const& Canvas::getConnectionIndex()
+{
+    if (!connectionIndexValid)
+    {
+        connectionIndex.clear();
+        for (auto* connection : connections)
+        {
+            connectionIndex.insert(connection, connection->getBounds());
+        }
+        connectionIndexValid = true;
+    }
+
+    return connectionIndex;
+}
+
+void Canvas::updateIndex(Object* object)
+{
+    if (objectIndexValid) objectIndex.insert(object, object->getBounds());
+}
+
+void Canvas::updateIndex(Connection* connection)
+{
+    if (connectionIndexValid) connectionIndex.insert(connection, connection->getBounds());
+}
+
+void Canvas::removeFromIndex(Object* object)
+{
+    objectIndex.remove(object);
+}
+
+void Canvas::removeFromIndex(Connection* connection)
+{
+    connectionIndex.remove(connection);
+}
+
+void Canvas::beginConnectionUpdates()
+{
+    batchingConnectionUpdates = true;
+}
+
+void Canvas::endConnectionUpdates()
+{
+    batchingConnectionUpdates = false;
+
+    for (auto* connection : pendingConnectionUpdates)
+    {
+        connection->applyMovedEnds();
+    }
+
+    pendingConnectionUpdates.clear();
+}
+
+bool Canvas::deferConnectionUpdate(Connection* connection)
+{
+    if (!batchingConnectionUpdates) return false;
+
+    pendingConnectionUpdates.insert(connection);
+    return true;
+}
+
 void Canvas::checkBounds()
 {
     if (isGraph || !viewport) return;
@@ -1039,6 +1774,10 @@ void Canvas::valueChanged(Value& v)
     {
         repaint();
     }
+    else if (v.refersToSameSourceAs(renderCache))
+    {
+        for (auto* object : objects) object->updateRenderCache();
+    }
     // Should only get called when the canvas isn't a real graph
     else if (v.refersToSameSourceAs(presentationMode))
     {
@@ -1184,6 +1923,12 @@ void Canvas::handleMouseUp(Component* component, const MouseEvent& e)
 
         pd->waitForStateUpdate();
         
+        // Routed connections may have to find a way around the objects at their new position
+        for (auto* connection : connections)
+        {
+            connection->rerouteIfNeeded();
+        }
+        
         // Update undo state
         main.updateCommandStatus();
         
@@ -1194,10 +1939,16 @@ void Canvas::handleMouseUp(Component* component, const MouseEvent& e)
     if(objectSnappingInbetween) {
         auto* c = connectionToSnapInbetween.getComponent();
         
-        patch.removeConnection(c->outobj->getPointer(), c->outIdx, c->inobj->getPointer(), c->inIdx);
+        // Reconnect in one go, instead of waiting for pd after every connection
+        pd::Patch::Transaction transaction(patch);
+        auto src = transaction.addObject(c->outobj->getPointer());
+        auto sink = transaction.addObject(c->inobj->getPointer());
+        auto inbetween = transaction.addObject(objectSnappingInbetween->getPointer());
         
-        patch.createConnection(c->outobj->getPointer(), c->outIdx, objectSnappingInbetween->getPointer(), 0);
-        patch.createConnection(objectSnappingInbetween->getPointer(), 0, c->inobj->getPointer(), c->inIdx);
+        transaction.removeConnection(src, c->outIdx, sink, c->inIdx);
+        transaction.createConnection(src, c->outIdx, inbetween, 0);
+        transaction.createConnection(inbetween, 0, sink, c->inIdx);
+        transaction.perform();
         
         objectSnappingInbetween->iolets[0]->isTargeted = false;
         objectSnappingInbetween->iolets[objectSnappingInbetween->numInputs]->isTargeted = false;
@@ -1208,7 +1959,7 @@ void Canvas::handleMouseUp(Component* component, const MouseEvent& e)
     
     for (auto* object : getSelectionOfType<Object>())
     {
-        object->setBufferedToImage(false);
+        object->updateRenderCache();
         object->repaint();
     }
 
@@ -1237,6 +1988,9 @@ void Canvas::handleMouseDrag(const MouseEvent& e)
     
     auto selection = getSelectionOfType<Object>();
 
+    // Connections between moved objects would otherwise update once for every end that moved
+    beginConnectionUpdates();
+    
     for (auto* object : selection)
     {
         // In case we dragged near the iolet and the canvas moved
@@ -1244,6 +1998,8 @@ void Canvas::handleMouseDrag(const MouseEvent& e)
         object->setTopLeftPosition(object->mouseDownPos + dragDistance + canvasMoveOffset);
     }
     
+    endConnectionUpdates();
+    
     // This handles the "unsnap" action when you shift-drag a connected object
     if(e.mods.isShiftDown() && selection.size() == 1 && e.getDistanceFromDragStart() > 15) {
         auto* object = selection.getFirst();
@@ -1358,34 +2114,46 @@ void Canvas::removeSelectedComponent(Component* component)
 
 void Canvas::findLassoItemsInArea(Array<WeakReference<Component>>& itemsFound, const Rectangle<int>& area)
 {
-    for (auto* element : objects)
+    auto deselectOthers = !ModifierKeys::getCurrentModifiers().isAnyModifierKeyDown();
+    
+    Array<Object*> objectsInArea;
+    getObjectIndex().query(area, objectsInArea);
+    
+    for (auto* element : objectsInArea)
     {
-        if (area.intersects(element->getBounds()))
-        {
-            itemsFound.add(element);
-            setSelected(element, true);
-        }
-        else if (!ModifierKeys::getCurrentModifiers().isAnyModifierKeyDown())
-        {
-            setSelected(element, false);
-        }
+        itemsFound.add(element);
+        setSelected(element, true);
     }
-
-    for (auto& con : connections)
+    
+    // If total bounds don't intersect, there can't be an intersection with the line
+    // This is cheaper than checking the path intersection, so do this first
+    Array<Connection*> connectionsInArea;
+    getConnectionIndex().query(lasso.getBounds(), connectionsInArea);
+    
+    std::unordered_set<Connection*> selectedConnections;
+    for (auto* con : connectionsInArea)
     {
-        // If total bounds don't intersect, there can't be an intersection with the line
-        // This is cheaper than checking the path intersection, so do this first
-        if (!con->getBounds().intersects(lasso.getBounds())) continue;
-
         // Check if path intersects with lasso
         if (con->intersects(lasso.getBounds().translated(-con->getX(), -con->getY()).toFloat()))
         {
             itemsFound.add(con);
             setSelected(con, true);
+            selectedConnections.insert(con);
+        }
+    }
+    
+    // Only the selection has to be looked at to deselect what's outside the lasso
+    if (deselectOthers)
+    {
+        std::unordered_set<Object*> selectedObjects(objectsInArea.begin(), objectsInArea.end());
+        
+        for (auto* object : getSelectionOfType<Object>())
+        {
+            if (!selectedObjects.count(object)) setSelected(object, false);
         }
-        else if (!ModifierKeys::getCurrentModifiers().isAnyModifierKeyDown())
+        for (auto* con : getSelectionOfType<Connection>())
         {
-            setSelected(con, false);
+            if (!selectedConnections.count(con)) setSelected(con, false);
         }
     }
 }
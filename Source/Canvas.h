@@ -8,23 +8,30 @@
 
 #include <JuceHeader.h>
 
+#include <unordered_map>
+#include <unordered_set>
+
 #include "Object.h"
 #include "Pd/PdPatch.h"
 #include "Pd/PdStorage.h"
 #include "PluginProcessor.h"
 #include "Utility/ObjectGrid.h"
+#include "Utility/SpatialIndex.h"
 
 class SuggestionComponent;
 struct GraphArea;
 class Iolet;
 class PlugDataPluginEditor;
+struct CanvasLoader;
+struct SidebarUpdater;
 class Canvas : public Component, public Value::Listener, public LassoSource<WeakReference<Component>>
 {    
    public:
     
     bool isBeingDeleted = false;
     
-    Canvas(PlugDataPluginEditor& parent, pd::Patch& patch, Component* parentGraph = nullptr);
+    // Without content, the objects are only made once loadContent is called
+    Canvas(PlugDataPluginEditor& parent, pd::Patch& patch, Component* parentGraph = nullptr, bool withContent = true);
 
     ~Canvas() override;
 
@@ -45,10 +52,43 @@ class Canvas : public Component, public Value::Listener, public LassoSource<Weak
     void mouseMove(const MouseEvent& e) override;
 
     void synchronise(bool updatePosition = true);
+
+    // State of an object as read at the start of synchronise, or nullptr when not synchronising
+    pd::ObjectState const* getObjectState(void* object) const;
+
+    // Lets the objects near the visible area build their content, see ObjectBase::realise
+    void realiseVisibleObjects();
+
+    // Applies the structural changes pd reported for this canvas, instead of comparing everything
+    void applyCanvasEvents(std::vector<pd::CanvasEvent> const& events);
+
+    // Whether the objects of a large patch are still being created, see loadNextBatch
+    bool isLoading() const;
+
+    // The canvas of a tab that isn't shown doesn't need its objects and connections
+    // They're made when the tab is shown, and released again when it wasn't shown for a while
+    bool hasContent() const;
+    void loadContent();
+    void releaseContent();
+
+    // Whether a tab is open for a subpatch inside this patch, which would be closed with the objects
+    bool hasOpenSubpatches() const;
+
+    // Time the tab of this canvas was last shown, in Time::getMillisecondCounterHiRes
+    double lastShown = 0.0;
     
     void updateDrawables();
     void updateGuiValues();
+
+    // Only redraws the scalars that changed, including the ones inside graphs
+    void updateDrawables(std::unordered_set<void*> const& changed);
+
+    // Only updates the objects that changed, including the ones inside graphs
+    void updateGuiValues(std::unordered_set<void*> const& changed);
     void updateGuiParameters();
+
+    // Heat map of the share of the block time each object uses, an empty map turns it off
+    void setDSPLoad(std::unordered_map<void*, float> const& load);
     
     bool keyPressed(const KeyPress& key) override;
     void valueChanged(Value& v) override;
@@ -59,6 +99,11 @@ class Canvas : public Component, public Value::Listener, public LassoSource<Weak
     void removeSelection();
     void pasteSelection();
     void duplicateSelection();
+
+    // Editor info of the connections between the selected objects, which pd doesn't copy
+    std::vector<pd::Clipboard::ConnectionInfo> getSelectedConnectionInfo();
+    // Gives the connections between the objects pd just pasted the info they had when they were copied
+    void restoreConnectionInfo(std::vector<pd::Clipboard::ConnectionInfo> const& infos);
     
     void encapsulateSelection();
 
@@ -67,6 +112,24 @@ class Canvas : public Component, public Value::Listener, public LassoSource<Weak
 
     void checkBounds();
 
+    // Bounds of all objects and connections, to find the ones in an area without looking at all of them
+    SpatialIndex<Object> const& getObjectIndex();
+    SpatialIndex<Connection> const& getConnectionIndex();
+
+    // Called by objects and connections when their bounds change, or when they're deleted
+    void updateIndex(Object* object);
+    void updateIndex(Connection* connection);
+    void removeFromIndex(Object* object);
+    void removeFromIndex(Connection* connection);
+
+    // Between these calls, connections that have to follow a moved object are collected,
+    // and each of them is updated once at the end
+    void beginConnectionUpdates();
+    void endConnectionUpdates();
+
+    // Returns false if the connection should update right away
+    bool deferConnectionUpdate(Connection* connection);
+
     // Multi-dragger functions
     void deselectAll();    
     void setSelected(Component* component, bool shouldNowBeSelected);
@@ -81,6 +144,7 @@ class Canvas : public Component, public Value::Listener, public LassoSource<Weak
     void removeSelectedComponent(Component* component);
     void findLassoItemsInArea(Array<WeakReference<Component>>& itemsFound, const Rectangle<int>& area) override;
 
+    // Shows the selection in the sidebar on the next frame, so changing it many times in a row only updates it once
     void updateSidebarSelection();
 
     void showSuggestions(Object* object, TextEditor* editor);
@@ -116,10 +180,14 @@ class Canvas : public Component, public Value::Listener, public LassoSource<Weak
     OwnedArray<Object> objects;
     OwnedArray<Connection> connections;
 
+    // Read from pd in one go while synchronising, sorted by object
+    std::vector<pd::ObjectState> objectStates;
+
     Value locked;
     Value commandLocked;
     Value presentationMode;
     Value gridEnabled = Value(var(true));
+    Value renderCache = Value(var(false));
 
     
     bool isGraph = false;
@@ -147,7 +215,9 @@ class Canvas : public Component, public Value::Listener, public LassoSource<Weak
     const int minimumMovementToStartDrag = 5;
     Object* componentBeingDragged = nullptr;
     
-    pd::Storage storage;
+    // Shared with the other canvases that show this patch
+    std::shared_ptr<pd::Storage> sharedStorage;
+    pd::Storage& storage;
     
     Point<int> lastMousePosition;
     
@@ -158,6 +228,40 @@ class Canvas : public Component, public Value::Listener, public LassoSource<Weak
     SafePointer<TabbedComponent> tabbar;
 
     LassoComponent<WeakReference<Component>> lasso;
+
+    // Built on the first query, and kept up to date after that
+    SpatialIndex<Object> objectIndex;
+    SpatialIndex<Connection> connectionIndex;
+    bool objectIndexValid = false;
+    bool connectionIndexValid = false;
+
+    // Objects this far outside the visible area are realised too, so they're ready when scrolling
+    static constexpr int realiseMargin = 400;
+
+    bool batchingConnectionUpdates = false;
+
+    // Patches with more objects than this get their objects over several frames, instead of blocking until all exist
+    static constexpr int incrementalLoadThreshold = 500;
+
+    // Time spent creating objects per frame while loading, leaves room for painting at 60 fps
+    static constexpr double loadBudgetMs = 8.0;
+
+    // Creates objects until the time budget is used up, returns the fraction of objects that exist
+    float loadNextBatch();
+    void finishLoading();
+
+    std::unique_ptr<CanvasLoader> loader;
+    friend struct CanvasLoader;
+
+    bool contentLoaded = false;
+
+    void showSelectionInSidebar();
+
+    std::unique_ptr<SidebarUpdater> sidebarUpdater;
+    friend struct SidebarUpdater;
+
+    std::unordered_map<void*, float> dspLoad;
+    std::unordered_set<Connection*> pendingConnectionUpdates;
     
 
     
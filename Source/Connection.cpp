@@ -8,6 +8,10 @@
 #include "Canvas.h"
 #include "Iolet.h"
 #include "LookAndFeel.h"
+#include "Utility/Trace.h"
+#include "Utility/PaintProfiler.h"
+
+#include <queue>
 
 Connection::Connection(Canvas* parent, Iolet* s, Iolet* e, bool exists) : cnv(parent), outlet(s->isInlet ? e : s), inlet(s->isInlet ? s : e), outobj(outlet->object), inobj(inlet->object)
 {
@@ -105,20 +109,28 @@ void Connection::setState(const String& state)
             plan.emplace_back(x + outlet->getCanvasBounds().getCentreX(), y + outlet->getCanvasBounds().getCentreY());
         }
     }
+    // A path that isn't the one we routed was set by the user
+    if (plan != currentPlan) autoRouted = false;
+
     currentPlan = plan;
     updatePath();
 }
 
 String Connection::getId() const
 {
-    MemoryOutputStream stream;
-    
     // TODO: check if connection is still valid before requesting idx from object
     
-    stream.writeInt(cnv->patch.getIndex(inobj->getPointer()));
-    stream.writeInt(cnv->patch.getIndex(outobj->getPointer()));
-    stream.writeInt(inIdx);
-    stream.writeInt(outobj->numInputs + outIdx);
+    return getId(cnv->patch.getIndex(inobj->getPointer()), cnv->patch.getIndex(outobj->getPointer()), inIdx, outobj->numInputs + outIdx);
+}
+
+String Connection::getId(int inObject, int outObject, int inlet, int outlet)
+{
+    MemoryOutputStream stream;
+    
+    stream.writeInt(inObject);
+    stream.writeInt(outObject);
+    stream.writeInt(inlet);
+    stream.writeInt(outlet);
     
     return stream.getMemoryBlock().toBase64Encoding();
 }
@@ -128,6 +140,7 @@ Connection::~Connection()
     if(!cnv->isBeingDeleted) {
         // Ensure there's no pointer to this object in the selection
         cnv->setSelected(this, false);
+        cnv->removeFromIndex(this);
     }
     
     if (outlet)
@@ -203,6 +216,8 @@ bool Connection::intersects(Rectangle<float> toCheck, int accuracy) const
 }
 void Connection::paint(Graphics& g)
 {
+    PaintProfiler::Scope profilerScope(*this, g);
+
     auto baseColour = findColour(PlugDataColour::connectionColourId);
     auto dataColour = findColour(PlugDataColour::dataColourId);
     auto signalColour = findColour(PlugDataColour::signalColourId);
@@ -218,14 +233,27 @@ void Connection::paint(Graphics& g)
         baseColour = baseColour.brighter(0.6f);
     }
     
+    // Stroking is the expensive part, so only do it again when the shape changed
+    if (toDraw != strokedPath)
+    {
+        strokedPath = toDraw;
+        
+        float const thickness[] = {2.5f, 1.5f, 0.5f};
+        for (int i = 0; i < numStrokes; i++)
+        {
+            strokes[i].clear();
+            PathStrokeType(thickness[i], PathStrokeType::mitered, PathStrokeType::square).createStrokedPath(strokes[i], toDraw);
+        }
+    }
+    
     g.setColour(baseColour.darker(0.1));
-    g.strokePath(toDraw, PathStrokeType(2.5f, PathStrokeType::mitered, PathStrokeType::square));
+    g.fillPath(strokes[0]);
     
     g.setColour(baseColour.darker(0.2));
-    g.strokePath(toDraw, PathStrokeType(1.5f, PathStrokeType::mitered, PathStrokeType::square));
+    g.fillPath(strokes[1]);
     
     g.setColour(baseColour);
-    g.strokePath(toDraw, PathStrokeType(0.5f, PathStrokeType::mitered, PathStrokeType::square));
+    g.fillPath(strokes[2]);
     
     if (cnv->isSelected(this))
     {
@@ -336,6 +364,8 @@ void Connection::mouseDrag(const MouseEvent& e)
     
     if (isSegmented() && dragIdx != -1)
     {
+        autoRouted = false;
+        
         auto n = dragIdx;
         auto delta = e.getPosition() - e.getMouseDownPosition();
         auto line = Line<int>(currentPlan[n - 1], currentPlan[n]);
@@ -450,6 +480,28 @@ void Connection::componentMovedOrResized(Component& component, bool wasMoved, bo
 {
     if (!inlet || !outlet) return;
     
+    if (&component == inlet || &component == inobj)
+    {
+        inletMoved = true;
+    }
+    else
+    {
+        outletMoved = true;
+    }
+    
+    // While dragging, the canvas updates us once after all objects have moved
+    if (cnv->deferConnectionUpdate(this)) return;
+    
+    applyMovedEnds();
+}
+
+void Connection::applyMovedEnds()
+{
+    auto moveStart = std::exchange(outletMoved, false);
+    auto moveEnd = std::exchange(inletMoved, false);
+    
+    if (!inlet || !outlet) return;
+    
     auto pstart = getStartPoint();
     auto pend = getEndPoint();
     
@@ -468,27 +520,29 @@ void Connection::componentMovedOrResized(Component& component, bool wasMoved, bo
         return;
     }
     
-    int idx1 = 0;
-    int idx2 = 1;
-    
-    auto& position = pstart;
-    if (&component == inlet || &component == inobj)
+    auto moveEndPoint = [this](int idx1, int idx2, Point<int> position)
     {
-        idx1 = static_cast<int>(currentPlan.size() - 1);
-        idx2 = static_cast<int>(currentPlan.size() - 2);
-        position = pend;
-    }
+        if (Line<int>(currentPlan[idx1], currentPlan[idx2]).isVertical())
+        {
+            currentPlan[idx2].x = position.x;
+        }
+        else
+        {
+            currentPlan[idx2].y = position.y;
+        }
+        
+        currentPlan[idx1] = position;
+    };
     
-    if (Line<int>(currentPlan[idx1], currentPlan[idx2]).isVertical())
+    if (moveStart)
     {
-        currentPlan[idx2].x = position.x;
+        moveEndPoint(0, 1, pstart);
     }
-    else
+    if (moveEnd)
     {
-        currentPlan[idx2].y = position.y;
+        moveEndPoint(static_cast<int>(currentPlan.size() - 1), static_cast<int>(currentPlan.size() - 2), pend);
     }
     
-    currentPlan[idx1] = position;
     updatePath();
 }
 
@@ -591,6 +645,7 @@ void Connection::updatePath()
     
     auto bounds = toDraw.getBounds().toNearestInt().expanded(8);
     setBounds(bounds + origin);
+    cnv->updateIndex(this);
     
     if (bounds.getX() < 0 || bounds.getY() < 0)
     {
@@ -605,61 +660,43 @@ void Connection::updatePath()
 
 void Connection::findPath()
 {
+    TRACE_ZONE("Connection::findPath");
+
     if (!outlet || !inlet) return;
     
     auto pstart = getStartPoint();
     auto pend = getEndPoint();
     
-    auto pathStack = PathPlan();
-    auto bestPath = PathPlan();
-    
-    pathStack.reserve(8);
-    
-    auto numFound = 0;
-    
-    int incrementX, incrementY;
-    
     auto distance = pstart.getDistanceFrom(pend);
-    auto distanceX = std::abs(pstart.x - pend.x);
-    auto distanceY = std::abs(pstart.y - pend.y);
-    
-    int maxXResolution = std::min(distanceX / 10, 14);
-    int maxYResolution = std::min(distanceY / 10, 14);
     
-    int resolutionX = 6;
-    int resolutionY = 6;
+    // Obstacles around the straight route, with some room for detours
+    auto searchBounds = Rectangle<int>(pstart, pend).expanded(routeMargin);
     
-    auto obstacles = Array<Rectangle<int>>();
-    auto searchBounds = Rectangle<int>(pstart, pend);
+    Array<Object*> nearby;
+    Array<Rectangle<int>> nearbyBounds;
+    cnv->getObjectIndex().query(searchBounds, nearby, &nearbyBounds);
     
-    for(auto* object : cnv->objects) {
-        if(object->getBounds().intersects(searchBounds)) {
-            obstacles.add(object->getBounds());
-        }
-    }
+    Array<Rectangle<int>> obstacles;
     
-    // Look for paths at an increasing resolution
-    while (!numFound && resolutionX < maxXResolution && distance > 40)
+    // Only route again if the ends or the obstacles have changed since the last time
+    auto key = static_cast<size_t>(pstart.x) * 73856093 ^ static_cast<size_t>(pstart.y) * 19349663 ^ static_cast<size_t>(pend.x) * 83492791 ^ static_cast<size_t>(pend.y);
+    for (int i = 0; i < nearby.size(); i++)
     {
+        if (nearby[i] == outobj || nearby[i] == inobj) continue;
         
-        // Find paths on a resolution*resolution lattice ObjectGrid
-        incrementX = distanceX / resolutionX;
-        incrementY = distanceY / resolutionY;
-        
-        numFound = findLatticePaths(bestPath, pathStack, pend, pstart, {incrementX, incrementY});
-        
-        if(resolutionX < maxXResolution) resolutionX++;
-        if(resolutionY < maxXResolution) resolutionY++;
-        
-        if(resolutionX > maxXResolution || resolutionY > maxYResolution) break;
-        
-        pathStack.clear();
+        auto const& b = nearbyBounds.getReference(i);
+        obstacles.add(b);
+        key = key * 31 + (static_cast<size_t>(b.getX()) * 73856093 ^ static_cast<size_t>(b.getY()) * 19349663 ^ static_cast<size_t>(b.getWidth()) * 83492791 ^ static_cast<size_t>(b.getHeight()));
     }
     
+    if (autoRouted && key == routeKey && !currentPlan.empty()) return;
+    
+    auto bestPath = distance > 40 ? findRoute(pstart, pend, obstacles) : PathPlan();
+    
     PathPlan simplifiedPath;
     
     bool direction;
-    if (!bestPath.empty())
+    if (bestPath.size() > 1)
     {
         simplifiedPath.push_back(bestPath.front());
         
@@ -705,151 +742,181 @@ void Connection::findPath()
     std::reverse(simplifiedPath.begin(), simplifiedPath.end());
     
     currentPlan = simplifiedPath;
+    routeKey = key;
+    autoRouted = true;
     
     auto state = getState();
     lastId = getId();
     cnv->storage.setInfo(lastId, "Path", state);
 }
 
-int Connection::findLatticePaths(PathPlan& bestPath, PathPlan& pathStack, Point<int> pstart, Point<int> pend, Point<int> increment)
+void Connection::rerouteIfNeeded()
 {
+    if (!autoRouted || !isSegmented()) return;
     
-    auto obstacles = Array<Object*>();
-    auto searchBounds = Rectangle<int>(pstart, pend);
+    auto previousPlan = currentPlan;
+    findPath();
     
-    for(auto* object : cnv->objects) {
-        if(object->getBounds().intersects(searchBounds)) {
-            obstacles.add(object);
-        }
-    }
+    if (currentPlan != previousPlan) updatePath();
+}
+
+PathPlan Connection::findRoute(Point<int> pstart, Point<int> pend, Array<Rectangle<int>> const& obstacles)
+{
+    // A* search on a lattice that has both ends on it, from the outlet to the inlet
+    // The cost is the length of the path plus a penalty for every corner
+    auto const distanceX = std::abs(pstart.x - pend.x);
+    auto const distanceY = std::abs(pstart.y - pend.y);
     
-    // Stop after we've found a path
-    if (!bestPath.empty()) return 0;
+    auto const stepsX = distanceX > 0 ? std::clamp(distanceX / 10, 1, 64) : 0;
+    auto const stepsY = distanceY > 0 ? std::clamp(distanceY / 10, 1, 64) : 0;
     
-    // Add point to path
-    pathStack.push_back(pstart);
+    auto const stepX = stepsX > 0 ? static_cast<float>(distanceX) / stepsX : 10.0f;
+    auto const stepY = stepsY > 0 ? static_cast<float>(distanceY) / stepsY : 10.0f;
     
-    // Check if it intersects any object
-    if (pathStack.size() > 1 && straightLineIntersectsObject(Line<int>(pathStack.back(), *(pathStack.end() - 2)), obstacles))
-    {
-        return 0;
-    }
+    auto const marginX = std::clamp(roundToInt(routeMargin / stepX), 2, 16);
+    auto const marginY = std::clamp(roundToInt(routeMargin / stepY), 2, 16);
+    
+    auto const width = stepsX + 2 * marginX + 1;
+    auto const height = stepsY + 2 * marginY + 1;
     
-    bool endVertically = pathStack[0].y > pend.y;
+    auto const minX = static_cast<float>(std::min(pstart.x, pend.x));
+    auto const minY = static_cast<float>(std::min(pstart.y, pend.y));
     
-    // Check if we've reached the destination
-    if (std::abs(pstart.x - pend.x) < (increment.x * 0.5) && std::abs(pstart.y - pend.y) < (increment.y * 0.5))
+    auto pointAt = [&](int i, int j)
     {
-        bestPath = pathStack;
-        return 1;
-    }
+        return Point<int>(roundToInt(minX + (i - marginX) * stepX), roundToInt(minY + (j - marginY) * stepY));
+    };
     
-    // Count the number of found paths
-    int count = 0;
+    auto const startI = marginX + (pstart.x > pend.x ? stepsX : 0);
+    auto const startJ = marginY + (pstart.y > pend.y ? stepsY : 0);
+    auto const endI = marginX + (pend.x > pstart.x ? stepsX : 0);
+    auto const endJ = marginY + (pend.y > pstart.y ? stepsY : 0);
     
-    // Get current stack to revert to after each trial
-    auto pathCopy = pathStack;
+    // Edges to the right and downward neighbour that cross an obstacle
+    std::vector<uint8> blockedRight(width * height, 0);
+    std::vector<uint8> blockedDown(width * height, 0);
     
-    auto followLine = [this, &count, &pathCopy, &bestPath, &pathStack, &increment](Point<int> currentOutlet, Point<int> currentInlet, bool isX)
-    {
-        auto& coord1 = isX ? currentOutlet.x : currentOutlet.y;
-        auto& coord2 = isX ? currentInlet.x : currentInlet.y;
-        auto& incr = isX ? increment.x : increment.y;
-        
-        if (std::abs(coord1 - coord2) >= incr)
-        {
-            coord1 > coord2 ? coord1 -= incr : coord1 += incr;
-            count += findLatticePaths(bestPath, pathStack, currentOutlet, currentInlet, increment);
-            pathStack = pathCopy;
-        }
-    };
+    auto column = [&](float x) { return (x - minX) / stepX + marginX; };
+    auto row = [&](float y) { return (y - minY) / stepY + marginY; };
     
-    // If we're halfway on the axis, change preferred direction by inverting search order
-    // This will make it do a staircase effect
-    if (endVertically)
+    for (auto const& obstacle : obstacles)
     {
-        if (std::abs(pstart.y - pend.y) >= std::abs(pathStack[0].y - pend.y) * 0.5)
+        auto b = obstacle.expanded(4).toFloat();
+        
+        // Lattice points inside the obstacle
+        auto const i1 = std::max(0, static_cast<int>(std::ceil(column(b.getX()))));
+        auto const i2 = std::min(width - 1, static_cast<int>(std::floor(column(b.getRight()))));
+        auto const j1 = std::max(0, static_cast<int>(std::ceil(row(b.getY()))));
+        auto const j2 = std::min(height - 1, static_cast<int>(std::floor(row(b.getBottom()))));
+        
+        // Edges that start before the obstacle also cross it
+        for (int j = j1; j <= j2; j++)
         {
-            followLine(pstart, pend, false);
-            followLine(pstart, pend, true);
+            for (int i = std::max(0, i1 - 1); i <= i2 && i < width - 1; i++) blockedRight[i * height + j] = 1;
         }
-        else
+        for (int i = i1; i <= i2; i++)
         {
-            followLine(pstart, pend, true);
-            followLine(pstart, pend, false);
+            for (int j = std::max(0, j1 - 1); j <= j2 && j < height - 1; j++) blockedDown[i * height + j] = 1;
         }
     }
-    else
+    
+    enum Direction { Up, Down, Left, Right };
+    constexpr int di[] = {0, 0, -1, 1};
+    constexpr int dj[] = {-1, 1, 0, 0};
+    
+    auto const cornerCost = 20.0f + std::max(stepX, stepY);
+    
+    auto canMove = [&](int i, int j, int dir)
     {
-        if (std::abs(pstart.x - pend.x) >= std::abs(pathStack[0].x - pend.x) * 0.5)
-        {
-            followLine(pstart, pend, true);
-            followLine(pstart, pend, false);
-        }
-        else
+        switch (dir)
         {
-            followLine(pstart, pend, false);
-            followLine(pstart, pend, true);
+            case Up: return j > 0 && !blockedDown[i * height + j - 1];
+            case Down: return j < height - 1 && !blockedDown[i * height + j];
+            case Left: return i > 0 && !blockedRight[(i - 1) * height + j];
+            default: return i < width - 1 && !blockedRight[i * height + j];
         }
-    }
+    };
     
-    return count;
-}
-
-bool Connection::intersectsObject(Object* object)
-{
-    auto b = (object->getBounds() - getPosition()).toFloat();
-    return toDraw.intersectsLine({b.getTopLeft(), b.getTopRight()})
-    || toDraw.intersectsLine({b.getTopLeft(), b.getBottomLeft()})
-    || toDraw.intersectsLine({b.getBottomRight(), b.getBottomLeft()})
-    || toDraw.intersectsLine({b.getBottomRight(), b.getTopRight()});
-}
-
-
-bool Connection::straightLineIntersectsObject(Line<int> toCheck, Array<Object*>& objects)
-{
+    auto heuristic = [&](int i, int j)
+    {
+        return std::abs(i - endI) * stepX + std::abs(j - endJ) * stepY;
+    };
+    
+    auto const numStates = width * height * 4;
+    std::vector<float> cost(numStates, std::numeric_limits<float>::max());
+    std::vector<int> previous(numStates, -1);
+    
+    using Entry = std::pair<float, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
     
-    for (const auto& object : objects)
+    // Leave the outlet going down
+    auto const startState = (startI * height + startJ) * 4 + Down;
+    cost[startState] = 0.0f;
+    open.push({heuristic(startI, startJ), startState});
+    
+    int bestState = -1;
+    float bestCost = std::numeric_limits<float>::max();
+    
+    while (!open.empty())
     {
-        auto bounds = object->getBounds().expanded(1);
+        auto [estimate, state] = open.top();
+        open.pop();
         
-        if (object == outobj || object == inobj || !bounds.intersects(getBounds())) continue;
+        if (estimate >= bestCost) break;
         
-        auto intersectV = [](Line<int> first, Line<int> second)
+        auto const dir = state % 4;
+        auto const node = state / 4;
+        auto const i = node / height;
+        auto const j = node % height;
+        
+        if (i == endI && j == endJ)
         {
-            if (first.getStartY() > first.getEndY())
+            // Prefer to enter the inlet from above
+            auto const total = cost[state] + (dir == Down ? 0.0f : cornerCost);
+            if (total < bestCost)
             {
-                first = {first.getEnd(), first.getStart()};
+                bestCost = total;
+                bestState = state;
             }
-            
-            return first.getStartX() > second.getStartX() && first.getStartX() < second.getEndX() && second.getStartY() > first.getStartY() && second.getStartY() < first.getEndY();
-        };
+            continue;
+        }
         
-        auto intersectH = [](Line<int> first, Line<int> second)
+        for (int next = 0; next < 4; next++)
         {
-            if (first.getStartX() > first.getEndX())
+            // Never turn back
+            if (next == (dir ^ 1)) continue;
+            if (!canMove(i, j, next)) continue;
+            
+            auto const ni = i + di[next];
+            auto const nj = j + dj[next];
+            auto const nextState = (ni * height + nj) * 4 + next;
+            auto const nextCost = cost[state] + (next < 2 ? stepY : stepX) + (next == dir ? 0.0f : cornerCost);
+            
+            if (nextCost < cost[nextState])
             {
-                first = {first.getEnd(), first.getStart()};
+                cost[nextState] = nextCost;
+                previous[nextState] = state;
+                open.push({nextCost + heuristic(ni, nj), nextState});
             }
-            
-            return first.getStartY() > second.getStartY() && first.getStartY() < second.getEndY() && second.getStartX() > first.getStartX() && second.getStartX() < first.getEndX();
-        };
-        
-        bool intersectsV = toCheck.isVertical() && (intersectV(toCheck, Line<int>(bounds.getTopLeft(), bounds.getTopRight())) || intersectV(toCheck, Line<int>(bounds.getBottomRight(), bounds.getBottomLeft())));
-        
-        bool intersectsH = toCheck.isHorizontal() && (intersectH(toCheck, Line<int>(bounds.getTopRight(), bounds.getBottomRight())) || intersectH(toCheck, Line<int>(bounds.getTopLeft(), bounds.getBottomLeft())));
-        if (intersectsV || intersectsH)
-        {
-            return true;
         }
-        
-        /*
-         if(bounds.toFloat().intersects(toCheck.toFloat())) {
-         return true;
-         } TODO: benchmark these two options */
-        // TODO: possible mark areas that have already been visited?
     }
     
-    return false;
+    // Walk back from the inlet, which gives the path from the inlet to the outlet
+    PathPlan path;
+    for (int state = bestState; state >= 0; state = previous[state])
+    {
+        auto const node = state / 4;
+        path.push_back(pointAt(node / height, node % height));
+    }
+    
+    return path;
 }
 
+bool Connection::intersectsObject(Object* object)
+{
+    auto b = (object->getBounds() - getPosition()).toFloat();
+    return toDraw.intersectsLine({b.getTopLeft(), b.getTopRight()})
+    || toDraw.intersectsLine({b.getTopLeft(), b.getBottomLeft()})
+    || toDraw.intersectsLine({b.getBottomRight(), b.getBottomLeft()})
+    || toDraw.intersectsLine({b.getBottomRight(), b.getTopRight()});
+}
@@ -18,7 +18,7 @@ extern "C"
 using PathPlan = std::vector<Point<int>>;
 
 class Canvas;
-class Connection : public Component, public ComponentListener
+class Connection : public Component, public ComponentListener, public Recycled
 {
    public:
     int inIdx;
@@ -58,18 +58,30 @@ class Connection : public Component, public ComponentListener
 
     String getId() const;
 
+    // Id of a connection by the index of its objects in the patch, outlets are counted after the inlets of their object
+    static String getId(int inObject, int outObject, int inlet, int outlet);
+
     String getState();
     void setState(const String& block);
 
     void componentMovedOrResized(Component& component, bool wasMoved, bool wasResized) override;
 
-    // Pathfinding
-    int findLatticePaths(PathPlan& bestPath, PathPlan& pathStack, Point<int> start, Point<int> end, Point<int> increment);
+    // Makes the path follow the ends that moved since the last call
+    void applyMovedEnds();
 
+    // Pathfinding
     void findPath();
 
+    // Routes again if the path was found by findPath, and an obstacle near it has changed
+    void rerouteIfNeeded();
+
+    // Makes the next findPath route again, even if nothing changed
+    void invalidateRoute()
+    {
+        autoRouted = false;
+    }
+
     bool intersectsObject(Object* object);
-    bool straightLineIntersectsObject(Line<int> toCheck, Array<Object*>& objects);
 
    private:
     bool wasSelected = false;
@@ -81,6 +93,23 @@ class Connection : public Component, public ComponentListener
 
     PathPlan currentPlan;
 
+    // Outlines of the strokes that make up the cord, and the path they were made from
+    static constexpr int numStrokes = 3;
+    Path strokes[numStrokes];
+    Path strokedPath;
+
+    bool outletMoved = false;
+    bool inletMoved = false;
+
+    static PathPlan findRoute(Point<int> start, Point<int> end, Array<Rectangle<int>> const& obstacles);
+
+    // Room around the direct route that the router may use for detours
+    static constexpr int routeMargin = 80;
+
+    // Set while currentPlan is the one findPath found, for the obstacles hashed into routeKey
+    bool autoRouted = false;
+    size_t routeKey = 0;
+
     Value locked;
 
     Canvas* cnv;
@@ -67,71 +67,238 @@ struct PackageSorter {
     }
 };
 
+// Lower case copies of the fields that a search looks at, made once when the package list comes in
+//! @details A search is one pass over the index, every package lands in the bucket of the best way it matches,
+//! so there's no sorting and no checking for duplicates. Within a bucket the packages keep the order of the list.
+struct PackageIndex {
+    struct Entry {
+        String name, description, author;
+        StringArray objects;
+    };
+    
+    PackageIndex() = default;
+    
+    explicit PackageIndex(PackageList const& packages)
+    {
+        entries.reserve(packages.size());
+        
+        for (auto const& package : packages) {
+            Entry entry { package.name.toLowerCase(), package.description.toLowerCase(), package.author.toLowerCase(), {} };
+            for (auto const& object : package.objects) {
+                entry.objects.add(object.toLowerCase());
+            }
+            entries.push_back(std::move(entry));
+        }
+    }
+    
+    // Indices into the package list of the packages that match the query, best matches first
+    std::vector<int> search(String const& query) const
+    {
+        auto const lowerQuery = query.toLowerCase();
+        
+        std::array<std::vector<int>, numRanks> buckets;
+        
+        for (int i = 0; i < static_cast<int>(entries.size()); i++) {
+            auto const rank = getRank(entries[i], lowerQuery);
+            if (rank < numRanks) {
+                buckets[rank].push_back(i);
+            }
+        }
+        
+        std::vector<int> result;
+        for (auto& bucket : buckets) {
+            result.insert(result.end(), bucket.begin(), bucket.end());
+        }
+        
+        return result;
+    }
+    
+private:
+    // Name starts with the query, name contains it, description, object name, author, part of an object name, and letters of the name in order
+    static constexpr int numRanks = 7;
+    
+    static int getRank(Entry const& entry, String const& query)
+    {
+        if (entry.name.startsWith(query))
+            return 0;
+        if (entry.name.contains(query))
+            return 1;
+        if (entry.description.contains(query))
+            return 2;
+        if (entry.objects.contains(query))
+            return 3;
+        if (entry.author.contains(query))
+            return 4;
+        
+        for (auto const& object : entry.objects) {
+            if (object.contains(query))
+                return 5;
+        }
+        
+        if (isSubsequence(query, entry.name))
+            return 6;
+        
+        return numRanks;
+    }
+    
+    // Whether all characters of query are in text in the same order, for typos like "cyclne"
+    static bool isSubsequence(String const& query, String const& text)
+    {
+        auto q = query.getCharPointer();
+        auto t = text.getCharPointer();
+        
+        while (!q.isEmpty()) {
+            while (!t.isEmpty() && *t != *q)
+                ++t;
+            
+            if (t.isEmpty())
+                return false;
+            
+            ++q;
+            ++t;
+        }
+        
+        return true;
+    }
+    
+    std::vector<Entry> entries;
+};
+
 struct PackageManager : public Thread
 , public ActionBroadcaster
 , public ValueTree::Listener
 , public DeletedAtShutdown {
     
-    struct DownloadTask : public Thread {
+    // Downloads a package to disk, resuming where it stopped if the connection drops, and installs it
+    struct DownloadTask : public ThreadPoolJob {
         PackageManager& manager;
         PackageInfo packageInfo;
         
-        std::unique_ptr<InputStream> instream;
-        
         DownloadTask(PackageManager& m, PackageInfo& info)
-        : Thread("Download Thread")
+        : ThreadPoolJob("Download " + info.name)
         , manager(m)
         , packageInfo(info)
         {
-            int statusCode = 0;
-            instream = URL(info.url).createInputStream(URL::InputStreamOptions(URL::ParameterHandling::inAddress)
-                                                       .withConnectionTimeoutMs(5000)
-                                                       .withStatusCode(&statusCode));
+        };
+        
+        JobStatus runJob() override
+        {
+            // Continue on pipe errors
+#ifndef _MSC_VER
+            signal(SIGPIPE, SIG_IGN);
+#endif
             
-            if (instream != nullptr && statusCode == 200) {
-                startThread(3);
-            } else {
-                finish(Result::fail("Failed to start download"));
-                return;
+            auto result = download();
+            
+            if (result.wasOk()) {
+                result = extract();
             }
-        };
+            
+            finish(result);
+            return jobHasFinished;
+        }
         
-        ~DownloadTask()
+        // Partially downloaded packages are kept until they're installed, so a new attempt can resume them
+        File getPartialFile() const
         {
-            stopThread(-1);
+            return filesystem.getChildFile(".downloads").getChildFile(String::toHexString(packageInfo.packageId.hashCode64()) + ".part");
         }
         
-        void run() override
+        Result download()
         {
-            MemoryBlock dekData;
+            auto const partialFile = getPartialFile();
+            partialFile.getParentDirectory().createDirectory();
             
-            int64 totalBytes = instream->getTotalLength();
-            int64 bytesDownloaded = 0;
-            
-            MemoryOutputStream mo(dekData, true);
-            
-            while (true) {
-                if (threadShouldExit()) {
-                    finish(Result::fail("Download cancelled"));
-                    return;
+            for (int attempt = 0; attempt < maxAttempts; attempt++) {
+                if (shouldExit()) {
+                    return Result::fail("Download cancelled");
                 }
                 
-                auto written = mo.writeFromInputStream(*instream, 8192);
+                if (attempt > 0) {
+                    Thread::sleep(1000 * attempt);
+                }
                 
-                if (written == 0)
-                    break;
+                auto const resumePosition = partialFile.getSize();
                 
-                bytesDownloaded += written;
+                int statusCode = 0;
+                auto options = URL::InputStreamOptions(URL::ParameterHandling::inAddress)
+                                   .withConnectionTimeoutMs(5000)
+                                   .withStatusCode(&statusCode);
                 
-                float progress = static_cast<long double>(bytesDownloaded) / static_cast<long double>(totalBytes);
+                if (resumePosition > 0) {
+                    options = options.withExtraHeaders("Range: bytes=" + String(resumePosition) + "-");
+                }
+                
+                auto instream = URL(packageInfo.url).createInputStream(options);
                 
-                MessageManager::callAsync([this, progress]() mutable {
-                    onProgress(progress);
-                });
+                if (instream == nullptr) {
+                    continue;
+                }
+                
+                // The part we have doesn't match what the server has, start over
+                if (statusCode == 416) {
+                    partialFile.deleteFile();
+                    continue;
+                }
+                
+                if (statusCode != 200 && statusCode != 206) {
+                    return Result::fail("Failed to start download");
+                }
+                
+                FileOutputStream output(partialFile);
+                if (!output.openedOk()) {
+                    return Result::fail("Failed to write download");
+                }
+                
+                // Servers that don't support ranges send the whole file again
+                if (statusCode == 200) {
+                    output.setPosition(0);
+                    output.truncate();
+                }
+                
+                auto const offset = output.getPosition();
+                auto const remainingBytes = instream->getTotalLength();
+                auto const totalBytes = remainingBytes < 0 ? -1 : offset + remainingBytes;
+                int lastPercentage = -1;
+                
+                while (!instream->isExhausted()) {
+                    if (shouldExit()) {
+                        return Result::fail("Download cancelled");
+                    }
+                    
+                    if (output.writeFromInputStream(*instream, 8192) == 0) {
+                        break;
+                    }
+                    
+                    if (totalBytes > 0) {
+                        auto const progress = static_cast<float>(static_cast<long double>(output.getPosition()) / static_cast<long double>(totalBytes));
+                        
+                        // Only tell the UI when there's something new to show
+                        if (auto const percentage = static_cast<int>(progress * 100.0f); percentage != lastPercentage) {
+                            lastPercentage = percentage;
+                            MessageManager::callAsync([this, progress]() mutable {
+                                onProgress(progress);
+                            });
+                        }
+                    }
+                }
+                
+                output.flush();
+                
+                if (instream->isExhausted() && (totalBytes < 0 || output.getPosition() == totalBytes)) {
+                    return Result::ok();
+                }
             }
             
-            MemoryInputStream input(dekData, false);
-            ZipFile zip(input);
+            return Result::fail("Download failed, try again to continue it");
+        }
+        
+        Result extract()
+        {
+            auto const partialFile = getPartialFile();
+            
+            // Reads the entries straight from the downloaded file, one at a time
+            ZipFile zip(partialFile);
             
             /* This check produces false positives sometimes, so I've disabled it
              if (zip.getNumEntries() == 0) {
@@ -140,17 +307,27 @@ struct PackageManager : public Thread
              } */
             
             auto extractedPath = filesystem.getChildFile(packageInfo.name).getFullPathName();
-            auto result = zip.uncompressTo(filesystem);
             
-            if (!result.wasOk()) {
-                finish(result);
-                return;
+            for (int i = 0; i < zip.getNumEntries(); i++) {
+                if (shouldExit()) {
+                    return Result::fail("Download cancelled");
+                }
+                
+                auto result = zip.uncompressEntry(i, filesystem);
+                
+                if (!result.wasOk()) {
+                    // A broken file can't be resumed
+                    partialFile.deleteFile();
+                    return result;
+                }
             }
             
+            partialFile.deleteFile();
+            
             // Tell deken about the newly installed package
             manager.addPackageToRegister(packageInfo, extractedPath);
             
-            finish(Result::ok());
+            return Result::ok();
         }
         
         void finish(Result result)
@@ -159,7 +336,7 @@ struct PackageManager : public Thread
                                       [this, result]() mutable {
                                           // Make sure lambda still exists after deletion
                                           auto finishCopy = onFinish;
-                                          waitForThreadToExit(-1);
+                                          manager.downloadPool.waitForJobToFinish(this, -1);
                                           
                                           // Self-destruct
                                           manager.downloads.removeObject(this);
@@ -170,6 +347,8 @@ struct PackageManager : public Thread
         
         std::function<void(float)> onProgress;
         std::function<void(Result)> onFinish;
+        
+        static constexpr int maxAttempts = 5;
     };
     
     PackageManager()
@@ -196,6 +375,7 @@ struct PackageManager : public Thread
     {
         if (webstream)
             webstream->cancel();
+        downloadPool.removeAllJobs(true, -1);
         downloads.clear();
         stopThread(500);
         clearSingletonInstance();
@@ -213,10 +393,20 @@ struct PackageManager : public Thread
 #ifndef _MSC_VER
         signal(SIGPIPE, SIG_IGN);
 #endif
-        allPackages = getAvailablePackages();
+        setPackages(getAvailablePackages());
         sendActionMessage("");
     }
     
+    // Replaces the package list and its search index, the index is built before taking the lock
+    void setPackages(PackageList packages)
+    {
+        auto index = PackageIndex(packages);
+        
+        ScopedLock lock(packageLock);
+        allPackages = std::move(packages);
+        packageIndex = std::move(index);
+    }
+    
     PackageList getAvailablePackages()
     {
         
@@ -227,17 +417,57 @@ struct PackageManager : public Thread
         auto triplet = os + "-" + machine + "-" + floatsize;
         auto repoForArchitecture = "https://raw.githubusercontent.com/timothyschoen/PlugDataDekenServer/main/bin/" + triplet + ".bin";
         
+        // Show the index we got last time, while checking if there is a newer one
+        MemoryBlock cachedIndex;
+        if (indexFile.loadFileAsData(cachedIndex) && cachedIndex.getSize() > 0) {
+            setPackages(parsePackages(cachedIndex));
+            sendActionMessage("");
+        }
+        
         webstream = std::make_unique<WebInputStream>(URL(repoForArchitecture), false);
+        
+        // The server only sends the index again if it changed
+        auto etag = indexTagFile.loadFileAsString();
+        if (cachedIndex.getSize() > 0 && etag.isNotEmpty()) {
+            webstream->withExtraHeaders("If-None-Match: " + etag);
+        }
+        
         webstream->connect(nullptr);
         
-        if (webstream->isError()) {
+        if (webstream->isError() || (webstream->getStatusCode() != 200 && webstream->getStatusCode() != 304)) {
+            if (cachedIndex.getSize() > 0) {
+                return getPackages();
+            }
+            
             sendActionMessage("Failed to connect to server");
             return {};
         }
         
+        if (webstream->getStatusCode() == 304) {
+            return getPackages();
+        }
+        
         MemoryBlock block;
         webstream->readIntoMemoryBlock(block);
         
+        if (block.getSize() == 0) {
+            return getPackages();
+        }
+        
+        indexFile.replaceWithData(block.getData(), block.getSize());
+        indexTagFile.replaceWithText(webstream->getResponseHeaders()["ETag"]);
+        
+        return parsePackages(block);
+    }
+    
+    PackageList getPackages()
+    {
+        ScopedLock lock(packageLock);
+        return allPackages;
+    }
+    
+    static PackageList parsePackages(MemoryBlock const& block)
+    {
         // Parse tree that was downloaded
         auto tree = ValueTree::readFromData(block.getData(), block.getSize());
         
@@ -296,7 +526,9 @@ struct PackageManager : public Thread
     {
         // Make sure https is used
         packageInfo.url = packageInfo.url.replaceFirstOccurrenceOf("http://", "https://");
-        return downloads.add(new DownloadTask(*this, packageInfo));
+        auto* task = downloads.add(new DownloadTask(*this, packageInfo));
+        downloadPool.addJob(task, false);
+        return task;
     }
     
     void addPackageToRegister(PackageInfo const& info, String path)
@@ -323,7 +555,7 @@ struct PackageManager : public Thread
     }
     
     // Checks if the current package is already being downloaded
-    DownloadTask* getDownloadForPackage(PackageInfo& info)
+    DownloadTask* getDownloadForPackage(PackageInfo const& info)
     {
         for (auto* download : downloads) {
             if (download->packageInfo == info) {
@@ -334,7 +566,10 @@ struct PackageManager : public Thread
         return nullptr;
     }
     
+    // Written by the thread and read by the dialog, always together with its index
+    CriticalSection packageLock;
     PackageList allPackages;
+    PackageIndex packageIndex;
     
     inline static File filesystem = File::getSpecialLocation(File::SpecialLocationType::userApplicationDataDirectory).getChildFile("PlugData").getChildFile("Deken");
     
@@ -344,9 +579,16 @@ struct PackageManager : public Thread
     // Package state tree, keeps track of which packages are installed and saves it to pkgInfo
     ValueTree packageState = ValueTree("pkg_info");
     
-    // Thread for unzipping and installing packages
+    // Cached package index, and the tag the server sent with it
+    File indexFile = filesystem.getChildFile(".index");
+    File indexTagFile = filesystem.getChildFile(".index_etag");
+    
+    // Packages that are being downloaded and installed
     OwnedArray<DownloadTask> downloads;
     
+    // Only a few downloads run at the same time, the others wait for their turn
+    ThreadPool downloadPool { 3 };
+    
     std::unique_ptr<WebInputStream> webstream;
     
     static inline const String floatsize = String(PD_FLOATSIZE);
@@ -557,17 +799,31 @@ public:
     {
     }
     
+    // The list box only asks for the visible rows, their components are reused while scrolling and searching
     Component* refreshComponentForRow(int rowNumber, bool isRowSelected, Component* existingComponentToUpdate) override
     {
-        delete existingComponentToUpdate;
+        PackageInfo* info = nullptr;
         
         if (isPositiveAndBelow(rowNumber, packageManager->downloads.size())) {
-            return new DekenRowComponent(*this, packageManager->downloads[rowNumber]->packageInfo);
+            info = &packageManager->downloads[rowNumber]->packageInfo;
         } else if (isPositiveAndBelow(rowNumber - packageManager->downloads.size(), searchResult.size())) {
-            return new DekenRowComponent(*this, searchResult.getReference(rowNumber - packageManager->downloads.size()));
+            info = &searchResult.getReference(rowNumber - packageManager->downloads.size());
         }
         
-        return nullptr;
+        if (!info) {
+            delete existingComponentToUpdate;
+            return nullptr;
+        }
+        
+        if (auto* row = dynamic_cast<DekenRowComponent*>(existingComponentToUpdate)) {
+            if (!(row->packageInfo == *info)) {
+                row->setPackage(*info);
+            }
+            return row;
+        }
+        
+        delete existingComponentToUpdate;
+        return new DekenRowComponent(*this, *info);
     }
     
     void filterResults()
@@ -606,55 +862,20 @@ public:
             return;
         }
         
-        auto& allPackages = packageManager->allPackages;
-        
-        // First check for name match
-        for (auto const& result : allPackages) {
-            if (result.name.contains(query)) {
-                newResult.addIfNotAlreadyThere(result);
-            }
-        }
-        
-        // Then check for description match
-        for (auto const& result : allPackages) {
-            if (result.description.contains(query)) {
-                newResult.addIfNotAlreadyThere(result);
-            }
-        }
-        
-        // Then check for object match
-        for (auto const& result : allPackages) {
-            if (result.objects.contains(query)) {
-                newResult.addIfNotAlreadyThere(result);
-            }
-        }
-        
-        // Then check for author match
-        for (auto const& result : allPackages) {
-            if (result.author.contains(query)) {
-                newResult.addIfNotAlreadyThere(result);
-            }
-        }
-        
-        // Then check for object close match
-        for (auto const& result : allPackages) {
-            for (auto const& obj : result.objects) {
-                if (obj.contains(query)) {
-                    newResult.addIfNotAlreadyThere(result);
+        {
+            ScopedLock lock(packageManager->packageLock);
+            
+            auto const& allPackages = packageManager->allPackages;
+            for (auto const index : packageManager->packageIndex.search(query)) {
+                auto const& package = allPackages.getReference(index);
+                
+                // Downloads are already always visible, so filter them out here
+                if (!packageManager->getDownloadForPackage(package)) {
+                    newResult.add(package);
                 }
             }
         }
         
-        // Downloads are already always visible, so filter them out here
-        newResult.removeIf([this](PackageInfo const& package) {
-            for (const auto* download : packageManager->downloads) {
-                if (download->packageInfo == package) {
-                    return true;
-                }
-            }
-            return false;
-        });
-        
         searchResult = newResult;
         listBox.updateContent();
     }
@@ -763,10 +984,17 @@ private:
             };
             
             addToPathButton.setClickingTogglesState(true);
+            
+            setPackage(info);
+        }
+        
+        // Shows another package, when the list box reuses this row
+        void setPackage(PackageInfo& info)
+        {
+            packageInfo = info;
+            
             auto state = packageState.getChildWithProperty("ID", packageInfo.packageId);
-            if(state.hasProperty("AddToPath")) {
-                addToPathButton.setToggleState(static_cast<bool>(state.getProperty("AddToPath")), dontSendNotification);
-            }
+            addToPathButton.setToggleState(state.hasProperty("AddToPath") && static_cast<bool>(state.getProperty("AddToPath")), dontSendNotification);
             
             // Check if package is already installed
             setInstalled(deken.packageManager->packageExists(packageInfo));
@@ -779,18 +1007,21 @@ private:
         
         void attachToDownload(PackageManager::DownloadTask* task)
         {
-            task->onProgress = [_this = SafePointer(this)](float progress) {
-                if (!_this)
+            // The row may show another package by the time the download reports
+            task->onProgress = [_this = SafePointer(this), packageId = task->packageInfo.packageId](float progress) {
+                if (!_this || _this->packageInfo.packageId != packageId)
                     return;
                 _this->installProgress = progress;
                 _this->repaint();
             };
             
-            task->onFinish = [_this = SafePointer(this), task](Result result) {
+            task->onFinish = [_this = SafePointer(this), packageId = task->packageInfo.packageId](Result result) {
                 if (!_this)
                     return;
                 
-                if (result.wasOk()) {
+                if (_this->packageInfo.packageId != packageId) {
+                    _this->deken.filterResults();
+                } else if (result.wasOk()) {
                     _this->setInstalled(result);
                     _this->deken.filterResults();
                 } else {
@@ -2,6 +2,7 @@
 #include "SearchPathComponent.h"
 #include "KeyMappingComponent.h"
 #include "../Utility/PropertiesPanel.h"
+#include "../Utility/Trace.h"
 
 struct ColourProperties : public Component, public Value::Listener
 {
@@ -221,9 +222,14 @@ struct DAWAudioSettings : public Component, public Value::Listener {
     {
         addAndMakeVisible(latencyNumberBox);
         addAndMakeVisible(tailLengthNumberBox);
+        addAndMakeVisible(autoSleepToggle);
+        addAndMakeVisible(numParametersNumberBox);
         addAndMakeVisible(nativeDialogToggle);
+        addAndMakeVisible(blockSizeCombo);
         
         dynamic_cast<DraggableNumber*>(latencyNumberBox.label.get())->setMinimum(64);
+        dynamic_cast<DraggableNumber*>(numParametersNumberBox.label.get())->setMinimum(0);
+        dynamic_cast<DraggableNumber*>(numParametersNumberBox.label.get())->setMaximum(PlugDataAudioProcessor::numParameters);
         
         auto* proc = dynamic_cast<PlugDataAudioProcessor*>(&processor);
         auto& settingsTree = dynamic_cast<PlugDataAudioProcessor&>(p).settingsTree;
@@ -234,12 +240,21 @@ struct DAWAudioSettings : public Component, public Value::Listener {
         
         tailLengthValue.referTo(proc->tailLength);
         nativeDialogValue.referTo(settingsTree.getPropertyAsValue("NativeDialog", nullptr));
+        autoSleepValue = static_cast<bool>(settingsTree.getProperty("AutoSleep"));
+        numParametersValue = static_cast<int>(settingsTree.getProperty("NumParameters", PlugDataAudioProcessor::numParameters));
+
+        // Item n is 64 << (n - 1) samples
+        auto const blockSize = static_cast<int>(settingsTree.getProperty("InternalBlockSize", 64));
+        blockSizeValue = findHighestSetBit(static_cast<uint32>(std::max(blockSize, 64) / 64)) + 1;
         
         tailLengthValue.addListener(this);
+        autoSleepValue.addListener(this);
+        numParametersValue.addListener(this);
         latencyValue.addListener(this);
         nativeDialogValue.addListener(this);
+        blockSizeValue.addListener(this);
         
-        latencyValue = proc->getLatencySamples();
+        latencyValue = proc->getBaseLatency();
         
     }
 
@@ -248,14 +263,29 @@ struct DAWAudioSettings : public Component, public Value::Listener {
         auto bounds = getLocalBounds();
         latencyNumberBox.setBounds(bounds.removeFromTop(23));
         tailLengthNumberBox.setBounds(bounds.removeFromTop(23));
+        autoSleepToggle.setBounds(bounds.removeFromTop(23));
+        numParametersNumberBox.setBounds(bounds.removeFromTop(23));
         nativeDialogToggle.setBounds(bounds.removeFromTop(23));
+        blockSizeCombo.setBounds(bounds.removeFromTop(23));
     }
     
     
     void valueChanged(Value& v) override
     {
         if(v.refersToSameSourceAs(latencyValue)) {
-            processor.setLatencySamples(static_cast<int>(latencyValue.getValue()));
+            dynamic_cast<PlugDataAudioProcessor&>(processor).setBaseLatency(static_cast<int>(latencyValue.getValue()));
+        }
+        else if(v.refersToSameSourceAs(tailLengthValue)) {
+            dynamic_cast<PlugDataAudioProcessor&>(processor).setTailLength(static_cast<float>(tailLengthValue.getValue()));
+        }
+        else if(v.refersToSameSourceAs(autoSleepValue)) {
+            dynamic_cast<PlugDataAudioProcessor&>(processor).setAutoSleep(static_cast<bool>(autoSleepValue.getValue()));
+        }
+        else if(v.refersToSameSourceAs(numParametersValue)) {
+            dynamic_cast<PlugDataAudioProcessor&>(processor).setNumAutomationParameters(static_cast<int>(numParametersValue.getValue()));
+        }
+        else if(v.refersToSameSourceAs(blockSizeValue)) {
+            dynamic_cast<PlugDataAudioProcessor&>(processor).setInternalBlockSize(64 << (static_cast<int>(blockSizeValue.getValue()) - 1));
         }
     }
     
@@ -269,10 +299,116 @@ struct DAWAudioSettings : public Component, public Value::Listener {
     Value latencyValue;
     Value tailLengthValue;
     Value nativeDialogValue;
+
+    // Silent instances stop their DSP after the tail, so a session full of idle ones costs little
+    Value autoSleepValue;
+
+    // For instances created after changing it
+    Value numParametersValue;
+
+    // Larger blocks are cheaper for effects where latency doesn't matter
+    Value blockSizeValue;
     
     PropertiesPanel::EditableComponent<int> latencyNumberBox = PropertiesPanel::EditableComponent<int>("Latency (samples)", latencyValue, 0);
     PropertiesPanel::EditableComponent<float> tailLengthNumberBox = PropertiesPanel::EditableComponent<float>("Tail Length (seconds)", tailLengthValue, 1);
-    PropertiesPanel::BoolComponent nativeDialogToggle = PropertiesPanel::BoolComponent("Use Native Dialog", tailLengthValue, 2,  {"No", "Yes"});
+    PropertiesPanel::BoolComponent autoSleepToggle = PropertiesPanel::BoolComponent("Sleep when silent", autoSleepValue, 2, { "No", "Yes" });
+    PropertiesPanel::EditableComponent<int> numParametersNumberBox = PropertiesPanel::EditableComponent<int>("Parameters (new instances)", numParametersValue, 3);
+    PropertiesPanel::BoolComponent nativeDialogToggle = PropertiesPanel::BoolComponent("Use Native Dialog", tailLengthValue, 4,  {"No", "Yes"});
+    PropertiesPanel::ComboComponent blockSizeCombo = PropertiesPanel::ComboComponent("Block size", blockSizeValue, 5, { "64", "128", "256", "512", "1024" });
+};
+
+// The standalone's device settings, with the options that only make sense when plugdata owns the device
+struct StandaloneAudioSettings : public Component, public Value::Listener {
+    StandaloneAudioSettings(AudioProcessor& p, AudioDeviceManager& manager)
+        : processor(p)
+        , deviceSelector(manager, 1, 2, 1, 2, true, true, true, false)
+        , lowLatencyValue(static_cast<bool>(dynamic_cast<PlugDataAudioProcessor&>(p).settingsTree.getProperty("LowLatency")))
+    {
+        addAndMakeVisible(deviceSelector);
+        addAndMakeVisible(lowLatencyToggle);
+
+        lowLatencyValue.addListener(this);
+    }
+
+    void resized() override
+    {
+        auto bounds = getLocalBounds();
+        lowLatencyToggle.setBounds(bounds.removeFromBottom(23));
+        deviceSelector.setBounds(bounds);
+    }
+
+    void valueChanged(Value& v) override
+    {
+        if (v.refersToSameSourceAs(lowLatencyValue)) {
+            dynamic_cast<PlugDataAudioProcessor&>(processor).setLowLatency(static_cast<bool>(lowLatencyValue.getValue()));
+        }
+    }
+
+    AudioProcessor& processor;
+    AudioDeviceSelectorComponent deviceSelector;
+
+    // Only has an effect when the buffer size is a multiple of pd's block size
+    Value lowLatencyValue;
+    PropertiesPanel::BoolComponent lowLatencyToggle = PropertiesPanel::BoolComponent("Low latency", lowLatencyValue, 0, { "No", "Yes" });
+};
+
+// Records what the audio, message and GUI threads are doing, to be opened in chrome://tracing or Perfetto
+struct DiagnosticsPanel : public Component, public Value::Listener {
+    DiagnosticsPanel()
+    {
+        tracingValue = Trace::isEnabled();
+        tracingValue.addListener(this);
+        addAndMakeVisible(tracingToggle);
+
+        saveButton.setConnectedEdges(12);
+        saveButton.onClick = [this]() {
+            saveChooser = std::make_unique<FileChooser>("Save trace", File::getSpecialLocation(File::userDesktopDirectory).getChildFile("plugdata-trace.json"), "*.json", wantsNativeDialog());
+            saveChooser->launchAsync(FileBrowserComponent::saveMode | FileBrowserComponent::warnAboutOverwriting,
+                [](FileChooser const& fc) {
+                    if (fc.getResult() == File {})
+                        return;
+
+                    if (!Trace::writeChromeTrace(fc.getResult()))
+                        AlertWindow::showMessageBoxAsync(MessageBoxIconType::WarningIcon, "Save trace", "Couldn't write " + fc.getResult().getFullPathName());
+                });
+        };
+        addAndMakeVisible(saveButton);
+
+        clearButton.setConnectedEdges(12);
+        clearButton.onClick = []() { Trace::clear(); };
+        addAndMakeVisible(clearButton);
+    }
+
+    void resized() override
+    {
+        auto bounds = getLocalBounds();
+        tracingToggle.setBounds(bounds.removeFromTop(23));
+
+        auto buttons = bounds.removeFromTop(30).reduced(6, 4);
+        saveButton.setBounds(buttons.removeFromLeft(100));
+        buttons.removeFromLeft(6);
+        clearButton.setBounds(buttons.removeFromLeft(100));
+    }
+
+    void valueChanged(Value& v) override
+    {
+        if (v.refersToSameSourceAs(tracingValue)) {
+            Trace::setEnabled(static_cast<bool>(tracingValue.getValue()));
+        }
+    }
+
+    void paint(Graphics& g) override
+    {
+        PlugDataLook::paintStripes(g, 23, 23, *this, -1, 0, true);
+    }
+
+    Value tracingValue;
+    PropertiesPanel::BoolComponent tracingToggle = PropertiesPanel::BoolComponent("Record Trace", tracingValue, 0, { "No", "Yes" });
+
+    TextButton saveButton = TextButton("Save trace...");
+    TextButton clearButton = TextButton("Clear");
+
+    std::unique_ptr<FileChooser> saveChooser;
 };
 
 struct SettingsDialog : public Component {
@@ -282,14 +418,14 @@ struct SettingsDialog : public Component {
     {
         setVisible(false);
 
-        toolbarButtons = { new TextButton(Icons::Audio), new TextButton(Icons::Pencil), new TextButton(Icons::Search), new TextButton(Icons::Keyboard), new TextButton(Icons::Externals)};
+        toolbarButtons = { new TextButton(Icons::Audio), new TextButton(Icons::Pencil), new TextButton(Icons::Search), new TextButton(Icons::Keyboard), new TextButton(Icons::Externals), new TextButton(Icons::Info)};
 
         currentPanel = std::clamp(lastPanel.load(), 0, toolbarButtons.size() - 1);
 
         auto* editor = dynamic_cast<ApplicationCommandManager*>(processor.getActiveEditor());
 
         if (manager) {
-            panels.add(new AudioDeviceSelectorComponent(*manager, 1, 2, 1, 2, true, true, true, false));
+            panels.add(new StandaloneAudioSettings(processor, *manager));
         } else {
             panels.add(new DAWAudioSettings(processor));
         }
@@ -299,6 +435,7 @@ struct SettingsDialog : public Component {
         panels.add(new SearchPathComponent(settingsTree.getChildWithName("Paths")));
         panels.add(new KeyMappingComponent(*editor->getKeyMappings()));
         panels.add(new Deken());
+        panels.add(new DiagnosticsPanel());
 
         for (int i = 0; i < toolbarButtons.size(); i++) {
             toolbarButtons[i]->setClickingTogglesState(true);
@@ -319,7 +456,7 @@ struct SettingsDialog : public Component {
     ~SettingsDialog() override
     {
         lastPanel = currentPanel;
-        dynamic_cast<PlugDataAudioProcessor*>(&audioProcessor)->saveSettings();
+        dynamic_cast<PlugDataAudioProcessor*>(&audioProcessor)->saveSettingsAsync();
     }
 
     void resized() override
@@ -400,11 +537,15 @@ struct SettingsPopup : public PopupMenu {
     settingsTree(tree),
     themeSelector(tree),
     zoomSelector(tree),
-    gridSelector(tree, "GridEnabled", "Enable grid")
+    gridSelector(tree, "GridEnabled", "Enable grid"),
+    renderCacheSelector(tree, "RenderCache", "Cache rendering"),
+    hardwareAccelerationSelector(tree, "HardwareAcceleration", "Use GPU")
     {
         addCustomItem(1, themeSelector, 70, 45, false);
         addCustomItem(2, zoomSelector, 70, 30, false);
         addCustomItem(3, gridSelector, 70, 30, false);
+        addCustomItem(6, renderCacheSelector, 70, 30, false);
+        addCustomItem(7, hardwareAccelerationSelector, 70, 30, false);
         
         addSeparator();
         addItem(4, "Settings");
@@ -600,6 +741,8 @@ struct SettingsPopup : public PopupMenu {
     
     ThemeSelector themeSelector;
     PopupToggleComponent gridSelector;
+    PopupToggleComponent renderCacheSelector;
+    PopupToggleComponent hardwareAccelerationSelector;
     ZoomSelector zoomSelector;
 
     
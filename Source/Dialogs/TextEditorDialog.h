@@ -227,18 +227,31 @@ private:
 };
 
 /**
- This class wraps a StringArray and memoizes the evaluation of glyph
- arrangements derived from the associated strings.
+ This class stores lines of text and memoizes the evaluation of glyph
+ arrangements derived from them. The lines are kept in blocks of at most
+ maxBlockSize lines, so inserting or removing a line only moves the lines of
+ one block, and finding a line is a binary search over the blocks. Each block
+ also remembers the extent of its lines, so after an edit only the blocks that
+ changed are measured again.
  */
 class GlyphArrangementArray {
 public:
-    int size() const { return lines.size(); }
-    void clear() { lines.clear(); }
-    void add(String const& string) { lines.add(string); }
-    void insert(int index, String const& string) { lines.insert(index, string); }
-    void removeRange(int startIndex, int numberToRemove) { lines.removeRange(startIndex, numberToRemove); }
+    /** The rows that aren't empty and the width of the widest one. */
+    struct Extent {
+        int firstRow = -1;
+        int lastRow = -1;
+        float width = 0.f;
+    };
+
+    int size() const { return numLines; }
+    void clear();
+    void add(String const& string) { insert(numLines, string); }
+    void insert(int index, String const& string);
+    void removeRange(int startIndex, int numberToRemove);
     String const& operator[](int index) const;
 
+    Extent getExtent() const;
+
     int getToken(int row, int col, int defaultIfOutOfBounds) const;
     void clearTokens(int index);
     void applyTokens(int index, Selection zone);
@@ -247,6 +260,26 @@ public:
         int token,
         bool withTrailingSpace = false) const;
 
+    /** Draw the cached glyphs of a line, without copying them. */
+    void drawLine(Graphics& g, int index, float baseline) const;
+
+    /** Glyphs and width of a line, laid out away from the message thread. */
+    struct Layout {
+        int index;
+        String string;
+        GlyphArrangement glyphs;
+        GlyphArrangement glyphsWithTrailingSpace;
+        float width;
+    };
+
+    static Layout createLayout(Font const& font, int index, String const& string);
+
+    /** Install a layout, unless the line or the font changed since it was made. */
+    void setLayout(Layout& layout, int layoutGeneration);
+
+    /** Changes whenever the font changes or all lines are replaced. */
+    int getGeneration() const { return generation; }
+
 private:
     friend class TextDocument;
     friend class PlugDataTextEditor;
@@ -255,6 +288,9 @@ private:
 
     void ensureValid(int index) const;
     void invalidateAll();
+    void setEstimateWidths(bool shouldEstimate);
+
+    static constexpr int maxBlockSize = 512;
 
     struct Entry {
         Entry() { }
@@ -266,10 +302,34 @@ private:
         GlyphArrangement glyphsWithTrailingSpace;
         GlyphArrangement glyphs;
         Array<int> tokens;
+        float width = -1.f; // Not measured yet when negative
         bool glyphsAreDirty = true;
         bool tokensAreDirty = true;
     };
-    mutable Array<Entry> lines;
+
+    struct Block {
+        Array<Entry> entries;
+        mutable Extent extent; // Rows relative to the block
+        mutable bool extentIsDirty = true;
+    };
+
+    /** Return the block that contains the line, and the line's position in it. */
+    std::pair<int, int> locate(int index) const;
+    Entry& getEntry(int index) const;
+
+    /** Recompute where the blocks start, from the given block on. */
+    void updateBlockStarts(int fromBlock);
+
+    std::vector<std::unique_ptr<Block>> blocks;
+    std::vector<int> blockStarts;
+    int numLines = 0;
+
+    mutable Extent cachedExtent;
+    mutable bool extentIsDirty = true;
+
+    // While the lines are laid out in the background, lines that weren't measured yet are estimated
+    bool estimateWidths = false;
+    int generation = 0;
 };
 
 class TextDocument {
@@ -368,6 +428,7 @@ public:
     {
         font = fontToUse;
         lines.font = fontToUse;
+        lines.invalidateAll();
     }
 
     StringArray getText() const;
@@ -430,6 +491,9 @@ public:
      */
     GlyphArrangement findGlyphsIntersecting(Rectangle<float> area, int token = -1) const;
 
+    /** Draw the rows intersecting the given area from their cached glyphs. */
+    void drawRowsIntersecting(Graphics& g, Rectangle<float> area) const;
+
     /** Return the range of rows intersecting the given rectangle. */
     Range<int> getRangeOfRowsIntersecting(Rectangle<float> area) const;
 
@@ -511,7 +575,6 @@ private:
     friend class PlugDataTextEditor;
 
     float lineSpacing = 1.25f;
-    mutable Rectangle<float> cachedBounds;
     GlyphArrangementArray lines;
     Font font;
     Array<Selection> selections;
@@ -531,7 +594,12 @@ private:
     void timerCallback() override;
     Array<Rectangle<float>> getCaretRectangles() const;
 
+    /** Repaint where the carets were and where they are now. */
+    void repaintCarets();
+
     float phase = 0.f;
+    float alpha = 1.f;
+    Array<Rectangle<int>> caretAreas;
     TextDocument const& document;
     AffineTransform transform;
 };
@@ -601,6 +669,12 @@ public:
     bool hasChanged() const { return changed; }
 
 private:
+    class LayoutJob;
+
+    /** Lay out all lines on the layout pool, after the text or the font changed. */
+    void startLayout();
+    void layoutFinished(int generation);
+
     bool insert(String const& content);
     void updateViewTransform();
     void updateSelections();
@@ -627,6 +701,9 @@ private:
     Point<float> translation;
     AffineTransform transform;
     UndoManager undo;
+
+    int numLayoutJobs = 0;
+    ThreadPool layoutPool { jlimit(1, 4, SystemStats::getNumCpus() - 1) };
 };
 
 // IMPLEMENTATIONS
@@ -643,18 +720,32 @@ Caret::Caret(TextDocument const& document)
 void Caret::setViewTransform(AffineTransform const& transformToUse)
 {
     transform = transformToUse;
-    repaint();
+    repaintCarets();
 }
 
 void Caret::updateSelections()
 {
     phase = 0.f;
-    repaint();
+    alpha = 1.f;
+    repaintCarets();
+}
+
+void Caret::repaintCarets()
+{
+    for (auto const& area : caretAreas)
+        repaint(area);
+
+    caretAreas.clearQuick();
+    for (auto const& r : getCaretRectangles())
+        caretAreas.add(r.getSmallestIntegerContainer());
+
+    for (auto const& area : caretAreas)
+        repaint(area);
 }
 
 void Caret::paint(Graphics& g)
 {
-    g.setColour(getParentComponent()->findColour(CaretComponent::caretColourId).withAlpha(squareWave(phase)));
+    g.setColour(getParentComponent()->findColour(CaretComponent::caretColourId).withAlpha(alpha));
 
     for (auto const& r : getCaretRectangles())
         g.fillRect(r);
@@ -671,8 +762,14 @@ void Caret::timerCallback()
 {
     phase += 3.2e-1;
 
-    for (auto const& r : getCaretRectangles())
-        repaint(r.getSmallestIntegerContainer());
+    // The wave is flat most of the time, only repaint when the caret looks different
+    auto const newAlpha = std::round(squareWave(phase) * 32.f) / 32.f;
+    if (newAlpha == alpha || !isShowing())
+        return;
+
+    alpha = newAlpha;
+    for (auto const& area : caretAreas)
+        repaint(area);
 }
 
 Array<Rectangle<float>> Caret::getCaretRectangles() const
@@ -981,10 +1078,172 @@ void Selection::push(Point<int>& index) const
     }
 }
 
+void GlyphArrangementArray::clear()
+{
+    blocks.clear();
+    blockStarts.clear();
+    numLines = 0;
+    extentIsDirty = true;
+    generation++;
+}
+
+void GlyphArrangementArray::insert(int index, String const& string)
+{
+    index = jlimit(0, numLines, index);
+
+    if (blocks.empty()) {
+        blocks.push_back(std::make_unique<Block>());
+        blockStarts.push_back(0);
+    }
+
+    auto [blockIndex, offset] = index == numLines ? std::make_pair(static_cast<int>(blocks.size()) - 1, numLines - blockStarts.back()) : locate(index);
+    auto& block = *blocks[blockIndex];
+
+    block.entries.insert(offset, Entry(string));
+    block.extentIsDirty = true;
+    numLines++;
+
+    // Split full blocks in half
+    if (block.entries.size() > maxBlockSize) {
+        auto second = std::make_unique<Block>();
+        auto const half = block.entries.size() / 2;
+
+        second->entries.ensureStorageAllocated(maxBlockSize);
+        for (int i = half; i < block.entries.size(); i++)
+            second->entries.add(std::move(block.entries.getReference(i)));
+
+        block.entries.removeLast(block.entries.size() - half);
+        blocks.insert(blocks.begin() + blockIndex + 1, std::move(second));
+        blockStarts.insert(blockStarts.begin() + blockIndex + 1, 0);
+    }
+
+    updateBlockStarts(blockIndex + 1);
+    extentIsDirty = true;
+}
+
+void GlyphArrangementArray::removeRange(int startIndex, int numberToRemove)
+{
+    startIndex = jlimit(0, numLines, startIndex);
+    numberToRemove = jlimit(0, numLines - startIndex, numberToRemove);
+
+    if (numberToRemove == 0)
+        return;
+
+    auto [blockIndex, offset] = locate(startIndex);
+    auto const firstBlock = blockIndex;
+
+    while (numberToRemove > 0) {
+        auto& block = *blocks[blockIndex];
+        auto const count = jmin(numberToRemove, block.entries.size() - offset);
+
+        block.entries.removeRange(offset, count);
+        block.extentIsDirty = true;
+        numLines -= count;
+        numberToRemove -= count;
+
+        if (block.entries.isEmpty()) {
+            blocks.erase(blocks.begin() + blockIndex);
+            blockStarts.erase(blockStarts.begin() + blockIndex);
+        } else {
+            blockIndex++;
+        }
+
+        offset = 0;
+    }
+
+    // Merge what's left of the first block with the next one, so removals don't leave lots of small blocks
+    if (isPositiveAndBelow(firstBlock + 1, static_cast<int>(blocks.size()))) {
+        auto& block = *blocks[firstBlock];
+        auto& next = *blocks[firstBlock + 1];
+
+        if (block.entries.size() + next.entries.size() <= maxBlockSize) {
+            for (auto& entry : next.entries)
+                block.entries.add(std::move(entry));
+
+            block.extentIsDirty = true;
+            blocks.erase(blocks.begin() + firstBlock + 1);
+            blockStarts.erase(blockStarts.begin() + firstBlock + 1);
+        }
+    }
+
+    updateBlockStarts(jmax(0, firstBlock));
+    extentIsDirty = true;
+}
+
+std::pair<int, int> GlyphArrangementArray::locate(int index) const
+{
+    jassert(isPositiveAndBelow(index, numLines));
+
+    auto it = std::upper_bound(blockStarts.begin(), blockStarts.end(), index);
+    auto const blockIndex = static_cast<int>(std::distance(blockStarts.begin(), it)) - 1;
+    return { blockIndex, index - blockStarts[blockIndex] };
+}
+
+GlyphArrangementArray::Entry& GlyphArrangementArray::getEntry(int index) const
+{
+    auto [blockIndex, offset] = locate(index);
+    return blocks[blockIndex]->entries.getReference(offset);
+}
+
+void GlyphArrangementArray::updateBlockStarts(int fromBlock)
+{
+    auto start = fromBlock > 0 ? blockStarts[fromBlock - 1] + blocks[fromBlock - 1]->entries.size() : 0;
+
+    for (int i = fromBlock; i < static_cast<int>(blocks.size()); i++) {
+        blockStarts[i] = start;
+        start += blocks[i]->entries.size();
+    }
+}
+
+GlyphArrangementArray::Extent GlyphArrangementArray::getExtent() const
+{
+    if (!extentIsDirty)
+        return cachedExtent;
+
+    Extent extent;
+    auto const characterWidth = estimateWidths ? font.getStringWidthFloat("M") : 0.f;
+
+    for (size_t i = 0; i < blocks.size(); i++) {
+        auto& block = *blocks[i];
+
+        // Measured without laying out the glyphs, so rows that are never shown aren't cached
+        if (block.extentIsDirty) {
+            block.extent = {};
+            for (int row = 0; row < block.entries.size(); row++) {
+                auto& entry = block.entries.getReference(row);
+                if (entry.string.isEmpty())
+                    continue;
+
+                if (block.extent.firstRow < 0)
+                    block.extent.firstRow = row;
+
+                if (entry.width < 0.f && !estimateWidths)
+                    entry.width = font.getStringWidthFloat(entry.string);
+
+                block.extent.lastRow = row;
+                block.extent.width = jmax(block.extent.width, entry.width < 0.f ? characterWidth * entry.string.length() : entry.width);
+            }
+            block.extentIsDirty = false;
+        }
+
+        if (block.extent.firstRow < 0)
+            continue;
+
+        if (extent.firstRow < 0)
+            extent.firstRow = blockStarts[i] + block.extent.firstRow;
+
+        extent.lastRow = blockStarts[i] + block.extent.lastRow;
+        extent.width = jmax(extent.width, block.extent.width);
+    }
+
+    extentIsDirty = false;
+    return cachedExtent = extent;
+}
+
 String const& GlyphArrangementArray::operator[](int index) const
 {
-    if (isPositiveAndBelow(index, lines.size())) {
-        return lines.getReference(index).string;
+    if (isPositiveAndBelow(index, numLines)) {
+        return getEntry(index).string;
     }
 
     static String empty;
@@ -993,18 +1252,18 @@ String const& GlyphArrangementArray::operator[](int index) const
 
 int GlyphArrangementArray::getToken(int row, int col, int defaultIfOutOfBounds) const
 {
-    if (!isPositiveAndBelow(row, lines.size())) {
+    if (!isPositiveAndBelow(row, numLines)) {
         return defaultIfOutOfBounds;
     }
-    return lines.getReference(row).tokens[col];
+    return getEntry(row).tokens[col];
 }
 
 void GlyphArrangementArray::clearTokens(int index)
 {
-    if (!isPositiveAndBelow(index, lines.size()))
+    if (!isPositiveAndBelow(index, numLines))
         return;
 
-    auto& entry = lines.getReference(index);
+    auto& entry = getEntry(index);
 
     ensureValid(index);
 
@@ -1015,10 +1274,10 @@ void GlyphArrangementArray::clearTokens(int index)
 
 void GlyphArrangementArray::applyTokens(int index, Selection zone)
 {
-    if (!isPositiveAndBelow(index, lines.size()))
+    if (!isPositiveAndBelow(index, numLines))
         return;
 
-    auto& entry = lines.getReference(index);
+    auto& entry = getEntry(index);
     auto range = zone.getColumnRangeOnRow(index, entry.tokens.size());
 
     ensureValid(index);
@@ -1033,7 +1292,7 @@ GlyphArrangement GlyphArrangementArray::getGlyphs(int index,
     int token,
     bool withTrailingSpace) const
 {
-    if (!isPositiveAndBelow(index, lines.size())) {
+    if (!isPositiveAndBelow(index, numLines)) {
         GlyphArrangement glyphs;
 
         if (withTrailingSpace) {
@@ -1043,8 +1302,8 @@ GlyphArrangement GlyphArrangementArray::getGlyphs(int index,
     }
     ensureValid(index);
 
-    auto& entry = lines.getReference(index);
-    auto glyphSource = withTrailingSpace ? entry.glyphsWithTrailingSpace : entry.glyphs;
+    auto const& entry = getEntry(index);
+    auto const& glyphSource = withTrailingSpace ? entry.glyphsWithTrailingSpace : entry.glyphs;
     auto glyphs = GlyphArrangement();
 
     for (int n = 0; n < glyphSource.getNumGlyphs(); ++n) {
@@ -1057,16 +1316,61 @@ GlyphArrangement GlyphArrangementArray::getGlyphs(int index,
     return glyphs;
 }
 
+void GlyphArrangementArray::drawLine(Graphics& g, int index, float baseline) const
+{
+    if (!isPositiveAndBelow(index, numLines))
+        return;
+
+    ensureValid(index);
+    getEntry(index).glyphs.draw(g, AffineTransform::translation(TEXT_INDENT, baseline));
+}
+
+GlyphArrangementArray::Layout GlyphArrangementArray::createLayout(Font const& font, int index, String const& string)
+{
+    Layout layout { index, string, {}, {}, font.getStringWidthFloat(string) };
+    layout.glyphs.addLineOfText(font, string, 0.f, 0.f);
+    layout.glyphsWithTrailingSpace.addLineOfText(font, string + " ", 0.f, 0.f);
+    return layout;
+}
+
+void GlyphArrangementArray::setLayout(Layout& layout, int layoutGeneration)
+{
+    if (layoutGeneration != generation || !isPositiveAndBelow(layout.index, numLines))
+        return;
+
+    auto [blockIndex, offset] = locate(layout.index);
+    auto& block = *blocks[blockIndex];
+    auto& entry = block.entries.getReference(offset);
+
+    if (entry.string != layout.string)
+        return;
+
+    if (entry.width < 0.f) {
+        entry.width = layout.width;
+        block.extentIsDirty = true;
+        extentIsDirty = true;
+    }
+
+    if (entry.glyphsAreDirty && cacheGlyphArrangement) {
+        entry.tokens.resize(entry.string.length());
+        entry.glyphs = std::move(layout.glyphs);
+        entry.glyphsWithTrailingSpace = std::move(layout.glyphsWithTrailingSpace);
+        entry.glyphsAreDirty = false;
+    }
+}
+
 void GlyphArrangementArray::ensureValid(int index) const
 {
-    if (!isPositiveAndBelow(index, lines.size()))
+    if (!isPositiveAndBelow(index, numLines))
         return;
 
-    auto& entry = lines.getReference(index);
+    auto& entry = getEntry(index);
 
     if (entry.glyphsAreDirty) {
         entry.tokens.resize(entry.string.length());
+        entry.glyphs.clear();
         entry.glyphs.addLineOfText(font, entry.string, 0.f, 0.f);
+        entry.glyphsWithTrailingSpace.clear();
         entry.glyphsWithTrailingSpace.addLineOfText(font, entry.string + " ", 0.f, 0.f);
         entry.glyphsAreDirty = !cacheGlyphArrangement;
     }
@@ -1074,10 +1378,30 @@ void GlyphArrangementArray::ensureValid(int index) const
 
 void GlyphArrangementArray::invalidateAll()
 {
-    for (auto& entry : lines) {
-        entry.glyphsAreDirty = true;
-        entry.tokensAreDirty = true;
+    for (auto& block : blocks) {
+        for (auto& entry : block->entries) {
+            entry.glyphsAreDirty = true;
+            entry.tokensAreDirty = true;
+            entry.width = -1.f;
+        }
+        block->extentIsDirty = true;
     }
+
+    extentIsDirty = true;
+    generation++;
+}
+
+void GlyphArrangementArray::setEstimateWidths(bool shouldEstimate)
+{
+    if (estimateWidths == shouldEstimate)
+        return;
+
+    estimateWidths = shouldEstimate;
+
+    for (auto& block : blocks)
+        block->extentIsDirty = true;
+
+    extentIsDirty = true;
 }
 
 void TextDocument::replaceAll(String const& content)
@@ -1169,15 +1493,16 @@ Array<Rectangle<float>> TextDocument::getSelectionRegion(Selection selection, Re
 
 Rectangle<float> TextDocument::getBounds() const
 {
-    if (cachedBounds.isEmpty()) {
-        auto bounds = Rectangle<float>();
+    // The union of the bounds of all rows that contain something
+    auto const extent = lines.getExtent();
 
-        for (int n = 0; n < getNumRows(); ++n) {
-            bounds = bounds.getUnion(getBoundsOnRow(n, Range<int>(0, getNumColumns(n))));
-        }
-        return cachedBounds = bounds;
-    }
-    return cachedBounds;
+    if (extent.firstRow < 0)
+        return {};
+
+    return Rectangle<float>::leftTopRightBottom(TEXT_INDENT,
+        getVerticalPosition(extent.firstRow, Metric::top),
+        TEXT_INDENT + extent.width,
+        getVerticalPosition(extent.lastRow, Metric::bottom));
 }
 
 Rectangle<float> TextDocument::getBoundsOnRow(int row, Range<int> columns) const
@@ -1214,6 +1539,15 @@ GlyphArrangement TextDocument::findGlyphsIntersecting(Rectangle<float> area, int
     return glyphs;
 }
 
+void TextDocument::drawRowsIntersecting(Graphics& g, Rectangle<float> area) const
+{
+    auto range = getRangeOfRowsIntersecting(area);
+
+    for (int n = range.getStart(); n < range.getEnd(); ++n) {
+        lines.drawLine(g, n, getVerticalPosition(n, Metric::baseline));
+    }
+}
+
 Range<int> TextDocument::getRangeOfRowsIntersecting(Rectangle<float> area) const
 {
     auto lineHeight = font.getHeight() * lineSpacing;
@@ -1465,8 +1799,6 @@ String TextDocument::getSelectionContent(Selection s) const
 
 Transaction TextDocument::fulfill(Transaction const& transaction)
 {
-    cachedBounds = {}; // invalidate the bounds
-
     auto const t = transaction.accountingForSpecialCharacters(*this);
     auto const s = t.selection.oriented();
     auto const L = getSelectionContent(s.horizontallyMaximized(*this));
@@ -1573,6 +1905,62 @@ UndoableAction* Transaction::on(TextDocument& document, Callback callback)
     return new Undoable(document, callback, *this);
 }
 
+/**
+ Lays out a range of lines on the editor's layout pool, and hands the results
+ to the document in chunks. Painting then only has to lay out lines that were
+ edited, or that it gets to before the pool does.
+ */
+class PlugDataTextEditor::LayoutJob : public ThreadPoolJob {
+public:
+    LayoutJob(PlugDataTextEditor& editor, int startRow, StringArray lines)
+        : ThreadPoolJob("Text layout")
+        , editor(&editor)
+        , font(editor.document.getFont())
+        , generation(editor.document.lines.getGeneration())
+        , startRow(startRow)
+        , lines(std::move(lines))
+    {
+        // A font of its own, so the typeface lookup doesn't share state with the message thread
+        font = Font(font.getTypefaceName(), font.getHeight(), font.getStyleFlags());
+    }
+
+    JobStatus runJob() override
+    {
+        for (int start = 0; start < lines.size(); start += chunkSize) {
+            if (shouldExit())
+                return jobHasFinished;
+
+            auto layouts = std::make_shared<std::vector<GlyphArrangementArray::Layout>>();
+            auto const end = jmin(start + chunkSize, lines.size());
+
+            for (int i = start; i < end; i++)
+                layouts->push_back(GlyphArrangementArray::createLayout(font, startRow + i, lines[i]));
+
+            MessageManager::callAsync([editor = editor, generation = generation, layouts, isLast = end == lines.size()]() {
+                if (!editor)
+                    return;
+
+                for (auto& layout : *layouts)
+                    editor->document.lines.setLayout(layout, generation);
+
+                if (isLast)
+                    editor->layoutFinished(generation);
+            });
+        }
+
+        return jobHasFinished;
+    }
+
+private:
+    static constexpr int chunkSize = 256;
+
+    Component::SafePointer<PlugDataTextEditor> editor;
+    Font font;
+    int generation;
+    int startRow;
+    StringArray lines;
+};
+
 PlugDataTextEditor::PlugDataTextEditor()
     : caret(document)
     , gutter(document)
@@ -1594,15 +1982,49 @@ PlugDataTextEditor::PlugDataTextEditor()
 void PlugDataTextEditor::setFont(Font font)
 {
     document.setFont(font);
+    startLayout();
     repaint();
 }
 
 void PlugDataTextEditor::setText(String const& text)
 {
     document.replaceAll(text);
+    startLayout();
     repaint();
 }
 
+void PlugDataTextEditor::startLayout()
+{
+    static constexpr int rowsPerJob = 4096;
+
+    // Results of jobs that are still running are dropped, the generation changed
+    layoutPool.removeAllJobs(true, 0);
+
+    auto& lines = document.lines;
+    numLayoutJobs = 0;
+
+    for (int start = 0; start < lines.size(); start += rowsPerJob) {
+        StringArray range;
+        for (int row = start; row < jmin(start + rowsPerJob, lines.size()); row++)
+            range.add(lines[row]);
+
+        layoutPool.addJob(new LayoutJob(*this, start, std::move(range)), true);
+        numLayoutJobs++;
+    }
+
+    // Until every line is measured, the document bounds use the width of an "M" for the rest
+    lines.setEstimateWidths(numLayoutJobs > 0);
+}
+
+void PlugDataTextEditor::layoutFinished(int generation)
+{
+    if (generation != document.lines.getGeneration() || --numLayoutJobs > 0)
+        return;
+
+    document.lines.setEstimateWidths(false);
+    translateView(0.f, 0.f);
+}
+
 String PlugDataTextEditor::getText() const
 {
     return document.getText().joinIntoString("\r");
@@ -2051,7 +2473,7 @@ void PlugDataTextEditor::renderTextUsingGlyphArrangement(Graphics& g)
         }
     } else {
         g.setColour(findColour(PlugDataColour::canvasTextColourId));
-        document.findGlyphsIntersecting(g.getClipBounds().toFloat()).draw(g);
+        document.drawRowsIntersecting(g, g.getClipBounds().toFloat());
     }
     g.restoreState();
 }
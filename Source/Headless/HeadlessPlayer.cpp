@@ -0,0 +1,263 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "HeadlessPlayer.h"
+
+#include <iostream>
+
+#include "Pd/PdAudioBuses.h"
+#include "Pd/PdDiskRecorders.h"
+#include "Pd/PdSharedArrays.h"
+#include "Pd/PdTableLoads.h"
+
+HeadlessPlayer::HeadlessPlayer()
+    : pd::Instance("PlugData")
+{
+    callbackLock.setLock(&audioLock, &audioStats);
+    setMidiOutput(&midiOutputBus);
+
+    // The same objects as in the plugin, shared by the instances of the process
+    pd::AudioBuses::getInstance();
+    pd::DiskRecorders::getInstance();
+    pd::SharedArrays::getInstance();
+    pd::TableLoads::getInstance();
+
+    startTimer(50);
+}
+
+HeadlessPlayer::~HeadlessPlayer()
+{
+    deviceManager.removeAudioCallback(this);
+    if (midiInputIdentifier.isNotEmpty())
+        deviceManager.removeMidiInputDeviceCallback(midiInputIdentifier, &midiInput);
+    deviceManager.closeAudioDevice();
+
+    if (patch) {
+        setThis();
+        patch->close();
+    }
+}
+
+void HeadlessPlayer::setSearchPaths(StringArray const& paths)
+{
+    auto const elsePath = File::getSpecialLocation(File::userApplicationDataDirectory).getChildFile("PlugData").getChildFile(ProjectInfo::versionString).getChildFile("Abstractions").getChildFile("else");
+
+    const pd::CallbackLock::ScopedLockType lock(callbackLock);
+    setThis();
+
+    libpd_clear_search_path();
+    for (auto const& path : paths)
+        libpd_add_to_search_path(path.toRawUTF8());
+
+    if (elsePath.isDirectory())
+        libpd_add_to_search_path(elsePath.getFullPathName().toRawUTF8());
+}
+
+Result HeadlessPlayer::loadPatch(File const& file)
+{
+    if (!file.existsAsFile())
+        return Result::fail("Can't find " + file.getFullPathName());
+
+    // The devices aren't running yet, so messageEnqueued performs the commands right away
+    auto opened = openPatch(file);
+    if (!opened.getPointer())
+        return Result::fail("Can't open " + file.getFullPathName());
+
+    patch = std::make_unique<pd::Patch>(opened);
+    return Result::ok();
+}
+
+String HeadlessPlayer::openDevices(Options const& options)
+{
+    auto error = deviceManager.initialise(options.numInputs, options.numOutputs, nullptr, true, options.audioDevice, nullptr);
+    if (error.isNotEmpty())
+        return error;
+
+    if (options.sampleRate > 0.0 || options.bufferSize > 0) {
+        auto setup = deviceManager.getAudioDeviceSetup();
+        if (options.sampleRate > 0.0)
+            setup.sampleRate = options.sampleRate;
+        if (options.bufferSize > 0)
+            setup.bufferSize = options.bufferSize;
+
+        error = deviceManager.setAudioDeviceSetup(setup, true);
+        if (error.isNotEmpty())
+            return error;
+    }
+
+    if (options.midiInput.isNotEmpty()) {
+        for (auto const& device : MidiInput::getAvailableDevices()) {
+            if (device.name == options.midiInput) {
+                midiInputIdentifier = device.identifier;
+                deviceManager.setMidiInputDeviceEnabled(midiInputIdentifier, true);
+                deviceManager.addMidiInputDeviceCallback(midiInputIdentifier, &midiInput);
+            }
+        }
+
+        if (midiInputIdentifier.isEmpty())
+            return "Can't find the midi input " + options.midiInput;
+    }
+
+    if (options.midiOutput.isNotEmpty()) {
+        for (auto const& device : MidiOutput::getAvailableDevices()) {
+            if (device.name == options.midiOutput)
+                midiOutput = MidiOutput::openDevice(device.identifier);
+        }
+
+        if (!midiOutput)
+            return "Can't open the midi output " + options.midiOutput;
+    }
+
+    deviceManager.addAudioCallback(this);
+    return {};
+}
+
+void HeadlessPlayer::listDevices()
+{
+    AudioDeviceManager manager;
+    manager.initialise(0, 0, nullptr, false);
+
+    for (auto* type : manager.getAvailableDeviceTypes()) {
+        type->scanForDevices();
+        std::cout << type->getTypeName() << ":" << std::endl;
+        for (auto const& name : type->getDeviceNames())
+            std::cout << "    " << name << std::endl;
+    }
+
+    std::cout << "Midi inputs:" << std::endl;
+    for (auto const& device : MidiInput::getAvailableDevices())
+        std::cout << "    " << device.name << std::endl;
+
+    std::cout << "Midi outputs:" << std::endl;
+    for (auto const& device : MidiOutput::getAvailableDevices())
+        std::cout << "    " << device.name << std::endl;
+}
+
+void HeadlessPlayer::messageEnqueued()
+{
+    // Only dequeue here if the audio callback isn't running, it does so on the next block otherwise
+    if (callbackLock.tryEnter()) {
+        sendMessagesFromQueue();
+        callbackLock.exit();
+    }
+}
+
+pd::CallbackLock const* HeadlessPlayer::getCallbackLock()
+{
+    return &callbackLock;
+}
+
+void HeadlessPlayer::createPanel(int type, char const* snd, char const* location)
+{
+    logError("File dialogs aren't available without an editor");
+}
+
+Colour HeadlessPlayer::getForegroundColour()
+{
+    return Colours::black;
+}
+
+Colour HeadlessPlayer::getBackgroundColour()
+{
+    return Colours::white;
+}
+
+Colour HeadlessPlayer::getTextColour()
+{
+    return Colours::black;
+}
+
+Colour HeadlessPlayer::getOutlineColour()
+{
+    return Colours::black;
+}
+
+void HeadlessPlayer::audioDeviceAboutToStart(AudioIODevice* device)
+{
+    const ScopedLock lock(audioLock);
+
+    sampleRate = device->getCurrentSampleRate();
+    numInputs = device->getActiveInputChannels().countNumberOfSetBits();
+    numOutputs = device->getActiveOutputChannels().countNumberOfSetBits();
+
+    prepareDSP(numInputs, numOutputs, sampleRate, device->getCurrentBufferSizeSamples());
+
+    auto const blockSize = getBlockSize();
+    inputBuffer.assign(static_cast<size_t>(numInputs * blockSize), 0.0f);
+    outputBuffer.assign(static_cast<size_t>(numOutputs * blockSize), 0.0f);
+    position = 0;
+
+    midiInput.reset();
+    startDSP();
+}
+
+void HeadlessPlayer::audioDeviceIOCallbackWithContext(float const** inputChannelData, int numInputChannels, float** outputChannelData, int numOutputChannels, int numSamples, AudioIODeviceCallbackContext const& context)
+{
+    const ScopedLock lock(audioLock);
+
+    auto const blockSize = getBlockSize();
+    auto const numIn = std::min(numInputChannels, numInputs);
+    auto const numOut = std::min(numOutputChannels, numOutputs);
+
+    for (int ch = numOut; ch < numOutputChannels; ch++)
+        FloatVectorOperations::clear(outputChannelData[ch], numSamples);
+
+    // The device's buffer is cut into pd's blocks, the output of a block is sent while the next one is collected
+    for (int done = 0; done < numSamples;) {
+        auto const count = std::min(numSamples - done, blockSize - position);
+
+        for (int ch = 0; ch < numIn; ch++)
+            FloatVectorOperations::copy(inputBuffer.data() + ch * blockSize + position, inputChannelData[ch] + done, count);
+        for (int ch = 0; ch < numOut; ch++)
+            FloatVectorOperations::copy(outputChannelData[ch] + done, outputBuffer.data() + ch * blockSize + position, count);
+
+        position += count;
+        done += count;
+
+        if (position == blockSize) {
+            processBlock();
+            position = 0;
+        }
+    }
+}
+
+void HeadlessPlayer::audioDeviceStopped()
+{
+    const ScopedLock lock(audioLock);
+    releaseDSP();
+}
+
+void HeadlessPlayer::processBlock()
+{
+    setThis();
+
+    midiOutputBus.clear();
+    beginMidiOutput();
+
+    sendMessagesFromQueue();
+
+    midiInputBuffer.clear();
+    midiInput.removeNextBlockOfMessages(midiInputBuffer, getBlockSize(), sampleRate);
+    if (!midiInputBuffer.isEmpty())
+        sendMidiEvents(midiInputBuffer);
+
+    performDSP(inputBuffer.data(), outputBuffer.data());
+
+    if (midiOutput && !midiOutputBus[0].isEmpty())
+        midiOutput->sendBlockOfMessagesNow(midiOutputBus[0]);
+}
+
+void HeadlessPlayer::timerCallback()
+{
+    auto const& log = getConsoleLog();
+
+    for (auto number = std::max(nextConsoleLine, log.getStart()); number < log.getEnd(); number++) {
+        auto const& line = log[number];
+        (line.type == 1 ? std::cerr : std::cout) << line.text << std::endl;
+    }
+
+    nextConsoleLine = log.getEnd();
+}
@@ -0,0 +1,95 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <memory>
+#include <vector>
+
+#include "Pd/PdInstance.h"
+
+// Plays a patch on an audio device without an editor, for installations and render servers
+//! @details Only pd::Instance, the libraries and the devices are involved: there's no look and feel, object
+//! library or settings. pd runs on the audio callback, in blocks of getBlockSize() that the device's buffers
+//! are cut into, so the output is one pd block late. Messages from other threads are sent on the next block,
+//! or right away while the audio callback isn't running. The console is written to stdout and stderr.
+class HeadlessPlayer : public pd::Instance
+    , private AudioIODeviceCallback
+    , private Timer {
+public:
+    struct Options {
+        String audioDevice; // Empty for the default device
+        double sampleRate = 0.0; // 0 keeps the device's
+        int bufferSize = 0;      // 0 keeps the device's
+        int numInputs = 2;
+        int numOutputs = 2;
+        String midiInput;  // Name of a device, or empty for none
+        String midiOutput; // Name of a device, or empty for none
+    };
+
+    HeadlessPlayer();
+    ~HeadlessPlayer() override;
+
+    // Searched for abstractions before the ELSE abstractions of an installed plugdata, if there are any
+    void setSearchPaths(StringArray const& paths);
+
+    Result loadPatch(File const& file);
+
+    // Returns an error message, or an empty string when the devices are running
+    String openDevices(Options const& options);
+
+    // Writes the available audio and midi devices to stdout
+    static void listDevices();
+
+    void messageEnqueued() override;
+    pd::CallbackLock const* getCallbackLock() override;
+
+    // There are no file dialogs without an editor
+    void createPanel(int type, char const* snd, char const* location) override;
+
+    Colour getForegroundColour() override;
+    Colour getBackgroundColour() override;
+    Colour getTextColour() override;
+    Colour getOutlineColour() override;
+
+private:
+    void audioDeviceAboutToStart(AudioIODevice* device) override;
+    void audioDeviceIOCallbackWithContext(float const** inputChannelData, int numInputChannels, float** outputChannelData, int numOutputChannels, int numSamples, AudioIODeviceCallbackContext const& context) override;
+    void audioDeviceStopped() override;
+
+    // Runs the messages, midi and DSP of one block, with the audio lock held
+    void processBlock();
+
+    // Writes new console lines
+    void timerCallback() override;
+
+    AudioDeviceManager deviceManager;
+
+    CriticalSection audioLock;
+    pd::CallbackLock callbackLock;
+
+    std::unique_ptr<pd::Patch> patch;
+
+    // Only used with the audio lock held, the buffers use the channel layout of libpd_process_raw
+    std::vector<float> inputBuffer;
+    std::vector<float> outputBuffer;
+    int numInputs = 0;
+    int numOutputs = 0;
+    int position = 0;
+    double sampleRate = 44100.0;
+
+    pd::MidiInputRing midiInput { static_cast<int>(pd::MidiBus::maxSysexSize) + 4096 };
+    String midiInputIdentifier;
+    MidiBuffer midiInputBuffer;
+    pd::MidiBus midiOutputBus { 1, 2048 };
+    std::unique_ptr<MidiOutput> midiOutput;
+
+    uint64 nextConsoleLine = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(HeadlessPlayer)
+};
@@ -0,0 +1,127 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <clocale>
+#include <csignal>
+#include <iostream>
+
+#include "HeadlessPlayer.h"
+
+// Used by pd::Instance for its file dialogs, which don't open without an editor
+bool wantsNativeDialog()
+{
+    return false;
+}
+
+namespace {
+
+std::atomic<bool> quitRequested = false;
+
+// Signal handlers can't touch the message manager, so this polls for them
+struct QuitPoller : public Timer {
+    QuitPoller()
+    {
+        startTimer(100);
+    }
+
+    void timerCallback() override
+    {
+        if (quitRequested)
+            MessageManager::getInstance()->stopDispatchLoop();
+    }
+};
+
+void printUsage()
+{
+    std::cout << "Usage: PlugDataHeadless [options] patch.pd" << std::endl
+              << "    --list            list the audio and midi devices" << std::endl
+              << "    --device name     audio device, the default one otherwise" << std::endl
+              << "    --rate n          sample rate" << std::endl
+              << "    --buffer n        buffer size of the device" << std::endl
+              << "    --inputs n        audio inputs, 2 by default" << std::endl
+              << "    --outputs n       audio outputs, 2 by default" << std::endl
+              << "    --midi-in name    midi input device" << std::endl
+              << "    --midi-out name   midi output device" << std::endl
+              << "    --path dir        searched for abstractions, can be given more than once" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    // Make sure to use dots for decimal numbers, pd requires that
+    std::setlocale(LC_ALL, "C");
+
+    ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h") || args.size() == 0) {
+        printUsage();
+        return 0;
+    }
+
+    ScopedJuceInitialiser_GUI juceInitialiser;
+
+    if (args.containsOption("--list")) {
+        HeadlessPlayer::listDevices();
+        return 0;
+    }
+
+    HeadlessPlayer::Options options;
+    StringArray searchPaths;
+    File patchFile;
+
+    for (int i = 0; i < args.size(); i++) {
+        auto const& arg = args[i];
+        auto const value = i + 1 < args.size() ? args[i + 1].text : String();
+
+        if (arg == "--device")
+            options.audioDevice = value;
+        else if (arg == "--rate")
+            options.sampleRate = value.getDoubleValue();
+        else if (arg == "--buffer")
+            options.bufferSize = value.getIntValue();
+        else if (arg == "--inputs")
+            options.numInputs = value.getIntValue();
+        else if (arg == "--outputs")
+            options.numOutputs = value.getIntValue();
+        else if (arg == "--midi-in")
+            options.midiInput = value;
+        else if (arg == "--midi-out")
+            options.midiOutput = value;
+        else if (arg == "--path")
+            searchPaths.add(File::getCurrentWorkingDirectory().getChildFile(value).getFullPathName());
+        else {
+            patchFile = arg.resolveAsFile();
+            continue;
+        }
+
+        i++;
+    }
+
+    HeadlessPlayer player;
+    player.setSearchPaths(searchPaths);
+
+    if (auto const result = player.loadPatch(patchFile); result.failed()) {
+        std::cerr << result.getErrorMessage() << std::endl;
+        return 1;
+    }
+
+    if (auto const error = player.openDevices(options); error.isNotEmpty()) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, [](int) { quitRequested = true; });
+    std::signal(SIGTERM, [](int) { quitRequested = true; });
+
+    QuitPoller quitPoller;
+    MessageManager::getInstance()->runDispatchLoop();
+
+    return 0;
+}
@@ -9,6 +9,7 @@
 #include "Canvas.h"
 #include "Connection.h"
 #include "LookAndFeel.h"
+#include "Utility/PaintProfiler.h"
 
 Iolet::Iolet(Object* parent, bool inlet) : object(parent)
 {
@@ -28,6 +29,8 @@ Rectangle<int> Iolet::getCanvasBounds()
 
 void Iolet::paint(Graphics& g)
 {
+    PaintProfiler::Scope profilerScope(*this, g);
+
     auto bounds = getLocalBounds().toFloat().reduced(0.5f);
 
     bool isLocked = static_cast<bool>(locked.getValue());
@@ -168,9 +171,12 @@ void Iolet::createConnection()
 
 Iolet* Iolet::findNearestEdge(Canvas* cnv, Point<int> position, bool inlet, Object* boxToExclude)
 {
-    // Find all iolets
+    // Find all iolets that can be in range, an iolet is always inside its object
+    Array<Object*> objectsInRange;
+    cnv->getObjectIndex().query(Rectangle<int>(position, position).expanded(150, 150), objectsInRange);
+    
     Array<Iolet*> allEdges;
-    for (auto* object : cnv->objects)
+    for (auto* object : objectsInRange)
     {
         for (auto* iolet : object->iolets)
         {
@@ -8,11 +8,13 @@
 
 #include <JuceHeader.h>
 
+#include "Utility/RecyclingAllocator.h"
+
 class Connection;
 class Object;
 class Canvas;
 
-class Iolet : public Component, public SettableTooltipClient
+class Iolet : public Component, public SettableTooltipClient, public Recycled
 {
    public:
     Object* object;
@@ -11,11 +11,15 @@
 #include "Connection.h"
 #include "Iolet.h"
 #include "LookAndFeel.h"
+#include "Utility/PaintProfiler.h"
+#include "Utility/HelpPreview.h"
+#include "Pd/PdAsync.h"
 
 extern "C"
 {
 #include <m_pd.h>
 #include <m_imp.h>
+#include <g_canvas.h>
 }
 
 Object::Object(Canvas* parent, const String& name, Point<int> position) : cnv(parent)
@@ -26,7 +30,7 @@ Object::Object(Canvas* parent, const String& name, Point<int> position) : cnv(pa
     {
         cnv->attachNextObjectToMouse = false;
         attachedToMouse = true;
-        startTimer(16);
+        cnv->main.frameScheduler.addClient(this, 0);
     }
 
     initialise();
@@ -69,11 +73,12 @@ Object::~Object()
     if(!cnv->isBeingDeleted) {
         // Ensure there's no pointer to this object in the selection
         cnv->setSelected(this, false);
+        cnv->removeFromIndex(this);
     }
     
     if (attachedToMouse)
     {
-        stopTimer();
+        cnv->main.frameScheduler.removeClient(this);
     }
 }
 
@@ -104,7 +109,7 @@ void Object::initialise()
     originalBounds.setBounds(0, 0, 0, 0);
 }
 
-void Object::timerCallback()
+void Object::frameUpdate()
 {
     auto pos = cnv->getMouseXYRelative();
     if (pos != getBounds().getCentre())
@@ -255,6 +260,7 @@ void Object::setType(const String& newType, void* existingObject)
     // Update inlets/outlets
     updatePorts();
     updateBounds();
+    updateRenderCache();
 
     cnv->main.updateCommandStatus();
 }
@@ -287,11 +293,19 @@ void Object::paintOverChildren(Graphics& g)
 
         g.restoreState();
     }
+
+    // Everything painted since paint(), which includes the gui, is booked on the type of the gui
+    if (paintProfiled)
+    {
+        PaintProfiler::end();
+        paintProfiled = false;
+    }
 }
 
 void Object::paint(Graphics& g)
 {
-    
+    paintProfiled = PaintProfiler::begin(*this, g, gui ? typeid(*gui) : typeid(*this));
+
     if (cnv->isSelected(this) && !cnv->isGraph)
     {
         g.setColour(findColour(PlugDataColour::objectSelectedOutlineColourId));
@@ -308,8 +322,15 @@ void Object::paint(Graphics& g)
     }
 }
 
+void Object::moved()
+{
+    cnv->updateIndex(this);
+}
+
 void Object::resized()
 {
+    cnv->updateIndex(this);
+    
     setVisible(!((cnv->isGraph || cnv->presentationMode == var(true)) && gui && gui->hideInGraph()));
 
     if (gui)
@@ -322,6 +343,15 @@ void Object::resized()
         newObjectEditor->setBounds(getLocalBounds().reduced(margin));
     }
 
+    if (ioletLayoutBounds == getLocalBounds() && ioletLayoutInputs == numInputs && ioletLayoutOutputs == numOutputs && iolets.size() == numInputs + numOutputs)
+    {
+        return;
+    }
+
+    ioletLayoutBounds = getLocalBounds();
+    ioletLayoutInputs = numInputs;
+    ioletLayoutOutputs = numOutputs;
+
     int ioletSize = 13;
     int ioletHitBox = 4;
     int borderWidth = 14;
@@ -371,6 +401,13 @@ void Object::resized()
     }
 }
 
+void Object::updateRenderCache()
+{
+    // The cached image is kept at the scale it was drawn at, so scrolling only composites it
+    // JUCE draws it again after a repaint, or when the zoom level changes
+    setBufferedToImage(static_cast<bool>(cnv->renderCache.getValue()) && !(gui && gui->isAnimated()));
+}
+
 void Object::updatePorts()
 {
     if (!getPointer()) return;
@@ -400,7 +437,9 @@ void Object::updatePorts()
     while (numOutputs > oldNumOutputs) iolets.insert(numInputs + (++oldNumOutputs), new Iolet(this, false));
     
     if(gui) {
-        gui->setTooltip(cnv->pd->objectLibrary.getObjectDescriptions()[gui->getType()]);
+        auto documentation = cnv->pd->objectLibrary->getSnapshot();
+        auto description = documentation->objectDescriptions.find(gui->getType());
+        gui->setTooltip(description != documentation->objectDescriptions.end() ? description->second : String());
     }
 
     int numIn = 0;
@@ -427,7 +466,7 @@ void Object::updatePorts()
 
         if (gui)
         {
-            String tooltip = cnv->pd->objectLibrary.getInletOutletTooltip(gui->getType(), iolet->ioletIdx, input ? numInputs : numOutputs, input);
+            String tooltip = cnv->pd->objectLibrary->getInletOutletTooltip(gui->getType(), iolet->ioletIdx, input ? numInputs : numOutputs, input);
             iolet->setTooltip(tooltip);
         }
 
@@ -454,7 +493,7 @@ void Object::mouseDown(const MouseEvent& e)
     if (attachedToMouse)
     {
         attachedToMouse = false;
-        stopTimer();
+        cnv->main.frameScheduler.removeClient(this);
         repaint();
 
         auto object = SafePointer<Object>(this);
@@ -708,26 +747,80 @@ void Object::textEditorTextChanged(TextEditor& ed)
     }
 }
 
-void Object::openHelpPatch() const
+// Whether obj is still in cnv or in one of its subpatches
+static bool containsObject(t_canvas* cnv, t_object* obj)
 {
-    cnv->pd->setThis();
+    for (auto* y = cnv->gl_list; y; y = y->g_next) {
+        if (pd_checkobject(&y->g_pd) == obj)
+            return true;
+        if (pd_class(&y->g_pd) == canvas_class && containsObject(reinterpret_cast<t_canvas*>(y), obj))
+            return true;
+    }
 
-    if (auto* ptr = static_cast<t_object*>(getPointer())) {
-        
-        auto file = cnv->pd->objectLibrary.findHelpfile(ptr);
-        
-        if(!file.existsAsFile()) {
-            cnv->pd->logMessage("Couldn't find help file");
-            return;
+    return false;
+}
+
+// The object is read on pd's thread, so the editor doesn't wait for the lock
+static pd::Detached openHelpfile(PlugDataAudioProcessor* instance, t_object* ptr)
+{
+    auto file = co_await instance->onPdThread([instance, ptr]() {
+        instance->setThis();
+
+        // It may have been deleted by something queued before this
+        for (auto* cnv = pd_getcanvaslist(); cnv; cnv = cnv->gl_next) {
+            if (containsObject(cnv, ptr))
+                return instance->objectLibrary->findHelpfile(ptr);
         }
-        
-        cnv->pd->enqueueFunction([this, file]() mutable {
-            cnv->pd->loadPatch(file);
-            
-        });
-        
+
+        return File();
+    });
+
+    if (!file.existsAsFile()) {
+        instance->logMessage("Couldn't find help file");
+        co_return;
+    }
+
+    HelpPreviewCache::getInstance()->noteOpened(file);
+
+    instance->enqueueFunction([instance, file]() mutable {
+        instance->loadPatch(file);
+    });
+}
+
+void Object::openHelpPatch() const
+{
+    if (auto* ptr = static_cast<t_object*>(getPointer())) {
+        openHelpfile(cnv->pd, ptr);
         return;
     }
     
     cnv->pd->logMessage("Couldn't find help file");
 }
+
+void Object::showHelpPreview()
+{
+    cnv->pd->setThis();
+
+    auto* ptr = static_cast<t_object*>(getPointer());
+    auto file = ptr ? cnv->pd->objectLibrary->findHelpfile(ptr) : File();
+
+    if (!file.existsAsFile()) {
+        cnv->pd->logMessage("Couldn't find help file");
+        return;
+    }
+
+    HelpPreviewCache::getInstance()->load(file, [_this = SafePointer<Object>(this), file](std::shared_ptr<HelpPreviewCache::Preview const> preview) {
+        if (!_this || !preview)
+            return;
+
+        auto maxSize = _this->cnv->getLocalBounds().withSizeKeepingCentre(640, 480);
+        auto thumbnail = HelpPreviewCache::getInstance()->getThumbnail(file, *preview, maxSize, _this->findColour(PlugDataColour::canvasBackgroundColourId), _this->findColour(PlugDataColour::canvasTextColourId));
+
+        auto content = std::make_unique<HelpPreviewComponent>(thumbnail, file.getFileNameWithoutExtension(), [_this]() {
+            if (_this)
+                _this->openHelpPatch();
+        });
+
+        CallOutBox::launchAsynchronously(std::move(content), _this->getScreenBounds(), nullptr);
+    });
+}
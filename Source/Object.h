@@ -14,11 +14,13 @@ extern "C"
 }
 
 #include "Utility/ObjectGrid.h"
+#include "Utility/FrameScheduler.h"
+#include "Utility/RecyclingAllocator.h"
 #include "Iolet.h"
 #include "Objects/GUIObject.h"
 
 class Canvas;
-class Object : public Component, public Value::Listener, public Timer, private TextEditor::Listener
+class Object : public Component, public Value::Listener, public FrameScheduler::Client, private TextEditor::Listener, public Recycled
 {
    public:
     Object(Canvas* parent, const String& name = "", Point<int> position = {100, 100});
@@ -29,14 +31,19 @@ class Object : public Component, public Value::Listener, public Timer, private T
 
     void valueChanged(Value& v) override;
 
-    void timerCallback() override;
+    // Follows the mouse while attached to it
+    void frameUpdate() override;
 
     void paint(Graphics&) override;
     void paintOverChildren(Graphics&) override;
     void resized() override;
+    void moved() override;
 
     void updatePorts();
 
+    // Buffers this object to an image when the render cache is enabled and it isn't animated
+    void updateRenderCache();
+
     void setType(const String& newType, void* existingObject = nullptr);
     void updateBounds();
 
@@ -47,6 +54,9 @@ class Object : public Component, public Value::Listener, public Timer, private T
     void setObjectBounds(Rectangle<int> bounds);
 
     void openHelpPatch() const;
+
+    // Shows what the help patch looks like, without opening it in pd
+    void showHelpPreview();
     void* getPointer() const;
 
     Array<Connection*> getConnections() const;
@@ -96,6 +106,12 @@ class Object : public Component, public Value::Listener, public Timer, private T
     bool createEditorOnMouseDown = false;
     bool selectionStateChanged = false;
     bool wasLockedOnMouseDown = false;
+    bool paintProfiled = false; // paint() can be skipped when obscured, paintOverChildren() can't
+
+    // Size and iolet counts the iolets were last laid out for, synchronise and updateBounds often change neither
+    Rectangle<int> ioletLayoutBounds;
+    int ioletLayoutInputs = -1;
+    int ioletLayoutOutputs = -1;
 
 
     std::unique_ptr<TextEditor> newObjectEditor;
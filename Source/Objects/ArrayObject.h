@@ -84,6 +84,23 @@ public:
         libpd_array_read(output.data(), ptr, 0, size);
     }
 
+    // Updates a copy of the array with the values that changed, returns the range that changed.
+    Range<int> readChanges(std::vector<float>& output) const
+    {
+        libpd_set_instance(static_cast<t_pdinstance*>(instance));
+        int const size = libpd_array_get_size(ptr);
+
+        if (output.size() != static_cast<size_t>(size)) {
+            output.resize(static_cast<size_t>(size));
+            libpd_array_read(output.data(), ptr, 0, size);
+            return { 0, size };
+        }
+
+        int start = 0, end = 0;
+        libpd_array_read_changes(output.data(), ptr, size, &start, &end);
+        return { start, end };
+    }
+
     // Writes the values of the array.
     void write(std::vector<float> const& input)
     {
@@ -98,6 +115,13 @@ public:
         libpd_array_write(ptr, static_cast<int>(pos), &input, 1);
     }
 
+    // Writes a range of values, starting at pos.
+    void write(const size_t pos, std::vector<float> const& input)
+    {
+        libpd_set_instance(static_cast<t_pdinstance*>(instance));
+        libpd_array_write(ptr, static_cast<int>(pos), input.data(), static_cast<int>(input.size()));
+    }
+
     void* ptr = nullptr;
     void* instance = nullptr;
 };
@@ -116,13 +140,14 @@ public:
             return;
 
         vec.reserve(8192);
-        temp.reserve(8192);
         try {
             array.read(vec);
         } catch (...) {
             error = true;
         }
 
+        peaks.rebuild(vec.data(), static_cast<int>(vec.size()));
+
         setInterceptsMouseClicks(true, false);
         setOpaque(false);
         setBufferedToImage(true);
@@ -135,26 +160,46 @@ public:
         array = graph;
     }
 
-    std::vector<float> rescale(std::vector<float> const& v, unsigned const newSize)
+    // Draws the range of the samples under every pixel, for tables that are wider than the graph
+    void paintPeaks(Graphics& g, std::array<float, 2> scale, bool invert)
     {
-        if (v.empty()) {
-            return {};
+        auto const h = static_cast<float>(getHeight());
+        auto const width = getWidth();
+        auto const numSamples = static_cast<int64>(vec.size());
+        float const dh = h / (scale[1] - scale[0]);
+
+        auto toY = [&](float value) {
+            float const y = h - (std::clamp(value, scale[0], scale[1]) - scale[0]) * dh;
+            return invert ? h - y : y;
+        };
+
+        std::vector<Range<float>> columns(static_cast<size_t>(width));
+        for (int x = 0; x < width; x++) {
+            auto const start = static_cast<int>(x * numSamples / width);
+            auto const end = jmax(start + 1, static_cast<int>((x + 1) * numSamples / width));
+            auto const range = peaks.getRange(vec.data(), start, end);
+            columns[x] = Range<float>::between(toY(range.getStart()), toY(range.getEnd()));
         }
 
-        std::vector<float> result(newSize);
-        const std::size_t oldSize = v.size();
-        for (unsigned i = 0; i < newSize; i++) {
-            auto const idx = i * (oldSize - 1) / newSize;
-            auto const mod = i * (oldSize - 1) % newSize;
-
-            if (mod == 0)
-                result[i] = v[idx];
-            else {
-                float const part = float(mod) / float(newSize);
-                result[i] = v[idx] * (1.0 - part) + v[idx + 1] * part;
-            }
+        g.setColour(object->findColour(PlugDataColour::objectOutlineColourId));
+
+        if (array.getDrawType() == PdArray::DrawType::Points) {
+            for (int x = 0; x < width; x++)
+                g.drawVerticalLine(x, columns[x].getStart(), jmax(columns[x].getEnd(), columns[x].getStart() + 1.0f));
+            return;
         }
-        return result;
+
+        // Outline of the tops, then back along the bottoms
+        Path p;
+        p.startNewSubPath(0.0f, columns[0].getStart());
+        for (int x = 1; x < width; x++)
+            p.lineTo(static_cast<float>(x), columns[x].getStart());
+        for (int x = width - 1; x >= 0; x--)
+            p.lineTo(static_cast<float>(x + 1), columns[x].getEnd());
+        p.closeSubPath();
+
+        g.fillPath(p);
+        g.strokePath(p, PathStrokeType(1));
     }
 
     void paintGraph(Graphics& g)
@@ -162,7 +207,7 @@ public:
 
         auto const h = static_cast<float>(getHeight());
         auto const w = static_cast<float>(getWidth());
-        std::vector<float> points = vec;
+        auto const& points = vec;
 
         if (!points.empty()) {
             std::array<float, 2> scale = array.getScale();
@@ -174,9 +219,10 @@ public:
             }
 
             // More than a point per pixel will cause insane loads, and isn't actually helpful
-            // Instead, linearly interpolate the vector to a max size of width in pixels
-            if (vec.size() >= getWidth()) {
-                points = rescale(points, getWidth());
+            // Instead, draw the minimum and maximum under every pixel from the pyramid
+            if (vec.size() >= getWidth() && peaks.size() == vec.size() && getWidth() > 0) {
+                paintPeaks(g, scale, invert);
+                return;
             }
 
             float const dh = h / (scale[1] - scale[0]);
@@ -294,15 +340,18 @@ public:
             vec[n] = jmap<float>(n, interpStart, interpEnd + 1, min, max);
         }
 
+        peaks.update(vec.data(), interpStart, interpEnd + 1);
+
         // Don't want to touch vec on the other thread, so we copy the vector into the lambda
         auto changed = std::vector<float>(vec.begin() + interpStart, vec.begin() + interpEnd + 1);
 
         pd->enqueueFunction(
             [_this = SafePointer(this), interpStart, changed]() mutable {
+                if (!_this)
+                    return;
+
                 try {
-                    for (int n = 0; n < changed.size(); n++) {
-                        _this->array.write(interpStart + n, changed[n]);
-                    }
+                    _this->array.write(interpStart, changed);
                 } catch (...) {
                     _this->error = true;
                 }
@@ -325,13 +374,22 @@ public:
     {
         if (!edited) {
             error = false;
+            Range<int> changed;
             try {
-                array.read(temp);
+                changed = array.readChanges(vec);
             } catch (...) {
                 error = true;
             }
-            if (temp != vec) {
-                vec.swap(temp);
+
+            if (peaks.size() != static_cast<int>(vec.size())) {
+                peaks.rebuild(vec.data(), static_cast<int>(vec.size()));
+                repaint();
+                return;
+            }
+
+            // Only the part that changed has to be summarised again
+            if (!changed.isEmpty()) {
+                peaks.update(vec.data(), changed.getStart(), changed.getEnd());
                 repaint();
             }
         }
@@ -339,7 +397,7 @@ public:
 
     PdArray array;
     std::vector<float> vec;
-    std::vector<float> temp;
+    MinMaxPyramid peaks;
     std::atomic<bool> edited;
     bool error = false;
     const String stringArray = "array";
@@ -52,17 +52,11 @@ struct AtomObject : public GUIObject {
 
     void updateBounds() override
     {
-        pd->getCallbackLock()->enter();
+        auto state = getObjectState();
 
-        int x, y, w, h;
-        libpd_get_object_bounds(cnv->patch.getPointer(), ptr, &x, &y, &w, &h);
+        int w = std::max<int>(4, state.textWidth) * state.fontWidth;
 
-        auto* gatom = static_cast<t_fake_gatom*>(ptr);
-        w = std::max<int>(4, gatom->a_text.te_width) * glist_fontwidth(cnv->patch.getPointer());
-
-        auto bounds = Rectangle<int>(x, y, w, getAtomHeight());
-
-        pd->getCallbackLock()->exit();
+        auto bounds = Rectangle<int>(state.bounds.getX(), state.bounds.getY(), w, getAtomHeight());
 
         object->setObjectBounds(bounds);
     }
@@ -215,7 +209,7 @@ struct AtomObject : public GUIObject {
         auto objectBounds = object->getBounds().reduced(Object::margin);
         int fontHeight = getAtomHeight() - 6;
 
-        int labelLength = Font(fontHeight).getStringWidth(getExpandedLabelText());
+        int labelLength = roundToInt(FastStringWidth::getExactStringWidth(Font(fontHeight), getExpandedLabelText()));
         int labelPosition = static_cast<t_fake_gatom*>(ptr)->a_wherelabel;
         auto labelBounds = objectBounds.withSizeKeepingCentre(labelLength, fontHeight);
 
@@ -87,15 +87,7 @@ struct ButtonObject : public GUIObject {
 
     void updateBounds() override
     {
-        pd->getCallbackLock()->enter();
-
-        int x = 0, y = 0, w = 0, h = 0;
-        libpd_get_object_bounds(cnv->patch.getPointer(), ptr, &x, &y, &w, &h);
-        auto bounds = Rectangle<int>(x, y, w, h);
-
-        pd->getCallbackLock()->exit();
-
-        object->setObjectBounds(bounds);
+        object->setObjectBounds(getObjectState().bounds);
     }
 
     void applyBounds() override
@@ -133,7 +125,7 @@ struct ButtonObject : public GUIObject {
     {
         auto const bounds = getLocalBounds().toFloat();
 
-        g.setColour(Colour::fromString(secondaryColour.toString()));
+        g.setColour(secondary.get());
         g.fillRoundedRectangle(bounds.reduced(1), 3.0f);
 
         bool selected = cnv->isSelected(object) && !cnv->isGraph;
@@ -145,7 +137,7 @@ struct ButtonObject : public GUIObject {
         g.drawRoundedRectangle(bounds.reduced(6), 3.0f, 1.5f);
 
         if (state) {
-            g.setColour(Colour::fromString(primaryColour.toString()));
+            g.setColour(primary.get());
             g.fillRoundedRectangle(bounds.reduced(6), 3.0f);
         }
     }
@@ -162,14 +154,14 @@ struct ButtonObject : public GUIObject {
     {
         auto* button = static_cast<t_fake_button*>(ptr);
         if (value.refersToSameSourceAs(primaryColour)) {
-            auto col = Colour::fromString(primaryColour.toString());
+            auto col = primary.get();
             button->x_fgcolor[0] = col.getRed();
             button->x_fgcolor[1] = col.getGreen();
             button->x_fgcolor[2] = col.getBlue();
             repaint();
         }
         if (value.refersToSameSourceAs(secondaryColour)) {
-            auto col = Colour::fromString(secondaryColour.toString());
+            auto col = secondary.get();
             button->x_bgcolor[0] = col.getRed();
             button->x_bgcolor[1] = col.getGreen();
             button->x_bgcolor[2] = col.getBlue();
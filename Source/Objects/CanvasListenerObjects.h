@@ -110,7 +110,7 @@ struct CanvasMouseObject final : public TextBase
 };
 
 
-struct CanvasVisibleObject final : public TextBase, public ComponentListener, public Timer
+struct CanvasVisibleObject final : public TextBase, public ComponentListener, public FrameScheduler::Client
 {
     struct t_fake_canvas_vis{
         t_object            x_obj;
@@ -127,11 +127,12 @@ struct CanvasVisibleObject final : public TextBase, public ComponentListener, pu
         lastFocus = cnv->hasKeyboardFocus(true);
         setInterceptsMouseClicks(false, false);
         cnv->addComponentListener(this);
-        startTimer(100);
+        cnv->main.frameScheduler.addClient(this, 100);
     }
     
     ~CanvasVisibleObject() {
-        cnv->addComponentListener(this);
+        cnv->removeComponentListener(this);
+        cnv->main.frameScheduler.removeClient(this);
     }
     
     void updateVisibility() {
@@ -153,7 +154,7 @@ struct CanvasVisibleObject final : public TextBase, public ComponentListener, pu
         updateVisibility();
     }
     
-    void timerCallback() override {
+    void frameUpdate() override {
         updateVisibility();
     }
 };
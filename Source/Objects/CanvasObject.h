@@ -39,7 +39,7 @@ struct CanvasObject final : public IEMObject {
 
     void paint(Graphics& g) override
     {
-        g.fillAll(Colour::fromString(secondaryColour.toString()));
+        g.fillAll(secondary.get());
     }
 
     void updateValue() override {};
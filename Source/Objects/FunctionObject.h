@@ -45,8 +45,18 @@ struct FunctionObject final : public GUIObject {
     
     Value range;
     
+    // The whole envelope is sent on every change, so while dragging it's sent at most this often
+    static constexpr int outputRateLimitMs = 25;
+    pd::LatestValue<std::vector<t_atom>> output;
+    
     FunctionObject(void* ptr, Object* object)
     : GUIObject(ptr, object)
+    , output(pd, [x = static_cast<t_fake_function*>(ptr)](std::vector<t_atom>& at) {
+        int ac = static_cast<int>(at.size());
+        outlet_list(x->x_obj.ob_outlet, &s_list, ac - 2, at.data());
+        if(x->x_send != &s_ && x->x_send->s_thing)
+            pd_list(x->x_send->s_thing, &s_list, ac - 2, at.data());
+    }, outputRateLimitMs)
     {
         auto* function = static_cast<t_fake_function*>(ptr);
         secondaryColour = colourFromHexArray(function->x_bgcolor).toString();
@@ -71,14 +81,7 @@ struct FunctionObject final : public GUIObject {
     
     void updateBounds() override
     {
-        pd->getCallbackLock()->enter();
-        
-        int x = 0, y = 0, w = 0, h = 0;
-        libpd_get_object_bounds(cnv->patch.getPointer(), ptr, &x, &y, &w, &h);
-        
-        pd->getCallbackLock()->exit();
-        
-        object->setObjectBounds({x, y, w, h});
+        object->setObjectBounds(getObjectState().bounds);
     }
     
     void resized() override
@@ -119,7 +122,7 @@ struct FunctionObject final : public GUIObject {
     
     void paint(Graphics& g) override
     {
-        g.fillAll(Colour::fromString(secondaryColour.toString()));
+        g.fillAll(secondary.get());
         
         bool selected = cnv->isSelected(object) && !cnv->isGraph;
         auto outlineColour = object->findColour(selected ? PlugDataColour::objectSelectedOutlineColourId : objectOutlineColourId);
@@ -127,7 +130,7 @@ struct FunctionObject final : public GUIObject {
         g.setColour(outlineColour);
         g.drawRoundedRectangle(getLocalBounds().toFloat().reduced(0.5f), 2.0f, 1.0f);
                 
-        g.setColour(Colour::fromString(primaryColour.toString()));
+        g.setColour(primary.get());
         
         auto realPoints = getRealPoints();
         auto lastPoint = realPoints[0];
@@ -139,10 +142,10 @@ struct FunctionObject final : public GUIObject {
         
         for(const auto& point : realPoints) {
             // Make sure line isn't visible through the hole
-            g.setColour(Colour::fromString(secondaryColour.toString()));
+            g.setColour(secondary.get());
             g.fillEllipse(Rectangle<float>().withCentre(point).withSizeKeepingCentre(5, 5));
             
-            g.setColour(Colour::fromString(primaryColour.toString()));
+            g.setColour(primary.get());
             g.drawEllipse(Rectangle<float>().withCentre(point).withSizeKeepingCentre(5, 5), 1.5f);
         }
     }
@@ -247,6 +250,8 @@ struct FunctionObject final : public GUIObject {
     {
         if(dragIdx < 0) return;
         
+        output.flush();
+        
         auto* function = static_cast<t_fake_function*>(ptr);
         points.sort(*this);
         
@@ -291,11 +296,7 @@ struct FunctionObject final : public GUIObject {
             SETFLOAT(at.data()+i, point);
         }
 
-        pd->enqueueFunction([x, at, ac]() mutable {
-            outlet_list(x->x_obj.ob_outlet, &s_list, ac - 2, at.data());
-            if(x->x_send != &s_ && x->x_send->s_thing)
-                pd_list(x->x_send->s_thing, &s_list, ac - 2, at.data());
-        });
+        output.set(std::move(at));
     }
     
     void valueChanged(Value& v) override
@@ -19,6 +19,9 @@ extern "C" {
 #include "PluginEditor.h"
 #include "LookAndFeel.h"
 #include "Pd/PdPatch.h"
+#include "Utility/VisualTap.h"
+#include "Utility/MinMaxPyramid.h"
+#include "Utility/ImageFileCache.h"
 
 #include "IEMObject.h"
 #include "AtomObject.h"
@@ -82,6 +85,18 @@ String ObjectBase::getText()
     return "";
 }
 
+pd::ObjectState ObjectBase::getObjectState() const
+{
+    if (auto const* state = cnv->getObjectState(ptr))
+        return *state;
+
+    pd->getCallbackLock()->enter();
+    auto state = cnv->patch.getObjectState(ptr);
+    pd->getCallbackLock()->exit();
+
+    return state;
+}
+
 String ObjectBase::getType() const
 {
     if (ptr) {
@@ -96,13 +111,12 @@ String ObjectBase::getType() const
 
             return String::fromUTF8(namebuf).fromLastOccurrenceOf("/", false, false);
         }
-        if(String(libpd_get_object_class_name(ptr)) == "text" && static_cast<t_text*>(ptr)->te_type == T_OBJECT)
+        auto* name = pd_class(static_cast<t_pd*>(ptr))->c_name;
+        if(!strcmp(name->s_name, "text") && static_cast<t_text*>(ptr)->te_type == T_OBJECT)
         {
             return String("invalid");
         }
-        if (auto* name = libpd_get_object_class_name(ptr)) {
-            return String(name);
-        }
+        return pd->symbols.toString(name);
     }
 
     return {};
@@ -248,6 +262,7 @@ GUIObject::GUIObject(void* obj, Object* parent)
     : ObjectBase(obj, parent)
     , processor(*parent->cnv->pd)
     , edited(false)
+    , dragValue(parent->cnv->pd, [obj](float& v) { pd_float(static_cast<t_pd*>(obj), v); })
 {
     object->addComponentListener(this);
     updateLabel(); // TODO: fix virtual call from constructor
@@ -340,6 +355,9 @@ void GUIObject::startEdition()
 void GUIObject::stopEdition()
 {
     edited = false;
+
+    // The last value of the drag has to arrive before the mouse is released
+    dragValue.flush();
     processor.enqueueMessages("gui", "mouse", { 0.f });
 }
 
@@ -377,12 +395,18 @@ void GUIObject::componentMovedOrResized(Component& component, bool moved, bool r
 
 void GUIObject::setValue(float value)
 {
+    // A drag can set the value many times per tick, pd only needs to see the last one
+    if (edited) {
+        dragValue.set(value);
+        return;
+    }
+
     cnv->pd->enqueueDirectMessages(ptr, value);
 }
 
 ObjectBase* GUIObject::createGui(void* ptr, Object* parent)
 {
-    const String name = libpd_get_object_class_name(ptr);
+    auto const name = parent->cnv->pd->symbols.toString(pd_class(static_cast<t_pd*>(ptr))->c_name);
     if (name == "bng") {
         return new BangObject(ptr, parent);
     }
@@ -9,18 +9,22 @@
 #include <JuceHeader.h>
 
 #include "PluginProcessor.h"
+#include "Pd/PdLatestValue.h"
 #include "Sidebar/Sidebar.h"
+#include "Utility/RecyclingAllocator.h"
 
 class Canvas;
 
 namespace pd {
 class Patch;
+struct ObjectState;
 }
 
 class Object;
 
 struct ObjectBase : public Component
-    , public SettableTooltipClient {
+    , public SettableTooltipClient
+    , public Recycled {
     void* ptr;
     Object* object;
     Canvas* cnv;
@@ -61,6 +65,12 @@ struct ObjectBase : public Component
         return false;
     }
 
+    // Objects that repaint continuously, like meters and scopes, are left out of the render cache
+    virtual bool isAnimated()
+    {
+        return false;
+    }
+
     virtual void setText(String const&) {};
 
     // Most objects ignore mouseclicks when locked
@@ -72,8 +82,16 @@ struct ObjectBase : public Component
 
     String getType() const;
 
+    // Bounds and text width of the object in pd
+    // While the canvas synchronises, this comes from the state it read for all objects at once
+    pd::ObjectState getObjectState() const;
+
     void moveToFront();
 
+    // Called when the object comes near the visible area for the first time
+    // Objects that are expensive to show can wait until then to build their content
+    virtual void realise() {};
+
     virtual Canvas* getCanvas()
     {
         return nullptr;
@@ -113,6 +131,49 @@ struct NonPatchable : public ObjectBase {
     virtual void applyBounds() {};
 };
 
+// A colour that's kept in a Value as a string, only parsed again after the Value changed
+//! @details Value listeners are called asynchronously, so the owner is repainted once the new colour is known
+class ColourValue : private Value::Listener {
+public:
+    ColourValue(Value& valueToUse, Component& ownerToRepaint)
+        : value(valueToUse)
+        , owner(ownerToRepaint)
+    {
+        value.addListener(this);
+    }
+
+    ~ColourValue() override
+    {
+        value.removeListener(this);
+    }
+
+    Colour get()
+    {
+        if (!valid) {
+            colour = Colour::fromString(value.toString());
+            valid = true;
+        }
+        return colour;
+    }
+
+    operator Colour()
+    {
+        return get();
+    }
+
+private:
+    void valueChanged(Value&) override
+    {
+        valid = false;
+        owner.repaint();
+    }
+
+    Value& value;
+    Component& owner;
+    Colour colour;
+    bool valid = false;
+};
+
 struct GUIObject : public ObjectBase
     , public ComponentListener
     , public Value::Listener {
@@ -187,6 +248,10 @@ protected:
     PlugDataAudioProcessor& processor;
 
     std::atomic<bool> edited;
+
+    // Values set while the object is edited, only the newest one goes to pd
+    pd::LatestValue<float> dragValue;
+
     float value = 0;
     Value min = Value(0.0f);
     Value max = Value(0.0f);
@@ -198,6 +263,10 @@ protected:
     Value secondaryColour;
     Value labelColour;
 
+    // The colours above, for painting
+    ColourValue primary { primaryColour, *this };
+    ColourValue secondary { secondaryColour, *this };
+
     Value labelX = Value(0.0f);
     Value labelY = Value(0.0f);
     Value labelHeight = Value(18.0f);
@@ -19,7 +19,7 @@ public:
         xRange.addListener(this);
         yRange.addListener(this);
 
-        updateCanvas();
+        // The canvas with the graph's content is only made once the graph becomes visible
         resized();
     }
 
@@ -63,15 +63,7 @@ public:
 
     void updateBounds() override
     {
-        pd->getCallbackLock()->enter();
-
-        int x = 0, y = 0, w = 0, h = 0;
-        libpd_get_object_bounds(cnv->patch.getPointer(), ptr, &x, &y, &w, &h);
-        auto bounds = Rectangle<int>(x, y, w, h);
-
-        pd->getCallbackLock()->exit();
-
-        object->setObjectBounds(bounds);
+        object->setObjectBounds(getObjectState().bounds);
     }
 
     ~GraphOnParent() override
@@ -94,15 +86,25 @@ public:
         isLocked = locked;
     }
 
-    void updateCanvas()
+    void realise() override
     {
-        if (!canvas) {
-            canvas = std::make_unique<Canvas>(cnv->main, subpatch, this);
+        if (canvas)
+            return;
 
-            // Make sure that the graph doesn't become the current canvas
-            cnv->patch.setCurrent(true);
-            cnv->main.updateCommandStatus();
-        }
+        canvas = std::make_unique<Canvas>(cnv->main, subpatch, this);
+
+        // Make sure that the graph doesn't become the current canvas
+        cnv->patch.setCurrent(true);
+        cnv->main.updateCommandStatus();
+
+        updateCanvas();
+        updateDrawables();
+    }
+
+    void updateCanvas()
+    {
+        if (!canvas)
+            return;
 
         auto b = getPatch()->getBounds();
         canvas->setBounds(-b.getX(), -b.getY(), b.getWidth() + b.getX(), b.getHeight() + b.getY());
@@ -1,3 +1,4 @@
+#include <bit>
 
 // Inherit to customise drawing
 struct MIDIKeyboard : public MidiKeyboardComponent {
@@ -61,7 +62,7 @@ struct MIDIKeyboard : public MidiKeyboardComponent {
 };
 // ELSE keyboard
 struct KeyboardObject final : public GUIObject
-    , public Timer
+    , public FrameScheduler::Client
     , public MidiKeyboardStateListener {
     typedef struct _edit_proxy {
         t_object p_obj;
@@ -102,8 +103,11 @@ struct KeyboardObject final : public GUIObject
         t_symbol* x_snd_raw;
         t_symbol* x_bindsym;
         t_outlet* x_out;
+        std::atomic<uint32> x_notes[4]; // one bit per note that is on, stored by pd without locking
     } t_keyboard;
 
+    static_assert(sizeof(std::atomic<uint32>) == sizeof(unsigned int) && std::atomic<uint32>::is_always_lock_free);
+
     KeyboardObject(void* ptr, Object* object)
         : GUIObject(ptr, object)
         , keyboard(state, MidiKeyboardComponent::horizontalKeyboard)
@@ -127,7 +131,12 @@ struct KeyboardObject final : public GUIObject
             octaves = 4;
         }
 
-        startTimer(150);
+        cnv->main.frameScheduler.addClient(this, 0);
+    }
+
+    ~KeyboardObject() override
+    {
+        cnv->main.frameScheduler.removeClient(this);
     }
 
     void updateBounds() override
@@ -182,19 +191,7 @@ struct KeyboardObject final : public GUIObject
         if (midiChannel != 1)
             return;
 
-        auto* x = (t_keyboard*)ptr;
-
-        cnv->pd->enqueueFunction(
-            [x, note, velocity]() mutable {
-                int ac = 2;
-                t_atom at[2];
-                SETFLOAT(at, note);
-                SETFLOAT(at + 1, velocity * 127);
-
-                outlet_list(x->x_out, &s_list, ac, at);
-                if (x->x_send != &s_ && x->x_send->s_thing)
-                    pd_list(x->x_send->s_thing, &s_list, ac, at);
-            });
+        playedNotes.emplace_back(note, velocity * 127);
     }
 
     void handleNoteOff(MidiKeyboardState* source, int midiChannel, int note, float velocity) override
@@ -202,19 +199,7 @@ struct KeyboardObject final : public GUIObject
         if (midiChannel != 1)
             return;
 
-        auto* x = (t_keyboard*)ptr;
-
-        cnv->pd->enqueueFunction(
-            [x, note]() mutable {
-                int ac = 2;
-                t_atom at[2];
-                SETFLOAT(at, note);
-                SETFLOAT(at + 1, 0);
-
-                outlet_list(x->x_out, &s_list, ac, at);
-                if (x->x_send != &s_ && x->x_send->s_thing)
-                    pd_list(x->x_send->s_thing, &s_list, ac, at);
-            });
+        playedNotes.emplace_back(note, 0.0f);
     };
 
     ObjectParameters defineParameters() override
@@ -248,25 +233,50 @@ struct KeyboardObject final : public GUIObject
 
     void updateValue() override
     {
-        auto* keyboardObject = static_cast<t_keyboard*>(ptr);
+        frameUpdate();
+    }
 
-        for (int i = keyboard.getRangeStart(); i < keyboard.getRangeEnd(); i++) {
-            if (keyboardObject->x_tgl_notes[i] && !(state.isNoteOn(2, i) && state.isNoteOn(1, i))) {
-                state.noteOn(2, i, 1.0f);
-            }
-            if (!keyboardObject->x_tgl_notes[i] && !(state.isNoteOn(2, i) && state.isNoteOn(1, i))) {
-                state.noteOff(2, i, 1.0f);
+    void frameUpdate() override
+    {
+        sendPlayedNotes();
+
+        // Only the keys whose bit changed since the last frame are updated
+        auto* x = static_cast<t_keyboard*>(ptr);
+        for (int word = 0; word < 4; word++) {
+            auto const notes = x->x_notes[word].load(std::memory_order_relaxed);
+            auto changed = notes ^ shownNotes[word];
+            shownNotes[word] = notes;
+
+            for (; changed != 0; changed &= changed - 1) {
+                auto const bit = std::countr_zero(changed);
+                auto const note = word * 32 + bit;
+
+                if (notes & (1u << bit))
+                    state.noteOn(2, note, 1.0f);
+                else
+                    state.noteOff(2, note, 1.0f);
             }
         }
     }
 
-    void timerCallback() override
+    // The notes played since the last frame go to pd together, in the order they were played
+    void sendPlayedNotes()
     {
-        pd->enqueueFunction([_this = SafePointer(this)] {
-            if (!_this)
-                return;
-            _this->updateValue();
-        });
+        if (playedNotes.empty())
+            return;
+
+        cnv->pd->enqueueFunction(
+            [x = static_cast<t_keyboard*>(ptr), notes = std::exchange(playedNotes, {})]() {
+                for (auto const& [note, velocity] : notes) {
+                    t_atom at[2];
+                    SETFLOAT(at, note);
+                    SETFLOAT(at + 1, velocity);
+
+                    outlet_list(x->x_out, &s_list, 2, at);
+                    if (x->x_send != &s_ && x->x_send->s_thing)
+                        pd_list(x->x_send->s_thing, &s_list, 2, at);
+                }
+            });
     }
 
     void paintOverChildren(Graphics& g) override
@@ -281,6 +291,12 @@ struct KeyboardObject final : public GUIObject
     Value lowC;
     Value octaves;
 
+    // The notes of x_notes that the keyboard shows
+    std::array<uint32, 4> shownNotes = {};
+
+    // Notes played on the keyboard that haven't been sent yet, with their velocity or 0 for note off
+    std::vector<std::pair<int, float>> playedNotes;
+
     MidiKeyboardState state;
     MIDIKeyboard keyboard;
 };
@@ -15,32 +15,33 @@ struct MessageObject final : public TextBase
 {
     bool isDown = false;
     bool isLocked = false;
+    
+    // Reused by getSymbol, which is polled
+    mutable char* textBuffer = nullptr;
+    mutable int textBufferSize = 0;
         
     MessageObject(void* obj, Object* parent)
     : TextBase(obj, parent)
     {
     }
     
+    ~MessageObject()
+    {
+        freebytes(textBuffer, textBufferSize);
+    }
+    
     void updateBounds() override
     {
-        pd->getCallbackLock()->enter();
-        
-        int x = 0, y = 0, w = 0, h = 0;
-        
-        // If it's a text object, we need to handle the resizable width, which pd saves in amount of text characters
-        auto* textObj = static_cast<t_text*>(ptr);
-        
-        libpd_get_object_bounds(cnv->patch.getPointer(), ptr, &x, &y, &w, &h);
+        auto state = getObjectState();
         
-        w = textObj->te_width * glist_fontwidth(cnv->patch.getPointer());
+        // We need to handle the resizable width, which pd saves in amount of text characters
+        int w = state.textWidth * state.fontWidth;
         
-        if (textObj->te_width == 0) {
-            w = Font(15).getStringWidth(getText()) + 19;
+        if (state.textWidth == 0) {
+            w = roundToInt(FastStringWidth::getExactStringWidth(Font(15), currentText)) + 19;
         }
         
-        pd->getCallbackLock()->exit();
-        
-        object->setObjectBounds({ x, y, w, h });
+        object->setObjectBounds(state.bounds.withWidth(w));
     }
     
     void checkBounds() override
@@ -203,21 +204,22 @@ struct MessageObject final : public TextBase
     {
         cnv->pd->setThis();
         
-        char* text;
-        int size;
+        int size = libpd_binbuf_gettext(static_cast<t_message*>(ptr)->m_text.te_binbuf, &textBuffer, &textBufferSize);
         
-        binbuf_gettext(static_cast<t_message*>(ptr)->m_text.te_binbuf, &text, &size);
-        
-        auto result = String::fromUTF8(text, size);
-        freebytes(text, size);
+        // Polled from updateValue, so skip building a new String when nothing changed
+        if (static_cast<size_t>(size) == currentText.getNumBytesAsUTF8() && (size == 0 || memcmp(textBuffer, currentText.toRawUTF8(), size) == 0)) {
+            return currentText;
+        }
         
-        return result;
+        return String::fromUTF8(textBuffer, size);
     }
     
-    void setSymbol(String const& value)
+    void setSymbol(String value)
     {
+        if (value == currentText) return;
+        
         cnv->pd->enqueueFunction(
-                                 [_this = SafePointer(this), ptr = this->ptr, value]() mutable {
+                                 [_this = SafePointer(this), ptr = this->ptr, value = std::move(value)]() mutable {
                                      
                                      if(!_this) return;
                                      
@@ -6,6 +6,9 @@ struct MousePadObject final : public GUIObject {
 
     Point<int> lastPosition;
 
+    // Mouse events can come much faster than pd's ticks, so only the newest position is sent
+    pd::LatestValue<Point<int>> position;
+
     typedef struct _pad {
         t_object x_obj;
         t_glist* x_glist;
@@ -23,6 +26,15 @@ struct MousePadObject final : public GUIObject {
 
     MousePadObject(void* ptr, Object* object)
         : GUIObject(ptr, object)
+        , position(pd, [x = static_cast<t_pad*>(ptr)](Point<int>& newPosition) {
+            x->x_x = newPosition.x;
+            x->x_y = newPosition.y;
+
+            t_atom at[2];
+            SETFLOAT(at, x->x_x);
+            SETFLOAT(at + 1, x->x_y);
+            outlet_anything(x->x_obj.ob_outlet, &s_list, 2, at);
+        })
     {
         cnv->addMouseListener(this, true);
 
@@ -56,15 +68,11 @@ struct MousePadObject final : public GUIObject {
             return;
 
         auto* x = static_cast<t_pad*>(ptr);
-        t_atom at[3];
 
         x->x_x = relativeEvent.getPosition().x;
         x->x_y = relativeEvent.getPosition().y;
 
-        SETFLOAT(at, 1.0f);
-        sys_lock();
-        outlet_anything(x->x_obj.ob_outlet, gensym("click"), 1, at);
-        sys_unlock();
+        sendClick(1.0f);
 
         isPressed = true;
     }
@@ -79,26 +87,14 @@ struct MousePadObject final : public GUIObject {
         if ((!getScreenBounds().contains(e.getScreenPosition()) && !isPressed) || !isLocked)
             return;
 
-        auto* x = static_cast<t_pad*>(ptr);
-        t_atom at[3];
-
         auto relativeEvent = e.getEventRelativeTo(this);
 
         // Don't repeat values
         if (relativeEvent.getPosition() == lastPosition)
             return;
 
-        x->x_x = relativeEvent.getPosition().x;
-        x->x_y = relativeEvent.getPosition().y;
-
-        SETFLOAT(at, x->x_x);
-        SETFLOAT(at + 1, x->x_y);
-
-        lastPosition = { x->x_x, x->x_y };
-
-        sys_lock();
-        outlet_anything(x->x_obj.ob_outlet, &s_list, 2, at);
-        sys_unlock();
+        lastPosition = relativeEvent.getPosition();
+        position.set(lastPosition);
     }
 
     void mouseUp(MouseEvent const& e) override
@@ -106,13 +102,22 @@ struct MousePadObject final : public GUIObject {
         if ((!getScreenBounds().contains(e.getScreenPosition()) && !isPressed))
             return;
 
-        auto* x = static_cast<t_pad*>(ptr);
-        t_atom at[1];
-        SETFLOAT(at, 0);
-        outlet_anything(x->x_obj.ob_outlet, gensym("click"), 1, at);
+        sendClick(0.0f);
         isPressed = false;
     }
 
+    // After the position, so pd gets where the mouse was before it hears about the click
+    void sendClick(float state)
+    {
+        position.flush();
+
+        pd->enqueueFunction([x = static_cast<t_pad*>(ptr), state]() {
+            t_atom at[1];
+            SETFLOAT(at, state);
+            outlet_anything(x->x_obj.ob_outlet, gensym("click"), 1, at);
+        });
+    }
+
     void applyBounds() override
     {
         auto b = object->getObjectBounds();
@@ -125,14 +130,7 @@ struct MousePadObject final : public GUIObject {
 
     void updateBounds() override
     {
-        pd->getCallbackLock()->enter();
-
-        int x = 0, y = 0, w = 0, h = 0;
-        libpd_get_object_bounds(cnv->patch.getPointer(), ptr, &x, &y, &w, &h);
-
-        pd->getCallbackLock()->exit();
-
-        object->setObjectBounds({ x, y, w, h });
+        object->setObjectBounds(getObjectState().bounds);
     }
 
     void lock(bool locked) override
@@ -42,15 +42,7 @@ struct NumberObject final : public IEMObject {
 
     void updateBounds() override
     {
-        pd->getCallbackLock()->enter();
-
-        int x = 0, y = 0, w = 0, h = 0;
-        libpd_get_object_bounds(cnv->patch.getPointer(), ptr, &x, &y, &w, &h);
-        auto bounds = Rectangle<int>(x, y, w, h);
-
-        pd->getCallbackLock()->exit();
-
-        object->setObjectBounds(bounds);
+        object->setObjectBounds(getObjectState().bounds);
     }
 
     void checkBounds() override
@@ -28,11 +28,20 @@ typedef struct _numbox {
 } t_numbox;
 
 struct NumboxTildeObject final : public GUIObject
-    , public Timer {
+    , public FrameScheduler::Client {
     DraggableNumber input;
 
-    int nextInterval = 100;
-    std::atomic<int> mode = 0;
+    // What the audio thread copies out of the numbox~ after every block
+    struct State {
+        float value = 0.0f;
+        int mode = 0;
+        int interval = 100;
+    };
+
+    VisualTap<State> states;
+
+    int scheduledInterval = 100;
+    int mode = 0;
 
     Value interval, ramp, init;
 
@@ -73,25 +82,26 @@ struct NumboxTildeObject final : public GUIObject
 
         addMouseListener(this, true);
 
+        input.dragStart = [this]() { startEdition(); };
         input.valueChanged = [this](float value) { setValue(value); };
+        input.dragEnd = [this]() { stopEdition(); };
 
         mode = static_cast<t_numbox*>(ptr)->x_outmode;
 
-        startTimer(nextInterval);
+        cnv->main.frameScheduler.addClient(this, scheduledInterval);
+        pd->addAudioThreadObject(this);
         repaint();
     }
 
-    void updateBounds() override
+    ~NumboxTildeObject() override
     {
-        pd->getCallbackLock()->enter();
-
-        int x = 0, y = 0, w = 0, h = 0;
-        libpd_get_object_bounds(cnv->patch.getPointer(), ptr, &x, &y, &w, &h);
-        auto bounds = Rectangle<int>(x, y, w, h);
-
-        pd->getCallbackLock()->exit();
+        pd->removeAudioThreadObject(this);
+        cnv->main.frameScheduler.removeClient(this);
+    }
 
-        object->setObjectBounds(bounds);
+    void updateBounds() override
+    {
+        object->setObjectBounds(getObjectState().bounds);
     }
 
     void checkBounds() override
@@ -123,6 +133,11 @@ struct NumboxTildeObject final : public GUIObject
         nbx->x_numwidth = (2.0f * (-6.0f + b.getWidth() - nbx->x_fontsize)) / (4.0f + nbx->x_fontsize);
     }
 
+    bool isAnimated() override
+    {
+        return true;
+    }
+
     void resized() override
     {
         input.setBounds(getLocalBounds().withTrimmedLeft(getHeight() - 4));
@@ -202,7 +217,7 @@ struct NumboxTildeObject final : public GUIObject
 
     void paint(Graphics& g) override
     {
-        g.setColour(Colour::fromString(secondaryColour.toString()));
+        g.setColour(secondary.get());
         g.fillRoundedRectangle(getLocalBounds().toFloat().reduced(0.5f), 2.0f);
 
         bool selected = cnv->isSelected(object) && !cnv->isGraph;
@@ -212,36 +227,53 @@ struct NumboxTildeObject final : public GUIObject
         g.drawRoundedRectangle(getLocalBounds().toFloat().reduced(0.5f), 2.0f, 1.0f);
     }
 
-    void timerCallback() override
+    // Called on the audio thread, with pd locked
+    void updateFromAudioThread() override
+    {
+        auto* nbx = static_cast<t_numbox*>(ptr);
+        states.publish([nbx](State& state) {
+            state.mode = nbx->x_outmode;
+            state.value = state.mode ? nbx->x_display : nbx->x_in_val;
+            state.interval = nbx->x_rate;
+        });
+    }
+
+    void frameUpdate() override
     {
+        auto const* state = states.read();
+        if (!state)
+            return;
+
+        if (state->mode != mode) {
+            mode = state->mode;
+            repaint();
+        }
+
         if (!mode) {
-            input.setText(input.formatNumber(getValueOriginal()), dontSendNotification);
+            value = state->value;
+            input.setText(input.formatNumber(value), dontSendNotification);
         }
 
-        startTimer(nextInterval);
+        // The rate can be changed from pd
+        if (state->interval != scheduledInterval) {
+            scheduledInterval = state->interval;
+            cnv->main.frameScheduler.addClient(this, scheduledInterval);
+        }
     }
 
+    // Updated by frameUpdate() instead
+    void updateValue() override {};
+
+    // setValueOriginal sends it to pd
     void setValue(float newValue)
     {
-        t_atom at;
-        SETFLOAT(&at, newValue);
         setValueOriginal(newValue);
-
-        pd->getCallbackLock()->enter();
-        pd_float(static_cast<t_pd*>(ptr), newValue);
-        pd->getCallbackLock()->exit();
     }
 
     float getValue() override
     {
         auto* object = static_cast<t_numbox*>(ptr);
-
-        // Kinda ugly, but use this audio-thread function to update all the variables
-
-        mode = object->x_outmode;
-        nextInterval = object->x_rate;
-
-        return mode ? object->x_display : object->x_in_val;
+        return object->x_outmode ? object->x_display : object->x_in_val;
     }
 
     float getMinimum()
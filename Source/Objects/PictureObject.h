@@ -56,8 +56,11 @@ struct PictureObject final : public GUIObject {
 
     void paint(Graphics& g) override
     {
-        if (imageFile.existsAsFile()) {
-            g.drawImageAt(img, 0, 0);
+        if (img.isValid()) {
+            // Drawn from a copy made for the zoom level, instead of resampling the image every time
+            auto scale = Component::getApproximateScaleFactorForComponent(this);
+            auto scaled = ImageFileCache::getInstance()->getScaled(imageFile, img, scale);
+            g.drawImage(scaled, Rectangle<float>(0.0f, 0.0f, img.getWidth(), img.getHeight()));
         } else {
             g.setFont(30);
             g.setColour(object->findColour(PlugDataColour::canvasTextColourId));
@@ -90,22 +93,14 @@ struct PictureObject final : public GUIObject {
 
     void updateBounds() override
     {
-        pd->getCallbackLock()->enter();
-
-        int x = 0, y = 0, w = 0, h = 0;
-        libpd_get_object_bounds(cnv->patch.getPointer(), ptr, &x, &y, &w, &h);
-        auto bounds = Rectangle<int>(x, y, w, h);
-
-        pd->getCallbackLock()->exit();
-
-        object->setObjectBounds(bounds);
+        object->setObjectBounds(getObjectState().bounds);
     }
 
     void checkBounds() override
     {
         auto* pic = static_cast<t_pic*>(ptr);
 
-        if (!imageFile.existsAsFile()) {
+        if (!img.isValid()) {
             object->setSize(50, 50);
         } else if (pic->x_height != img.getHeight() || pic->x_width != img.getWidth()) {
             object->setSize(img.getWidth(), img.getHeight());
@@ -132,8 +127,18 @@ struct PictureObject final : public GUIObject {
         pic->x_filename = gensym(charptr);
         pic->x_fullname = gensym(charptr);
 
-        img = ImageFileFormat::loadFrom(imageFile);
+        // Decoded in the background, the same file is only decoded once for all objects
+        ImageFileCache::getInstance()->load(imageFile, [_this = SafePointer(this), file = imageFile](Image image) {
+            if (_this && _this->imageFile == file)
+                _this->setImage(image);
+        });
+    }
+
+    void setImage(Image image)
+    {
+        auto* pic = static_cast<t_pic*>(ptr);
 
+        img = image;
         pic->x_width = img.getWidth();
         pic->x_height = img.getHeight();
 
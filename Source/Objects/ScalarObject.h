@@ -104,6 +104,9 @@ struct DrawableCurve final : public DrawableTemplate, public DrawablePath {
     int baseX, baseY;
     Canvas* canvas;
 
+    // The points the path was last built from, an unchanged curve keeps its path and isn't repainted
+    std::vector<int> lastPixels;
+
     DrawableCurve(t_scalar* s, t_gobj* obj, Canvas* cnv, int x, int y)
         : scalar(s)
         , object(reinterpret_cast<t_fake_curve*>(obj))
@@ -128,11 +131,12 @@ struct DrawableCurve final : public DrawableTemplate, public DrawablePath {
         t_template* t = template_findbyname(scalar->sc_template);
         scalar_doclick(scalar->sc_vec, t, scalar, 0, canvas->patch.getPointer(), 0, 0, relativeEvent.x, relativeEvent.y, shift, alt, dbl, 1);
 
-        // Update all drawables
+        // Clicking only changes this scalar, pd tells us when it changes others
         for (auto* object : canvas->objects) {
-            if (!object->gui)
-                continue;
-            object->gui->updateDrawables();
+            if (object->gui && object->getPointer() == scalar) {
+                object->gui->updateDrawables();
+                break;
+            }
         }
     }
 
@@ -190,12 +194,26 @@ struct DrawableCurve final : public DrawableTemplate, public DrawablePath {
             if (glist->gl_isgraph)
                 width *= glist_getzoom(glist);
 
-            numbertocolor(fielddesc_getfloat(&x->x_outlinecolor, templ, data, 1), outline);
+            auto outlineNumber = static_cast<int>(fielddesc_getfloat(&x->x_outlinecolor, templ, data, 1));
+            auto fillNumber = closed ? static_cast<int>(fielddesc_getfloat(&x->x_fillcolor, templ, data, 1)) : -1;
+
+            // Everything the drawing depends on
+            std::vector<int> pixels(pix, pix + 2 * n);
+            pixels.push_back(closed);
+            pixels.push_back(outlineNumber);
+            pixels.push_back(fillNumber);
+            pixels.push_back(static_cast<int>(width * 100.0f));
+            if (pixels == lastPixels)
+                return;
+
+            lastPixels = std::move(pixels);
+
+            numbertocolor(outlineNumber, outline);
             setStrokeFill(Colour::fromString("FF" + String::fromUTF8(outline + 1)));
             setStrokeThickness(width);
 
             if (closed) {
-                numbertocolor(fielddesc_getfloat(&x->x_fillcolor, templ, data, 1), fill);
+                numbertocolor(fillNumber, fill);
                 setFill(Colour::fromString("FF" + String::fromUTF8(fill + 1)));
             } else {
                 setFill(Colours::transparentBlack);
@@ -53,17 +53,27 @@ struct t_fake_scope {
     void*           x_handle;
 };
 
-struct ScopeObject final : public GUIObject, public Timer {
+struct ScopeObject final : public GUIObject, public FrameScheduler::Client {
     
-    std::vector<float> x_buffer;
-    std::vector<float> y_buffer;
+    // What the audio thread copies out of the scope after every block
+    struct Snapshot {
+        std::array<float, SCOPE_MAXBUFSIZE * 4> x, y;
+        int bufsize = 0;
+        int mode = 0;
+        float min = 0.0f, max = 0.0f;
+    };
+    
+    // Copying the buffers waits until the last snapshot was drawn
+    VisualTap<Snapshot> snapshots { true };
+    Path trace;
     
     Value gridColour, triggerMode, triggerValue, samplesPerPoint, bufferSize, delay, receiveSymbol, signalRange;
+    ColourValue grid { gridColour, *this };
     
     ScopeObject(void* ptr, Object* object)
         : GUIObject(ptr, object)
     {
-        startTimerHz(25);
+        cnv->main.frameScheduler.addClient(this, 40);
         
         auto* scope = static_cast<t_fake_scope*>(ptr);
         triggerMode = scope->x_trigmode + 1;
@@ -91,6 +101,14 @@ struct ScopeObject final : public GUIObject, public Timer {
         delay.addListener(this);
         triggerMode.addListener(this);
         triggerValue.addListener(this);
+        
+        pd->addAudioThreadObject(this);
+    }
+    
+    ~ScopeObject() override
+    {
+        pd->removeAudioThreadObject(this);
+        cnv->main.frameScheduler.removeClient(this);
     }
     
     Colour colourFromHexArray(unsigned char* hex) {
@@ -104,14 +122,12 @@ struct ScopeObject final : public GUIObject, public Timer {
 
     void updateBounds() override
     {
-        pd->getCallbackLock()->enter();
-
-        int x = 0, y = 0, w = 0, h = 0;
-        libpd_get_object_bounds(cnv->patch.getPointer(), ptr, &x, &y, &w, &h);
-
-        pd->getCallbackLock()->exit();
+        object->setObjectBounds(getObjectState().bounds);
+    }
 
-        object->setObjectBounds({x, y, w, h});
+    bool isAnimated() override
+    {
+        return true;
     }
 
     void resized() override
@@ -131,7 +147,7 @@ struct ScopeObject final : public GUIObject, public Timer {
 
     void paint(Graphics& g) override
     {
-        g.fillAll(Colour::fromString(secondaryColour.toString()));
+        g.fillAll(secondary.get());
         
         bool selected = cnv->isSelected(object) && !cnv->isGraph;
         auto outlineColour = object->findColour(selected ? PlugDataColour::objectSelectedOutlineColourId : objectOutlineColourId);
@@ -142,7 +158,7 @@ struct ScopeObject final : public GUIObject, public Timer {
         auto dx = getWidth() * 0.125f;
         auto dy = getHeight() * 0.25f;
         
-        g.setColour(Colour::fromString(gridColour.toString()));
+        g.setColour(grid.get());
         
         float xx;
         for(int i = 0, xx = dx; i < 7; i++, xx += dx) {
@@ -154,20 +170,8 @@ struct ScopeObject final : public GUIObject, public Timer {
             g.drawLine(0, yy, getWidth(), yy);
         }
         
-        if(y_buffer.empty() || x_buffer.empty()) return;
-        
-        Point<float> lastPoint = Point<float>(x_buffer[0], y_buffer[0]);
-        Point<float> newPoint;
-
-        g.setColour(Colour::fromString(primaryColour.toString()));
-        
-        Path p;
-        for (size_t i = 1; i < y_buffer.size(); i++) {
-            newPoint = Point<float>(x_buffer[i], y_buffer[i]);
-            g.drawLine({lastPoint, newPoint});
-            lastPoint = newPoint;
-        }
-        
+        g.setColour(primary.get());
+        g.strokePath(trace, PathStrokeType(1.0f));
     }
     
     // Push current object bounds into pd
@@ -180,59 +184,85 @@ struct ScopeObject final : public GUIObject, public Timer {
         static_cast<t_fake_scope*>(ptr)->x_height = getHeight();
     }
     
-    void timerCallback() override
+    // Called on the audio thread, with pd locked
+    void updateFromAudioThread() override
     {
-        int bufsize, mode;
-        float min, max;
+        auto* x = static_cast<t_fake_scope*>(ptr);
         
-        if(object->iolets.size() == 3) object->iolets[2]->setVisible(false);
-
-        if(pd->getCallbackLock()->tryEnter())
-        {
-            auto* x = static_cast<t_fake_scope*>(ptr);
-            bufsize = x->x_bufsize;
-            min = x->x_min;
-            max = x->x_max;
-            mode = x->x_xymode;
-            
-            if(x_buffer.size() != bufsize) {
-                x_buffer.resize(bufsize);
-                y_buffer.resize(bufsize);
-            }
+        snapshots.publish([x](Snapshot& snapshot) {
+            snapshot.bufsize = jlimit(0, SCOPE_MAXBUFSIZE * 4, x->x_bufsize);
+            snapshot.mode = x->x_xymode;
+            snapshot.min = std::min(x->x_min, x->x_max);
+            snapshot.max = std::max(x->x_min, x->x_max);
             
-            std::copy(x->x_xbuflast, x->x_xbuflast + bufsize, x_buffer.data());
-            std::copy(x->x_ybuflast, x->x_ybuflast + bufsize, y_buffer.data());
-            pd->getCallbackLock()->exit();
-        }
-        else {
+            std::copy(x->x_xbuflast, x->x_xbuflast + snapshot.bufsize, snapshot.x.data());
+            std::copy(x->x_ybuflast, x->x_ybuflast + snapshot.bufsize, snapshot.y.data());
+        });
+    }
+    
+    void frameUpdate() override
+    {
+        if(object->iolets.size() == 3) object->iolets[2]->setVisible(false);
+        
+        auto const* snapshot = snapshots.read();
+        if (!snapshot)
             return;
-        }
         
-        if(min > max) {
-            auto temp = max;
-            max = min;
-            min = temp;
+        auto const width = static_cast<float>(getWidth());
+        auto const height = static_cast<float>(getHeight());
+        auto const bufsize = snapshot->bufsize;
+        
+        trace.clear();
+        
+        if (bufsize < 2) {
+            repaint();
+            return;
         }
-
-        float oldx = 0, oldy = 0;
-        float dx = getWidth() / (float)bufsize;
-        float dy = getHeight() / (float)bufsize;
-
-        for(int n = 0; n < bufsize; n++) {
-            if(mode == 1) {
-                y_buffer[n] = jmap<float>(x_buffer[n], min, max, getHeight(), 0);
-                x_buffer[n] = oldx;
-                oldx += dx;
-            }
-            else if(mode == 2) {
-                x_buffer[n] = jmap<float>(y_buffer[n], min, max, 0, getWidth());
-                y_buffer[n] = oldy;
-                oldy += dy;
+        
+        auto mapX = [&](float value) { return jmap<float>(value, snapshot->min, snapshot->max, 0, width); };
+        auto mapY = [&](float value) { return jmap<float>(value, snapshot->min, snapshot->max, height, 0); };
+        
+        // One signal against time, time runs along the length of the given axis
+        auto drawSignal = [&](float const* samples, bool vertical, float length) {
+            auto const numPixels = std::max(1, roundToInt(length));
+            auto const step = length / static_cast<float>(bufsize);
+            
+            auto toPoint = [&](float position, float value) {
+                return vertical ? Point<float>(mapX(value), position) : Point<float>(position, mapY(value));
+            };
+            
+            // With fewer samples than pixels, just connect the samples
+            if (bufsize <= numPixels) {
+                trace.startNewSubPath(toPoint(0, samples[0]));
+                for (int n = 1; n < bufsize; n++)
+                    trace.lineTo(toPoint(n * step, samples[n]));
+                return;
             }
-            else if(mode == 3) {
-                x_buffer[n] = jmap<float>(x_buffer[n], min, max, 0, getWidth());
-                y_buffer[n] = jmap<float>(y_buffer[n], min, max, getHeight(), 0);
+            
+            // Otherwise draw the range of the samples that fall in each pixel
+            for (int pixel = 0; pixel < numPixels; pixel++) {
+                auto const start = pixel * bufsize / numPixels;
+                auto const end = std::max(start + 1, (pixel + 1) * bufsize / numPixels);
+                auto const range = FloatVectorOperations::findMinAndMax(samples + start, end - start);
+                
+                auto const position = static_cast<float>(pixel);
+                if (pixel == 0)
+                    trace.startNewSubPath(toPoint(position, range.getStart()));
+                else
+                    trace.lineTo(toPoint(position, range.getStart()));
+                
+                trace.lineTo(toPoint(position, range.getEnd()));
             }
+        };
+        
+        if (snapshot->mode == 1) {
+            drawSignal(snapshot->x.data(), false, width);
+        } else if (snapshot->mode == 2) {
+            drawSignal(snapshot->y.data(), true, height);
+        } else if (snapshot->mode == 3) {
+            trace.startNewSubPath(mapX(snapshot->x[0]), mapY(snapshot->y[0]));
+            for (int n = 1; n < bufsize; n++)
+                trace.lineTo(mapX(snapshot->x[n]), mapY(snapshot->y[n]));
         }
         
         repaint();
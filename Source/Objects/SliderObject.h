@@ -69,6 +69,11 @@ struct SliderObject : public IEMObject {
         g.drawRoundedRectangle(getLocalBounds().toFloat().reduced(0.5f), 2.0f, 1.0f);
     }
 
+    bool isAnimated() override
+    {
+        return true;
+    }
+
     void resized() override
     {
         slider.setBounds(getLocalBounds());
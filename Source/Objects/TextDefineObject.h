@@ -25,12 +25,21 @@ struct TextDefineObject final : public TextBase {
     std::unique_ptr<Component> textEditor;
     std::unique_ptr<Dialog> saveDialog;
 
+    // Reused by getText, so reading a large [text] doesn't allocate a new buffer every time
+    char* textBuffer = nullptr;
+    int textBufferSize = 0;
+
     TextDefineObject(void* obj, Object* parent, bool isValid = true)
         : TextBase(obj, parent, isValid)
         , textEditor(nullptr)
     {
     }
 
+    ~TextDefineObject()
+    {
+        freebytes(textBuffer, textBufferSize);
+    }
+
     void lock(bool isLocked) override
     {
         setInterceptsMouseClicks(isLocked, false);
@@ -73,50 +82,19 @@ struct TextDefineObject final : public TextBase {
     {
         auto& textbuf = static_cast<t_fake_text_define*>(ptr)->x_textbuf;
 
-        text = text.removeCharacters("\r");
-        auto lines = StringArray::fromTokens(text, ";", "\"");
-        auto atoms = std::vector<t_atom>();
-        atoms.reserve(lines.size());
-
-        for (int i = 0; i < lines.size(); i++) {
-            if (lines[i].isEmpty())
-                continue;
-
-            auto words = StringArray::fromTokens(lines[i], " ", "\"");
-            for (int j = 0; j < words.size(); j++) {
-                atoms.emplace_back();
-                if (words[j].containsOnly("0123456789e.-+") && words[j] != "-") {
-                    SETFLOAT(&atoms.back(), words[j].getFloatValue());
-                } else {
-                    SETSYMBOL(&atoms.back(), gensym((words[j].toRawUTF8())));
-                }
-            }
-
-            atoms.emplace_back();
-            SETSYMBOL(&atoms.back(), gensym(";"));
-        }
-
-        pd->enqueueFunction([this, atoms, &textbuf]() mutable {
-            binbuf_clear(textbuf.b_binbuf);
-
-            t_binbuf* z = binbuf_new();
-            binbuf_restore(z, atoms.size(), atoms.data());
-            binbuf_add(textbuf.b_binbuf, binbuf_getnatom(z), binbuf_getvec(z));
-            binbuf_free(z);
+        // Parsed by pd straight into the existing binbuf, like pd's own text editor does
+        pd->enqueueFunction([text = std::move(text), &textbuf]() {
+            libpd_binbuf_settext(textbuf.b_binbuf, text.toRawUTF8(), text.getNumBytesAsUTF8());
         });
     }
 
     String getText() override
     {
         auto& textbuf = static_cast<t_fake_text_define*>(ptr)->x_textbuf;
-        auto* binbuf = textbuf.b_binbuf;
-
-        char* bufp;
-        int lenp;
 
-        binbuf_gettext(binbuf, &bufp, &lenp);
+        int length = libpd_binbuf_gettext(textbuf.b_binbuf, &textBuffer, &textBufferSize);
 
-        return String::fromUTF8(bufp, lenp);
+        return String::fromUTF8(textBuffer, length);
     }
 
     bool canOpenFromMenu() override
@@ -34,7 +34,7 @@ struct TextBase : public ObjectBase
         int width = textObjectWidth * fontWidth + textWidthOffset;
         width = std::max(width, std::max({ 1, object->numInputs, object->numOutputs }) * 18);
 
-        numLines = getNumLines(currentText, width);
+        numLines = getCachedNumLines(width);
         int height = numLines * 15 + 6;
 
         if (getWidth() != width || getHeight() != height) {
@@ -51,13 +51,22 @@ struct TextBase : public ObjectBase
         g.setColour(object->findColour(PlugDataColour::canvasBackgroundColourId));
         g.fillRoundedRectangle(getLocalBounds().toFloat().reduced(0.5f), 2.0f);
 
-        TextLayout textLayout;
         auto textArea = border.subtractedFrom(getLocalBounds());
-        AttributedString attributedCurrentText(currentText);
-        attributedCurrentText.setColour(object->findColour(PlugDataColour::canvasTextColourId));
-        attributedCurrentText.setFont(font);
-        attributedCurrentText.setJustification(justification);
-        textLayout.createLayout(attributedCurrentText, textArea.getWidth());
+        auto textColour = object->findColour(PlugDataColour::canvasTextColourId);
+
+        // Zooming and scrolling repaint every object, so only lay out the text again when it changed
+        if (layoutWidth != textArea.getWidth() || layoutColour != textColour || layoutText != currentText) {
+            AttributedString attributedCurrentText(currentText);
+            attributedCurrentText.setColour(textColour);
+            attributedCurrentText.setFont(font);
+            attributedCurrentText.setJustification(justification);
+            textLayout.createLayout(attributedCurrentText, textArea.getWidth());
+
+            layoutText = currentText;
+            layoutWidth = textArea.getWidth();
+            layoutColour = textColour;
+        }
+
         textLayout.draw(g, textArea.toFloat());
 
         bool selected = cnv->isSelected(object) && !cnv->isGraph;
@@ -80,7 +89,29 @@ struct TextBase : public ObjectBase
 
     virtual int getBestTextWidth(String const& text)
     {
-        return std::max<float>(round(font.getStringWidthFloat(text) + 14.0f), 32);
+        return std::max<float>(round(FastStringWidth::getExactStringWidth(font, text) + 14.0f), 32);
+    }
+
+    // Synchronising a patch calls updateBounds on every object, usually without its text having changed
+    int getCachedBestTextWidth()
+    {
+        if (bestWidthText != currentText || bestTextWidth < 0) {
+            bestWidthText = currentText;
+            bestTextWidth = getBestTextWidth(currentText);
+        }
+
+        return bestTextWidth;
+    }
+
+    int getCachedNumLines(int width)
+    {
+        if (numLinesText != currentText || numLinesWidth != width) {
+            numLinesText = currentText;
+            numLinesWidth = width;
+            numLinesForWidth = getNumLines(currentText, width);
+        }
+
+        return numLinesForWidth;
     }
 
     void textEditorReturnKeyPressed(TextEditor& ed) override
@@ -102,20 +133,12 @@ struct TextBase : public ObjectBase
 
     void updateBounds() override
     {
-        pd->getCallbackLock()->enter();
-
-        int x, y, w, h;
-
-        auto* textObj = static_cast<t_text*>(ptr);
+        auto state = getObjectState();
 
-        libpd_get_object_bounds(cnv->patch.getPointer(), ptr, &x, &y, &w, &h);
+        Rectangle<int> bounds = state.bounds.withWidth(state.textWidth);
 
-        Rectangle<int> bounds = { x, y, textObj->te_width, h };
-
-        int fontWidth = glist_fontwidth(cnv->patch.getPointer());
-        int textWidth = getBestTextWidth(currentText);
-
-        pd->getCallbackLock()->exit();
+        int fontWidth = state.fontWidth;
+        int textWidth = getCachedBestTextWidth();
 
         // We need to handle the resizable width, which pd saves in amount of text characters
         textWidthOffset = textWidth % fontWidth;
@@ -128,7 +151,7 @@ struct TextBase : public ObjectBase
         int width = textObjectWidth * fontWidth + textWidthOffset;
         width = std::max(width, std::max({ 1, object->numInputs, object->numOutputs }) * 18);
 
-        numLines = getNumLines(currentText, width);
+        numLines = getCachedNumLines(width);
         int height = numLines * 15 + 6;
 
         bounds.setWidth(width);
@@ -242,6 +265,19 @@ protected:
     int textWidthOffset = 0;
     int numLines = 1;
 
+    // Measurements of currentText, see getCachedBestTextWidth and getCachedNumLines
+    String bestWidthText;
+    int bestTextWidth = -1;
+    String numLinesText;
+    int numLinesWidth = -1;
+    int numLinesForWidth = 1;
+
+    // Layout of currentText as last painted
+    TextLayout textLayout;
+    String layoutText;
+    int layoutWidth = -1;
+    Colour layoutColour;
+
     bool wasSelected = false;
     bool isValid = true;
 };
@@ -1,9 +1,31 @@
 
 
-struct VUMeterObject final : public IEMObject {
+struct VUMeterObject final : public IEMObject
+    , public FrameScheduler::Client {
+
+    // What the audio thread copies out of the vu after every block, in dB
+    struct Levels {
+        float peak = 0.0f;
+        float rms = 0.0f;
+    };
+
+    VisualTap<Levels> levels;
+    Levels shown;
+
     VUMeterObject(void* ptr, Object* object)
         : IEMObject(ptr, object)
     {
+        shown.peak = static_cast<t_vu*>(ptr)->x_fp;
+        shown.rms = static_cast<t_vu*>(ptr)->x_fr;
+
+        cnv->main.frameScheduler.addClient(this, 40);
+        pd->addAudioThreadObject(this);
+    }
+
+    ~VUMeterObject() override
+    {
+        pd->removeAudioThreadObject(this);
+        cnv->main.frameScheduler.removeClient(this);
     }
 
     void checkBounds() override
@@ -22,9 +44,29 @@ struct VUMeterObject final : public IEMObject {
         return static_cast<t_vu*>(ptr)->x_fp;
     }
 
-    float getRMS()
+    // Called on the audio thread, with pd locked
+    void updateFromAudioThread() override
     {
-        return static_cast<t_vu*>(ptr)->x_fr;
+        auto* vu = static_cast<t_vu*>(ptr);
+        levels.publish([vu](Levels& latest) {
+            latest.peak = vu->x_fp;
+            latest.rms = vu->x_fr;
+        });
+    }
+
+    void frameUpdate() override
+    {
+        auto const* latest = levels.read();
+        if (!latest || (latest->peak == shown.peak && latest->rms == shown.rms))
+            return;
+
+        shown = *latest;
+        repaint();
+    }
+
+    bool isAnimated() override
+    {
+        return true;
     }
 
     void resized() override
@@ -33,7 +75,7 @@ struct VUMeterObject final : public IEMObject {
 
     void paint(Graphics& g) override
     {
-        auto values = std::vector<float> { getValue(), getRMS() };
+        auto values = std::vector<float> { shown.peak, shown.rms };
 
         int height = getHeight();
         int width = getWidth();
@@ -102,8 +144,6 @@ struct VUMeterObject final : public IEMObject {
         g.drawRoundedRectangle(getLocalBounds().toFloat().reduced(0.5f), 2.0f, 1.0f);
     }
 
-    void updateValue() override
-    {
-        repaint();
-    };
+    // Redrawn by frameUpdate() when the levels change
+    void updateValue() override {};
 };
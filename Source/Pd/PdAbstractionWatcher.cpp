@@ -0,0 +1,90 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "PdAbstractionWatcher.h"
+#include "PdInstance.h"
+
+extern "C" {
+#include <m_pd.h>
+#include <g_canvas.h>
+#include "x_libpd_mod_utils.h"
+#include "x_libpd_abscache.h"
+}
+
+namespace pd {
+
+AbstractionWatcher::AbstractionWatcher(Instance& pd)
+    : instance(pd)
+{
+    watcher.addListener(this);
+}
+
+AbstractionWatcher::~AbstractionWatcher()
+{
+    watcher.removeListener(this);
+}
+
+void AbstractionWatcher::setPatchFiles(Array<File> const& files)
+{
+    Array<File> newFolders;
+    for (auto const& file : files) {
+        if (file.existsAsFile())
+            newFolders.addIfNotAlreadyThere(file.getParentDirectory());
+    }
+
+    if (newFolders == folders)
+        return;
+
+    for (auto const& folder : folders) {
+        if (!newFolders.contains(folder))
+            watcher.removeFolder(folder);
+    }
+
+    for (auto const& folder : newFolders) {
+        if (!folders.contains(folder))
+            watcher.addFolder(folder);
+    }
+
+    folders = newFolders;
+}
+
+void AbstractionWatcher::fsFilesChanged(FileSystemWatcher::FileChanges const& changes)
+{
+    std::vector<void*> openCanvases;
+
+    for (auto const& [file, fsEvent] : changes) {
+        if (file.getFileExtension() != ".pd" || fsEvent == FileSystemWatcher::fileDeleted || fsEvent == FileSystemWatcher::fileRenamedOldName)
+            continue;
+
+        // Only fetched once something might be reloaded
+        if (openCanvases.empty() && getOpenCanvases)
+            openCanvases = getOpenCanvases();
+
+        // pd uses forward slashes on every platform
+        auto const dirPath = file.getParentDirectory().getFullPathName().replaceCharacter('\\', '/');
+
+        instance.getCallbackLock()->enter();
+        instance.setThis();
+
+        auto* name = gensym(file.getFileName().toRawUTF8());
+        auto* dir = gensym(dirPath.toRawUTF8());
+
+        // The modification time alone can miss changes within the same second
+        libpd_abscache_invalidate(name, dir);
+
+        bool inUse = false;
+        for (auto* cnv : openCanvases) {
+            inUse = inUse || libpd_is_inside_abstraction(static_cast<t_canvas*>(cnv), name, dir);
+        }
+
+        if (!inUse)
+            libpd_reload_abstraction(name, dir);
+
+        instance.getCallbackLock()->exit();
+    }
+}
+
+} // namespace pd
@@ -0,0 +1,45 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include "../Utility/FileSystemWatcher.h"
+
+namespace pd {
+
+class Instance;
+
+// Reloads abstractions in place when their file changes on disk
+//! @details Watches the folders of the open patches. When a .pd file in them changes, pd reopens every
+//! instance of it, which keeps their connections and sorts the DSP graph once. Only the canvases that
+//! contain an instance synchronise, and they only rebuild the objects that were replaced.
+//! An abstraction is left alone while one of its instances, or a subpatch in one, is open: that canvas
+//! would be freed under its patch. This is also what keeps saving an abstraction from plugdata from
+//! reloading it.
+class AbstractionWatcher : public FileSystemWatcher::Listener {
+public:
+    explicit AbstractionWatcher(Instance& instance);
+    ~AbstractionWatcher() override;
+
+    // Watches the folders of these files from now on
+    void setPatchFiles(Array<File> const& files);
+
+    // Canvases that are in use, which must not be freed by a reload: open patches and the graphs
+    // that are drawn inside graph-on-parent boxes. Called on the message thread
+    std::function<std::vector<void*>()> getOpenCanvases;
+
+    void fsChangeCallback() override { }
+    void fsFilesChanged(FileSystemWatcher::FileChanges const& changes) override;
+
+private:
+    Instance& instance;
+    FileSystemWatcher watcher;
+    Array<File> folders;
+};
+
+} // namespace pd
@@ -0,0 +1,88 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <coroutine>
+#include <optional>
+#include <type_traits>
+
+#include "PdInstance.h"
+
+namespace pd {
+
+// Return type for a coroutine on the message thread that waits for pd with co_await
+//! @details It starts right away and runs until its first co_await, the rest runs from the message loop.
+//! Nothing waits for it to finish, so anything it uses after a co_await has to be checked, for example
+//! with a SafePointer, as the editor may have changed in the meantime.
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept { }
+        void unhandled_exception() noexcept { jassertfalse; }
+    };
+};
+
+// Calls a function on pd's thread, then resumes the coroutine that awaits it on the message thread
+// co_await gives the result of the function. See Instance::onPdThread
+template<typename Callable>
+class OnPdThread {
+public:
+    using Result = std::invoke_result_t<Callable&>;
+
+    OnPdThread(Instance& inst, Callable fn)
+        : instance(inst)
+        , function(std::move(fn))
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        // Resuming from the message loop, even when pd calls this straight away, keeps the coroutine on the message thread
+        JUCE_ASSERT_MESSAGE_THREAD
+
+        instance.enqueueFunction([this, handle]() {
+            if constexpr (std::is_void_v<Result>) {
+                function();
+                result.emplace();
+            } else {
+                result.emplace(function());
+            }
+
+            MessageManager::callAsync([handle]() { handle.resume(); });
+        });
+    }
+
+    Result await_resume()
+    {
+        if constexpr (!std::is_void_v<Result>)
+            return std::move(*result);
+    }
+
+private:
+    struct Nothing { };
+
+    Instance& instance;
+    Callable function;
+    std::optional<std::conditional_t<std::is_void_v<Result>, Nothing, Result>> result;
+};
+
+template<typename Callable>
+auto Instance::onPdThread(Callable&& fn)
+{
+    return OnPdThread<std::decay_t<Callable>>(*this, std::forward<Callable>(fn));
+}
+
+}
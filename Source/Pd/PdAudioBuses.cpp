@@ -0,0 +1,160 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "PdAudioBuses.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+
+extern "C" {
+#include "x_libpd_bus.h"
+}
+
+namespace pd {
+
+JUCE_IMPLEMENT_SINGLETON(AudioBuses)
+
+namespace {
+
+// Enough for a few blocks of the largest buffer size hosts use
+constexpr uint64 busCapacity = 1 << 14;
+
+// A receiver further behind than this skips ahead, so the sender never writes where it reads
+constexpr uint64 maxLag = busCapacity / 2;
+
+}
+
+struct AudioBuses::Bus {
+    String name;
+    bool hasSender = false;
+    int numEndpoints = 0;
+
+    // Samples the sender has written so far, the ring holds the newest of them
+    std::atomic<uint64> written = 0;
+    std::array<t_sample, busCapacity> samples {};
+};
+
+struct AudioBuses::Endpoint {
+    Bus* bus;
+    bool isSender;
+    uint64 position; // Receivers only, the next sample to read
+};
+
+AudioBuses::AudioBuses()
+{
+    static t_libpd_bus_registry const registry = {
+        [](char const* name, int isSender) { return acquire(name, isSender); },
+        [](void* endpoint) { release(endpoint); },
+        [](void* endpoint, t_sample const* in, int n) { write(endpoint, in, n); },
+        [](void* endpoint, t_sample* out, int n) { read(endpoint, out, n); },
+    };
+
+    libpd_bus_set_registry(&registry);
+}
+
+AudioBuses::~AudioBuses()
+{
+    libpd_bus_set_registry(nullptr);
+    clearSingletonInstance();
+}
+
+void* AudioBuses::acquire(char const* name, int isSender)
+{
+    auto* buses = getInstanceWithoutCreating();
+    if (!buses)
+        return nullptr;
+
+    auto const busName = String::fromUTF8(name);
+
+    ScopedLock const scopedLock(buses->lock);
+
+    Bus* bus = nullptr;
+    for (auto& existing : buses->buses) {
+        if (existing->name == busName) {
+            bus = existing.get();
+            break;
+        }
+    }
+
+    if (!bus) {
+        bus = buses->buses.emplace_back(std::make_unique<Bus>()).get();
+        bus->name = busName;
+    }
+
+    if (isSender) {
+        if (bus->hasSender)
+            return nullptr;
+        bus->hasSender = true;
+    }
+
+    bus->numEndpoints++;
+
+    // Receivers start at the newest sample, so they don't play back what was sent before they existed
+    return new Endpoint { bus, isSender != 0, bus->written.load(std::memory_order_acquire) };
+}
+
+void AudioBuses::release(void* endpoint)
+{
+    std::unique_ptr<Endpoint> e(static_cast<Endpoint*>(endpoint));
+
+    auto* buses = getInstanceWithoutCreating();
+    if (!buses)
+        return;
+
+    ScopedLock const scopedLock(buses->lock);
+
+    if (e->isSender)
+        e->bus->hasSender = false;
+
+    if (--e->bus->numEndpoints == 0) {
+        auto& list = buses->buses;
+        list.erase(std::remove_if(list.begin(), list.end(), [bus = e->bus](auto const& b) { return b.get() == bus; }), list.end());
+    }
+}
+
+void AudioBuses::write(void* endpoint, void const* in, int n)
+{
+    auto* bus = static_cast<Endpoint*>(endpoint)->bus;
+    auto const* source = static_cast<t_sample const*>(in);
+
+    auto const written = bus->written.load(std::memory_order_relaxed);
+    auto const start = static_cast<size_t>(written % busCapacity);
+    auto const first = std::min<size_t>(static_cast<size_t>(n), busCapacity - start);
+
+    std::copy(source, source + first, bus->samples.begin() + start);
+    std::copy(source + first, source + n, bus->samples.begin());
+
+    bus->written.store(written + static_cast<uint64>(n), std::memory_order_release);
+}
+
+void AudioBuses::read(void* endpoint, void* out, int n)
+{
+    auto* e = static_cast<Endpoint*>(endpoint);
+    auto* destination = static_cast<t_sample*>(out);
+    auto const size = static_cast<uint64>(n);
+
+    auto const written = e->bus->written.load(std::memory_order_acquire);
+
+    if (written - e->position > maxLag)
+        e->position = written - size;
+
+    // The sender hasn't run this block yet, or there is none
+    if (written - e->position < size) {
+        std::fill(destination, destination + n, t_sample(0));
+        return;
+    }
+
+    auto const start = static_cast<size_t>(e->position % busCapacity);
+    auto const first = std::min<size_t>(static_cast<size_t>(n), busCapacity - start);
+
+    std::copy(e->bus->samples.begin() + start, e->bus->samples.begin() + start + first, destination);
+    std::copy(e->bus->samples.begin(), e->bus->samples.begin() + (n - first), destination + first);
+
+    e->position += size;
+}
+
+} // namespace pd
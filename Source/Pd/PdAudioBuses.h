@@ -0,0 +1,44 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <memory>
+#include <vector>
+
+namespace pd {
+
+// The audio buses of [sendbus~] and [receivebus~], shared by every instance in the process
+//! @details Each bus is a ring of samples with a count of what its sender has written so far, which the sender
+//! bumps after every block. Every receiver keeps its own position, so it reads each block once and any number of
+//! receivers can follow a bus without knowing about each other. Nothing on the audio threads locks or allocates:
+//! buses are only created and removed when an endpoint is acquired or released, from the pd thread of an instance.
+//! A receiver that runs before its sender in a block gets that block in the next one, a receiver that falls
+//! too far behind skips ahead to the newest block.
+class AudioBuses : public DeletedAtShutdown {
+public:
+    AudioBuses();
+    ~AudioBuses() override;
+
+    JUCE_DECLARE_SINGLETON(AudioBuses, false)
+
+private:
+    struct Bus;
+    struct Endpoint;
+
+    // Called by pd, see x_libpd_bus.h
+    static void* acquire(char const* name, int isSender);
+    static void release(void* endpoint);
+    static void write(void* endpoint, void const* in, int n);
+    static void read(void* endpoint, void* out, int n);
+
+    CriticalSection lock;
+    std::vector<std::unique_ptr<Bus>> buses;
+};
+
+} // namespace pd
@@ -0,0 +1,316 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+extern "C" {
+#include <m_pd.h>
+}
+
+#include <cmath>
+
+namespace pd {
+
+// Histogram of the block load, the time a block took divided by the time it had
+//! @details Buckets are spaced logarithmically like in an HDR histogram: every octave is split
+//! into the same number of sub-buckets, so the relative error is the same anywhere in the range.
+//! Only one thread may add values, any thread can read them.
+class LoadHistogram {
+public:
+    static constexpr int subBuckets = 8;
+    static constexpr int minExponent = -10; // 0.1% of the budget
+    static constexpr int maxExponent = 4;   // 16 times the budget
+    static constexpr int numBuckets = (maxExponent - minExponent) * subBuckets;
+
+    LoadHistogram()
+    {
+        clear();
+    }
+
+    void add(float load)
+    {
+        buckets[bucketFor(load)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void clear()
+    {
+        for (auto& bucket : buckets)
+            bucket.store(0, std::memory_order_relaxed);
+    }
+
+    uint64 getCount() const
+    {
+        uint64 count = 0;
+        for (auto const& bucket : buckets)
+            count += bucket.load(std::memory_order_relaxed);
+
+        return count;
+    }
+
+    // Load below which the given fraction of the blocks stayed
+    float getPercentile(float fraction) const
+    {
+        auto const count = getCount();
+        if (count == 0)
+            return 0.0f;
+
+        auto const target = static_cast<uint64>(std::ceil(fraction * static_cast<float>(count)));
+        uint64 seen = 0;
+        for (int i = 0; i < numBuckets; i++) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen >= jmax<uint64>(target, 1))
+                return valueOf(i);
+        }
+
+        return valueOf(numBuckets - 1);
+    }
+
+private:
+    static int bucketFor(float load)
+    {
+        if (!(load > 0.0f))
+            return 0;
+
+        int exponent;
+        auto const mantissa = std::frexp(load, &exponent); // in [0.5, 1)
+        auto const octave = exponent - 1 - minExponent;
+        auto const sub = static_cast<int>((mantissa * 2.0f - 1.0f) * subBuckets);
+
+        return jlimit(0, numBuckets - 1, octave * subBuckets + sub);
+    }
+
+    // The middle of the bucket
+    static float valueOf(int bucket)
+    {
+        auto const octave = bucket / subBuckets + minExponent;
+        auto const sub = static_cast<float>(bucket % subBuckets);
+        return std::ldexp(1.0f + (sub + 0.5f) / subBuckets, octave);
+    }
+
+    std::atomic<uint32> buckets[numBuckets];
+};
+
+// Timing of the audio callback and of everything that can hold it up
+//! @details record() is called by the audio thread after every block, the lock and queue
+//! times come from whichever thread held the lock or dequeued. Values are kept since the
+//! last reset, except for the load shown in the statusbar, which is the average of the
+//! last interval. publish() sends everything to [r audiostats] from pd's thread.
+class AudioStats {
+public:
+    // Blocks that took more than this part of their budget count as near misses
+    static constexpr float nearMissLoad = 0.8f;
+
+    // Seconds of audio between two updates of the recent load and the receiver
+    static constexpr double interval = 0.5;
+
+    void prepare()
+    {
+        receiver = gensym("audiostats");
+        selLoad = gensym("load");
+        selBlocks = gensym("blocks");
+        selLock = gensym("lock");
+        selQueue = gensym("queue");
+    }
+
+    // Time the block took against the time that was available for it, in seconds
+    void record(double elapsed, double budget)
+    {
+        if (budget <= 0.0)
+            return;
+
+        if (resetPending.exchange(false, std::memory_order_acquire))
+            clear();
+
+        auto const load = static_cast<float>(elapsed / budget);
+        histogram.add(load);
+        blockBudget.store(static_cast<float>(budget), std::memory_order_relaxed);
+
+        numBlocks.fetch_add(1, std::memory_order_relaxed);
+        if (load > 1.0f)
+            numXruns.fetch_add(1, std::memory_order_relaxed);
+        else if (load > nearMissLoad)
+            numNearMisses.fetch_add(1, std::memory_order_relaxed);
+
+        storeMax(maxLoad, load);
+
+        intervalElapsed += elapsed;
+        intervalBudget += budget;
+        intervalPeak = jmax(intervalPeak, load);
+
+        if (intervalBudget >= interval) {
+            recentLoad.store(static_cast<float>(intervalElapsed / intervalBudget), std::memory_order_relaxed);
+            recentPeak.store(intervalPeak, std::memory_order_relaxed);
+            intervalElapsed = intervalBudget = 0.0;
+            intervalPeak = 0.0f;
+            publishPending.store(true, std::memory_order_release);
+        }
+    }
+
+    // Called by anything that held the audio callback lock
+    void recordLockHold(double seconds)
+    {
+        storeMax(maxLockHold, static_cast<float>(seconds));
+        if (seconds > blockBudget.load(std::memory_order_relaxed))
+            numLockStalls.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void recordQueueTime(double seconds)
+    {
+        storeMax(maxQueueTime, static_cast<float>(seconds));
+    }
+
+    // Starts counting again, the audio thread clears the histogram on its next block
+    void reset()
+    {
+        maxLockHold = 0.0f;
+        maxQueueTime = 0.0f;
+        numLockStalls = 0;
+        resetPending = true;
+    }
+
+    // Called for every tick, sends the stats once per interval if someone listens
+    void publish()
+    {
+        if (!receiver || !publishPending.exchange(false, std::memory_order_acquire))
+            return;
+
+        sys_lock();
+
+        if (receiver->s_thing)
+            send(selLoad, { 100.0f * getRecentLoad(), 100.0f * getPercentile(0.5f), 100.0f * getPercentile(0.99f), 100.0f * getMaxLoad() });
+        if (receiver->s_thing)
+            send(selBlocks, { static_cast<float>(getNumBlocks()), static_cast<float>(getNumNearMisses()), static_cast<float>(getNumXruns()) });
+        if (receiver->s_thing)
+            send(selLock, { 1000.0f * getMaxLockHold(), static_cast<float>(getNumLockStalls()) });
+        if (receiver->s_thing)
+            send(selQueue, { 1000.0f * getMaxQueueTime() });
+
+        sys_unlock();
+    }
+
+    float getRecentLoad() const { return recentLoad.load(std::memory_order_relaxed); }
+    float getRecentPeak() const { return recentPeak.load(std::memory_order_relaxed); }
+    float getMaxLoad() const { return maxLoad.load(std::memory_order_relaxed); }
+    float getPercentile(float fraction) const { return histogram.getPercentile(fraction); }
+
+    int64 getNumBlocks() const { return numBlocks.load(std::memory_order_relaxed); }
+    int64 getNumNearMisses() const { return numNearMisses.load(std::memory_order_relaxed); }
+    int64 getNumXruns() const { return numXruns.load(std::memory_order_relaxed); }
+
+    // In seconds
+    float getMaxLockHold() const { return maxLockHold.load(std::memory_order_relaxed); }
+    int64 getNumLockStalls() const { return numLockStalls.load(std::memory_order_relaxed); }
+    float getMaxQueueTime() const { return maxQueueTime.load(std::memory_order_relaxed); }
+
+private:
+    static void storeMax(std::atomic<float>& target, float value)
+    {
+        auto current = target.load(std::memory_order_relaxed);
+        while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) { }
+    }
+
+    void clear()
+    {
+        histogram.clear();
+        numBlocks = 0;
+        numNearMisses = 0;
+        numXruns = 0;
+        maxLoad = 0.0f;
+    }
+
+    void send(t_symbol* selector, std::initializer_list<float> values)
+    {
+        t_atom atoms[4];
+        int numValues = 0;
+        for (auto value : values)
+            SETFLOAT(atoms + numValues++, value);
+
+        pd_typedmess(receiver->s_thing, selector, numValues, atoms);
+    }
+
+    LoadHistogram histogram;
+
+    std::atomic<int64> numBlocks = 0;
+    std::atomic<int64> numNearMisses = 0;
+    std::atomic<int64> numXruns = 0;
+    std::atomic<float> maxLoad = 0.0f;
+    std::atomic<float> blockBudget = 0.0f;
+
+    std::atomic<float> recentLoad = 0.0f;
+    std::atomic<float> recentPeak = 0.0f;
+
+    std::atomic<float> maxLockHold = 0.0f;
+    std::atomic<int64> numLockStalls = 0;
+    std::atomic<float> maxQueueTime = 0.0f;
+
+    std::atomic<bool> resetPending = false;
+    std::atomic<bool> publishPending = false;
+
+    // Only touched by the audio thread
+    double intervalElapsed = 0.0;
+    double intervalBudget = 0.0;
+    float intervalPeak = 0.0f;
+
+    t_symbol* receiver = nullptr;
+    t_symbol* selLoad = nullptr;
+    t_symbol* selBlocks = nullptr;
+    t_symbol* selLock = nullptr;
+    t_symbol* selQueue = nullptr;
+};
+
+// The lock the host holds while calling the audio callback, timing how long others hold it
+//! @details Works like a CriticalSection, only the outermost enter and exit are timed. The
+//! timestamps are only touched while the lock is held, so they don't need to be atomic.
+class CallbackLock {
+public:
+    using ScopedLockType = GenericScopedLock<CallbackLock>;
+
+    void setLock(CriticalSection const* newLock, AudioStats* newStats)
+    {
+        lock = newLock;
+        stats = newStats;
+    }
+
+    void enter() const
+    {
+        lock->enter();
+        entered();
+    }
+
+    bool tryEnter() const
+    {
+        if (!lock->tryEnter())
+            return false;
+
+        entered();
+        return true;
+    }
+
+    void exit() const
+    {
+        if (--depth == 0 && stats)
+            stats->recordLockHold(Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - enteredAt));
+
+        lock->exit();
+    }
+
+private:
+    void entered() const
+    {
+        if (depth++ == 0)
+            enteredAt = Time::getHighResolutionTicks();
+    }
+
+    CriticalSection const* lock = nullptr;
+    AudioStats* stats = nullptr;
+
+    mutable int depth = 0;
+    mutable int64 enteredAt = 0;
+};
+
+} // namespace pd
@@ -0,0 +1,49 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <vector>
+
+namespace pd {
+
+// What was last copied in this process
+//! @details A copy is put on the system clipboard as pd's text, for other apps and processes. It's also kept
+//! here in pd's binary form (see libpd_copy_binary), which any instance can paste no matter which one copied
+//! it, so pasting within the process doesn't parse text. It's used as long as the system clipboard still has
+//! the text of this copy. The editor info of the copied connections goes with it, pd's copy doesn't have that.
+//! Only used from the message thread.
+struct Clipboard {
+    // Editor info of a copied connection, by the position of its objects among the copied objects
+    struct ConnectionInfo {
+        int inObject = 0;
+        int outObject = 0;
+        int inlet = 0;
+        int outlet = 0;
+        String path;
+        String segmented;
+    };
+
+    String text;
+    MemoryBlock binary;
+    std::vector<ConnectionInfo> connections;
+
+    // Whether the system clipboard still has what was copied here
+    bool isCurrent() const
+    {
+        return text.isNotEmpty() && SystemClipboard::getTextFromClipboard() == text;
+    }
+
+    static Clipboard& get()
+    {
+        static Clipboard clipboard;
+        return clipboard;
+    }
+};
+
+} // namespace pd
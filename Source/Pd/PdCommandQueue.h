@@ -0,0 +1,501 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+extern "C" {
+#include <m_pd.h>
+}
+
+namespace pd {
+
+// Preallocated ring of typed commands for passing messages between pd and the GUI
+//! @details Commands are stored back-to-back in a fixed ring of memory, so neither
+//! enqueueing nor dequeueing touches the heap. Producers are serialised by WriteLock,
+//! the consumer never locks. List atoms are stored inline after the command header.
+//! Symbols can be passed as t_symbol pointers, or as names that the consumer interns with
+//! resolveNames, so a producer that doesn't own the pd instance never calls gensym.
+//! Anything that is not a plain message can be passed as a callable, which is stored inline.
+//! The consumer only calls it, whatever it captured is destroyed by releaseFinished, so
+//! the audio thread never frees memory. Until then its space isn't handed back to the producers.
+template<typename WriteLock>
+class CommandRing {
+public:
+    enum Type : uint32 {
+        Wrap,
+        Bang,
+        Float,
+        Symbol,
+        List,
+        Message,
+        Function,
+        NumTypes
+    };
+
+    // Counters for finding out what floods the queue, the producers and the consumer update them as they go
+    //! @details A drain is one call of dequeueAll that found something to do. Everything is counted
+    //! since the last reset, which only the consumer may do while it isn't dequeueing.
+    struct Statistics {
+        // Commands that took longer than this to run are counted as slow
+        static constexpr double slowCommandSeconds = 100e-6;
+
+        std::atomic<uint64> numEnqueued[NumTypes] = {};
+        std::atomic<uint64> numDequeued = 0;
+        std::atomic<uint64> numDrains = 0;
+        std::atomic<uint32> lastDrained = 0;
+        std::atomic<uint32> maxDrained = 0;
+        std::atomic<uint64> maxPendingCommands = 0;
+        std::atomic<size_t> maxPendingBytes = 0;
+        std::atomic<float> maxDrainTime = 0.0f;
+
+        std::atomic<uint64> numSlowCommands = 0;
+        std::atomic<float> slowestCommandTime = 0.0f;
+        std::atomic<uint32> slowestCommandType = Wrap;
+
+        // Selector of the slowest message, or the symbol it carried, or its receiver
+        std::atomic<t_symbol*> slowestCommandSymbol = nullptr;
+
+        uint64 getNumEnqueued() const
+        {
+            uint64 total = 0;
+            for (auto const& count : numEnqueued)
+                total += count.load(std::memory_order_relaxed);
+
+            return total;
+        }
+
+        void reset()
+        {
+            for (auto& count : numEnqueued)
+                count = 0;
+
+            numDequeued = 0;
+            numDrains = 0;
+            lastDrained = 0;
+            maxDrained = 0;
+            maxPendingCommands = 0;
+            maxPendingBytes = 0;
+            maxDrainTime = 0.0f;
+            numSlowCommands = 0;
+            slowestCommandTime = 0.0f;
+            slowestCommandType = Wrap;
+            slowestCommandSymbol = nullptr;
+        }
+    };
+
+    static char const* getTypeName(uint32 type)
+    {
+        static char const* const names[] = { "wrap", "bang", "float", "symbol", "list", "message", "function" };
+        return type < NumTypes ? names[type] : "";
+    }
+
+    // Which symbols of a command were passed by name, they're stored in this order after the atoms
+    enum NamedField : uint32 {
+        NamedDestination = 1,
+        NamedSelector = 2,
+        NamedSymbol = 4,
+        NamedAtoms = 8
+    };
+
+    struct Command {
+        Type type;
+        uint32 size;
+
+        // Target object, or nullptr to send to the destination receiver
+        void* object;
+        t_symbol* destination;
+        t_symbol* selector;
+        t_symbol* symbol;
+        t_float value;
+        int numAtoms;
+
+        // Calls the callable of a function command, and destroys it once it's released
+        void (*invoke)(void*);
+        void (*destroy)(void*);
+
+        uint32 namedFields;
+
+        t_atom* getAtoms() const
+        {
+            return reinterpret_cast<t_atom*>(const_cast<char*>(reinterpret_cast<char const*>(this)) + headerSize);
+        }
+
+        void* getStorage() const
+        {
+            return const_cast<char*>(reinterpret_cast<char const*>(this)) + headerSize;
+        }
+
+        // Interns the names the producer passed, call it with the instance set and locked before
+        // using the symbols. Only the consumer may do this, it happens once for each command
+        void resolveNames() const
+        {
+            if (!namedFields)
+                return;
+
+            auto* self = const_cast<Command*>(this);
+            auto const* name = static_cast<char const*>(getStorage()) + numAtoms * sizeof(t_atom);
+            auto next = [&name]() {
+                auto* symbol = gensym(name);
+                name += std::strlen(name) + 1;
+                return symbol;
+            };
+
+            if (namedFields & NamedDestination)
+                self->destination = next();
+            if (namedFields & NamedSelector)
+                self->selector = next();
+            if (namedFields & NamedSymbol)
+                self->symbol = next();
+            if (namedFields & NamedAtoms) {
+                auto* atoms = getAtoms();
+                for (int i = 0; i < numAtoms; i++) {
+                    if (atoms[i].a_type == A_SYMBOL)
+                        atoms[i].a_w.w_symbol = next();
+                }
+            }
+
+            self->namedFields = 0;
+        }
+    };
+
+    explicit CommandRing(size_t capacityInBytes = 1 << 20)
+        : capacity(nextPowerOfTwo(static_cast<int>(capacityInBytes)))
+    {
+        buffer.allocate(capacity, true);
+    }
+
+    ~CommandRing()
+    {
+        // Functions that never got called are destroyed too
+        releaseUpTo(writePosition.load(std::memory_order_acquire));
+    }
+
+    bool enqueueBang(void* object, t_symbol* destination)
+    {
+        return write(Bang, object, destination, 0, [](Command&) {});
+    }
+
+    bool enqueueFloat(void* object, t_symbol* destination, t_float value)
+    {
+        return write(Float, object, destination, 0, [value](Command& command) { command.value = value; });
+    }
+
+    bool enqueueSymbol(void* object, t_symbol* destination, t_symbol* symbol)
+    {
+        return write(Symbol, object, destination, 0, [symbol](Command& command) { command.symbol = symbol; });
+    }
+
+    // The symbol is interned by the consumer
+    bool enqueueSymbol(void* object, t_symbol* destination, String const& symbol)
+    {
+        auto const numBytes = symbol.getNumBytesAsUTF8() + 1;
+        return write(Symbol, object, destination, numBytes, [&symbol, numBytes](Command& command) {
+            command.namedFields = NamedSymbol;
+            std::memcpy(command.getStorage(), symbol.toRawUTF8(), numBytes);
+        });
+    }
+
+    // AtomList can be any container of pd::Atom, its symbols are interned by the consumer
+    template<typename AtomList>
+    bool enqueueList(void* object, t_symbol* destination, AtomList const& list)
+    {
+        return writeNamed(List, object, destination, nullptr, nullptr, list);
+    }
+
+    // The receiver, selector and symbols are all interned by the consumer
+    template<typename AtomList>
+    bool enqueueMessage(void* object, String const& destination, String const& selector, AtomList const& list)
+    {
+        return writeNamed(Message, object, nullptr, &destination, &selector, list);
+    }
+
+    // Copies atoms straight from pd, only valid if the symbols belong to this pd instance
+    bool enqueueAtoms(void* object, t_symbol* destination, t_symbol* selector, int argc, t_atom const* argv)
+    {
+        return write(selector ? Message : List, object, destination, argc * sizeof(t_atom), [selector, argc, argv](Command& command) {
+            command.selector = selector;
+            command.numAtoms = argc;
+            std::copy(argv, argv + argc, command.getAtoms());
+        });
+    }
+
+    template<typename Callable>
+    bool enqueueFunction(Callable&& fn)
+    {
+        using FunctionType = std::decay_t<Callable>;
+        static_assert(alignof(FunctionType) <= granularity, "Callable is over-aligned for the command queue");
+
+        return write(Function, nullptr, nullptr, sizeof(FunctionType), [&fn](Command& command) {
+            new (command.getStorage()) FunctionType(std::forward<Callable>(fn));
+            command.invoke = [](void* storage) {
+                (*static_cast<FunctionType*>(storage))();
+            };
+            command.destroy = [](void* storage) {
+                static_cast<FunctionType*>(storage)->~FunctionType();
+            };
+        });
+    }
+
+    // Calls callback for every pending message, and invokes the pending functions itself
+    //! @details Can be called recursively from within a command, for example to wait for a state update.
+    //! Only the outermost call releases memory back to the producers.
+    //! If another thread is already dequeueing, this returns immediately.
+    template<typename Callback>
+    void dequeueAll(Callback&& callback)
+    {
+        auto const thisThread = Thread::getCurrentThreadId();
+        bool const isNested = consumerThread.load() == thisThread;
+
+        Thread::ThreadID noThread = nullptr;
+        if (!isNested && !consumerThread.compare_exchange_strong(noThread, thisThread))
+            return;
+
+        auto const drainStart = Time::getHighResolutionTicks();
+        uint32 numDrained = 0;
+
+        while (consumePosition != writePosition.load(std::memory_order_acquire)) {
+            auto* command = reinterpret_cast<Command*>(buffer.get() + (consumePosition & (capacity - 1)));
+            consumePosition += command->size;
+
+            auto const type = command->type;
+            if (type != Wrap) {
+                auto const start = Time::getHighResolutionTicks();
+
+                // The command is gone after invoking a function, the others only have their names resolved by the callback
+                if (type == Function)
+                    command->invoke(command->getStorage());
+                else
+                    callback(static_cast<Command const&>(*command));
+
+                auto* const symbol = type == Function ? nullptr : command->selector ? command->selector : command->symbol ? command->symbol : command->destination;
+                recordCommand(type, symbol, Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start));
+                numDrained++;
+            }
+
+            if (!isNested)
+                readPosition.store(consumePosition, std::memory_order_release);
+        }
+
+        if (!isNested) {
+            if (numDrained) {
+                statistics.numDrains.fetch_add(1, std::memory_order_relaxed);
+                statistics.lastDrained.store(numDrained, std::memory_order_relaxed);
+                storeMax(statistics.maxDrained, numDrained);
+                storeMax(statistics.maxDrainTime, static_cast<float>(Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - drainStart)));
+            }
+
+            consumerThread = nullptr;
+        }
+    }
+
+    // Destroys the functions that have been called, and hands their space back to the producers
+    //! @details Call this from a thread that may free memory, never from the consumer if that is the audio thread.
+    void releaseFinished()
+    {
+        releaseUpTo(readPosition.load(std::memory_order_acquire));
+    }
+
+    Statistics const& getStatistics() const
+    {
+        return statistics;
+    }
+
+    // Safe to call from any thread, the counters are only approximate while commands are passing
+    void resetStatistics()
+    {
+        statistics.reset();
+    }
+
+    bool isEmpty() const
+    {
+        return readPosition.load(std::memory_order_acquire) == writePosition.load(std::memory_order_acquire);
+    }
+
+    size_t getNumBytesPending() const
+    {
+        return writePosition.load(std::memory_order_acquire) - readPosition.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr size_t granularity = 16;
+
+    static constexpr size_t roundUp(size_t size)
+    {
+        return (size + granularity - 1) & ~(granularity - 1);
+    }
+
+    static constexpr size_t headerSize = (sizeof(Command) + granularity - 1) & ~(granularity - 1);
+
+    template<typename Value>
+    static void storeMax(std::atomic<Value>& target, Value value)
+    {
+        auto current = target.load(std::memory_order_relaxed);
+        while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) { }
+    }
+
+    void recordCommand(Type type, t_symbol* symbol, double seconds)
+    {
+        statistics.numDequeued.fetch_add(1, std::memory_order_relaxed);
+
+        if (seconds <= Statistics::slowCommandSeconds)
+            return;
+
+        statistics.numSlowCommands.fetch_add(1, std::memory_order_relaxed);
+        if (seconds > statistics.slowestCommandTime.load(std::memory_order_relaxed)) {
+            statistics.slowestCommandTime = static_cast<float>(seconds);
+            statistics.slowestCommandType = type;
+            statistics.slowestCommandSymbol = symbol;
+        }
+    }
+
+    void releaseUpTo(size_t end)
+    {
+        ScopedLock lock(releaseLock);
+
+        auto position = releasePosition.load(std::memory_order_relaxed);
+        while (position != end) {
+            auto* command = reinterpret_cast<Command*>(buffer.get() + (position & (capacity - 1)));
+            if (command->type == Function)
+                command->destroy(command->getStorage());
+
+            position += command->size;
+        }
+
+        releasePosition.store(position, std::memory_order_release);
+    }
+
+    static void appendName(char*& names, String const& name)
+    {
+        auto const numBytes = name.getNumBytesAsUTF8() + 1;
+        std::memcpy(names, name.toRawUTF8(), numBytes);
+        names += numBytes;
+    }
+
+    // Stores the atoms, with the names of the destination, selector and symbols after them
+    template<typename AtomList>
+    bool writeNamed(Type type, void* object, t_symbol* destination, String const* destinationName, String const* selectorName, AtomList const& list)
+    {
+        auto const numAtoms = static_cast<int>(list.size());
+
+        size_t numNameBytes = 0;
+        uint32 namedFields = 0;
+        if (destinationName) {
+            numNameBytes += destinationName->getNumBytesAsUTF8() + 1;
+            namedFields |= NamedDestination;
+        }
+        if (selectorName) {
+            numNameBytes += selectorName->getNumBytesAsUTF8() + 1;
+            namedFields |= NamedSelector;
+        }
+        for (int i = 0; i < numAtoms; i++) {
+            if (!list[i].isFloat()) {
+                numNameBytes += list[i].getSymbol().getNumBytesAsUTF8() + 1;
+                namedFields |= NamedAtoms;
+            }
+        }
+
+        return write(type, object, destination, numAtoms * sizeof(t_atom) + numNameBytes, [&list, numAtoms, namedFields, destinationName, selectorName](Command& command) {
+            command.numAtoms = numAtoms;
+            command.namedFields = namedFields;
+
+            auto* atoms = command.getAtoms();
+            auto* names = static_cast<char*>(command.getStorage()) + numAtoms * sizeof(t_atom);
+            if (destinationName)
+                appendName(names, *destinationName);
+            if (selectorName)
+                appendName(names, *selectorName);
+
+            for (int i = 0; i < numAtoms; i++) {
+                if (list[i].isFloat()) {
+                    SETFLOAT(atoms + i, list[i].getFloat());
+                } else {
+                    SETSYMBOL(atoms + i, nullptr);
+                    appendName(names, list[i].getSymbol());
+                }
+            }
+        });
+    }
+
+    template<typename Initialiser>
+    bool write(Type type, void* object, t_symbol* destination, size_t payloadSize, Initialiser&& initialise)
+    {
+        auto const size = roundUp(headerSize + payloadSize);
+
+        // Commands have to be stored contiguously, so anything larger than half the ring might never fit
+        if (size > capacity / 2)
+            return false;
+
+        typename WriteLock::ScopedLockType lock(writeLock);
+
+        auto const write = writePosition.load(std::memory_order_relaxed);
+        auto const read = releasePosition.load(std::memory_order_acquire);
+
+        auto offset = write & (capacity - 1);
+
+        // Reserve the rest of the ring as padding if the command doesn't fit before the end
+        auto const padding = offset + size > capacity ? capacity - offset : 0;
+
+        if (capacity - (write - read) < padding + size)
+            return false;
+
+        if (padding) {
+            auto* wrap = reinterpret_cast<Command*>(buffer.get() + offset);
+            wrap->type = Wrap;
+            wrap->size = static_cast<uint32>(padding);
+            offset = 0;
+        }
+
+        auto* command = new (buffer.get() + offset) Command { type, static_cast<uint32>(size), object, destination, nullptr, nullptr, 0.0f, 0, nullptr, nullptr, 0 };
+        initialise(*command);
+
+        writePosition.store(write + padding + size, std::memory_order_release);
+
+        statistics.numEnqueued[type].fetch_add(1, std::memory_order_relaxed);
+
+        auto const numEnqueued = statistics.getNumEnqueued();
+        auto const numDequeued = statistics.numDequeued.load(std::memory_order_relaxed);
+        if (numEnqueued > numDequeued)
+            storeMax(statistics.maxPendingCommands, numEnqueued - numDequeued);
+
+        storeMax(statistics.maxPendingBytes, static_cast<size_t>(write + padding + size - read));
+        return true;
+    }
+
+    size_t const capacity;
+    HeapBlock<char> buffer;
+
+    std::atomic<size_t> writePosition = 0;
+    std::atomic<size_t> readPosition = 0;
+
+    // Everything before this is free for the producers again
+    std::atomic<size_t> releasePosition = 0;
+    CriticalSection releaseLock;
+
+    // Only touched by the thread that is dequeueing
+    size_t consumePosition = 0;
+    std::atomic<Thread::ThreadID> consumerThread = nullptr;
+
+    WriteLock writeLock;
+
+    Statistics statistics;
+
+    JUCE_DECLARE_NON_COPYABLE(CommandRing)
+};
+
+// Multiple producers, for sending commands from the GUI to pd
+using CommandQueue = CommandRing<SpinLock>;
+
+// Single producer, for sending messages from pd's thread to the GUI
+using MessageQueue = CommandRing<DummyCriticalSection>;
+
+} // namespace pd
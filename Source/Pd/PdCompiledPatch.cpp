@@ -0,0 +1,583 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "PdCompiledPatch.h"
+
+#include "PdInstance.h"
+#include "PdPatch.h"
+#include "PdStorage.h"
+#include "../Utility/TaskPool.h"
+
+#include <map>
+#include <tuple>
+
+extern "C" {
+#include <m_pd.h>
+#include <g_canvas.h>
+#include <m_imp.h>
+}
+
+namespace pd {
+
+namespace {
+
+enum class Kind {
+    Input,
+    Output,
+    Constant,
+    Plus,
+    Minus,
+    Times,
+    Over,
+    Clip,
+    Oscillator,
+    Phasor
+};
+
+struct Node {
+    Kind kind = Kind::Constant;
+    String text;
+    std::vector<float> args;
+    std::vector<int> channels; // of [adc~] and [dac~], from 0, -1 for none
+    bool hasScalar = false;    // arithmetic with an argument, which has no signal in its right inlet
+    int numOutlets = 0;
+
+    // The node and outlet of every connection to each signal inlet
+    std::vector<std::vector<std::pair<int, int>>> inputs;
+
+    float getArg(size_t index, float fallback) const
+    {
+        return index < args.size() ? args[index] : fallback;
+    }
+};
+
+bool makeNode(String const& name, std::vector<float> const& args, Node& node)
+{
+    int numSignalInlets = 1;
+    node.numOutlets = 1;
+    node.args = args;
+
+    if (name == "adc~" || name == "dac~") {
+        node.kind = name == "adc~" ? Kind::Input : Kind::Output;
+        if (args.empty())
+            node.channels = { 0, 1 };
+        for (auto const arg : args)
+            node.channels.push_back(std::max(-1, static_cast<int>(arg) - 1));
+
+        bool const isInput = node.kind == Kind::Input;
+        numSignalInlets = isInput ? 0 : static_cast<int>(node.channels.size());
+        node.numOutlets = isInput ? static_cast<int>(node.channels.size()) : 0;
+    } else if (name == "sig~") {
+        node.kind = Kind::Constant;
+        numSignalInlets = 0;
+    } else if (name == "+~" || name == "-~" || name == "*~" || name == "/~") {
+        static std::map<String, Kind> const kinds = { { "+~", Kind::Plus }, { "-~", Kind::Minus }, { "*~", Kind::Times }, { "/~", Kind::Over } };
+        node.kind = kinds.at(name);
+        node.hasScalar = !args.empty();
+        numSignalInlets = node.hasScalar ? 1 : 2;
+    } else if (name == "clip~") {
+        node.kind = Kind::Clip;
+    } else if (name == "osc~" || name == "phasor~") {
+        node.kind = name == "osc~" ? Kind::Oscillator : Kind::Phasor;
+    } else {
+        return false;
+    }
+
+    node.inputs.resize(static_cast<size_t>(numSignalInlets));
+    return true;
+}
+
+// A float as a C++ literal that reads back as the same float
+String literal(float value)
+{
+    auto text = String::formatted("%.9g", static_cast<double>(value));
+    if (!text.containsAnyOf(".e"))
+        text << ".0";
+    return text + "f";
+}
+
+// Reads the objects and connections of patch, fails with the objects that can't be compiled
+Result readGraph(Instance* instance, Patch& patch, std::vector<Node>& nodes)
+{
+    auto* cnv = patch.getPointer();
+    if (!cnv)
+        return Result::fail("The patch isn't open");
+
+    StringArray unsupported;
+    std::map<t_object*, int> indices;
+    std::vector<std::tuple<t_object*, int, t_object*, int>> connections;
+
+    instance->getCallbackLock()->enter();
+
+    for (t_gobj* y = cnv->gl_list; y; y = y->g_next) {
+        auto* ob = pd_checkobject(&y->g_pd);
+        if (!ob || ob->te_type == T_TEXT || Storage::isInfoParent(y))
+            continue;
+
+        char* buf;
+        int bufsize;
+        binbuf_gettext(ob->te_binbuf, &buf, &bufsize);
+        auto const text = String::fromUTF8(buf, bufsize);
+        freebytes(buf, static_cast<size_t>(bufsize));
+
+        // Dollar arguments and symbols would have to be resolved by pd
+        auto const argc = binbuf_getnatom(ob->te_binbuf);
+        auto const* argv = binbuf_getvec(ob->te_binbuf);
+        bool onlyFloats = true;
+        std::vector<float> args;
+        for (int i = 1; i < argc; i++) {
+            onlyFloats = onlyFloats && argv[i].a_type == A_FLOAT;
+            args.push_back(atom_getfloat(argv + i));
+        }
+
+        Node node;
+        if (ob->te_type != T_OBJECT || !onlyFloats || !makeNode(String::fromUTF8(class_getname(pd_class(&y->g_pd))), args, node)) {
+            unsupported.addIfNotAlreadyThere("[" + text + "]");
+            continue;
+        }
+
+        node.text = text;
+        indices[ob] = static_cast<int>(nodes.size());
+        nodes.push_back(std::move(node));
+    }
+
+    t_linetraverser t;
+    linetraverser_start(&t, cnv);
+    while (linetraverser_next(&t))
+        connections.emplace_back(t.tr_ob, t.tr_outno, t.tr_ob2, t.tr_inno);
+
+    instance->getCallbackLock()->exit();
+
+    for (auto const& [source, outlet, sink, inlet] : connections) {
+        auto sourceIndex = indices.find(source);
+        auto sinkIndex = indices.find(sink);
+
+        // The object that can't be compiled is reported already
+        if (sourceIndex == indices.end() || sinkIndex == indices.end())
+            continue;
+
+        auto& node = nodes[static_cast<size_t>(sinkIndex->second)];
+        if (inlet >= static_cast<int>(node.inputs.size())) {
+            unsupported.addIfNotAlreadyThere("the connection to the control inlet of [" + node.text + "]");
+            continue;
+        }
+
+        node.inputs[static_cast<size_t>(inlet)].emplace_back(sourceIndex->second, outlet);
+    }
+
+    if (!unsupported.isEmpty())
+        return Result::fail("Can't compile " + unsupported.joinIntoString(", "));
+
+    return Result::ok();
+}
+
+// The nodes in an order where every node comes after the nodes it gets signals from, like pd sorts its chain
+Result sortGraph(std::vector<Node> const& nodes, std::vector<int>& order)
+{
+    std::vector<int> numWaiting(nodes.size(), 0);
+    std::vector<std::vector<int>> sinks(nodes.size());
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+        for (auto const& sources : nodes[i].inputs) {
+            for (auto const& source : sources) {
+                sinks[static_cast<size_t>(source.first)].push_back(static_cast<int>(i));
+                numWaiting[i]++;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (!numWaiting[i])
+            order.push_back(static_cast<int>(i));
+    }
+
+    for (size_t i = 0; i < order.size(); i++) {
+        for (auto const sink : sinks[static_cast<size_t>(order[i])]) {
+            if (!--numWaiting[static_cast<size_t>(sink)])
+                order.push_back(sink);
+        }
+    }
+
+    if (order.size() != nodes.size())
+        return Result::fail("Can't compile a patch with a signal loop");
+
+    return Result::ok();
+}
+
+// Kernels that every generated source starts with
+char const* const prologue = R"(#include <algorithm>
+#include <cmath>
+
+#if defined(_WIN32)
+#define PLUGDATA_EXPORT extern "C" __declspec(dllexport)
+#else
+#define PLUGDATA_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+namespace {
+
+constexpr int blockSize = 64;
+constexpr int cosTableSize = 512;
+
+float const zero[blockSize] = {};
+
+// Every kernel takes a signal, or a constant where an inlet has none
+inline float at(float const* signal, int i) { return signal[i]; }
+inline float at(float value, int) { return value; }
+
+template<int N, typename In>
+inline void assign(In in, float* out)
+{
+    for (int i = 0; i < N; i++)
+        out[i] = at(in, i);
+}
+
+template<int N, typename In>
+inline void accumulate(In in, float* out)
+{
+    for (int i = 0; i < N; i++)
+        out[i] += at(in, i);
+}
+
+template<int N, typename A, typename B>
+inline void plus(A a, B b, float* out)
+{
+    for (int i = 0; i < N; i++)
+        out[i] = at(a, i) + at(b, i);
+}
+
+template<int N, typename A, typename B>
+inline void minus(A a, B b, float* out)
+{
+    for (int i = 0; i < N; i++)
+        out[i] = at(a, i) - at(b, i);
+}
+
+template<int N, typename A, typename B>
+inline void times(A a, B b, float* out)
+{
+    for (int i = 0; i < N; i++)
+        out[i] = at(a, i) * at(b, i);
+}
+
+template<int N, typename A, typename B>
+inline void over(A a, B b, float* out)
+{
+    for (int i = 0; i < N; i++) {
+        float const f = at(a, i), g = at(b, i);
+        out[i] = g ? f / g : 0.0f;
+    }
+}
+
+// Like [/~] with an argument, which multiplies by the reciprocal
+template<int N, typename A>
+inline void overScalar(A a, float g, float* out)
+{
+    float const reciprocal = g ? static_cast<float>(1.0 / g) : 0.0f;
+    for (int i = 0; i < N; i++)
+        out[i] = at(a, i) * reciprocal;
+}
+
+template<int N, typename In>
+inline void clip(In in, float lo, float hi, float* out)
+{
+    for (int i = 0; i < N; i++) {
+        float f = at(in, i);
+        f = f < lo ? lo : f;
+        out[i] = f > hi ? hi : f;
+    }
+}
+
+template<int N, typename Frequency>
+inline void oscillator(double& phase, Frequency frequency, double conversion, float const* table, float* out)
+{
+    for (int i = 0; i < N; i++) {
+        phase -= std::floor(phase);
+        double const index = phase * cosTableSize;
+        int const j = static_cast<int>(index);
+        float const fraction = static_cast<float>(index - j);
+        out[i] = table[j] + fraction * (table[j + 1] - table[j]);
+        phase += at(frequency, i) * conversion;
+    }
+}
+
+template<int N, typename Frequency>
+inline void phasor(double& phase, Frequency frequency, double conversion, float* out)
+{
+    for (int i = 0; i < N; i++) {
+        phase -= std::floor(phase);
+        out[i] = static_cast<float>(phase);
+        phase += at(frequency, i) * conversion;
+    }
+}
+)";
+
+// The functions CompiledPatch looks for, see CompiledPatch::load
+char const* const epilogue = R"(
+PLUGDATA_EXPORT int plugdata_compiled_version()
+{
+    return PLUGDATA_COMPILED_VERSION;
+}
+
+PLUGDATA_EXPORT void* plugdata_compiled_create()
+{
+    return new Patch();
+}
+
+PLUGDATA_EXPORT void plugdata_compiled_free(void* state)
+{
+    delete static_cast<Patch*>(state);
+}
+
+PLUGDATA_EXPORT void plugdata_compiled_prepare(void* state, double sampleRate)
+{
+    static_cast<Patch*>(state)->prepare(sampleRate);
+}
+
+// Channels follow each other, numSamples each, numSamples is a multiple of the block size
+PLUGDATA_EXPORT void plugdata_compiled_perform(void* state, float const* const* inputs, int numInputs, float* const* outputs, int numOutputs, int numSamples)
+{
+    auto* patch = static_cast<Patch*>(state);
+    for (int offset = 0; offset + blockSize <= numSamples; offset += blockSize)
+        patch->tick(inputs, numInputs, outputs, numOutputs, offset);
+}
+)";
+
+} // namespace
+
+Result PatchCompiler::generate(Instance* instance, Patch& patch, String& source)
+{
+    std::vector<Node> nodes;
+    std::vector<int> order;
+
+    auto result = readGraph(instance, patch, nodes);
+    if (result.wasOk())
+        result = sortGraph(nodes, order);
+    if (result.failed())
+        return result;
+
+    if (std::none_of(nodes.begin(), nodes.end(), [](Node const& node) { return node.kind == Kind::Output; }))
+        return Result::fail("Nothing to compile, the patch has no [dac~]");
+
+    StringArray members;
+    StringArray resets;
+    String code;
+
+    // Constants are folded into the kernels that read them, inputs are read where they are
+    auto getSource = [&nodes](std::pair<int, int> const& source) -> String {
+        auto const& node = nodes[static_cast<size_t>(source.first)];
+        if (node.kind == Kind::Constant)
+            return literal(node.getArg(0, 0.0f));
+
+        return "b" + String(source.first) + "_" + String(source.second);
+    };
+
+    // pd adds up the signals that are connected to the same inlet
+    auto getInlet = [&](int index, int inlet, String const& unconnected) -> String {
+        auto const& sources = nodes[static_cast<size_t>(index)].inputs[static_cast<size_t>(inlet)];
+        if (sources.empty())
+            return unconnected;
+        if (sources.size() == 1)
+            return getSource(sources.front());
+
+        auto const name = "i" + String(index) + "_" + String(inlet);
+        members.add("float " + name + "[blockSize];");
+        code << "        assign<blockSize>(" << getSource(sources.front()) << ", " << name << ");\n";
+        for (size_t i = 1; i < sources.size(); i++)
+            code << "        accumulate<blockSize>(" << getSource(sources[i]) << ", " << name << ");\n";
+
+        return name;
+    };
+
+    for (auto const index : order) {
+        auto const& node = nodes[static_cast<size_t>(index)];
+        auto const out = "b" + String(index) + "_0";
+
+        code << "\n        // [" << node.text << "]\n";
+
+        switch (node.kind) {
+        case Kind::Input:
+            for (size_t i = 0; i < node.channels.size(); i++) {
+                auto const channel = String(node.channels[i]);
+                code << "        float const* b" << index << "_" << static_cast<int>(i) << " = ";
+                if (node.channels[i] >= 0)
+                    code << channel << " < numInputs ? inputs[" << channel << "] + offset : zero;\n";
+                else
+                    code << "zero;\n";
+            }
+            break;
+        case Kind::Output:
+            for (size_t i = 0; i < node.channels.size(); i++) {
+                auto const channel = String(node.channels[i]);
+                auto const in = getInlet(index, static_cast<int>(i), {});
+                if (in.isNotEmpty() && node.channels[i] >= 0)
+                    code << "        if (" << channel << " < numOutputs)\n            accumulate<blockSize>(" << in << ", outputs[" << channel << "] + offset);\n";
+            }
+            break;
+        case Kind::Constant:
+            code << "        // folded into the objects it's connected to\n";
+            break;
+        case Kind::Plus:
+        case Kind::Minus:
+        case Kind::Times:
+        case Kind::Over: {
+            static std::map<Kind, String> const kernels = { { Kind::Plus, "plus" }, { Kind::Minus, "minus" }, { Kind::Times, "times" }, { Kind::Over, "over" } };
+            auto const a = getInlet(index, 0, literal(0.0f));
+            auto const b = node.hasScalar ? literal(node.getArg(0, 0.0f)) : getInlet(index, 1, literal(0.0f));
+            auto const kernel = node.kind == Kind::Over && node.hasScalar ? String("overScalar") : kernels.at(node.kind);
+            members.add("float " + out + "[blockSize];");
+            code << "        " << kernel << "<blockSize>(" << a << ", " << b << ", " << out << ");\n";
+            break;
+        }
+        case Kind::Clip: {
+            auto const in = getInlet(index, 0, literal(0.0f));
+            members.add("float " + out + "[blockSize];");
+            code << "        clip<blockSize>(" << in << ", " << literal(node.getArg(0, 0.0f)) << ", " << literal(node.getArg(1, 0.0f)) << ", " << out << ");\n";
+            break;
+        }
+        case Kind::Oscillator:
+        case Kind::Phasor: {
+            // Without a signal, the argument is the frequency
+            auto const frequency = getInlet(index, 0, literal(node.getArg(0, 0.0f)));
+            auto const phase = "phase" + String(index);
+            members.add("float " + out + "[blockSize];");
+            members.add("double " + phase + " = 0.0;");
+            resets.add(phase + " = 0.0;");
+            if (node.kind == Kind::Oscillator)
+                code << "        oscillator<blockSize>(" << phase << ", " << frequency << ", conversion, cosTable, " << out << ");\n";
+            else
+                code << "        phasor<blockSize>(" << phase << ", " << frequency << ", conversion, " << out << ");\n";
+            break;
+        }
+        }
+    }
+
+    source.clear();
+    source << "// Generated by plugdata from " << patch.getCurrentFile().getFileName() << ", changes are lost when it's exported again\n";
+    source << "// Build it as a shared library, then load it with [; compiled load <library>(\n\n";
+    source << "#define PLUGDATA_COMPILED_VERSION " << version << "\n\n";
+    source << prologue;
+
+    source << "\nstruct Patch {\n";
+    source << "    double conversion = 0.0;\n";
+    source << "    float cosTable[cosTableSize + 1];\n";
+    for (auto const& member : members)
+        source << "    " << member << "\n";
+
+    source << "\n    Patch()\n    {\n";
+    source << "        for (int i = 0; i <= cosTableSize; i++)\n";
+    source << "            cosTable[i] = static_cast<float>(std::cos(6.283185307179586 * i / cosTableSize));\n";
+    source << "    }\n";
+
+    source << "\n    void prepare(double sampleRate)\n    {\n";
+    source << "        conversion = 1.0 / sampleRate;\n";
+    for (auto const& reset : resets)
+        source << "        " << reset << "\n";
+    source << "    }\n";
+
+    // The inputs are read where they are, so they can't be the same channels as the outputs
+    source << "\n    void tick(float const* const* inputs, int numInputs, float* const* outputs, int numOutputs, int offset)\n    {\n";
+    source << "        for (int ch = 0; ch < numOutputs; ch++)\n";
+    source << "            std::fill(outputs[ch] + offset, outputs[ch] + offset + blockSize, 0.0f);\n";
+    source << code;
+    source << "    }\n};\n\n} // namespace\n";
+    source << epilogue;
+
+    return Result::ok();
+}
+
+void PatchCompiler::build(File const& source, File const& module, TaskPool& tasks, std::function<void(Result)> onDone)
+{
+#if JUCE_WINDOWS
+    ignoreUnused(tasks);
+    onDone(Result::fail("Build " + source.getFullPathName() + " as a DLL with your compiler, then load it"));
+#else
+    tasks.add([source, module, onDone]() {
+        ChildProcess compiler;
+        StringArray command = { "c++", "-std=c++17", "-O3", "-shared", "-fPIC", "-o", module.getFullPathName(), source.getFullPathName() };
+
+        auto result = Result::ok();
+        if (!compiler.start(command))
+            result = Result::fail("Couldn't start the C++ compiler, c++ has to be on the path");
+        else {
+            auto const output = compiler.readAllProcessOutput();
+            if (compiler.getExitCode() != 0)
+                result = Result::fail("Building " + source.getFileName() + " failed:\n" + output);
+        }
+
+        MessageManager::callAsync([onDone, result]() { onDone(result); });
+    },
+        TaskPool::Low);
+#endif
+}
+
+String PatchCompiler::getModuleFileName(String const& name)
+{
+#if JUCE_WINDOWS
+    return name + ".dll";
+#elif JUCE_MAC
+    return name + ".dylib";
+#else
+    return name + ".so";
+#endif
+}
+
+CompiledPatch::~CompiledPatch()
+{
+    if (state && freeState)
+        freeState(state);
+}
+
+std::unique_ptr<CompiledPatch> CompiledPatch::load(File const& file, String& error)
+{
+    std::unique_ptr<CompiledPatch> patch(new CompiledPatch());
+    patch->file = file;
+
+    if (!file.existsAsFile() || !patch->library.open(file.getFullPathName())) {
+        error = "Couldn't load " + file.getFullPathName();
+        return nullptr;
+    }
+
+    using VersionFunction = int (*)();
+    auto* getVersion = reinterpret_cast<VersionFunction>(patch->library.getFunction("plugdata_compiled_version"));
+    auto* create = reinterpret_cast<CreateFunction>(patch->library.getFunction("plugdata_compiled_create"));
+    patch->freeState = reinterpret_cast<FreeFunction>(patch->library.getFunction("plugdata_compiled_free"));
+    patch->prepareState = reinterpret_cast<PrepareFunction>(patch->library.getFunction("plugdata_compiled_prepare"));
+    patch->performState = reinterpret_cast<PerformFunction>(patch->library.getFunction("plugdata_compiled_perform"));
+
+    if (!getVersion || !create || !patch->freeState || !patch->prepareState || !patch->performState) {
+        error = file.getFileName() + " wasn't built from an exported patch";
+        return nullptr;
+    }
+
+    if (getVersion() != PatchCompiler::version) {
+        error = file.getFileName() + " was exported by another version of plugdata, export it again";
+        return nullptr;
+    }
+
+    patch->state = create();
+    return patch;
+}
+
+void CompiledPatch::prepare(double sampleRate, int numInputs, int numOutputs)
+{
+    prepareState(state, sampleRate);
+    inputPointers.assign(static_cast<size_t>(std::max(0, numInputs)), nullptr);
+    outputPointers.assign(static_cast<size_t>(std::max(0, numOutputs)), nullptr);
+}
+
+void CompiledPatch::perform(float const* inputs, float* outputs, int numSamples)
+{
+    for (size_t ch = 0; ch < inputPointers.size(); ch++)
+        inputPointers[ch] = inputs + ch * static_cast<size_t>(numSamples);
+
+    for (size_t ch = 0; ch < outputPointers.size(); ch++)
+        outputPointers[ch] = outputs + ch * static_cast<size_t>(numSamples);
+
+    performState(state, inputPointers.data(), static_cast<int>(inputPointers.size()), outputPointers.data(), static_cast<int>(outputPointers.size()), numSamples);
+}
+
+} // namespace pd
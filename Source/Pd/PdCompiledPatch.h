@@ -0,0 +1,86 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+class TaskPool;
+
+namespace pd {
+
+class Instance;
+class Patch;
+
+// Turns the signal graph of a patch into C++ that processes it without pd
+//! @details Every object becomes a call to a kernel that is instantiated for pd's block size, and for
+//! constants where an inlet has no signal, so the compiler can fold them into the loops. Only [adc~], [dac~],
+//! [sig~], [+~], [-~], [*~], [/~], [clip~], [osc~] and [phasor~] can be compiled, with signal connections
+//! between them. Patches with anything else fail, with the objects that are in the way.
+//! The source is built into a module that CompiledPatch loads, see the functions at the end of the source.
+class PatchCompiler {
+public:
+    // Version of the functions the generated source exports, a module with another version isn't loaded
+    static constexpr int version = 1;
+
+    // Generates the source for the main canvas of patch, takes the audio lock while it reads the patch
+    static Result generate(Instance* instance, Patch& patch, String& source);
+
+    // Builds source into a module with the system's C++ compiler, on one of the workers of tasks
+    // onDone is called on the message thread, with the compiler's output when it failed
+    static void build(File const& source, File const& module, TaskPool& tasks, std::function<void(Result)> onDone);
+
+    // The name of a module on this platform, like name.so
+    static String getModuleFileName(String const& name);
+};
+
+// A module built from PatchCompiler's source, which processes audio in place of pd's DSP chain
+class CompiledPatch {
+public:
+    ~CompiledPatch();
+
+    // Loads a module, or fails with the reason in error
+    static std::unique_ptr<CompiledPatch> load(File const& file, String& error);
+
+    // Sets up the patch for another sample rate or other channels, not while audio is processed
+    void prepare(double sampleRate, int numInputs, int numOutputs);
+
+    // Processes channels that follow each other, numSamples each, like libpd_process_raw_ticks
+    // numSamples has to be a multiple of pd's block size
+    void perform(float const* inputs, float* outputs, int numSamples);
+
+    File getFile() const
+    {
+        return file;
+    }
+
+private:
+    CompiledPatch() = default;
+
+    using CreateFunction = void* (*)();
+    using FreeFunction = void (*)(void*);
+    using PrepareFunction = void (*)(void*, double);
+    using PerformFunction = void (*)(void*, float const* const*, int, float* const*, int, int);
+
+    File file;
+    DynamicLibrary library;
+
+    FreeFunction freeState = nullptr;
+    PrepareFunction prepareState = nullptr;
+    PerformFunction performState = nullptr;
+    void* state = nullptr;
+
+    std::vector<float const*> inputPointers;
+    std::vector<float*> outputPointers;
+
+    JUCE_DECLARE_NON_COPYABLE(CompiledPatch)
+};
+
+} // namespace pd
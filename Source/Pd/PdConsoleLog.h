@@ -0,0 +1,276 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace pd {
+
+// The lines of the console, with indexes to filter and search them without looking at every line
+//! @details Lines are kept in a ring of fixed size, when it's full a new line replaces the oldest one.
+//! Every line gets a number, counting up from 0, that stays the same for as long as the line is kept.
+//! For each type there's a bitmap over the slots of the ring, so lines of some types are found
+//! by going through the bitmaps. The words of each line are indexed in lower case, a search finds
+//! the lines that have a word starting with each word of the query. Only used from the message thread.
+class ConsoleLog {
+public:
+    struct Line {
+        String text;
+        int type = 0;
+        int width = 0; // in pixels, 0 until it's measured
+        int repeats = 0;
+    };
+
+    // Messages and errors
+    static constexpr int numTypes = 2;
+
+    explicit ConsoleLog(int maxLines)
+        : capacity(static_cast<uint64>(maxLines))
+        , lines(static_cast<size_t>(maxLines))
+    {
+        for (auto& bitmap : typeBitmaps)
+            bitmap.assign(static_cast<size_t>((capacity + 63) / 64), 0);
+    }
+
+    // Adds a line, or adds to the repeats of the last one if it's the same
+    // Returns the new line so it can be measured, or nullptr if it was a repeat
+    Line* add(String const& text, int type, int repeats)
+    {
+        type = jlimit(0, numTypes - 1, type);
+
+        if (next > getStart()) {
+            auto& last = (*this)[next - 1];
+            if (last.type == type && last.text == text) {
+                last.repeats += repeats;
+                return nullptr;
+            }
+        }
+
+        if (next - first == capacity)
+            removeOldest();
+
+        auto const slot = next % capacity;
+        lines[slot] = { text, type, 0, repeats };
+        typeBitmaps[type][slot / 64] |= uint64(1) << (slot % 64);
+
+        getWords(text, scratchWords);
+        for (auto const& word : scratchWords)
+            words[word].push_back(next);
+
+        next++;
+        return &lines[slot];
+    }
+
+    Line& operator[](uint64 number)
+    {
+        return lines[number % capacity];
+    }
+
+    Line const& operator[](uint64 number) const
+    {
+        return lines[number % capacity];
+    }
+
+    // Whether a line with this number is kept and shown
+    bool contains(uint64 number) const
+    {
+        return number >= getStart() && number < next;
+    }
+
+    // Number of the oldest line that is kept, shown or not
+    uint64 getOldest() const
+    {
+        return first;
+    }
+
+    // Number of the first line that is shown, lines before it were cleared or are gone
+    uint64 getStart() const
+    {
+        return std::max(first, clearedUntil);
+    }
+
+    // Number that the next line will get
+    uint64 getEnd() const
+    {
+        return next;
+    }
+
+    // Hides the lines until now, they're kept until restore or until newer lines push them out
+    void clear()
+    {
+        clearedUntil = next;
+    }
+
+    void restore()
+    {
+        clearedUntil = first;
+    }
+
+    // Adds the numbers of the shown lines from number from on that match, in order
+    // A line matches when its type is in typeMask, bit n for type n, and every word of the
+    // query starts one of its words. When the query has no words, the query has to be part of the line
+    void find(uint64 from, int typeMask, String const& query, std::vector<uint64>& result) const
+    {
+        from = std::max(from, getStart());
+        if (from >= next)
+            return;
+
+        if (query.isEmpty()) {
+            forEachOfType(from, typeMask, [&result](uint64 number) { result.push_back(number); });
+            return;
+        }
+
+        StringArray queryWords;
+        getWords(query, queryWords);
+
+        if (queryWords.isEmpty()) {
+            forEachOfType(from, typeMask, [this, &query, &result](uint64 number) {
+                if ((*this)[number].text.containsIgnoreCase(query))
+                    result.push_back(number);
+            });
+            return;
+        }
+
+        std::vector<uint64> matches, candidates, merged;
+        for (int i = 0; i < queryWords.size(); i++) {
+            auto const& queryWord = queryWords[i];
+            candidates.clear();
+
+            // The words that start with the query word are next to each other in the map
+            for (auto it = words.lower_bound(queryWord); it != words.end() && it->first.startsWith(queryWord); ++it) {
+                auto const& numbers = it->second;
+                merged.clear();
+                std::merge(candidates.begin(), candidates.end(), std::lower_bound(numbers.begin(), numbers.end(), from), numbers.end(), std::back_inserter(merged));
+                std::swap(candidates, merged);
+            }
+
+            // A line can have more than one word that starts with the query word
+            candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+            if (i == 0) {
+                std::swap(matches, candidates);
+            } else {
+                merged.clear();
+                std::set_intersection(matches.begin(), matches.end(), candidates.begin(), candidates.end(), std::back_inserter(merged));
+                std::swap(matches, merged);
+            }
+
+            if (matches.empty())
+                return;
+        }
+
+        for (auto const number : matches) {
+            if (typeMask & (1 << (*this)[number].type))
+                result.push_back(number);
+        }
+    }
+
+private:
+    // Calls callback with the number of every line from number from on with a type in typeMask
+    template<typename Callback>
+    void forEachOfType(uint64 from, int typeMask, Callback&& callback) const
+    {
+        // Two runs of slots at most, when the lines wrap around the end of the ring
+        while (from < next) {
+            auto const startSlot = from % capacity;
+            auto const endSlot = startSlot + std::min(next - from, capacity - startSlot);
+
+            for (auto slot = startSlot; slot < endSlot;) {
+                auto const offset = slot % 64;
+                auto const span = std::min<uint64>(64 - offset, endSlot - slot);
+
+                uint64 bits = 0;
+                for (int type = 0; type < numTypes; type++) {
+                    if (typeMask & (1 << type))
+                        bits |= typeBitmaps[type][slot / 64];
+                }
+
+                bits >>= offset;
+                if (span < 64)
+                    bits &= (uint64(1) << span) - 1;
+
+                for (; bits != 0; bits &= bits - 1)
+                    callback(from + (slot - startSlot) + static_cast<uint64>(std::countr_zero(bits)));
+
+                slot += span;
+            }
+
+            from += endSlot - startSlot;
+        }
+    }
+
+    void removeOldest()
+    {
+        auto const slot = first % capacity;
+        auto& line = lines[slot];
+
+        typeBitmaps[line.type][slot / 64] &= ~(uint64(1) << (slot % 64));
+
+        // The oldest line is first in the list of every word it has
+        getWords(line.text, scratchWords);
+        for (auto const& word : scratchWords) {
+            auto it = words.find(word);
+            if (it == words.end())
+                continue;
+
+            if (!it->second.empty() && it->second.front() == first)
+                it->second.pop_front();
+
+            if (it->second.empty())
+                words.erase(it);
+        }
+
+        line = Line();
+        first++;
+    }
+
+    // The words of text in lower case, each one once, a word being letters, digits, '_' and '~'
+    static void getWords(String const& text, StringArray& result)
+    {
+        auto isWordCharacter = [](juce_wchar c) {
+            return CharacterFunctions::isLetterOrDigit(c) || c == '_' || c == '~';
+        };
+
+        result.clearQuick();
+
+        auto p = text.getCharPointer();
+        while (!p.isEmpty()) {
+            while (!p.isEmpty() && !isWordCharacter(*p))
+                ++p;
+
+            auto const start = p;
+            while (!p.isEmpty() && isWordCharacter(*p))
+                ++p;
+
+            if (p != start)
+                result.addIfNotAlreadyThere(String(start, p).toLowerCase());
+        }
+    }
+
+    uint64 capacity;
+    std::vector<Line> lines;
+
+    uint64 first = 0;
+    uint64 next = 0;
+    uint64 clearedUntil = 0;
+
+    std::array<std::vector<uint64>, numTypes> typeBitmaps;
+
+    // The numbers of the lines that have each word, oldest first
+    std::map<String, std::deque<uint64>> words;
+
+    StringArray scratchWords;
+};
+
+}
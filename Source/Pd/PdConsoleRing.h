@@ -0,0 +1,145 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <cstring>
+
+namespace pd {
+
+// Preallocated ring of console lines, written by pd and the GUI and read by the console
+//! @details Lines are stored back-to-back in a fixed ring of memory like the CommandRing, so printing
+//! from the audio thread never touches the heap. A line that is the same as the last one that hasn't
+//! been read yet only increments its repeat count, so printing at audio rate only fills a single line.
+//! Lines that don't fit are dropped and counted, instead of blocking or growing the ring.
+//! Producers are serialised by a SpinLock, the consumer never locks.
+class ConsoleRing {
+public:
+    struct Line {
+        uint32 size;
+        int type;
+        int length;
+
+        // Set to consumed by the reader, after that a producer will never touch this line again
+        std::atomic<uint32> repeats;
+
+        char const* getText() const
+        {
+            return reinterpret_cast<char const*>(this) + headerSize;
+        }
+    };
+
+    explicit ConsoleRing(size_t capacityInBytes = 1 << 16)
+        : capacity(nextPowerOfTwo(static_cast<int>(capacityInBytes)))
+    {
+        buffer.allocate(capacity, true);
+    }
+
+    // Returns false if the line was dropped because the ring is full
+    bool write(char const* text, int length, int type)
+    {
+        auto const size = roundUp(headerSize + static_cast<size_t>(length));
+
+        if (size > capacity / 2) {
+            numDropped++;
+            return false;
+        }
+
+        SpinLock::ScopedLockType lock(writeLock);
+
+        if (lastLine && lastLine->type == type && lastLine->length == length && std::memcmp(lastLine->getText(), text, static_cast<size_t>(length)) == 0) {
+            auto repeats = lastLine->repeats.load(std::memory_order_relaxed);
+            while (repeats != consumed && !lastLine->repeats.compare_exchange_weak(repeats, repeats + 1, std::memory_order_relaxed)) { }
+
+            if (repeats != consumed)
+                return true;
+        }
+
+        auto const write = writePosition.load(std::memory_order_relaxed);
+        auto const read = readPosition.load(std::memory_order_acquire);
+
+        auto offset = write & (capacity - 1);
+        auto const padding = offset + size > capacity ? capacity - offset : 0;
+
+        if (capacity - (write - read) < padding + size) {
+            numDropped++;
+            return false;
+        }
+
+        if (padding) {
+            new (buffer.get() + offset) Line { static_cast<uint32>(padding), wrapType, 0, consumed };
+            offset = 0;
+        }
+
+        auto* line = new (buffer.get() + offset) Line { static_cast<uint32>(size), type, length, 1 };
+        std::memcpy(buffer.get() + offset + headerSize, text, static_cast<size_t>(length));
+        lastLine = line;
+
+        writePosition.store(write + padding + size, std::memory_order_release);
+        return true;
+    }
+
+    // Calls callback(text, length, type, repeats) for every pending line, only one thread may read
+    template<typename Callback>
+    void readAll(Callback&& callback)
+    {
+        auto position = readPosition.load(std::memory_order_relaxed);
+
+        while (position != writePosition.load(std::memory_order_acquire)) {
+            auto* line = reinterpret_cast<Line*>(buffer.get() + (position & (capacity - 1)));
+            position += line->size;
+
+            if (line->type != wrapType) {
+                auto const repeats = line->repeats.exchange(consumed, std::memory_order_acquire);
+                callback(line->getText(), line->length, line->type, static_cast<int>(repeats));
+            }
+
+            readPosition.store(position, std::memory_order_release);
+        }
+    }
+
+    // Number of lines that were dropped since the last call
+    int getNumDropped()
+    {
+        return static_cast<int>(numDropped.exchange(0));
+    }
+
+    bool isEmpty() const
+    {
+        return readPosition.load(std::memory_order_acquire) == writePosition.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr int wrapType = -1;
+    static constexpr uint32 consumed = 0xffffffff;
+    static constexpr size_t granularity = 16;
+
+    static constexpr size_t roundUp(size_t size)
+    {
+        return (size + granularity - 1) & ~(granularity - 1);
+    }
+
+    static constexpr size_t headerSize = (sizeof(Line) + granularity - 1) & ~(granularity - 1);
+
+    size_t const capacity;
+    HeapBlock<char> buffer;
+
+    std::atomic<size_t> writePosition = 0;
+    std::atomic<size_t> readPosition = 0;
+    std::atomic<uint32> numDropped = 0;
+
+    // Most recently written line, only touched by producers while holding the lock
+    Line* lastLine = nullptr;
+
+    SpinLock writeLock;
+
+    JUCE_DECLARE_NON_COPYABLE(ConsoleRing)
+};
+
+} // namespace pd
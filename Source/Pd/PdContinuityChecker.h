@@ -0,0 +1,189 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <functional>
+
+namespace pd {
+
+// Keeps pd's scheduler running when the host stops calling the audio callback
+//! @details A realtime thread watches the audio callback. Once no block arrived for two block
+//! lengths, it starts running the callback at pd's tick rate, until the audio callback resumes.
+//! Ticks are scheduled against the time the backup started rather than the previous wakeup,
+//! so sleeping imprecisely never makes pd's clocks drift. If the thread falls far behind, the
+//! missed ticks are skipped instead of being processed in a burst.
+//! Only one side processes pd at a time: the audio callback, the backup thread and the
+//! message thread claim ownership through a single atomic, nothing here takes a lock.
+class ContinuityChecker : private Thread {
+public:
+    enum Owner {
+        None,
+        Audio,
+        Backup,
+        Message
+    };
+
+    // Claims pd for the duration of an audio callback
+    struct ScopedAudioCallback {
+        ScopedAudioCallback(ContinuityChecker& checker, bool nonRealtime)
+            : owner(checker)
+        {
+            owner.audioCallbackStarted(nonRealtime);
+        }
+
+        ~ScopedAudioCallback()
+        {
+            owner.release();
+        }
+
+        ContinuityChecker& owner;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedAudioCallback)
+    };
+
+    ContinuityChecker()
+        : Thread("Pd Backup Scheduler")
+    {
+    }
+
+    ~ContinuityChecker() override
+    {
+        stop();
+    }
+
+    // Called on the backup thread for every tick, with ownership of pd
+    void setCallback(std::function<void()> cb)
+    {
+        stop();
+        callback = std::move(cb);
+    }
+
+    void prepare(double sampleRate, int samplesPerBlock, int pdBlockSize)
+    {
+        // Changing the timing of a running backup would confuse its schedule
+        stop();
+
+        if (sampleRate <= 0.0 || samplesPerBlock <= 0)
+            return;
+
+        blockMs = samplesPerBlock / sampleRate * 1000.0;
+        tickMs = pdBlockSize / sampleRate * 1000.0;
+        lastCallbackTime = Time::getMillisecondCounterHiRes();
+
+        if (callback)
+            startThread(Thread::realtimeAudioPriority);
+    }
+
+    // Stops the backup thread, has to be called before anything the callback uses is destroyed
+    void stop()
+    {
+        signalThreadShouldExit();
+        notify();
+        stopThread(-1);
+    }
+
+    bool tryAcquire(Owner newOwner)
+    {
+        auto expected = None;
+        return owner.compare_exchange_strong(expected, newOwner, std::memory_order_acquire);
+    }
+
+    void release()
+    {
+        owner.store(None, std::memory_order_release);
+    }
+
+    bool isBackupRunning() const
+    {
+        return backupRunning.load();
+    }
+
+    // Number of ticks that were run by the backup scheduler so far
+    uint64 getNumBackupTicks() const
+    {
+        return numBackupTicks.load();
+    }
+
+private:
+    // Never fall behind by more than this, older ticks are skipped
+    static constexpr double maxLagMs = 100.0;
+
+    void audioCallbackStarted(bool nonRealtime)
+    {
+        isNonRealtime.store(nonRealtime, std::memory_order_relaxed);
+        lastCallbackTime.store(Time::getMillisecondCounterHiRes(), std::memory_order_relaxed);
+        numCallbacks.fetch_add(1, std::memory_order_relaxed);
+
+        // Waits for at most one backup tick
+        while (!tryAcquire(Audio)) { }
+    }
+
+    bool audioHasStalled() const
+    {
+        return !isNonRealtime && Time::getMillisecondCounterHiRes() - lastCallbackTime > 2.0 * blockMs;
+    }
+
+    void run() override
+    {
+        while (!threadShouldExit()) {
+            if (!audioHasStalled()) {
+                wait(jmax(1, roundToInt(blockMs)));
+                continue;
+            }
+
+            runBackup();
+        }
+    }
+
+    void runBackup()
+    {
+        auto const callbacksBefore = numCallbacks.load();
+        auto const startTime = Time::getMillisecondCounterHiRes();
+        int64 ticksDone = 0;
+
+        backupRunning = true;
+
+        while (!threadShouldExit() && !isNonRealtime && numCallbacks.load() == callbacksBefore) {
+            auto const ticksDue = static_cast<int64>((Time::getMillisecondCounterHiRes() - startTime) / tickMs);
+
+            if ((ticksDue - ticksDone) * tickMs > maxLagMs)
+                ticksDone = ticksDue - 1;
+
+            while (ticksDone < ticksDue && tryAcquire(Backup)) {
+                callback();
+                release();
+
+                ticksDone++;
+                numBackupTicks++;
+            }
+
+            auto const nextTick = startTime + static_cast<double>(ticksDone + 1) * tickMs;
+            wait(jmax(1, static_cast<int>(nextTick - Time::getMillisecondCounterHiRes())));
+        }
+
+        backupRunning = false;
+    }
+
+    std::function<void()> callback;
+
+    double blockMs = 0.0;
+    double tickMs = 0.0;
+
+    std::atomic<Owner> owner = None;
+
+    std::atomic<double> lastCallbackTime = 0.0;
+    std::atomic<uint32> numCallbacks = 0;
+    std::atomic<bool> isNonRealtime = false;
+
+    std::atomic<bool> backupRunning = false;
+    std::atomic<uint64> numBackupTicks = 0;
+};
+
+} // namespace pd
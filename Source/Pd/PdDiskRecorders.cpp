@@ -0,0 +1,339 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "PdDiskRecorders.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+
+extern "C" {
+#include "x_libpd_diskrec.h"
+}
+
+namespace pd {
+
+JUCE_IMPLEMENT_SINGLETON(DiskRecorders)
+
+namespace {
+
+// How much the ring of a recording holds, for when the disk stalls
+constexpr double ringSeconds = 4.0;
+
+// Used for the ring when pd doesn't know its samplerate yet
+constexpr double minSampleRate = 44100.0;
+
+// How many starts and stops a recorder can have waiting for the writer
+constexpr int maxCommands = 8;
+
+// How often the writer drains the rings, it isn't woken by the audio thread since that would lock
+constexpr int drainInterval = 50;
+
+// Size of the file's write buffer, so the disk gets large writes
+constexpr size_t writeBufferSize = 1 << 20;
+
+}
+
+struct DiskRecorders::Recorder {
+    // A start, or a stop when take is 0, with the number of frames that were written to the ring before it
+    struct Command {
+        uint64 position;
+        int take;
+        double sampleRate;
+        int bits;
+        char path[MAXPDSTRING];
+    };
+
+    int const numChannels;
+
+    AudioBuffer<float> ring;
+    AbstractFifo fifo;
+
+    std::array<Command, maxCommands> commands;
+    AbstractFifo commandFifo;
+
+    // Only used by pd, its lock orders the audio thread with its messages
+    uint64 written = 0;
+    int take = 0;
+    uint64 droppedAtStart = 0;
+
+    // Only used by the writer
+    std::unique_ptr<AudioFormatWriter> writer;
+    std::vector<float const*> channels;
+    uint64 read = 0;
+    int writerTake = 0;
+
+    std::atomic<uint64> dropped = 0;
+    std::atomic<int> failedTake = 0;
+    std::atomic<bool> released = false;
+
+    Recorder* next = nullptr;
+
+    Recorder(int nchans, int ringSize)
+        : numChannels(nchans)
+        , ring(nchans, ringSize)
+        , fifo(ringSize)
+        , commandFifo(maxCommands)
+        , channels(static_cast<size_t>(nchans))
+    {
+    }
+
+    bool writeFromRing(int start, int size)
+    {
+        if (size == 0)
+            return true;
+
+        for (int ch = 0; ch < numChannels; ch++)
+            channels[ch] = ring.getReadPointer(ch, start);
+
+        return writer->writeFromFloatArrays(channels.data(), numChannels, size);
+    }
+
+    // Frames without a file, because it failed or wasn't started, are dropped
+    void writeFrames(int numFrames)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(numFrames, start1, size1, start2, size2);
+
+        if (writer && !(writeFromRing(start1, size1) && writeFromRing(start2, size2))) {
+            writer.reset();
+            failedTake = writerTake;
+        }
+
+        fifo.finishedRead(size1 + size2);
+        read += static_cast<uint64>(size1 + size2);
+    }
+
+    void post(int newTake, char const* path, double sampleRate, int bits)
+    {
+        int start1, size1, start2, size2;
+        commandFifo.prepareToWrite(1, start1, size1, start2, size2);
+
+        auto& command = commands[start1];
+        command.position = written;
+        command.take = newTake;
+        command.sampleRate = sampleRate;
+        command.bits = bits;
+        std::strncpy(command.path, path, MAXPDSTRING - 1);
+        command.path[MAXPDSTRING - 1] = 0;
+
+        commandFifo.finishedWrite(1);
+    }
+};
+
+DiskRecorders::DiskRecorders()
+    : Thread("Disk Recorder")
+{
+    formats[0] = std::make_unique<WavAudioFormat>();
+    formats[1] = std::make_unique<FlacAudioFormat>();
+    formats[2] = std::make_unique<AiffAudioFormat>();
+
+    for (int i = 0; i < 3; i++)
+        bitDepths[i] = formats[i]->getPossibleBitDepths();
+
+    static t_libpd_diskrec_registry const registry = {
+        [](int nchans, double samplerate) { return create(nchans, samplerate); },
+        [](void* recorder) { release(recorder); },
+        [](char const* path, int bits) { return check(path, bits); },
+        [](void* recorder, char const* path, double samplerate, int bits) { return start(recorder, path, samplerate, bits); },
+        [](void* recorder) { stop(recorder); },
+        [](void* recorder, t_sample const* const* in, int n) { write(recorder, reinterpret_cast<void const* const*>(in), n); },
+        [](void* recorder, double* dropped) { return status(recorder, dropped); },
+    };
+
+    libpd_diskrec_set_registry(&registry);
+
+    startThread(7);
+}
+
+DiskRecorders::~DiskRecorders()
+{
+    libpd_diskrec_set_registry(nullptr);
+    stopThread(-1);
+
+    // Finish every file, so what was recorded until now can be played back
+    adopt();
+    for (auto& recorder : recorders) {
+        recorder->released = true;
+        drain(*recorder);
+    }
+
+    clearSingletonInstance();
+}
+
+void DiskRecorders::run()
+{
+    while (!threadShouldExit()) {
+        adopt();
+
+        recorders.erase(std::remove_if(recorders.begin(), recorders.end(), [this](auto const& recorder) {
+            return !drain(*recorder);
+        }),
+            recorders.end());
+
+        wait(drainInterval);
+    }
+}
+
+void DiskRecorders::adopt()
+{
+    auto* recorder = created.exchange(nullptr, std::memory_order_acquire);
+
+    while (recorder) {
+        auto* next = recorder->next;
+        recorders.emplace_back(recorder);
+        recorder = next;
+    }
+}
+
+bool DiskRecorders::drain(Recorder& r)
+{
+    // Checked first, so everything pd did before it let go of the recorder is handled below
+    auto const released = r.released.load(std::memory_order_acquire);
+
+    while (true) {
+        int start1, size1, start2, size2;
+        r.commandFifo.prepareToRead(1, start1, size1, start2, size2);
+        auto const* command = size1 > 0 ? &r.commands[start1] : nullptr;
+
+        // The frames before a command are in the ring by the time it's posted, they belong to the previous take
+        auto const ready = static_cast<uint64>(r.fifo.getNumReady());
+        r.writeFrames(static_cast<int>(command ? jmin(ready, command->position - r.read) : ready));
+
+        if (!command)
+            break;
+
+        r.writer.reset();
+        if (command->take != 0)
+            startFile(r, command->take, command->path, command->sampleRate, command->bits);
+
+        r.commandFifo.finishedRead(1);
+    }
+
+    if (released) {
+        r.writer.reset();
+        return false;
+    }
+
+    return true;
+}
+
+void DiskRecorders::startFile(Recorder& r, int take, char const* path, double sampleRate, int bits)
+{
+    auto const name = String::fromUTF8(path);
+    auto const format = findFormat(path);
+
+    r.writerTake = take;
+
+    if (format >= 0 && File::isAbsolutePath(name)) {
+        auto stream = std::make_unique<FileOutputStream>(File(name), writeBufferSize);
+        if (stream->openedOk() && stream->setPosition(0) && stream->truncate().wasOk())
+            r.writer.reset(formats[format]->createWriterFor(stream.get(), sampleRate, static_cast<unsigned int>(r.numChannels), bits, {}, 0));
+
+        if (r.writer)
+            stream.release();
+    }
+
+    if (!r.writer)
+        r.failedTake = take;
+}
+
+int DiskRecorders::findFormat(char const* path)
+{
+    static constexpr std::pair<char const*, int> extensions[] = { { "wav", 0 }, { "flac", 1 }, { "aif", 2 }, { "aiff", 2 } };
+
+    auto const* dot = std::strrchr(path, '.');
+    if (!dot || std::strpbrk(dot, "/\\"))
+        return -1;
+
+    for (auto const& [extension, format] : extensions) {
+        if (CharacterFunctions::compareIgnoreCase(CharPointer_UTF8(dot + 1), CharPointer_ASCII(extension)) == 0)
+            return format;
+    }
+
+    return -1;
+}
+
+void* DiskRecorders::create(int numChannels, double sampleRate)
+{
+    auto* recorders = getInstanceWithoutCreating();
+    if (!recorders || numChannels < 1)
+        return nullptr;
+
+    auto* recorder = new Recorder(numChannels, static_cast<int>(jmax(sampleRate, minSampleRate) * ringSeconds));
+
+    // The writer takes the whole list at once, so pushing is all that needs to be atomic
+    recorder->next = recorders->created.load(std::memory_order_relaxed);
+    while (!recorders->created.compare_exchange_weak(recorder->next, recorder, std::memory_order_release, std::memory_order_relaxed)) { }
+
+    return recorder;
+}
+
+void DiskRecorders::release(void* recorder)
+{
+    // The writer deletes it once it's drained
+    static_cast<Recorder*>(recorder)->released.store(true, std::memory_order_release);
+}
+
+int DiskRecorders::check(char const* path, int bits)
+{
+    auto* recorders = getInstanceWithoutCreating();
+    auto const format = findFormat(path);
+
+    return recorders && format >= 0 && recorders->bitDepths[format].contains(bits) ? 1 : 0;
+}
+
+int DiskRecorders::start(void* recorder, char const* path, double sampleRate, int bits)
+{
+    auto& r = *static_cast<Recorder*>(recorder);
+
+    // Leaves room for the stop, so that can always be posted
+    if (r.commandFifo.getFreeSpace() < 2)
+        return 0;
+
+    r.droppedAtStart = r.dropped.load(std::memory_order_relaxed);
+    r.post(++r.take, path, sampleRate, bits);
+    return 1;
+}
+
+void DiskRecorders::stop(void* recorder)
+{
+    static_cast<Recorder*>(recorder)->post(0, "", 0, 0);
+}
+
+void DiskRecorders::write(void* recorder, void const* const* in, int n)
+{
+    auto& r = *static_cast<Recorder*>(recorder);
+    auto const* const* source = reinterpret_cast<t_sample const* const*>(in);
+
+    int start1, size1, start2, size2;
+    r.fifo.prepareToWrite(n, start1, size1, start2, size2);
+
+    // Blocks are kept whole, so a file never has part of one
+    if (size1 + size2 < n) {
+        r.dropped.fetch_add(static_cast<uint64>(n), std::memory_order_relaxed);
+        return;
+    }
+
+    for (int ch = 0; ch < r.numChannels; ch++) {
+        std::copy(source[ch], source[ch] + size1, r.ring.getWritePointer(ch, start1));
+        std::copy(source[ch] + size1, source[ch] + n, r.ring.getWritePointer(ch, start2));
+    }
+
+    r.fifo.finishedWrite(n);
+    r.written += static_cast<uint64>(n);
+}
+
+int DiskRecorders::status(void* recorder, double* dropped)
+{
+    auto& r = *static_cast<Recorder*>(recorder);
+
+    *dropped = static_cast<double>(r.dropped.load(std::memory_order_relaxed) - r.droppedAtStart);
+    return r.failedTake.load(std::memory_order_relaxed) == r.take ? 0 : 1;
+}
+
+} // namespace pd
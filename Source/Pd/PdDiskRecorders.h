@@ -0,0 +1,68 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace pd {
+
+// The files that [diskrec~] objects record to, for every instance in the process
+//! @details Each object gets a recorder with a ring buffer of a few seconds when it's created, which the audio thread
+//! copies its blocks into. Starting and stopping are posted to the same recorder, with the position in the ring where
+//! they happened, so nothing pd does while it's running locks, allocates or touches the disk. One thread drains every
+//! ring into its file, creating the file when it reaches a start and finishing it at a stop, so a slow disk only delays
+//! it; when a ring is full the block is dropped and counted, which the object reports. The writer deletes a recorder
+//! once its object has released it and everything has been written.
+//! WAV files that grow past 4 GB are written as RF64, so recordings can run for hours.
+class DiskRecorders : public DeletedAtShutdown
+    , private Thread {
+public:
+    DiskRecorders();
+    ~DiskRecorders() override;
+
+    JUCE_DECLARE_SINGLETON(DiskRecorders, false)
+
+private:
+    struct Recorder;
+
+    void run() override;
+
+    // Takes the recorders that were created since the last call
+    void adopt();
+
+    // Writes what's in the ring to the files, returns false once the recorder is released and everything is written
+    bool drain(Recorder& recorder);
+    void startFile(Recorder& recorder, int take, char const* path, double sampleRate, int bits);
+
+    // Index of the format for the path's extension, or -1
+    static int findFormat(char const* path);
+
+    // Called by pd, see x_libpd_diskrec.h
+    static void* create(int numChannels, double sampleRate);
+    static void release(void* recorder);
+    static int check(char const* path, int bits);
+    static int start(void* recorder, char const* path, double sampleRate, int bits);
+    static void stop(void* recorder);
+    static void write(void* recorder, void const* const* in, int n);
+    static int status(void* recorder, double* dropped);
+
+    // Created up front, so checking a file doesn't allocate
+    std::unique_ptr<AudioFormat> formats[3];
+    Array<int> bitDepths[3];
+
+    // Recorders that were created but not yet seen by the writer, linked through their next pointer
+    std::atomic<Recorder*> created = nullptr;
+
+    // Only used by the writer
+    std::vector<std::unique_ptr<Recorder>> recorders;
+};
+
+} // namespace pd
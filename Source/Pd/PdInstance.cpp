@@ -11,90 +11,113 @@ extern "C" {
 #include <m_imp.h>
 
 #include "x_libpd_extra_utils.h"
+#include "x_libpd_fuse.h"
 #include "x_libpd_mod_utils.h"
 #include "x_libpd_multi.h"
+#include "x_libpd_parallel.h"
 #include "z_print_util.h"
 }
 
 #include "PdInstance.h"
 #include "PdPatch.h"
+#include "PdLibraryPaths.h"
+#include "../Utility/Trace.h"
 
 extern "C" {
 struct pd::Instance::internal {
 
-    static void instance_multi_bang(pd::Instance* ptr, char const* recv)
+    // Messages from pd to the GUI are copied into the outgoing message queue, without allocating
+    // Symbols are interned by pd already, so we only need to pass the pointers
+
+    // What pd sends to "pd" is only shown by the editor, so it's dropped while there is no editor
+    static bool isUnheard(pd::Instance* ptr, t_symbol* recv)
     {
-        ptr->enqueueFunctionAsync([ptr, recv]() { ptr->processMessage({ String("bang"), String(recv) }); });
+        return ptr->isHeadless() && recv == ptr->knownSymbols.pd;
     }
 
-    static void instance_multi_float(pd::Instance* ptr, char const* recv, float f)
+    static void instance_multi_bang(pd::Instance* ptr, t_symbol* recv)
     {
-        ptr->enqueueFunctionAsync([ptr, recv, f]() mutable { ptr->processMessage({ String("float"), String(recv), std::vector<Atom>(1, { f }) }); });
+        if (isUnheard(ptr, recv))
+            return;
+
+        ptr->enqueueOutgoing([ptr, recv]() { return ptr->m_message_queue.enqueueBang(nullptr, recv); });
     }
 
-    static void instance_multi_symbol(pd::Instance* ptr, char const* recv, char const* sym)
+    static void instance_multi_float(pd::Instance* ptr, t_symbol* recv, float f)
     {
-        ptr->enqueueFunctionAsync([ptr, recv, sym]() mutable { ptr->processMessage({ String("symbol"), String(recv), std::vector<Atom>(1, String(sym)) }); });
+        if (isUnheard(ptr, recv))
+            return;
+
+        ptr->enqueueOutgoing([ptr, recv, f]() { return ptr->m_message_queue.enqueueFloat(nullptr, recv, f); });
     }
 
-    static void instance_multi_list(pd::Instance* ptr, char const* recv, int argc, t_atom* argv)
+    static void instance_multi_symbol(pd::Instance* ptr, t_symbol* recv, t_symbol* sym)
     {
-        Message mess { String("list"), String(recv), std::vector<Atom>(argc) };
-        for (int i = 0; i < argc; ++i) {
-            if (argv[i].a_type == A_FLOAT)
-                mess.list[i] = Atom(atom_getfloat(argv + i));
-            else if (argv[i].a_type == A_SYMBOL)
-                mess.list[i] = Atom(String(atom_getsymbol(argv + i)->s_name));
-        }
+        if (isUnheard(ptr, recv))
+            return;
 
-        ptr->enqueueFunctionAsync([ptr, mess]() mutable { ptr->processMessage(mess); });
+        ptr->enqueueOutgoing([ptr, recv, sym]() { return ptr->m_message_queue.enqueueSymbol(nullptr, recv, sym); });
     }
 
-    static void instance_multi_message(pd::Instance* ptr, char const* recv, char const* msg, int argc, t_atom* argv)
+    static void instance_multi_list(pd::Instance* ptr, t_symbol* recv, int argc, t_atom* argv)
     {
-        Message mess { msg, String(recv), std::vector<Atom>(argc) };
-        for (int i = 0; i < argc; ++i) {
-            if (argv[i].a_type == A_FLOAT)
-                mess.list[i] = Atom(atom_getfloat(argv + i));
-            else if (argv[i].a_type == A_SYMBOL)
-                mess.list[i] = Atom(String(atom_getsymbol(argv + i)->s_name));
-        }
-        ptr->enqueueFunctionAsync([ptr, mess]() mutable { ptr->processMessage(std::move(mess)); });
+        if (isUnheard(ptr, recv))
+            return;
+
+        ptr->enqueueOutgoing([ptr, recv, argc, argv]() { return ptr->m_message_queue.enqueueAtoms(nullptr, recv, nullptr, argc, argv); });
+    }
+
+    static void instance_multi_message(pd::Instance* ptr, t_symbol* recv, t_symbol* msg, int argc, t_atom* argv)
+    {
+        if (isUnheard(ptr, recv))
+            return;
+
+        ptr->enqueueOutgoing([ptr, recv, msg, argc, argv]() { return ptr->m_message_queue.enqueueAtoms(nullptr, recv, msg, argc, argv); });
     }
 
+    // Binds name in the current instance, what it receives is passed to processMessage
+    static void* receiver_new(pd::Instance* ptr, char const* name)
+    {
+        return libpd_multi_receiver_new(ptr, name, reinterpret_cast<t_libpd_multi_banghook>(instance_multi_bang), reinterpret_cast<t_libpd_multi_floathook>(instance_multi_float), reinterpret_cast<t_libpd_multi_symbolhook>(instance_multi_symbol),
+            reinterpret_cast<t_libpd_multi_listhook>(instance_multi_list), reinterpret_cast<t_libpd_multi_messagehook>(instance_multi_message));
+    }
+
+    // Midi is handled straight away, pd calls these with its lock held, from within the tick or from a
+    // thread that has the lock. This way outgoing midi keeps its logical time and nothing is allocated
     static void instance_multi_noteon(pd::Instance* ptr, int channel, int pitch, int velocity)
     {
-        ptr->enqueueFunctionAsync([ptr, channel, pitch, velocity]() mutable { ptr->processMidiEvent({ midievent::NOTEON, channel, pitch, velocity }); });
+        ptr->addMidiOutput(channel, velocity == 0 ? 0x80 : 0x90, pitch, velocity, 3);
     }
 
     static void instance_multi_controlchange(pd::Instance* ptr, int channel, int controller, int value)
     {
-        ptr->enqueueFunctionAsync([ptr, channel, controller, value]() mutable { ptr->processMidiEvent({ midievent::CONTROLCHANGE, channel, controller, value }); });
+        ptr->addMidiOutput(channel, 0xb0, controller, value, 3);
     }
 
     static void instance_multi_programchange(pd::Instance* ptr, int channel, int value)
     {
-        ptr->enqueueFunctionAsync([ptr, channel, value]() mutable { ptr->processMidiEvent({ midievent::PROGRAMCHANGE, channel, value, 0 }); });
+        ptr->addMidiOutput(channel, 0xc0, value, 0, 2);
     }
 
     static void instance_multi_pitchbend(pd::Instance* ptr, int channel, int value)
     {
-        ptr->enqueueFunctionAsync([ptr, channel, value]() mutable { ptr->processMidiEvent({ midievent::PITCHBEND, channel, value, 0 }); });
+        auto const bend = std::clamp(value + 8192, 0, 16383);
+        ptr->addMidiOutput(channel, 0xe0, bend & 0x7f, bend >> 7, 3);
     }
 
     static void instance_multi_aftertouch(pd::Instance* ptr, int channel, int value)
     {
-        ptr->enqueueFunctionAsync([ptr, channel, value]() mutable { ptr->processMidiEvent({ midievent::AFTERTOUCH, channel, value, 0 }); });
+        ptr->addMidiOutput(channel, 0xd0, value, 0, 2);
     }
 
     static void instance_multi_polyaftertouch(pd::Instance* ptr, int channel, int pitch, int value)
     {
-        ptr->enqueueFunctionAsync([ptr, channel, pitch, value]() mutable { ptr->processMidiEvent({ midievent::POLYAFTERTOUCH, channel, pitch, value }); });
+        ptr->addMidiOutput(channel, 0xa0, pitch, value, 3);
     }
 
     static void instance_multi_midibyte(pd::Instance* ptr, int port, int byte)
     {
-        ptr->enqueueFunctionAsync([ptr, port, byte]() mutable { ptr->processMidiEvent({ midievent::MIDIBYTE, port, byte, 0 }); });
+        ptr->addMidiOutputByte(port, byte);
     }
 
     static void instance_multi_print(pd::Instance* ptr, char const* s)
@@ -109,41 +132,69 @@ bool wantsNativeDialog();
 namespace pd {
 
 Instance::Instance(String const& symbol)
-    : consoleHandler(this)
+    : messageDispatcher(this)
+    , consoleHandler(this)
 {
+    auto const constructionStart = Time::getHighResolutionTicks();
+
     libpd_multi_init();
 
     m_instance = libpd_new_instance();
 
     libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
+    symbols.setInstance(m_instance);
 
     libpd_init_else();
     libpd_init_cyclone();
 
+    libpd_set_parallel_executor(workerPool.get(), [](void* pool, t_libpd_parallel_task task, void* data, int numTasks) {
+        static_cast<WorkerPool*>(pool)->run(task, data, numTasks);
+    });
+
     m_midi_receiver = libpd_multi_midi_new(this, reinterpret_cast<t_libpd_multi_noteonhook>(internal::instance_multi_noteon), reinterpret_cast<t_libpd_multi_controlchangehook>(internal::instance_multi_controlchange), reinterpret_cast<t_libpd_multi_programchangehook>(internal::instance_multi_programchange),
         reinterpret_cast<t_libpd_multi_pitchbendhook>(internal::instance_multi_pitchbend), reinterpret_cast<t_libpd_multi_aftertouchhook>(internal::instance_multi_aftertouch), reinterpret_cast<t_libpd_multi_polyaftertouchhook>(internal::instance_multi_polyaftertouch),
         reinterpret_cast<t_libpd_multi_midibytehook>(internal::instance_multi_midibyte));
     m_print_receiver = libpd_multi_print_new(this, reinterpret_cast<t_libpd_multi_printhook>(internal::instance_multi_print));
 
-    m_message_receiver = libpd_multi_receiver_new(this, "pd", reinterpret_cast<t_libpd_multi_banghook>(internal::instance_multi_bang), reinterpret_cast<t_libpd_multi_floathook>(internal::instance_multi_float), reinterpret_cast<t_libpd_multi_symbolhook>(internal::instance_multi_symbol),
-        reinterpret_cast<t_libpd_multi_listhook>(internal::instance_multi_list), reinterpret_cast<t_libpd_multi_messagehook>(internal::instance_multi_message));
-
-    m_parameter_receiver = libpd_multi_receiver_new(this, "param", reinterpret_cast<t_libpd_multi_banghook>(internal::instance_multi_bang), reinterpret_cast<t_libpd_multi_floathook>(internal::instance_multi_float), reinterpret_cast<t_libpd_multi_symbolhook>(internal::instance_multi_symbol),
-        reinterpret_cast<t_libpd_multi_listhook>(internal::instance_multi_list), reinterpret_cast<t_libpd_multi_messagehook>(internal::instance_multi_message));
-
-    m_parameter_change_receiver = libpd_multi_receiver_new(this, "param_change", reinterpret_cast<t_libpd_multi_banghook>(internal::instance_multi_bang), reinterpret_cast<t_libpd_multi_floathook>(internal::instance_multi_float), reinterpret_cast<t_libpd_multi_symbolhook>(internal::instance_multi_symbol),
-        reinterpret_cast<t_libpd_multi_listhook>(internal::instance_multi_list), reinterpret_cast<t_libpd_multi_messagehook>(internal::instance_multi_message));
-
-    m_atoms = malloc(sizeof(t_atom) * 512);
+    knownSymbols.pd = gensym("pd");
+    knownSymbols.param = gensym("param");
+    knownSymbols.paramChange = gensym("param_change");
+    knownSymbols.layer = gensym("layer");
+    knownSymbols.latency = gensym("latency");
+    knownSymbols.compiled = gensym("compiled");
+    knownSymbols.dsp = gensym("dsp");
+    knownSymbols.bang = &s_bang;
+    knownSymbols.floatSelector = &s_float;
+    knownSymbols.symbol = &s_symbol;
+    knownSymbols.list = &s_list;
+
+    m_message_receiver = internal::receiver_new(this, "pd");
+    m_parameter_receiver = internal::receiver_new(this, "param");
+    m_parameter_change_receiver = internal::receiver_new(this, "param_change");
+    m_layer_receiver = internal::receiver_new(this, "layer");
+    m_latency_receiver = internal::receiver_new(this, "latency");
+    m_compiled_receiver = internal::receiver_new(this, "compiled");
+
+    m_atoms = getbytes(sizeof(t_atom) * maxAtoms);
 
     // Register callback when pd's gui changes
     // Needs to be done on pd's thread
     auto gui_trigger = [](void* instance, void* target) {
+        // The editor redraws everything when it's opened
+        if (static_cast<Instance*>(instance)->isHeadless())
+            return;
+
         auto* pd = static_cast<t_pd*>(target);
 
-        // redraw scalar
+        // redraw scalar, only the ones that changed
         if (pd && !strcmp((*pd)->c_name->s_name, "scalar")) {
+            static_cast<Instance*>(instance)->m_dirty_objects.enqueue(target);
             static_cast<Instance*>(instance)->receiveGuiUpdate(2);
+        }
+        // We know which object changed
+        else if (pd) {
+            static_cast<Instance*>(instance)->m_dirty_objects.enqueue(target);
+            static_cast<Instance*>(instance)->receiveGuiUpdate(4);
         } else {
             static_cast<Instance*>(instance)->receiveGuiUpdate(1);
         }
@@ -159,6 +210,16 @@ Instance::Instance(String const& symbol)
 
     register_gui_triggers(static_cast<t_pdinstance*>(m_instance), this, gui_trigger, panel_trigger, synchronise_trigger, parameter_trigger);
 
+    auto canvas_event_trigger = [](void* instance, void const* event) {
+        auto* _this = static_cast<Instance*>(instance);
+        _this->m_canvas_events.enqueue({ _this->m_canvas_event_count++, *static_cast<CanvasEvent const*>(event) });
+
+        if (!_this->m_canvas_events_pending.exchange(true))
+            _this->canvasEventsAvailable();
+    };
+
+    register_canvas_event_hook(static_cast<t_pdinstance*>(m_instance), canvas_event_trigger);
+
     // HACK: create full path names for c-coded externals
     // Temporarily disabled because bugs
     /*
@@ -220,6 +281,8 @@ Instance::Instance(String const& symbol)
 
     libpd_set_verbose(0);
     setThis();
+
+    constructionTime = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - constructionStart);
 }
 
 Instance::~Instance()
@@ -229,25 +292,73 @@ Instance::~Instance()
     pd_free(static_cast<t_pd*>(m_print_receiver));
     pd_free(static_cast<t_pd*>(m_parameter_receiver));
     pd_free(static_cast<t_pd*>(m_parameter_change_receiver));
+    pd_free(static_cast<t_pd*>(m_layer_receiver));
+    pd_free(static_cast<t_pd*>(m_latency_receiver));
+    pd_free(static_cast<t_pd*>(m_compiled_receiver));
+    for (auto& [name, subscription] : messageListeners) {
+        if (subscription.receiver)
+            pd_free(static_cast<t_pd*>(subscription.receiver));
+    }
+    freebytes(m_atoms, sizeof(t_atom) * maxAtoms);
 
     libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
+    libpd_set_parallel_executor(nullptr, nullptr);
     libpd_free_instance(static_cast<t_pdinstance*>(m_instance));
 }
 
 int Instance::getBlockSize() const
 {
-    return libpd_blocksize();
+    return libpd_blocksize() * ticksPerBlock;
+}
+
+int Instance::getTicksPerBlock() const
+{
+    return ticksPerBlock;
+}
+
+void Instance::setTicksPerBlock(int ticks)
+{
+    ticksPerBlock = std::max(ticks, 1);
+}
+
+void Instance::setCompiledPatch(std::unique_ptr<CompiledPatch> patch)
+{
+    compiledPatch = std::move(patch);
+
+    // Not prepared yet, prepareDSP will pick it up
+    if (compiledPatch && dspConfiguration.sampleRate > 0.0)
+        compiledPatch->prepare(dspConfiguration.sampleRate, dspConfiguration.numInputs, dspConfiguration.numOutputs);
+}
+
+CompiledPatch* Instance::getCompiledPatch() const
+{
+    return compiledPatch.get();
 }
 
 void Instance::prepareDSP(int const nins, int const nouts, double const samplerate, int const blockSize)
 {
     libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
+    continuityChecker.prepare(samplerate, blockSize, libpd_blocksize());
+
+    if (compiledPatch)
+        compiledPatch->prepare(samplerate, nins, nouts);
+
+    // Hosts often prepare again with the same settings, there's no need to rebuild the chain then
+    DSPConfiguration const configuration { nins, nouts, samplerate };
+    keepDSPChain = pd_getdspstate() && configuration == dspConfiguration;
+
+    if (keepDSPChain)
+        return;
+
     libpd_init_audio(nins, nouts, static_cast<int>(samplerate));
-    continuityChecker.prepare(samplerate, blockSize, std::max(nins, nouts));
+    dspConfiguration = configuration;
 }
 
 void Instance::startDSP()
 {
+    if (std::exchange(keepDSPChain, false))
+        return;
+
     t_atom av;
     libpd_set_float(&av, 1.f);
     libpd_message("pd", "dsp", 1, &av);
@@ -264,7 +375,50 @@ void Instance::releaseDSP()
 void Instance::performDSP(float const* inputs, float* outputs)
 {
     libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
-    libpd_process_raw(inputs, outputs);
+
+    // pd's DSP chain doesn't run, the clocks and messages still do
+    if (compiledPatch) {
+        for (int i = 0; i < ticksPerBlock; i++)
+            libpd_process_nodsp();
+
+        compiledPatch->perform(inputs, outputs, getBlockSize());
+        return;
+    }
+
+    // Installs the profiler again after pd rebuilt its DSP chain
+    if (dspProfiling)
+        libpd_profiler_update();
+
+    if (ticksPerBlock == 1)
+        libpd_process_raw(inputs, outputs);
+    else
+        libpd_process_raw_ticks(inputs, outputs, ticksPerBlock);
+}
+
+void Instance::performDSP(float const** inputs, int numInputs, float** outputs, int numOutputs, int offset, bool direct)
+{
+    libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
+
+    // Installs the profiler again after pd rebuilt its DSP chain
+    if (dspProfiling)
+        libpd_profiler_update();
+
+    if (direct)
+        libpd_process_channels_direct(inputs, numInputs, outputs, numOutputs, offset);
+    else
+        libpd_process_channels(inputs, numInputs, outputs, numOutputs, offset);
+}
+
+void Instance::setPendingOutput(float const* buffer)
+{
+    libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
+    libpd_set_pending_output(buffer);
+}
+
+void Instance::getPendingOutput(float* buffer)
+{
+    libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
+    libpd_get_pending_output(buffer);
 }
 
 void Instance::sendNoteOn(int const channel, int const pitch, int const velocity) const
@@ -321,6 +475,45 @@ void Instance::sendMidiByte(int const port, int const byte) const
     libpd_midibyte(port, byte);
 }
 
+void Instance::sendMidiEvents(MidiBuffer const& buffer, int const port) const
+{
+    if (buffer.isEmpty())
+        return;
+
+    libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
+
+    sys_lock();
+    for (auto const event : buffer) {
+        libpd_dispatch_midi(port, event.data, event.numBytes);
+    }
+    sys_unlock();
+}
+
+void Instance::sendMidiEvents(MidiBus const& bus) const
+{
+    if (bus.isEmpty())
+        return;
+
+    libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
+
+    sys_lock();
+    for (int port = 0; port < bus.getNumPorts(); port++) {
+        for (auto const event : bus[port]) {
+            libpd_dispatch_midi(port, event.data, event.numBytes);
+        }
+    }
+    sys_unlock();
+}
+
+void Instance::sendMidiBytes(int const port, uint8 const* data, int const size) const
+{
+    libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
+
+    sys_lock();
+    libpd_dispatch_midi_stream(port, data, size);
+    sys_unlock();
+}
+
 void Instance::sendBang(char const* receiver) const
 {
 #if !PLUGDATA_STANDALONE
@@ -359,154 +552,260 @@ void Instance::sendSymbol(char const* receiver, char const* symbol) const
     libpd_symbol(receiver, symbol);
 }
 
-void Instance::sendList(char const* receiver, std::vector<Atom> const& list) const
+// Symbols are interned for the current instance, so it has to be set first
+int Instance::fillAtoms(std::vector<Atom> const& list) const
 {
     auto* argv = static_cast<t_atom*>(m_atoms);
-    libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
-    for (size_t i = 0; i < list.size(); ++i) {
+    auto const argc = std::min(static_cast<int>(list.size()), maxAtoms);
+    jassert(argc == static_cast<int>(list.size()));
+
+    for (int i = 0; i < argc; ++i) {
         if (list[i].isFloat())
-            libpd_set_float(argv + i, list[i].getFloat());
+            SETFLOAT(argv + i, list[i].getFloat());
         else
-            libpd_set_symbol(argv + i, list[i].getSymbol().toRawUTF8());
+            SETSYMBOL(argv + i, symbols.toSymbol(list[i].getSymbol()));
     }
-    libpd_list(receiver, static_cast<int>(list.size()), argv);
+
+    return argc;
+}
+
+void Instance::sendList(char const* receiver, std::vector<Atom> const& list) const
+{
+    libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
+
+    auto const argc = fillAtoms(list);
+    libpd_list(receiver, argc, static_cast<t_atom*>(m_atoms));
 }
 
 void Instance::sendMessage(char const* receiver, char const* msg, std::vector<Atom> const& list) const
 {
     libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
-    
-    auto* argv = static_cast<t_atom*>(m_atoms);
 
-    for (size_t i = 0; i < list.size(); ++i) {
-        if (list[i].isFloat())
-            libpd_set_float(argv + i, list[i].getFloat());
-        else
-            libpd_set_symbol(argv + i, list[i].getSymbol().toRawUTF8());
-    }
     auto* obj = gensym(receiver)->s_thing;
-    
-    if(!obj) return;
-    
-    pd_typedmess(gensym(receiver)->s_thing, gensym(msg), static_cast<int>(list.size()), argv);
+    if (!obj)
+        return;
+
+    auto const argc = fillAtoms(list);
+    pd_typedmess(obj, gensym(msg), argc, static_cast<t_atom*>(m_atoms));
 }
 
-void Instance::processMessage(Message mess)
+void Instance::processMessage(MessageQueue::Command const& message)
 {
-    if (mess.destination == "param") {
-        int index = mess.list[0].getFloat();
-        float value = std::clamp(mess.list[1].getFloat(), 0.0f, 1.0f);
+    auto* const destination = message.destination;
+
+    auto getList = [this, &message]() {
+        auto list = std::vector<Atom>(message.numAtoms);
+        auto* argv = message.getAtoms();
+        for (int i = 0; i < message.numAtoms; ++i) {
+            if (argv[i].a_type == A_FLOAT)
+                list[i] = Atom(atom_getfloat(argv + i));
+            else if (argv[i].a_type == A_SYMBOL)
+                list[i] = Atom(symbols.toString(atom_getsymbol(argv + i)));
+        }
+        return list;
+    };
+
+    auto getFloat = [&message](int idx) -> float {
+        return idx < message.numAtoms ? atom_getfloat(message.getAtoms() + idx) : 0.0f;
+    };
+
+    if (destination == knownSymbols.param) {
+        if (message.numAtoms < 2)
+            return;
+        int index = getFloat(0);
+        float value = std::clamp(getFloat(1), 0.0f, 1.0f);
         performParameterChange(0, index - 1, value);
-    } else if (mess.destination == "param_change") {
-        int index = mess.list[0].getFloat();
-        int state = mess.list[1].getFloat() != 0;
+    } else if (destination == knownSymbols.paramChange) {
+        if (message.numAtoms < 2)
+            return;
+        int index = getFloat(0);
+        int state = getFloat(1) != 0;
         performParameterChange(1, index - 1, state);
-    } else if (mess.selector == "bang") {
-        receiveBang(mess.destination);
-    } else if (mess.selector == "float") {
-        receiveFloat(mess.destination, mess.list[0].getFloat());
-    } else if (mess.selector == "symbol") {
-        receiveSymbol(mess.destination, mess.list[0].getSymbol());
-    } else if (mess.selector == "list") {
-        receiveList(mess.destination, mess.list);
-    } else if (mess.selector == "dsp") {
-        receiveDSPState(mess.list[0].getFloat());
-    } else {
-        receiveMessage(mess.destination, mess.selector, mess.list);
-    }
-}
-
-void Instance::processMidiEvent(midievent event)
-{
-    if (event.type == midievent::NOTEON)
-        receiveNoteOn(event.midi1 + 1, event.midi2, event.midi3);
-    else if (event.type == midievent::CONTROLCHANGE)
-        receiveControlChange(event.midi1 + 1, event.midi2, event.midi3);
-    else if (event.type == midievent::PROGRAMCHANGE)
-        receiveProgramChange(event.midi1 + 1, event.midi2);
-    else if (event.type == midievent::PITCHBEND)
-        receivePitchBend(event.midi1 + 1, event.midi2);
-    else if (event.type == midievent::AFTERTOUCH)
-        receiveAftertouch(event.midi1 + 1, event.midi2);
-    else if (event.type == midievent::POLYAFTERTOUCH)
-        receivePolyAftertouch(event.midi1 + 1, event.midi2, event.midi3);
-    else if (event.type == midievent::MIDIBYTE)
-        receiveMidiByte(event.midi1, event.midi2);
-}
-
-void Instance::processSend(dmessage mess)
-{
-    if (mess.object && !mess.list.empty()) {
-        if (mess.selector == "list") {
-            auto* argv = static_cast<t_atom*>(m_atoms);
-            for (size_t i = 0; i < mess.list.size(); ++i) {
-                if (mess.list[i].isFloat())
-                    SETFLOAT(argv + i, mess.list[i].getFloat());
-                else if (mess.list[i].isSymbol()) {
-                    sys_lock();
-                    SETSYMBOL(argv + i, gensym(mess.list[i].getSymbol().toRawUTF8()));
-                    sys_unlock();
-                } else
-                    SETFLOAT(argv + i, 0.0);
-            }
-            sys_lock();
-            pd_list(static_cast<t_pd*>(mess.object), gensym("list"), static_cast<int>(mess.list.size()), argv);
-            sys_unlock();
-        } else if (mess.selector == "float" && mess.list[0].isFloat()) {
-            sys_lock();
-            pd_float(static_cast<t_pd*>(mess.object), mess.list[0].getFloat());
-            sys_unlock();
-        } else if (mess.selector == "symbol") {
-            sys_lock();
-            pd_symbol(static_cast<t_pd*>(mess.object), gensym(mess.list[0].getSymbol().toRawUTF8()));
-            sys_unlock();
+    } else if (destination == knownSymbols.layer) {
+        if (message.type == MessageQueue::Message)
+            performLayerChange(symbols.toString(message.selector), getList());
+    } else if (destination == knownSymbols.compiled) {
+        if (message.type == MessageQueue::Message)
+            performCompiledChange(symbols.toString(message.selector), getList());
+    } else if (destination == knownSymbols.latency) {
+        if (message.type == MessageQueue::Float)
+            performLatencyChange(std::max(0, roundToInt(message.value)));
+    } else if (auto it = messageListeners.find(destination); it != messageListeners.end()) {
+        t_symbol* selector = message.selector;
+        std::vector<Atom> list;
+
+        switch (message.type) {
+        case MessageQueue::Bang:
+            selector = knownSymbols.bang;
+            break;
+        case MessageQueue::Float:
+            selector = knownSymbols.floatSelector;
+            list.emplace_back(message.value);
+            break;
+        case MessageQueue::Symbol:
+            selector = knownSymbols.symbol;
+            list.emplace_back(symbols.toString(message.symbol));
+            break;
+        case MessageQueue::List:
+            selector = knownSymbols.list;
+            list = getList();
+            break;
+        default:
+            list = getList();
+            break;
         }
+
+        it->second.listeners.call([selector, &list](MessageListener& listener) { listener.receiveMessage(selector, list); });
+    } else if (message.type == MessageQueue::Bang) {
+        receiveBang(symbols.toString(destination));
+    } else if (message.type == MessageQueue::Float) {
+        receiveFloat(symbols.toString(destination), message.value);
+    } else if (message.type == MessageQueue::Symbol) {
+        receiveSymbol(symbols.toString(destination), symbols.toString(message.symbol));
+    } else if (message.type == MessageQueue::List) {
+        receiveList(symbols.toString(destination), getList());
+    } else if (message.selector == knownSymbols.dsp) {
+        receiveDSPState(getFloat(0));
     } else {
-        sendMessage(mess.destination.toRawUTF8(), mess.selector.toRawUTF8(), mess.list);
+        receiveMessage(symbols.toString(destination), symbols.toString(message.selector), getList());
     }
 }
 
-void Instance::enqueueFunction(std::function<void(void)> const& fn)
+void Instance::addMessageListener(t_symbol* receiver, MessageListener* listener)
 {
-    // This should be the way to do it, but it currently causes some issues
-    // By calling fn directly we fix these issues at the cost of possible thread unsafety
-    m_function_queue.enqueue(fn);
+    auto& subscription = messageListeners[receiver];
+    subscription.listeners.add(listener);
 
-    // Checks if it can be performed immediately
-    messageEnqueued();
+    if (!subscription.receiver) {
+        libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
+        subscription.receiver = internal::receiver_new(this, receiver->s_name);
+    }
+}
+
+void Instance::removeMessageListener(t_symbol* receiver, MessageListener* listener)
+{
+    auto it = messageListeners.find(receiver);
+    if (it == messageListeners.end())
+        return;
+
+    auto& subscription = it->second;
+    subscription.listeners.remove(listener);
+
+    // The entry stays, a listener that is being called may have removed itself
+    if (subscription.listeners.isEmpty() && subscription.receiver) {
+        libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
+        sys_lock();
+        pd_free(static_cast<t_pd*>(subscription.receiver));
+        sys_unlock();
+        subscription.receiver = nullptr;
+    }
+}
+
+void Instance::setMidiOutput(MidiBus* bus)
+{
+    midiOutput = bus;
+}
+
+void Instance::beginMidiOutput()
+{
+    libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
+    midiOutputStartTime = clock_getlogicaltime();
+}
+
+int Instance::getMidiOutputPosition() const
+{
+    // Messages from clocks go out at the sample they were scheduled at. Outside of a tick this is the end of the last one
+    auto const position = static_cast<int>(clock_gettimesincewithunits(midiOutputStartTime, 1, 1));
+    return std::clamp(position, 0, getBlockSize() - 1);
+}
+
+void Instance::addMidiOutput(int channel, int status, int data1, int data2, int size)
+{
+    if (!midiOutput)
+        return;
+
+    uint8 const data[3] = { static_cast<uint8>(status | (channel & 0x0f)), static_cast<uint8>(data1 & 0x7f), static_cast<uint8>(data2 & 0x7f) };
+    midiOutput->add(channel >> 4, data, size, getMidiOutputPosition());
+}
+
+void Instance::addMidiOutputByte(int port, int byte)
+{
+    if (midiOutput)
+        midiOutput->addByte(port, byte, getMidiOutputPosition());
 }
 
-void Instance::enqueueFunctionAsync(std::function<void(void)> const& fn)
+void Instance::processCommand(CommandQueue::Command const& command)
 {
-    // This should be the way to do it, but it currently causes some issues
-    // By calling fn directly we fix these issues at the cost of possible thread unsafety
-    m_function_queue.enqueue(fn);
+    auto dispatch = [&command](t_pd* target) {
+        switch (command.type) {
+        case CommandQueue::Bang:
+            pd_bang(target);
+            break;
+        case CommandQueue::Float:
+            pd_float(target, command.value);
+            break;
+        case CommandQueue::Symbol:
+            pd_symbol(target, command.symbol);
+            break;
+        case CommandQueue::List:
+            pd_list(target, &s_list, command.numAtoms, command.getAtoms());
+            break;
+        case CommandQueue::Message:
+            pd_typedmess(target, command.selector, command.numAtoms, command.getAtoms());
+            break;
+        default:
+            break;
+        }
+    };
+
+    sys_lock();
+    command.resolveNames();
+    if (command.object) {
+        dispatch(static_cast<t_pd*>(command.object));
+    } else if (command.destination && command.destination->s_thing) {
+        dispatch(command.destination->s_thing);
+    }
+    sys_unlock();
 }
 
+// The names are interned by pd's thread when it dequeues them, the GUI can't call gensym on pd's instance
 void Instance::enqueueMessages(String const& dest, String const& msg, std::vector<Atom>&& list)
 {
-    enqueueFunction([this, dest, msg, list]() mutable { processSend(dmessage { nullptr, dest, msg, std::move(list) }); });
+    enqueueCommand([this, &dest, &msg, &list]() { return m_command_queue.enqueueMessage(nullptr, dest, msg, list); });
+    messageEnqueued();
 }
 
 void Instance::enqueueDirectMessages(void* object, std::vector<Atom> const& list)
 {
-    enqueueFunction([this, object, list]() mutable { processSend(dmessage { object, String(), "list", list }); });
+    if (!object || list.empty())
+        return;
+
+    enqueueCommand([this, object, &list]() { return m_command_queue.enqueueList(object, nullptr, list); });
+    messageEnqueued();
 }
 
 void Instance::enqueueDirectMessages(void* object, String const& msg)
 {
-    enqueueFunction([this, object, msg]() mutable { processSend(dmessage { object, String(), "symbol", std::vector<Atom>(1, msg) }); });
+    if (!object)
+        return;
+
+    enqueueCommand([this, object, &msg]() { return m_command_queue.enqueueSymbol(object, nullptr, msg); });
+    messageEnqueued();
 }
 
 void Instance::enqueueDirectMessages(void* object, float const msg)
 {
-    enqueueFunction([this, object, msg]() mutable { processSend(dmessage { object, String(), "float", std::vector<Atom>(1, msg) }); });
+    if (!object)
+        return;
+
+    enqueueCommand([this, object, msg]() { return m_command_queue.enqueueFloat(object, nullptr, msg); });
+    messageEnqueued();
 }
 
 void Instance::waitForStateUpdate()
 {
     // No action needed
-    if (m_function_queue.size_approx() == 0) {
+    if (m_command_queue.isEmpty()) {
         return;
     }
 
@@ -518,14 +817,94 @@ void Instance::waitForStateUpdate()
     updateWait.wait();
 }
 
+void Instance::dispatchMessages()
+{
+    TRACE_ZONE("dispatchMessages");
+
+    m_message_queue.dequeueAll([this](MessageQueue::Command const& message) {
+        processMessage(message);
+    });
+
+    // Whatever the functions that pd already ran captured is freed here, rather than on the audio thread
+    m_command_queue.releaseFinished();
+    m_message_queue.releaseFinished();
+}
+
+void Instance::canvasEventsAvailable()
+{
+    m_canvas_events_pending = false;
+
+    std::pair<uint64, CanvasEvent> event;
+    while (m_canvas_events.try_dequeue(event)) { }
+}
+
+void Instance::dequeueCanvasEvents(std::vector<CanvasEvent>& events)
+{
+    // Cleared first, so an event that arrives while draining triggers a new notification
+    m_canvas_events_pending = false;
+
+    std::vector<std::pair<uint64, CanvasEvent>> numbered;
+
+    std::pair<uint64, CanvasEvent> event;
+    while (m_canvas_events.try_dequeue(event)) {
+        numbered.push_back(event);
+    }
+
+    std::sort(numbered.begin(), numbered.end(), [](auto const& a, auto const& b) { return a.first < b.first; });
+
+    for (auto const& [order, canvasEvent] : numbered) {
+        events.push_back(canvasEvent);
+    }
+}
+
+void Instance::collectDirtyObjects(std::unordered_set<void*>& objects)
+{
+    void* object;
+    while (m_dirty_objects.try_dequeue(object)) {
+        objects.insert(object);
+    }
+}
+
+void Instance::setDSPProfiling(bool enabled)
+{
+    setThis();
+
+    // The profiler measures every object on its own, so nothing is fused while it runs
+    libpd_fuse_enable(!enabled);
+    libpd_profiler_enable(enabled);
+    dspProfiling = enabled;
+}
+
+void Instance::collectDSPLoad(std::unordered_map<void*, float>& load)
+{
+    if (!dspProfiling)
+        return;
+
+    profiledRoutines.clear();
+
+    setThis();
+    libpd_profiler_collect([](void* data, void* owner, float routineLoad) {
+        static_cast<std::vector<std::pair<void*, float>>*>(data)->emplace_back(owner, routineLoad);
+    }, &profiledRoutines);
+
+    // Objects with more than one perform routine are reported once for every routine
+    for (auto const& [owner, routineLoad] : profiledRoutines) {
+        load[owner] += routineLoad;
+    }
+}
+
 void Instance::sendMessagesFromQueue()
 {
+    TRACE_ZONE("sendMessagesFromQueue");
     libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
 
-    std::function<void(void)> callback;
-    while (m_function_queue.try_dequeue(callback)) {
-        callback();
-    }
+    auto const start = Time::getHighResolutionTicks();
+
+    m_command_queue.dequeueAll([this](CommandQueue::Command const& command) {
+        processCommand(command);
+    });
+
+    audioStats.recordQueueTime(Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start));
 }
 
 String Instance::getExtraInfo(File const& toOpen)
@@ -542,6 +921,10 @@ Patch Instance::openPatch(File const& toOpen)
 {
     t_canvas* cnv = nullptr;
 
+    // Externals from installed libraries are loaded in parallel first, instead of one by one while pd creates the objects
+    if (auto* libraryPaths = LibraryPaths::getInstanceWithoutCreating())
+        libraryPaths->preloadExternals(toOpen);
+
     bool done = false;
     enqueueFunction(
         [this, toOpen, &cnv, &done]() mutable {
@@ -553,7 +936,13 @@ Patch Instance::openPatch(File const& toOpen)
 
             setThis();
 
-            cnv = static_cast<t_canvas*>(libpd_create_canvas(file, dir));
+            // Mapped instead of read, so large saved arrays aren't copied before pd parses them
+            MemoryMappedFile mappedFile(toOpen, MemoryMappedFile::readOnly);
+            if (mappedFile.getData()) {
+                cnv = static_cast<t_canvas*>(libpd_create_canvas_from_memory(file, dir, static_cast<char const*>(mappedFile.getData()), mappedFile.getSize()));
+            } else {
+                cnv = static_cast<t_canvas*>(libpd_create_canvas(file, dir));
+            }
             done = true;
         });
 
@@ -566,6 +955,32 @@ Patch Instance::openPatch(File const& toOpen)
     return patch;
 }
 
+Patch Instance::openPatch(MemoryBlock const& binaryContent)
+{
+    t_canvas* cnv = nullptr;
+
+    // Named like the temporary files that text content is opened from, so abstractions are found the same way
+    auto location = File::createTempFile(".pd");
+
+    bool done = false;
+    enqueueFunction(
+        [this, &binaryContent, &location, &cnv, &done]() mutable {
+            String dirname = location.getParentDirectory().getFullPathName();
+            String filename = location.getFileName();
+
+            setThis();
+
+            cnv = static_cast<t_canvas*>(libpd_create_canvas_from_binary(filename.toRawUTF8(), dirname.toRawUTF8(), static_cast<char const*>(binaryContent.getData()), binaryContent.getSize()));
+            done = true;
+        });
+
+    while (!done) {
+        waitForStateUpdate();
+    }
+
+    return Patch(cnv, this, File());
+}
+
 void Instance::setThis()
 {
     libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
@@ -581,14 +996,9 @@ void Instance::logError(String const& error)
     consoleHandler.logError(error);
 }
 
-std::deque<std::tuple<String, int, int>>& Instance::getConsoleMessages()
-{
-    return consoleHandler.consoleMessages;
-}
-
-std::deque<std::tuple<String, int, int>>& Instance::getConsoleHistory()
+ConsoleLog& Instance::getConsoleLog()
 {
-    return consoleHandler.consoleHistory;
+    return consoleHandler.consoleLog;
 }
 
 void Instance::createPanel(int type, char const* snd, char const* location)
@@ -9,6 +9,8 @@
 #include <JuceHeader.h>
 
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 
 extern "C" {
@@ -17,6 +19,15 @@ extern "C" {
 }
 
 #include "PdPatch.h"
+#include "PdCompiledPatch.h"
+#include "PdAudioStats.h"
+#include "PdCommandQueue.h"
+#include "PdConsoleLog.h"
+#include "PdConsoleRing.h"
+#include "PdMidiBus.h"
+#include "PdSymbolCache.h"
+#include "PdContinuityChecker.h"
+#include "PdWorkerPool.h"
 #include "concurrentqueue.h"
 #include "../Utility/FastStringWidth.h"
 
@@ -100,169 +111,43 @@ private:
     String symbol;
 };
 
-struct ContinuityChecker : public Timer {
-
-    struct BackupTimer : public HighResolutionTimer {
-        t_pdinstance* pd;
-
-        std::atomic<bool>& hasTicked;
-
-        std::vector<t_float> emptyInBuffer;
-        std::vector<t_float> emptyOutBuffer;
-
-        std::function<void(t_float*, t_float*)> callback;
-
-        int numBlocksPerCallback;
-        int intervalMs;
-
-        BackupTimer(std::atomic<bool>& ticked)
-            : hasTicked(ticked)
-        {
-        }
-
-        void prepare(int samplesPerBlock, int schedulerInterval, int numChannels)
-        {
-            pd = pd_this;
-
-            numBlocksPerCallback = samplesPerBlock / libpd_blocksize();
-            intervalMs = schedulerInterval;
-
-            emptyInBuffer.resize(numChannels * samplesPerBlock);
-            emptyOutBuffer.resize(numChannels * samplesPerBlock);
-        }
-
-        void startScheduler()
-        {
-            if (isTimerRunning())
-                return;
-
-                // startTimer(intervalMs);
-#if JUCE_DEBUG
-                // std::cout << "backup scheduler started" << std::endl;
-#endif
-        }
-
-        void stopScheduler()
-        {
-            if (!isTimerRunning())
-                return;
-
-                // stopTimer();
-
-#if JUCE_DEBUG
-                // std::cout << "backup scheduler stopped" << std::endl;
-#endif
-        }
-
-        void hiResTimerCallback() override
-        {
-            if (hasTicked) {
-                stopScheduler();
-                return;
-            }
-
-            for (int i = 0; i < numBlocksPerCallback; i++) {
-                std::fill(emptyInBuffer.begin(), emptyInBuffer.end(), 0.0f);
-
-                callback(emptyInBuffer.data(), emptyOutBuffer.data());
-
-                std::fill(emptyOutBuffer.begin(), emptyOutBuffer.end(), 0.0f);
-            }
-        }
-    };
-
-    ContinuityChecker()
-        : backupTimer(hasTicked) {};
-
-    void setCallback(std::function<void(t_float*, t_float*)> cb)
-    {
-        backupTimer.callback = std::move(cb);
-    }
-
-    void prepare(double sampleRate, int samplesPerBlock, int numChannels)
-    {
-        timePerBlock = std::round((samplesPerBlock / sampleRate) * 1000.0);
-
-        backupTimer.prepare(samplesPerBlock, timePerBlock, numChannels);
-
-        startTimer(timePerBlock);
-    }
-
-    void setTimer()
-    {
-        lastTime = Time::getCurrentTime().getMillisecondCounterHiRes();
-        hasTicked = true;
-    }
-
-    void setNonRealtime(bool nonRealtime)
-    {
-        isNonRealtime = nonRealtime;
-        if (isNonRealtime)
-            backupTimer.stopScheduler();
-    }
-
-    void timerCallback() override
-    {
-        int timePassed = Time::getCurrentTime().getMillisecondCounterHiRes() - lastTime;
-
-        // Scheduler
-        if (timePassed > 2 * timePerBlock && !hasTicked && !isNonRealtime) {
-            backupTimer.startScheduler();
-        }
-
-        hasTicked = false;
-    }
-
-    t_pdinstance* pd;
-
-    std::atomic<double> lastTime;
-    std::atomic<bool> hasTicked;
-
-    std::atomic<bool> isNonRealtime = false;
-    int timePerBlock;
+// Gets what pd sends to a receiver name, see Instance::addMessageListener
+class MessageListener {
+public:
+    virtual ~MessageListener() = default;
 
-    BackupTimer backupTimer;
+    // The selector is bang, float, symbol or list for those, the atoms are what came with it
+    virtual void receiveMessage(t_symbol* selector, std::vector<Atom> const& atoms) = 0;
 };
 
 class Instance {
-    struct Message {
-        String selector;
-        String destination;
-        std::vector<pd::Atom> list;
-    };
-
-    struct dmessage {
-        void* object;
-        String destination;
-        String selector;
-        std::vector<pd::Atom> list;
-    };
-
-    typedef struct midievent {
-        enum {
-            NOTEON,
-            CONTROLCHANGE,
-            PROGRAMCHANGE,
-            PITCHBEND,
-            AFTERTOUCH,
-            POLYAFTERTOUCH,
-            MIDIBYTE
-        } type;
-        int midi1;
-        int midi2;
-        int midi3;
-    } midievent;
-
 public:
     Instance(String const& symbol);
     Instance(Instance const& other) = delete;
     virtual ~Instance();
 
+    // When DSP is running with the same channels and sample rate, the compiled DSP chain is kept,
+    // and the next startDSP does nothing. pd's block size is fixed, so the host's doesn't matter
     void prepareDSP(int const nins, int const nouts, double const samplerate, int const blockSize);
     void startDSP();
     void releaseDSP();
     void performDSP(float const* inputs, float* outputs);
+    // With direct, the output isn't delayed by a tick, see libpd_process_channels_direct
+    void performDSP(float const** inputs, int numInputs, float** outputs, int numOutputs, int offset, bool direct = false);
+    void setPendingOutput(float const* buffer);
+    void getPendingOutput(float* buffer);
+
+    // The block that performDSP(inputs, outputs) processes, some of pd's ticks in a row
+    //! @details The messages, playhead, midi and parameters are sent once per block, so fewer of them
+    //! cost less when latency doesn't matter. Only change it while the audio thread can't process
     int getBlockSize() const;
+    int getTicksPerBlock() const;
+    void setTicksPerBlock(int ticks);
+
+    // A patch that was exported and built processes the audio in place of pd's DSP chain, pd still runs its messages and clocks
+    //! @details Only performDSP(inputs, outputs) uses it. Only change it while the audio thread can't process
+    void setCompiledPatch(std::unique_ptr<CompiledPatch> patch);
+    CompiledPatch* getCompiledPatch() const;
 
     void sendNoteOn(int const channel, int const pitch, int const velocity) const;
     void sendControlChange(int const channel, int const controller, int const value) const;
@@ -274,30 +159,77 @@ public:
     void sendSysRealTime(int const port, int const byte) const;
     void sendMidiByte(int const port, int const byte) const;
 
-    virtual void receiveNoteOn(int const channel, int const pitch, int const velocity)
+    // Sends a whole buffer or byte stream, taking pd's lock only once
+    void sendMidiEvents(MidiBuffer const& buffer, int const port = 0) const;
+    void sendMidiBytes(int const port, uint8 const* data, int const size) const;
+
+    // Sends every port of the bus to the same port in pd, one port after the other
+    void sendMidiEvents(MidiBus const& bus) const;
+
+    // pd's midi output is added to this bus as pd sends it, on the port pd sends it to
+    // Call beginMidiOutput at the start of every tick, the events are positioned by their logical time in the tick
+    void setMidiOutput(MidiBus* bus);
+    void beginMidiOutput();
+
+    virtual void receiveGuiUpdate(int type) {};
+    virtual void synchroniseCanvas(void* cnv) {};
+
+    // Called once on pd's thread when canvas events become available after the queue was drained
+    // Instances without an editor don't need them, so by default they are dropped
+    virtual void canvasEventsAvailable();
+
+    // Moves all canvas events that were received so far into events, in the order they happened
+    void dequeueCanvasEvents(std::vector<CanvasEvent>& events);
+
+    // Called after the canvases have handled numEvents dequeued events
+    void canvasEventsApplied(size_t numEvents)
     {
+        m_canvas_events_applied += numEvents;
     }
-    virtual void receiveControlChange(int const channel, int const controller, int const value)
+
+    // True if every structural change pd made so far has been handled by the canvases
+    bool isGuiInSync() const
     {
+        return m_canvas_events_applied.load() == m_canvas_event_count.load();
     }
-    virtual void receiveProgramChange(int const channel, int const value)
+
+    // The GUI doesn't follow along while the host renders offline
+    void setRenderingOffline(bool offline)
     {
+        renderingOffline = offline;
     }
-    virtual void receivePitchBend(int const channel, int const value)
+
+    bool isRenderingOffline() const
     {
+        return renderingOffline;
     }
-    virtual void receiveAftertouch(int const channel, int const value)
+
+    // Without an editor, nothing is prepared for it: redraws aren't collected, messages for the
+    // editor are dropped and console messages aren't measured. The editor reads everything anew when it's opened
+    void setHeadless(bool shouldBeHeadless)
     {
+        headless = shouldBeHeadless;
+        if (!shouldBeHeadless)
+            consoleHandler.measureMessages();
     }
-    virtual void receivePolyAftertouch(int const channel, int const pitch, int const value)
+
+    bool isHeadless() const
     {
+        return headless;
     }
-    virtual void receiveMidiByte(int const port, int const byte)
+
+    // Adds the objects that asked pd for a redraw since the last call
+    void collectDirtyObjects(std::unordered_set<void*>& objects);
+
+    // Opt-in profiling of the perform routines, which costs two clock reads per routine while it's on
+    void setDSPProfiling(bool enabled);
+    bool isProfilingDSP() const
     {
+        return dspProfiling;
     }
 
-    virtual void receiveGuiUpdate(int type) {};
-    virtual void synchroniseCanvas(void* cnv) {};
+    // Adds the share of the block time that each object used since the last call
+    void collectDSPLoad(std::unordered_map<void*, float>& load);
 
     virtual void createPanel(int type, char const* snd, char const* location);
 
@@ -309,6 +241,13 @@ public:
 
     virtual void receivePrint(String const& message) {};
 
+    // Calls listener on the message thread with everything pd sends to receiver, from the next tick on
+    //! @details Messages are routed by the pointer of the symbol, so nothing is compared by name, and
+    //! what goes to a receiver with listeners doesn't reach the receive functions below. Only use it from
+    //! the message thread, and not for the receivers of the instance itself, like "pd" or "param".
+    void addMessageListener(t_symbol* receiver, MessageListener* listener);
+    void removeMessageListener(t_symbol* receiver, MessageListener* listener);
+
     virtual void receiveBang(String const& dest)
     {
     }
@@ -331,8 +270,24 @@ public:
 
     virtual void titleChanged() {};
 
-    void enqueueFunction(std::function<void(void)> const& fn);
-    void enqueueFunctionAsync(std::function<void(void)> const& fn);
+    template<typename Callable>
+    void enqueueFunction(Callable&& fn)
+    {
+        enqueueCommand([this, &fn]() { return m_command_queue.enqueueFunction(std::forward<Callable>(fn)); });
+
+        // Checks if it can be performed immediately
+        messageEnqueued();
+    }
+
+    // Doesn't try to dequeue, so this can be used from pd's thread
+    template<typename Callable>
+    void enqueueFunctionAsync(Callable&& fn)
+    {
+        if (!m_command_queue.enqueueFunction(std::forward<Callable>(fn))) {
+            // Command queue is full, the function will be dropped
+            jassertfalse;
+        }
+    }
 
     void enqueueMessages(String const& dest, String const& msg, std::vector<pd::Atom>&& list);
 
@@ -341,23 +296,47 @@ public:
     void enqueueDirectMessages(void* object, float const msg);
 
     virtual void performParameterChange(int type, int idx, float value) {};
+    virtual void performLayerChange(String const& action, std::vector<pd::Atom> const& args) {};
+    virtual void performCompiledChange(String const& action, std::vector<pd::Atom> const& args) {};
+
+    // Latency the patch adds, in samples at pd's sample rate, sent to [r latency]
+    virtual void performLatencyChange(int samples) {};
 
     void logMessage(String const& message);
     void logError(String const& message);
 
-    std::deque<std::tuple<String, int, int>>& getConsoleMessages();
-    std::deque<std::tuple<String, int, int>>& getConsoleHistory();
+    ConsoleLog& getConsoleLog();
 
     virtual void messageEnqueued() {};
 
     void sendMessagesFromQueue();
-    void processMessage(Message mess);
-    void processMidiEvent(midievent event);
-    void processSend(dmessage mess);
+    void dispatchMessages();
+
+    // Traffic from the GUI to pd and back, for the queue monitor
+    CommandQueue::Statistics const& getCommandQueueStatistics() const
+    {
+        return m_command_queue.getStatistics();
+    }
+
+    MessageQueue::Statistics const& getMessageQueueStatistics() const
+    {
+        return m_message_queue.getStatistics();
+    }
+
+    void resetQueueStatistics()
+    {
+        m_command_queue.resetStatistics();
+        m_message_queue.resetStatistics();
+    }
+    void processMessage(MessageQueue::Command const& message);
+    void processCommand(CommandQueue::Command const& command);
 
     String getExtraInfo(File const& toOpen);
     Patch openPatch(File const& toOpen);
 
+    // Opens a patch from the content of Patch::getCanvasBinary, as an untitled patch
+    Patch openPatch(MemoryBlock const& binaryContent);
+
     virtual Colour getForegroundColour() = 0;
     virtual Colour getBackgroundColour() = 0;
     virtual Colour getTextColour() = 0;
@@ -367,27 +346,136 @@ public:
 
     void waitForStateUpdate();
 
-    virtual CriticalSection const* getCallbackLock()
+    // Without blocking, co_await it from a coroutine on the message thread to call fn on pd's thread
+    // The coroutine continues on the message thread with the result of fn. Defined in PdAsync.h
+    template<typename Callable>
+    auto onPdThread(Callable&& fn);
+
+    virtual CallbackLock const* getCallbackLock()
     {
         return nullptr;
     };
 
+    // Block load, lock and queue times, see AudioStats
+    AudioStats audioStats;
+
+    // Use this to turn the instance's symbols into Strings and back
+    SymbolCache symbols;
+
     void* m_instance = nullptr;
     void* m_patch = nullptr;
     void* m_atoms = nullptr;
     void* m_message_receiver = nullptr;
     void* m_parameter_receiver = nullptr;
     void* m_parameter_change_receiver = nullptr;
+    void* m_layer_receiver = nullptr;
+    void* m_latency_receiver = nullptr;
+    void* m_compiled_receiver = nullptr;
     void* m_midi_receiver = nullptr;
     void* m_print_receiver = nullptr;
 
     std::atomic<bool> canUndo = false;
     std::atomic<bool> canRedo = false;
+    std::atomic<bool> renderingOffline = false;
+    std::atomic<bool> headless = true;
 
     inline static const String defaultPatch = "#N canvas 827 239 527 327 12;";
 
 private:
-    moodycamel::ConcurrentQueue<std::function<void(void)>> m_function_queue = moodycamel::ConcurrentQueue<std::function<void(void)>>(4096);
+    // Retries when the queue is full, which only happens if the audio thread can't keep up
+    template<typename Enqueuer>
+    void enqueueCommand(Enqueuer&& enqueue)
+    {
+        for (int attempt = 0; !enqueue(); attempt++) {
+            if (attempt == maxEnqueueAttempts) {
+                jassertfalse;
+                return;
+            }
+
+            messageEnqueued();
+            m_command_queue.releaseFinished();
+            Thread::yield();
+        }
+    }
+
+    // Called from pd's thread, so we can't wait for the queue to drain
+    template<typename Enqueuer>
+    void enqueueOutgoing(Enqueuer&& enqueue)
+    {
+        if (!enqueue()) {
+            // Outgoing message queue is full, the message will be dropped
+            jassertfalse;
+        }
+    }
+
+    static constexpr int maxEnqueueAttempts = 1000;
+
+    // Size of m_atoms, longer lists are cut off by sendList and sendMessage
+    static constexpr int maxAtoms = 512;
+
+    // Fills m_atoms with list, returns the number of atoms
+    int fillAtoms(std::vector<Atom> const& list) const;
+
+    CommandQueue m_command_queue;
+
+    // Messages from pd's receivers to the GUI, drained by the message thread
+    MessageQueue m_message_queue;
+
+    // Structural changes to canvases, drained by the message thread
+    // The queue only keeps the order per producer, so events are numbered
+    moodycamel::ConcurrentQueue<std::pair<uint64, CanvasEvent>> m_canvas_events;
+    std::atomic<uint64> m_canvas_event_count = 0;
+    std::atomic<uint64> m_canvas_events_applied = 0;
+    std::atomic<bool> m_canvas_events_pending = false;
+
+    // Objects that queued a redraw, so only those have to update
+    moodycamel::ConcurrentQueue<void*> m_dirty_objects;
+
+    std::atomic<bool> dspProfiling = false;
+
+    // Symbols that messages are routed by, from this instance
+    struct KnownSymbols {
+        t_symbol* pd = nullptr;
+        t_symbol* param = nullptr;
+        t_symbol* paramChange = nullptr;
+        t_symbol* layer = nullptr;
+        t_symbol* latency = nullptr;
+        t_symbol* compiled = nullptr;
+        t_symbol* dsp = nullptr;
+        t_symbol* bang = nullptr;
+        t_symbol* floatSelector = nullptr;
+        t_symbol* symbol = nullptr;
+        t_symbol* list = nullptr;
+    };
+
+    KnownSymbols knownSymbols;
+
+    // The receiver bound for each name with listeners, only used on the message thread
+    struct MessageSubscription {
+        void* receiver = nullptr;
+        ListenerList<MessageListener> listeners;
+    };
+
+    std::unordered_map<t_symbol*, MessageSubscription> messageListeners;
+
+    // Filled while holding pd's lock, so it's only merged into the result afterwards
+    std::vector<std::pair<void*, float>> profiledRoutines;
+
+    // Adds a message from pd's midi hooks, the channel counts up through the ports like in pd
+    void addMidiOutput(int channel, int status, int data1, int data2, int size);
+    void addMidiOutputByte(int port, int byte);
+    int getMidiOutputPosition() const;
+
+    MidiBus* midiOutput = nullptr;
+
+    // Logical time at the start of the current tick
+    double midiOutputStartTime = 0.0;
+
+protected:
+    // Runs the copies of [clone -parallel] objects, shared by all instances
+    SharedResourcePointer<WorkerPool> workerPool;
+
+private:
 
     std::unique_ptr<FileChooser> saveChooser;
     std::unique_ptr<FileChooser> openChooser;
@@ -397,98 +485,182 @@ private:
 protected:
     ContinuityChecker continuityChecker;
 
+    // What the DSP chain was last prepared for, see prepareDSP
+    struct DSPConfiguration {
+        int numInputs = -1;
+        int numOutputs = -1;
+        double sampleRate = 0.0;
+
+        bool operator==(DSPConfiguration const&) const = default;
+    };
+
+    DSPConfiguration dspConfiguration;
+    bool keepDSPChain = false;
+
+    int ticksPerBlock = 1;
+
+    std::unique_ptr<CompiledPatch> compiledPatch;
+
+    // Seconds it took to create the pd instance and set up the libraries
+    double constructionTime = 0.0;
+
     struct internal;
 
+    struct MessageDispatcher : public Timer {
+        Instance* instance;
+
+        MessageDispatcher(Instance* parent)
+            : instance(parent)
+        {
+            startTimerHz(60);
+        }
+
+        void timerCallback() override
+        {
+            instance->dispatchMessages();
+        }
+    };
+
+    MessageDispatcher messageDispatcher;
+
     struct ConsoleHandler : public Timer {
         Instance* instance;
 
+        static constexpr int maxMessages = 100000;
+
         ConsoleHandler(Instance* parent)
             : instance(parent)
             , fastStringWidth(Font(14))
         {
+            // Polling, so that printing never has to start a timer from the audio thread
+            startTimer(20);
         }
 
         void timerCallback() override
         {
-            auto item = std::pair<String, bool>();
-            while (pendingMessages.try_dequeue(item)) {
-                auto& [message, type] = item;
-                consoleMessages.emplace_back(message, type, fastStringWidth.getStringWidth(message) + 12);
+            // The lines are still read, so the ring doesn't overflow, but the console is only redrawn afterwards
+            bool const deferUpdate = instance->isRenderingOffline() || instance->isHeadless();
+            if (ring.isEmpty()) {
+                if (updatePending && !deferUpdate) {
+                    updatePending = false;
+                    instance->updateConsole();
+                }
+                return;
+            }
+
+            ring.readAll([this](char const* text, int length, int type, int repeats) {
+                if (type == printType)
+                    classifyPrint(text, length, type);
+
+                auto message = String::fromUTF8(text, length);
 
-                if (consoleMessages.size() > 800)
-                    consoleMessages.pop_front();
+                // The ring only collapses lines that haven't been read yet, the log collapses the rest
+                if (auto* line = consoleLog.add(message, type, repeats))
+                    line->width = measure(message);
+            });
+
+            if (auto const numDropped = ring.getNumDropped()) {
+                auto const warning = String(numDropped) + " console messages were dropped";
+                if (auto* line = consoleLog.add(warning, 1, 1))
+                    line->width = measure(warning);
             }
 
-            // Check if any item got assigned
-            if (std::get<0>(item).isNotEmpty()) {
+            updatePending = deferUpdate;
+            if (!deferUpdate)
                 instance->updateConsole();
-            }
+        }
+
+        // Messages that arrive without an editor get a width of 0, they're measured when it opens
+        int measure(String const& message)
+        {
+            return instance->isHeadless() ? 0 : fastStringWidth.getStringWidth(message) + 12;
+        }
 
-            stopTimer();
+        void measureMessages()
+        {
+            for (auto number = consoleLog.getOldest(); number < consoleLog.getEnd(); number++) {
+                auto& line = consoleLog[number];
+                if (line.width == 0)
+                    line.width = fastStringWidth.getStringWidth(line.text) + 12;
+            }
         }
 
         void logMessage(String const& message)
         {
-            pendingMessages.enqueue({ message, false });
-            startTimer(10);
+            ring.write(message.toRawUTF8(), static_cast<int>(message.getNumBytesAsUTF8()), 0);
         }
 
         void logError(String const& error)
         {
-            pendingMessages.enqueue({ error, 1 });
-            startTimer(10);
+            ring.write(error.toRawUTF8(), static_cast<int>(error.getNumBytesAsUTF8()), 1);
         }
 
+        // Sorts a line printed by pd into messages and errors, on the message thread
+        //! @details Lines in the ring aren't null-terminated, so prefixes are only compared within length
+        static void classifyPrint(char const*& text, int& length, int& type)
+        {
+            auto startsWith = [&](char const* prefix) {
+                auto const prefixLength = static_cast<int>(strlen(prefix));
+                return length >= prefixLength && std::memcmp(text, prefix, static_cast<size_t>(prefixLength)) == 0;
+            };
+
+            auto skip = [&](int numChars) {
+                numChars = std::min(length, numChars);
+                text += numChars;
+                length -= numChars;
+            };
+
+            type = 0;
+            if (startsWith("error:")) {
+                skip(7);
+                type = 1;
+            } else if (startsWith("verbose(4):")) {
+                skip(12);
+                type = 1;
+            }
+        }
+
+        // Collects the pieces pd prints into lines, only copies bytes so that it's safe on the audio thread
         void processPrint(char const* message)
         {
-            std::function<void(String)> forwardMessage =
-                [this](String message) {
-                    if (message.startsWith("error:")) {
-
-                        logError(message.substring(7));
-                    } else if (message.startsWith("verbose(4):")) {
-                        logError(message.substring(12));
-                    } else {
-                        logMessage(message);
-                    }
-                };
-
-            static int length = 0;
-            printConcatBuffer[length] = '\0';
-
-            int len = (int)strlen(message);
-            while (length + len >= 2048) {
-                int d = 2048 - 1 - length;
-                strncat(printConcatBuffer, message, d);
+            auto& length = printConcatLength;
+            auto len = static_cast<int>(strlen(message));
+
+            while (length + len >= printBufferSize) {
+                auto const d = printBufferSize - 1 - length;
+                std::memcpy(printConcatBuffer + length, message, static_cast<size_t>(d));
 
                 // Send concatenated line to PlugData!
-                forwardMessage(String::fromUTF8(printConcatBuffer));
+                ring.write(printConcatBuffer, printBufferSize - 1, printType);
 
                 message += d;
                 len -= d;
                 length = 0;
-                printConcatBuffer[0] = '\0';
             }
 
-            strncat(printConcatBuffer, message, len);
+            std::memcpy(printConcatBuffer + length, message, static_cast<size_t>(len));
             length += len;
 
             if (length > 0 && printConcatBuffer[length - 1] == '\n') {
-                printConcatBuffer[length - 1] = '\0';
-
                 // Send concatenated line to PlugData!
-                forwardMessage(String::fromUTF8(printConcatBuffer));
+                ring.write(printConcatBuffer, length - 1, printType);
 
                 length = 0;
             }
         }
 
-        std::deque<std::tuple<String, int, int>> consoleMessages;
-        std::deque<std::tuple<String, int, int>> consoleHistory;
+        ConsoleLog consoleLog { maxMessages };
+
+        // Lines from pd's print hook, these are classified when they are read from the ring
+        static constexpr int printType = 2;
+        static constexpr int printBufferSize = 2048;
+
+        char printConcatBuffer[printBufferSize];
+        int printConcatLength = 0;
 
-        char printConcatBuffer[2048];
+        bool updatePending = false;
 
-        moodycamel::ConcurrentQueue<std::pair<String, bool>> pendingMessages;
+        ConsoleRing ring;
 
         FastStringWidth fastStringWidth; // For formatting console messages more quickly
     };
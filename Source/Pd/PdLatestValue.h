@@ -0,0 +1,129 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "PdInstance.h"
+
+namespace pd {
+
+// A value that the GUI keeps sending to pd while only the newest one matters, like while dragging
+//! @details set() can be called for every mouse event. A value only goes into the command queue when
+//! the one before it has been sent, and pd sends whatever is newest when it gets there, so there is
+//! at most one send per tick however fast the mouse events come. With a rate limit, sends are also at
+//! least that far apart, the last value is sent once the time is up.
+//! The send function is called on pd's thread, after the LatestValue may have been deleted, so it
+//! shouldn't use the component it belongs to. Everything else is for the message thread.
+template<typename T>
+class LatestValue : private Timer {
+public:
+    using Sender = std::function<void(T&)>;
+
+    LatestValue(Instance* instance, Sender sender, int rateLimitMs = 0)
+        : pd(instance)
+        , slot(std::make_shared<Slot>())
+        , rateLimit(rateLimitMs)
+    {
+        slot->send = std::move(sender);
+    }
+
+    ~LatestValue() override
+    {
+        // A value that was held back by the rate limit still has to get there
+        if (isTimerRunning())
+            enqueue();
+    }
+
+    // Minimum time between two sends, 0 to send once per tick
+    void setRateLimit(int ms)
+    {
+        rateLimit = ms;
+    }
+
+    void set(T newValue)
+    {
+        {
+            SpinLock::ScopedLockType lock(slot->lock);
+            slot->value = std::move(newValue);
+            slot->hasValue = true;
+        }
+
+        if (isTimerRunning())
+            return;
+
+        auto const elapsed = static_cast<int>(Time::getMillisecondCounter() - lastSent);
+        if (rateLimit > 0 && elapsed < rateLimit) {
+            startTimer(rateLimit - elapsed);
+            return;
+        }
+
+        enqueue();
+    }
+
+    // Sends a value that the rate limit is holding back right away
+    // Call it before anything that has to arrive after the value, like the end of a drag
+    void flush()
+    {
+        if (isTimerRunning()) {
+            stopTimer();
+            enqueue();
+        }
+    }
+
+private:
+    struct Slot {
+        SpinLock lock;
+        T value {};
+        bool hasValue = false;
+        std::atomic<bool> queued = false;
+        Sender send;
+    };
+
+    void timerCallback() override
+    {
+        stopTimer();
+        enqueue();
+    }
+
+    void enqueue()
+    {
+        lastSent = Time::getMillisecondCounter();
+
+        // The send that is already waiting will pick up the new value
+        if (slot->queued.exchange(true))
+            return;
+
+        pd->enqueueFunction([slot = slot]() {
+            // Cleared first, so a value set from here on is queued again instead of getting lost
+            slot->queued = false;
+
+            T value;
+            {
+                SpinLock::ScopedLockType lock(slot->lock);
+                if (!slot->hasValue)
+                    return;
+
+                value = std::move(slot->value);
+                slot->hasValue = false;
+            }
+
+            slot->send(value);
+        });
+    }
+
+    Instance* pd;
+    std::shared_ptr<Slot> slot;
+    int rateLimit;
+    uint32 lastSent = 0;
+};
+
+}
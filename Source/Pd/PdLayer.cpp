@@ -0,0 +1,180 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "PdLayer.h"
+
+namespace pd {
+
+Layer::Layer(Instance& parent, File const& toOpen)
+    : Instance(toOpen.getFileNameWithoutExtension())
+    , owner(parent)
+    , file(toOpen)
+{
+    // Not processed yet, so messageEnqueued performs the commands right away
+    auto opened = openPatch(file);
+
+    if (opened.getPointer()) {
+        patch = std::make_unique<Patch>(opened);
+    }
+}
+
+Layer::~Layer()
+{
+    if (patch) {
+        setThis();
+        patch->close();
+    }
+}
+
+bool Layer::isLoaded() const
+{
+    return patch != nullptr;
+}
+
+File const& Layer::getFile() const
+{
+    return file;
+}
+
+void Layer::prepare(int numIns, int numOuts, double sampleRate, int blockSize)
+{
+    prepareDSP(numIns, numOuts, sampleRate, blockSize);
+    output.assign(static_cast<size_t>(std::max(numOuts, 2) * getBlockSize()), 0.0f);
+    startDSP();
+}
+
+void Layer::setActive(bool shouldBeActive)
+{
+    active = shouldBeActive;
+}
+
+void Layer::setPaused(bool shouldBePaused)
+{
+    paused = shouldBePaused;
+}
+
+bool Layer::isPaused() const
+{
+    return paused;
+}
+
+void Layer::process(float const* input)
+{
+    sendMessagesFromQueue();
+
+    if (paused) {
+        if (!outputCleared) {
+            std::fill(output.begin(), output.end(), 0.0f);
+            outputCleared = true;
+        }
+        return;
+    }
+
+    outputCleared = false;
+    performDSP(input, output.data());
+
+    if (gain != 1.0f || gainTarget != 1.0f)
+        applyFade();
+}
+
+void Layer::fadeTo(bool audible, int numSamples)
+{
+    gainTarget = audible ? 1.0f : 0.0f;
+
+    if (audible)
+        paused = false;
+
+    if (numSamples <= 0) {
+        gain = gainTarget;
+        gainStep = 0.0f;
+        if (!audible)
+            paused = true;
+        return;
+    }
+
+    gainStep = (gainTarget - gain) / static_cast<float>(numSamples);
+}
+
+void Layer::applyFade()
+{
+    auto const blockSize = getBlockSize();
+    auto const numChannels = static_cast<int>(output.size()) / blockSize;
+    auto endGain = gain;
+
+    for (int ch = 0; ch < numChannels; ch++) {
+        auto* samples = output.data() + ch * blockSize;
+        auto channelGain = gain;
+
+        for (int i = 0; i < blockSize; i++) {
+            channelGain = gainStep > 0.0f ? std::min(channelGain + gainStep, gainTarget) : std::max(channelGain + gainStep, gainTarget);
+            samples[i] *= channelGain;
+        }
+
+        endGain = channelGain;
+    }
+
+    gain = endGain;
+
+    // The output of this block already faded to silence
+    if (gain == 0.0f && gainTarget == 0.0f)
+        paused = true;
+}
+
+float const* Layer::getOutput() const
+{
+    return output.data();
+}
+
+void Layer::messageEnqueued()
+{
+    if (!active) {
+        sendMessagesFromQueue();
+        return;
+    }
+
+    // Same as the owner: only dequeue here if the audio callback isn't running
+    auto const* cs = getCallbackLock();
+    if (cs && cs->tryEnter()) {
+        sendMessagesFromQueue();
+        cs->exit();
+    }
+}
+
+void Layer::performLayerChange(String const& action, std::vector<pd::Atom> const& args)
+{
+    // The owner might close this layer, so don't do that while we're dispatching its messages
+    MessageManager::callAsync([_this = WeakReference<Layer>(this), action, args]() {
+        if (_this)
+            _this->owner.performLayerChange(action, args);
+    });
+}
+
+CallbackLock const* Layer::getCallbackLock()
+{
+    return owner.getCallbackLock();
+}
+
+Colour Layer::getForegroundColour()
+{
+    return owner.getForegroundColour();
+}
+
+Colour Layer::getBackgroundColour()
+{
+    return owner.getBackgroundColour();
+}
+
+Colour Layer::getTextColour()
+{
+    return owner.getTextColour();
+}
+
+Colour Layer::getOutlineColour()
+{
+    return owner.getOutlineColour();
+}
+
+} // namespace pd
@@ -0,0 +1,82 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include "PdInstance.h"
+
+namespace pd {
+
+// A patch that runs in a pd instance of its own
+//! @details Layers are opened from a file and have no editor. The owner processes all layers
+//! next to its own instance, each on a thread of the shared worker pool, and mixes their outputs
+//! into its own. The ticks really overlap: with PDINSTANCE, the sys_lock that libpd takes around a tick
+//! is the instance's own mutex plus a read lock that all instances share, and readers don't exclude each
+//! other. They only wait while some instance takes the write side to change pd's class list, which
+//! happens when a library or a new class is loaded, not while patches run. Layers receive the same audio input as the owner, but no MIDI or parameters.
+//! Patches can control layers by sending "open <file>", "close <file>", "pause <file>", "resume <file>"
+//! or "clear" to [r layer]. "program <index> <file>" opens a layer as a program, see PlugDataAudioProcessor::setProgram.
+//! Layers need PDINSTANCE, builds with a single pd instance like the standalone refuse to open them.
+class Layer : public Instance {
+public:
+    Layer(Instance& owner, File const& file);
+    ~Layer() override;
+
+    bool isLoaded() const;
+    File const& getFile() const;
+
+    void prepare(int numIns, int numOuts, double sampleRate, int blockSize);
+
+    // Set while the layer is processed by the audio callback
+    void setActive(bool shouldBeActive);
+
+    // A paused layer keeps its DSP chain, it's only not ticked, so resuming it is instant
+    // It still receives messages, and its output is silent
+    void setPaused(bool shouldBePaused);
+    bool isPaused() const;
+
+    // Fades the output in or out over numSamples, called by the audio thread between blocks
+    // Fading in resumes the layer, a layer that faded out pauses itself so it costs nothing
+    void fadeTo(bool audible, int numSamples);
+
+    // Runs a single tick, the buffers use the channel layout of libpd_process_raw
+    void process(float const* input);
+    float const* getOutput() const;
+
+    void messageEnqueued() override;
+    void performLayerChange(String const& action, std::vector<pd::Atom> const& args) override;
+
+    CallbackLock const* getCallbackLock() override;
+
+    Colour getForegroundColour() override;
+    Colour getBackgroundColour() override;
+    Colour getTextColour() override;
+    Colour getOutlineColour() override;
+
+private:
+    Instance& owner;
+    File file;
+
+    std::unique_ptr<Patch> patch;
+    std::vector<float> output;
+
+    std::atomic<bool> active = false;
+    std::atomic<bool> paused = false;
+
+    void applyFade();
+
+    // Only used by the audio thread
+    bool outputCleared = false;
+    float gain = 1.0f;
+    float gainTarget = 1.0f;
+    float gainStep = 0.0f;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(Layer)
+};
+
+} // namespace pd
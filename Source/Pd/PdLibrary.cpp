@@ -6,10 +6,13 @@ extern "C" {
 #include <s_stuff.h>
 }
 
+#include <atomic>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 #include "PdLibrary.h"
+#include "../Utility/Trace.h"
 
 struct _canvasenvironment {
     t_symbol* ce_dir;    /* directory patch lives in */
@@ -21,313 +24,355 @@ struct _canvasenvironment {
 
 namespace pd {
 
-// Iterative function to insert a key into a Trie
-void Trie::insert(String const& key)
+ObjectIndex::ObjectIndex(StringArray objectNames, KeywordMap const& keywords)
 {
-    // Names with spaces not supported yet by the suggestor
-    if (key.containsChar(' '))
-        return;
+    for (auto& name : objectNames) {
+        // Names with spaces not supported yet by the suggestor
+        if (name.isNotEmpty() && !name.containsChar(' '))
+            names.push_back(name);
+    }
 
-    // start from the root node
-    Trie* curr = this;
-    for (char i : key) {
-        if (!curr)
-            continue;
+    // Sorted by code point, so that all names with the same prefix are next to each other
+    std::sort(names.begin(), names.end(), [](String const& lhs, String const& rhs) { return lhs.compare(rhs) < 0; });
+    names.erase(std::unique(names.begin(), names.end()), names.end());
 
-        // create a new node if the path doesn't exist
-        if (curr->character[i] == nullptr) {
-            curr->character[i] = new Trie();
-        }
+    for (auto const& [name, words] : keywords) {
+        auto it = std::lower_bound(names.begin(), names.end(), name, [](String const& lhs, String const& rhs) { return lhs.compare(rhs) < 0; });
+        if (it == names.end() || *it != name)
+            continue;
 
-        // go to the next node
-        curr = curr->character[i];
+        for (auto& word : words)
+            keywordIndex.emplace_back(word.toLowerCase(), static_cast<int>(it - names.begin()));
     }
 
-    // mark the current node as a leaf
-    curr->isLeaf = true;
+    std::sort(keywordIndex.begin(), keywordIndex.end(), [](auto const& lhs, auto const& rhs) {
+        auto const order = lhs.first.compare(rhs.first);
+        return order == 0 ? lhs.second < rhs.second : order < 0;
+    });
 }
 
-// Iterative function to search a key in a Trie. It returns true
-// if the key is found in the Trie; otherwise, it returns false
-bool Trie::search(String const& key)
+Suggestions ObjectIndex::autocomplete(String const& query, int maxResults, bool includeFuzzy, Narrowing* narrowing) const
 {
-    Trie* curr = this;
-    for (char i : key) {
-        // go to the next node
-        curr = curr->character[i];
-
-        // if the string is invalid (reached end of a path in the Trie)
-        if (curr == nullptr) {
-            return false;
-        }
-    }
+    Suggestions result;
+    if (query.isEmpty() || names.empty())
+        return result;
 
-    // return true if the current node is a leaf and the
-    // end of the string is reached
-    return curr->isLeaf;
-}
+    std::vector<bool> added(names.size(), false);
 
-// Returns true if a given node has any children
-bool Trie::hasChildren()
-{
-    for (auto& i : character) {
-        if (i) {
-            return true; // child found
-        }
-    }
+    addPrefixMatches(query, result, added, maxResults);
+    addKeywordMatches(query, result, added, maxResults);
+
+    if (includeFuzzy)
+        addFuzzyMatches(query, result, added, maxResults, narrowing);
 
-    return false;
+    return result;
 }
 
-// Recursive function to delete a key in the Trie
-bool Trie::deletion(Trie*& curr, String key)
+void ObjectIndex::addPrefixMatches(String const& query, Suggestions& result, std::vector<bool>& added, int maxResults) const
 {
-    // return if Trie is empty
-    if (curr == nullptr) {
-        return false;
+    auto const first = std::lower_bound(names.begin(), names.end(), query, [](String const& lhs, String const& rhs) { return lhs.compare(rhs) < 0; });
+
+    auto last = first;
+    while (last != names.end() && last->startsWith(query))
+        last++;
+
+    // Only the shortest names have to be sorted, these are the closest to what was typed
+    std::vector<int> matches;
+    matches.reserve(static_cast<size_t>(last - first));
+    for (auto it = first; it != last; it++)
+        matches.push_back(static_cast<int>(it - names.begin()));
+
+    auto const numResults = std::min<size_t>(matches.size(), static_cast<size_t>(maxResults));
+    std::partial_sort(matches.begin(), matches.begin() + numResults, matches.end(), [this](int lhs, int rhs) {
+        auto const lhsLength = names[lhs].length();
+        auto const rhsLength = names[rhs].length();
+        return lhsLength == rhsLength ? lhs < rhs : lhsLength < rhsLength;
+    });
+
+    for (size_t i = 0; i < numResults; i++) {
+        result.push_back({ names[matches[i]], true });
+        added[matches[i]] = true;
     }
+}
 
-    // if the end of the key is not reached
-    if (key.length()) {
-        // recur for the node corresponding to the next character in the key
-        // and if it returns true, delete the current node (if it is non-leaf)
-
-        if (curr != nullptr && curr->character[key[0]] != nullptr && deletion(curr->character[key[0]], key.substring(1)) && !curr->isLeaf) {
-            if (!curr->hasChildren()) {
-                delete curr;
-                curr = nullptr;
-                return true;
-            }
-
-            return false;
-        }
-    }
+void ObjectIndex::addKeywordMatches(String const& query, Suggestions& result, std::vector<bool>& added, int maxResults) const
+{
+    if (static_cast<int>(result.size()) >= maxResults || keywordIndex.empty())
+        return;
 
-    // if the end of the key is reached
-    if (key.length() == 0 && curr->isLeaf) {
-        // if the current node is a leaf node and doesn't have any children
-        if (!curr->hasChildren()) {
-            // delete the current node
-            delete curr;
-            curr = nullptr;
+    auto const lowerQuery = query.toLowerCase();
+    auto it = std::lower_bound(keywordIndex.begin(), keywordIndex.end(), lowerQuery, [](auto const& lhs, String const& rhs) { return lhs.first.compare(rhs) < 0; });
 
-            // delete the non-leaf parent nodes
-            return true;
-        }
+    for (; it != keywordIndex.end() && it->first.startsWith(lowerQuery); it++) {
+        if (static_cast<int>(result.size()) >= maxResults)
+            return;
 
-        // mark the current node as a non-leaf node (DON'T DELETE IT)
-        curr->isLeaf = false;
+        if (added[it->second])
+            continue;
 
-        // don't delete its parent nodes
-        return false;
+        result.push_back({ names[it->second], false });
+        added[it->second] = true;
     }
-
-    return false;
 }
 
-void Trie::suggestionsRec(String currPrefix, Suggestions& result)
+void ObjectIndex::addFuzzyMatches(String const& query, Suggestions& result, std::vector<bool>& added, int maxResults, Narrowing* narrowing) const
 {
-    // found aString in Trie with the given prefix
-    if (isLeaf) {
-        result.push_back({ currPrefix, true });
-    }
-
-    // All children struct node pointers are NULL
-    if (!hasChildren())
+    // Single characters match almost everything, that isn't helpful
+    if (static_cast<int>(result.size()) >= maxResults || query.length() < 2)
         return;
 
-    for (int i = 0; i < CHAR_SIZE; i++) {
-        if (character[i]) {
-            // append current character to currPrefixString
-            // currPrefix += i;
-            char letter = INDEX_TO_CHAR(i);
-            currPrefix += String(&letter, 1);
+    auto const* queryText = query.toRawUTF8();
+    auto const queryLength = static_cast<int>(strlen(queryText));
+
+    // A name that contains the characters of the query in order also contains those of any prefix of it
+    auto const canNarrow = narrowing && narrowing->query.isNotEmpty() && query.startsWith(narrowing->query);
+    auto const numCandidates = canNarrow ? narrowing->fuzzyMatches.size() : names.size();
+
+    std::vector<int> allMatches;
 
-            // recur over the rest
-            character[i]->suggestionsRec(currPrefix, result);
+    // Scores by how spread out the matched characters are, closer together is better
+    std::vector<std::pair<int, int>> matches;
+    for (size_t candidate = 0; candidate < numCandidates; candidate++) {
+        auto const i = canNarrow ? narrowing->fuzzyMatches[candidate] : static_cast<int>(candidate);
+        auto const* text = names[i].toRawUTF8();
+        int q = 0, start = -1, end = 0;
 
-            // remove last character
-            currPrefix = currPrefix.dropLastCharacters(1);
+        for (int c = 0; text[c] != '\0' && q < queryLength; c++) {
+            if (text[c] == queryText[q]) {
+                if (start < 0)
+                    start = c;
+                end = c;
+                q++;
+            }
         }
-    }
-}
 
-// print suggestions for given query prefix.
-int Trie::autocomplete(String query, Suggestions& result)
-{
-    auto* pCrawl = this;
-
-    // Check if prefix is present and find the
-    // the node (of last level) with last character
-    // of givenString.
-    int level;
-    int n = query.length();
-    for (level = 0; level < n; level++) {
-        int index = CHAR_TO_INDEX(query[level]);
-
-        // no String in the Trie has this prefix
-        // TODO: why does this crash every now and then???
-        if (index < 0 || index >= 127 || !pCrawl->character[index])
-            return 0;
-
-        pCrawl = pCrawl->character[index];
-    }
+        if (q != queryLength)
+            continue;
 
-    // If prefix is present as a word.
-    bool isWord = pCrawl->isLeaf;
+        allMatches.push_back(i);
 
-    // If prefix is last node of tree (has no
-    // children)
-    bool isLast = !pCrawl->hasChildren();
+        if (!added[i])
+            matches.emplace_back((end - start) * 4 + start + names[i].length(), i);
+    }
 
-    // If prefix is present as a word, but
-    // there is no subtree below the last
-    // matching node.
-    if (isWord && isLast) {
-        result.push_back({ query, true });
-        return -1;
+    if (narrowing) {
+        narrowing->query = query;
+        narrowing->fuzzyMatches = std::move(allMatches);
     }
 
-    // If there are are nodes below last
-    // matching character.
-    if (!isLast) {
-        String const& prefix = query;
-        pCrawl->suggestionsRec(prefix, result);
-        return 1;
+    auto const numResults = std::min<size_t>(matches.size(), static_cast<size_t>(maxResults) - result.size());
+    std::partial_sort(matches.begin(), matches.begin() + numResults, matches.end());
+
+    for (size_t i = 0; i < numResults; i++) {
+        result.push_back({ names[matches[i].second], false });
+        added[matches[i].second] = true;
     }
-    return 0;
 }
 
-void Library::initialiseLibrary()
+Library::Library()
+    : thread(new LambdaThread())
+    , snapshot(std::make_shared<LibrarySnapshot const>())
 {
-    auto* pdinstance = pd_this;
+    appDataDir = File::getSpecialLocation(File::SpecialLocationType::userApplicationDataDirectory).getChildFile("PlugData");
+    documentationDir = appDataDir.getChildFile("Library").getChildFile("Documentation").getChildFile("pddp");
+
+    // Paths to search
+    // First, only search vanilla, then search all documentation
+    // Lastly, check the deken folder
+    helpPaths = {appDataDir.getChildFile("Documentation").getChildFile("Library").getChildFile("5.reference"), appDataDir.getChildFile("Library").getChildFile("Documentation"),
+        appDataDir.getChildFile("Deken")
+    };
 
-    auto updateFn = [this, pdinstance]() {
-        libraryLock.lock();
+    cache.setFile(appDataDir.getChildFile("Library.cache"));
+}
 
+void Library::initialiseLibrary()
+{
+    std::call_once(initialised, [this]() {
+        // The object names are read from the main instance, which lives as long as the process
+#ifdef PDINSTANCE
+        auto* pdinstance = &pd_maininstance;
+#else
+        auto* pdinstance = pd_this;
+#endif
+
+        auto updateFn = [this, pdinstance]() {
 // Make sure instance is set correctly for this thread
 #ifdef PDINSTANCE
-        pd_setinstance(pdinstance);
+            pd_setinstance(pdinstance);
 #endif
 
-        appDataDir = File::getSpecialLocation(File::SpecialLocationType::userApplicationDataDirectory).getChildFile("PlugData");
+            cache.load();
+            update(pdinstance);
 
-        auto pddocPath = appDataDir.getChildFile("Library").getChildFile("Documentation").getChildFile("pddp").getFullPathName();
+            if (thread->threadShouldExit())
+                return;
 
-        updateLibrary();
-        parseDocumentation(pddocPath);
+            // Update docs in GUI
+            MessageManager::callAsync([this]() {
+                watcher.addFolder(appDataDir);
+                watcher.addListener(this);
 
-        if (thread->threadShouldExit())
-            return;
-        
-        
-        // Paths to search
-        // First, only search vanilla, then search all documentation
-        // Lastly, check the deken folder
-        helpPaths = {appDataDir.getChildFile("Documentation").getChildFile("Library").getChildFile("5.reference"), appDataDir.getChildFile("Library").getChildFile("Documentation"),
-            appDataDir.getChildFile("Deken")
+                listeners.call([](Listener& l) { l.appDirChanged(); });
+            });
         };
 
-        // Update docs in GUI
-        MessageManager::callAsync([this]() {
-            watcher.addFolder(appDataDir);
-            watcher.addListener(this);
+        thread->runLambda(updateFn);
+    });
+}
 
-            if (appDirChanged)
-                appDirChanged();
-        });
+void Library::updateLibrary()
+{
+#ifdef PDINSTANCE
+    auto* pdinstance = &pd_maininstance;
+#else
+    auto* pdinstance = pd_this;
+#endif
 
-        libraryLock.unlock();
-    };
+    thread->runLambda([this, pdinstance]() {
+        TRACE_ZONE("Library::updateLibrary");
 
-    thread = new LambdaThread();
-    thread->runLambda(updateFn);
+        // Revalidates against the cache, only changed files are parsed again
+        update(pdinstance);
+    });
 }
 
-void Library::updateLibrary()
+void Library::update(t_pdinstance* pdinstance, int parts)
 {
-    auto* pdinstance = pd_this;
-    auto updateFn = [this, pdinstance]() {
-        auto settingsTree = ValueTree::fromXml(appDataDir.getChildFile("Settings.xml").loadFileAsString());
+    auto newSnapshot = std::make_shared<LibrarySnapshot>(*getSnapshot());
+
+    // Documentation first, the search index uses its keywords
+    if (parts & Documentation) {
+        newSnapshot->objectDescriptions.clear();
+        newSnapshot->objectKeywords.clear();
+        newSnapshot->inletDescriptions.clear();
+        newSnapshot->outletDescriptions.clear();
+        newSnapshot->arguments.clear();
+
+        parseDocumentation(documentationDir.getFullPathName(), *newSnapshot);
+        parts |= SearchIndex;
+    }
 
-        auto pathTree = settingsTree.getChildWithName("Paths");
+    // The library is being destroyed, what was built so far is of no use
+    if (thread->threadShouldExit())
+        return;
+
+    if (parts & SearchIndex)
+        buildSearchIndex(pdinstance, *newSnapshot);
+
+    if (thread->threadShouldExit())
+        return;
+
+    if (parts & HelpIndex) {
+        newSnapshot->helpIndex.clear();
+        buildHelpIndex(*newSnapshot);
+    }
+
+    cache.save();
+
+    SpinLock::ScopedLockType lock(snapshotLock);
+    snapshot = std::move(newSnapshot);
+}
+
+std::shared_ptr<LibrarySnapshot const> Library::getSnapshot() const
+{
+    SpinLock::ScopedLockType lock(snapshotLock);
+    return snapshot;
+}
+
+void Library::buildSearchIndex(t_pdinstance* pdinstance, LibrarySnapshot& newSnapshot)
+{
+    auto settingsTree = ValueTree::fromXml(appDataDir.getChildFile("Settings.xml").loadFileAsString());
+
+    auto pathTree = settingsTree.getChildWithName("Paths");
 
-        searchTree = std::make_unique<Trie>();
+    StringArray names;
 
-        // Get available objects directly from pd
-        int i;
-        t_class* o = pd_objectmaker;
+    // Get available objects directly from pd
+    int i;
+    t_class* o = pd_objectmaker;
 
-        t_methodentry *mlist, *m;
+    t_methodentry *mlist, *m;
 
 #if PDINSTANCE
-        mlist = o->c_methods[pdinstance->pd_instanceno];
+    mlist = o->c_methods[pdinstance->pd_instanceno];
 #else
-        mlist = o->c_methods;
+    mlist = o->c_methods;
 #endif
 
-        for (i = o->c_nmethod, m = mlist; i--; m++) {
-            String name(m->me_name->s_name);
-            searchTree->insert(m->me_name->s_name);
-        }
+    for (i = o->c_nmethod, m = mlist; i--; m++) {
+        names.add(String::fromUTF8(m->me_name->s_name));
+    }
 
-        searchTree->insert("graph");
+    names.add("graph");
 
-        // Find patches in our search tree
-        for (auto path : pathTree) {
-            auto filePath = File(path.getProperty("Path").toString());
+    // Find patches in our search tree, search paths of which no folder changed come from the cache
+    for (auto path : pathTree) {
+        auto filePath = File(path.getProperty("Path").toString());
+        auto const stamp = LibraryCache::getFolderStamp(filePath);
 
-            for (const auto& iter : RangedDirectoryIterator(filePath, true)) {
-                auto file = iter.getFile();
-                // Get pd files but not help files
-                if (file.getFileExtension() == ".pd" && !(file.getFileNameWithoutExtension().startsWith("help-") || file.getFileNameWithoutExtension().endsWith("-help"))) {
-                    searchTree->insert(file.getFileNameWithoutExtension().toStdString());
-                }
+        if (auto const* cached = cache.findPatchNames(filePath, stamp)) {
+            names.addArray(*cached);
+            continue;
+        }
+
+        StringArray patchNames;
+        for (const auto& iter : RangedDirectoryIterator(filePath, true)) {
+            auto file = iter.getFile();
+            // Get pd files but not help files
+            if (file.getFileExtension() == ".pd" && !(file.getFileNameWithoutExtension().startsWith("help-") || file.getFileNameWithoutExtension().endsWith("-help"))) {
+                patchNames.add(file.getFileNameWithoutExtension());
             }
         }
-    };
 
-    jassert(thread);
-    thread->runLambda(updateFn);
+        names.addArray(patchNames);
+        cache.addPatchNames(filePath, stamp, std::move(patchNames));
+    }
+
+    newSnapshot.searchIndex = std::make_shared<ObjectIndex const>(std::move(names), newSnapshot.objectKeywords);
 }
 
-void Library::parseDocumentation(String const& path)
+void Library::parseDocumentation(String const& path, LibrarySnapshot& newSnapshot)
 {
     // Function to get sections from a text file based on a section name
     // Let it know which sections exists, and it will order them and put them in a map by name
-    auto getSections = [](String contents, StringArray sectionNames) {
-        Array<std::pair<String, int>> positions;
-
-        for (auto& section : sectionNames) {
-            positions.add({ section, contents.indexOf(section + ':') });
+    // The text is only read once, looking for the first occurrence of every name followed by a colon
+    auto getSections = [](std::string_view contents, std::initializer_list<char const*> sectionNames) {
+        std::vector<std::pair<std::string_view, size_t>> positions;
+        std::vector<std::string_view> remaining(sectionNames.begin(), sectionNames.end());
+
+        for (size_t i = 0; i < contents.size() && !remaining.empty(); i++) {
+            for (auto it = remaining.begin(); it != remaining.end(); it++) {
+                auto const& name = *it;
+                if (contents[i] != name[0] || contents.compare(i, name.size(), name) != 0 || i + name.size() >= contents.size() || contents[i + name.size()] != ':')
+                    continue;
+
+                positions.push_back({ name, i });
+                remaining.erase(it);
+                break;
+            }
         }
 
-        std::sort(positions.begin(), positions.end(), [](const auto& lhs, const auto& rhs) { return lhs.second < rhs.second; });
-
         std::map<String, std::pair<String, int>> sections;
 
-        int i = 0;
-        for (auto it = positions.begin(); it < positions.end(); it++) {
-            auto& [name, currentPosition] = *it;
-            if (currentPosition < 0)
-                continue; // section not found
+        for (size_t i = 0; i < positions.size(); i++) {
+            auto const& [name, position] = positions[i];
 
-            currentPosition += name.length();
+            // Everything after the colon, up to the next section
+            auto const start = position + name.size() + 1;
+            auto const end = i + 1 < positions.size() ? positions[i + 1].second : contents.size();
+            auto const content = String::fromUTF8(contents.data() + start, static_cast<int>(end - start));
 
-            String sectionContent;
-            if (it == positions.end() - 1) {
-                sectionContent = contents.substring(currentPosition);
-            } else {
-                sectionContent = contents.substring(currentPosition + 1, (*(it + 1)).second);
-            }
-
-            sections[name.trim()] = { sectionContent.substring(1).trim().unquoted(), i };
-            i++;
+            sections[String::fromUTF8(name.data(), static_cast<int>(name.size())).trim()] = { content.trim().unquoted(), static_cast<int>(i) };
         }
 
         return sections;
     };
 
+    auto view = [](String const& text) {
+        return std::string_view(text.toRawUTF8(), text.getNumBytesAsUTF8());
+    };
+
     auto formatText = [](String text) {
         text = text.trim();
         // Start sentences with uppercase
@@ -366,85 +411,153 @@ void Library::parseDocumentation(String const& path)
         return lines;
     };
 
-    auto parseFile = [this, getSections, formatText, sectionsFromHyphens](File& f) {
-        String contents = f.loadFileAsString();
-        auto sections = getSections(contents, { "\ntitle", "\ndescription", "\npdcategory", "\ncategories", "\nflags", "\narguments", "\nlast_update", "\ninlets", "\noutlets", "\ndraft" });
+    auto parseFile = [getSections, view, formatText, sectionsFromHyphens](File const& f) {
+        DocumentationEntry entry;
+
+        MemoryBlock contents;
+        f.loadFileAsData(contents);
+        auto sections = getSections(std::string_view(static_cast<char const*>(contents.getData()), contents.getSize()), { "\ntitle", "\ndescription", "\npdcategory", "\ncategories", "\nflags", "\narguments", "\nlast_update", "\ninlets", "\noutlets", "\ndraft" });
 
         if (!sections.count("title"))
-            return;
+            return entry;
 
-        String name = sections["title"].first;
+        entry.name = sections["title"].first;
 
         if (sections.count("description")) {
-            objectDescriptions[name] = sections["description"].first;
+            entry.description = sections["description"].first;
+        }
+
+        // Words from the description and category, so objects can be found by what they do
+        StringArray keywords;
+        keywords.addTokens(sections["description"].first + " " + sections["pdcategory"].first, " ,.;:()[]{}/\"'\t\n", "");
+        for (int i = keywords.size() - 1; i >= 0; i--) {
+            if (keywords[i].length() < 3)
+                keywords.remove(i);
         }
+        keywords.removeDuplicates(true);
+        entry.keywords = keywords;
 
         if (sections.count("arguments") || sections.count("flags")) {
-            Arguments args;
+            auto& args = entry.arguments;
 
             for (auto& argument : sectionsFromHyphens(sections["arguments"].first)) {
-                auto sectionMap = getSections(argument, { "type", "description", "default" });
+                auto sectionMap = getSections(view(argument), { "type", "description", "default" });
                 args.push_back({ sectionMap["type"].first, sectionMap["description"].first, sectionMap["default"].first });
             }
 
             for (auto& flag : sectionsFromHyphens(sections["flags"].first)) {
-                auto sectionMap = getSections(flag, { "name", "description" });
+                auto sectionMap = getSections(view(flag), { "name", "description" });
                 args.push_back({ sectionMap["name"].first, sectionMap["description"].first, "" });
             }
-
-            arguments[name] = args;
         }
 
         auto numbers = { "1st", "2nd", "3rd", "4th", "5th", "6th", "7th", "8th", "nth" };
         if (sections.count("inlets")) {
-            auto section = getSections(sections["inlets"].first, numbers);
-            inletDescriptions[name].resize(static_cast<int>(section.size()));
+            auto section = getSections(view(sections["inlets"].first), numbers);
+            entry.inlets.resize(static_cast<int>(section.size()));
             for (auto [number, content] : section) {
                 String tooltip;
                 for (auto& argument : sectionsFromHyphens(content.first)) {
-                    auto sectionMap = getSections(argument, { "type", "description" });
+                    auto sectionMap = getSections(view(argument), { "type", "description" });
                     if (sectionMap["type"].first.isEmpty())
                         continue;
 
                     tooltip += "(" + sectionMap["type"].first + ") " + sectionMap["description"].first + "\n";
                 }
 
-                inletDescriptions[name].getReference(content.second) = { tooltip, number == "nth" };
+                entry.inlets.getReference(content.second) = { tooltip, number == "nth" };
             }
         }
         if (sections.count("outlets")) {
-            auto section = getSections(sections["outlets"].first, numbers);
-            outletDescriptions[name].resize(static_cast<int>(section.size()));
+            auto section = getSections(view(sections["outlets"].first), numbers);
+            entry.outlets.resize(static_cast<int>(section.size()));
             for (auto [number, content] : section) {
                 String tooltip;
 
                 for (auto& argument : sectionsFromHyphens(content.first)) {
-                    auto sectionMap = getSections(argument, { "type", "description" });
+                    auto sectionMap = getSections(view(argument), { "type", "description" });
                     if (sectionMap["type"].first.isEmpty())
                         continue;
                     tooltip += "(" + sectionMap["type"].first + ") " + sectionMap["description"].first + "\n";
                 }
 
-                outletDescriptions[name].getReference(content.second) = { tooltip, number == "nth" };
+                entry.outlets.getReference(content.second) = { tooltip, number == "nth" };
             }
         }
+
+        return entry;
     };
 
-    for (auto& iter : RangedDirectoryIterator(path, true)) {
-        auto file = iter.getFile();
+    auto addEntry = [&newSnapshot](DocumentationEntry const& entry) {
+        if (entry.name.isEmpty())
+            return;
+
+        auto const& name = entry.name;
+
+        if (entry.description.isNotEmpty())
+            newSnapshot.objectDescriptions[name] = entry.description;
+        if (!entry.keywords.isEmpty())
+            newSnapshot.objectKeywords[name] = entry.keywords;
+        if (!entry.arguments.empty())
+            newSnapshot.arguments[name] = entry.arguments;
+        if (!entry.inlets.isEmpty())
+            newSnapshot.inletDescriptions[name] = entry.inlets;
+        if (!entry.outlets.isEmpty())
+            newSnapshot.outletDescriptions[name] = entry.outlets;
+    };
 
-        if (file.hasFileExtension("md")) {
-            parseFile(file);
+    // Only files that changed since the cache was written have to be read
+    std::vector<DocumentationEntry const*> cachedEntries;
+    std::vector<RangedDirectoryIterator::value_type> changedFiles;
+
+    for (auto& iter : RangedDirectoryIterator(path, true, "*.md")) {
+        auto const* cached = cache.findDocumentation(iter);
+        cachedEntries.push_back(cached);
+
+        if (!cached)
+            changedFiles.push_back(iter);
+    }
+
+    // Those are spread over the background workers, which is what makes the first startup fast
+    std::vector<DocumentationEntry> parsedEntries(changedFiles.size());
+
+    auto const numChunks = static_cast<int>((changedFiles.size() + minFilesPerThread - 1) / minFilesPerThread);
+
+    tasks->parallelFor(numChunks, [&](int chunk) {
+        auto const end = jmin(changedFiles.size(), (chunk + 1) * minFilesPerThread);
+        for (auto i = chunk * minFilesPerThread; i < end; i++)
+            parsedEntries[i] = parseFile(changedFiles[i].getFile());
+    });
+
+    // Merged in the order of the files, so entries with the same name resolve like they always did
+    size_t parsed = 0;
+    for (auto const* cached : cachedEntries) {
+        if (cached) {
+            addEntry(*cached);
+            continue;
         }
+
+        addEntry(parsedEntries[parsed]);
+        cache.addDocumentation(changedFiles[parsed], std::move(parsedEntries[parsed]));
+        parsed++;
     }
 }
 
-Suggestions Library::autocomplete(String query) const
+Suggestions Library::autocomplete(String query, bool includeFuzzy, ObjectIndex::Narrowing* narrowing) const
 {
-    Suggestions result;
-    if (searchTree)
-        searchTree->autocomplete(std::move(query), result);
-    return result;
+    auto current = getSnapshot();
+
+    if (!current->searchIndex)
+        return {};
+
+    // What was narrowed down for an older index doesn't apply to this one
+    if (narrowing && narrowing->index != current->searchIndex) {
+        narrowing->index = current->searchIndex;
+        narrowing->query.clear();
+        narrowing->fuzzyMatches.clear();
+    }
+
+    return current->searchIndex->autocomplete(query, maxSuggestions, includeFuzzy, narrowing);
 }
 
 String Library::getInletOutletTooltip(String objname, int idx, int total, bool isInlet)
@@ -452,7 +565,9 @@ String Library::getInletOutletTooltip(String objname, int idx, int total, bool i
     auto name = objname.upToFirstOccurrenceOf(" ", false, false);
     auto args = StringArray::fromTokens(objname.fromFirstOccurrenceOf(" ", false, false), true);
 
-    auto findInfo = [&name, &args, &total, &idx](IODescriptionMap map) {
+    auto current = getSnapshot();
+
+    auto findInfo = [&name, &args, &total, &idx](IODescriptionMap const& map) {
         if (map.count(name)) {
             auto descriptions = map.at(name);
 
@@ -478,12 +593,64 @@ String Library::getInletOutletTooltip(String objname, int idx, int total, bool i
         return String();
     };
 
-    return isInlet ? findInfo(getInletDescriptions()) : findInfo(getOutletDescriptions());
+    return isInlet ? findInfo(current->inletDescriptions) : findInfo(current->outletDescriptions);
 }
 
 void Library::fsChangeCallback()
 {
-    appDirChanged();
+    // Updated once here, for all instances that share the library
+    updateLibrary();
+
+    listeners.call([](Listener& l) { l.appDirChanged(); });
+}
+
+void Library::fsFilesChanged(FileSystemWatcher::FileChanges const& changes)
+{
+    // Without knowing what changed, everything has to be updated
+    int parts = changes.empty() ? All : 0;
+
+    for (auto const& [file, fsEvent] : changes) {
+        auto const extension = file.getFileExtension();
+
+        if (extension == ".md") {
+            parts |= Documentation;
+        } else if (extension == ".pd") {
+            auto const name = file.getFileName();
+            parts |= name.endsWith("-help.pd") || name.startsWith("help-") ? HelpIndex : SearchIndex;
+        } else if (extension.isEmpty()) {
+            // Most likely a folder, which can contain anything
+            parts = All;
+        } else if (file == appDataDir.getChildFile("Settings.xml")) {
+            // The search paths might have changed
+            parts |= SearchIndex;
+        }
+
+        // Anything else, like our own cache, doesn't affect the library
+    }
+
+    if (parts != 0) {
+#ifdef PDINSTANCE
+        auto* pdinstance = &pd_maininstance;
+#else
+        auto* pdinstance = pd_this;
+#endif
+
+        thread->runLambda([this, pdinstance, parts]() {
+            update(pdinstance, parts);
+        });
+    }
+
+    listeners.call([](Listener& l) { l.appDirChanged(); });
+}
+
+void Library::addListener(Listener* listener)
+{
+    listeners.add(listener);
+}
+
+void Library::removeListener(Listener* listener)
+{
+    listeners.remove(listener);
 }
 
 File Library::findHelpfile(t_object* obj)
@@ -510,6 +677,24 @@ File Library::findHelpfile(t_object* obj)
     String firstName = helpName + "-help.pd";
     String secondName = "help-" + helpName + ".pd";
 
+    auto current = getSnapshot();
+
+    // The help path that comes first wins, and within a path the first name
+    if (current->isHelpIndexed) {
+        auto const& index = current->helpIndex;
+        auto first = index.find(firstName);
+        auto second = index.find(secondName);
+
+        if (first != index.end() && (second == index.end() || first->second.first <= second->second.first))
+            return first->second.second;
+        if (second != index.end())
+            return second->second.second;
+
+        return File();
+    }
+
+    // Not indexed yet, search the help paths directly
+
     auto findHelpPatch = [&firstName, &secondName](const File& searchDir) -> File
     {
         for (const auto& fileIter : RangedDirectoryIterator(searchDir, true))
@@ -535,50 +720,24 @@ File Library::findHelpfile(t_object* obj)
     return File();
 }
 
-ObjectMap Library::getObjectDescriptions()
-{
-    if (libraryLock.try_lock()) {
-        auto descriptions = objectDescriptions;
-        libraryLock.unlock();
-        return descriptions;
-    }
-    return {};
-}
-KeywordMap Library::getObjectKeywords()
-{
-    if (libraryLock.try_lock()) {
-        auto keywords = objectKeywords;
-        libraryLock.unlock();
-        return keywords;
-    }
-    return {};
-}
-IODescriptionMap Library::getInletDescriptions()
-{
-    if (libraryLock.try_lock()) {
-        auto descriptions = inletDescriptions;
-        libraryLock.unlock();
-        return descriptions;
-    }
-    return {};
-}
-IODescriptionMap Library::getOutletDescriptions()
-{
-    if (libraryLock.try_lock()) {
-        auto descriptions = outletDescriptions;
-        libraryLock.unlock();
-        return descriptions;
-    }
-    return {};
-}
-ArgumentMap Library::getArguments()
+void Library::buildHelpIndex(LibrarySnapshot& newSnapshot)
 {
-    if (libraryLock.try_lock()) {
-        auto args = arguments;
-        libraryLock.unlock();
-        return args;
+    auto& index = newSnapshot.helpIndex;
+
+    for (int i = 0; i < static_cast<int>(helpPaths.size()); i++) {
+        for (auto const& iter : RangedDirectoryIterator(helpPaths[i], true, "*.pd")) {
+            auto file = iter.getFile();
+            auto name = file.getFileName();
+
+            if (!name.endsWith("-help.pd") && !name.startsWith("help-"))
+                continue;
+
+            // Keeps the first file with this name, like searching the paths in order did
+            index.emplace(name, std::make_pair(i, file));
+        }
     }
-    return {};
+
+    newSnapshot.isHelpIndexed = true;
 }
 
 } // namespace pd
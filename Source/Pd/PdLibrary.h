@@ -8,138 +8,217 @@
 #include <JuceHeader.h>
 
 #include "../Utility/FileSystemWatcher.h"
+#include "../Utility/TaskPool.h"
+#include "PdLibraryCache.h"
 
 #include <array>
+#include <deque>
+#include <mutex>
 #include <vector>
 
 namespace pd {
 
-using IODescription = juce::Array<std::pair<String, bool>>;
 using IODescriptionMap = std::unordered_map<String, IODescription>;
 
 using Suggestion = std::pair<String, bool>;
 using Suggestions = std::vector<Suggestion>;
 
-using Arguments = std::vector<std::tuple<String, String, String>>;
 using ArgumentMap = std::unordered_map<String, Arguments>;
 
 using ObjectMap = std::unordered_map<String, String>;
 using KeywordMap = std::unordered_map<String, StringArray>;
 
-// Define the character size
-#define CHAR_SIZE 128
-#define CHAR_TO_INDEX(c) (static_cast<int>(c) - static_cast<int>('\0'))
-#define INDEX_TO_CHAR(c) static_cast<char>(c + static_cast<int>('\0'))
-// A class to store a Trie node
-class Trie {
+// Immutable index of object names for autocompletion
+//! @details All names are kept in a single sorted array, so the names that start with a prefix are
+//! found with a binary search and are next to each other. Keywords are stored the same way, as
+//! pairs of a keyword and the index of its name. The index is built once on the library thread and
+//! never changed after that, so the message thread can search it without locking.
+class ObjectIndex {
 public:
-    bool isLeaf;
-    Trie* character[CHAR_SIZE];
-
-    // Constructor
-    Trie()
-    {
-        isLeaf = false;
-
-        for (int i = 0; i < CHAR_SIZE; i++) {
-            character[i] = nullptr;
-        }
-    }
-
-    ~Trie()
+    // What the previous query matched, so that extending it only has to look at those names
+    struct Narrowing {
+        std::shared_ptr<ObjectIndex const> index;
+        String query;
+        std::vector<int> fuzzyMatches;
+    };
+
+    ObjectIndex(StringArray objectNames, KeywordMap const& keywords);
+
+    // Best matches first: the exact name, names starting with the query (shortest first),
+    // names with a keyword starting with the query, and then names that contain the query's
+    // characters in order. Only the prefix matches can be used to complete the typed text.
+    // The last kind is the only one that has to look at all names, it can be left out.
+    Suggestions autocomplete(String const& query, int maxResults, bool includeFuzzy = true, Narrowing* narrowing = nullptr) const;
+
+    int size() const
     {
-        for (int i = 0; i < CHAR_SIZE; i++) {
-            if (character[i]) {
-                delete character[i];
-            }
-        }
+        return static_cast<int>(names.size());
     }
 
-    void insert(String const& key);
-    bool deletion(Trie*&, String);
-    bool search(String const&);
-    bool hasChildren();
+private:
+    void addPrefixMatches(String const& query, Suggestions& result, std::vector<bool>& added, int maxResults) const;
+    void addKeywordMatches(String const& query, Suggestions& result, std::vector<bool>& added, int maxResults) const;
+    void addFuzzyMatches(String const& query, Suggestions& result, std::vector<bool>& added, int maxResults, Narrowing* narrowing) const;
 
-    void suggestionsRec(String currPrefix, Suggestions& result);
-    int autocomplete(String query, Suggestions& result);
+    std::vector<String> names;
+    std::vector<std::pair<String, int>> keywordIndex;
 };
 
+// Runs jobs one after another, queueing never waits for the job that is running
 struct LambdaThread : public Thread {
     LambdaThread()
         : Thread("Library update thread")
     {
     }
 
+    // Jobs check threadShouldExit between their steps, so they give up well within the timeout
     ~LambdaThread()
     {
-        stopThread(-1);
+        signalThreadShouldExit();
+        notify();
+        stopThread(exitTimeoutMs);
     }
 
     void run() override
     {
-        fn();
+        while (!threadShouldExit()) {
+            std::function<void()> job;
+            {
+                ScopedLock lock(jobLock);
+                if (!jobs.empty()) {
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+            }
+
+            if (job)
+                job();
+            else
+                wait(-1);
+        }
     }
 
     void runLambda(std::function<void()> func)
     {
-        fn = func;
-        startThread();
+        {
+            ScopedLock lock(jobLock);
+            jobs.push_back(std::move(func));
+        }
+
+        if (isThreadRunning())
+            notify();
+        else
+            startThread();
     }
 
 private:
-    std::function<void()> fn;
+    static constexpr int exitTimeoutMs = 2000;
+
+    CriticalSection jobLock;
+    std::deque<std::function<void()>> jobs;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LambdaThread)
 };
 
+// Help file name to the index of its help path and the file
+using HelpIndex = std::unordered_map<String, std::pair<int, File>>;
+
+// Everything that is read from the library, replaced as a whole whenever the library changes
+struct LibrarySnapshot {
+    ObjectMap objectDescriptions;
+    KeywordMap objectKeywords;
+    IODescriptionMap inletDescriptions;
+    IODescriptionMap outletDescriptions;
+    ArgumentMap arguments;
+
+    std::shared_ptr<ObjectIndex const> searchIndex;
+
+    HelpIndex helpIndex;
+    bool isHelpIndexed = false;
+};
+
+// Object documentation and autocompletion, shared by all plugin instances in the process
+//! @details Use it through a SharedResourcePointer, the first instance that initialises it starts
+//! the library thread. Readers take a reference to the current snapshot, which is never changed
+//! after it was published, so reading needs no lock other than the one that guards swapping the
+//! pointer. Updates build a complete new snapshot on the library thread and then publish it.
 struct Library : public FileSystemWatcher::Listener {
 
+    // Told when something in the app data folder changed, on the message thread
+    struct Listener {
+        virtual ~Listener() = default;
+        virtual void appDirChanged() = 0;
+    };
+
+    Library();
+
     ~Library()
     {
-        appDirChanged = nullptr;
-        if (thread) {
-            thread->waitForThreadToExit(-1);
-            delete thread;
-        }
+        // Stops the thread with a bounded wait, an update that is running gives up at its next step
+        delete thread;
     }
+
+    // Only the first call does anything, the library is shared by all instances, which
+    // may call this from their own threads
     void initialiseLibrary();
 
     void updateLibrary();
-    void parseDocumentation(String const& path);
 
-    Suggestions autocomplete(String query) const;
+    std::shared_ptr<LibrarySnapshot const> getSnapshot() const;
+
+    Suggestions autocomplete(String query, bool includeFuzzy = true, ObjectIndex::Narrowing* narrowing = nullptr) const;
+
+    // Maximum number of suggestions, the suggestion box doesn't show more than this
+    static constexpr int maxSuggestions = 20;
 
     String getInletOutletTooltip(String objname, int idx, int total, bool isInlet);
 
     void fsChangeCallback() override;
+    void fsFilesChanged(FileSystemWatcher::FileChanges const& changes) override;
     
     File findHelpfile(t_object* obj);
 
-    std::vector<File> helpPaths;
+    void addListener(Listener* listener);
+    void removeListener(Listener* listener);
 
-    LambdaThread* thread;
+private:
+    // Parts of the snapshot that an update rebuilds
+    enum Part {
+        Documentation = 1,
+        SearchIndex = 2,
+        HelpIndex = 4,
+        All = Documentation | SearchIndex | HelpIndex
+    };
 
-    ObjectMap getObjectDescriptions();
-    KeywordMap getObjectKeywords();
-    IODescriptionMap getInletDescriptions();
-    IODescriptionMap getOutletDescriptions();
-    ArgumentMap getArguments();
+    // Builds a new snapshot, parts that aren't rebuilt are copied from the current one
+    void update(t_pdinstance* pdinstance, int parts = All);
 
-    std::function<void()> appDirChanged;
+    // Changed documentation files are parsed in parallel, in chunks of this many files
+    static constexpr size_t minFilesPerThread = 32;
 
-private:
-    ObjectMap objectDescriptions;
-    KeywordMap objectKeywords;
-    IODescriptionMap inletDescriptions;
-    IODescriptionMap outletDescriptions;
-    ArgumentMap arguments;
+    void parseDocumentation(String const& path, LibrarySnapshot& snapshot);
+    void buildSearchIndex(t_pdinstance* pdinstance, LibrarySnapshot& snapshot);
+    void buildHelpIndex(LibrarySnapshot& snapshot);
 
-    std::mutex libraryLock;
+    // Made in the constructor and never replaced, so any thread can queue jobs on it
+    LambdaThread* thread;
+    std::once_flag initialised;
 
-    std::unique_ptr<Trie> searchTree = nullptr;
+    std::shared_ptr<LibrarySnapshot const> snapshot;
+    mutable SpinLock snapshotLock;
+
+    std::vector<File> helpPaths;
 
     File appDataDir;
+    File documentationDir;
     FileSystemWatcher watcher;
+
+    ListenerList<Listener> listeners;
+
+    // Only used on the library thread
+    LibraryCache cache;
+
+    SharedResourcePointer<TaskPool> tasks;
 };
 
 } // namespace pd
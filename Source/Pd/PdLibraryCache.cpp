@@ -0,0 +1,218 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "PdLibraryCache.h"
+
+namespace pd {
+
+namespace {
+
+void writeStrings(OutputStream& out, StringArray const& strings)
+{
+    out.writeInt(strings.size());
+    for (auto& string : strings)
+        out.writeString(string);
+}
+
+StringArray readStrings(InputStream& in)
+{
+    StringArray strings;
+    auto const size = in.readInt();
+    for (int i = 0; i < size && !in.isExhausted(); i++)
+        strings.add(in.readString());
+    return strings;
+}
+
+void writeIO(OutputStream& out, IODescription const& io)
+{
+    out.writeInt(io.size());
+    for (auto& [tooltip, repeating] : io) {
+        out.writeString(tooltip);
+        out.writeBool(repeating);
+    }
+}
+
+IODescription readIO(InputStream& in)
+{
+    IODescription io;
+    auto const size = in.readInt();
+    for (int i = 0; i < size && !in.isExhausted(); i++) {
+        auto tooltip = in.readString();
+        io.add({ tooltip, in.readBool() });
+    }
+    return io;
+}
+
+void writeDocumentation(OutputStream& out, DocumentationEntry const& entry)
+{
+    out.writeString(entry.name);
+    out.writeString(entry.description);
+    writeStrings(out, entry.keywords);
+
+    out.writeInt(static_cast<int>(entry.arguments.size()));
+    for (auto& [type, description, init] : entry.arguments) {
+        out.writeString(type);
+        out.writeString(description);
+        out.writeString(init);
+    }
+
+    writeIO(out, entry.inlets);
+    writeIO(out, entry.outlets);
+}
+
+DocumentationEntry readDocumentation(InputStream& in)
+{
+    DocumentationEntry entry;
+    entry.name = in.readString();
+    entry.description = in.readString();
+    entry.keywords = readStrings(in);
+
+    auto const numArguments = in.readInt();
+    for (int i = 0; i < numArguments && !in.isExhausted(); i++) {
+        auto type = in.readString();
+        auto description = in.readString();
+        auto init = in.readString();
+        entry.arguments.emplace_back(type, description, init);
+    }
+
+    entry.inlets = readIO(in);
+    entry.outlets = readIO(in);
+    return entry;
+}
+
+} // namespace
+
+LibraryCache::LibraryCache(File cacheFile)
+    : file(std::move(cacheFile))
+{
+}
+
+void LibraryCache::setFile(File newFile)
+{
+    file = std::move(newFile);
+}
+
+void LibraryCache::load()
+{
+    documentation.clear();
+    patchNames.clear();
+
+    MemoryMappedFile mapped(file, MemoryMappedFile::readOnly);
+    if (!mapped.getData())
+        return;
+
+    MemoryInputStream in(mapped.getData(), mapped.getSize(), false);
+
+    if (in.readInt() != magic || in.readInt() != version)
+        return;
+
+    auto const numDocumentation = in.readInt();
+    for (int i = 0; i < numDocumentation && !in.isExhausted(); i++) {
+        auto path = in.readString();
+        auto& cached = documentation[path];
+        cached.modified = in.readInt64();
+        cached.size = in.readInt64();
+        cached.documentation = readDocumentation(in);
+    }
+
+    auto const numPaths = in.readInt();
+    for (int i = 0; i < numPaths && !in.isExhausted(); i++) {
+        auto path = in.readString();
+        auto& cached = patchNames[path];
+        cached.stamp = in.readInt64();
+        cached.names = readStrings(in);
+    }
+}
+
+void LibraryCache::save()
+{
+    // Anything that was loaded but not used anymore has been removed
+    changed |= usedDocumentation.size() != documentation.size() || usedPatchNames.size() != patchNames.size();
+
+    documentation = std::move(usedDocumentation);
+    patchNames = std::move(usedPatchNames);
+    usedDocumentation.clear();
+    usedPatchNames.clear();
+
+    if (!std::exchange(changed, false) || file == File())
+        return;
+
+    MemoryOutputStream out;
+    out.writeInt(magic);
+    out.writeInt(version);
+
+    out.writeInt(static_cast<int>(documentation.size()));
+    for (auto& [path, cached] : documentation) {
+        out.writeString(path);
+        out.writeInt64(cached.modified);
+        out.writeInt64(cached.size);
+        writeDocumentation(out, cached.documentation);
+    }
+
+    out.writeInt(static_cast<int>(patchNames.size()));
+    for (auto& [path, cached] : patchNames) {
+        out.writeString(path);
+        out.writeInt64(cached.stamp);
+        writeStrings(out, cached.names);
+    }
+
+    file.replaceWithData(out.getData(), out.getDataSize());
+}
+
+DocumentationEntry const* LibraryCache::findDocumentation(RangedDirectoryIterator::value_type const& entry)
+{
+    auto const path = entry.getFile().getFullPathName();
+
+    auto it = documentation.find(path);
+    if (it == documentation.end() || it->second.modified != entry.getModificationTime().toMilliseconds() || it->second.size != entry.getFileSize())
+        return nullptr;
+
+    auto& used = usedDocumentation[path] = it->second;
+    return &used.documentation;
+}
+
+void LibraryCache::addDocumentation(RangedDirectoryIterator::value_type const& entry, DocumentationEntry newDocumentation)
+{
+    auto& cached = usedDocumentation[entry.getFile().getFullPathName()];
+    cached.modified = entry.getModificationTime().toMilliseconds();
+    cached.size = entry.getFileSize();
+    cached.documentation = std::move(newDocumentation);
+    changed = true;
+}
+
+StringArray const* LibraryCache::findPatchNames(File const& path, int64 stamp)
+{
+    auto it = patchNames.find(path.getFullPathName());
+    if (it == patchNames.end() || it->second.stamp != stamp)
+        return nullptr;
+
+    auto& used = usedPatchNames[it->first] = it->second;
+    return &used.names;
+}
+
+void LibraryCache::addPatchNames(File const& path, int64 stamp, StringArray names)
+{
+    auto& cached = usedPatchNames[path.getFullPathName()];
+    cached.stamp = stamp;
+    cached.names = std::move(names);
+    changed = true;
+}
+
+int64 LibraryCache::getFolderStamp(File const& path)
+{
+    auto folderStamp = [](File const& folder, Time modified) {
+        return static_cast<uint64>(folder.getFullPathName().hashCode64()) * 1099511628211ull + static_cast<uint64>(modified.toMilliseconds());
+    };
+
+    // Summed, so it doesn't depend on the order the folders are listed in
+    auto stamp = folderStamp(path, path.getLastModificationTime());
+    for (auto const& iter : RangedDirectoryIterator(path, true, "*", File::findDirectories))
+        stamp += folderStamp(iter.getFile(), iter.getModificationTime());
+
+    return static_cast<int64>(stamp);
+}
+
+} // namespace pd
@@ -0,0 +1,80 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace pd {
+
+using IODescription = juce::Array<std::pair<String, bool>>;
+using Arguments = std::vector<std::tuple<String, String, String>>;
+
+// Everything that is read from the documentation file of an object
+struct DocumentationEntry {
+    String name;
+    String description;
+    StringArray keywords;
+    Arguments arguments;
+    IODescription inlets;
+    IODescription outlets;
+};
+
+// Parsed library from the previous run, so that startup doesn't have to parse it again
+//! @details Documentation files are stored with their modification time and size, search paths
+//! with a stamp of the modification times of all their folders, which change whenever a file is
+//! added, removed or renamed. Anything that changed since is parsed again and replaces its old entry.
+//! The file is memory-mapped when loading, and only written when something changed, so that
+//! the file system watcher on the app folder doesn't trigger another update.
+class LibraryCache {
+public:
+    explicit LibraryCache(File cacheFile = File());
+
+    void setFile(File newFile);
+
+    void load();
+
+    // Writes everything that was used or added since the last save
+    void save();
+
+    // Returns the cached documentation if the file didn't change, and keeps it for the next save
+    DocumentationEntry const* findDocumentation(RangedDirectoryIterator::value_type const& entry);
+    void addDocumentation(RangedDirectoryIterator::value_type const& entry, DocumentationEntry documentation);
+
+    // Returns the cached patch names of a search path if none of its folders changed
+    StringArray const* findPatchNames(File const& path, int64 stamp);
+    void addPatchNames(File const& path, int64 stamp, StringArray names);
+
+    // Combines the modification times of all folders in a path
+    static int64 getFolderStamp(File const& path);
+
+private:
+    static constexpr int magic = 0x434c4450; // "PDLC"
+    static constexpr int version = 1;
+
+    struct CachedDocumentation {
+        int64 modified = 0;
+        int64 size = 0;
+        DocumentationEntry documentation;
+    };
+
+    struct CachedPatchNames {
+        int64 stamp = 0;
+        StringArray names;
+    };
+
+    File file;
+
+    // What was loaded, and what has been used or parsed since, which will be saved
+    std::unordered_map<String, CachedDocumentation> documentation, usedDocumentation;
+    std::unordered_map<String, CachedPatchNames> patchNames, usedPatchNames;
+
+    bool changed = false;
+};
+
+} // namespace pd
@@ -0,0 +1,229 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "PdLibraryPaths.h"
+
+#include <algorithm>
+
+extern "C" {
+#include "x_libpd_libpaths.h"
+}
+
+namespace pd {
+
+JUCE_IMPLEMENT_SINGLETON(LibraryPaths)
+
+LibraryPaths::LibraryPaths()
+{
+    watcher.addListener(this);
+    libpd_libpaths_set_resolver(resolve);
+}
+
+LibraryPaths::~LibraryPaths()
+{
+    libpd_libpaths_set_resolver(nullptr);
+    watcher.removeListener(this);
+    clearSingletonInstance();
+}
+
+StringArray LibraryPaths::setFolders(StringArray const& paths)
+{
+    StringArray current;
+    for (auto const& folder : folders)
+        current.add(folder.path);
+
+    // Every instance sets the same folders
+    if (current != paths) {
+        std::vector<Folder> listed;
+        for (auto const& path : paths)
+            listed.push_back(listFolder(path));
+
+        {
+            ScopedLock const scopedLock(lock);
+            folders.swap(listed);
+        }
+
+        watcher.removeAllFolders();
+        for (auto const& path : paths)
+            watcher.addFolder(File(path));
+    }
+
+    StringArray onSearchPath;
+    for (auto const& folder : folders) {
+        if (folder.hasLibraryBinary)
+            onSearchPath.add(folder.path);
+    }
+
+    return onSearchPath;
+}
+
+LibraryPaths::Folder LibraryPaths::listFolder(String const& path)
+{
+    Folder folder;
+    folder.path = path;
+
+    auto const folderName = File(path).getFileName().toLowerCase();
+
+    for (auto const& entry : RangedDirectoryIterator(File(path), false, "*", File::findFilesAndDirectories)) {
+        auto const file = entry.getFile();
+        auto const name = file.getFileName().toLowerCase();
+
+        // pd also looks for name/name.extension
+        if (entry.isDirectory()) {
+            folder.names.insert(name);
+            continue;
+        }
+
+        auto const stem = file.getFileNameWithoutExtension().toLowerCase();
+        auto const extension = file.getFileExtension().toLowerCase();
+
+        folder.names.insert(stem);
+
+        // Files of objects that end with ~ may be called _tilde instead
+        auto const name = stem.endsWith("_tilde") ? stem.dropLastCharacters(6) + "~" : stem;
+        folder.names.insert(name);
+
+        if (isExternalBinary(extension))
+            folder.binaries.emplace(name, file.getFullPathName());
+
+        if (stem == folderName && extension != ".pd" && extension != ".pat" && extension != ".txt")
+            folder.hasLibraryBinary = true;
+    }
+
+    return folder;
+}
+
+bool LibraryPaths::isExternalBinary(String const& extension)
+{
+    // The extensions pd tries for this platform, see sys_dllextent
+#if JUCE_LINUX || JUCE_BSD
+    return extension == ".pd_linux" || extension == ".so" || extension.startsWith(".l_");
+#elif JUCE_MAC
+    return extension == ".pd_darwin" || extension == ".so" || extension.startsWith(".d_");
+#elif JUCE_WINDOWS
+    return extension == ".dll" || extension.startsWith(".m_");
+#else
+    return false;
+#endif
+}
+
+std::unordered_set<String> LibraryPaths::getObjectNames(char const* text, size_t size)
+{
+    std::unordered_set<String> names;
+
+    auto const* end = text + size;
+    auto isSpace = [](char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; };
+
+    // Objects are "#X obj x y name ...;", the name ends at a space or at the end of the line
+    static constexpr char const marker[] = "#X obj ";
+    for (auto const* p = text; (p = std::search(p, end, marker, marker + 7)) != end;) {
+        p += 7;
+
+        // Skip the position
+        for (int field = 0; field < 2; field++) {
+            while (p != end && !isSpace(*p) && *p != ';')
+                p++;
+            while (p != end && isSpace(*p))
+                p++;
+        }
+
+        auto const* start = p;
+        bool usable = true;
+        while (p != end && !isSpace(*p) && *p != ';' && *p != ',') {
+            usable = usable && *p != '/' && *p != '$' && *p != '\\';
+            p++;
+        }
+
+        if (usable && p != start && !CharacterFunctions::isDigit(*start) && *start != '-')
+            names.insert(String::fromUTF8(start, static_cast<int>(p - start)).toLowerCase());
+    }
+
+    return names;
+}
+
+void LibraryPaths::preloadExternals(File const& patchFile)
+{
+    MemoryMappedFile mappedFile(patchFile, MemoryMappedFile::readOnly);
+    if (!mappedFile.getData())
+        return;
+
+    auto const names = getObjectNames(static_cast<char const*>(mappedFile.getData()), mappedFile.getSize());
+
+    StringArray toLoad;
+    {
+        ScopedLock const scopedLock(lock);
+        for (auto const& name : names) {
+            for (auto const& folder : folders) {
+                if (auto it = folder.binaries.find(name); it != folder.binaries.end()) {
+                    if (preloadedPaths.insert(it->second).second)
+                        toLoad.add(it->second);
+                    break;
+                }
+            }
+        }
+    }
+
+    if (toLoad.isEmpty())
+        return;
+
+    // The system loader maps one library at a time, but reading them from disk and resolving
+    // their dependencies overlaps. pd's own dlopen of the same file later only bumps a count
+    CriticalSection loadedLock;
+    for (auto const& path : toLoad) {
+        preloadPool.addJob([this, path, &loadedLock]() {
+            auto library = std::make_unique<DynamicLibrary>();
+            if (library->open(path)) {
+                ScopedLock const scopedLock(loadedLock);
+                preloaded.add(library.release());
+            }
+        });
+    }
+
+    while (preloadPool.getNumJobs() > 0)
+        Thread::sleep(1);
+}
+
+int LibraryPaths::resolve(char const* name, char* dir, int size)
+{
+    auto* paths = getInstanceWithoutCreating();
+    if (!paths)
+        return 0;
+
+    auto const key = String::fromUTF8(name).toLowerCase();
+
+    ScopedLock const scopedLock(paths->lock);
+    for (auto const& folder : paths->folders) {
+        if (folder.names.count(key)) {
+            // pd uses forward slashes on every platform
+            folder.path.replaceCharacter('\\', '/').copyToUTF8(dir, static_cast<size_t>(size));
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void LibraryPaths::fsFilesChanged(FileSystemWatcher::FileChanges const& changes)
+{
+    std::vector<Folder> listed;
+
+    for (auto const& folder : folders) {
+        auto const directory = File(folder.path);
+
+        // An empty set means the backend couldn't tell what changed
+        bool changed = changes.empty();
+        for (auto const& [file, fsEvent] : changes) {
+            changed = changed || file.getParentDirectory() == directory;
+        }
+
+        listed.push_back(changed ? listFolder(folder.path) : folder);
+    }
+
+    ScopedLock const scopedLock(lock);
+    folders.swap(listed);
+}
+
+} // namespace pd
@@ -0,0 +1,76 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../Utility/FileSystemWatcher.h"
+
+namespace pd {
+
+// Listings of the folders of installed libraries, so pd only searches the folder that has what it looks for
+//! @details Shared by every instance. These folders aren't on pd's search path, a name pd can't find on its
+//! own is looked up in the listings, and the folder that has it is added to the search path of that instance
+//! (see x_libpd_libpaths.h). Names are kept in lowercase without their extension, since the file systems on
+//! macOS and Windows ignore case. A folder is listed again when something in it changes.
+//! Folders with a binary named after the folder stay on the search path the usual way: that's a library
+//! that can be loaded with [declare -lib], which pd looks for without asking.
+//! The listings also know which names are compiled externals, so the binaries a patch needs can be
+//! loaded in parallel before pd opens it. pd then finds them already loaded and only runs their setup.
+class LibraryPaths : public DeletedAtShutdown
+    , private FileSystemWatcher::Listener {
+public:
+    LibraryPaths();
+    ~LibraryPaths() override;
+
+    // Lists these folders from now on, returns the ones that need to be on the search path anyway
+    StringArray setFolders(StringArray const& paths);
+
+    // Loads the binaries of the externals that a patch file uses, before pd gets to them
+    // Called by the thread that opens the patch, it returns once they're loaded
+    void preloadExternals(File const& patchFile);
+
+    JUCE_DECLARE_SINGLETON(LibraryPaths, false)
+
+private:
+    struct Folder {
+        String path;
+        std::unordered_set<String> names;
+        std::unordered_map<String, String> binaries; // Path of the binary for each name that has one
+        bool hasLibraryBinary = false;
+    };
+
+    static Folder listFolder(String const& path);
+
+    static bool isExternalBinary(String const& extension);
+
+    // Names of the objects in the text of a patch, without numbers and names with a folder or a $ in them
+    static std::unordered_set<String> getObjectNames(char const* text, size_t size);
+
+    // Called by pd, from the thread of any instance
+    static int resolve(char const* name, char* dir, int size);
+
+    void fsChangeCallback() override { }
+    void fsFilesChanged(FileSystemWatcher::FileChanges const& changes) override;
+
+    // Held while pd reads the listings, they're only changed by the message thread
+    CriticalSection lock;
+    std::vector<Folder> folders;
+
+    // Binaries that were preloaded, they stay loaded like pd keeps the externals it loads
+    OwnedArray<DynamicLibrary> preloaded;
+    std::unordered_set<String> preloadedPaths;
+    ThreadPool preloadPool { jlimit(1, 8, SystemStats::getNumCpus()) };
+
+    FileSystemWatcher watcher;
+};
+
+} // namespace pd
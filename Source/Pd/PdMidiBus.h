@@ -0,0 +1,265 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <vector>
+
+namespace pd {
+
+// Midi for each of pd's midi ports. Like in pd, [notein] and [noteout] number the channels of
+// port n as 16n+1 to 16n+16
+//! @details Every port is a MidiBuffer, which keeps its events packed back-to-back in one block
+//! of memory, so adding an event only copies its bytes. Everything is reserved up front, nothing
+//! is allocated afterwards unless a port gets more than it was sized for.
+//! Only one thread may use a bus at a time.
+class MidiBus {
+public:
+    static constexpr int maxPorts = 16;
+
+    // Longer sysex messages from pd's byte stream are cut off
+    static constexpr size_t maxSysexSize = 65536;
+
+    // Messages for ports the bus doesn't have go to port 0
+    MidiBus(int numPorts, size_t bytesPerPort)
+        : ports(static_cast<size_t>(jlimit(1, maxPorts, numPorts)))
+        , streams(ports.size())
+    {
+        for (auto& port : ports)
+            port.ensureSize(bytesPerPort);
+
+        sysex.reserve(maxSysexSize);
+    }
+
+    int getNumPorts() const
+    {
+        return static_cast<int>(ports.size());
+    }
+
+    MidiBuffer& operator[](int port)
+    {
+        return ports[indexOf(port)];
+    }
+
+    MidiBuffer const& operator[](int port) const
+    {
+        return ports[indexOf(port)];
+    }
+
+    void add(int port, uint8 const* data, int size, int position)
+    {
+        ports[indexOf(port)].addEvent(data, size, position);
+    }
+
+    // Assembles messages from single bytes, as [midiout] sends them
+    // A sysex message is collected until its 0xf7, only one at a time for all ports
+    void addByte(int port, int byte, int position)
+    {
+        auto const index = indexOf(port);
+        auto& stream = streams[index];
+
+        if (stream.isSysex) {
+            if (byte == 0xf7) {
+                sysex.push_back(0xf7);
+                ports[index].addEvent(sysex.data(), static_cast<int>(sysex.size()), position);
+                sysex.clear();
+                stream.isSysex = false;
+            } else if (sysex.size() < maxSysexSize - 1) {
+                sysex.push_back(static_cast<uint8>(byte));
+            }
+        } else if (stream.size == 0 && byte == 0xf0) {
+            for (auto& other : streams)
+                other.isSysex = false;
+
+            sysex.clear();
+            sysex.push_back(0xf0);
+            stream.isSysex = true;
+        } else {
+            stream.bytes[stream.size++] = static_cast<uint8>(byte);
+            if (stream.size >= 3) {
+                ports[index].addEvent(stream.bytes, 3, position);
+                stream.size = 0;
+            }
+        }
+    }
+
+    bool isEmpty() const
+    {
+        for (auto const& port : ports) {
+            if (!port.isEmpty())
+                return false;
+        }
+        return true;
+    }
+
+    void clear()
+    {
+        for (int port = 0; port < getNumPorts(); port++)
+            clear(port);
+    }
+
+    // Also forgets a message that was being assembled from bytes
+    void clear(int port)
+    {
+        auto const index = indexOf(port);
+        ports[index].clear();
+
+        auto& stream = streams[index];
+        if (stream.isSysex)
+            sysex.clear();
+
+        stream = ByteStream();
+    }
+
+private:
+    size_t indexOf(int port) const
+    {
+        return isPositiveAndBelow(port, getNumPorts()) ? static_cast<size_t>(port) : 0;
+    }
+
+    struct ByteStream {
+        uint8 bytes[3] = { 0 };
+        int size = 0;
+        bool isSysex = false;
+    };
+
+    std::vector<MidiBuffer> ports;
+    std::vector<ByteStream> streams;
+    std::vector<uint8> sysex;
+};
+
+// Hands the midi of a device to the audio thread without locking
+//! @details Single producer, single consumer: the device's thread writes, the audio thread reads.
+//! Messages keep the time they arrived, and are spread over the next block the way they arrived,
+//! so a burst from a controller doesn't end up on one sample. What doesn't fit is dropped.
+class MidiInputRing : public MidiInputCallback {
+public:
+    explicit MidiInputRing(int capacityInBytes)
+        : fifo(capacityInBytes)
+        , storage(static_cast<size_t>(capacityInBytes))
+        , scratch(static_cast<size_t>(capacityInBytes))
+    {
+    }
+
+    void handleIncomingMidiMessage(MidiInput*, MidiMessage const& message) override
+    {
+        push(message.getRawData(), message.getRawDataSize(), message.getTimeStamp());
+    }
+
+    // The time is in seconds of Time::getMillisecondCounterHiRes(), like that of messages from a MidiInput
+    bool push(uint8 const* data, int size, double time)
+    {
+        Header const header { time, size };
+        auto const total = static_cast<int>(sizeof(Header)) + size;
+
+        if (size <= 0 || fifo.getFreeSpace() < total) {
+            numDropped++;
+            return false;
+        }
+
+        auto scope = fifo.write(total);
+        int written = 0;
+        copyIn(scope, written, &header, sizeof(Header));
+        copyIn(scope, written, data, size);
+        return true;
+    }
+
+    // Adds what arrived since the last block to buffer, which is numSamples long
+    void removeNextBlockOfMessages(MidiBuffer& buffer, int numSamples, double sampleRate)
+    {
+        auto const now = Time::getMillisecondCounterHiRes() * 0.001;
+        auto const blockStart = lastBlockTime > 0.0 ? lastBlockTime : now - numSamples / sampleRate;
+        lastBlockTime = now;
+
+        auto const numReady = fifo.getNumReady();
+        if (numReady == 0 || numSamples <= 0)
+            return;
+
+        // Squeezed into the block when the callbacks came further apart than a block
+        auto const samplesPerSecond = std::min(sampleRate, numSamples / std::max(now - blockStart, 1e-6));
+
+        auto scope = fifo.read(numReady);
+        int read = 0;
+        while (read < numReady) {
+            Header header;
+            copyOut(scope, read, &header, sizeof(Header));
+            copyOut(scope, read, scratch.data(), header.size);
+
+            auto const position = jlimit(0, numSamples - 1, static_cast<int>((header.time - blockStart) * samplesPerSecond));
+            buffer.addEvent(scratch.data(), header.size, position);
+        }
+    }
+
+    // Forgets what's waiting, only while the audio thread isn't reading
+    void reset()
+    {
+        fifo.read(fifo.getNumReady());
+        lastBlockTime = 0.0;
+    }
+
+    int getNumDropped() const
+    {
+        return numDropped.load();
+    }
+
+private:
+    struct Header {
+        double time;
+        int size;
+    };
+
+    void copyIn(AbstractFifo::ScopedWrite const& scope, int& offset, void const* data, int size)
+    {
+        copy(scope.startIndex1, scope.blockSize1, scope.startIndex2, offset, size, [this, data](int index, int dataOffset, int count) {
+            std::memcpy(storage.data() + index, static_cast<uint8 const*>(data) + dataOffset, static_cast<size_t>(count));
+        });
+    }
+
+    void copyOut(AbstractFifo::ScopedRead const& scope, int& offset, void* data, int size)
+    {
+        copy(scope.startIndex1, scope.blockSize1, scope.startIndex2, offset, size, [this, data](int index, int dataOffset, int count) {
+            std::memcpy(static_cast<uint8*>(data) + dataOffset, storage.data() + index, static_cast<size_t>(count));
+        });
+    }
+
+    // Splits size bytes at offset in the scope into the parts before and after the end of the storage
+    template<typename Copier>
+    static void copy(int start1, int size1, int start2, int& offset, int size, Copier&& copier)
+    {
+        auto const first = jlimit(0, size, size1 - offset);
+        if (first > 0)
+            copier(start1 + offset, 0, first);
+        if (size > first)
+            copier(start2 + offset + first - size1, first, size - first);
+
+        offset += size;
+    }
+
+    AbstractFifo fifo;
+    std::vector<uint8> storage;
+
+    // Only used by the audio thread, for messages that wrap around the end of the storage
+    std::vector<uint8> scratch;
+    double lastBlockTime = 0.0;
+
+    std::atomic<int> numDropped = 0;
+};
+
+// Connects pd's midi ports to midi devices of their own, for the standalone
+class MidiDevicePorts {
+public:
+    virtual ~MidiDevicePorts() = default;
+
+    // Can be added to the device manager as the callback of a device
+    virtual MidiInputCallback* getMidiInputPort(int port) = 0;
+
+    // Called with nullptr before the device is closed
+    virtual void setMidiOutputPort(int port, MidiOutput* output) = 0;
+};
+
+}
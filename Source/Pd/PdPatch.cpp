@@ -8,7 +8,6 @@
 
 #include "PdInstance.h"
 #include "PdStorage.h"
-#include "../Objects/GUIObject.h"
 
 extern "C" {
 #include <m_pd.h>
@@ -18,6 +17,7 @@ extern "C" {
 #include "g_undo.h"
 #include "x_libpd_extra_utils.h"
 #include "x_libpd_multi.h"
+#include "s_libpd_inter.h"
 
 struct _instanceeditor {
     t_binbuf* copy_binbuf;
@@ -87,6 +87,29 @@ void Patch::close()
     libpd_closefile(ptr);
 }
 
+Patch::MemoryUsage Patch::getMemoryUsage() const
+{
+    MemoryUsage usage;
+    if (!ptr)
+        return usage;
+
+    t_libpd_memory_report report;
+
+    instance->getCallbackLock()->enter();
+    libpd_canvas_get_memory(getPointer(), &report);
+    usage.undo = libpd_undo_get_memory(getPointer(), &usage.numUndoActions);
+    instance->getCallbackLock()->exit();
+
+    usage.objects = report.r_objects;
+    usage.text = report.r_text;
+    usage.arrays = report.r_arrays;
+    usage.clones = report.r_clones;
+    usage.numObjects = report.r_numobjects;
+    usage.numArrays = report.r_numarrays;
+    usage.numClones = report.r_numclones;
+    return usage;
+}
+
 bool Patch::isDirty() const
 {
     return getPointer()->gl_dirty;
@@ -99,6 +122,8 @@ void Patch::savePatch(File const& location)
 
     auto* dir = gensym(fullPathname.toRawUTF8());
     auto* file = gensym(filename.toRawUTF8());
+
+    Storage::storeAll(instance);
     libpd_savetofile(getPointer(), file, dir);
 
     setTitle(filename);
@@ -115,6 +140,7 @@ void Patch::savePatch()
     auto* dir = gensym(fullPathname.toRawUTF8());
     auto* file = gensym(filename.toRawUTF8());
 
+    Storage::storeAll(instance);
     libpd_savetofile(getPointer(), file, dir);
 
     setTitle(filename);
@@ -152,8 +178,25 @@ void Patch::setCurrent(bool lock)
         instance->getCallbackLock()->exit();
 }
 
+Patch::IndexScope::IndexScope(Patch& p, PatchSnapshot const& snapshot)
+    : patch(p)
+    , previous(p.indexedSnapshot)
+{
+    patch.indexedSnapshot = &snapshot;
+}
+
+Patch::IndexScope::~IndexScope()
+{
+    patch.indexedSnapshot = previous;
+}
+
 int Patch::getIndex(void* obj)
 {
+    if (indexedSnapshot) {
+        auto it = indexedSnapshot->indices.find(obj);
+        return it != indexedSnapshot->indices.end() ? static_cast<int>(it->second) : -1;
+    }
+
     int i = 0;
     auto* cnv = getPointer();
 
@@ -171,36 +214,71 @@ int Patch::getIndex(void* obj)
     return -1;
 }
 
-Connections Patch::getConnections() const
+// Only call with the audio lock held
+static void readConnections(t_canvas* cnv, Connections& connections)
 {
-
-    Connections connections;
-
-    // instance->getCallbackLock()->enter();
-
     t_outconnect* oc;
     t_linetraverser t;
-    auto* x = getPointer();
 
-    // Get connections from pd
-    linetraverser_start(&t, x);
+    linetraverser_start(&t, cnv);
 
-    // TODO: fix data race
     while ((oc = linetraverser_next(&t))) {
         connections.push_back({ t.tr_inno, t.tr_ob, t.tr_outno, t.tr_ob2 });
     }
+}
 
-    // instance->getCallbackLock()->exit();
+Connections Patch::getConnections() const
+{
+    Connections connections;
+    if (!ptr)
+        return connections;
+
+    instance->getCallbackLock()->enter();
+    readConnections(getPointer(), connections);
+    instance->getCallbackLock()->exit();
 
     return connections;
 }
 
+std::shared_ptr<PatchSnapshot const> Patch::getSnapshot() const
+{
+    static std::atomic<uint64> lastVersion = 0;
+
+    auto snapshot = std::make_shared<PatchSnapshot>();
+    if (!ptr)
+        return snapshot;
+
+    instance->getCallbackLock()->enter();
+
+    for (t_gobj* y = getPointer()->gl_list; y; y = y->g_next) {
+        if (Storage::isInfoParent(y))
+            continue;
+
+        snapshot->objects.push_back(y);
+        snapshot->states.push_back(getObjectState(y));
+    }
+
+    readConnections(getPointer(), snapshot->connections);
+
+    instance->getCallbackLock()->exit();
+
+    snapshot->indices.reserve(snapshot->objects.size());
+    for (size_t i = 0; i < snapshot->objects.size(); i++)
+        snapshot->indices.emplace(snapshot->objects[i], i);
+
+    snapshot->version = ++lastVersion;
+    return snapshot;
+}
+
 std::vector<void*> Patch::getObjects(bool onlyGui)
 {
     if (ptr) {
         std::vector<void*> objects;
         t_canvas const* cnv = getPointer();
 
+        // pd's thread could be changing the list
+        instance->getCallbackLock()->enter();
+
         for (t_gobj* y = cnv->gl_list; y; y = y->g_next) {
             if (Storage::isInfoParent(y))
                 continue;
@@ -210,11 +288,48 @@ std::vector<void*> Patch::getObjects(bool onlyGui)
             }
         }
 
+        instance->getCallbackLock()->exit();
+
         return objects;
     }
     return {};
 }
 
+std::vector<ObjectState> Patch::getObjectStates() const
+{
+    std::vector<ObjectState> states;
+    if (!ptr)
+        return states;
+
+    instance->getCallbackLock()->enter();
+
+    for (t_gobj* y = getPointer()->gl_list; y; y = y->g_next) {
+        if (!Storage::isInfoParent(y))
+            states.push_back(getObjectState(y));
+    }
+
+    instance->getCallbackLock()->exit();
+
+    return states;
+}
+
+ObjectState Patch::getObjectState(void* obj) const
+{
+    ObjectState state;
+    state.object = obj;
+
+    int x = 0, y = 0, w = 0, h = 0;
+    libpd_get_object_bounds(getPointer(), obj, &x, &y, &w, &h);
+    state.bounds = { x, y, w, h };
+
+    // Scalars aren't patchable objects
+    if (auto* object = checkObject(obj))
+        state.textWidth = object->te_width;
+
+    state.fontWidth = glist_fontwidth(getPointer());
+    return state;
+}
+
 void* Patch::createGraphOnParent(int x, int y)
 {
     t_pd* pdobject = nullptr;
@@ -257,11 +372,8 @@ void* Patch::createGraph(String const& name, int size, int x, int y)
     return pdobject;
 }
 
-void* Patch::createObject(String const& name, int x, int y)
+std::function<void*()> Patch::makeCreator(String const& name, int x, int y)
 {
-    if (!ptr)
-        return nullptr;
-
     StringArray tokens;
     tokens.addTokens(name, false);
 
@@ -295,9 +407,15 @@ void* Patch::createObject(String const& name, int x, int y)
     }
 
     if (tokens[0] == "graph" && tokens.size() == 3) {
-        return createGraph(tokens[1], tokens[2].getIntValue(), x, y);
+        return [this, graphName = tokens[1], size = tokens[2].getIntValue(), x, y]() -> void* {
+            setCurrent();
+            return libpd_creategraph(getPointer(), graphName.toRawUTF8(), size, x, y);
+        };
     } else if (tokens[0] == "graph") {
-        return createGraphOnParent(x, y);
+        return [this, x, y]() -> void* {
+            setCurrent();
+            return libpd_creategraphonparent(getPointer(), x, y);
+        };
     }
 
     t_symbol* typesymbol = gensym("obj");
@@ -343,13 +461,39 @@ void* Patch::createObject(String const& name, int x, int y)
         }
     }
 
-    t_pd* pdobject = nullptr;
+    return [this, argc, argv, typesymbol]() mutable -> void* {
+        setCurrent();
+        return libpd_createobj(getPointer(), typesymbol, argc, argv.data());
+    };
+}
+
+std::vector<void*> Patch::createObjects(std::vector<ObjectDescription> const& objects, std::vector<ConnectionDescription> const& connections)
+{
+    Transaction transaction(*this);
+
+    for (auto const& object : objects)
+        transaction.createObject(object.name, object.x, object.y);
+
+    // Handles of the created objects are their index in the list
+    for (auto const& connection : connections)
+        transaction.createConnection(connection.src, connection.nout, connection.sink, connection.nin);
+
+    return transaction.perform();
+}
+
+void* Patch::createObject(String const& name, int x, int y)
+{
+    if (!ptr)
+        return nullptr;
+
+    auto create = makeCreator(name, x, y);
+
+    void* pdobject = nullptr;
     std::atomic<bool> done = false;
 
     instance->enqueueFunction(
-        [this, argc, argv, typesymbol, &pdobject, &done]() mutable {
-            setCurrent();
-            pdobject = libpd_createobj(getPointer(), typesymbol, argc, argv.data());
+        [&create, &pdobject, &done]() mutable {
+            pdobject = create();
             done = true;
         });
 
@@ -408,22 +552,47 @@ void* Patch::renameObject(void* obj, String const& name)
     return libpd_newest(getPointer());
 }
 
-void Patch::copy()
+void Patch::copy(std::vector<Clipboard::ConnectionInfo> connections)
 {
     instance->enqueueFunction(
-        [this]() {
+        [this, connections]() {
             int size;
             const char* text = libpd_copy(getPointer(), &size);
             auto copied = String::fromUTF8(text, size);
-            MessageManager::callAsync([copied]() mutable { SystemClipboard::copyTextToClipboard(copied); });
+            freebytes(const_cast<char*>(text), static_cast<size_t>(size));
+
+            char* buf;
+            int bufsize;
+            libpd_copy_binary(&buf, &bufsize);
+            auto binary = MemoryBlock(buf, static_cast<size_t>(bufsize));
+            freebytes(buf, static_cast<size_t>(bufsize));
+
+            MessageManager::callAsync([copied, binary, connections]() mutable {
+                SystemClipboard::copyTextToClipboard(copied);
+
+                auto& clipboard = Clipboard::get();
+                clipboard.text = std::move(copied);
+                clipboard.binary = std::move(binary);
+                clipboard.connections = std::move(connections);
+            });
         });
 }
 
-void Patch::paste()
+bool Patch::paste()
 {
+    // Copied in this process, so the text doesn't have to be parsed
+    auto const& clipboard = Clipboard::get();
+    if (clipboard.isCurrent()) {
+        instance->enqueueFunction([this, binary = clipboard.binary]() {
+            libpd_paste_binary(getPointer(), static_cast<char const*>(binary.getData()), binary.getSize());
+        });
+        return true;
+    }
+
     auto text = SystemClipboard::getTextFromClipboard();
 
     instance->enqueueFunction([this, text]() mutable { libpd_paste(getPointer(), text.toRawUTF8()); });
+    return false;
 }
 
 void Patch::duplicate()
@@ -577,17 +746,15 @@ void Patch::removeSelection()
         });
 }
 
-void Patch::startUndoSequence(String name)
+void Patch::performUndoSequence(String const& name, std::function<void()> edits)
 {
-    instance->enqueueFunction([this, name]() {
-        canvas_undo_add(getPointer(), UNDO_SEQUENCE_START, name.toRawUTF8(), 0);
-    });
-}
+    // Starting and ending the sequence in one function means the DSP graph can't be left suspended
+    instance->enqueueFunction([this, name, edits = std::move(edits)]() {
+        auto* cnv = getPointer();
+        libpd_start_undo_sequence(cnv, name.toRawUTF8());
 
-void Patch::endUndoSequence(String name)
-{
-    instance->enqueueFunction([this, name]() {
-        canvas_undo_add(getPointer(), UNDO_SEQUENCE_END, name.toRawUTF8(), 0);
+        ScopeGuard const endSequence { [cnv, &name]() { libpd_end_undo_sequence(cnv, name.toRawUTF8()); } };
+        edits();
     });
 }
 
@@ -645,7 +812,7 @@ void Patch::keyPress(int keycode, int shift)
 
 String Patch::getTitle() const
 {
-    String name = String::fromUTF8(getPointer()->gl_name->s_name);
+    String name = instance->symbols.toString(getPointer()->gl_name);
     return name.isEmpty() ? "Untitled Patcher" : name;
 }
 
@@ -655,9 +822,123 @@ void Patch::setTitle(String const& title)
         return;
 
     canvas_unbind(getPointer());
-    getPointer()->gl_name = gensym(title.toRawUTF8());
+    getPointer()->gl_name = instance->symbols.toSymbol(title);
     canvas_bind(getPointer());
     instance->titleChanged();
 }
 
+Patch::Transaction::Transaction(Patch& p)
+    : patch(p)
+{
+}
+
+int Patch::Transaction::addObject(void* object)
+{
+    handles.push_back(object);
+    return static_cast<int>(handles.size() - 1);
+}
+
+int Patch::Transaction::createObject(String const& name, int x, int y)
+{
+    auto handle = addObject(nullptr);
+
+    edits.push_back([handle, create = patch.makeCreator(name, x, y)](std::vector<void*>& objects) mutable {
+        objects[handle] = create();
+    });
+
+    return handle;
+}
+
+void Patch::Transaction::removeObject(int object)
+{
+    edits.push_back([&p = patch, object](std::vector<void*>& objects) {
+        if (!objects[object])
+            return;
+
+        p.setCurrent();
+        libpd_removeobj(p.getPointer(), &checkObject(objects[object])->te_g);
+        objects[object] = nullptr;
+    });
+}
+
+void Patch::Transaction::createConnection(int src, int nout, int sink, int nin)
+{
+    edits.push_back([&p = patch, src, nout, sink, nin](std::vector<void*>& objects) {
+        if (!objects[src] || !objects[sink])
+            return;
+
+        auto* srcObject = checkObject(objects[src]);
+        auto* sinkObject = checkObject(objects[sink]);
+
+        if (!libpd_canconnect(p.getPointer(), srcObject, nout, sinkObject, nin))
+            return;
+
+        p.setCurrent();
+        libpd_createconnection(p.getPointer(), srcObject, nout, sinkObject, nin);
+    });
+}
+
+void Patch::Transaction::removeConnection(int src, int nout, int sink, int nin)
+{
+    edits.push_back([&p = patch, src, nout, sink, nin](std::vector<void*>& objects) {
+        if (!objects[src] || !objects[sink])
+            return;
+
+        p.setCurrent();
+        libpd_removeconnection(p.getPointer(), checkObject(objects[src]), nout, checkObject(objects[sink]), nin);
+    });
+}
+
+std::vector<void*> Patch::Transaction::perform()
+{
+    if (!patch.ptr)
+        return handles;
+
+    std::atomic<bool> done = false;
+
+    patch.instance->enqueueFunction(
+        [this, &done]() mutable {
+            apply(edits, handles);
+            done = true;
+        });
+
+    while (!done) {
+        patch.instance->waitForStateUpdate();
+    }
+
+    edits.clear();
+    return handles;
+}
+
+void Patch::Transaction::apply(std::vector<Edit>& edits, std::vector<void*>& objects)
+{
+    // Rebuild the DSP graph once at the end, instead of after every object and connection
+    suspend_dsp_updates();
+
+    for (auto& edit : edits)
+        edit(objects);
+
+    resume_dsp_updates();
+}
+
+void Patch::Transaction::performAsync(std::function<void(std::vector<void*> const&)> onDone)
+{
+    if (!patch.ptr)
+        return;
+
+    patch.instance->enqueueFunction(
+        [edits = std::move(edits), objects = handles, onDone = std::move(onDone)]() mutable {
+            apply(edits, objects);
+
+            if (onDone) {
+                MessageManager::callAsync([onDone = std::move(onDone), objects = std::move(objects)]() {
+                    onDone(objects);
+                });
+            }
+        });
+
+    edits.clear();
+}
+
 } // namespace pd
+
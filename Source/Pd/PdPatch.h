@@ -8,8 +8,12 @@
 #include <JuceHeader.h>
 
 #include <array>
+#include <functional>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
+#include "PdClipboard.h"
 #include "PdStorage.h"
 
 extern "C" {
@@ -19,8 +23,35 @@ extern "C" {
 namespace pd {
 
 using Connections = std::vector<std::tuple<int, t_object*, int, t_object*>>;
+
+// Structural change to a canvas, as reported by x_libpd_mod_utils
+//! @details Pointers in an event are only used to identify objects, they might have been
+//! freed by the time the event is received.
+using CanvasEvent = t_libpd_canvas_event;
 class Instance;
 
+// What the editor needs to lay out an object, copied from pd
+struct ObjectState {
+    void* object = nullptr;
+    Rectangle<int> bounds; // as libpd_get_object_bounds reports them
+    int textWidth = 0;     // te_width, in characters
+    int fontWidth = 0;     // glist_fontwidth of the patch
+};
+
+// The structure of a patch as the editor sees it, read from pd in one go
+//! @details Taken under one acquisition of the audio lock, so the objects, their states and the
+//! connections all belong to the same moment, and the editor reads them afterwards without locking.
+//! A snapshot isn't changed after it's made, a later snapshot has a higher version.
+struct PatchSnapshot {
+    uint64 version = 0;
+    std::vector<void*> objects;      // in pd's order
+    std::vector<ObjectState> states; // in the same order
+    Connections connections;
+
+    // Position of every object in objects, so the editor never has to search for one
+    std::unordered_map<void*, size_t> indices;
+};
+
 // The Pd patch.
 //! @details The class is a wrapper around a Pd patch. The lifetime of the internal patch\n
 //! is not guaranteed by the class.
@@ -45,6 +76,59 @@ public:
 
     void* createObject(String const& name, int x, int y);
     void removeObject(void* obj);
+
+    // Edits that are sent to pd together, so they only need one round-trip to pd's thread
+    //! @details Objects that are created by the transaction don't exist until it's performed,
+    //! so edits refer to objects by the handle that createObject or addObject returned.
+    //! Edits on objects that couldn't be created are skipped.
+    class Transaction {
+    public:
+        explicit Transaction(Patch& patch);
+
+        // Gets a handle for an object that already exists
+        int addObject(void* object);
+
+        int createObject(String const& name, int x, int y);
+        void removeObject(int object);
+
+        void createConnection(int src, int nout, int sink, int nin);
+        void removeConnection(int src, int nout, int sink, int nin);
+
+        // Performs all edits and waits for them, returns the object of every handle
+        std::vector<void*> perform();
+
+        // Performs all edits without waiting, onDone is called on the message thread with the object of every handle
+        void performAsync(std::function<void(std::vector<void*> const&)> onDone = nullptr);
+
+    private:
+        using Edit = std::function<void(std::vector<void*>&)>;
+
+        // Called on pd's thread
+        static void apply(std::vector<Edit>& edits, std::vector<void*>& objects);
+
+        Patch& patch;
+        std::vector<void*> handles;
+        std::vector<Edit> edits;
+    };
+
+    struct ObjectDescription {
+        String name;
+        int x = 0;
+        int y = 0;
+    };
+
+    // Connection between two objects, by their index in the list of objects
+    struct ConnectionDescription {
+        int src = 0;
+        int nout = 0;
+        int sink = 0;
+        int nin = 0;
+    };
+
+    // Builds a whole set of objects and connections in one transaction, returns the created objects
+    //! @details The DSP graph is only rebuilt once, after everything was created. The canvas
+    //! isn't updated, so call Canvas::synchronise once afterwards.
+    std::vector<void*> createObjects(std::vector<ObjectDescription> const& objects, std::vector<ConnectionDescription> const& connections);
     void* renameObject(void* obj, String const& name);
 
     void moveObjects(std::vector<void*> const&, int x, int y);
@@ -57,12 +141,15 @@ public:
 
     void setZoom(int zoom);
 
-    void copy();
-    void paste();
+    // Puts the selection on the clipboard, with the editor info of its connections
+    void copy(std::vector<Clipboard::ConnectionInfo> connections = {});
+    // Pastes what the clipboard has, in binary form when it was copied in this process
+    // Returns whether it was, the connection info of the clipboard only belongs to the pasted objects then
+    bool paste();
     void duplicate();
 
-    void startUndoSequence(String name);
-    void endUndoSequence(String name);
+    // Runs edits on pd's thread as a single undo step, pd's DSP graph is only rebuilt once they're all done
+    void performUndoSequence(String const& name, std::function<void()> edits);
 
     void undo();
     void redo();
@@ -74,6 +161,29 @@ public:
 
     void setCurrent(bool lock = false);
 
+    // Moves in a row are merged and the oldest actions are dropped when the undo history grows beyond this
+    static constexpr size_t undoMemoryBudget = 16 * 1024 * 1024;
+
+    // Memory this patch uses as far as pd knows, in bytes, see libpd_canvas_get_memory
+    struct MemoryUsage {
+        size_t objects = 0;
+        size_t text = 0;
+        size_t arrays = 0;
+        size_t clones = 0;
+        size_t undo = 0;
+        int numObjects = 0;
+        int numArrays = 0;
+        int numClones = 0;
+        int numUndoActions = 0;
+
+        size_t getTotal() const
+        {
+            return objects + text + arrays + clones + undo;
+        }
+    };
+
+    MemoryUsage getMemoryUsage() const;
+
     bool isDirty() const;
 
     void savePatch(File const& location);
@@ -95,6 +205,9 @@ public:
 
     Connections getConnections() const;
 
+    // Objects, their states and the connections, see PatchSnapshot
+    std::shared_ptr<PatchSnapshot const> getSnapshot() const;
+
     t_canvas* getPointer() const
     {
         return static_cast<t_canvas*>(ptr);
@@ -103,20 +216,63 @@ public:
     // Gets the objects of the patch.
     std::vector<void*> getObjects(bool onlyGui = false);
 
+    // Gets the state of every object in the same order as getObjects, under one acquisition of the audio lock
+    //! @details Canvas::synchronise lays out all objects from this, so the audio thread isn't
+    //! held up once for every object.
+    std::vector<ObjectState> getObjectStates() const;
+
+    // Gets the state of a single object, only call with the audio lock held
+    ObjectState getObjectState(void* obj) const;
+
     String getCanvasContent()
     {
         if (!ptr)
             return {};
+
+        Storage::storeAll(instance);
+
         char* buf;
         int bufsize;
         libpd_getcontent(static_cast<t_canvas*>(ptr), &buf, &bufsize);
 
         auto content = String(buf, static_cast<size_t>(bufsize));
+        freebytes(buf, static_cast<size_t>(bufsize));
+        return content;
+    }
+
+    // Same content in pd's binary form, much quicker to write and load again than text
+    MemoryBlock getCanvasBinary()
+    {
+        if (!ptr)
+            return {};
+
+        Storage::storeAll(instance);
+
+        char* buf;
+        int bufsize;
+        libpd_getcontent_binary(static_cast<t_canvas*>(ptr), &buf, &bufsize);
+
+        auto content = MemoryBlock(buf, static_cast<size_t>(bufsize));
+        freebytes(buf, static_cast<size_t>(bufsize));
         return content;
     }
 
+    // Position of obj among the objects of the patch, or -1
+    // Looked up in the snapshot of an IndexScope if there is one, otherwise the patch is searched
     int getIndex(void* obj);
 
+    // While it exists, getIndex finds objects in the snapshot instead of searching the patch
+    // Only use it while the editor is known to follow the snapshot, like during Canvas::synchronise
+    class IndexScope {
+    public:
+        IndexScope(Patch& patch, PatchSnapshot const& snapshot);
+        ~IndexScope();
+
+    private:
+        Patch& patch;
+        PatchSnapshot const* previous;
+    };
+
     static t_object* checkObject(void* obj);
 
     void keyPress(int keycode, int shift);
@@ -127,10 +283,16 @@ public:
     Instance* instance = nullptr;
 
 private:
+    // Prepares the arguments on the calling thread, the returned function creates the object on pd's thread
+    std::function<void*()> makeCreator(String const& name, int x, int y);
+
     File currentFile;
 
     void* ptr = nullptr;
 
+    // Set by an IndexScope
+    PatchSnapshot const* indexedSnapshot = nullptr;
+
     // Initialisation parameters for GUI objects
     // Taken from pd save files, this will make sure that it directly initialises objects with the right parameters
     static inline const std::map<String, String> guiDefaults = {
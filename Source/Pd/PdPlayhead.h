@@ -0,0 +1,162 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+extern "C" {
+#include <m_pd.h>
+}
+
+namespace pd {
+
+// Sends the host's playhead to [r playhead]
+//! @details Selectors are interned once for the pd instance that is current when calling prepare().
+//! Position is sent every time, all other messages only when their value changed since the
+//! last time they were sent. Nothing is sent while there is no receiver, and the next receiver
+//! gets the complete state again. Only publish() has to be called from the audio thread.
+class PlayheadPublisher {
+public:
+    enum Rate {
+        PerTick,
+        PerBlock,
+        Off
+    };
+
+    void prepare()
+    {
+        receiver = gensym("playhead");
+        playing = { gensym("playing") };
+        recording = { gensym("recording") };
+        looping = { gensym("looping") };
+        edittime = { gensym("edittime") };
+        framerate = { gensym("framerate") };
+        bpm = { gensym("bpm") };
+        lastbar = { gensym("lastbar") };
+        timesig = { gensym("timesig") };
+        position = { gensym("position") };
+    }
+
+    void setRate(Rate newRate)
+    {
+        rate = newRate;
+        reset();
+    }
+
+    Rate getRate() const
+    {
+        return rate;
+    }
+
+    // Called at the start of every host block
+    void beginBlock()
+    {
+        blockPending = true;
+    }
+
+    // Makes the next publish send every message
+    void reset()
+    {
+        resetPending = true;
+    }
+
+    // Called for every tick, sends whatever the rate allows
+    void publish(AudioPlayHead* playhead)
+    {
+        if (rate == Off || !playhead || !receiver)
+            return;
+
+        if (rate == PerBlock && !std::exchange(blockPending, false))
+            return;
+
+        if (resetPending.exchange(false) || !receiver->s_thing)
+            forget();
+
+        if (!receiver->s_thing)
+            return;
+
+        auto const info = playhead->getPosition();
+        if (!info.hasValue())
+            return;
+
+        sys_lock();
+
+        send(playing, { static_cast<float>(info->getIsPlaying()) });
+        send(recording, { static_cast<float>(info->getIsRecording()) });
+
+        auto const loopPoints = info->getLoopPoints();
+        send(looping, { static_cast<float>(info->getIsLooping()), loopPoints ? static_cast<float>(loopPoints->ppqStart) : 0.0f, loopPoints ? static_cast<float>(loopPoints->ppqEnd) : 0.0f });
+
+        if (auto const editTime = info->getEditOriginTime())
+            send(edittime, { static_cast<float>(*editTime) });
+
+        if (auto const frameRate = info->getFrameRate())
+            send(framerate, { static_cast<float>(frameRate->getEffectiveRate()) });
+
+        if (auto const tempo = info->getBpm())
+            send(bpm, { static_cast<float>(*tempo) });
+
+        if (auto const lastBar = info->getPpqPositionOfLastBarStart())
+            send(lastbar, { static_cast<float>(*lastBar) });
+
+        if (auto const timeSignature = info->getTimeSignature())
+            send(timesig, { static_cast<float>(timeSignature->numerator), static_cast<float>(timeSignature->denominator) });
+
+        auto const ppq = info->getPpqPosition();
+        auto const samples = info->getTimeInSamples();
+        auto const seconds = info->getTimeInSeconds();
+        send(position, { ppq ? static_cast<float>(*ppq) : 0.0f, samples ? static_cast<float>(*samples) : 0.0f, seconds ? static_cast<float>(*seconds) : 0.0f }, true);
+
+        sys_unlock();
+    }
+
+private:
+    static constexpr int maxValues = 3;
+
+    void forget()
+    {
+        for (auto* field : { &playing, &recording, &looping, &edittime, &framerate, &bpm, &lastbar, &timesig, &position })
+            field->numValues = 0;
+    }
+
+    struct Field {
+        t_symbol* selector = nullptr;
+        int numValues = 0;
+        float values[maxValues] = {};
+    };
+
+    void send(Field& field, std::initializer_list<float> values, bool always = false)
+    {
+        auto const numValues = static_cast<int>(values.size());
+
+        if (!always && field.numValues == numValues && std::equal(values.begin(), values.end(), field.values))
+            return;
+
+        t_atom atoms[maxValues];
+        int i = 0;
+        for (auto value : values) {
+            field.values[i] = value;
+            SETFLOAT(atoms + i, value);
+            i++;
+        }
+        field.numValues = numValues;
+
+        // The receiver can disappear while handling one of the previous messages
+        if (receiver->s_thing)
+            pd_typedmess(receiver->s_thing, field.selector, numValues, atoms);
+    }
+
+    t_symbol* receiver = nullptr;
+
+    Field playing, recording, looping, edittime, framerate, bpm, lastbar, timesig, position;
+
+    std::atomic<Rate> rate = PerTick;
+    std::atomic<bool> resetPending = false;
+    bool blockPending = false;
+};
+
+} // namespace pd
@@ -0,0 +1,223 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "PdSharedArrays.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+extern "C" {
+#include "x_libpd_sharedarray.h"
+}
+
+namespace pd {
+
+JUCE_IMPLEMENT_SINGLETON(SharedArrays)
+
+struct SharedArrays::Storage {
+    String key;
+    int size;
+    std::atomic<int> numUsers;
+
+    // Set once the last array let go and the values are freed, the storage is removed from the list later
+    std::atomic<bool> released = false;
+    HeapBlock<t_word> values;
+};
+
+struct SharedArrays::Storages {
+    // Storage by the address of its values, so pd's freebytes can find it without locking
+    //! @details Only acquire adds storage, under the lock. Storage is taken out by the release that lets
+    //! go of it last, which leaves a marker so other storage further along the probe chain can still be found.
+    struct Slot {
+        std::atomic<t_word const*> values = nullptr;
+        std::atomic<Storage*> storage = nullptr;
+    };
+
+    static constexpr size_t numSlots = 4096;
+
+    // Only taken by acquire, never on pd's free and resize path
+    CriticalSection lock;
+    std::vector<std::unique_ptr<Storage>> list;
+
+    Slot slots[numSlots];
+
+    // Every shared storage ever made is in this range, most blocks pd frees are rejected by it
+    std::atomic<uintptr_t> lowest = std::numeric_limits<uintptr_t>::max();
+    std::atomic<uintptr_t> highest = 0;
+
+    static t_word const* getRemovedMarker()
+    {
+        static t_word marker;
+        return &marker;
+    }
+
+    static size_t getSlotIndex(void const* values)
+    {
+        auto const address = static_cast<uint64>(reinterpret_cast<uintptr_t>(values));
+        return static_cast<size_t>((address >> 4) * 0x9E3779B97F4A7C15ull >> 52) & (numSlots - 1);
+    }
+
+    Slot* find(void const* values)
+    {
+        auto const address = reinterpret_cast<uintptr_t>(values);
+        if (address < lowest.load(std::memory_order_acquire) || address >= highest.load(std::memory_order_acquire))
+            return nullptr;
+
+        for (size_t i = 0, index = getSlotIndex(values); i < numSlots; i++, index = (index + 1) & (numSlots - 1)) {
+            auto const* slotValues = slots[index].values.load(std::memory_order_acquire);
+            if (slotValues == values)
+                return slots + index;
+            if (!slotValues)
+                return nullptr;
+        }
+
+        return nullptr;
+    }
+
+    // Called with the lock held
+    bool insert(Storage* storage)
+    {
+        auto const* values = storage->values.get();
+        auto const address = reinterpret_cast<uintptr_t>(values);
+
+        for (size_t i = 0, index = getSlotIndex(values); i < numSlots; i++, index = (index + 1) & (numSlots - 1)) {
+            auto& slot = slots[index];
+            auto const* slotValues = slot.values.load(std::memory_order_acquire);
+            if (slotValues && slotValues != getRemovedMarker())
+                continue;
+
+            if (address < lowest.load(std::memory_order_relaxed))
+                lowest.store(address, std::memory_order_release);
+            if (address + storage->size * sizeof(t_word) > highest.load(std::memory_order_relaxed))
+                highest.store(address + storage->size * sizeof(t_word), std::memory_order_release);
+
+            slot.storage.store(storage, std::memory_order_release);
+            slot.values.store(values, std::memory_order_release);
+            return true;
+        }
+
+        return false;
+    }
+
+    // Called with the lock held, removes the storage that the last array let go of
+    void sweep()
+    {
+        list.erase(std::remove_if(list.begin(), list.end(), [](auto const& storage) { return storage->released.load(std::memory_order_acquire); }), list.end());
+    }
+};
+
+SharedArrays::SharedArrays()
+{
+    static t_libpd_sharedarray_registry const registry = {
+        [](char const* key, t_word const* values, int size) { return static_cast<t_word*>(acquire(key, values, size)); },
+        [](t_word const* values) { return static_cast<int>(contains(values)); },
+        [](t_word* values) { return static_cast<int>(release(values)); },
+    };
+
+    libpd_sharedarray_set_registry(&registry);
+}
+
+SharedArrays::~SharedArrays()
+{
+    // The registry stays, pd still has to give back the storage of arrays that are freed later
+    clearSingletonInstance();
+}
+
+SharedArrays::Storages& SharedArrays::getStorages()
+{
+    // Never deleted, pd might free an array while the process exits
+    static auto* storages = new Storages();
+    return *storages;
+}
+
+// Takes one more use of storage that's still in use, storage that has no users any more is about to be freed
+static bool addUser(std::atomic<int>& numUsers)
+{
+    auto users = numUsers.load(std::memory_order_acquire);
+    while (users > 0 && !numUsers.compare_exchange_weak(users, users + 1, std::memory_order_acq_rel)) { }
+    return users > 0;
+}
+
+void* SharedArrays::acquire(char const* key, void const* values, int size)
+{
+    if (size <= 0)
+        return nullptr;
+
+    auto const name = String::fromUTF8(key);
+    auto& storages = getStorages();
+
+    auto findExisting = [&storages, &name, size](bool& sizeMismatch) -> t_word* {
+        for (auto& storage : storages.list) {
+            if (storage->key != name || !addUser(storage->numUsers))
+                continue;
+
+            if (storage->size != size) {
+                storage->numUsers.fetch_sub(1, std::memory_order_acq_rel);
+                sizeMismatch = true;
+                return nullptr;
+            }
+
+            return storage->values.get();
+        }
+
+        return nullptr;
+    };
+
+    bool sizeMismatch = false;
+    {
+        ScopedLock const scopedLock(storages.lock);
+        storages.sweep();
+
+        if (auto* existing = findExisting(sizeMismatch))
+            return existing;
+        if (sizeMismatch)
+            return nullptr;
+    }
+
+    // The first array of a key gives its values, they're copied outside of the lock
+    auto storage = std::make_unique<Storage>();
+    storage->key = name;
+    storage->size = size;
+    storage->numUsers = 1;
+    storage->values.malloc(static_cast<size_t>(size));
+    std::copy_n(static_cast<t_word const*>(values), size, storage->values.get());
+
+    ScopedLock const scopedLock(storages.lock);
+
+    // Another instance might have shared the same key meanwhile, ours is freed after the lock
+    if (auto* existing = findExisting(sizeMismatch))
+        return existing;
+    if (sizeMismatch || !storages.insert(storage.get()))
+        return nullptr;
+
+    return storages.list.emplace_back(std::move(storage))->values.get();
+}
+
+bool SharedArrays::contains(void const* values)
+{
+    return getStorages().find(values) != nullptr;
+}
+
+bool SharedArrays::release(void* values)
+{
+    auto& storages = getStorages();
+
+    auto* slot = storages.find(values);
+    if (!slot)
+        return false;
+
+    auto* storage = slot->storage.load(std::memory_order_acquire);
+    if (storage->numUsers.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        slot->values.store(Storages::getRemovedMarker(), std::memory_order_release);
+        storage->values.free();
+        storage->released.store(true, std::memory_order_release);
+    }
+
+    return true;
+}
+
+} // namespace pd
@@ -0,0 +1,42 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <memory>
+#include <vector>
+
+namespace pd {
+
+// The storage of arrays that are shared with the "share" message, one for the whole process
+//! @details Arrays of every instance that share a key point at the same values, so a sample that each instance
+//! loads is only kept once (see x_libpd_sharedarray.h). Storage is counted by the arrays that use it and freed
+//! with the last one. While any array is shared, pd asks about every block it frees, from any thread, so that
+//! is answered without locking, only sharing takes a lock. Every instance of the process reads and writes the
+//! same values, so a write is seen by the others right away and there is nothing to publish.
+//! The storage outlives this object, since arrays of instances that are freed after it might still use it.
+class SharedArrays : public DeletedAtShutdown {
+public:
+    SharedArrays();
+    ~SharedArrays() override;
+
+    JUCE_DECLARE_SINGLETON(SharedArrays, false)
+
+private:
+    struct Storage;
+    struct Storages;
+
+    static Storages& getStorages();
+
+    // Called by pd, see x_libpd_sharedarray.h
+    static void* acquire(char const* key, void const* values, int size);
+    static bool contains(void const* values);
+    static bool release(void* values);
+};
+
+} // namespace pd
@@ -22,22 +22,47 @@ void canvas_map(t_canvas* x, t_floatarg f);
 
 namespace pd {
 
+namespace {
+
+// Every storage that exists, so they can all be stored before a patch is saved
+struct Registry {
+    CriticalSection lock;
+    Array<Storage*> storages;
+
+    // The storages in use for each patch, see Storage::getShared
+    std::unordered_map<t_glist*, std::weak_ptr<Storage>> shared;
+};
+
+Registry& getRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+} // namespace
+
 Storage::Storage(t_glist* patch, Instance* inst)
     : parentPatch(patch)
     , instance(inst)
 {
+    {
+        auto& registry = getRegistry();
+        const ScopedLock lock(registry.lock);
+        registry.storages.add(this);
+    }
+
     instance->getCallbackLock()->enter();
 
     for (t_gobj* y = patch->gl_list; y; y = y->g_next) {
-        const String name = libpd_get_object_class_name(y);
+        auto const* name = libpd_get_object_class_name(y);
 
-        if (name == "graph" || name == "canvas") {
+        if (!strcmp(name, "graph") || !strcmp(name, "canvas")) {
             auto* glist = pd_checkglist(&y->g_pd);
             auto* obj = glist->gl_list;
 
             if (obj != nullptr && obj->g_next == nullptr) {
                 // Skip non-text object to prevent crash on libpd_get_object_text
-                if (String::fromUTF8(libpd_get_object_class_name(&glist->gl_list->g_pd)) != "text")
+                if (strcmp(libpd_get_object_class_name(&glist->gl_list->g_pd), "text"))
                     continue;
 
                 // Get object text to return the content of the comment
@@ -86,6 +111,49 @@ Storage::Storage(t_glist* patch, Instance* inst)
     instance->getCallbackLock()->exit();
 }
 
+// Doesn't store anything, the patch may already be gone
+Storage::~Storage()
+{
+    auto& registry = getRegistry();
+    const ScopedLock lock(registry.lock);
+    registry.storages.removeFirstMatchingValue(this);
+}
+
+std::shared_ptr<Storage> Storage::getShared(t_glist* patch, Instance* instance)
+{
+    auto& registry = getRegistry();
+
+    {
+        const ScopedLock lock(registry.lock);
+
+        auto it = registry.shared.find(patch);
+        if (it != registry.shared.end()) {
+            if (auto storage = it->second.lock(); storage && storage->instance == instance)
+                return storage;
+
+            registry.shared.erase(it);
+        }
+    }
+
+    // Made without the registry lock, as making it takes the audio lock, while storeAll can be called with that held
+    auto storage = std::make_shared<Storage>(patch, instance);
+
+    const ScopedLock lock(registry.lock);
+    registry.shared[patch] = storage;
+    return storage;
+}
+
+void Storage::storeAll(Instance* instance)
+{
+    auto& registry = getRegistry();
+    const ScopedLock lock(registry.lock);
+
+    for (auto* storage : registry.storages) {
+        if (storage->instance == instance)
+            storage->storeInfo();
+    }
+}
+
 // Function to load state tree from existing patch, only called on init
 void Storage::loadInfoFromPatch()
 {
@@ -117,10 +185,20 @@ void Storage::loadInfoFromPatch()
     canvas_vis(infoParent, 0);
 
     try {
-        auto tree = ValueTree::fromXml(content);
+        ValueTree tree;
+
+        auto const prefix = String(formatVersion) + " ";
+        if (content.startsWith(prefix)) {
+            MemoryOutputStream data;
+            if (Base64::convertFromBase64(data, content.substring(prefix.length()).trim()))
+                tree = ValueTree::readFromGZIPData(data.getData(), data.getDataSize());
+        } else {
+            tree = ValueTree::fromXml(content);
+        }
 
         if (tree.isValid()) {
             extraInfo = tree;
+            rebuildIndex();
             return;
         }
     } catch (...) {
@@ -135,13 +213,49 @@ void Storage::loadInfoFromPatch()
 // Function to store state tree in pd patch
 void Storage::storeInfo()
 {
-    if (!infoObject)
+    const ScopedLock lock(infoLock);
+
+    if (!infoObject || !dirty)
         return;
 
-    String newname = "plugdatainfo " + extraInfo.toXmlString(XmlElement::TextFormat().singleLine());
+    // Binary and compressed, so it's small and quick to write even with thousands of connections
+    MemoryOutputStream data;
+    {
+        GZIPCompressorOutputStream compressor(data, 9);
+        extraInfo.writeToStream(compressor);
+    }
+
+    String newname = "plugdatainfo " + String(formatVersion) + " " + Base64::toBase64(data.getData(), data.getDataSize());
 
     // This is likely thread safe because nothing else should access this object
     binbuf_text((reinterpret_cast<t_text*>(infoObject))->te_binbuf, newname.toRawUTF8(), newname.getNumBytesAsUTF8());
+
+    dirty = false;
+}
+
+void Storage::rebuildIndex()
+{
+    index.clear();
+    updatedInfo.clear();
+
+    for (auto info : extraInfo) {
+        info.removeProperty("Updated", nullptr); // Older patches stored it
+        index[info.getProperty("ID").toString()].add(info);
+    }
+}
+
+ValueTree Storage::findInfo(String const& id) const
+{
+    auto it = index.find(id);
+    if (it == index.end() || it->second.isEmpty())
+        return {};
+
+    for (auto const& info : it->second) {
+        if (info.hasProperty("Updated"))
+            return info;
+    }
+
+    return it->second.getFirst();
 }
 
 // Function to change the id of an entry
@@ -152,60 +266,75 @@ void Storage::setInfoId(String const& oldId, String const& newId)
     if (!infoObject)
         return;
 
-    for (auto s : extraInfo) {
-        if (s.getProperty("ID") == oldId && s.getProperty("Updated") == var(false)) {
-            s.setProperty("ID", newId, nullptr);
-            s.setProperty("Updated", true, nullptr); // Updated flag in case we temporarily need conflicting IDs
-            return;
-        }
+    const ScopedLock lock(infoLock);
+
+    auto it = index.find(oldId);
+    if (it == index.end())
+        return;
+
+    for (auto info : it->second) {
+        if (info.hasProperty("Updated"))
+            continue;
+
+        it->second.removeFirstMatchingValue(info);
+        if (it->second.isEmpty())
+            index.erase(it);
+
+        info.setProperty("ID", newId, nullptr);
+        info.setProperty("Updated", true, nullptr); // Updated flag in case we temporarily need conflicting IDs
+        index[newId].add(info);
+        updatedInfo.add(info);
+
+        dirty = true;
+        return;
     }
 }
 
 void Storage::confirmIds()
 {
-    for (auto s : extraInfo)
-        s.setProperty("Updated", false, nullptr);
-    storeInfo();
+    const ScopedLock lock(infoLock);
+
+    for (auto info : updatedInfo)
+        info.removeProperty("Updated", nullptr);
+
+    updatedInfo.clearQuick();
 }
 
 // Check if info exists
 bool Storage::hasInfo(String const& id) const
 {
-    auto child = extraInfo.getChildWithProperty("ID", id);
-    return child.isValid();
+    return findInfo(id).isValid();
 }
 
 // Get info from local state
 String Storage::getInfo(String const& id, String const& property) const
 {
-    return extraInfo.getChildWithProperty("ID", id).getProperty(property).toString();
+    return findInfo(id).getProperty(property).toString();
 }
 
-// Set info to local state
-// Also pushes the change into pd patch
+// Set info to local state, it's written into the pd patch when that's needed
 void Storage::setInfo(String const& id, String const& property, String const& info, bool undoable)
 {
     jassert(property != "Updated" && property != "ID");
 
-    auto tree = ValueTree("InfoObj");
+    // Takes the audio lock, so it has to happen before taking ours
+    if (undoable)
+        createUndoAction();
+
+    const ScopedLock lock(infoLock);
 
-    auto existingInfo = extraInfo.getChildWithProperty("ID", id);
-    if (existingInfo.isValid()) {
-        tree = existingInfo;
-    }
+    auto tree = findInfo(id);
 
-    if (!existingInfo.isValid()) {
+    if (!tree.isValid()) {
+        tree = ValueTree("InfoObj");
+        tree.setProperty("ID", id, nullptr);
         extraInfo.appendChild(tree, nullptr);
+        index[id].add(tree);
     }
 
-    if (undoable)
-        createUndoAction();
-
-    tree.setProperty("ID", id, nullptr);
-    tree.setProperty("Updated", false, nullptr);
     tree.setProperty(property, info, &undoManager);
 
-    storeInfo();
+    dirty = true;
 }
 
 // Checks if we're at a storage undo event, and applies undo if needed
@@ -216,12 +345,12 @@ void Storage::undoIfNeeded()
     t_undo* udo = canvas_undo_get(parentPatch);
 
     if (udo && udo->u_last && !strcmp(udo->u_last->name, "plugdata_undo")) {
+        const ScopedLock lock(infoLock);
         undoManager.undo();
+        dirty = true;
     }
 
     instance->getCallbackLock()->exit();
-
-    storeInfo();
 }
 
 // Checks if we're at a storage redo event, and applies redo if needed
@@ -232,12 +361,12 @@ void Storage::redoIfNeeded()
     t_undo* udo = canvas_undo_get(parentPatch);
 
     if (udo && udo->u_last && !strcmp(udo->u_last->next->name, "plugdata_undo")) {
+        const ScopedLock lock(infoLock);
         undoManager.redo();
+        dirty = true;
     }
 
     instance->getCallbackLock()->exit();
-
-    storeInfo();
 }
 
 // Creates a dummy undoable action in pd and begins a new transaction in out own undo manager
@@ -260,8 +389,9 @@ void Storage::createUndoAction()
 // We use this to make ignore this object in the GUI
 bool Storage::isInfoParent(t_gobj* obj)
 {
-    const String name = libpd_get_object_class_name(obj);
-    if (name == "graph" || name == "canvas") {
+    // Called for every object when reading a patch, so the class name isn't made into a String
+    auto const* name = libpd_get_object_class_name(obj);
+    if (!strcmp(name, "graph") || !strcmp(name, "canvas")) {
         auto* glist = pd_checkglist(&obj->g_pd);
         return isInfoParent(glist);
     }
@@ -278,7 +408,7 @@ bool Storage::isInfoParent(t_glist* glist)
         char* text;
         int size;
 
-        if (String::fromUTF8(libpd_get_object_class_name(&glist->gl_list->g_pd)) != "text")
+        if (strcmp(libpd_get_object_class_name(&glist->gl_list->g_pd), "text"))
             return false;
 
         libpd_get_object_text(glist->gl_list, &text, &size);
@@ -8,6 +8,8 @@
 #include <JuceHeader.h>
 
 #include <array>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 extern "C" {
@@ -17,6 +19,12 @@ extern "C" {
 namespace pd {
 
 class Instance;
+
+// Editor metadata that pd doesn't know about, like connection paths, kept inside the patch
+//! @details The info lives in a text object inside a hidden graph, but it's only written there
+//! when the patch is saved, its content is requested, or a canvas goes away while the patch
+//! stays open. Until then it's kept in a tree that's indexed by ID. Call storeAll() before
+//! anything reads the patch from pd.
 class Storage {
     t_glist* parentPatch = nullptr;
     Instance* instance = nullptr;
@@ -29,13 +37,24 @@ public:
 
     Storage() = delete;
 
+    ~Storage();
+
     void setInfoId(String const& oldId, String const& newId);
     void confirmIds();
 
     bool hasInfo(String const& id) const;
+
+    // Writes the info into the patch if it changed since the last time
     void storeInfo();
     void loadInfoFromPatch();
 
+    // Every view of a patch, like a tab and the graph showing it on its parent, uses the same storage
+    // This way the info is only read from the patch once, and the views can't disagree about it
+    static std::shared_ptr<Storage> getShared(t_glist* patch, Instance* instance);
+
+    // Stores the info of every canvas of the instance, safe to call from any thread
+    static void storeAll(Instance* instance);
+
     void undoIfNeeded();
     void redoIfNeeded();
 
@@ -50,11 +69,26 @@ public:
 private:
     void createObject();
 
+    // Entry for an ID, the one that was moved to it if two have it while ids are being updated
+    ValueTree findInfo(String const& id) const;
+    void rebuildIndex();
+
+    // Written in front of the compressed tree, older patches contain the tree as XML
+    static constexpr int formatVersion = 2;
+
     UndoManager undoManager;
 
     ValueTree extraInfo = ValueTree("PlugDataInfo");
 
+    std::unordered_map<String, Array<ValueTree>> index;
+    Array<ValueTree> updatedInfo; // Moved to a new ID since the last confirmIds
+
+    bool dirty = false;
+    CriticalSection infoLock;
+
     friend class Instance;
     friend class Patch;
+
+    JUCE_DECLARE_NON_COPYABLE(Storage)
 };
 } // namespace pd
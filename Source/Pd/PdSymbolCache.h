@@ -0,0 +1,83 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <unordered_map>
+
+extern "C" {
+#include <m_pd.h>
+#include <z_libpd.h>
+}
+
+namespace pd {
+
+// The names of an instance's symbols as Strings, so each name is only decoded once
+//! @details The Strings come from JUCE's global StringPool, so every cache of every instance shares the
+//! text of a name, and copying one never allocates. A String that came from here is turned back into
+//! its symbol by the address of its text, without hashing or comparing it, other Strings go through gensym.
+//! pd keeps its symbols as long as the instance lives, so nothing is ever removed. Safe to use from
+//! any thread, except from within pd's lock: a name that isn't cached yet is interned by toSymbol with
+//! the cache's instance set and pd's lock held.
+class SymbolCache {
+public:
+    void setInstance(void* pdInstance)
+    {
+        instance = pdInstance;
+    }
+
+    String toString(t_symbol const* symbol)
+    {
+        if (!symbol)
+            return {};
+
+        {
+            SpinLock::ScopedLockType lock(mutex);
+            if (auto it = strings.find(symbol); it != strings.end())
+                return it->second;
+        }
+
+        // Decoded outside of the lock, if two threads get here the second one finds the first one's String
+        auto name = StringPool::getGlobalPool().getPooledString(symbol->s_name);
+
+        SpinLock::ScopedLockType lock(mutex);
+        auto [it, inserted] = strings.emplace(symbol, name);
+        if (inserted)
+            symbols.emplace(it->second.getCharPointer().getAddress(), const_cast<t_symbol*>(symbol));
+
+        return it->second;
+    }
+
+    t_symbol* toSymbol(String const& name) const
+    {
+        {
+            SpinLock::ScopedLockType lock(mutex);
+            if (auto it = symbols.find(name.getCharPointer().getAddress()); it != symbols.end())
+                return it->second;
+        }
+
+        libpd_set_instance(static_cast<t_pdinstance*>(instance));
+        sys_lock();
+        auto* symbol = gensym(name.toRawUTF8());
+        sys_unlock();
+
+        return symbol;
+    }
+
+private:
+    void* instance = nullptr;
+
+    mutable SpinLock mutex;
+
+    std::unordered_map<t_symbol const*, String> strings;
+
+    // By the address of the pooled text, which stays the same while the String above holds on to it
+    std::unordered_map<char const*, t_symbol*> symbols;
+};
+
+}
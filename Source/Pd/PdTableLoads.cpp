@@ -0,0 +1,202 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "PdTableLoads.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include "x_libpd_tableload.h"
+}
+
+namespace pd {
+
+JUCE_IMPLEMENT_SINGLETON(TableLoads)
+
+namespace {
+
+// Frames decoded at a time, a cancelled load stops after the chunk it's in
+constexpr int chunkSize = 1 << 16;
+
+}
+
+struct TableLoads::Load {
+    File file;
+    int numChannels;
+    std::vector<int64> sizes;
+    int64 skip;
+    int64 maxFrames;
+    double sampleRate;
+
+    // Written by the worker before done is set
+    std::vector<t_word*> buffers;
+    int64 frames = -1;
+    double fileSampleRate = 0;
+    int fileChannels = 0;
+
+    std::atomic<bool> done = false;
+    TaskPool::CancellationToken token;
+
+    ~Load()
+    {
+        // pd's freebytes is free(), the buffers are allocated like getbytes does
+        for (auto* buffer : buffers)
+            std::free(buffer);
+    }
+
+    // Copies n frames of chunk to the buffers from frame start on, as far as each one goes
+    void copy(AudioBuffer<float> const& chunk, int64 start, int n)
+    {
+        for (int ch = 0; ch < chunk.getNumChannels(); ch++) {
+            auto const* source = chunk.getReadPointer(ch);
+            auto const count = jmin<int64>(n, sizes[ch] - start);
+            for (int64 i = 0; i < count; i++)
+                buffers[ch][start + i].w_float = source[i];
+        }
+    }
+};
+
+TableLoads::TableLoads()
+{
+    static t_libpd_tableload_registry const registry = {
+        [](char const* path, int nchans, long const* sizes, long skip, long maxframes, double samplerate) { return open(path, nchans, sizes, skip, maxframes, samplerate); },
+        [](void* load, long* frames, double* samplerate, int* nchans) { return poll(load, frames, samplerate, nchans); },
+        [](void* load, int ch) { return static_cast<t_word*>(take(load, ch)); },
+        [](void* load) { close(load); },
+    };
+
+    libpd_tableload_set_registry(&registry);
+}
+
+TableLoads::~TableLoads()
+{
+    libpd_tableload_set_registry(nullptr);
+    clearSingletonInstance();
+}
+
+void TableLoads::decode(Load& load)
+{
+    AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    std::unique_ptr<AudioFormatReader> reader(formats.createReaderFor(load.file));
+    if (!reader || reader->sampleRate <= 0) {
+        load.done.store(true, std::memory_order_release);
+        return;
+    }
+
+    auto const resample = load.sampleRate > 0 && load.sampleRate != reader->sampleRate;
+    auto const ratio = resample ? load.sampleRate / reader->sampleRate : 1.0;
+    auto const available = jmax<int64>(0, reader->lengthInSamples - load.skip);
+    auto const frames = jmin(load.maxFrames, static_cast<int64>(std::ceil(static_cast<double>(available) * ratio)));
+
+    load.fileSampleRate = reader->sampleRate;
+    load.fileChannels = static_cast<int>(reader->numChannels);
+
+    // Buffers without a size get one for every frame, and at least one since arrays can't be empty
+    for (int ch = 0; ch < load.numChannels; ch++) {
+        if (load.sizes[ch] <= 0)
+            load.sizes[ch] = jmax<int64>(frames, 1);
+        load.buffers[ch] = static_cast<t_word*>(std::calloc(static_cast<size_t>(load.sizes[ch]), sizeof(t_word)));
+        if (!load.buffers[ch]) {
+            load.done.store(true, std::memory_order_release);
+            return;
+        }
+    }
+
+    // Arrays past the channels of the file stay zero
+    AudioBuffer<float> chunk(jmin(load.numChannels, load.fileChannels), chunkSize);
+
+    if (resample) {
+        AudioFormatReaderSource source(reader.get(), false);
+        ResamplingAudioSource resampler(&source, false, chunk.getNumChannels());
+
+        source.setNextReadPosition(load.skip);
+        resampler.setResamplingRatio(reader->sampleRate / load.sampleRate);
+        resampler.prepareToPlay(chunkSize, load.sampleRate);
+
+        for (int64 start = 0; start < frames; start += chunkSize) {
+            if (load.token.isCancelled())
+                break;
+
+            auto const n = static_cast<int>(jmin<int64>(chunkSize, frames - start));
+            resampler.getNextAudioBlock(AudioSourceChannelInfo(&chunk, 0, n));
+            load.copy(chunk, start, n);
+        }
+    } else {
+        for (int64 start = 0; start < frames; start += chunkSize) {
+            if (load.token.isCancelled())
+                break;
+
+            auto const n = static_cast<int>(jmin<int64>(chunkSize, frames - start));
+            reader->read(&chunk, 0, n, load.skip + start, true, true);
+            load.copy(chunk, start, n);
+        }
+    }
+
+    load.frames = frames;
+    load.done.store(true, std::memory_order_release);
+}
+
+void* TableLoads::open(char const* path, int numChannels, long const* sizes, long skip, long maxFrames, double sampleRate)
+{
+    auto* loads = getInstanceWithoutCreating();
+    if (!loads || numChannels <= 0 || !File::isAbsolutePath(String::fromUTF8(path)))
+        return nullptr;
+
+    auto const file = File(String::fromUTF8(path));
+    if (!file.existsAsFile())
+        return nullptr;
+
+    auto load = std::make_shared<Load>();
+    load->file = file;
+    load->numChannels = numChannels;
+    load->sizes.assign(sizes, sizes + numChannels);
+    load->skip = skip;
+    load->maxFrames = maxFrames;
+    load->sampleRate = sampleRate;
+    load->buffers.assign(static_cast<size_t>(numChannels), nullptr);
+
+    // The task keeps the load until it's done, even when pd closed it in the meantime
+    loads->tasks->add([load]() { decode(*load); }, TaskPool::Normal, load->token);
+
+    return new std::shared_ptr<Load>(std::move(load));
+}
+
+int TableLoads::poll(void* load, long* frames, double* sampleRate, int* numChannels)
+{
+    auto& l = **static_cast<std::shared_ptr<Load>*>(load);
+    if (!l.done.load(std::memory_order_acquire))
+        return 0;
+
+    *frames = static_cast<long>(l.frames);
+    *sampleRate = l.fileSampleRate;
+    *numChannels = l.fileChannels;
+    return 1;
+}
+
+void* TableLoads::take(void* load, int channel)
+{
+    auto& l = **static_cast<std::shared_ptr<Load>*>(load);
+    if (!l.done.load(std::memory_order_acquire) || channel < 0 || channel >= l.numChannels)
+        return nullptr;
+
+    return std::exchange(l.buffers[channel], nullptr);
+}
+
+void TableLoads::close(void* load)
+{
+    auto* l = static_cast<std::shared_ptr<Load>*>(load);
+    (*l)->token.cancel();
+    delete l;
+}
+
+} // namespace pd
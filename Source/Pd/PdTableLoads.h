@@ -0,0 +1,41 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include "../Utility/TaskPool.h"
+
+namespace pd {
+
+// Decodes the files that [soundfiler] reads with "readasync", for every instance in the process
+//! @details Each file is decoded by a task of the shared TaskPool, straight into buffers that the arrays take over
+//! as they are, so the pd thread only swaps pointers once a file is done (see x_libpd_tableload.h). A load that
+//! pd gives up on is cancelled, the task stops at the next chunk and the buffers go with the last reference.
+class TableLoads : public DeletedAtShutdown {
+public:
+    TableLoads();
+    ~TableLoads() override;
+
+    JUCE_DECLARE_SINGLETON(TableLoads, false)
+
+private:
+    struct Load;
+
+    // Reads the file of load into its buffers, on a worker
+    static void decode(Load& load);
+
+    // Called by pd, see x_libpd_tableload.h
+    static void* open(char const* path, int numChannels, long const* sizes, long skip, long maxFrames, double sampleRate);
+    static int poll(void* load, long* frames, double* sampleRate, int* numChannels);
+    static void* take(void* load, int channel);
+    static void close(void* load);
+
+    SharedResourcePointer<TaskPool> tasks;
+};
+
+} // namespace pd
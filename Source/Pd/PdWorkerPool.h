@@ -0,0 +1,274 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <atomic>
+
+namespace pd {
+
+// Fixed set of threads that help the audio thread through a batch of independent tasks
+//! @details The calling thread works along and only returns once every task is done.
+//! Tasks are claimed from a single atomic word holding the batch generation, the number of tasks
+//! and the next index, so a worker that wakes up late can never pick up a task from the wrong batch.
+//! Nothing on this path locks or allocates while the workers are awake. Idle workers only keep
+//! spinning for a small fraction of a block, so the tail of a batch doesn't pay for a wakeup, and
+//! then park until the next batch signals them. Blocks without parallel work cost no CPU.
+//! Only one batch runs at a time: a batch started from inside a task, or from another thread
+//! while the pool is busy, is run serially by its caller.
+//! When the audio device or host provides a workgroup, the workers join it from their own thread
+//! the next time they wake up, so the OS schedules them together with the audio thread instead of
+//! on efficiency cores. Workers beyond the number of threads the workgroup allows stay asleep.
+//! The threads aren't started until the first batch that could use them. That batch still runs
+//! serially, because threads can't be created on the audio thread: the message thread starts
+//! them the next time it polls, and later batches use them.
+class WorkerPool : private Timer {
+public:
+    using Task = void (*)(void* data, int index);
+
+    explicit WorkerPool(int numWorkers = jmax(0, SystemStats::getNumCpus() - 1))
+    {
+        for (int i = 0; i < numWorkers; i++) {
+            workers.add(new Worker(*this, i));
+        }
+
+        numAllowedWorkers = numWorkers;
+
+        if (numWorkers > 0)
+            startTimer(startPollMs);
+    }
+
+    ~WorkerPool() override
+    {
+        stopTimer();
+
+        for (auto* worker : workers) {
+            worker->signalThreadShouldExit();
+            worker->wakeUp.signal();
+        }
+
+        workers.clear();
+    }
+
+    void run(Task task, void* data, int numTasks)
+    {
+        if (numTasks <= 0)
+            return;
+
+        if (workers.isEmpty() || numTasks == 1 || numTasks > maxTasks || !isStarted() || busy.exchange(true, std::memory_order_acquire)) {
+            for (int i = 0; i < numTasks; i++)
+                task(data, i);
+            return;
+        }
+
+        currentTask.store(task, std::memory_order_relaxed);
+        currentData.store(data, std::memory_order_relaxed);
+        remaining.store(numTasks, std::memory_order_relaxed);
+
+        generation = (generation + 1) & 0xFFFFFFFF;
+        claim.store((generation << 32) | (static_cast<uint64>(numTasks) << 16));
+
+        if (numSleeping.load() > 0) {
+            for (auto* worker : workers)
+                worker->wakeUp.signal();
+        }
+
+        while (runNextTask()) { }
+
+        while (remaining.load(std::memory_order_acquire) != 0) { }
+
+        busy.store(false, std::memory_order_release);
+    }
+
+    // Calls fn(index) for every index in [0, numTasks)
+    template<typename Callable>
+    void run(int numTasks, Callable& fn)
+    {
+        run([](void* data, int index) { (*static_cast<Callable*>(data))(index); }, &fn, numTasks);
+    }
+
+    int getNumWorkers() const
+    {
+        return workers.size();
+    }
+
+#if JUCE_VERSION >= 0x070006
+    // Call when the audio thread's workgroup changes, from any thread
+    void setWorkgroup(AudioWorkgroup const& newWorkgroup)
+    {
+        {
+            SpinLock::ScopedLockType lock(workgroupLock);
+            workgroup = newWorkgroup;
+        }
+
+        // The audio thread itself counts towards the limit
+        auto const maxThreads = newWorkgroup ? static_cast<int>(newWorkgroup.getMaxParallelThreadCount()) : 0;
+        numAllowedWorkers = maxThreads > 0 ? jmin(workers.size(), maxThreads - 1) : workers.size();
+
+        workgroupGeneration++;
+
+        for (auto* worker : workers)
+            worker->wakeUp.signal();
+    }
+#endif
+
+private:
+    static constexpr int maxTasks = 0xFFFF;
+    static constexpr int startPollMs = 50;
+
+    // Asks the message thread for the threads the first time they would have been used
+    bool isStarted()
+    {
+        if (started.load(std::memory_order_acquire))
+            return true;
+
+        startRequested.store(true, std::memory_order_relaxed);
+        return false;
+    }
+
+    void timerCallback() override
+    {
+        if (!startRequested.load(std::memory_order_relaxed))
+            return;
+
+        stopTimer();
+
+        for (auto* worker : workers)
+            worker->startThread(Thread::realtimeAudioPriority);
+
+        started.store(true, std::memory_order_release);
+    }
+
+    bool hasWork() const
+    {
+        auto const current = claim.load();
+        return (current & 0xFFFF) < ((current >> 16) & 0xFFFF);
+    }
+
+    bool runNextTask()
+    {
+        auto current = claim.load(std::memory_order_acquire);
+
+        while (true) {
+            auto const index = current & 0xFFFF;
+            if (index >= ((current >> 16) & 0xFFFF))
+                return false;
+
+            if (claim.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel))
+                break;
+        }
+
+        // The batch can't be replaced before this task is done, so these are still ours
+        auto const task = currentTask.load(std::memory_order_relaxed);
+        auto const data = currentData.load(std::memory_order_relaxed);
+
+        task(data, static_cast<int>(current & 0xFFFF));
+
+        remaining.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+
+    struct Worker : public Thread {
+        Worker(WorkerPool& parent, int workerIndex)
+            : Thread("Pd Worker")
+            , pool(parent)
+            , index(workerIndex)
+        {
+        }
+
+        ~Worker() override
+        {
+            stopThread(-1);
+        }
+
+        void run() override
+        {
+            auto idleSince = Time::getHighResolutionTicks();
+
+            while (!threadShouldExit()) {
+#if JUCE_VERSION >= 0x070006
+                if (joinedGeneration != pool.workgroupGeneration.load())
+                    joinWorkgroup();
+#endif
+
+                auto const allowed = index < pool.numAllowedWorkers.load(std::memory_order_relaxed);
+
+                if (allowed && pool.runNextTask()) {
+                    idleSince = Time::getHighResolutionTicks();
+                    continue;
+                }
+
+                if (allowed && Time::getHighResolutionTicks() - idleSince < spinTicks) {
+                    Thread::yield();
+                    continue;
+                }
+
+                pool.numSleeping++;
+                if ((!allowed || !pool.hasWork()) && !threadShouldExit())
+                    wakeUp.wait(-1);
+                pool.numSleeping--;
+
+                idleSince = Time::getHighResolutionTicks();
+            }
+        }
+
+#if JUCE_VERSION >= 0x070006
+        void joinWorkgroup()
+        {
+            AudioWorkgroup current;
+            {
+                SpinLock::ScopedLockType lock(pool.workgroupLock);
+                current = pool.workgroup;
+                joinedGeneration = pool.workgroupGeneration.load();
+            }
+
+            // Resetting the token leaves the previous workgroup
+            token = WorkgroupToken();
+            if (current)
+                current.join(token);
+        }
+
+        WorkgroupToken token;
+        int joinedGeneration = 0;
+#endif
+
+        // 100us, less than the period of even a 32 sample block at 192kHz
+        int64 const spinTicks = Time::secondsToHighResolutionTicks(0.0001);
+
+        WorkerPool& pool;
+        int const index;
+        WaitableEvent wakeUp;
+    };
+
+    OwnedArray<Worker> workers;
+
+    // Generation in the upper 32 bits, then the number of tasks and the next index in 16 bits each
+    std::atomic<uint64> claim = 0;
+    uint64 generation = 0;
+
+    std::atomic<Task> currentTask = nullptr;
+    std::atomic<void*> currentData = nullptr;
+    std::atomic<int> remaining = 0;
+    std::atomic<bool> busy = false;
+
+    std::atomic<bool> started = false;
+    std::atomic<bool> startRequested = false;
+
+    std::atomic<int> numSleeping = 0;
+    std::atomic<int> numAllowedWorkers = 0;
+
+#if JUCE_VERSION >= 0x070006
+    SpinLock workgroupLock;
+    AudioWorkgroup workgroup;
+    std::atomic<int> workgroupGeneration = 0;
+#endif
+
+    JUCE_DECLARE_NON_COPYABLE(WorkerPool)
+};
+
+} // namespace pd
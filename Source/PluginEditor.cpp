@@ -11,6 +11,7 @@
 #include "Canvas.h"
 #include "Connection.h"
 #include "Dialogs/Dialogs.h"
+#include "Utility/HelpPreview.h"
 
 
 bool wantsNativeDialog() {
@@ -35,7 +36,7 @@ bool wantsNativeDialog() {
 
 
 
-PlugDataPluginEditor::PlugDataPluginEditor(PlugDataAudioProcessor& p) : AudioProcessorEditor(&p), pd(p), statusbar(p), sidebar(&p)
+PlugDataPluginEditor::PlugDataPluginEditor(PlugDataAudioProcessor& p) : AudioProcessorEditor(&p), pd(p), frameScheduler(*this, p.getCallbackLock(), p.audioStats, [&p]() { return p.isRenderingOffline(); }), statusbar(p, frameScheduler), sidebar(&p)
 {
     toolbarButtons = {new TextButton(Icons::Open), new TextButton(Icons::Save),     new TextButton(Icons::SaveAs), new TextButton(Icons::Undo),
                       new TextButton(Icons::Redo), new TextButton(Icons::Add),  new TextButton(Icons::Settings), new TextButton(Icons::Hide),   new TextButton(Icons::Pin)};
@@ -52,6 +53,11 @@ PlugDataPluginEditor::PlugDataPluginEditor(PlugDataAudioProcessor& p) : AudioPro
 
     addKeyListener(getKeyMappings());
 
+    // pd's GUI updates follow the frame rate
+    frameScheduler.onFrameRateChange = [this](int framesPerSecond) {
+        pd.guiUpdateInterval = 1000 / framesPerSecond;
+    };
+
     pd.locked.addListener(this);
     pd.settingsTree.addListener(this);
 
@@ -84,6 +90,9 @@ PlugDataPluginEditor::PlugDataPluginEditor(PlugDataAudioProcessor& p) : AudioPro
     
     zoomScale.referTo(pd.settingsTree.getPropertyAsValue("Zoom", nullptr));
     zoomScale.addListener(this);
+
+    hardwareAcceleration.referTo(pd.settingsTree.getPropertyAsValue("HardwareAcceleration", nullptr));
+    hardwareAcceleration.addListener(this);
     
     addAndMakeVisible(statusbar);
 
@@ -100,14 +109,7 @@ PlugDataPluginEditor::PlugDataPluginEditor(PlugDataAudioProcessor& p) : AudioPro
     
     tabbar.onTabChange = [this](int idx)
     {
-        if (idx == -1) return;
-
-        // update GraphOnParent when changing tabs
-        for (auto* object : getCurrentCanvas()->objects)
-        {
-            if (!object->gui) continue;
-            if (auto* cnv = object->gui->getCanvas()) cnv->synchronise();
-        }
+        if (idx == -1 || deferTabContent) return;
 
         auto* cnv = getCurrentCanvas();
         if (cnv->patch.getPointer())
@@ -115,7 +117,22 @@ PlugDataPluginEditor::PlugDataPluginEditor(PlugDataAudioProcessor& p) : AudioPro
             cnv->patch.setCurrent();
         }
 
-        cnv->synchronise();
+        if (cnv->hasContent())
+        {
+            // update GraphOnParent when changing tabs
+            for (auto* object : cnv->objects)
+            {
+                if (!object->gui) continue;
+                if (auto* graph = object->gui->getCanvas()) graph->synchronise();
+            }
+
+            cnv->synchronise();
+        }
+
+        // Synchronises when the content wasn't loaded yet
+        cnv->loadContent();
+        releaseHiddenTabs();
+
         cnv->updateGuiValues();
         cnv->updateDrawables();
         cnv->updateGuiParameters();
@@ -213,14 +230,22 @@ PlugDataPluginEditor::PlugDataPluginEditor(PlugDataAudioProcessor& p) : AudioPro
     // Make sure existing console messages are processed
     sidebar.updateConsole();
     updateCommandStatus();
+
+    // Starts parsing the most opened help patches, so their previews are ready
+    HelpPreviewCache::getInstance();
     
     addChildComponent(zoomLabel);
+    addChildComponent(paintProfiler);
     
     // Initialise zoom factor
     valueChanged(zoomScale);
+    valueChanged(hardwareAcceleration);
 }
 PlugDataPluginEditor::~PlugDataPluginEditor()
 {
+    // The patches stay open when the editor closes, our canvases are the only ones with their info
+    pd::Storage::storeAll(&pd);
+
     auto keymap = pd.settingsTree.getChildWithName("Keymap");
     if (keymap.isValid())
     {
@@ -233,10 +258,17 @@ PlugDataPluginEditor::~PlugDataPluginEditor()
     pd.locked.removeListener(this);
     zoomScale.removeListener(this);
     theme.removeListener(this);
+    hardwareAcceleration.removeListener(this);
+
+    openGLContext.detach();
+
+    pd.guiUpdateInterval = PlugDataAudioProcessor::defaultGuiUpdateInterval;
 }
 
 void PlugDataPluginEditor::paint(Graphics& g)
 {
+    PaintProfiler::beginFrame();
+
     g.setColour(findColour(PlugDataColour::canvasBackgroundColourId));
     g.fillRoundedRectangle(getLocalBounds().toFloat(), 6.0f);
     
@@ -327,6 +359,7 @@ void PlugDataPluginEditor::resized()
     pd.lastUIHeight = getHeight();
     
     zoomLabel.setTopLeftPosition(5, statusbar.getY() - 28);
+    paintProfiler.setBounds(getLocalBounds());
     zoomLabel.setSize(50, 23);
     
     if (auto* cnv = getCurrentCanvas())
@@ -428,6 +461,7 @@ void PlugDataPluginEditor::saveProjectAs(const std::function<void()>& nestedCall
                                      result = result.withFileExtension(".pd");
 
                                      getCurrentCanvas()->patch.savePatch(result);
+                                     pd.updateAbstractionWatcher();
                                  }
 
                                  nestedCallback();
@@ -518,6 +552,9 @@ void PlugDataPluginEditor::addTab(Canvas* cnv, bool deleteWhenClosed)
 
             auto* patch = &cnv->patch;
 
+            // The patch may stay open without this canvas, so it needs the info the canvas kept
+            cnv->storage.storeInfo();
+
             if (deleteWhenClosed)
             {
                 patch->close();
@@ -526,6 +563,7 @@ void PlugDataPluginEditor::addTab(Canvas* cnv, bool deleteWhenClosed)
             canvases.removeObject(cnv);
             tabbar.removeTab(idx);
             pd.patches.removeObject(patch);
+            pd.updateAbstractionWatcher();
 
             tabbar.setCurrentTabIndex(tabbar.getNumTabs() - 1, true);
             updateCommandStatus();
@@ -604,6 +642,18 @@ void PlugDataPluginEditor::valueChanged(Value& v)
         
         zoomLabel.setZoomLevel(scale);
     }
+    else if (v.refersToSameSourceAs(hardwareAcceleration))
+    {
+        // Everything in the editor is then drawn by JUCE's OpenGL renderer, which turns fills, text and paths into batched GPU draws
+        if (static_cast<bool>(hardwareAcceleration.getValue()))
+        {
+            if (!openGLContext.isAttached()) openGLContext.attachTo(*this);
+        }
+        else
+        {
+            openGLContext.detach();
+        }
+    }
     // Update theme
     else if (v.refersToSameSourceAs(theme))
     {
@@ -630,11 +680,25 @@ void PlugDataPluginEditor::valueTreeChildRemoved(ValueTree& parentTree, ValueTre
 void PlugDataPluginEditor::timerCallback()
 {
     // Save settings to file whenever valuetree state changes
-    // Use timer to group changes together
-    pd.saveSettings();
+    // Use timer to group changes together, so the tree isn't serialised for every one of them
+    pd.saveSettingsAsync();
     stopTimer();
 }
 
+void PlugDataPluginEditor::releaseHiddenTabs()
+{
+    auto const now = Time::getMillisecondCounterHiRes();
+    auto* current = getCurrentCanvas();
+
+    for (auto* cnv : canvases)
+    {
+        if (cnv != current && cnv->hasContent() && now - cnv->lastShown > releaseHiddenTabsAfterMs)
+        {
+            cnv->releaseContent();
+        }
+    }
+}
+
 void PlugDataPluginEditor::updateCommandStatus()
 {
     if (auto* cnv = getCurrentCanvas())
@@ -664,6 +728,19 @@ void PlugDataPluginEditor::updateCommandStatus()
         auto* patchPtr = cnv->patch.getPointer();
         if (!patchPtr) return;
         
+        // Every edit ends up here, so this is where the undo history is kept in check
+        if (!isDragging)
+        {
+            const pd::CallbackLock::ScopedLockType lock(*pd.getCallbackLock());
+
+            if (patchPtr != compactedPatch || libpd_undo_get_position(patchPtr) != compactedUndoPosition)
+            {
+                libpd_undo_compact(patchPtr, pd::Patch::undoMemoryBudget);
+                compactedPatch = patchPtr;
+                compactedUndoPosition = libpd_undo_get_position(patchPtr);
+            }
+        }
+
         auto deletionCheck = SafePointer(this);
 
         // First on pd's thread, get undo status
@@ -11,6 +11,8 @@
 #include "Dialogs/Dialogs.h"
 #include "Sidebar/Sidebar.h"
 #include "Statusbar.h"
+#include "Utility/PaintProfiler.h"
+#include "Utility/FrameScheduler.h"
 
 #ifndef PLUGDATA_STANDALONE
 #define PLUGDATA_ROUNDED 0
@@ -314,6 +316,9 @@ class PlugDataPluginEditor : public AudioProcessorEditor, public Value::Listener
 
     void addTab(Canvas* cnv, bool deleteWhenClosed = false);
 
+    // While set, showing a tab doesn't load the content of its canvas, for adding many tabs at once
+    bool deferTabContent = false;
+
     Canvas* getCurrentCanvas();
     Canvas* getCanvas(int idx);
     
@@ -343,6 +348,9 @@ class PlugDataPluginEditor : public AudioProcessorEditor, public Value::Listener
 
     PlugDataAudioProcessor& pd;
 
+    // Periodic updates of objects, declared before the canvases so it outlives them
+    FrameScheduler frameScheduler;
+
     AffineTransform transform;
 
     TabComponent tabbar;
@@ -352,10 +360,18 @@ class PlugDataPluginEditor : public AudioProcessorEditor, public Value::Listener
 
     std::atomic<bool> canUndo = false, canRedo = false;
 
+    // Undo history that was compacted last, so it's only done again after an edit
+    void* compactedPatch = nullptr;
+    size_t compactedUndoPosition = 0;
+
     std::unique_ptr<Dialog> openedDialog = nullptr;
     
     Value theme;
     Value zoomScale;
+    Value hardwareAcceleration;
+
+    // Developer overlay, toggled from the statusbar
+    PaintProfiler paintProfiler;
 
    private:
     
@@ -370,8 +386,14 @@ class PlugDataPluginEditor : public AudioProcessorEditor, public Value::Listener
 
     OwnedArray<TextButton> toolbarButtons;
 
+    // Canvases of tabs that weren't shown for this long release their objects, see Canvas::releaseContent
+    static constexpr double releaseHiddenTabsAfterMs = 5.0 * 60.0 * 1000.0;
+    void releaseHiddenTabs();
+
     SharedResourcePointer<TooltipWindow> tooltipWindow;
 
+    OpenGLContext openGLContext;
+
     TextButton seperators[2];
     
     ZoomLabel zoomLabel;
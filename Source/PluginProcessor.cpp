@@ -4,7 +4,11 @@
  // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
  */
 
+#include <bit>
 #include <clocale>
+#include <future>
+#include <mutex>
+#include <string_view>
 #include "PluginProcessor.h"
 
 #include "Canvas.h"
@@ -12,10 +16,21 @@
 #include "LookAndFeel.h"
 
 #include "Utility/PluginParameter.h"
+#include "Utility/FilesystemExtractor.h"
+#include "Utility/Trace.h"
+#include "Utility/RealtimeCheck.h"
+#include "Objects/GUIObject.h"
+#include "Pd/PdLibraryPaths.h"
+#include "Pd/PdAudioBuses.h"
+#include "Pd/PdDiskRecorders.h"
+#include "Pd/PdSharedArrays.h"
+#include "Pd/PdTableLoads.h"
+#include "Pd/PdCompiledPatch.h"
 
 extern "C"
 {
     #include "x_libpd_extra_utils.h"
+    #include "x_libpd_param.h"
     EXTERN char* pd_version;
 #if JUCE_WINDOWS && _WIN64
     // Need this to create directory junctions on Windows
@@ -23,6 +38,54 @@ extern "C"
 #endif
 }
 
+namespace
+{
+// Times the phases of the constructor, so hosts that are slow to load a project can tell us where the time went
+struct StartupTimer
+{
+    void phase(char const* name)
+    {
+        auto const now = Time::getHighResolutionTicks();
+        phases.add(String(name) + " " + String(Time::highResolutionTicksToSeconds(now - last) * 1000.0, 1) + " ms");
+        last = now;
+    }
+
+    // Seconds since the timer was created, up to the last phase
+    double getTotal() const
+    {
+        return Time::highResolutionTicksToSeconds(last - start);
+    }
+
+    String getSummary() const
+    {
+        return phases.joinIntoString(", ");
+    }
+
+    int64 const start = Time::getHighResolutionTicks();
+    int64 last = start;
+    StringArray phases;
+};
+
+// The settings are loaded after the parameters are created, so only the attributes of the settings file are read for this
+int readNumAutomationParameters(File const& settingsFile, int maximum)
+{
+    if (auto settings = XmlDocument(settingsFile).getDocumentElement(true))
+        return jlimit(0, maximum, settings->getIntAttribute("NumParameters", maximum));
+
+    return maximum;
+}
+
+bool isSilent(AudioBuffer<float> const& buffer, int numChannels, float threshold)
+{
+    for (int ch = 0; ch < numChannels; ch++)
+    {
+        auto const range = FloatVectorOperations::findMinAndMax(buffer.getReadPointer(ch), buffer.getNumSamples());
+        if (range.getEnd() > threshold || range.getStart() < -threshold) return false;
+    }
+    return true;
+}
+}
+
 AudioProcessor::BusesProperties PlugDataAudioProcessor::buildBusesProperties()
 {
     AudioProcessor::BusesProperties busesProperties;
@@ -47,109 +110,145 @@ PlugDataAudioProcessor::PlugDataAudioProcessor()
 {
     // Make sure to use dots for decimal numbers, pd requires that
     std::setlocale(LC_ALL, "C");
+
+    StartupTimer startupTimer;
+
+    // The files don't depend on anything below, so they are checked while the parameters are created
+    auto filesystemReady = std::async(std::launch::async, [this]() {
+        auto const start = Time::getHighResolutionTicks();
+        initialiseFilesystem();
+        return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+    });
     
-    // continuityChecker keeps track of whether audio is running and creates a backup scheduler in case it isn't
-    continuityChecker.setCallback([this](t_float* in, t_float* out){
+    // continuityChecker keeps track of whether audio is running and runs a backup scheduler in case it isn't
+    // It owns pd while this is called, so there's no need for the callback lock
+    continuityChecker.setCallback([this](){
         
-        if(isNonRealtime()) return;
+        // Dequeue messages
+        sendMessagesFromQueue();
         
-        if(getCallbackLock()->tryEnter()) {
-            
-            // Dequeue messages
-            sendMessagesFromQueue();
-            
-            libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
-            libpd_process_nodsp();
-            getCallbackLock()->exit();
-        }
+        libpd_set_instance(static_cast<t_pdinstance*>(m_instance));
+        libpd_process_nodsp();
     });
     
     parameters.createAndAddParameter(std::make_unique<AudioParameterFloat>(ParameterID("volume", 1), "Volume", NormalisableRange<float>(0.0f, 1.0f, 0.001f, 0.75f, false), 1.0f));
 
+#if !PLUGDATA_STANDALONE
     // General purpose automation parameters you can get by using "receive param1" etc.
-    for (int n = 0; n < numParameters; n++)
+    // Hosts list and save every one of them, so projects that need fewer can ask for fewer
+    numAutomationParameters = readNumAutomationParameters(settingsFile, numParameters);
+
+    for (int n = 0; n < numAutomationParameters; n++)
     {
         auto id = ParameterID("param" + String(n + 1), 1);
         //auto* parameter = parameters.createAndAddParameter(std::make_unique<PlugDataParameter>(this, "Parameter " + String(n + 1),  "", 0.0f));
         
         auto* parameter = parameters.createAndAddParameter(std::make_unique<AudioParameterFloat>(id, "Parameter " + String(n + 1), 0.0f, 1.0f, 0.0f));
         
-        lastParameters[n] = 0;
         parameter->addListener(this);
     }
+#endif
 
     volume = parameters.getRawParameterValue("volume");
 
+    startupTimer.phase("parameters");
+
+    setThis();
+    for (int n = 0; n < numParameters; n++)
+    {
+        parameterSymbols[n] = gensym(("param" + String(n + 1)).toRawUTF8());
+        parameterRampSymbols[n] = gensym(("param" + String(n + 1) + "~").toRawUTF8());
+    }
+
+    playheadPublisher.prepare();
+    audioStats.prepare();
+
+    // Delivers scheduled midi at its position inside the tick, in samples of pd's logical time
+    midiClock = clock_new(this, reinterpret_cast<t_method>(+[](PlugDataAudioProcessor* processor) {
+        processor->dispatchScheduledMidi(processor->scheduledMidiPosition);
+    }));
+    clock_setunit(midiClock, 1, 1);
+
     // Make sure that the parameter valuetree has a name, to prevent assertion failures
     parameters.replaceState(ValueTree("PlugData"));
     
+    startupTimer.phase("receivers");
+
+    // The library reads the abstractions, so it has to wait for them
+    auto const filesystemTime = filesystemReady.get();
+    startupTimer.phase("waiting for files");
+
     // scope for locking message manager
     {
         const MessageManagerLock mmLock;
         
         LookAndFeel::setDefaultLookAndFeel(&lnf.get());
         
-        // On first startup, initialise abstractions and settings
-        initialiseFilesystem();
-        
-        // Initialise library for text autocompletion
-        objectLibrary.initialiseLibrary();
+        // The settings change the shared look and feel
+        initialiseSettings();
     }
-    
-    channelPointers.reserve(32);
 
+    startupTimer.phase("settings");
+
+    // Initialise library for text autocompletion, only the first instance of the process does any work
+    objectLibrary->initialiseLibrary();
+
+    // [sendbus~] and [receivebus~] connect every instance in the process
+    pd::AudioBuses::getInstance();
+
+    // [diskrec~] objects of every instance share the thread that writes their files
+    pd::DiskRecorders::getInstance();
+
+    // Arrays that are shared with the "share" message are kept once for every instance in the process
+    pd::SharedArrays::getInstance();
+
+    // Files that [soundfiler] reads with "readasync" are decoded on the shared workers
+    pd::TableLoads::getInstance();
+    
     // Set up midi buffers
     midiBufferIn.ensureSize(2048);
-    midiBufferOut.ensureSize(2048);
     midiBufferTemp.ensureSize(2048);
     midiBufferCopy.ensureSize(2048);
+    midiBufferScheduled.ensureSize(2048);
+    nextScheduledMidi = midiBufferScheduled.end();
+    setMidiOutput(&midiOutputBus);
 
-    atoms_playhead.reserve(3);
-    atoms_playhead.resize(1);
+#if PLUGDATA_STANDALONE
+    for (int port = 0; port < numMidiPorts; port++)
+    {
+        midiInputPorts.add(new pd::MidiInputRing(static_cast<int>(pd::MidiBus::maxSysexSize) + 4096));
+    }
+#endif
 
     setCallbackLock(&AudioProcessor::getCallbackLock());
 
     sendMessagesFromQueue();
 
-    objectLibrary.appDirChanged = [this]()
-    {
-        // If we changed the settings from within the app, don't reload
-        if(!settingsChangedInternally) {
-            
-            auto newTree = ValueTree::fromXml(settingsFile.loadFileAsString());
-            
-            // Prevents causing an update loop
-            if (auto* editor = dynamic_cast<PlugDataPluginEditor*>(getActiveEditor()))
-            {
-                settingsTree.removeListener(editor);
-            }
-            
-            settingsTree.getChildWithName("Paths").copyPropertiesAndChildrenFrom(newTree.getChildWithName("Paths"), nullptr);
-            
-            // Direct children shouldn't be overwritten as that would break some valueTree links, for example in SettingsDialog
-            for (auto child : settingsTree)
-            {
-                child.copyPropertiesAndChildrenFrom(newTree.getChildWithName(child.getType()), nullptr);
-            }
-            settingsTree.copyPropertiesFrom(newTree, nullptr);
-            
-            if (auto* editor = dynamic_cast<PlugDataPluginEditor*>(getActiveEditor()))
-            {
-                settingsTree.addListener(editor);
-                
-                for(auto* cnv : editor->canvases) {
-                    // Make sure inlets/outlets are updated
-                    for(auto* object : cnv->objects) object->updatePorts();
+    objectLibrary->addListener(this);
+    SettingsStore::getInstance()->addListener(this);
+
+    // Subpatches and abstractions opened in the editor are in here as well, the graphs that show
+    // their content inside a graph-on-parent box aren't, so those are collected from the editor
+    abstractionWatcher.getOpenCanvases = [this]() {
+        std::vector<void*> canvases;
+        for (auto* patch : patches)
+            canvases.push_back(patch->getPointer());
+
+        std::function<void(Canvas*)> addGraphs = [&](Canvas* cnv) {
+            for (auto* object : cnv->objects) {
+                if (auto* graph = object->gui ? object->gui->getCanvas() : nullptr) {
+                    canvases.push_back(graph->patch.getPointer());
+                    addGraphs(graph);
                 }
             }
+        };
+
+        if (auto* editor = dynamic_cast<PlugDataPluginEditor*>(getActiveEditor())) {
+            for (auto* cnv : editor->canvases)
+                addGraphs(cnv);
         }
 
-        settingsChangedInternally = false;
-        
-        updateSearchPaths();
-        objectLibrary.updateLibrary();
-        
-        setTheme(static_cast<bool>(settingsTree.getProperty("Theme")));
+        return canvases;
     };
 
     if (settingsTree.hasProperty("Theme"))
@@ -161,35 +260,168 @@ PlugDataAudioProcessor::PlugDataAudioProcessor()
         oversampling = static_cast<int>(settingsTree.getProperty("Oversampling"));
     }
 
+    if(settingsTree.hasProperty("OversamplingEngine")) {
+        oversamplingEngine = static_cast<Oversampler::Engine>(std::clamp(static_cast<int>(settingsTree.getProperty("OversamplingEngine")), 0, Oversampler::numEngines - 1));
+    }
+
+    if(settingsTree.hasProperty("InternalRate")) {
+        internalRate = std::max(0, static_cast<int>(settingsTree.getProperty("InternalRate")));
+    }
+
+    if(settingsTree.hasProperty("SampleAccurateMidi")) {
+        sampleAccurateMidi = static_cast<bool>(settingsTree.getProperty("SampleAccurateMidi"));
+    }
+
+    if(settingsTree.hasProperty("AutoSleep")) {
+        autoSleep = static_cast<bool>(settingsTree.getProperty("AutoSleep"));
+    }
+
+#if PLUGDATA_STANDALONE
+    if(settingsTree.hasProperty("LowLatency")) {
+        lowLatency = static_cast<bool>(settingsTree.getProperty("LowLatency"));
+    }
+#endif
+
+    if(settingsTree.hasProperty("PlayheadRate")) {
+        playheadPublisher.setRate(static_cast<pd::PlayheadPublisher::Rate>(std::clamp(static_cast<int>(settingsTree.getProperty("PlayheadRate")), 0, 2)));
+    }
+
     updateSearchPaths();
     
-    setLatencySamples(pd::Instance::getBlockSize());
+    setBaseLatency(pd::Instance::getBlockSize());
+
+    // After the base latency, which is for a single tick
+    if(settingsTree.hasProperty("InternalBlockSize")) {
+        setTicksPerBlock(std::clamp(static_cast<int>(settingsTree.getProperty("InternalBlockSize")), libpd_blocksize(), maxInternalBlockSize) / libpd_blocksize());
+    }
+
+    startupTimer.phase("search paths");
 
     logMessage("PlugData v" + String(ProjectInfo::versionString));
     logMessage("Based on " + String(pd_version).upToFirstOccurrenceOf("(", false, false));
     logMessage("Libraries:");
     logMessage(else_version);
     logMessage(cyclone_version);
+
+#if PLUGDATA_STANDALONE
+    // Once startup is done, so the recovered patches open next to the ones opened on startup
+    MessageManager::callAsync([this]() { autosave.recover(); });
+#endif
+
+    logMessage("Started in " + String(constructionTime * 1000.0 + startupTimer.getTotal() * 1000.0, 1) + " ms (pd " + String(constructionTime * 1000.0, 1) + " ms, " + startupTimer.getSummary() + ", files " + String(filesystemTime * 1000.0, 1) + " ms in parallel)");
 }
 
 PlugDataAudioProcessor::~PlugDataAudioProcessor()
 {
+    objectLibrary->removeListener(this);
+
     // Save current settings before quitting
     saveSettings();
+    SettingsStore::getInstance()->removeListener(this);
+
+    // The backup scheduler calls into this processor
+    continuityChecker.stop();
+
+    setThis();
+    clock_free(midiClock);
+}
+
+void PlugDataAudioProcessor::appDirChanged()
+{
+    // If we changed the settings from within the app, don't reload
+    // Instances in this process send their changes directly, the file only has to be read when something else wrote it
+    if(!settingsChangedInternally && SettingsStore::getInstance()->wasChangedOutside(settingsFile)) {
+        applySettings(ValueTree::fromXml(settingsFile.loadFileAsString()));
+    }
+
+    settingsChangedInternally = false;
+    
+    updateSearchPaths();
+    
+    setTheme(static_cast<bool>(settingsTree.getProperty("Theme")));
+}
+
+void PlugDataAudioProcessor::settingsChanged(ValueTree const& newSettings)
+{
+    applySettings(newSettings);
+
+    updateSearchPaths();
+
+    setTheme(static_cast<bool>(settingsTree.getProperty("Theme")));
+}
+
+void PlugDataAudioProcessor::applySettings(ValueTree const& newSettings)
+{
+    if (!newSettings.isValid())
+        return;
+
+    // Prevents causing an update loop
+    if (auto* editor = dynamic_cast<PlugDataPluginEditor*>(getActiveEditor()))
+    {
+        settingsTree.removeListener(editor);
+    }
+
+    // Children shouldn't be replaced as that would break some valueTree links, for example in SettingsDialog
+    SettingsStore::applyChanges(settingsTree, newSettings);
+
+    if (auto* editor = dynamic_cast<PlugDataPluginEditor*>(getActiveEditor()))
+    {
+        settingsTree.addListener(editor);
+
+        for(auto* cnv : editor->canvases) {
+            // Make sure inlets/outlets are updated
+            for(auto* object : cnv->objects) object->updatePorts();
+        }
+    }
 }
 
 void PlugDataAudioProcessor::initialiseFilesystem()
 {
-    // Check if the abstractions directory exists, if not, unzip it from binaryData
-    if (!homeDir.exists() || !abstractions.exists())
+    // Every instance of the process sees the same files, so only the first one has to check them
+    static std::mutex abstractionsMutex;
+    static bool abstractionsChecked = false;
+    static std::atomic<bool> documentationPending = true;
+
+    auto const isFirstRun = !homeDir.exists() || !abstractions.exists();
+    
+    // Patches can't load without the abstractions, so these have to be there before anything else
+    // This only writes files that are missing or outdated, and does nothing if they are all up to date
+    {
+        std::lock_guard<std::mutex> lock(abstractionsMutex);
+        if (!std::exchange(abstractionsChecked, true))
+        {
+            FilesystemExtractor(BinaryData::Filesystem_zip, BinaryData::Filesystem_zipSize).extract("plugdata_version/Abstractions/", abstractions);
+        }
+    }
+    
+    // The documentation is only needed for help files and autocompletion, so it can arrive later
+    auto const documentation = appDir.getChildFile("Documentation");
+    documentation.createDirectory();
+    
+    if (documentationPending.exchange(false))
+    {
+        filesystemThread.runLambda([this, documentation]() {
+            auto const numWritten = FilesystemExtractor(BinaryData::Filesystem_zip, BinaryData::Filesystem_zipSize).extract("plugdata_version/Documentation/", documentation, [this]() { return filesystemThread.threadShouldExit(); });
+            
+            // Let the next instance finish the job if this one was closed before it was done
+            if (filesystemThread.threadShouldExit())
+            {
+                documentationPending = true;
+                return;
+            }
+            
+            if (numWritten > 0)
+            {
+                MessageManager::callAsync([library = objectLibrary]() mutable {
+                    library->updateLibrary();
+                });
+            }
+        });
+    }
+    
+    // Create the library folder and its links on first startup
+    if (isFirstRun)
     {
-        MemoryInputStream binaryFilesystem(BinaryData::Filesystem_zip, BinaryData::Filesystem_zipSize, false);
-        auto file = ZipFile(binaryFilesystem);
-        file.uncompressTo(homeDir);
-        
-        // Create filesystem for this specific version
-        homeDir.getChildFile("plugdata_version").moveFileTo(appDir);
-        
         auto library = homeDir.getChildFile("Library");
         auto deken = homeDir.getChildFile("Deken");
         
@@ -210,37 +442,36 @@ void PlugDataAudioProcessor::initialiseFilesystem()
         deken.createDirectory();
         
 #if JUCE_WINDOWS
-        // Get paths that need symlinks
-        auto abstractionsPath = appDir.getChildFile("Abstractions").getFullPathName().replaceCharacters("/", "\\");
-        auto documentationPath = appDir.getChildFile("Documentation").getFullPathName().replaceCharacters("/", "\\");
-        auto dekenPath = deken.getFullPathName();
-        
-        // The mklink /J command creates a directory junction. This is the closest thing I can get to a directory symlink on Windows
-        // Regular symlinks can only created by administrators
-        auto abstractionsCommand = "cmd.exe /k mklink /J " + library.getChildFile("Abstractions").getFullPathName().replaceCharacters("/", "\\") + " " + abstractionsPath;
-        auto documentationCommand = "cmd.exe /k mklink /J " + library.getChildFile("Documentation").getFullPathName().replaceCharacters("/", "\\") + " " + documentationPath;
-        auto dekenCommand = "cmd.exe /k mklink /J " + library.getChildFile("Deken").getFullPathName().replaceCharacters("/", "\\") + " " + dekenPath;
-        
-        // Execute junction command
-        // TODO: write real C++ code for creating junctions
+        // Every link is tried on its own, so one that fails doesn't affect the others
+        auto createLink = [](File const& target, File const& link) {
+            // Symlinks work without admin rights when developer mode is enabled
+            if (target.createSymbolicLink(link, true))
+                return;
+
+            // Otherwise fall back to a directory junction, the closest thing to a directory symlink that doesn't need admin rights
+            // TODO: write real C++ code for creating junctions
+            auto const command = "cmd.exe /k mklink /J \"" + link.getFullPathName().replaceCharacters("/", "\\") + "\" \"" + target.getFullPathName().replaceCharacters("/", "\\") + "\"";
 #if _WIN64
-        // For some reason, this only links with 64-bit targets
-        WinExec(abstractionsCommand.toRawUTF8(), 0);
-        WinExec(documentationCommand.toRawUTF8(), 0);
-        WinExec(dekenCommand.toRawUTF8(), 0);
-#else   
-        system(abstractionsCommand.fromFirstOccurrenceOf("/k", false, false).toRawUTF8());
-        system(documentationCommand.fromFirstOccurrenceOf("/k", false, false).toRawUTF8());
-        system(dekenCommand.fromFirstOccurrenceOf("/k", false, false).toRawUTF8());
+            // For some reason, this only links with 64-bit targets
+            WinExec(command.toRawUTF8(), 0);
+#else
+            system(command.fromFirstOccurrenceOf("/k", false, false).toRawUTF8());
 #endif
+        };
 
+        createLink(appDir.getChildFile("Abstractions"), library.getChildFile("Abstractions"));
+        createLink(appDir.getChildFile("Documentation"), library.getChildFile("Documentation"));
+        createLink(deken, library.getChildFile("Deken"));
 #else
         appDir.getChildFile("Abstractions").createSymbolicLink(library.getChildFile("Abstractions"), true);
         appDir.getChildFile("Documentation").createSymbolicLink(library.getChildFile("Documentation"), true);
         deken.createSymbolicLink(library.getChildFile("Deken"), true);
 #endif
     }
-    
+}
+
+void PlugDataAudioProcessor::initialiseSettings()
+{
     // Check if settings file exists, if not, create the default
     if (!settingsFile.existsAsFile())
     {
@@ -315,9 +546,14 @@ void PlugDataAudioProcessor::initialiseFilesystem()
 
 void PlugDataAudioProcessor::saveSettings()
 {
-    // Save settings to file
-    auto xml = settingsTree.toXmlString();
-    settingsFile.replaceWithText(xml);
+    // Replaces any save that's still waiting, it's older than this one
+    saveSettingsAsync();
+    SettingsStore::getInstance()->flush();
+}
+
+void PlugDataAudioProcessor::saveSettingsAsync()
+{
+    SettingsStore::getInstance()->save(settingsFile, settingsTree, this);
 }
 
 void PlugDataAudioProcessor::updateSearchPaths()
@@ -325,6 +561,9 @@ void PlugDataAudioProcessor::updateSearchPaths()
     // Reload pd search paths from settings
     auto pathTree = settingsTree.getChildWithName("Paths");
 
+    // Folders of installed libraries are only searched once something is loaded from them
+    auto libraryPaths = pd::LibraryPaths::getInstance()->setFolders(DekenInterface::getExternalPaths());
+
     setThis();
     
     getCallbackLock()->enter();
@@ -344,7 +583,7 @@ void PlugDataAudioProcessor::updateSearchPaths()
         libpd_add_to_search_path(location.toRawUTF8());
     }
     
-    for (auto path : DekenInterface::getExternalPaths())
+    for (auto path : libraryPaths)
     {
         libpd_add_to_search_path(path.toRawUTF8());
     }
@@ -391,22 +630,31 @@ double PlugDataAudioProcessor::getTailLengthSeconds() const
 
 int PlugDataAudioProcessor::getNumPrograms()
 {
-    return 1;  // NB: some hosts don't cope very well if you tell them there are 0 programs,
+    return std::max(1, numPrograms.load());  // NB: some hosts don't cope very well if you tell them there are 0 programs,
     // so this should be at least 1, even if you're not really implementing programs.
 }
 
 int PlugDataAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return currentProgram;
 }
 
+// Only chooses a program, the audio thread switches to it at the start of its next block
 void PlugDataAudioProcessor::setCurrentProgram(int index)
 {
+    if (!isPositiveAndBelow(index, numPrograms.load()))
+        return;
+
+    currentProgram = index;
+    pendingProgram = index;
 }
 
 const String PlugDataAudioProcessor::getProgramName(int index)
 {
-    return "Init preset";
+    if (isPositiveAndBelow(index, maxPrograms) && programs[index])
+        return programs[index]->getFile().getFileNameWithoutExtension();
+
+    return index == 0 ? "Init preset" : String();
 }
 
 void PlugDataAudioProcessor::changeProgramName(int index, const String& newName)
@@ -416,121 +664,594 @@ void PlugDataAudioProcessor::changeProgramName(int index, const String& newName)
 void PlugDataAudioProcessor::setOversampling(int amount)
 {
     settingsTree.setProperty("Oversampling", var(amount), nullptr);
-    saveSettings();
+    saveSettingsAsync();
     
-    oversampling = amount;
-    auto blockSize = AudioProcessor::getBlockSize();
-    auto sampleRate = AudioProcessor::getSampleRate();
-    
-    suspendProcessing(true);
-    prepareToPlay(sampleRate, blockSize);
-    suspendProcessing(false);
+    changeOversampling(amount, oversamplingEngine, internalRate);
 }
 
-void PlugDataAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
+void PlugDataAudioProcessor::setOversamplingEngine(int engine)
 {
-    float oversampleFactor = 1 << oversampling;
-    auto maxChannels = std::max(getTotalNumInputChannels(), getTotalNumOutputChannels());
-    
-    prepareDSP(getTotalNumInputChannels(), getTotalNumOutputChannels(), sampleRate * oversampleFactor, samplesPerBlock * oversampleFactor);
-    
-    oversampler.reset (new dsp::Oversampling<float> (maxChannels, oversampling, dsp::Oversampling<float>::filterHalfBandPolyphaseIIR, false));
+    engine = std::clamp(engine, 0, Oversampler::numEngines - 1);
     
-    oversampler->initProcessing (samplesPerBlock);
+    settingsTree.setProperty("OversamplingEngine", var(engine), nullptr);
+    saveSettingsAsync();
     
-    audioAdvancement = 0;
-    const auto blksize = static_cast<size_t>(Instance::getBlockSize());
-    const auto numIn = std::max(static_cast<size_t>(getTotalNumInputChannels()), static_cast<size_t>(2));
-    const auto nouts = std::max(static_cast<size_t>(getTotalNumOutputChannels()), static_cast<size_t>(2));
-    audioBufferIn.resize(numIn * blksize);
-    audioBufferOut.resize(nouts * blksize);
-    std::fill(audioBufferOut.begin(), audioBufferOut.end(), 0.f);
-    std::fill(audioBufferIn.begin(), audioBufferIn.end(), 0.f);
-    midiBufferIn.clear();
-    midiBufferOut.clear();
-    midiBufferTemp.clear();
-
-    midiByteIndex = 0;
-    midiByteBuffer[0] = 0;
-    midiByteBuffer[1] = 0;
-    midiByteBuffer[2] = 0;
-
-    startDSP();
-
-    statusbarSource.prepareToPlay(getTotalNumOutputChannels());
+    changeOversampling(oversampling, static_cast<Oversampler::Engine>(engine), internalRate);
 }
 
-void PlugDataAudioProcessor::releaseResources()
+void PlugDataAudioProcessor::setInternalRate(int rate)
 {
-    releaseDSP();
+    rate = std::max(rate, 0);
+    
+    settingsTree.setProperty("InternalRate", var(rate), nullptr);
+    saveSettingsAsync();
+    
+    changeOversampling(oversampling, oversamplingEngine, rate);
 }
 
-bool PlugDataAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
+void PlugDataAudioProcessor::setInternalBlockSize(int samples)
 {
-#if JucePlugin_IsMidiEffect
-    ignoreUnused(layouts);
-    return true;
-#endif
-
-    int ninch = 0;
-    int noutch = 0;
-    for (int bus = 0; bus < layouts.outputBuses.size(); bus++)
+    auto const ticks = std::clamp(samples, libpd_blocksize(), maxInternalBlockSize) / libpd_blocksize();
+    
+    settingsTree.setProperty("InternalBlockSize", var(ticks * libpd_blocksize()), nullptr);
+    saveSettingsAsync();
+    
+    if (ticks == getTicksPerBlock()) return;
+    
+    auto blockSize = AudioProcessor::getBlockSize();
+    auto sampleRate = AudioProcessor::getSampleRate();
+    
+    // The FIFOs are sized for the block, so they're set up again with the audio thread kept out
+    suspendProcessing(true);
     {
-        int nchb = layouts.getNumChannels(false, bus);
-
-        if (layouts.outputBuses[bus].isDisabled()) continue;
-
-        if (nchb > 2) return false;
-        if (nchb == 0) return false;
-        noutch += nchb;
+        const pd::CallbackLock::ScopedLockType lock(*getCallbackLock());
+        
+        setTicksPerBlock(ticks);
+        for (auto* layer : layers)
+        {
+            layer->setTicksPerBlock(ticks);
+        }
+        
+        // Not prepared yet, prepareToPlay will pick it up
+        if (sampleRate > 0.0 && blockSize > 0)
+        {
+            prepareToPlay(sampleRate, blockSize);
+        }
     }
+    suspendProcessing(false);
+}
 
-    for (int bus = 0; bus < layouts.inputBuses.size(); bus++)
-    {
-        int nchb = layouts.getNumChannels(true, bus);
+void PlugDataAudioProcessor::setBaseLatency(int samples)
+{
+    baseLatency = samples;
+    updateLatency();
+}
 
-        if (layouts.inputBuses[bus].isDisabled()) continue;
+int PlugDataAudioProcessor::getBaseLatency() const
+{
+    return baseLatency;
+}
 
-        if (nchb > 2) return false;
-        if (nchb == 0) return false;
-        ninch += nchb;
-    }
+// Reports the sum of the block adaptation, the resampling filters and what the patch declared
+// The patch counts samples at pd's rate, the host wants them at its own rate
+void PlugDataAudioProcessor::updateLatency()
+{
+    auto filterLatency = oversampling > 0 && oversampler ? oversampler->getLatencyInSamples() : 0.0f;
+    if (undersampling > 0 && undersampler)
+        filterLatency += undersampler->getLatencyInSamples();
 
-    return ninch <= 32 && noutch <= 32;
-}
+    auto hostPatchLatency = static_cast<float>(patchLatency / getPdRateFactor());
 
+    // The base latency covers the FIFO for one tick, larger blocks wait for the rest
+    hostPatchLatency += static_cast<float>((Instance::getBlockSize() - libpd_blocksize()) / getPdRateFactor());
 
+    auto latency = baseLatency + roundToInt(filterLatency + hostPatchLatency);
+    if (latency != getLatencySamples())
+        setLatencySamples(latency);
+}
 
-void PlugDataAudioProcessor::processBlock(AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
+void PlugDataAudioProcessor::changeOversampling(int amount, Oversampler::Engine engine, int rate)
 {
-    ScopedNoDenormals noDenormals;
-    auto totalNumInputChannels = getTotalNumInputChannels();
-    auto totalNumOutputChannels = getTotalNumOutputChannels();
-
-    continuityChecker.setNonRealtime(isNonRealtime());
-    continuityChecker.setTimer();
+    if (amount == oversampling && engine == oversamplingEngine && rate == internalRate) return;
     
-    setThis();
-
-    for (int i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
+    auto blockSize = AudioProcessor::getBlockSize();
+    auto sampleRate = AudioProcessor::getSampleRate();
+    
+    // Not prepared yet, prepareToPlay will pick it up
+    if (sampleRate <= 0.0 || blockSize <= 0)
     {
-        buffer.clear(i, 0, buffer.getNumSamples());
+        oversampling = amount;
+        oversamplingEngine = engine;
+        internalRate = rate;
+        return;
     }
-
-    midiBufferCopy.clear();
-    midiBufferCopy.addEvents(midiMessages, 0, buffer.getNumSamples(), audioAdvancement);
-
-    auto targetBlock = dsp::AudioBlock<float>(buffer);
-    auto blockOut = oversampling > 0 ? oversampler->processSamplesUp(targetBlock) : targetBlock;
     
-    process(blockOut, midiMessages);
-        
-    if(oversampling > 0) {
-        oversampler->processSamplesDown(targetBlock);
+    auto const newUndersampling = getUndersampling(amount, rate, sampleRate);
+    
+    // A different internal rate that still divides the host's rate the same way changes nothing
+    if (amount == oversampling && engine == oversamplingEngine && newUndersampling == undersampling)
+    {
+        internalRate = rate;
+        return;
     }
-
-    buffer.applyGain(getParameters()[0]->getValue());
-    statusbarSource.processBlock(buffer, midiBufferCopy, midiMessages, totalNumOutputChannels);
+    
+    // Design the new filters before the audio thread has to wait for anything
+    auto newOversampler = createOversampler(amount, engine, blockSize);
+    auto newUndersampler = createUndersampler(newUndersampling, blockSize);
+    
+    // Let the audio thread fade out, so restarting pd at the new rate can't be heard
+    // If the host stops calling us in the meantime, we just go ahead after a few blocks
+    if (!isSuspended() && !isNonRealtime())
+    {
+        reconfigureFade = ReconfigureFade::FadeOut;
+        
+        auto const timeout = Time::getMillisecondCounter() + static_cast<uint32>(jmax(20.0, 4000.0 * blockSize / sampleRate));
+        while (reconfigureFade == ReconfigureFade::FadeOut && Time::getMillisecondCounter() < timeout)
+        {
+            Thread::sleep(1);
+        }
+    }
+    
+    {
+        const pd::CallbackLock::ScopedLockType lock(*getCallbackLock());
+        
+        oversampler.swap(newOversampler);
+        undersampler.swap(newUndersampler);
+        undersampledMidi.clear();
+        
+        // Only a different engine doesn't require restarting pd
+        if (amount != oversampling || newUndersampling != undersampling)
+        {
+            oversampling = amount;
+            undersampling = newUndersampling;
+            prepareSampleRate(sampleRate, blockSize);
+        }
+        oversamplingEngine = engine;
+        internalRate = rate;
+        
+        if (reconfigureFade != ReconfigureFade::None)
+        {
+            reconfigureFade = ReconfigureFade::FadeIn;
+        }
+    }
+    
+    // newOversampler and newUndersampler now hold the previous filters, which are freed outside of the lock
+    
+    updateLatency();
+}
+
+std::unique_ptr<Oversampler> PlugDataAudioProcessor::createOversampler(int amount, Oversampler::Engine engine, int samplesPerBlock) const
+{
+    auto numChannels = std::max(getTotalNumInputChannels(), getTotalNumOutputChannels());
+    
+    auto newOversampler = Oversampler::create(engine, numChannels, amount);
+    newOversampler->initProcessing(samplesPerBlock);
+    
+    return newOversampler;
+}
+
+// Without oversampling, the host's rate is halved for as long as pd stays at or above the internal rate
+// Stops at 8 times slower, like oversampling stops at 8 times faster
+int PlugDataAudioProcessor::getUndersampling(int oversamplingAmount, int rate, double sampleRate)
+{
+    if (oversamplingAmount > 0 || rate <= 0)
+        return 0;
+    
+    int amount = 0;
+    while (amount < 3 && sampleRate / static_cast<double>(2 << amount) >= rate)
+        amount++;
+    
+    return amount;
+}
+
+std::unique_ptr<Undersampler> PlugDataAudioProcessor::createUndersampler(int amount, int samplesPerBlock) const
+{
+    if (amount <= 0)
+        return nullptr;
+    
+    auto numChannels = std::max(getTotalNumInputChannels(), getTotalNumOutputChannels());
+    
+    auto newUndersampler = Undersampler::create(numChannels, amount);
+    newUndersampler->initProcessing(static_cast<size_t>(samplesPerBlock));
+    
+    return newUndersampler;
+}
+
+double PlugDataAudioProcessor::getPdRateFactor() const
+{
+    return static_cast<double>(1 << oversampling) / static_cast<double>(1 << undersampling);
+}
+
+void PlugDataAudioProcessor::prepareSampleRate(double sampleRate, int samplesPerBlock)
+{
+    auto const factor = getPdRateFactor();
+    auto const pdBlockSize = static_cast<int>(std::ceil(samplesPerBlock * factor));
+    auto const& routing = *channelRouting.load();
+    
+    prepareDSP(routing.numInputs, routing.numOutputs, sampleRate * factor, pdBlockSize);
+    
+    for (auto* layer : layers)
+    {
+        layer->prepare(routing.numInputs, routing.numOutputs, sampleRate * factor, pdBlockSize);
+    }
+    
+    startDSP();
+}
+
+void PlugDataAudioProcessor::applyReconfigureFade(AudioBuffer<float>& buffer)
+{
+    const int numSamples = buffer.getNumSamples();
+    auto state = reconfigureFade.load();
+    
+    switch (state)
+    {
+        case ReconfigureFade::None:
+            break;
+        case ReconfigureFade::FadeOut:
+            buffer.applyGainRamp(0, numSamples, 1.0f, 0.0f);
+            reconfigureFade.compare_exchange_strong(state, ReconfigureFade::Muted);
+            break;
+        case ReconfigureFade::Muted:
+            buffer.clear();
+            break;
+        case ReconfigureFade::FadeIn:
+            buffer.applyGainRamp(0, numSamples, 0.0f, 1.0f);
+            reconfigureFade.compare_exchange_strong(state, ReconfigureFade::None);
+            break;
+    }
+}
+
+void PlugDataAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
+{
+    oversampler = createOversampler(oversampling, oversamplingEngine, samplesPerBlock);
+    undersampling = getUndersampling(oversampling, internalRate, sampleRate);
+    undersampler = createUndersampler(undersampling, samplesPerBlock);
+    undersampledMidi.clear();
+    undersampledMidi.ensureSize(2048);
+    updateLatency();
+    reconfigureFade = ReconfigureFade::None;
+    
+    updateChannelRouting();
+    auto const& routing = *channelRouting.load();
+
+    audioAdvancement = 0;
+    const auto blksize = static_cast<size_t>(Instance::getBlockSize());
+    const auto numIn = static_cast<size_t>(std::max(routing.numInputs, 2));
+    const auto nouts = static_cast<size_t>(std::max(routing.numOutputs, 2));
+    audioBufferIn.resize(numIn * blksize);
+    audioBufferOut.resize(nouts * blksize);
+    std::fill(audioBufferOut.begin(), audioBufferOut.end(), 0.f);
+    std::fill(audioBufferIn.begin(), audioBufferIn.end(), 0.f);
+    layerInput.assign(audioBufferIn.size(), 0.f);
+    layerOutput.assign(audioBufferOut.size(), 0.f);
+
+    midiBufferIn.clear();
+    midiOutputBus.clear();
+    midiBufferTemp.clear();
+
+    midiInputBus.clear();
+    for (auto* port : midiInputPorts)
+        port->reset();
+
+    prepareSampleRate(sampleRate, samplesPerBlock);
+
+    statusbarSource.prepareToPlay(getTotalNumOutputChannels());
+}
+
+#if JUCE_VERSION >= 0x070006
+void PlugDataAudioProcessor::audioWorkgroupContextChanged(AudioWorkgroup const& workgroup)
+{
+    workerPool->setWorkgroup(workgroup);
+}
+#endif
+
+void PlugDataAudioProcessor::releaseResources()
+{
+    releaseDSP();
+
+    for (auto* layer : layers)
+    {
+        layer->releaseDSP();
+    }
+}
+
+void PlugDataAudioProcessor::setNonRealtime(bool isNonRealtime) noexcept
+{
+    AudioProcessor::setNonRealtime(isNonRealtime);
+    setRenderingOffline(isNonRealtime);
+}
+
+void PlugDataAudioProcessor::processorLayoutsChanged()
+{
+    updateChannelRouting();
+}
+
+void PlugDataAudioProcessor::updateChannelRouting()
+{
+    auto& routing = channelRouting.load() == &channelRoutings[0] ? channelRoutings[1] : channelRoutings[0];
+
+    auto build = [this](bool isInput, std::array<int, maxChannels>& map) {
+        map.fill(-1);
+
+        int numChannels = 0;
+        for (int index = 0; index < getBusCount(isInput); index++)
+        {
+            auto* bus = getBus(isInput, index);
+            if (!bus->isEnabled())
+                continue;
+
+            for (int ch = 0; ch < std::min(bus->getNumberOfChannels(), 2); ch++)
+            {
+                auto const pdChannel = 2 * index + ch;
+                map[pdChannel] = bus->getChannelIndexInProcessBlockBuffer(ch);
+                numChannels = std::max(numChannels, pdChannel + 1);
+            }
+        }
+        return numChannels;
+    };
+
+    routing.numInputs = build(true, routing.inputs);
+    routing.numOutputs = build(false, routing.outputs);
+    routing.numHostInputs = getTotalNumInputChannels();
+    routing.numHostOutputs = getTotalNumOutputChannels();
+
+    channelRouting.store(&routing);
+}
+
+bool PlugDataAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
+{
+#if JucePlugin_IsMidiEffect
+    ignoreUnused(layouts);
+    return true;
+#endif
+
+    int ninch = 0;
+    int noutch = 0;
+    for (int bus = 0; bus < layouts.outputBuses.size(); bus++)
+    {
+        int nchb = layouts.getNumChannels(false, bus);
+
+        if (layouts.outputBuses[bus].isDisabled()) continue;
+
+        if (nchb > 2) return false;
+        if (nchb == 0) return false;
+        noutch += nchb;
+    }
+
+    for (int bus = 0; bus < layouts.inputBuses.size(); bus++)
+    {
+        int nchb = layouts.getNumChannels(true, bus);
+
+        if (layouts.inputBuses[bus].isDisabled()) continue;
+
+        if (nchb > 2) return false;
+        if (nchb == 0) return false;
+        ninch += nchb;
+    }
+
+    return ninch <= 32 && noutch <= 32;
+}
+
+
+
+void PlugDataAudioProcessor::processBlock(AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
+{
+    ScopedNoDenormals noDenormals;
+    auto const blockStart = Time::getHighResolutionTicks();
+
+    Trace::setThreadName("Audio");
+    TRACE_ZONE("processBlock");
+    RealtimeCheck::ScopedAudioCallback realtimeCheck(isNonRealtime());
+
+    auto totalNumInputChannels = getTotalNumInputChannels();
+    auto totalNumOutputChannels = getTotalNumOutputChannels();
+
+    pd::ContinuityChecker::ScopedAudioCallback audioCallback(continuityChecker, isNonRealtime());
+    
+    // While the host renders offline, nothing is prepared for the editor
+    bool const offline = isNonRealtime();
+
+    setThis();
+    playheadPublisher.beginBlock();
+
+    for (int i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
+    {
+        buffer.clear(i, 0, buffer.getNumSamples());
+    }
+
+    // Port 0 goes along with the host's midi, so it gets the same timing
+    for (int port = 0; port < midiInputPorts.size(); port++)
+    {
+        midiInputPorts.getUnchecked(port)->removeNextBlockOfMessages(port == 0 ? midiMessages : midiInputBus[port], buffer.getNumSamples(), getSampleRate());
+    }
+
+    // A program change from the host's midi chooses one of the programs, pd gets it as well
+    if (numPrograms > 0)
+    {
+        for (auto const metadata : midiMessages)
+        {
+            if (metadata.numBytes >= 2 && (metadata.data[0] & 0xf0) == 0xc0 && metadata.data[1] < numPrograms && programs[metadata.data[1]])
+            {
+                currentProgram = metadata.data[1];
+                pendingProgram = metadata.data[1];
+            }
+        }
+    }
+
+    switchProgram();
+
+    // Only the statusbar looks at the input after pd consumed it
+    midiBufferCopy.clear();
+    if (!offline)
+    {
+        midiBufferCopy.addEvents(midiMessages, 0, buffer.getNumSamples(), audioAdvancement);
+    }
+
+    // Automation is ramped over the block, to arrive when the next value can come in
+    parameterRampTime = static_cast<float>(buffer.getNumSamples() * 1000.0 / getSampleRate());
+
+    // The layers have schedulers of their own, they would stop while this instance sleeps,
+    // and a compiled patch makes sound whatever pd's chain does
+    bool const canSleep = autoSleep && layers.isEmpty() && !getCompiledPatch();
+
+    // Checked before pd writes to the buffer
+    bool const hasInput = canSleep && (sleepWakeRequested.exchange(false) || !midiMessages.isEmpty() || !midiInputBus.isEmpty() || !isSilent(buffer, totalNumInputChannels, silenceThreshold));
+
+    if (asleep && (hasInput || !canSleep))
+    {
+        wakeUp();
+    }
+
+    if (asleep)
+    {
+        buffer.clear();
+        if (!processAsleep(buffer.getNumSamples(), midiMessages))
+        {
+            wakeUp();
+        }
+    }
+    else
+    {
+        auto targetBlock = dsp::AudioBlock<float>(buffer);
+        
+        if (undersampling > 0)
+        {
+            processUndersampled(targetBlock, midiMessages);
+        }
+        else
+        {
+            auto blockOut = oversampling > 0 ? oversampler->processSamplesUp(targetBlock) : targetBlock;
+
+            process(blockOut, midiMessages);
+
+            if(oversampling > 0) {
+                oversampler->processSamplesDown(targetBlock);
+            }
+        }
+
+        if (canSleep)
+        {
+            updateSleepState(buffer, hasInput);
+        }
+    }
+
+    // Objects are only read while the editor knows about every structural change,
+    // otherwise an object could have been deleted before its component
+    if (!offline && !isHeadless() && isGuiInSync())
+    {
+        const SpinLock::ScopedTryLockType lock(audioThreadObjectsLock);
+        if (lock.isLocked())
+        {
+            for (auto* object : audioThreadObjects) object->updateFromAudioThread();
+        }
+    }
+
+    applyReconfigureFade(buffer);
+
+    buffer.applyGain(getParameters()[0]->getValue());
+
+    sendMidiOutputPorts(midiMessages);
+
+    // Offline renders can take as long as they want
+    if (!offline)
+    {
+        statusbarSource.processBlock(buffer, midiBufferCopy, midiMessages, totalNumOutputChannels);
+
+        auto const elapsed = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - blockStart);
+        audioStats.record(elapsed, buffer.getNumSamples() / getSampleRate());
+    }
+}
+
+// The midi's positions are divided the same way as the audio, and multiplied again for what pd sends out
+void PlugDataAudioProcessor::processUndersampled(dsp::AudioBlock<float>& block, MidiBuffer& midiMessages)
+{
+    auto blockIn = undersampler->processSamplesDown(block);
+    auto const numSamples = static_cast<int>(blockIn.getNumSamples());
+
+    for (auto const metadata : midiMessages)
+    {
+        undersampledMidi.addEvent(metadata.getMessage(), jmin(metadata.samplePosition >> undersampling, jmax(0, numSamples - 1)));
+    }
+    midiMessages.clear();
+
+    if (numSamples > 0)
+    {
+        process(blockIn, undersampledMidi);
+
+        for (auto const metadata : undersampledMidi)
+        {
+            midiMessages.addEvent(metadata.getMessage(), metadata.samplePosition << undersampling);
+        }
+        undersampledMidi.clear();
+    }
+
+    undersampler->processSamplesUp(block);
+}
+
+void PlugDataAudioProcessor::updateSleepState(AudioBuffer<float> const& buffer, bool hasInput)
+{
+    if (hasInput || !isSilent(buffer, getTotalNumOutputChannels(), silenceThreshold))
+    {
+        silentSamples = 0;
+        return;
+    }
+
+    silentSamples += buffer.getNumSamples();
+
+    // pd's output lags up to a tick behind the buffer
+    auto const tailSamples = static_cast<int64>(tailLengthSeconds.load() * getSampleRate()) + (2 * Instance::getBlockSize() << undersampling);
+    if (silentSamples > tailSamples)
+    {
+        asleep = true;
+        sleepAdvancement = 0;
+    }
+}
+
+// Runs pd's ticks without DSP for a block of the host
+// Returns false when pd did something that could make a sound, like a clock that went off
+bool PlugDataAudioProcessor::processAsleep(int numSamples, MidiBuffer& midiMessages)
+{
+    auto const blockSize = Instance::getBlockSize();
+    bool idle = true;
+
+    // A tick takes longer at the host's rate when pd runs slower than the host
+    auto const tickLength = blockSize << undersampling;
+
+    midiMessages.clear();
+    sleepAdvancement += numSamples << oversampling;
+
+    for (int pos = 0; sleepAdvancement >= tickLength; pos += tickLength)
+    {
+        sleepAdvancement -= tickLength;
+
+        prepareTick();
+        for (int tick = 0; tick < getTicksPerBlock(); tick++)
+        {
+            if (libpd_process_nodsp() > 0)
+            {
+                idle = false;
+            }
+        }
+
+        if (!midiBufferOut.isEmpty())
+        {
+            midiMessages.addEvents(midiBufferOut, 0, blockSize, pos);
+            idle = false;
+        }
+    }
+
+    return idle;
+}
+
+void PlugDataAudioProcessor::wakeUp()
+{
+    asleep = false;
+    silentSamples = 0;
+
+    // The FIFO starts over, what's in it is from before pd went to sleep
+    audioAdvancement = 0;
+    std::fill(audioBufferIn.begin(), audioBufferIn.end(), 0.f);
+    std::fill(audioBufferOut.begin(), audioBufferOut.end(), 0.f);
 }
 
 void PlugDataAudioProcessor::process(dsp::AudioBlock<float> buffer, MidiBuffer& midiMessages)
@@ -538,41 +1259,117 @@ void PlugDataAudioProcessor::process(dsp::AudioBlock<float> buffer, MidiBuffer&
     ScopedNoDenormals noDenormals;
     const int blockSize = Instance::getBlockSize();
     const int numSamples = static_cast<int>(buffer.getNumSamples());
-    const int adv = audioAdvancement >= 64 ? 0 : audioAdvancement;
+    const int adv = audioAdvancement >= blockSize ? 0 : audioAdvancement;
     const int numLeft = blockSize - adv;
-    const int numIn = getTotalNumInputChannels();
-    const int numOut = getTotalNumOutputChannels();
+    auto const& routing = *channelRouting.load();
+    const int numIn = routing.numInputs;
+    const int numOut = routing.numOutputs;
 
-    channelPointers.clear();
-    for(int ch = 0; ch < std::max(numIn, numOut); ch++) {
-        channelPointers.push_back(buffer.getChannelPointer(ch));
+    // The host's channels can move between blocks
+    for (int ch = 0; ch < numIn; ch++)
+    {
+        inputPointers[ch] = routing.inputs[ch] >= 0 ? buffer.getChannelPointer(routing.inputs[ch]) : nullptr;
+    }
+    for (int ch = 0; ch < numOut; ch++)
+    {
+        outputPointers[ch] = routing.outputs[ch] >= 0 ? buffer.getChannelPointer(routing.outputs[ch]) : nullptr;
     }
 
     const bool midiConsume = acceptsMidi();
     const bool midiProduce = producesMidi();
 
-    auto const maxOuts = std::max(numOut, std::max(numIn, numOut));
-    for (int ch = numIn; ch < maxOuts; ch++)
+    for (int ch = routing.numHostInputs; ch < routing.numHostOutputs; ch++)
     {
         buffer.getSingleChannelBlock(ch).clear();
     }
 
+    // Through the FIFO, pd's channels of inactive buses are silent and aren't written anywhere
+    auto readInputs = [&](int fifoOffset, int channelOffset, int count) {
+        for (int ch = 0; ch < numIn; ++ch)
+        {
+            auto* fifo = audioBufferIn.data() + ch * blockSize + fifoOffset;
+            if (inputPointers[ch])
+                FloatVectorOperations::copy(fifo, inputPointers[ch] + channelOffset, count);
+            else
+                FloatVectorOperations::clear(fifo, count);
+        }
+    };
+    auto writeOutputs = [&](int fifoOffset, int channelOffset, int count) {
+        for (int ch = 0; ch < numOut; ++ch)
+        {
+            if (outputPointers[ch])
+                FloatVectorOperations::copy(outputPointers[ch] + channelOffset, audioBufferOut.data() + ch * blockSize + fifoOffset, count);
+        }
+    };
+
+    // If the block is aligned to pd's block size, we let pd
+    // read and write the channels directly, without copying
+    // through the FIFO. The output keeps the same one-tick delay.
+    // Only for single ticks, the output pd keeps for the next block is one tick long
+    // A compiled patch only processes pd's own buffers
+    if (audioAdvancement == 0 && numSamples > 0 && numSamples % blockSize == 0 && getTicksPerBlock() == 1 && !getCompiledPatch())
+    {
+        // In low latency mode the tick's output is written straight away instead,
+        // the layers always run a tick late so they need the delay
+        bool const direct = lowLatency && layers.isEmpty();
+
+        MidiBuffer const& midiin = midiProduce ? midiBufferTemp : midiMessages;
+        if (midiProduce)
+        {
+            midiBufferTemp.swapWith(midiMessages);
+            midiMessages.clear();
+        }
+
+        // Move the output of the previous tick into pd
+        if (!direct)
+            setPendingOutput(audioBufferOut.data());
+
+        for (int pos = 0; pos < numSamples; pos += blockSize)
+        {
+            if (midiConsume)
+            {
+                midiBufferIn.addEvents(midiin, pos, blockSize, -pos);
+            }
+            if (midiProduce && !direct)
+            {
+                midiMessages.addEvents(midiBufferOut, 0, blockSize, pos);
+            }
+            processInternal(pos, direct);
+
+            // Without the tick of delay, the midi goes out with the audio of the same tick
+            if (midiProduce && direct)
+            {
+                midiMessages.addEvents(midiBufferOut, 0, blockSize, pos);
+            }
+        }
+
+        // Nothing is pending, the other paths shouldn't output a stale tick when the block size changes
+        if (direct)
+        {
+            FloatVectorOperations::clear(audioBufferOut.data(), static_cast<int>(audioBufferOut.size()));
+            return;
+        }
+
+        // Keep the output of the last tick for the next block
+        getPendingOutput(audioBufferOut.data());
+
+        // The layers' last tick is still waiting as well
+        if (!layers.isEmpty())
+        {
+            FloatVectorOperations::add(audioBufferOut.data(), layerOutput.data(), static_cast<int>(layerOutput.size()));
+            FloatVectorOperations::clear(layerOutput.data(), static_cast<int>(layerOutput.size()));
+        }
+        return;
+    }
+
     // If the current number of samples in this block
     // is inferior to the number of samples required
     if (numSamples < numLeft)
     {
         // we save the input samples and we output
         // the missing samples of the previous tick.
-        for (int j = 0; j < numIn; ++j)
-        {
-            const int index = j * blockSize + adv;
-            FloatVectorOperations::copy(audioBufferIn.data() + index, channelPointers[j], numSamples);
-        }
-        for (int j = 0; j < numOut; ++j)
-        {
-            const int index = j * blockSize + adv;
-            FloatVectorOperations::copy(channelPointers[j], audioBufferOut.data() + index, numSamples);
-        }
+        readInputs(adv, 0, numSamples);
+        writeOutputs(adv, 0, numSamples);
         if (midiConsume)
         {
             midiBufferIn.addEvents(midiMessages, 0, numSamples, adv);
@@ -598,16 +1395,8 @@ void PlugDataAudioProcessor::process(dsp::AudioBlock<float> buffer, MidiBuffer&
             midiMessages.clear();
         }
 
-        for (int j = 0; j < numIn; ++j)
-        {
-            const int index = j * blockSize + adv;
-            FloatVectorOperations::copy(audioBufferIn.data() + index, channelPointers[j], numLeft);
-        }
-        for (int j = 0; j < numOut; ++j)
-        {
-            const int index = j * blockSize + adv;
-            FloatVectorOperations::copy(channelPointers[j], audioBufferOut.data() + index, numLeft);
-        }
+        readInputs(adv, 0, numLeft);
+        writeOutputs(adv, 0, numLeft);
         if (midiConsume)
         {
             midiBufferIn.addEvents(midiin, 0, numLeft, adv);
@@ -624,19 +1413,11 @@ void PlugDataAudioProcessor::process(dsp::AudioBlock<float> buffer, MidiBuffer&
         int pos = numLeft;
         while ((pos + blockSize) <= numSamples)
         {
-            for (int j = 0; j < numIn; ++j)
-            {
-                const int index = j * blockSize;
-                FloatVectorOperations::copy(audioBufferIn.data() + index, channelPointers[j] + pos, blockSize);
-            }
-            for (int j = 0; j < numOut; ++j)
-            {
-                const int index = j * blockSize;
-                FloatVectorOperations::copy(channelPointers[j] + pos, audioBufferOut.data() + index, blockSize);
-            }
+            readInputs(0, pos, blockSize);
+            writeOutputs(0, pos, blockSize);
             if (midiConsume)
             {
-                midiBufferIn.addEvents(midiin, pos, blockSize, 0);
+                midiBufferIn.addEvents(midiin, pos, blockSize, -pos);
             }
             if (midiProduce)
             {
@@ -652,19 +1433,11 @@ void PlugDataAudioProcessor::process(dsp::AudioBlock<float> buffer, MidiBuffer&
         const int remaining = numSamples - pos;
         if (remaining > 0)
         {
-            for (int j = 0; j < numIn; ++j)
-            {
-                const int index = j * blockSize;
-                FloatVectorOperations::copy(audioBufferIn.data() + index, channelPointers[j] + pos, remaining);
-            }
-            for (int j = 0; j < numOut; ++j)
-            {
-                const int index = j * blockSize;
-                FloatVectorOperations::copy(channelPointers[j] + pos, audioBufferOut.data() + index, remaining);
-            }
+            readInputs(0, pos, remaining);
+            writeOutputs(0, pos, remaining);
             if (midiConsume)
             {
-                midiBufferIn.addEvents(midiin, pos, remaining, 0);
+                midiBufferIn.addEvents(midiin, pos, remaining, -pos);
             }
             if (midiProduce)
             {
@@ -677,100 +1450,38 @@ void PlugDataAudioProcessor::process(dsp::AudioBlock<float> buffer, MidiBuffer&
 
 void PlugDataAudioProcessor::sendPlayhead()
 {
-    AudioPlayHead* playhead = getPlayHead();
-    if(!playhead) return;
-    
-    auto infos = playhead->getPosition();
-    
-    setThis();
-    if (infos.hasValue())
-    {
-        atoms_playhead[0] = static_cast<float>(infos->getIsPlaying());
-        sendMessage("playhead", "playing", atoms_playhead);
-        
-        atoms_playhead[0] = static_cast<float>(infos->getIsRecording());
-        sendMessage("playhead", "recording", atoms_playhead);
-
-        atoms_playhead[0] = static_cast<float>(infos->getIsLooping());
-        
-        auto loopPoints = infos->getLoopPoints();
-        if(loopPoints.hasValue()) {
-            atoms_playhead.push_back(static_cast<float>(loopPoints->ppqStart));
-            atoms_playhead.push_back(static_cast<float>(loopPoints->ppqEnd));
-        }
-        else {
-            atoms_playhead.push_back(0.0f);
-            atoms_playhead.push_back(0.0f);
-        }
-        sendMessage("playhead", "looping", atoms_playhead);
-        
-        if(infos->getEditOriginTime().hasValue()) {
-            atoms_playhead.resize(1);
-            atoms_playhead[0] = static_cast<float>(*infos->getEditOriginTime());
-            sendMessage("playhead", "edittime", atoms_playhead);
-        }
-
-        if(infos->getFrameRate().hasValue()) {
-            atoms_playhead[0] = static_cast<float>(infos->getFrameRate()->getEffectiveRate());
-            sendMessage("playhead", "framerate", atoms_playhead);
-        }
-
-       
-        if(infos->getBpm().hasValue()) {
-            atoms_playhead[0] = static_cast<float>(*infos->getBpm());
-            sendMessage("playhead", "bpm", atoms_playhead);
-        }
-        
-        if(infos->getPpqPositionOfLastBarStart().hasValue()) {
-            atoms_playhead[0] = static_cast<float>(*infos->getPpqPositionOfLastBarStart());
-            sendMessage("playhead", "lastbar", atoms_playhead);
-        }
-        
-        if(infos->getTimeSignature().hasValue()) {
-            atoms_playhead[0] = static_cast<float>(infos->getTimeSignature()->numerator);
-            atoms_playhead.push_back(static_cast<float>(infos->getTimeSignature()->denominator));
-            sendMessage("playhead", "timesig", atoms_playhead);
-        }
+    playheadPublisher.publish(getPlayHead());
+}
 
-        if(infos->getPpqPosition().hasValue()) {
-            
-            atoms_playhead[0] = static_cast<float>(*infos->getPpqPosition());
-        }
-        else {
-            atoms_playhead[0] = 0.0f;
-        }
-        
-        if(infos->getTimeInSamples().hasValue()) {
-            atoms_playhead[1] = static_cast<float>(*infos->getTimeInSamples());
-        }
-        else {
-            atoms_playhead[1] = 0.0f;
-        }
-        
-        if(infos->getTimeInSeconds().hasValue()) {
-            atoms_playhead.push_back(static_cast<float>(*infos->getTimeInSeconds()));
-        }
-        else {
-            atoms_playhead.push_back(0.0f);
-        }
-        
-        sendMessage("playhead", "position", atoms_playhead);
-        atoms_playhead.resize(1);
-    }
+void PlugDataAudioProcessor::setPlayheadRate(int rate)
+{
+    playheadPublisher.setRate(static_cast<pd::PlayheadPublisher::Rate>(std::clamp(rate, 0, 2)));
+    settingsTree.setProperty("PlayheadRate", var(rate), nullptr);
 }
 
 void PlugDataAudioProcessor::messageEnqueued()
 {
+    sleepWakeRequested = true;
+
+    // If the backup scheduler owns pd, it dequeues the messages on its next tick
     if (isNonRealtime() || isSuspended())
     {
-        sendMessagesFromQueue();
+        if (continuityChecker.tryAcquire(pd::ContinuityChecker::Message))
+        {
+            sendMessagesFromQueue();
+            continuityChecker.release();
+        }
     }
     else
     {
-        const CriticalSection* cs = getCallbackLock();
+        auto const* cs = getCallbackLock();
         if (cs->tryEnter())
         {
-            sendMessagesFromQueue();
+            if (continuityChecker.tryAcquire(pd::ContinuityChecker::Message))
+            {
+                sendMessagesFromQueue();
+                continuityChecker.release();
+            }
             cs->exit();
         }
     }
@@ -780,84 +1491,228 @@ void PlugDataAudioProcessor::sendMidiBuffer()
 {
     if (acceptsMidi())
     {
-        for (const auto& event : midiBufferIn)
+        if (sampleAccurateMidi)
         {
-            auto const message = event.getMessage();
-            if (message.isNoteOn())
-            {
-                sendNoteOn(message.getChannel(), message.getNoteNumber(), message.getVelocity());
-            }
-            else if (message.isNoteOff())
-            {
-                sendNoteOn(message.getChannel(), message.getNoteNumber(), 0);
-            }
-            else if (message.isController())
-            {
-                sendControlChange(message.getChannel(), message.getControllerNumber(), message.getControllerValue());
-            }
-            else if (message.isPitchWheel())
-            {
-                sendPitchBend(message.getChannel(), message.getPitchWheelValue() - 8192);
-            }
-            else if (message.isChannelPressure())
-            {
-                sendAfterTouch(message.getChannel(), message.getChannelPressureValue());
-            }
-            else if (message.isAftertouch())
-            {
-                sendPolyAfterTouch(message.getChannel(), message.getNoteNumber(), message.getAfterTouchValue());
-            }
-            else if (message.isProgramChange())
-            {
-                sendProgramChange(message.getChannel(), message.getProgramChangeNumber());
-            }
-            else if (message.isSysEx())
-            {
-                for (int i = 0; i < message.getSysExDataSize(); ++i)
-                {
-                    sendSysEx(0, static_cast<int>(message.getSysExData()[i]));
-                }
-            }
-            else if (message.isMidiClock() || message.isMidiStart() || message.isMidiStop() || message.isMidiContinue() || message.isActiveSense() || (message.getRawDataSize() == 1 && message.getRawData()[0] == 0xff))
-            {
-                for (int i = 0; i < message.getRawDataSize(); ++i)
-                {
-                    sendSysRealTime(0, static_cast<int>(message.getRawData()[i]));
-                }
-            }
+            scheduleMidiBuffer();
+            return;
+        }
 
-            for (int i = 0; i < message.getRawDataSize(); i++)
-            {
-                sendMidiByte(0, static_cast<int>(message.getRawData()[i]));
-            }
+        // Events that were scheduled before switching modes
+        if (nextScheduledMidi != midiBufferScheduled.end())
+        {
+            sys_lock();
+            dispatchScheduledMidi(std::numeric_limits<int>::max());
+            sys_unlock();
         }
+
+        sendMidiEvents(midiBufferIn);
         midiBufferIn.clear();
     }
+
+    // The other ports arrive in one batch per port at the start of the block
+    sendMidiEvents(midiInputBus);
+    midiInputBus.clear();
+}
+
+MidiInputCallback* PlugDataAudioProcessor::getMidiInputPort(int port)
+{
+    return midiInputPorts[jlimit(0, midiInputPorts.size() - 1, port)];
+}
+
+void PlugDataAudioProcessor::setMidiOutputPort(int port, MidiOutput* output)
+{
+    const pd::CallbackLock::ScopedLockType lock(*getCallbackLock());
+    midiOutputPorts[jlimit(1, pd::MidiBus::maxPorts - 1, port)] = output;
+}
+
+// Ports without a device of their own are sent with port 0, like a plugin does
+void PlugDataAudioProcessor::sendMidiOutputPorts(MidiBuffer& midiMessages)
+{
+    for (int port = 1; port < midiOutputBus.getNumPorts(); port++)
+    {
+        auto& events = midiOutputBus[port];
+        if (events.isEmpty())
+            continue;
+
+        if (auto* output = midiOutputPorts[port])
+            output->sendBlockOfMessagesNow(events);
+        else
+            midiMessages.addEvents(events, 0, -1, 0);
+
+        midiOutputBus.clear(port);
+    }
 }
 
-void PlugDataAudioProcessor::processInternal()
+void PlugDataAudioProcessor::setSampleAccurateMidi(bool enabled)
 {
-    setThis();
+    sampleAccurateMidi = enabled;
+    settingsTree.setProperty("SampleAccurateMidi", var(enabled), nullptr);
+}
+
+void PlugDataAudioProcessor::setLowLatency(bool enabled)
+{
+    lowLatency = enabled;
+    settingsTree.setProperty("LowLatency", var(enabled), nullptr);
+}
+
+void PlugDataAudioProcessor::setAutoSleep(bool enabled)
+{
+    autoSleep = enabled;
+    settingsTree.setProperty("AutoSleep", var(enabled), nullptr);
+}
+
+void PlugDataAudioProcessor::setTailLength(float seconds)
+{
+    tailLengthSeconds = std::max(seconds, 0.0f);
+    tailLength = var(seconds);
+}
+
+void PlugDataAudioProcessor::setNumAutomationParameters(int amount)
+{
+    settingsTree.setProperty("NumParameters", var(jlimit(0, numParameters, amount)), nullptr);
+    saveSettingsAsync();
+}
+
+// Takes this tick's events and delivers them at their own position through midiClock,
+// so messages they trigger have the matching logical time, like for [vline~]
+void PlugDataAudioProcessor::scheduleMidiBuffer()
+{
+    sys_lock();
+
+    // Anything the previous tick didn't get to is late now
+    dispatchScheduledMidi(std::numeric_limits<int>::max());
 
-    // clear midi out
-    if (producesMidi())
+    midiBufferScheduled.swapWith(midiBufferIn);
+    midiBufferIn.clear();
+    nextScheduledMidi = midiBufferScheduled.begin();
+
+    dispatchScheduledMidi(0);
+
+    sys_unlock();
+}
+
+// Sends all scheduled events up to position, then sets the clock for the next one
+void PlugDataAudioProcessor::dispatchScheduledMidi(int position)
+{
+    auto const lastSample = Instance::getBlockSize() - 1;
+
+    while (nextScheduledMidi != midiBufferScheduled.end())
     {
-        midiByteIndex = 0;
-        midiByteBuffer[0] = 0;
-        midiByteBuffer[1] = 0;
-        midiByteBuffer[2] = 0;
-        midiBufferOut.clear();
+        auto const event = *nextScheduledMidi;
+        auto const eventPosition = std::clamp(event.samplePosition, 0, lastSample);
+
+        if (eventPosition > position)
+        {
+            scheduledMidiPosition = eventPosition;
+            clock_delay(midiClock, eventPosition - position);
+            return;
+        }
+
+        libpd_dispatch_midi(0, event.data, event.numBytes);
+        ++nextScheduledMidi;
     }
 
+    clock_unset(midiClock);
+}
+
+void PlugDataAudioProcessor::prepareTick()
+{
+    setThis();
+
+    // clear midi out, the other ports are sent once per block
+    midiOutputBus.clear(0);
+    beginMidiOutput();
+
     // Dequeue messages
     sendMessagesFromQueue();
     sendPlayhead();
     sendMidiBuffer();
     sendParameters();
+    audioStats.publish();
+}
+
+void PlugDataAudioProcessor::processInternal()
+{
+    TRACE_ZONE("processInternal");
+    RealtimeCheck::ScopedAudioCallback realtimeCheck(isNonRealtime());
+    prepareTick();
 
     // Process audio
-    FloatVectorOperations::copy(audioBufferIn.data() + (2 * 64), audioBufferOut.data() + (2 * 64), (minOut - 2) * 64);
-    performDSP(audioBufferIn.data(), audioBufferOut.data());
+    if (layers.isEmpty())
+    {
+        performDSP(audioBufferIn.data(), audioBufferOut.data());
+        return;
+    }
+
+    processWithLayers(audioBufferIn.data(), [this]() { performDSP(audioBufferIn.data(), audioBufferOut.data()); });
+    mixLayers(audioBufferOut.data());
+}
+
+void PlugDataAudioProcessor::processInternal(int offset, bool direct)
+{
+    TRACE_ZONE("processInternal");
+    RealtimeCheck::ScopedAudioCallback realtimeCheck(isNonRealtime());
+    prepareTick();
+
+    // Process audio straight from the host's channels
+    auto const& routing = *channelRouting.load();
+    auto const numIn = routing.numInputs;
+    auto const numOut = routing.numOutputs;
+
+    if (layers.isEmpty())
+    {
+        performDSP(inputPointers.data(), numIn, outputPointers.data(), numOut, offset, direct);
+        return;
+    }
+
+    // pd writes to the channels while the layers are running, so they need a copy of the input
+    auto const blockSize = Instance::getBlockSize();
+    for (int ch = 0; ch < numIn; ch++)
+    {
+        if (inputPointers[ch])
+            FloatVectorOperations::copy(layerInput.data() + ch * blockSize, inputPointers[ch] + offset, blockSize);
+        else
+            FloatVectorOperations::clear(layerInput.data() + ch * blockSize, blockSize);
+    }
+
+    processWithLayers(layerInput.data(), [this, numIn, numOut, offset]() {
+        performDSP(inputPointers.data(), numIn, outputPointers.data(), numOut, offset);
+    });
+
+    // pd's output is a tick late on this path, so the layers are delayed by a tick too
+    for (int ch = 0; ch < numOut; ch++)
+    {
+        if (outputPointers[ch])
+            FloatVectorOperations::add(outputPointers[ch] + offset, layerOutput.data() + ch * blockSize, blockSize);
+    }
+
+    FloatVectorOperations::clear(layerOutput.data(), static_cast<int>(layerOutput.size()));
+    mixLayers(layerOutput.data());
+}
+
+template<typename Callable>
+void PlugDataAudioProcessor::processWithLayers(float const* input, Callable&& processMain)
+{
+    // Task 0 is this instance, every layer gets a task of its own
+    // Each task only takes its own instance's sys_lock, see pd::Layer, so they don't serialise
+    auto processInstance = [this, input, &processMain](int index) {
+        if (index == 0)
+            processMain();
+        else
+            layers.getUnchecked(index - 1)->process(input);
+    };
+
+    workerPool->run(layers.size() + 1, processInstance);
+
+    setThis();
+}
+
+void PlugDataAudioProcessor::mixLayers(float* output)
+{
+    for (auto* layer : layers)
+    {
+        FloatVectorOperations::add(output, layer->getOutput(), static_cast<int>(audioBufferOut.size()));
+    }
 }
 
 bool PlugDataAudioProcessor::hasEditor() const
@@ -867,54 +1722,113 @@ bool PlugDataAudioProcessor::hasEditor() const
 
 AudioProcessorEditor* PlugDataAudioProcessor::createEditor()
 {
+    setHeadless(false);
+
     auto* editor = new PlugDataPluginEditor(*this);
 
     setThis();
     
+    // Only the tab that will be shown gets its objects now, the others get them when they're first shown
+    editor->deferTabContent = true;
+
     for (auto* patch : patches)
     {
-        auto* cnv = editor->canvases.add(new Canvas(*editor, *patch, nullptr));
+        auto* cnv = editor->canvases.add(new Canvas(*editor, *patch, nullptr, false));
         editor->addTab(cnv, true);
     }
 
+    editor->deferTabContent = false;
+
     editor->resized();
     
     if(isPositiveAndBelow(lastTab, patches.size())) {
-        editor->tabbar.setCurrentTabIndex(lastTab);
+        editor->tabbar.setCurrentTabIndex(lastTab, false);
+    }
+
+    if (editor->tabbar.getCurrentTabIndex() >= 0)
+    {
+        editor->tabbar.onTabChange(editor->tabbar.getCurrentTabIndex());
     }
 
     return editor;
 }
 
+void PlugDataAudioProcessor::editorBeingDeleted(AudioProcessorEditor* editor) noexcept
+{
+    AudioProcessor::editorBeingDeleted(editor);
+    setHeadless(true);
+}
+
 void PlugDataAudioProcessor::getStateInformation(MemoryBlock& destData)
 {
-    MemoryBlock xmlBlock;
+    std::vector<MemoryBlock> contents;
+    StringArray locations;
+    ValueTree state;
 
-    suspendProcessing(true);  // These functions can be called from any thread, so suspend processing prevent threading issues
+    // These functions can be called from any thread, so take a snapshot while pd can't run
+    // Everything else happens outside the lock, so audio is only held up for the snapshot
+    {
+        const pd::CallbackLock::ScopedLockType lock(*getCallbackLock());
 
-    setThis();
-    auto state = parameters.copyState();
+        setThis();
+        state = parameters.copyState();
+
+        for (auto& patch : patches)
+        {
+            contents.push_back(patch->getCanvasBinary());
+            locations.add(patch->getCurrentFile().getFullPathName());
+        }
+    }
+
+    MemoryBlock xmlBlock;
     std::unique_ptr<XmlElement> xml(state.createXml());
     copyXmlToBinary(*xml, xmlBlock);
 
-    // Store pure-data state
     MemoryOutputStream ostream(destData, false);
 
-    ostream.writeInt(patches.size());
+    ostream.writeInt(stateMagic);
+    ostream.writeInt(stateVersion);
+    ostream.writeInt(static_cast<int>(contents.size()));
 
-    for (auto& patch : patches)
     {
-        ostream.writeString(patch->getCanvasContent());
-        ostream.writeString(patch->getCurrentFile().getFullPathName());
+        const ScopedLock lock(stateCacheLock);
+
+        // Only keep what this state uses, so the cache never grows beyond the open patches
+        std::unordered_map<int64, MemoryBlock> usedCache;
+
+        for (size_t i = 0; i < contents.size(); i++)
+        {
+            auto hash = static_cast<int64>(std::hash<std::string_view>()(std::string_view(static_cast<char const*>(contents[i].getData()), contents[i].getSize())));
+
+            auto cached = stateCache.find(hash);
+            if (cached == stateCache.end())
+            {
+                // Patches that didn't change since the last save don't have to be compressed again
+                MemoryBlock compressed;
+                {
+                    MemoryOutputStream compressedStream(compressed, false);
+                    // Fastest level, the symbol table already took out most of the repetition
+                    GZIPCompressorOutputStream zipStream(compressedStream, 1);
+                    zipStream.write(contents[i].getData(), contents[i].getSize());
+                }
+                cached = stateCache.emplace(hash, std::move(compressed)).first;
+            }
+
+            auto& compressed = usedCache.emplace(hash, cached->second).first->second;
+
+            ostream.writeString(locations[static_cast<int>(i)]);
+            ostream.writeInt(static_cast<int>(compressed.getSize()));
+            ostream.write(compressed.getData(), compressed.getSize());
+        }
+
+        stateCache = std::move(usedCache);
     }
 
-    ostream.writeInt(getLatencySamples());
+    ostream.writeInt(getBaseLatency());
     ostream.writeInt(oversampling);
     ostream.writeFloat(static_cast<float>(tailLength.getValue()));
     ostream.writeInt(static_cast<int>(xmlBlock.getSize()));
     ostream.write(xmlBlock.getData(), xmlBlock.getSize());
-
-    suspendProcessing(false);
 }
 
 void PlugDataAudioProcessor::setStateInformation(const void* data, int sizeInBytes)
@@ -945,14 +1859,50 @@ void PlugDataAudioProcessor::setStateInformation(const void* data, int sizeInByt
             for (auto& patch : patches) patch->close();
             patches.clear();
 
+            // Old states start with the number of patches and store the patches as text
             int numPatches = istream.readInt();
+            bool compressed = numPatches == stateMagic;
+            int version = 0;
+
+            if (compressed)
+            {
+                version = istream.readInt();
+                numPatches = istream.readInt();
+            }
+
+            for (int i = 0; i < numPatches; i++)
+            {
+                pd::Patch* patch;
+                File location;
+
+                if (compressed)
+                {
+                    location = File(istream.readString());
+
+                    MemoryBlock block;
+                    istream.readIntoMemoryBlock(block, istream.readInt());
+
+                    MemoryInputStream blockStream(block, false);
+                    GZIPDecompressorInputStream zipStream(blockStream);
 
-            for (int i = 0; i < numPatches; i++)
-            {
-                auto state = istream.readString();
-                auto location = File(istream.readString());
+                    if (version >= 2)
+                    {
+                        MemoryBlock content;
+                        zipStream.readIntoMemoryBlock(content);
+                        patch = loadPatch(content);
+                    }
+                    else
+                    {
+                        patch = loadPatch(zipStream.readString());
+                    }
+                }
+                else
+                {
+                    patch = loadPatch(istream.readString());
+                    location = File(istream.readString());
+                }
 
-                auto* patch = loadPatch(state);
+                if (!patch) continue;
 
                 if ((location.exists() && location.getParentDirectory() == File::getSpecialLocation(File::tempDirectory)) || !location.exists())
                 {
@@ -966,6 +1916,7 @@ void PlugDataAudioProcessor::setStateInformation(const void* data, int sizeInByt
                     auto parentPath = location.getParentDirectory().getFullPathName();
                     // Add patch path to search path to make sure it finds the externals!
                     libpd_add_to_search_path(parentPath.toRawUTF8());
+                    updateAbstractionWatcher();
                 }
             }
 
@@ -974,7 +1925,7 @@ void PlugDataAudioProcessor::setStateInformation(const void* data, int sizeInByt
             auto tail = istream.readFloat();
             auto xmlSize = istream.readInt();
 
-            tailLength = var(tail);
+            setTailLength(tail);
 
             void* xmlData = static_cast<void*>(new char[xmlSize]);
             istream.read(xmlData, xmlSize);
@@ -987,7 +1938,7 @@ void PlugDataAudioProcessor::setStateInformation(const void* data, int sizeInByt
                 }
             }
 
-            setLatencySamples(latency);
+            setBaseLatency(latency);
             setOversampling(oversampling);
             
             suspendProcessing(false);
@@ -1019,30 +1970,54 @@ pd::Patch* PlugDataAudioProcessor::loadPatch(const File& patchFile)
         i++;
     }
 
-    auto newPatch = openPatch(patchFile);
-    
+    auto* patch = addPatch(openPatch(patchFile));
+    if (!patch) return nullptr;
+
+    patch->setCurrentFile(patchFile);
+    updateAbstractionWatcher();
+
+    return patch;
+}
+
+pd::Patch* PlugDataAudioProcessor::loadPatch(MemoryBlock const& binaryContent)
+{
+    return addPatch(openPatch(binaryContent));
+}
+
+pd::Patch* PlugDataAudioProcessor::addPatch(pd::Patch const& newPatch)
+{
     if (!newPatch.getPointer())
     {
         logError("Couldn't open patch");
         return nullptr;
     }
-    
+
     auto* patch = patches.add(new pd::Patch(newPatch));
 
+    // New receivers should get the complete playhead state
+    playheadPublisher.reset();
+
     if (auto* editor = dynamic_cast<PlugDataPluginEditor*>(getActiveEditor()))
     {
-        MessageManager::callAsync([i, patch, _editor = Component::SafePointer(editor)]() mutable {
+        MessageManager::callAsync([patch, _editor = Component::SafePointer(editor)]() mutable {
             if(!_editor) return;
             auto* cnv = _editor->canvases.add(new Canvas(*_editor, *patch, nullptr));
             _editor->addTab(cnv, true);
         });
     }
 
-    patch->setCurrentFile(patchFile);
-
     return patch;
 }
 
+void PlugDataAudioProcessor::updateAbstractionWatcher()
+{
+    Array<File> files;
+    for (auto* patch : patches)
+        files.add(patch->getCurrentFile());
+
+    abstractionWatcher.setPatchFiles(files);
+}
+
 pd::Patch* PlugDataAudioProcessor::loadPatch(String patchText)
 {
     if (patchText.isEmpty()) patchText = pd::Instance::defaultPatch;
@@ -1053,7 +2028,7 @@ pd::Patch* PlugDataAudioProcessor::loadPatch(String patchText)
     auto* patch = loadPatch(patchFile);
 
     // Set to unknown file when loading temp patch
-    patch->setCurrentFile(File());
+    if (patch) patch->setCurrentFile(File());
 
     return patch;
 }
@@ -1098,139 +2073,423 @@ Colour PlugDataAudioProcessor::getTextColour()
     return lnf->findColour(PlugDataColour::toolbarTextColourId);
 }
 
-void PlugDataAudioProcessor::receiveNoteOn(const int channel, const int pitch, const int velocity)
+// Only for standalone: check which parameters have changed and forward them to pd
+void PlugDataAudioProcessor::markParameterDirty(int idx)
 {
-    if (velocity == 0)
-    {
-        midiBufferOut.addEvent(MidiMessage::noteOff(channel, pitch, uint8(0)), audioAdvancement);
-    }
-    else
+    sleepWakeRequested = true;
+    dirtyParameters[idx / 64].fetch_or(uint64(1) << (idx % 64), std::memory_order_release);
+}
+
+void PlugDataAudioProcessor::sendParameters()
+{
+    bool locked = false;
+
+    for (int word = 0; word < static_cast<int>(dirtyParameters.size()); word++)
     {
-        midiBufferOut.addEvent(MidiMessage::noteOn(channel, pitch, static_cast<uint8>(velocity)), audioAdvancement);
+        auto dirty = dirtyParameters[word].exchange(0, std::memory_order_acquire);
+
+        while (dirty)
+        {
+            auto const idx = word * 64 + std::countr_zero(dirty);
+            dirty &= dirty - 1;
+
+#if PLUGDATA_STANDALONE
+            float value = standaloneParams[idx].load();
+            if (value == lastParameters[idx].load()) continue;
+#else
+            float value = pendingParameters[idx].load();
+#endif
+            lastParameters[idx].store(value);
+
+            // For [param~], which needs no receiver
+            libpd_param_set(idx, value, parameterRampTime);
+
+            auto* receiver = parameterSymbols[idx]->s_thing;
+            auto* rampReceiver = parameterRampSymbols[idx]->s_thing;
+            if (!receiver && !rampReceiver) continue;
+
+            if (!locked)
+            {
+                sys_lock();
+                locked = true;
+            }
+
+            if (receiver) pd_float(receiver, value);
+
+            if (rampReceiver)
+            {
+                t_atom ramp[2];
+                SETFLOAT(ramp, value);
+                SETFLOAT(ramp + 1, parameterRampTime);
+                pd_list(rampReceiver, &s_list, 2, ramp);
+            }
+        }
     }
+
+    if (locked) sys_unlock();
 }
 
-void PlugDataAudioProcessor::receiveControlChange(const int channel, const int controller, const int value)
+void PlugDataAudioProcessor::performParameterChange(int type, int idx, float value)
 {
-    midiBufferOut.addEvent(MidiMessage::controllerEvent(channel, controller, value), audioAdvancement);
+    if (!isPositiveAndBelow(idx, numAutomationParameters))
+    {
+        logMessage("parameter " + String(idx + 1) + " doesn't exist");
+        return;
+    }
+
+    // Type == 1 means it sets the change gesture state
+    if(type)
+    {
+        if(changeGestureState[idx] == value) {
+            logMessage("parameter change " + String(idx) + (value ? " already started" : " not started"));
+        }
+        else {
+            #if !PLUGDATA_STANDALONE
+            auto* parameter = parameters.getParameter("param" + String(idx + 1));
+            value ? parameter->beginChangeGesture() : parameter->endChangeGesture();
+            #endif
+            changeGestureState[idx] = value;
+        }
+    }
+    else { // otherwise set parameter value
+#if PLUGDATA_STANDALONE
+        // Set the value
+        standaloneParams[idx].store(value);
+        
+        // The automation panel picks it up on its next frame
+        if(lastParameters[idx].exchange(value) == value) return;
+        parametersChangedByPd[idx / 64].fetch_or(uint64(1) << (idx % 64));
+#else
+        auto paramID = "param" + String(idx + 1);
+        if(lastParameters[idx].exchange(value) == value) return; // Prevent feedback
+        // Send new value to DAW
+        parameters.getParameter(paramID)->setValueNotifyingHost(value);
+#endif
+    }
 }
 
-void PlugDataAudioProcessor::receiveProgramChange(const int channel, const int value)
+void PlugDataAudioProcessor::performLatencyChange(int samples)
 {
-    midiBufferOut.addEvent(MidiMessage::programChange(channel, value), audioAdvancement);
+    if (samples == patchLatency)
+        return;
+
+    patchLatency = samples;
+    updateLatency();
 }
 
-void PlugDataAudioProcessor::receivePitchBend(const int channel, const int value)
+void PlugDataAudioProcessor::performLayerChange(String const& action, std::vector<pd::Atom> const& args)
 {
-    midiBufferOut.addEvent(MidiMessage::pitchWheel(channel, value + 8192), audioAdvancement);
+    auto getFile = [this, &args](size_t index = 0) {
+        auto const path = args.size() <= index ? String() : args[index].getSymbol();
+        auto const directory = patches.isEmpty() ? File::getCurrentWorkingDirectory() : patches.getFirst()->getCurrentFile().getParentDirectory();
+        return directory.getChildFile(path);
+    };
+
+    if (action == "open" && !args.empty())
+    {
+        addLayer(getFile());
+    }
+    else if (action == "close" && !args.empty())
+    {
+        removeLayer(getFile());
+    }
+    else if ((action == "pause" || action == "resume") && !args.empty())
+    {
+        setLayerPaused(getFile(), action == "pause");
+    }
+    else if (action == "clear")
+    {
+        clearLayers();
+    }
+    else if (action == "program" && args.size() >= 2 && args[0].isFloat())
+    {
+        setProgram(static_cast<int>(args[0].getFloat()), getFile(1));
+    }
+    else if (action == "program" && !args.empty() && args[0].isFloat())
+    {
+        setCurrentProgram(static_cast<int>(args[0].getFloat()));
+    }
+    else if (action == "crossfade" && !args.empty() && args[0].isFloat())
+    {
+        programCrossfadeMs = std::max(0.0f, args[0].getFloat());
+    }
 }
 
-void PlugDataAudioProcessor::receiveAftertouch(const int channel, const int value)
+void PlugDataAudioProcessor::performCompiledChange(String const& action, std::vector<pd::Atom> const& args)
 {
-    midiBufferOut.addEvent(MidiMessage::channelPressureChange(channel, value), audioAdvancement);
+    auto const name = args.empty() ? String() : args[0].getSymbol();
+    auto const directory = patches.isEmpty() ? File::getCurrentWorkingDirectory() : patches.getFirst()->getCurrentFile().getParentDirectory();
+
+    if (action == "export" && name.isNotEmpty())
+    {
+        exportCompiledPatch(directory.getChildFile(name).withFileExtension("cpp"));
+    }
+    else if (action == "load" && name.isNotEmpty())
+    {
+        loadCompiledPatch(directory.getChildFile(name));
+    }
+    else if (action == "unload")
+    {
+        loadCompiledPatch(File());
+    }
 }
 
-void PlugDataAudioProcessor::receivePolyAftertouch(const int channel, const int pitch, const int value)
+void PlugDataAudioProcessor::exportCompiledPatch(File const& source)
 {
-    midiBufferOut.addEvent(MidiMessage::aftertouchChange(channel, pitch, value), audioAdvancement);
+    if (patches.isEmpty())
+    {
+        logError("There's no patch to export");
+        return;
+    }
+
+    String code;
+    auto const result = pd::PatchCompiler::generate(this, *patches.getFirst(), code);
+    if (result.failed())
+    {
+        logError(result.getErrorMessage());
+        return;
+    }
+
+    if (!source.replaceWithText(code))
+    {
+        logError("Couldn't write " + source.getFullPathName());
+        return;
+    }
+
+    auto const module = source.getSiblingFile(pd::PatchCompiler::getModuleFileName(source.getFileNameWithoutExtension()));
+    logMessage("Exported " + source.getFileName() + ", building " + module.getFileName());
+
+    // The build can take longer than the processor is around
+    WeakReference<PlugDataAudioProcessor> processor(this);
+    pd::PatchCompiler::build(source, module, *tasks, [processor, module](Result built) {
+        if (!processor)
+            return;
+
+        if (built.failed())
+            processor->logError(built.getErrorMessage());
+        else
+            processor->logMessage("Built " + module.getFileName() + ", load it with [; compiled load " + module.getFileName() + "(");
+    });
 }
 
-void PlugDataAudioProcessor::receiveMidiByte(const int port, const int byte)
+void PlugDataAudioProcessor::loadCompiledPatch(File const& module)
 {
-    if (midiByteIsSysex)
+    std::unique_ptr<pd::CompiledPatch> compiled;
+    if (module != File())
     {
-        if (byte == 0xf7)
+        String error;
+        compiled = pd::CompiledPatch::load(module, error);
+        if (!compiled)
         {
-            midiBufferOut.addEvent(MidiMessage::createSysExMessage(midiByteBuffer, static_cast<int>(midiByteIndex)), audioAdvancement);
-            midiByteIndex = 0;
-            midiByteIsSysex = false;
+            logError(error);
+            return;
         }
-        else
+    }
+
+    auto const name = compiled ? compiled->getFile().getFileName() : String();
+
+    // The previous module is unloaded here as well, so the audio thread is kept out
+    suspendProcessing(true);
+    {
+        const pd::CallbackLock::ScopedLockType lock(*getCallbackLock());
+        setCompiledPatch(std::move(compiled));
+    }
+    suspendProcessing(false);
+
+    logMessage(name.isEmpty() ? String("Running the patch in pd again") : "Running " + name + " instead of the patch's DSP");
+}
+
+pd::Layer* PlugDataAudioProcessor::addLayer(File const& file, bool paused)
+{
+#if !PDINSTANCE
+    // Without separate instances a layer would share pd's state with this one, the standalone is built that way
+    logError("Layers need a build of plugdata with multiple pd instances, couldn't open " + file.getFileName());
+    return nullptr;
+#endif
+
+    if (!file.existsAsFile())
+    {
+        logError("Layer " + file.getFullPathName() + " doesn't exist");
+        return nullptr;
+    }
+
+    auto layer = std::make_unique<pd::Layer>(*this, file);
+    if (!layer->isLoaded())
+    {
+        logError("Couldn't open layer " + file.getFileName());
+        return nullptr;
+    }
+
+    auto const factor = getPdRateFactor();
+    auto const& routing = *channelRouting.load();
+    layer->setTicksPerBlock(getTicksPerBlock());
+    layer->prepare(routing.numInputs, routing.numOutputs, getSampleRate() * factor, static_cast<int>(std::ceil(getBlockSize() * factor)));
+
+    // Not processed yet, so this can't race with the audio thread
+    if (paused)
+        layer->fadeTo(false, 0);
+
+    setThis();
+
+    // From now on, the audio thread dequeues the layer's messages
+    const pd::CallbackLock::ScopedLockType lock(*getCallbackLock());
+    layer->setActive(true);
+    return layers.add(layer.release());
+}
+
+void PlugDataAudioProcessor::removeLayer(File const& file)
+{
+    std::unique_ptr<pd::Layer> removed;
+
+    {
+        const pd::CallbackLock::ScopedLockType lock(*getCallbackLock());
+        for (int i = 0; i < layers.size(); i++)
         {
-            midiByteBuffer[midiByteIndex++] = static_cast<uint8>(byte);
-            if (midiByteIndex == 512)
+            if (layers[i]->getFile() == file)
             {
-                midiByteIndex = 511;
+                removed.reset(layers.removeAndReturn(i));
+                forgetProgram(removed.get());
+                break;
             }
         }
     }
-    else if (midiByteIndex == 0 && byte == 0xf0)
+
+    if (removed)
     {
-        midiByteIsSysex = true;
+        removed->setActive(false);
     }
-    else
+
+    // Destroy the layer outside of the audio lock, then make our instance current again
+    removed.reset();
+    setThis();
+}
+
+void PlugDataAudioProcessor::setLayerPaused(File const& file, bool paused)
+{
+    for (auto* layer : layers)
     {
-        midiByteBuffer[midiByteIndex++] = static_cast<uint8>(byte);
-        if (midiByteIndex >= 3)
+        if (layer->getFile() == file)
         {
-            midiBufferOut.addEvent(MidiMessage(midiByteBuffer, 3), audioAdvancement);
-            midiByteIndex = 0;
+            layer->setPaused(paused);
+            return;
         }
     }
+
+    logError("Layer " + file.getFileName() + " isn't open");
 }
 
-// Only for standalone: check which parameters have changed and forward them to pd
-void PlugDataAudioProcessor::sendParameters()
+void PlugDataAudioProcessor::clearLayers()
 {
-#if PLUGDATA_STANDALONE
-    for (int idx = 0; idx < numParameters; idx++)
+    OwnedArray<pd::Layer> removed;
+
+    {
+        const pd::CallbackLock::ScopedLockType lock(*getCallbackLock());
+        removed.swapWith(layers);
+
+        programs.fill(nullptr);
+        numPrograms = 0;
+        playingProgram = -1;
+    }
+
+    for (auto* layer : removed)
+    {
+        layer->setActive(false);
+    }
+
+    removed.clear();
+    setThis();
+}
+
+void PlugDataAudioProcessor::setProgram(int index, File const& file)
+{
+    if (!isPositiveAndBelow(index, maxPrograms))
     {
-        float value = standaloneParams[idx].load();
-        if (value != lastParameters[idx])
+        logError("Program " + String(index) + " is out of range");
+        return;
+    }
+
+    auto* layer = addLayer(file, true);
+    if (!layer)
+        return;
+
+    std::unique_ptr<pd::Layer> replaced;
+
+    {
+        const pd::CallbackLock::ScopedLockType lock(*getCallbackLock());
+
+        if (auto* previous = programs[index])
         {
-            auto paramID = "param" + String(idx + 1);
-            sendFloat(paramID.toRawUTF8(), value);
-            lastParameters[idx] = value;
+            replaced.reset(layers.removeAndReturn(layers.indexOf(previous)));
+            forgetProgram(previous);
         }
+
+        programs[index] = layer;
+        numPrograms = std::max(numPrograms.load(), index + 1);
+
+        // The program that was replaced while playing is followed by the new one
+        if (currentProgram == index)
+            pendingProgram = index;
     }
-#endif
+
+    if (replaced)
+    {
+        replaced->setActive(false);
+    }
+
+    replaced.reset();
+    setThis();
 }
 
-void PlugDataAudioProcessor::performParameterChange(int type, int idx, float value)
+// Called with the callback lock, when a layer goes away
+void PlugDataAudioProcessor::forgetProgram(pd::Layer* layer)
 {
-    // Type == 1 means it sets the change gesture state
-    if(type)
+    for (int i = 0; i < maxPrograms; i++)
     {
-        if(changeGestureState[idx] == value) {
-            logMessage("parameter change " + String(idx) + (value ? " already started" : " not started"));
-        }
-        else {
-            #if !PLUGDATA_STANDALONE
-            auto* parameter = parameters.getParameter("param" + String(idx + 1));
-            value ? parameter->beginChangeGesture() : parameter->endChangeGesture();
-            #endif
-            changeGestureState[idx] = value;
-        }
+        if (programs[i] != layer)
+            continue;
+
+        programs[i] = nullptr;
+        if (playingProgram == i)
+            playingProgram = -1;
     }
-    else { // otherwise set parameter value
-#if PLUGDATA_STANDALONE
-        // Set the value
-        standaloneParams[idx].store(value);
-        
-        // Update values in automation panel
-        if(lastParameters[idx] == value) return;
-        if(auto* editor = dynamic_cast<PlugDataPluginEditor*>(getActiveEditor())) {
-            editor->sidebar.updateAutomationParameters();
-        }
-        lastParameters[idx] = value;
-#else
-        auto paramID = "param" + String(idx + 1);
-        if(lastParameters[idx] == value) return; // Prevent feedback
-        // Send new value to DAW
-        parameters.getParameter(paramID)->setValueNotifyingHost(value);
-        lastParameters[idx] = value;
-#endif
+
+    auto count = maxPrograms;
+    while (count > 0 && !programs[count - 1])
+        count--;
+
+    numPrograms = count;
+}
+
+// Fades out the program that is playing and fades in the one that was chosen, at the start of a block
+void PlugDataAudioProcessor::switchProgram()
+{
+    auto const index = pendingProgram.exchange(-1);
+    if (!isPositiveAndBelow(index, maxPrograms) || index == playingProgram)
+        return;
+
+    // The layers count samples at pd's rate
+    auto const fadeSamples = roundToInt(programCrossfadeMs.load() * getSampleRate() * getPdRateFactor() / 1000.0);
+
+    if (isPositiveAndBelow(playingProgram, maxPrograms) && programs[playingProgram])
+        programs[playingProgram]->fadeTo(false, fadeSamples);
+
+    if (programs[index])
+    {
+        programs[index]->fadeTo(true, fadeSamples);
+        playingProgram = index;
     }
 }
 
 // Callback when parameter values change
 void PlugDataAudioProcessor::parameterValueChanged (int idx, float value)
 {
-    enqueueFunction([this, idx, value]() mutable {
-        auto paramID = "param" + String(idx);
-        sendFloat(paramID.toRawUTF8(), value);
-        lastParameters[idx - 1] = value;
-    });
+    // Index 0 is the volume parameter
+#if PLUGDATA_STANDALONE
+    standaloneParams[idx - 1].store(value);
+#else
+    pendingParameters[idx - 1].store(value);
+#endif
+    markParameterDirty(idx - 1);
 }
 
 void PlugDataAudioProcessor::parameterGestureChanged (int parameterIndex, bool gestureIsStarting)
@@ -1256,12 +2515,20 @@ void PlugDataAudioProcessor::receiveGuiUpdate(int type)
     
     if(!isTimerRunning()) {
 
-        startTimer(16);
+        startTimer(guiUpdateInterval);
     }
 }
 
 void PlugDataAudioProcessor::timerCallback()
 {
+    TRACE_ZONE("PlugDataAudioProcessor::timerCallback");
+
+    RealtimeCheck::flush([this](String const& message) { logError(message); });
+
+    // Always collected, so the queue doesn't grow while there's no editor
+    std::unordered_set<void*> changedObjects;
+    collectDirtyObjects(changedObjects);
+    
     if (auto* editor = dynamic_cast<PlugDataPluginEditor*>(getActiveEditor()))
     {
         if (!callbackType) return;
@@ -1271,9 +2538,15 @@ void PlugDataAudioProcessor::timerCallback()
             {
                 cnv->updateGuiValues();
             }
+            // Only specific objects changed
+            else if (callbackType & 16)
+            {
+                cnv->updateGuiValues(changedObjects);
+            }
+            // Only specific scalars changed
             if (callbackType & 4)
             {
-                cnv->updateDrawables();
+                cnv->updateDrawables(changedObjects);
             }
             if (callbackType & 8)
             {
@@ -1312,6 +2585,45 @@ void PlugDataAudioProcessor::synchroniseCanvas(void* cnv)
         });
 }
 
+void PlugDataAudioProcessor::canvasEventsAvailable()
+{
+    MessageManager::callAsync(
+        [this]() mutable
+        {
+            dispatchCanvasEvents();
+        });
+}
+
+void PlugDataAudioProcessor::dispatchCanvasEvents()
+{
+    std::vector<pd::CanvasEvent> events;
+    dequeueCanvasEvents(events);
+
+    if (events.empty()) return;
+
+    if (auto* editor = dynamic_cast<PlugDataPluginEditor*>(getActiveEditor()))
+    {
+        for (auto* canvas : editor->canvases)
+        {
+            canvas->applyCanvasEvents(events);
+        }
+    }
+
+    canvasEventsApplied(events.size());
+}
+
+void PlugDataAudioProcessor::addAudioThreadObject(GUIObject* object)
+{
+    const SpinLock::ScopedLockType lock(audioThreadObjectsLock);
+    audioThreadObjects.addIfNotAlreadyThere(object);
+}
+
+void PlugDataAudioProcessor::removeAudioThreadObject(GUIObject* object)
+{
+    const SpinLock::ScopedLockType lock(audioThreadObjectsLock);
+    audioThreadObjects.removeFirstMatchingValue(object);
+}
+
 void PlugDataAudioProcessor::titleChanged()
 {
     if (auto* editor = dynamic_cast<PlugDataPluginEditor*>(getActiveEditor()))
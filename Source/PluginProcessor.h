@@ -8,16 +8,26 @@
 
 #include <JuceHeader.h>
 
+#include <unordered_map>
+
 #include "Pd/PdInstance.h"
+#include "Pd/PdAbstractionWatcher.h"
 #include "Pd/PdLibrary.h"
+#include "Pd/PdLayer.h"
+#include "Pd/PdPlayhead.h"
 #include "Standalone/PlugDataWindow.h"
 #include "Statusbar.h"
+#include "Utility/Autosave.h"
+#include "Utility/Oversampler.h"
+#include "Utility/SettingsStore.h"
+#include "Utility/TaskPool.h"
 
 
 class PlugDataLook;
+struct GUIObject;
 
 class PlugDataPluginEditor;
-class PlugDataAudioProcessor : public AudioProcessor, public pd::Instance, public Timer, public AudioProcessorParameter::Listener
+class PlugDataAudioProcessor : public AudioProcessor, public pd::Instance, public Timer, public AudioProcessorParameter::Listener, public pd::Library::Listener, public pd::MidiDevicePorts, public SettingsStore::Listener
 {
    public:
     PlugDataAudioProcessor();
@@ -26,8 +36,30 @@ class PlugDataAudioProcessor : public AudioProcessor, public pd::Instance, publi
     static AudioProcessor::BusesProperties buildBusesProperties();
 
     void setOversampling(int amount);
+    void setOversamplingEngine(int engine);
+
+    // Lowest rate pd may run at without oversampling, 0 to always run at the host's rate
+    void setInternalRate(int rate);
+
+    // Samples that pd processes at once, a multiple of pd's block size
+    // Larger blocks have less overhead per sample, at the cost of latency
+    void setInternalBlockSize(int samples);
+    static constexpr int maxInternalBlockSize = 1024;
+
+    // Latency of the patch itself, the oversampling filters add their own on top
+    void setBaseLatency(int samples);
+    int getBaseLatency() const;
     void prepareToPlay(double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+    void processorLayoutsChanged() override;
+
+    // The editor and the console stop updating until the host is done rendering
+    void setNonRealtime(bool isNonRealtime) noexcept override;
+
+#if JUCE_VERSION >= 0x070006
+    // Lets the worker threads join the workgroup of the audio thread
+    void audioWorkgroupContextChanged(AudioWorkgroup const& workgroup) override;
+#endif
 
 #ifndef JucePlugin_PreferredChannelConfigurations
     bool isBusesLayoutSupported(const BusesLayout& layouts) const override;
@@ -38,6 +70,9 @@ class PlugDataAudioProcessor : public AudioProcessor, public pd::Instance, publi
     AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
 
+    // pd runs headless until the editor is created, and again after it's deleted, see pd::Instance::setHeadless
+    void editorBeingDeleted(AudioProcessorEditor* editor) noexcept override;
+
     const String getName() const override;
 
     bool acceptsMidi() const override;
@@ -48,6 +83,14 @@ class PlugDataAudioProcessor : public AudioProcessor, public pd::Instance, publi
     std::atomic<int> callbackType = 0;
     void timerCallback() override;
 
+    // Time between pd's GUI updates in ms, lowered along with the editor's frame rate
+    static constexpr int defaultGuiUpdateInterval = 16;
+    std::atomic<int> guiUpdateInterval = defaultGuiUpdateInterval;
+
+    // Objects that take a snapshot of their pd object after every audio block, with updateFromAudioThread
+    void addAudioThreadObject(GUIObject* object);
+    void removeAudioThreadObject(GUIObject* object);
+
     int getNumPrograms() override;
     int getCurrentProgram() override;
     void setCurrentProgram(int index) override;
@@ -57,14 +100,6 @@ class PlugDataAudioProcessor : public AudioProcessor, public pd::Instance, publi
     void getStateInformation(MemoryBlock& destData) override;
     void setStateInformation(const void* data, int sizeInBytes) override;
 
-    void receiveNoteOn(const int channel, const int pitch, const int velocity) override;
-    void receiveControlChange(const int channel, const int controller, const int value) override;
-    void receiveProgramChange(const int channel, const int value) override;
-    void receivePitchBend(const int channel, const int value) override;
-    void receiveAftertouch(const int channel, const int value) override;
-    void receivePolyAftertouch(const int channel, const int pitch, const int value) override;
-    void receiveMidiByte(const int port, const int byte) override;
-    
     void parameterValueChanged (int parameterIndex, float newValue) override;
     void parameterGestureChanged (int parameterIndex, bool gestureIsStarting) override;
     
@@ -73,18 +108,25 @@ class PlugDataAudioProcessor : public AudioProcessor, public pd::Instance, publi
 
     void updateConsole() override;
 
+    void appDirChanged() override;
+    void settingsChanged(ValueTree const& newSettings) override;
+
     void synchroniseCanvas(void* cnv) override;
+    void canvasEventsAvailable() override;
+
+    // Hands the pending canvas events to the canvases of the editor, call from the message thread
+    void dispatchCanvasEvents();
 
     void process(dsp::AudioBlock<float>, MidiBuffer&);
 
     void setCallbackLock(const CriticalSection* lock)
     {
-        audioLock = lock;
+        callbackLock.setLock(lock, &audioStats);
     };
 
-    const CriticalSection* getCallbackLock() override
+    const pd::CallbackLock* getCallbackLock() override
     {
-        return audioLock;
+        return &callbackLock;
     };
 
     bool canAddBus(bool isInput) const override
@@ -98,20 +140,81 @@ class PlugDataAudioProcessor : public AudioProcessor, public pd::Instance, publi
         return nbus > 0;
     }
 
+    // Extracts the abstractions and documentation and creates the library links, safe to call from any thread
     void initialiseFilesystem();
+
+    // Creates the default settings or loads them, call from the message thread
+    void initialiseSettings();
+    // Writes the settings before returning
     void saveSettings();
+    // Writes the settings once they stop changing, other instances get them straight away
+    void saveSettingsAsync();
     void updateSearchPaths();
 
     void sendMidiBuffer();
     void sendPlayhead();
+    void setPlayheadRate(int rate);
     void sendParameters();
 
+    // Delivers midi at its sample position inside pd's ticks instead of at the start of each tick
+    void setSampleAccurateMidi(bool enabled);
+
+    // Standalone only: when the device's buffer size is a multiple of pd's block size,
+    // the output of every tick is written straight away instead of a tick later
+    void setLowLatency(bool enabled);
+
+    // Stops pd's DSP once the inputs and outputs have been silent for longer than the tail length,
+    // until audio, midi, a parameter or a message comes in. pd's clocks keep running while it sleeps
+    void setAutoSleep(bool enabled);
+    void setTailLength(float seconds);
+
+    // Hosts can't handle parameters that come and go, so this applies to instances created afterwards
+    void setNumAutomationParameters(int amount);
+
+    // Midi devices for pd's ports, the input of port 0 is merged with the midi the player passes on
+    MidiInputCallback* getMidiInputPort(int port) override;
+    void setMidiOutputPort(int port, MidiOutput* output) override;
+
+    // Marks a parameter to be sent to pd on the next tick, can be called from any thread
+    void markParameterDirty(int idx);
+
     void messageEnqueued() override;
     void performParameterChange(int type, int idx, float value) override;
+    void performLayerChange(String const& action, std::vector<pd::Atom> const& args) override;
+    void performCompiledChange(String const& action, std::vector<pd::Atom> const& args) override;
+    void performLatencyChange(int samples) override;
+
+    // Layers are patches that run in a pd instance of their own, concurrently with this one
+    // A paused layer starts silent, see pd::Layer::fadeTo
+    pd::Layer* addLayer(File const& file, bool paused = false);
+    void removeLayer(File const& file);
+
+    // Stops or continues running a layer, without rebuilding any DSP chain
+    void setLayerPaused(File const& file, bool paused);
+    void clearLayers();
+
+    // Programs are layers that are kept loaded and paused until they're chosen, so switching is instant
+    //! @details The host, a midi program change or "program <index>" to [r layer] choose one, the switch
+    //! happens at the start of the next block, with a crossfade of "crossfade <ms>" between the two.
+    void setProgram(int index, File const& file);
+    static constexpr int maxPrograms = 128;
+
+    // Writes the signal graph of the main patch as C++ next to the patch and builds it, see pd::PatchCompiler
+    // "export <name>" to [r compiled] calls it, "load <module>" loads the module so it runs instead of pd's DSP chain
+    void exportCompiledPatch(File const& source);
+
+    // An empty file goes back to pd's DSP chain
+    void loadCompiledPatch(File const& module);
 
     pd::Patch* loadPatch(String patch);
     pd::Patch* loadPatch(const File& patch);
 
+    // Loads the content of Patch::getCanvasBinary as an untitled patch
+    pd::Patch* loadPatch(MemoryBlock const& binaryContent);
+
+    // Call when patches were opened, closed or saved under another name
+    void updateAbstractionWatcher();
+
     void titleChanged() override;
 
     void setTheme(bool themeToUse);
@@ -124,14 +227,22 @@ class PlugDataAudioProcessor : public AudioProcessor, public pd::Instance, publi
     // All opened patches
     OwnedArray<pd::Patch> patches;
 
+    // Reloads the abstractions next to the open patches when they change
+    pd::AbstractionWatcher abstractionWatcher { *this };
+
+#if PLUGDATA_STANDALONE
+    // In a plugin the host keeps the state, and copies could be recovered into the wrong session
+    Autosave autosave { *this };
+#endif
+
     int lastUIWidth = 1000, lastUIHeight = 650;
 
-    std::vector<float*> channelPointers;
     std::atomic<float>* volume;
 
     ValueTree settingsTree = ValueTree("PlugDataSettings");
 
-    pd::Library objectLibrary;
+    // Shared by all instances in the process
+    SharedResourcePointer<pd::Library> objectLibrary;
 
     File homeDir = File::getSpecialLocation(File::SpecialLocationType::userApplicationDataDirectory).getChildFile("PlugData");
     File appDir = homeDir.getChildFile(ProjectInfo::versionString);
@@ -147,54 +258,224 @@ class PlugDataAudioProcessor : public AudioProcessor, public pd::Instance, publi
     StatusbarSource statusbarSource;
 
     Value tailLength = Value(0.0f);
+    std::atomic<float> tailLengthSeconds = 0.0f;
 
     SharedResourcePointer<PlugDataLook> lnf;
 
     static inline constexpr int numParameters = 512;
+
+    // The first of the parameters that can be used as param1 etc., the host only sees these
+    // The standalone has no host, it keeps all of them in standaloneParams instead
+    int numAutomationParameters = numParameters;
     static inline constexpr int numInputBuses = 16;
     static inline constexpr int numOutputBuses = 16;
 
 #if PLUGDATA_STANDALONE
     std::atomic<float> standaloneParams[numParameters] = {0};
+
+    // One bit for every parameter that pd changed since the automation panel last showed it
+    std::array<std::atomic<uint64>, numParameters / 64> parametersChangedByPd;
 #endif
     
     // Zero means no oversampling
     int oversampling = 0;
+    Oversampler::Engine oversamplingEngine = Oversampler::IIR;
+
+    // pd runs at the host's rate divided by 1 << undersampling, the highest division that stays at or above internalRate
+    int internalRate = 0;
+    int undersampling = 0;
     int lastTab = -1;
     
     bool settingsChangedInternally = false;
     
    private:
+    // Brings settingsTree up to date with newSettings, without breaking the links the editor has to it
+    void applySettings(ValueTree const& newSettings);
+
+    // Every bus has two of pd's channels, channel c of bus b is [adc~]/[dac~] 2b+c+1, whether
+    // the buses before it are active or not
+    static inline constexpr int maxChannels = 2 * std::max(numInputBuses, numOutputBuses);
+
+    // The channel of the host's buffer for each of pd's channels, or -1 when its bus is inactive
+    //! @details pd only gets channels up to the last active bus, so inactive buses at the end cost
+    //! nothing and the ones in between are only a silent input. Built whenever the layout can change,
+    //! the audio thread picks up the new one at its next block.
+    struct ChannelRouting {
+        std::array<int, maxChannels> inputs;
+        std::array<int, maxChannels> outputs;
+        int numInputs = 0;
+        int numOutputs = 0;
+        int numHostInputs = 0;
+        int numHostOutputs = 0;
+    };
+
+    void updateChannelRouting();
+
+    // Written only from the message thread, while the audio thread may still read the other one
+    std::array<ChannelRouting, 2> channelRoutings;
+    std::atomic<ChannelRouting const*> channelRouting = &channelRoutings[0];
+
+    // pd's channels in the current block, nullptr for inactive buses
+    std::array<float const*, maxChannels> inputPointers = {};
+    std::array<float*, maxChannels> outputPointers = {};
+
+    void changeOversampling(int amount, Oversampler::Engine engine, int rate);
+    std::unique_ptr<Oversampler> createOversampler(int amount, Oversampler::Engine engine, int samplesPerBlock) const;
+    std::unique_ptr<Undersampler> createUndersampler(int amount, int samplesPerBlock) const;
+    static int getUndersampling(int oversamplingAmount, int rate, double sampleRate);
+
+    // pd's rate relative to the host's
+    double getPdRateFactor() const;
+    void updateLatency();
+    void prepareSampleRate(double sampleRate, int samplesPerBlock);
+    void applyReconfigureFade(AudioBuffer<float>& buffer);
+
+    void prepareTick();
     void processInternal();
 
+    // Everything at or below this is silence, about -100 dB
+    static constexpr float silenceThreshold = 1.0e-5f;
+
+    void updateSleepState(AudioBuffer<float> const& buffer, bool hasInput);
+    bool processAsleep(int numSamples, MidiBuffer& midiMessages);
+
+    // Runs pd at its internal rate, between the undersampler's down and up
+    void processUndersampled(dsp::AudioBlock<float>& block, MidiBuffer& midiMessages);
+    void wakeUp();
+
+    std::atomic<bool> autoSleep = false;
+    std::atomic<bool> sleepWakeRequested = false;
+    bool asleep = false;
+    int64 silentSamples = 0;
+    int sleepAdvancement = 0;
+
+    void processInternal(int offset, bool direct = false);
+
+    template<typename Callable>
+    void processWithLayers(float const* input, Callable&& processMain);
+    void mixLayers(float* output);
+
     int audioAdvancement = 0;
     std::vector<float> audioBufferIn;
     std::vector<float> audioBufferOut;
 
+    OwnedArray<pd::Layer> layers;
+    std::vector<float> layerInput;
+    std::vector<float> layerOutput;
+
+    // Layers owned by layers, only changed with the callback lock
+    std::array<pd::Layer*, maxPrograms> programs = {};
+    std::atomic<int> numPrograms = 0;
+    std::atomic<int> currentProgram = 0;
+    std::atomic<int> pendingProgram = -1;
+    std::atomic<float> programCrossfadeMs = 10.0f;
+
+    // Used by the audio thread, or with the callback lock
+    int playingProgram = -1;
+
+    void switchProgram();
+    void forgetProgram(pd::Layer* layer);
+
     MidiBuffer midiBufferIn;
-    MidiBuffer midiBufferOut;
+
+    // The host only has one midi bus, so a plugin puts every port on port 0
+#if PLUGDATA_STANDALONE
+    static constexpr int numMidiPorts = pd::MidiBus::maxPorts;
+#else
+    static constexpr int numMidiPorts = 1;
+#endif
+
+    // pd's midi output, sized so a sysex dump doesn't allocate on the audio thread
+    pd::MidiBus midiOutputBus { numMidiPorts, pd::MidiBus::maxSysexSize + 2048 };
+    MidiBuffer& midiBufferOut = midiOutputBus[0];
     MidiBuffer midiBufferTemp;
     MidiBuffer midiBufferCopy;
 
-    bool midiByteIsSysex = false;
-    uint8 midiByteBuffer[512] = {0};
-    size_t midiByteIndex = 0;
+    void scheduleMidiBuffer();
+    void dispatchScheduledMidi(int position);
 
-    std::array<float, numParameters> lastParameters = {0};
+    std::atomic<bool> sampleAccurateMidi = false;
+    std::atomic<bool> lowLatency = false;
+    MidiBuffer midiBufferScheduled;
+    MidiBufferIterator nextScheduledMidi = midiBufferScheduled.end();
+    int scheduledMidiPosition = 0;
+    t_clock* midiClock = nullptr;
+
+    // The midi devices of the ports, only the standalone has them
+    OwnedArray<pd::MidiInputRing> midiInputPorts;
+    std::array<MidiOutput*, pd::MidiBus::maxPorts> midiOutputPorts = {};
+    pd::MidiBus midiInputBus { numMidiPorts, 2048 };
+
+    void sendMidiOutputPorts(MidiBuffer& midiMessages);
+
+    // The value pd last got or sent, the audio thread and the message thread both compare against it
+    std::array<std::atomic<float>, numParameters> lastParameters;
     std::array<float, numParameters> changeGestureState = {0};
 
-    std::vector<pd::Atom> atoms_playhead;
+    // "param1" to "param512", interned once for our pd instance
+    std::array<t_symbol*, numParameters> parameterSymbols = {};
+
+    // "param1~" to "param512~", get the value with the time to ramp to it, for [vline~] or [line~]
+    std::array<t_symbol*, numParameters> parameterRampSymbols = {};
+
+    // Length of the last host block in ms, the host sends at most one value per parameter per block
+    float parameterRampTime = 0.0f;
 
-    int minIn = 2;
-    int minOut = 2;
+    // One bit for every parameter that changed since the last tick
+    std::array<std::atomic<uint64>, numParameters / 64> dirtyParameters;
+
+#if !PLUGDATA_STANDALONE
+    std::array<std::atomic<float>, numParameters> pendingParameters;
+#endif
+
+    pd::PlayheadPublisher playheadPublisher;
 
     
-    std::unique_ptr<dsp::Oversampling<float>> oversampler;
+    std::unique_ptr<Oversampler> oversampler;
+    std::unique_ptr<Undersampler> undersampler;
+
+    // The host's midi at pd's rate, events wait here while the host's blocks are too short for a sample at pd's rate
+    MidiBuffer undersampledMidi;
+    int baseLatency = 0;
+    int patchLatency = 0;
+
+    // Fades the output around changes that restart pd while audio is running
+    enum class ReconfigureFade
+    {
+        None,
+        FadeOut,
+        Muted,
+        FadeIn
+    };
+    std::atomic<ReconfigureFade> reconfigureFade = ReconfigureFade::None;
+
+    // Extracts the documentation in the background on startup
+    pd::LambdaThread filesystemThread;
+
+    // Only taken briefly by the message thread, the audio thread skips a block rather than waiting
+    Array<GUIObject*> audioThreadObjects;
+    SpinLock audioThreadObjectsLock;
+
+    // Marks the binary state format, the old format started with the number of patches
+    static constexpr int stateMagic = 0x54534450;
+    // Takes an opened patch in, and gives it a tab when the editor is open
+    pd::Patch* addPatch(pd::Patch const& newPatch);
+
+    // Version 1 stores the patches as text, version 2 in pd's binary form
+    static constexpr int stateVersion = 2;
+
+    // Compressed patch contents from the last time the state was saved, by hash of the content
+    std::unordered_map<int64, MemoryBlock> stateCache;
+    CriticalSection stateCacheLock;
+
+    pd::CallbackLock callbackLock;
 
-    const CriticalSection* audioLock;
+    // Builds exported patches
+    SharedResourcePointer<TaskPool> tasks;
     
     static inline const String else_version = "ELSE v1.0-rc4";
     static inline const String cyclone_version = "cyclone v0.6-1";
     
+    JUCE_DECLARE_WEAK_REFERENCEABLE(PlugDataAudioProcessor)
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PlugDataAudioProcessor)
 };
@@ -4,19 +4,19 @@
  // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
  */
 
+#include <bit>
+
 #include "Canvas.h"
 
 struct AutomationSlider : public Component, public Value::Listener {
 
     PlugDataAudioProcessor* pd;
     
-    AutomationSlider(int idx, PlugDataAudioProcessor* processor)
-        : index(idx), pd(processor)
+    explicit AutomationSlider(PlugDataAudioProcessor* processor)
+        : pd(processor)
     {
         createButton.setName("statusbar:createbutton");
 
-        nameLabel.setText(String(idx + 1), dontSendNotification);
-
         createButton.onClick = [this]() mutable {
             if (auto* editor = dynamic_cast<PlugDataPluginEditor*>(pd->getActiveEditor())) {
                 auto* cnv = editor->getCurrentCanvas();
@@ -33,12 +33,11 @@ struct AutomationSlider : public Component, public Value::Listener {
         slider.setTextBoxStyle(Slider::NoTextBox, false, 45, 13);
 
 #if PLUGDATA_STANDALONE
-        slider.setValue(pd->standaloneParams[index]);
         slider.setRange(0.0f, 1.0f);
-        valueLabel.setText(String(pd->standaloneParams[index], 2), dontSendNotification);
         slider.onValueChange = [this]() mutable {
             float value = slider.getValue();
             pd->standaloneParams[index] = value;
+            pd->markParameterDirty(index);
             valueLabel.setText(String(value, 2), dontSendNotification);
         };
 #else
@@ -46,10 +45,6 @@ struct AutomationSlider : public Component, public Value::Listener {
             float value = slider.getValue();
             valueLabel.setText(String(value, 2), dontSendNotification);
         };
-        auto* param = pd->parameters.getParameter("param" + String(index + 1));
-        auto range = param->getNormalisableRange().getRange();
-        attachment = std::make_unique<SliderParameterAttachment>(*param, slider, nullptr);
-        valueLabel.setText(String(param->getValue(), 2), dontSendNotification);
 #endif
         valueLabel.onEditorShow = [this]() mutable {
             if (auto* editor = valueLabel.getCurrentTextEditor()) {
@@ -58,8 +53,7 @@ struct AutomationSlider : public Component, public Value::Listener {
         };
 
         valueLabel.onEditorHide = [this]() mutable {
-            auto* param = pd->parameters.getParameter("param" + String(index + 1));
-            param->setValue(valueLabel.getText().getFloatValue());
+            slider.setValue(valueLabel.getText().getFloatValue());
         };
 
         valueLabel.setMinimumHorizontalScale(1.0f);
@@ -77,6 +71,37 @@ struct AutomationSlider : public Component, public Value::Listener {
     ~AutomationSlider() {
         pd->locked.removeListener(this);
     }
+
+    // Rows are reused for whichever parameters are scrolled into view
+    void setIndex(int newIndex)
+    {
+        if (newIndex == index)
+            return;
+
+        index = newIndex;
+        nameLabel.setText(String(index + 1), dontSendNotification);
+
+#if PLUGDATA_STANDALONE
+        updateValue();
+#else
+        attachment.reset();
+
+        auto* param = pd->parameters.getParameter("param" + String(index + 1));
+        attachment = std::make_unique<SliderParameterAttachment>(*param, slider, nullptr);
+        valueLabel.setText(String(param->getValue(), 2), dontSendNotification);
+#endif
+        repaint();
+    }
+
+#if PLUGDATA_STANDALONE
+    // Shows a value that pd changed, without sending it back to pd
+    void updateValue()
+    {
+        auto const value = pd->standaloneParams[index].load();
+        slider.setValue(value, dontSendNotification);
+        valueLabel.setText(String(value, 2), dontSendNotification);
+    }
+#endif
     
     
     void valueChanged(Value& v) override
@@ -111,41 +136,66 @@ struct AutomationSlider : public Component, public Value::Listener {
     Label valueLabel;
     Slider slider;
 
-    int index;
+    int index = -1;
 
 #if !PLUGDATA_STANDALONE
     std::unique_ptr<SliderParameterAttachment> attachment;
 #endif
 };
 
+// Only has rows for the parameters in view, so a change repaints one row at most
+//! @details Parameter p is always shown by row p modulo the number of rows, scrolling by a row
+//! only hands one of them a different parameter
 struct AutomationComponent : public Component {
+    static constexpr int rowHeight = 23;
+
     PlugDataAudioProcessor* pd;
+    int const numParameters;
 
     explicit AutomationComponent(PlugDataAudioProcessor* processor)
         : pd(processor)
+        , numParameters(processor->numAutomationParameters)
     {
-        for (int p = 0; p < PlugDataAudioProcessor::numParameters; p++) {
-            auto* slider = rows.add(new AutomationSlider(p, processor));
-            addAndMakeVisible(slider);
-        }
+        setSize(0, numParameters * rowHeight);
     }
 
-    void resized() override
+    void updateVisibleRows(Rectangle<int> visibleArea)
     {
-        int height = 23;
-        int y = 0;
-        for (int p = 0; p < PlugDataAudioProcessor::numParameters; p++) {
-            auto rect = Rectangle<int>(0, y, getWidth(), height);
-            y += height;
-            rows[p]->setBounds(rect);
+        firstVisible = jlimit(0, numParameters, visibleArea.getY() / rowHeight);
+        lastVisible = jlimit(firstVisible, numParameters, (visibleArea.getBottom() + rowHeight - 1) / rowHeight);
+
+        while (rows.size() < lastVisible - firstVisible)
+            addChildComponent(rows.add(new AutomationSlider(pd)));
+
+        for (auto* row : rows)
+            row->setVisible(false);
+
+        for (int p = firstVisible; p < lastVisible; p++) {
+            auto* row = rows[p % rows.size()];
+            row->setIndex(p);
+            row->setBounds(0, p * rowHeight, getWidth(), rowHeight);
+            row->setVisible(true);
         }
     }
 
+    // The row that shows parameter p, if it's in view
+    AutomationSlider* getRow(int p)
+    {
+        if (p < firstVisible || p >= lastVisible)
+            return nullptr;
+
+        return rows[p % rows.size()];
+    }
+
+    int firstVisible = 0;
+    int lastVisible = 0;
+
     OwnedArray<AutomationSlider> rows;
 };
 
 struct AutomationPanel : public Component
-    , public ScrollBar::Listener {
+    , public ScrollBar::Listener
+    , public FrameScheduler::Client {
     explicit AutomationPanel(PlugDataAudioProcessor* processor)
         : sliders(processor)
     {
@@ -160,11 +210,57 @@ struct AutomationPanel : public Component
         addAndMakeVisible(viewport);
     }
 
+    ~AutomationPanel() override
+    {
+        if (scheduler)
+            scheduler->removeClient(this);
+    }
+
     void scrollBarMoved(ScrollBar* scrollBarThatHasMoved, double newRangeStart) override
     {
+        sliders.updateVisibleRows(viewport.getViewArea());
         repaint();
     }
 
+    void visibilityChanged() override
+    {
+#if PLUGDATA_STANDALONE
+        // pd's changes to the parameters are picked up once per frame while the panel is showing
+        if (isShowing() && !scheduler) {
+            if (auto* editor = findParentComponentOfClass<PlugDataPluginEditor>()) {
+                scheduler = &editor->frameScheduler;
+                scheduler->addClient(this, 0);
+            }
+
+            // Whatever changed while hidden
+            for (auto& word : sliders.pd->parametersChangedByPd)
+                word = 0;
+            for (int p = sliders.firstVisible; p < sliders.lastVisible; p++)
+                sliders.getRow(p)->updateValue();
+        } else if (!isShowing() && scheduler) {
+            scheduler->removeClient(this);
+            scheduler = nullptr;
+        }
+#endif
+    }
+
+    void frameUpdate() override
+    {
+#if PLUGDATA_STANDALONE
+        auto& changed = sliders.pd->parametersChangedByPd;
+        for (int word = 0; word < static_cast<int>(changed.size()); word++) {
+            auto bits = changed[word].exchange(0);
+
+            while (bits) {
+                if (auto* row = sliders.getRow(word * 64 + std::countr_zero(bits)))
+                    row->updateValue();
+
+                bits &= bits - 1;
+            }
+        }
+#endif
+    }
+
     void paint(Graphics& g) override
     {
         g.setColour(findColour(PlugDataColour::panelBackgroundOffsetColourId));
@@ -186,18 +282,12 @@ struct AutomationPanel : public Component
     void resized() override
     {
         viewport.setBounds(getLocalBounds().withTrimmedTop(28).withTrimmedBottom(28));
-        sliders.setSize(getWidth(), PlugDataAudioProcessor::numParameters * 23);
+        sliders.setSize(viewport.getMaximumVisibleWidth(), sliders.getHeight());
+        sliders.updateVisibleRows(viewport.getViewArea());
     }
 
-#if PLUGDATA_STANDALONE
-    void updateParameters()
-    {
-        for (int p = 0; p < PlugDataAudioProcessor::numParameters; p++) {
-            sliders.rows[p]->slider.setValue(sliders.pd->standaloneParams[p]);
-        }
-    }
-#endif
-
     Viewport viewport;
     AutomationComponent sliders;
+
+    FrameScheduler* scheduler = nullptr;
 };
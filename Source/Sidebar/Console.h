@@ -17,13 +17,23 @@ struct Console : public Component {
 
         addAndMakeVisible(viewport);
 
+        search.setName("sidebar::searcheditor");
+        search.setJustification(Justification::centredLeft);
+        search.setBorder({ 1, 23, 3, 1 });
+        search.onTextChange = [this]() {
+            console->setQuery(search.getText());
+            repaint();
+        };
+
+        addAndMakeVisible(search);
+
         std::vector<String> tooltips = { "Clear logs", "Restore logs", "Show errors", "Show messages", "Enable autoscroll" };
 
         std::vector<std::function<void()>> callbacks = {
             [this]() { console->clear(); },
             [this]() { console->restore(); },
-            [this]() { console->update(); },
-            [this]() { console->update(); },
+            [this]() { console->relayout(); },
+            [this]() { console->relayout(); },
             [this]() { console->update(); },
 
         };
@@ -66,7 +76,8 @@ struct Console : public Component {
         auto bounds = getLocalBounds().toFloat();
 
         fb.performLayout(bounds.removeFromBottom(28));
-        
+        search.setBounds(bounds.removeFromTop(28).toNearestInt());
+
         viewport.setBounds(bounds.toNearestInt());
         console->setSize(viewport.getWidth(), std::max<int>(console->getTotalHeight(), viewport.getHeight()));
     }
@@ -87,13 +98,13 @@ struct Console : public Component {
         // Draw background if we don't have enough messages to fill the panel
         int h = 24;
         int y = console->getTotalHeight();
-        int idx = static_cast<int>(console->messages.size());
+        int idx = console->getNumRows();
         while (y < console->getHeight()) {
 
             if (y + h > console->getHeight()) {
                 h = console->getHeight() - y;
             }
-            auto b = Rectangle<int>(0, y, getWidth(), h);
+            auto b = Rectangle<int>(0, viewport.getY() + y, getWidth(), h);
 
             auto offColour = findColour(PlugDataColour::panelBackgroundOffsetColourId);
             auto onColour = findColour(PlugDataColour::panelBackgroundColourId);
@@ -107,71 +118,18 @@ struct Console : public Component {
         }
     }
 
-    struct ConsoleComponent : public Component {
-        struct ConsoleMessage : public Component {
-            int idx;
-            ConsoleComponent& console;
-
-            ConsoleMessage(int index, ConsoleComponent& parent)
-                : idx(index)
-                , console(parent)
-            {
-
-                parent.addAndMakeVisible(this);
-            }
-
-            Colour colourWithType(int type)
-            {
-                if (type == 0)
-                    return findColour(PlugDataColour::panelTextColourId);
-                else if (type == 1)
-                    return Colours::orange;
-                else
-                    return Colours::red;
-            }
-
-            void mouseDown(MouseEvent const& e)
-            {
-                console.selectedItem = idx;
-                console.repaint();
-            }
-
-            void paint(Graphics& g)
-            {
-                auto font = Font(Font::getDefaultSansSerifFontName(), 13, 0);
-                g.setFont(font);
-
-                bool isSelected = console.selectedItem == idx;
-                bool showMessages = console.buttons[2].getToggleState();
-                bool showErrors = console.buttons[3].getToggleState();
-
-                // Draw background
-                auto offColour = findColour(PlugDataColour::panelBackgroundOffsetColourId);
-                auto onColour = findColour(PlugDataColour::panelBackgroundColourId);
-                auto background = (idx & 1) ? offColour : onColour;
-
-                g.setColour(isSelected ? findColour(PlugDataColour::panelActiveBackgroundColourId) : background);
-                g.fillRect(getLocalBounds());
-
-                // Get console message
-                auto& [message, type, length] = console.pd->getConsoleMessages()[idx];
-
-                // Check if message type should be visible
-                if ((type == 1 && !showMessages) || (type == 0 && !showErrors)) {
-                    return;
-                }
-
-                // Approximate number of lines from string length and current width
-                int numLines = getNumLines(console.getWidth(), length);
-
-                // Draw text
-                g.setColour(isSelected ? findColour(PlugDataColour::panelActiveTextColourId) : colourWithType(type));
-                g.drawFittedText(message, getLocalBounds().reduced(4, 0), Justification::centredLeft, numLines, 1.0f);
-            }
-        };
+    void paintOverChildren(Graphics& g) override
+    {
+        g.setFont(getLookAndFeel().getTextButtonFont(buttons[0], 30));
+        g.setColour(findColour(PlugDataColour::panelTextColourId));
 
-        std::deque<std::unique_ptr<ConsoleMessage>> messages;
+        g.drawText(Icons::Search, 0, 0, 30, 30, Justification::centred);
+    }
 
+    // Draws the console messages as rows, only laying out and painting the rows that are visible
+    //! @details Rows are numbers of lines in the console log. New lines are found through the log's
+    //! indexes and added to the end of the layout, only a change of filter, search or width lays out every row again.
+    struct ConsoleComponent : public Component {
         std::array<TextButton, 5>& buttons;
         Viewport& viewport;
 
@@ -186,6 +144,16 @@ struct Console : public Component {
             repaint();
         }
 
+        static Colour colourWithType(Component& c, int type)
+        {
+            if (type == 0)
+                return c.findColour(PlugDataColour::panelTextColourId);
+            else if (type == 1)
+                return Colours::orange;
+            else
+                return Colours::red;
+        }
+
         void focusLost(FocusChangeType cause) override
         {
             selectedItem = -1;
@@ -193,123 +161,229 @@ struct Console : public Component {
 
         bool keyPressed(KeyPress const& key) override
         {
-            if (isPositiveAndBelow(selectedItem, pd->getConsoleMessages().size())) {
+            auto& log = pd->getConsoleLog();
+            if (selectedItem >= 0 && log.contains(static_cast<uint64>(selectedItem))) {
                 // Copy console item
                 if (key == KeyPress('c', ModifierKeys::commandModifier, 0)) {
-                    SystemClipboard::copyTextToClipboard(std::get<0>(pd->getConsoleMessages()[selectedItem]));
+                    SystemClipboard::copyTextToClipboard(log[static_cast<uint64>(selectedItem)].text);
                     return true;
                 }
             }
             return false;
         }
 
-        void update()
+        void mouseDown(MouseEvent const& e) override
         {
-            while (messages.size() > pd->getConsoleMessages().size() || messages.size() >= 800) {
-                messages.pop_front();
-
-                // Make sure we don't trigger a repaint for all messages when the console is full
-                for (int row = 0; row < static_cast<int>(messages.size()); row++) {
-                    messages[row]->idx--;
-                }
-            }
+            auto const row = getRowAt(e.y);
+            selectedItem = isPositiveAndBelow(row, rows.size()) ? static_cast<int64>(rows[row]) : -1;
+            repaint();
+        }
 
-            while (messages.size() < pd->getConsoleMessages().size()) {
-                messages.push_back(std::make_unique<ConsoleMessage>(messages.size(), *this));
+        // Adds the lines that came in since the last update
+        void update()
+        {
+            if (viewport.getWidth() != layoutWidth) {
+                setSize(viewport.getWidth(), getHeight());
+                layoutRows();
+            } else {
+                removeOldRows();
+                addNewRows();
             }
 
-            bool showMessages = buttons[2].getToggleState();
-            bool showErrors = buttons[3].getToggleState();
-
-            int totalHeight = 0;
-            for (int row = 0; row < static_cast<int>(pd->getConsoleMessages().size()); row++) {
-                auto [message, type, length] = pd->getConsoleMessages()[row];
-                int numLines = getNumLines(getWidth(), length);
-                int height = numLines * 22 + 2;
-
-                if (messages[row]->idx != row) {
-                    messages[row]->idx = row;
-                    messages[row]->repaint();
-                }
-
-                if ((type == 1 && !showMessages) || (length == 0 && !showErrors))
-                    continue;
+            updateSize();
+        }
 
-                totalHeight += std::max(0, height);
-            }
+        // Lays out every row again, after the filter or search changed
+        void relayout()
+        {
+            layoutRows();
+            updateSize();
+        }
 
-            setSize(viewport.getWidth(), std::max<int>(getTotalHeight(), viewport.getHeight()));
-            resized();
+        void setQuery(String const& newQuery)
+        {
+            if (newQuery.trim() == query)
+                return;
 
-            if (buttons[4].getToggleState()) {
-                viewport.setViewPositionProportionately(0.0f, 1.0f);
-            }
+            query = newQuery.trim();
+            relayout();
         }
 
         void clear()
         {
-            pd->getConsoleHistory().insert(pd->getConsoleHistory().end(), pd->getConsoleMessages().begin(), pd->getConsoleMessages().end());
-            pd->getConsoleMessages().clear();
-            update();
+            pd->getConsoleLog().clear();
+            selectedItem = -1;
+            relayout();
         }
 
         void restore()
         {
-            pd->getConsoleMessages().insert(pd->getConsoleMessages().begin(), pd->getConsoleHistory().begin(), pd->getConsoleHistory().end());
-            pd->getConsoleHistory().clear();
-            update();
+            pd->getConsoleLog().restore();
+            selectedItem = -1;
+            relayout();
         }
 
         // Get total height of messages, also taking multi-line messages into account
-        int getTotalHeight()
+        int getTotalHeight() const
         {
-            bool showMessages = buttons[2].getToggleState();
-            bool showErrors = buttons[3].getToggleState();
+            return rowPositions.back() - rowPositions.front();
+        }
+
+        int getNumRows() const
+        {
+            return static_cast<int>(rows.size());
+        }
+
+        void resized() override
+        {
+            // The number of lines per message depends on the width
+            if (getWidth() != layoutWidth)
+                layoutRows();
+        }
 
+        void paint(Graphics& g) override
+        {
+            auto const clip = g.getClipBounds();
             auto font = Font(Font::getDefaultSansSerifFontName(), 13, 0);
-            int totalHeight = 0;
+            g.setFont(font);
+
+            auto offColour = findColour(PlugDataColour::panelBackgroundOffsetColourId);
+            auto onColour = findColour(PlugDataColour::panelBackgroundColourId);
 
-            for (auto& [message, type, length] : pd->getConsoleMessages()) {
-                int numLines = getNumLines(getWidth(), length);
-                int height = numLines * 22 + 2;
+            auto& log = pd->getConsoleLog();
 
-                if ((type == 1 && !showMessages) || (length == 0 && !showErrors))
+            for (int row = std::max(0, getRowAt(clip.getY())); row < getNumRows(); row++) {
+                auto const y = getRowY(row);
+                if (y >= clip.getBottom())
+                    break;
+
+                auto const number = rows[row];
+                if (!log.contains(number))
                     continue;
 
-                totalHeight += std::max(0, height);
+                auto bounds = Rectangle<int>(0, y, getWidth(), getRowY(row + 1) - y);
+                bool isSelected = selectedItem == static_cast<int64>(number);
+
+                // Draw background
+                g.setColour(isSelected ? findColour(PlugDataColour::panelActiveBackgroundColourId) : ((row & 1) ? offColour : onColour));
+                g.fillRect(bounds);
+
+                auto const& line = log[number];
+
+                // Approximate number of lines from string length and current width
+                int numLines = getNumLines(getWidth(), line.width);
+
+                // Draw text, with the number of times it was repeated
+                auto text = line.repeats > 1 ? line.text + " x " + formatCount(line.repeats) : line.text;
+                g.setColour(isSelected ? findColour(PlugDataColour::panelActiveTextColourId) : colourWithType(*this, line.type));
+                g.drawFittedText(text, bounds.reduced(4, 0), Justification::centredLeft, numLines, 1.0f);
+            }
+        }
+
+        // Number of the selected line in the console log, or -1
+        int64 selectedItem = -1;
+
+    private:
+        // Count with thousands separators, like 1,234
+        static String formatCount(int count)
+        {
+            auto digits = String(count);
+            String result;
+
+            for (int i = 0; i < digits.length(); i++) {
+                if (i > 0 && (digits.length() - i) % 3 == 0)
+                    result << ",";
+                result << String::charToString(digits[i]);
             }
 
-            return totalHeight;
+            return result;
         }
 
-        void resized() override
+        void updateSize()
         {
-            int totalHeight = 0;
-            for (int row = 0; row < static_cast<int>(pd->getConsoleMessages().size()); row++) {
-                if (row >= messages.size())
-                    break;
+            setSize(viewport.getWidth(), std::max<int>(getTotalHeight(), viewport.getHeight()));
+            repaint();
+
+            if (buttons[4].getToggleState()) {
+                viewport.setViewPositionProportionately(0.0f, 1.0f);
+            }
+        }
+
+        // Bit 0 for messages, bit 1 for errors, like the types in the console log
+        int getTypeMask() const
+        {
+            return (buttons[3].getToggleState() ? 1 : 0) | (buttons[2].getToggleState() ? 2 : 0);
+        }
+
+        // Finds the positions of the visible messages, without measuring or painting anything
+        void layoutRows()
+        {
+            layoutWidth = getWidth();
+            rows.clear();
+            rowPositions.assign(1, 0);
+            laidOutUntil = 0;
+
+            addNewRows();
+        }
 
-                auto& [message, type, length] = pd->getConsoleMessages()[row];
+        // Adds rows for the lines that match and weren't looked at yet
+        void addNewRows()
+        {
+            auto& log = pd->getConsoleLog();
 
-                int numLines = getNumLines(getWidth(), length);
-                int height = numLines * 22 + 2;
+            found.clear();
+            log.find(laidOutUntil, getTypeMask(), query, found);
+            laidOutUntil = log.getEnd();
 
-                messages[row]->setBounds(0, totalHeight, getWidth(), height);
+            for (auto const number : found) {
+                int numLines = getNumLines(layoutWidth, log[number].width);
+                rows.push_back(number);
+                rowPositions.push_back(rowPositions.back() + std::max(0, numLines * 22 + 2));
+            }
+        }
 
-                totalHeight += height;
+        // Removes the rows of lines that the console log doesn't keep anymore
+        void removeOldRows()
+        {
+            auto const start = pd->getConsoleLog().getStart();
+            while (!rows.empty() && rows.front() < start) {
+                rows.pop_front();
+                rowPositions.pop_front();
             }
         }
 
-        int selectedItem = -1;
+        int getRowY(int row) const
+        {
+            return rowPositions[row] - rowPositions.front();
+        }
+
+        // Row at a y position, or -1 if it is above or below all rows
+        int getRowAt(int y) const
+        {
+            if (rows.empty() || y < 0 || y >= getTotalHeight())
+                return -1;
+
+            auto it = std::upper_bound(rowPositions.begin(), rowPositions.end(), y + rowPositions.front());
+            return static_cast<int>(it - rowPositions.begin()) - 1;
+        }
+
+        // Line number of every visible row, and the position of each row plus the bottom of the last one
+        // Positions don't change when old rows are removed from the front, they're relative to the first one
+        std::deque<uint64> rows;
+        std::deque<int> rowPositions = { 0 };
+        uint64 laidOutUntil = 0;
+        int layoutWidth = 0;
+
+        String query;
+        std::vector<uint64> found;
 
-    private:
-    private:
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ConsoleComponent)
     };
 
 private:
     ConsoleComponent* console;
     Viewport viewport;
+    TextEditor search;
 
     int pendingUpdates = 0;
 
@@ -0,0 +1,129 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+// Debug view of the traffic through the command queue (GUI to pd) and the message queue (pd to GUI),
+// and of the memory used by every open patch
+struct DebugPanel : public Component, public Timer {
+
+    PlugDataAudioProcessor* pd;
+    TextButton resetButton = TextButton("Reset");
+
+    // Walking the patches takes pd's lock, so memory is only measured once per second
+    static constexpr int memoryInterval = 4;
+    int memoryCountdown = 0;
+    std::vector<std::pair<String, StringArray>> memoryLines;
+
+    explicit DebugPanel(PlugDataAudioProcessor* processor)
+        : pd(processor)
+    {
+        resetButton.setConnectedEdges(12);
+        resetButton.onClick = [this]() {
+            pd->resetQueueStatistics();
+            repaint();
+        };
+        addAndMakeVisible(resetButton);
+    }
+
+    void visibilityChanged() override
+    {
+        if (isVisible()) {
+            memoryCountdown = 0;
+            timerCallback();
+            startTimerHz(4);
+        } else {
+            stopTimer();
+        }
+    }
+
+    void timerCallback() override
+    {
+        if (memoryCountdown-- <= 0) {
+            memoryCountdown = memoryInterval - 1;
+            updateMemory();
+        }
+
+        repaint();
+    }
+
+    void updateMemory()
+    {
+        auto size = [](size_t bytes) { return File::descriptionOfSizeInBytes(static_cast<int64>(bytes)); };
+
+        memoryLines.clear();
+        for (auto* patch : pd->patches) {
+            auto const usage = patch->getMemoryUsage();
+
+            StringArray lines;
+            lines.add("Total: " + size(usage.getTotal()) + " in " + String(usage.numObjects) + " objects");
+            lines.add("Objects " + size(usage.objects) + ", text " + size(usage.text));
+            lines.add("Arrays: " + size(usage.arrays) + " in " + String(usage.numArrays) + " arrays");
+            if (usage.numClones)
+                lines.add("Clones: " + size(usage.clones) + " in " + String(usage.numClones) + " copies");
+            lines.add("Undo: " + size(usage.undo) + " in " + String(usage.numUndoActions) + " actions");
+
+            memoryLines.emplace_back(patch->getTitle(), lines);
+        }
+    }
+
+    template<typename Statistics>
+    static StringArray describe(Statistics const& stats)
+    {
+        using Ring = pd::CommandQueue;
+
+        StringArray types;
+        for (uint32 type = Ring::Bang; type < Ring::NumTypes; type++) {
+            if (auto const count = stats.numEnqueued[type].load())
+                types.add(String(Ring::getTypeName(type)) + " " + String(count));
+        }
+
+        StringArray lines;
+        lines.add("Enqueued: " + String(stats.getNumEnqueued()) + (types.isEmpty() ? "" : " (" + types.joinIntoString(", ") + ")"));
+        lines.add("Drained: " + String(stats.numDequeued.load()) + " in " + String(stats.numDrains.load()) + " drains");
+        lines.add("Per drain: last " + String(stats.lastDrained.load()) + ", max " + String(stats.maxDrained.load()));
+        lines.add("Max depth: " + String(stats.maxPendingCommands.load()) + " commands, " + File::descriptionOfSizeInBytes(static_cast<int64>(stats.maxPendingBytes.load())));
+        lines.add("Max drain time: " + String(stats.maxDrainTime.load() * 1000.0f, 3) + " ms");
+
+        String slowest;
+        if (auto const numSlow = stats.numSlowCommands.load()) {
+            auto* symbol = stats.slowestCommandSymbol.load();
+            slowest = ", slowest " + String(stats.slowestCommandTime.load() * 1000.0f, 3) + " ms (" + Ring::getTypeName(stats.slowestCommandType.load()) + (symbol ? " " + String::fromUTF8(symbol->s_name) : "") + ")";
+        }
+        lines.add("Over " + String(roundToInt(Statistics::slowCommandSeconds * 1e6)) + " us: " + String(stats.numSlowCommands.load()) + slowest);
+
+        return lines;
+    }
+
+    void paint(Graphics& g) override
+    {
+        g.fillAll(findColour(PlugDataColour::panelBackgroundColourId));
+
+        auto bounds = getLocalBounds().reduced(8, 4);
+        bounds.removeFromBottom(28);
+
+        auto drawSection = [&](String const& title, StringArray const& lines) {
+            g.setColour(findColour(PlugDataColour::panelTextColourId));
+            g.setFont(Font(14, Font::bold));
+            g.drawText(title, bounds.removeFromTop(24), Justification::centredLeft);
+
+            g.setFont(Font(12));
+            for (auto const& line : lines)
+                g.drawFittedText(line, bounds.removeFromTop(18), Justification::centredLeft, 1, 0.8f);
+
+            bounds.removeFromTop(8);
+        };
+
+        drawSection("GUI to pd", describe(pd->getCommandQueueStatistics()));
+        drawSection("pd to GUI", describe(pd->getMessageQueueStatistics()));
+
+        for (auto const& [title, lines] : memoryLines)
+            drawSection(title, lines);
+    }
+
+    void resized() override
+    {
+        resetButton.setBounds(getLocalBounds().removeFromBottom(28).reduced(8, 3).removeFromRight(60));
+    }
+};
@@ -9,6 +9,8 @@
 // 2. Improve simplicity and efficiency by not using OS file icons (they look bad anyway)
 
 #include "../Utility/FileSystemWatcher.h"
+#include "../Utility/FileIndex.h"
+#include "../Utility/FileTree.h"
 
 #if JUCE_WINDOWS
 #    include <filesystem>
@@ -24,55 +26,39 @@ unsigned int WinExec(char const* lpCmdLine, unsigned int uCmdShow);
 bool wantsNativeDialog();
 
 // Base classes for communication between parent and child classes
-struct DocumentBrowserViewBase : public TreeView
-    , public DirectoryContentsDisplayComponent {
-    DocumentBrowserViewBase(DirectoryContentsList& listToShow)
-        : DirectoryContentsDisplayComponent(listToShow) {};
+struct DocumentBrowserViewBase : public TreeView {
+    virtual void fileDoubleClicked(File const& file) = 0;
+    virtual void selectionChanged() = 0;
+
+    SharedResourcePointer<FileTree> tree;
 };
 
 struct DocumentBrowserBase : public Component {
     DocumentBrowserBase(PlugDataAudioProcessor* processor)
-        : pd(processor)
-        , filter("*", "*", "All files")
-        , updateThread("browserThread")
-        , directory(&filter, updateThread) {
+        : pd(processor) {
 
         };
 
     virtual bool isSearching() = 0;
 
     PlugDataAudioProcessor* pd;
-    TimeSliceThread updateThread;
-    DirectoryContentsList directory;
-    WildcardFileFilter filter;
+    File directory;
 };
 
 //==============================================================================
-class DocumentBrowserItem : public TreeViewItem
-    , private AsyncUpdater
-    , private ChangeListener {
+// Sub items are only made for folders that are open, from the entries the tree has for them
+class DocumentBrowserItem : public TreeViewItem {
 public:
-    DocumentBrowserItem(DocumentBrowserViewBase& treeComp, DirectoryContentsList* parentContents, int indexInContents, int indexInParent, File const& f)
+    DocumentBrowserItem(DocumentBrowserViewBase& treeComp, File const& f, bool isFolder)
         : file(f)
         , owner(treeComp)
-        , parentContentsList(parentContents)
-        , indexInContentsList(indexInContents)
-        , subContentsList(nullptr, false)
+        , isDirectory(isFolder)
     {
-        DirectoryContentsList::FileInfo fileInfo;
-
-        if (parentContents != nullptr && parentContents->getFileInfo(indexInContents, fileInfo)) {
-            fileSize = File::descriptionOfSizeInBytes(fileInfo.fileSize);
-            isDirectory = fileInfo.isDirectory;
-        } else {
-            isDirectory = true;
-        }
     }
 
     ~DocumentBrowserItem() override
     {
         clearSubItems();
-        removeSubContentsList();
     }
 
     void paintOpenCloseButton(Graphics& g, Rectangle<float> const& area, Colour backgroundColour, bool isMouseOver) override
@@ -105,65 +91,50 @@ public:
 
     void itemOpennessChanged(bool isNowOpen) override
     {
-        if (isNowOpen) {
+        if (isNowOpen)
+            rebuildSubItems();
+        else
             clearSubItems();
-
-            isDirectory = file.isDirectory();
-
-            if (isDirectory) {
-                if (subContentsList == nullptr && parentContentsList != nullptr) {
-                    auto l = new DirectoryContentsList(parentContentsList->getFilter(), parentContentsList->getTimeSliceThread());
-
-                    l->setDirectory(file, parentContentsList->isFindingDirectories(), parentContentsList->isFindingFiles());
-
-                    setSubContentsList(l, true);
-                }
-
-                changeListenerCallback(nullptr);
-            }
-        }
     }
 
-    void removeSubContentsList()
+    // Matches the sub items to the entries of the folder, keeping the ones that are still there as they are
+    void rebuildSubItems()
     {
-        if (subContentsList != nullptr) {
-            subContentsList->removeChangeListener(this);
-            subContentsList.reset();
+        std::map<String, DocumentBrowserItem*> previous;
+
+        for (int i = getNumSubItems(); --i >= 0;) {
+            auto* item = static_cast<DocumentBrowserItem*>(getSubItem(i));
+            previous.emplace(item->getUniqueName(), item);
+            removeSubItem(i, false);
         }
-    }
 
-    void setSubContentsList(DirectoryContentsList* newList, bool const canDeleteList)
-    {
-        removeSubContentsList();
+        for (auto const& entry : owner.tree->getEntries(file)) {
+            auto it = previous.find(entry.file.getFullPathName());
+            if (it != previous.end() && it->second->isDirectory == entry.isDirectory) {
+                addSubItem(it->second);
+                previous.erase(it);
+            } else {
+                addSubItem(new DocumentBrowserItem(owner, entry.file, entry.isDirectory));
+            }
+        }
 
-        subContentsList = OptionalScopedPointer<DirectoryContentsList>(newList, canDeleteList);
-        newList->addChangeListener(this);
+        for (auto& [name, item] : previous)
+            delete item;
     }
 
-    void changeListenerCallback(ChangeBroadcaster*) override
+    // Rebuilds the open items that show a folder that changed, or all of them when folder is empty
+    void folderChanged(File const& folder)
     {
-        rebuildItemsFromContentList();
-    }
+        if (!isOpen())
+            return;
 
-    void rebuildItemsFromContentList()
-    {
-        clearSubItems();
+        if (folder == File() || folder == file)
+            rebuildSubItems();
 
-        if (isOpen() && subContentsList != nullptr) {
-            int idx = 0;
-            // Sort by folders first
-            for (int i = 0; i < subContentsList->getNumFiles(); ++i) {
-                if (subContentsList->getFile(i).isDirectory()) {
-                    addSubItem(new DocumentBrowserItem(owner, subContentsList, i, idx, subContentsList->getFile(i)));
-                    idx++;
-                }
-            }
-            for (int i = 0; i < subContentsList->getNumFiles(); ++i) {
-                if (subContentsList->getFile(i).existsAsFile()) {
-                    addSubItem(new DocumentBrowserItem(owner, subContentsList, i, idx, subContentsList->getFile(i)));
-                    idx++;
-                }
-            }
+        for (int i = 0; i < getNumSubItems(); ++i) {
+            auto* item = static_cast<DocumentBrowserItem*>(getSubItem(i));
+            if (item->isDirectory && (folder == File() || folder.isAChildOf(item->file) || folder == item->file))
+                item->folderChanged(folder);
         }
     }
 
@@ -203,92 +174,67 @@ public:
         if (target.isAChildOf(file)) {
             setOpen(true);
 
-            for (int maxRetries = 500; --maxRetries > 0;) {
-                for (int i = 0; i < getNumSubItems(); ++i)
-                    if (auto* f = dynamic_cast<DocumentBrowserItem*>(getSubItem(i)))
-                        if (f->selectFile(target))
-                            return true;
-
-                // if we've just opened and the contents are still loading, wait for it..
-                if (subContentsList != nullptr && subContentsList->isStillLoading()) {
-                    Thread::sleep(10);
-                    rebuildItemsFromContentList();
-                } else {
-                    break;
-                }
-            }
+            for (int i = 0; i < getNumSubItems(); ++i)
+                if (auto* f = dynamic_cast<DocumentBrowserItem*>(getSubItem(i)))
+                    if (f->selectFile(target))
+                        return true;
         }
 
         return false;
     }
 
-    void itemClicked(MouseEvent const& e) override
-    {
-        owner.sendMouseClickMessage(file, e);
-    }
-
     void itemDoubleClicked(MouseEvent const& e) override
     {
         TreeViewItem::itemDoubleClicked(e);
 
-        owner.sendDoubleClickMessage(file);
+        owner.fileDoubleClicked(file);
     }
 
     void itemSelectionChanged(bool) override
     {
-        owner.sendSelectionChangeMessage();
-    }
-
-    void handleAsyncUpdate() override
-    {
-        owner.repaint();
+        owner.selectionChanged();
     }
 
     const File file;
 
 private:
     DocumentBrowserViewBase& owner;
-    DirectoryContentsList* parentContentsList;
-    int indexInContentsList;
-    OptionalScopedPointer<DirectoryContentsList> subContentsList;
     bool isDirectory;
-    String fileSize;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DocumentBrowserItem)
 };
 
 class DocumentBrowserView : public DocumentBrowserViewBase
-    , public FileBrowserListener
+    , public FileTree::Listener
     , public ScrollBar::Listener {
 public:
     //==============================================================================
-    /** Creates a listbox to show the contents of a specified directory.
+    /** Creates a tree to show the contents of the browser's directory.
      */
-    DocumentBrowserView(DirectoryContentsList& listToShow, DocumentBrowserBase* parent)
-        : DocumentBrowserViewBase(listToShow)
-        , itemHeight(24)
+    DocumentBrowserView(DocumentBrowserBase* parent)
+        : itemHeight(24)
         , browser(parent)
     {
         setRootItemVisible(false);
-        refresh();
-        addListener(this);
+        tree->addListener(this);
         getViewport()->getVerticalScrollBar().addListener(this);
     }
 
     /** Destructor. */
     ~DocumentBrowserView() override
     {
+        tree->removeListener(this);
         deleteRootItem();
     }
 
     /** Scrolls this view to the top. */
-    void scrollToTop() override
+    void scrollToTop()
     {
         getViewport()->getVerticalScrollBar().setCurrentRangeStart(0);
     }
     /** If the specified file is in the list, it will become the only selected item
         (and if the file isn't in the list, all other items will be deselected). */
-    void setSelectedFile(File const& target) override
+    void setSelectedFile(File const& target)
     {
         if (auto* t = dynamic_cast<DocumentBrowserItem*>(getRootItem()))
             if (!t->selectFile(target))
@@ -299,7 +245,7 @@ public:
     /** Returns the number of files the user has got selected.
         @see getSelectedFile
     */
-    int getNumSelectedFiles() const override
+    int getNumSelectedFiles() const
     {
         return TreeView::getNumSelectedItems();
     }
@@ -308,7 +254,7 @@ public:
         The index should be in the range 0 to (getNumSelectedFiles() - 1).
         @see getNumSelectedFiles
     */
-    File getSelectedFile(int index = 0) const override
+    File getSelectedFile(int index = 0) const
     {
         if (auto* item = dynamic_cast<DocumentBrowserItem const*>(getSelectedItem(index)))
             return item->file;
@@ -317,13 +263,13 @@ public:
     }
 
     /** Deselects any files that are currently selected. */
-    void deselectAllFiles() override
+    void deselectAllFiles()
     {
         clearSelectedItems();
     }
 
-    /** Updates the files in the list. */
-    void refresh()
+    /** Shows the files in another folder. */
+    void setRoot(File const& folder)
     {
         // Mouse events during update can cause a crash!
         setEnabled(false);
@@ -333,15 +279,34 @@ public:
 
         deleteRootItem();
 
-        auto root = new DocumentBrowserItem(*this, nullptr, 0, 0, directoryContentsList.getDirectory());
-
-        root->setSubContentsList(&directoryContentsList, false);
+        auto root = new DocumentBrowserItem(*this, folder, true);
         setRootItem(root);
+        root->setOpen(true);
 
         setInterceptsMouseClicks(true, true);
         setEnabled(true);
     }
 
+    // Only the open folders that changed are rebuilt, the rest of the tree stays as it is
+    void treeChanged(FileSystemWatcher::FileChanges const& changes) override
+    {
+        auto* root = dynamic_cast<DocumentBrowserItem*>(getRootItem());
+        if (!root)
+            return;
+
+        if (changes.empty())
+            root->folderChanged(File());
+
+        std::set<File> folders;
+        for (auto const& [file, fsEvent] : changes)
+            folders.insert(file.getParentDirectory());
+
+        for (auto const& folder : folders)
+            root->folderChanged(folder);
+
+        repaint();
+    }
+
     void paint(Graphics& g) override
     {
         int selectedIdx = -1;
@@ -390,8 +355,6 @@ public:
     {
         browser->repaint();
     };
-    void fileClicked(File const&, MouseEvent const&) override {};
-    void browserRootChanged(File const&) override {};
 
     bool isInterestedInFileDrag(StringArray const& files) override
     {
@@ -414,11 +377,13 @@ public:
 
     void filesDropped(StringArray const& files, int x, int y) override
     {
+        FileSystemWatcher::FileChanges changes;
+
         for (auto& path : files) {
             auto file = File(path);
 
             if (file.exists() && (file.isDirectory() || file.hasFileExtension("pd"))) {
-                auto alias = browser->directory.getDirectory().getChildFile(file.getFileName());
+                auto alias = browser->directory.getChildFile(file.getFileName());
 
 #if JUCE_WINDOWS
                 if (alias.exists())
@@ -442,10 +407,11 @@ public:
 #else
                 file.createSymbolicLink(alias, true);
 #endif
+                changes.emplace(alias, FileSystemWatcher::fileCreated);
             }
         }
 
-        browser->directory.refresh();
+        tree->filesChanged(changes);
 
         isDraggingFile = false;
         repaint();
@@ -478,9 +444,23 @@ class FileSearchComponent : public Component
     , public ListBoxModel
     , public ScrollBar::Listener {
 public:
-    FileSearchComponent(DirectoryContentsList& directory)
-        : searchPath(directory)
+    FileSearchComponent()
     {
+        index.onResults = [this](Array<File> const& results) {
+            // The list was closed while we were searching
+            if (input.isEmpty())
+                return;
+
+            auto const selection = getSelection();
+
+            searchResult = results;
+            listBox.updateContent();
+
+            auto const selectedRow = searchResult.indexOf(selection);
+            listBox.selectRow(selectedRow >= 0 ? selectedRow : 0, true, true);
+            listBox.repaint();
+        };
+
         listBox.setModel(this);
         listBox.setRowHeight(24);
         listBox.setOutlineThickness(0);
@@ -595,45 +575,25 @@ public:
         searchResult.clear();
     }
 
+    // Results arrive asynchronously, from the index
     void updateResults(String query)
     {
-        clearSearchResults();
-
-        if (query.isEmpty())
-            return;
-
-        auto addFile = [this, &query](File const& file) {
-            auto fileName = file.getFileName();
-
-            if (!file.hasFileExtension("pd"))
-                return;
-
-            // Insert in front if the query matches a whole word
-            if (fileName.containsWholeWordIgnoreCase(query)) {
-                searchResult.insert(0, file);
-            }
-            // Insert in back if it contains the query
-            else if (fileName.containsIgnoreCase(query)) {
-                searchResult.add(file);
-            }
-        };
-
-        for (int i = 0; i < searchPath.getNumFiles(); i++) {
-            auto file = searchPath.getFile(i);
-
-            if (file.isDirectory()) {
-                for (auto& child : RangedDirectoryIterator(file, true)) {
-                    addFile(child.getFile());
-                }
-            } else {
-                addFile(file);
-            }
+        if (query.isEmpty()) {
+            clearSearchResults();
+            listBox.updateContent();
         }
 
-        listBox.updateContent();
+        index.search(query);
+    }
 
-        if (listBox.getSelectedRow() == -1)
-            listBox.selectRow(0, true, true);
+    void setSearchPath(File const& path)
+    {
+        index.setRoot(path);
+    }
+
+    void fileChanged(File const& file)
+    {
+        index.fileChanged(file);
     }
 
     bool hasSelection()
@@ -674,18 +634,17 @@ public:
 private:
     ListBox listBox;
 
-    DirectoryContentsList& searchPath;
+    FileIndex index = FileIndex("pd");
     Array<File> searchResult;
     TextEditor input;
     TextButton closeButton = TextButton(Icons::Clear);
 };
 
 struct DocumentBrowser : public DocumentBrowserBase
-    , public FileSystemWatcher::Listener {
+    , public FileTree::Listener {
     DocumentBrowser(PlugDataAudioProcessor* processor)
         : DocumentBrowserBase(processor)
-        , fileList(directory, this)
-        , searchComponent(directory)
+        , fileList(this)
     {
         auto location = File::getSpecialLocation(File::SpecialLocationType::userApplicationDataDirectory).getChildFile("PlugData").getChildFile("Library");
 
@@ -696,14 +655,11 @@ struct DocumentBrowser : public DocumentBrowserBase
             }
         }
 
-        watcher.addFolder(location);
-        directory.setDirectory(location, true, true);
-
-        updateThread.startThread();
+        setDirectory(location);
 
         addAndMakeVisible(fileList);
 
-        watcher.addListener(this);
+        fileList.tree->addListener(this);
 
         searchComponent.openFile = [this](File& file) {
             if (file.existsAsFile()) {
@@ -733,7 +689,7 @@ struct DocumentBrowser : public DocumentBrowserBase
         addAndMakeVisible(resetFolderButton);
 
         loadFolderButton.onClick = [this]() {
-            openChooser = std::make_unique<FileChooser>("Open...", directory.getDirectory().getFullPathName(), "", wantsNativeDialog());
+            openChooser = std::make_unique<FileChooser>("Open...", directory.getFullPathName(), "", wantsNativeDialog());
 
             openChooser->launchAsync(FileBrowserComponent::openMode | FileBrowserComponent::canSelectDirectories,
                 [this](FileChooser const& fileChooser) {
@@ -741,8 +697,7 @@ struct DocumentBrowser : public DocumentBrowserBase
                     if (file.exists()) {
                         auto path = file.getFullPathName();
                         pd->settingsTree.setProperty("BrowserPath", path, nullptr);
-                        directory.setDirectory(path, true, true);
-                        watcher.addFolder(file);
+                        setDirectory(file);
                     }
                 });
         };
@@ -751,7 +706,7 @@ struct DocumentBrowser : public DocumentBrowserBase
             auto location = File::getSpecialLocation(File::SpecialLocationType::userApplicationDataDirectory).getChildFile("PlugData").getChildFile("Library");
             auto path = location.getFullPathName();
             pd->settingsTree.setProperty("BrowserPath", path, nullptr);
-            directory.setDirectory(path, true, true);
+            setDirectory(location);
         };
 
         revealButton.onClick = [this]() {
@@ -770,14 +725,26 @@ struct DocumentBrowser : public DocumentBrowserBase
 
     ~DocumentBrowser()
     {
-        updateThread.stopThread(1000);
+        fileList.tree->removeListener(this);
     }
 
-    // Called when folder changes
-    void fsChangeCallback() override
+    void setDirectory(File const& location)
     {
-        directory.refresh();
-        fileList.refresh();
+        directory = location;
+        fileList.tree->watch(location);
+        fileList.setRoot(location);
+        searchComponent.setSearchPath(location);
+    }
+
+    // The file list updates itself, the search index is kept up to date here
+    void treeChanged(FileSystemWatcher::FileChanges const& changes) override
+    {
+        // Without knowing what changed, the search index has to start over
+        if (changes.empty())
+            searchComponent.setSearchPath(directory);
+
+        for (auto const& [file, fsEvent] : changes)
+            searchComponent.fileChanged(file);
     }
 
     bool isSearching() override
@@ -845,5 +812,4 @@ private:
 public:
     DocumentBrowserView fileList;
     FileSearchComponent searchComponent;
-    FileSystemWatcher watcher;
 };
@@ -10,6 +10,13 @@ struct Inspector : public Component {
 
     PropertiesPanel panel;
     String title;
+    float dspLoad = -1.0f;
+
+    // Name, type, category and options of the parameters the panel was built for
+    std::vector<std::tuple<String, ParameterType, ParameterCategory, std::vector<String>>> layout;
+
+    // The component of each of those parameters, in the same order
+    std::vector<PropertiesPanel::Property*> properties;
 
     Inspector()
     {
@@ -23,6 +30,12 @@ struct Inspector : public Component {
         
         g.setColour(findColour(PlugDataColour::panelTextColourId));
         g.drawText(title, getLocalBounds().removeFromTop(23), Justification::centred);
+
+        if (dspLoad >= 0.0f)
+        {
+            g.setFont(Font(12));
+            g.drawText("DSP " + String(dspLoad * 100.0f, 1) + "%", getLocalBounds().removeFromTop(23).reduced(6, 0), Justification::centredRight);
+        }
         
         g.setColour(findColour(PlugDataColour::outlineColourId));
         g.drawLine(0, 23, getWidth(), 23);
@@ -38,7 +51,16 @@ struct Inspector : public Component {
         title = name;
     }
 
-    PropertyComponent* createPanel(int type, String const& name, Value* value, int idx, std::vector<String>& options)
+    void setDSPLoad(float load)
+    {
+        if (load == dspLoad)
+            return;
+
+        dspLoad = load;
+        repaint(getLocalBounds().removeFromTop(23));
+    }
+
+    PropertiesPanel::Property* createPanel(int type, String const& name, Value* value, int idx, std::vector<String>& options)
     {
         switch (type) {
         case tString:
@@ -60,19 +82,48 @@ struct Inspector : public Component {
         }
     }
 
+    bool hasLayout(ObjectParameters const& params) const
+    {
+        if (params.size() != layout.size())
+            return false;
+
+        for (size_t i = 0; i < params.size(); i++) {
+            auto& [name, type, category, value, options] = params[i];
+            if (layout[i] != std::make_tuple(name, type, category, options))
+                return false;
+        }
+
+        return true;
+    }
+
     void loadParameters(ObjectParameters& params)
     {
+        // Selecting another object of the same kind keeps the components, they only show its values
+        if (hasLayout(params)) {
+            for (size_t i = 0; i < params.size(); i++)
+                properties[i]->referTo(*std::get<3>(params[i]));
+
+            return;
+        }
+
         StringArray names = { "General", "Appearance", "Label", "Extra" };
 
         panel.clear();
+        layout.clear();
+        properties.assign(params.size(), nullptr);
+
+        for (auto& [name, type, category, value, options] : params)
+            layout.emplace_back(name, type, category, options);
 
         for (int i = 0; i < 4; i++) {
             Array<PropertyComponent*> panels;
 
             int idx = 0;
-            for (auto& [name, type, category, value, options] : params) {
+            for (size_t p = 0; p < params.size(); p++) {
+                auto& [name, type, category, value, options] = params[p];
                 if (static_cast<int>(category) == i) {
-                    panels.add(createPanel(type, name, value, idx, options));
+                    properties[p] = createPanel(type, name, value, idx, options);
+                    panels.add(properties[p]);
                     idx++;
                 }
             }
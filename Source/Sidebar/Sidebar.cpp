@@ -15,6 +15,7 @@
 #include "Inspector.h"
 #include "DocumentBrowser.h"
 #include "AutomationPanel.h"
+#include "DebugPanel.h"
 
 Sidebar::Sidebar(PlugDataAudioProcessor* instance)
     : pd(instance)
@@ -24,11 +25,13 @@ Sidebar::Sidebar(PlugDataAudioProcessor* instance)
     inspector = new Inspector;
     browser = new DocumentBrowser(pd);
     automationPanel = new AutomationPanel(pd);
+    debugPanel = new DebugPanel(pd);
     
     addAndMakeVisible(console);
     addAndMakeVisible(inspector);
     addChildComponent(browser);
     addChildComponent(automationPanel);
+    addChildComponent(debugPanel);
     
     browser->setAlwaysOnTop(true);
     browser->addMouseListener(this, true);
@@ -62,9 +65,20 @@ Sidebar::Sidebar(PlugDataAudioProcessor* instance)
         showPanel(0);
     };
     
+    debugButton.setTooltip("Show queue and memory statistics");
+    debugButton.setConnectedEdges(12);
+    debugButton.setName("statusbar:debug");
+    debugButton.setClickingTogglesState(true);
+    debugButton.onClick = [this]()
+    {
+        showPanel(3);
+    };
+    addAndMakeVisible(debugButton);
+    
     browserButton.setRadioGroupId(1100);
     automationButton.setRadioGroupId(1100);
     consoleButton.setRadioGroupId(1100);
+    debugButton.setRadioGroupId(1100);
     
     consoleButton.setToggleState(true, dontSendNotification);
     
@@ -81,6 +95,7 @@ Sidebar::~Sidebar()
     delete inspector;
     delete browser;
     delete automationPanel;
+    delete debugPanel;
 }
 
 void Sidebar::paint(Graphics& g)
@@ -117,11 +132,12 @@ void Sidebar::resized()
     
     auto tabbarBounds = bounds.removeFromTop(28);
     
-    int buttonWidth = getWidth() / 3;
+    int buttonWidth = getWidth() / 4;
     
     consoleButton.setBounds(tabbarBounds.removeFromLeft(buttonWidth));
     browserButton.setBounds(tabbarBounds.removeFromLeft(buttonWidth));
     automationButton.setBounds(tabbarBounds.removeFromLeft(buttonWidth));
+    debugButton.setBounds(tabbarBounds.removeFromLeft(buttonWidth));
 
     browser->setBounds(bounds);
     
@@ -131,6 +147,7 @@ void Sidebar::resized()
     inspector->setBounds(bounds);
     
     automationPanel->setBounds(bounds);
+    debugPanel->setBounds(bounds);
 }
 
 void Sidebar::mouseDown(MouseEvent const& e)
@@ -178,6 +195,7 @@ void Sidebar::showPanel(int panelToShow)
 {
     bool showBrowser = panelToShow == 1;
     bool showAutomation = panelToShow == 2;
+    bool showDebug = panelToShow == 3;
     
     browser->setVisible(showBrowser);
     browser->setInterceptsMouseClicks(showBrowser, showBrowser);
@@ -185,6 +203,9 @@ void Sidebar::showPanel(int panelToShow)
     automationPanel->setVisible(showAutomation);
     automationPanel->setInterceptsMouseClicks(showAutomation, showAutomation);
     
+    debugPanel->setVisible(showDebug);
+    debugPanel->setInterceptsMouseClicks(showDebug, showDebug);
+    
 
     if(auto* editor =  dynamic_cast<PlugDataPluginEditor*>(pd->getActiveEditor())) {
         editor->toolbarButton(PlugDataPluginEditor::Pin)->setEnabled(panelToShow == 0);
@@ -198,18 +219,6 @@ bool Sidebar::isShowingBrowser()
 }
 
 
-#if PLUGDATA_STANDALONE
-void Sidebar::updateAutomationParameters()
-{
-    if (automationPanel) {
-        // Might be called from audio thread
-        MessageManager::callAsync([this]() { //automationPanel->updateParameters();
-            
-        });
-    };
-};
-#endif
-
 void Sidebar::showSidebar(bool show)
 {
     sidebarHidden = !show;
@@ -276,6 +285,11 @@ void Sidebar::hideParameters()
     console->deselect();
 }
 
+void Sidebar::showDSPLoad(float load)
+{
+    inspector->setDSPLoad(load);
+}
+
 bool Sidebar::isShowingConsole() const
 {
     return console->isVisible();
@@ -11,6 +11,7 @@ struct Console;
 struct Inspector;
 struct DocumentBrowser;
 struct AutomationPanel;
+struct DebugPanel;
 struct PlugDataAudioProcessor;
 
 namespace pd {
@@ -87,6 +88,9 @@ struct Sidebar : public Component {
     void showParameters();
     void hideParameters();
 
+    // Shows the DSP load of the selected object in the inspector, a negative load hides it
+    void showDSPLoad(float load);
+
     bool isShowingBrowser();
 
     void showPanel(int panelToShow);
@@ -99,10 +103,6 @@ struct Sidebar : public Component {
 
     void updateConsole();
 
-#if PLUGDATA_STANDALONE
-    void updateAutomationParameters();
-#endif
-
     static constexpr int dragbarWidth = 5;
 
 private:
@@ -112,11 +112,13 @@ private:
     TextButton browserButton = TextButton(Icons::Documentation);
     TextButton automationButton = TextButton(Icons::Parameters);
     TextButton consoleButton = TextButton(Icons::Console);
+    TextButton debugButton = TextButton(Icons::Info);
     
     Console* console;
     Inspector* inspector;
     DocumentBrowser* browser;
     AutomationPanel* automationPanel;
+    DebugPanel* debugPanel;
     
 
     int dragStartWidth = 0;
@@ -26,6 +26,7 @@
 #include <JuceHeader.h>
 
 #include "../PluginEditor.h"
+#include "../Pd/PdMidiBus.h"
 
 #if !JUCE_MAC
 #    define CUSTOM_SHADOW 1
@@ -102,8 +103,9 @@ public:
 #endif
         startPlaying();
 
-        if (autoOpenMidiDevices)
-            startTimer(500);
+        // Also keeps the midi ports up to date
+        timerCallback();
+        startTimer(500);
     }
 
     ~StandalonePluginHolder() override
@@ -125,6 +127,7 @@ public:
 
     virtual void deletePlugin()
     {
+        clearMidiPorts();
         stopPlaying();
         processor = nullptr;
     }
@@ -328,6 +331,11 @@ public:
 
     std::unique_ptr<AudioDeviceManager::AudioDeviceSetup> options;
     Array<MidiDeviceInfo> lastMidiDevices;
+    Array<MidiDeviceInfo> lastMidiOutputs;
+
+    // pd's midi ports in the order the system lists the devices, port 0 is the first input and the default output
+    std::vector<std::pair<String, MidiInputCallback*>> midiInputPorts;
+    OwnedArray<MidiOutput> midiOutputPorts;
 
     std::unique_ptr<FileChooser> stateFileChooser;
 
@@ -444,6 +452,11 @@ private:
 
         player.audioDeviceAboutToStart(device);
         player.setMidiOutput(deviceManager.getDefaultMidiOutput());
+
+#if JUCE_VERSION >= 0x070006
+        if (processor != nullptr)
+            processor->audioWorkgroupContextChanged(device->getWorkgroup());
+#endif
     }
 
     void audioDeviceStopped() override
@@ -456,7 +469,6 @@ private:
     void setupAudioDevices(bool enableAudioInput, String const& preferredDefaultDeviceName, AudioDeviceManager::AudioDeviceSetup const* preferredSetupOptions)
     {
         deviceManager.addAudioCallback(&maxSizeEnforcer);
-        deviceManager.addMidiInputDeviceCallback({}, &player);
 
         reloadAudioDeviceState(enableAudioInput, preferredDefaultDeviceName, preferredSetupOptions);
     }
@@ -465,7 +477,7 @@ private:
     {
         saveAudioDeviceState();
 
-        deviceManager.removeMidiInputDeviceCallback({}, &player);
+        clearMidiPorts();
         deviceManager.removeAudioCallback(&maxSizeEnforcer);
     }
 
@@ -474,16 +486,92 @@ private:
         auto newMidiDevices = MidiInput::getAvailableDevices();
 
         if (newMidiDevices != lastMidiDevices) {
-            for (auto& oldDevice : lastMidiDevices)
-                if (!newMidiDevices.contains(oldDevice))
-                    deviceManager.setMidiInputDeviceEnabled(oldDevice.identifier, false);
-
-            for (auto& newDevice : newMidiDevices)
-                if (!lastMidiDevices.contains(newDevice))
-                    deviceManager.setMidiInputDeviceEnabled(newDevice.identifier, true);
+            if (autoOpenMidiDevices) {
+                for (auto& oldDevice : lastMidiDevices)
+                    if (!newMidiDevices.contains(oldDevice))
+                        deviceManager.setMidiInputDeviceEnabled(oldDevice.identifier, false);
+
+                for (auto& newDevice : newMidiDevices)
+                    if (!lastMidiDevices.contains(newDevice))
+                        deviceManager.setMidiInputDeviceEnabled(newDevice.identifier, true);
+            }
 
             lastMidiDevices = newMidiDevices;
+            updateMidiInputPorts();
+        }
+
+        auto newMidiOutputs = MidiOutput::getAvailableDevices();
+
+        if (newMidiOutputs != lastMidiOutputs) {
+            lastMidiOutputs = newMidiOutputs;
+            updateMidiOutputPorts();
+        }
+    }
+
+    void updateMidiInputPorts()
+    {
+        for (auto& [identifier, callback] : midiInputPorts)
+            deviceManager.removeMidiInputDeviceCallback(identifier, callback);
+
+        midiInputPorts.clear();
+
+        auto* devicePorts = dynamic_cast<pd::MidiDevicePorts*>(processor.get());
+
+        for (int port = 0; port < lastMidiDevices.size(); port++) {
+            // Every port is read without a lock, which only works for one device each
+            // Devices past the last port share port 0 through the player instead
+            MidiInputCallback* callback = &player;
+            if (devicePorts && port < pd::MidiBus::maxPorts)
+                callback = devicePorts->getMidiInputPort(port);
+
+            auto const& identifier = lastMidiDevices.getReference(port).identifier;
+            deviceManager.addMidiInputDeviceCallback(identifier, callback);
+            midiInputPorts.emplace_back(identifier, callback);
+        }
+    }
+
+    void updateMidiOutputPorts()
+    {
+        auto* devicePorts = dynamic_cast<pd::MidiDevicePorts*>(processor.get());
+        if (!devicePorts)
+            return;
+
+        for (int port = 1; port < pd::MidiBus::maxPorts; port++)
+            devicePorts->setMidiOutputPort(port, nullptr);
+
+        midiOutputPorts.clear();
+
+        auto* defaultOutput = deviceManager.getDefaultMidiOutput();
+
+        for (auto& device : lastMidiOutputs) {
+            if (midiOutputPorts.size() == pd::MidiBus::maxPorts - 1)
+                break;
+
+            if (defaultOutput && device.identifier == defaultOutput->getIdentifier())
+                continue;
+
+            if (auto output = MidiOutput::openDevice(device.identifier)) {
+                devicePorts->setMidiOutputPort(midiOutputPorts.size() + 1, output.get());
+                midiOutputPorts.add(output.release());
+            }
+        }
+    }
+
+    void clearMidiPorts()
+    {
+        for (auto& [identifier, callback] : midiInputPorts)
+            deviceManager.removeMidiInputDeviceCallback(identifier, callback);
+
+        midiInputPorts.clear();
+        lastMidiDevices.clear();
+
+        if (auto* devicePorts = dynamic_cast<pd::MidiDevicePorts*>(processor.get())) {
+            for (int port = 1; port < pd::MidiBus::maxPorts; port++)
+                devicePorts->setMidiOutputPort(port, nullptr);
         }
+
+        midiOutputPorts.clear();
+        lastMidiOutputs.clear();
     }
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StandalonePluginHolder)
@@ -11,18 +11,25 @@
 #include "PluginEditor.h"
 #include "Canvas.h"
 #include "Connection.h"
+#include "Utility/Trace.h"
 
-struct LevelMeter : public Component, public Timer
+struct LevelMeter : public Component, public FrameScheduler::Client
 {
     int numChannels = 2;
     StatusbarSource& source;
+    FrameScheduler& scheduler;
 
-    explicit LevelMeter(StatusbarSource& statusbarSource) : source(statusbarSource)
+    LevelMeter(StatusbarSource& statusbarSource, FrameScheduler& frameScheduler) : source(statusbarSource), scheduler(frameScheduler)
     {
-        startTimerHz(20);
+        scheduler.addClient(this, 50);
     }
 
-    void timerCallback() override
+    ~LevelMeter() override
+    {
+        scheduler.removeClient(this);
+    }
+
+    void frameUpdate() override
     {
         if (isShowing())
         {
@@ -91,13 +98,19 @@ struct LevelMeter : public Component, public Timer
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LevelMeter)
 };
 
-struct MidiBlinker : public Component, public Timer
+struct MidiBlinker : public Component, public FrameScheduler::Client
 {
     StatusbarSource& source;
+    FrameScheduler& scheduler;
+
+    MidiBlinker(StatusbarSource& statusbarSource, FrameScheduler& frameScheduler) : source(statusbarSource), scheduler(frameScheduler)
+    {
+        scheduler.addClient(this, 200);
+    }
 
-    explicit MidiBlinker(StatusbarSource& statusbarSource) : source(statusbarSource)
+    ~MidiBlinker() override
     {
-        startTimer(200);
+        scheduler.removeClient(this);
     }
 
     void paint(Graphics& g) override
@@ -117,7 +130,7 @@ struct MidiBlinker : public Component, public Timer
         g.fillRoundedRectangle(midiOutRect, 1.0f);
     }
 
-    void timerCallback() override
+    void frameUpdate() override
     {
         if (source.midiReceived != blinkMidiIn)
         {
@@ -135,10 +148,80 @@ struct MidiBlinker : public Component, public Timer
     bool blinkMidiOut = false;
 };
 
-Statusbar::Statusbar(PlugDataAudioProcessor& processor) : pd(processor)
+// Load of the audio callback over the last interval, turns red for a while after a block overran
+struct CPUMeter : public Component, public SettableTooltipClient, public FrameScheduler::Client
 {
-    levelMeter = new LevelMeter(processor.statusbarSource);
-    midiBlinker = new MidiBlinker(processor.statusbarSource);
+    pd::AudioStats& stats;
+    FrameScheduler& scheduler;
+
+    CPUMeter(pd::AudioStats& audioStats, FrameScheduler& frameScheduler) : stats(audioStats), scheduler(frameScheduler)
+    {
+        scheduler.addClient(this, 250);
+    }
+
+    ~CPUMeter() override
+    {
+        scheduler.removeClient(this);
+    }
+
+    void paint(Graphics& g) override
+    {
+        g.setColour(overrunCountdown > 0 ? Colours::red : findColour(ComboBox::textColourId));
+        g.setFont(Font(11));
+        g.drawText("CPU " + String(roundToInt(load * 100.0f)) + "%", getLocalBounds(), Justification::centred);
+    }
+
+    void mouseDown(const MouseEvent& e) override
+    {
+        stats.reset();
+        lastXruns = 0;
+        overrunCountdown = 0;
+        frameUpdate();
+    }
+
+    void frameUpdate() override
+    {
+        auto const wasRed = overrunCountdown > 0;
+        auto const xruns = stats.getNumXruns();
+        if (xruns > lastXruns)
+        {
+            overrunCountdown = 8;
+        }
+        else if (overrunCountdown > 0)
+        {
+            overrunCountdown--;
+        }
+        lastXruns = xruns;
+
+        auto const newLoad = stats.getRecentLoad();
+        if (roundToInt(newLoad * 100.0f) != roundToInt(load * 100.0f) || wasRed != (overrunCountdown > 0))
+        {
+            load = newLoad;
+            repaint();
+        }
+
+        auto ms = [](float seconds) { return String(seconds * 1000.0f, 2) + " ms"; };
+        auto percent = [](float value) { return String(roundToInt(value * 100.0f)) + "%"; };
+
+        setTooltip("Block load: peak " + percent(stats.getRecentPeak()) + ", median " + percent(stats.getPercentile(0.5f)) + ", 99th percentile " + percent(stats.getPercentile(0.99f)) + ", max " + percent(stats.getMaxLoad()) + "\n"
+                   + String(stats.getNumXruns()) + " overruns, " + String(stats.getNumNearMisses()) + " near misses in " + String(stats.getNumBlocks()) + " blocks\n"
+                   + "Audio lock held for up to " + ms(stats.getMaxLockHold()) + ", " + String(stats.getNumLockStalls()) + " times longer than a block\n"
+                   + "Message queue took up to " + ms(stats.getMaxQueueTime()) + "\n"
+                   + "Click to reset");
+    }
+
+    float load = 0.0f;
+    int64 lastXruns = 0;
+    int overrunCountdown = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CPUMeter)
+};
+
+Statusbar::Statusbar(PlugDataAudioProcessor& processor, FrameScheduler& frameScheduler) : pd(processor), scheduler(frameScheduler)
+{
+    levelMeter = new LevelMeter(processor.statusbarSource, scheduler);
+    cpuMeter = new CPUMeter(processor.audioStats, scheduler);
+    midiBlinker = new MidiBlinker(processor.statusbarSource, scheduler);
 
     setWantsKeyboardFocus(true);
 
@@ -163,11 +246,36 @@ Statusbar::Statusbar(PlugDataAudioProcessor& processor) : pd(processor)
         menu.addItem(3, "4x");
         menu.addItem(4, "8x");
         
+        menu.addSeparator();
+        
+        // Engines get the ids after the oversampling factors
+        for (int engine = 0; engine < Oversampler::numEngines; engine++)
+        {
+            menu.addItem(engine + 5, Oversampler::getEngineName(static_cast<Oversampler::Engine>(engine)), true, engine == pd.oversamplingEngine);
+        }
+        
+        menu.addSeparator();
+        
+        // Without oversampling, pd can run at a fraction of a high host rate instead
+        std::vector<std::pair<int, String>> internalRates = { { 0, "Run at host rate" }, { 44100, "Run at 44.1/48 kHz" }, { 88200, "Run at 88.2/96 kHz" } };
+        for (int i = 0; i < static_cast<int>(internalRates.size()); i++)
+        {
+            menu.addItem(i + 20, internalRates[i].second, pd.oversampling == 0, internalRates[i].first == pd.internalRate);
+        }
+        
         auto* editor = pd.getActiveEditor();
         menu.showMenuAsync(PopupMenu::Options().withMinimumWidth(100).withMaximumNumColumns(1).withTargetComponent(&oversampleSelector).withParentComponent(editor),
-                           [this](int result)
+                           [this, internalRates](int result)
                            {
-                               if (result != 0)
+                               if (result >= 20)
+                               {
+                                   pd.setInternalRate(internalRates[result - 20].first);
+                               }
+                               else if (result >= 5)
+                               {
+                                   pd.setOversamplingEngine(result - 5);
+                               }
+                               else if (result != 0)
                                {
                                    oversampleSelector.setButtonText(String(1 << (result - 1)) + "x");
                                    pd.setOversampling(result - 1);
@@ -184,6 +292,8 @@ Statusbar::Statusbar(PlugDataAudioProcessor& processor) : pd(processor)
     zoomIn = std::make_unique<TextButton>(Icons::ZoomIn);
     zoomOut = std::make_unique<TextButton>(Icons::ZoomOut);
     presentationButton = std::make_unique<TextButton>(Icons::Presentation);
+    profilerButton = std::make_unique<TextButton>(Icons::Sine);
+    repaintButton = std::make_unique<TextButton>(Icons::Search);
     gridButton = std::make_unique<TextButton>(Icons::Grid);
     themeButton = std::make_unique<TextButton>(Icons::Theme);
     browserButton = std::make_unique<TextButton>(Icons::Documentation);
@@ -217,6 +327,40 @@ Statusbar::Statusbar(PlugDataAudioProcessor& processor) : pd(processor)
 
     addAndMakeVisible(presentationButton.get());
 
+    profilerButton->setTooltip("Show DSP load");
+    profilerButton->setClickingTogglesState(true);
+    profilerButton->setConnectedEdges(12);
+    profilerButton->setName("statusbar:profiler");
+    profilerButton->onClick = [this]()
+    {
+        pd.setDSPProfiling(profilerButton->getToggleState());
+
+        auto* editor = dynamic_cast<PlugDataPluginEditor*>(pd.getActiveEditor());
+        if (auto* cnv = editor ? editor->getCurrentCanvas() : nullptr; cnv && !profilerButton->getToggleState())
+        {
+            cnv->setDSPLoad({});
+        }
+    };
+    addAndMakeVisible(profilerButton.get());
+
+    repaintButton->setTooltip("Show repaints and paint times");
+    repaintButton->setClickingTogglesState(true);
+    repaintButton->setConnectedEdges(12);
+    repaintButton->setName("statusbar:repaints");
+    repaintButton->onClick = [this]()
+    {
+        if (auto* editor = dynamic_cast<PlugDataPluginEditor*>(pd.getActiveEditor()))
+        {
+            editor->paintProfiler.setActive(repaintButton->getToggleState());
+        }
+    };
+    addAndMakeVisible(repaintButton.get());
+
+    loadingLabel.setFont(Font(13.0f));
+    loadingLabel.setJustificationType(Justification::centredLeft);
+    loadingLabel.setInterceptsMouseClicks(false, false);
+    addChildComponent(loadingLabel);
+
     powerButton->setTooltip("Mute");
     powerButton->setClickingTogglesState(true);
     powerButton->setConnectedEdges(12);
@@ -270,6 +414,7 @@ Statusbar::Statusbar(PlugDataAudioProcessor& processor) : pd(processor)
 
     addAndMakeVisible(levelMeter);
     addAndMakeVisible(midiBlinker);
+    addAndMakeVisible(cpuMeter);
 
     levelMeter->toBehind(&volumeSlider);
 
@@ -277,13 +422,16 @@ Statusbar::Statusbar(PlugDataAudioProcessor& processor) : pd(processor)
     
     // Timer to make sure modifier keys are up-to-date...
     // Hoping to find a better solution for this
-    startTimer(150);
+    scheduler.addClient(this, 150);
 
 }
 
 Statusbar::~Statusbar()
 {
+    scheduler.removeClient(this);
+
     delete midiBlinker;
+    delete cpuMeter;
     delete levelMeter;
 }
 
@@ -300,6 +448,12 @@ void Statusbar::valueChanged(Value& v)
     }
 }
 
+void Statusbar::setLoadingProgress(float progress)
+{
+    loadingLabel.setVisible(progress >= 0.0f);
+    loadingLabel.setText("Loading... " + String(roundToInt(jlimit(0.0f, 1.0f, progress) * 100.0f)) + "%", dontSendNotification);
+}
+
 void Statusbar::paint(Graphics &g)
 {
     g.setColour(findColour(PlugDataColour::outlineColourId));
@@ -327,6 +481,15 @@ void Statusbar::resized()
     
     presentationButton->setBounds(position(getHeight()), 0, getHeight(), getHeight());
 
+    position(5);  // Seperator
+
+    profilerButton->setBounds(position(getHeight()), 0, getHeight(), getHeight());
+    repaintButton->setBounds(position(getHeight()), 0, getHeight(), getHeight());
+
+    position(5);  // Seperator
+
+    loadingLabel.setBounds(position(110), 0, 110, getHeight());
+
     pos = 0;  // reset position for elements on the left
 
     powerButton->setBounds(position(getHeight(), true), 0, getHeight(), getHeight());
@@ -334,6 +497,8 @@ void Statusbar::resized()
     int levelMeterPosition = position(100, true);
     levelMeter->setBounds(levelMeterPosition, 0, 100, getHeight());
     volumeSlider.setBounds(levelMeterPosition, 0, 100, getHeight());
+
+    cpuMeter->setBounds(position(52, true), 0, 52, getHeight());
     
     // Offset to make text look centred
     oversampleSelector.setBounds(position(getHeight(), true) + 3, 0, getHeight(), getHeight());
@@ -353,15 +518,32 @@ void Statusbar::modifierKeysChanged(const ModifierKeys& modifiers)
     commandLocked = modifiers.isCommandDown() && locked.getValue() == var(false);
 }
 
-void Statusbar::timerCallback()
+void Statusbar::frameUpdate()
 {
+    TRACE_ZONE("Statusbar::frameUpdate");
+
     modifierKeysChanged(ModifierKeys::getCurrentModifiers());
+
+    if (pd.isProfilingDSP())
+    {
+        std::unordered_map<void*, float> load;
+        pd.collectDSPLoad(load);
+
+        auto* editor = dynamic_cast<PlugDataPluginEditor*>(pd.getActiveEditor());
+        if (auto* cnv = editor ? editor->getCurrentCanvas() : nullptr)
+        {
+            cnv->setDSPLoad(load);
+        }
+    }
 }
 
 StatusbarSource::StatusbarSource()
 {
-    level[0] = 0.0f;
-    level[1] = 0.0f;
+    for (int ch = 0; ch < maxChannels; ch++)
+    {
+        level[ch] = 0.0f;
+        rms[ch] = 0.0f;
+    }
 }
 
 static bool hasRealEvents(MidiBuffer& buffer)
@@ -375,39 +557,43 @@ static bool hasRealEvents(MidiBuffer& buffer)
 void StatusbarSource::processBlock(const AudioBuffer<float>& buffer, MidiBuffer& midiIn, MidiBuffer& midiOut, int channels)
 {
     auto** channelData = buffer.getArrayOfReadPointers();
+    auto const numSamples = buffer.getNumSamples();
+
+    channels = jmin(channels, buffer.getNumChannels(), static_cast<int>(maxChannels));
 
-    if (channels == 1)
+    // The same decay per sample as before, applied once per block
+    if (numSamples != decayBlockSize)
     {
-        level[1] = 0;
+        const float decayFactor = 0.99992f;
+        decay = std::pow(decayFactor, static_cast<float>(numSamples));
+        decayBlockSize = numSamples;
     }
-    else if (channels == 0)
+
+    for (int ch = channels; ch < numChannels.load(); ch++)
     {
-        level[0] = 0;
-        level[1] = 0;
+        level[ch] = 0.0f;
+        rms[ch] = 0.0f;
+        meanSquare[ch] = 0.0f;
     }
 
-    for (int ch = 0; ch < channels; ch++)
+    for (int ch = 0; ch < channels && numSamples > 0; ch++)
     {
-        // TODO: this logic for > 2 channels makes no sense!!
-        auto localLevel = level[ch & 1].load();
+        auto const range = FloatVectorOperations::findMinAndMax(channelData[ch], numSamples);
+        auto const peak = jmax(std::abs(range.getStart()), std::abs(range.getEnd()));
 
-        for (int n = 0; n < buffer.getNumSamples(); n++)
-        {
-            float s = std::abs(channelData[ch][n]);
+        auto localLevel = jmax(peak, level[ch].load(std::memory_order_relaxed) * decay);
+        if (localLevel < 0.001f)
+            localLevel = 0.0f;
 
-            const float decayFactor = 0.99992f;
+        auto const blockRms = buffer.getRMSLevel(ch, 0, numSamples);
+        meanSquare[ch] = meanSquare[ch] * decay + blockRms * blockRms * (1.0f - decay);
 
-            if (s > localLevel)
-                localLevel = s;
-            else if (localLevel > 0.001f)
-                localLevel *= decayFactor;
-            else
-                localLevel = 0;
-        }
-
-        level[ch & 1] = localLevel;
+        level[ch].store(localLevel, std::memory_order_relaxed);
+        rms[ch].store(std::sqrt(meanSquare[ch]), std::memory_order_relaxed);
     }
 
+    numChannels = channels;
+
     auto now = Time::getCurrentTime();
 
     auto hasInEvents = hasRealEvents(midiIn);
@@ -436,5 +622,5 @@ void StatusbarSource::processBlock(const AudioBuffer<float>& buffer, MidiBuffer&
 
 void StatusbarSource::prepareToPlay(int nChannels)
 {
-    numChannels = nChannels;
+    numChannels = jmin(nChannels, static_cast<int>(maxChannels));
 }
@@ -6,15 +6,19 @@
 #pragma once
 #include <JuceHeader.h>
 
+#include "Utility/FrameScheduler.h"
+
 struct LevelMeter;
 struct MidiBlinker;
+struct CPUMeter;
 struct PlugDataAudioProcessor;
 
-struct Statusbar : public Component, public Value::Listener, public Timer
+struct Statusbar : public Component, public Value::Listener, public FrameScheduler::Client
 {
     PlugDataAudioProcessor& pd;
+    FrameScheduler& scheduler;
 
-    explicit Statusbar(PlugDataAudioProcessor& processor);
+    Statusbar(PlugDataAudioProcessor& processor, FrameScheduler& frameScheduler);
     ~Statusbar();
     
     void paint(Graphics& g) override;
@@ -25,19 +29,24 @@ struct Statusbar : public Component, public Value::Listener, public Timer
 
     void valueChanged(Value& v) override;
     
-    void timerCallback() override;
+    void frameUpdate() override;
+
+    // Shows how far a patch that's being opened is, hidden when progress is negative
+    void setLoadingProgress(float progress);
 
     bool lastLockMode = false; // For restoring lock state after presentation mode
     bool wasLocked = false; // Make sure it doesn't re-lock after unlocking (because cmd is still down)
     
     LevelMeter* levelMeter;
     MidiBlinker* midiBlinker;
+    CPUMeter* cpuMeter;
 
-    std::unique_ptr<TextButton> powerButton, lockButton, connectionStyleButton, connectionPathfind, presentationButton, zoomIn, zoomOut, gridButton, themeButton, browserButton, automationButton;
+    std::unique_ptr<TextButton> powerButton, lockButton, connectionStyleButton, connectionPathfind, presentationButton, profilerButton, repaintButton, zoomIn, zoomOut, gridButton, themeButton, browserButton, automationButton;
 
     TextButton oversampleSelector;
     
     Label zoomLabel;
+    Label loadingLabel;
 
     Slider volumeSlider;
 
@@ -57,6 +66,9 @@ struct Statusbar : public Component, public Value::Listener, public Timer
 
 struct StatusbarSource
 {
+    // Channels that are metered, any channels above this are ignored
+    static constexpr int maxChannels = 32;
+
     StatusbarSource();
 
     void processBlock(const AudioBuffer<float>& buffer, MidiBuffer& midiIn, MidiBuffer& midiOut, int outChannels);
@@ -65,9 +77,17 @@ struct StatusbarSource
 
     std::atomic<bool> midiReceived = false;
     std::atomic<bool> midiSent = false;
-    std::atomic<float> level[2] = {0};
 
-    int numChannels;
+    // Decaying peak and RMS of every output channel, written by the audio thread
+    std::atomic<float> level[maxChannels];
+    std::atomic<float> rms[maxChannels];
+
+    std::atomic<int> numChannels = 0;
+
+    // Per-block decay, recalculated when the block size changes
+    float decay = 1.0f;
+    float meanSquare[maxChannels] = {};
+    int decayBlockSize = 0;
 
     Time lastMidiIn;
     Time lastMidiOut;
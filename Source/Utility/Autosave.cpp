@@ -0,0 +1,194 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "Autosave.h"
+
+#include <string_view>
+
+#include "../PluginProcessor.h"
+
+extern "C" {
+#include <g_canvas.h>
+#include "x_libpd_mod_utils.h"
+}
+
+Autosave::Autosave(PlugDataAudioProcessor& processor)
+    : pd(processor)
+    , sessionLock(getLockName(sessionId))
+{
+    sessionDir = getAutosaveDir().getChildFile(sessionId);
+    sessionLock.enter(0);
+
+    startTimer(checkInterval);
+}
+
+Autosave::~Autosave()
+{
+    stopTimer();
+
+    // Quitting normally, so nothing needs to be recovered
+    writer.removeAllJobs(true, -1);
+    sessionDir.deleteRecursively();
+
+    sessionLock.exit();
+}
+
+File Autosave::getAutosaveDir()
+{
+    return File::getSpecialLocation(File::userApplicationDataDirectory).getChildFile("PlugData").getChildFile("Autosave");
+}
+
+String Autosave::getLockName(String const& sessionId)
+{
+    return "plugdata_autosave_" + sessionId;
+}
+
+void Autosave::timerCallback()
+{
+    auto const now = Time::getMillisecondCounterHiRes();
+
+    std::unordered_map<void*, PatchState> states;
+    std::vector<std::pair<PatchState*, pd::Patch*>> toCopy;
+
+    for (auto* patch : pd.patches) {
+        auto* cnv = patch->getPointer();
+        if (!cnv)
+            continue;
+
+        auto it = patchStates.find(cnv);
+        auto& state = states[cnv] = it != patchStates.end() ? it->second : PatchState();
+
+        if (state.file == File())
+            state.file = sessionDir.getChildFile(String(nextFileIndex++) + ".pdz");
+    }
+
+    // Checking is cheap, so all patches are checked under one acquisition of the lock
+    {
+        const pd::CallbackLock::ScopedLockType lock(*pd.getCallbackLock());
+
+        for (auto* patch : pd.patches) {
+            auto it = states.find(patch->getPointer());
+            if (it == states.end())
+                continue;
+
+            auto& state = it->second;
+
+            if (!patch->isDirty()) {
+                if (state.hasCopy)
+                    remove(state.file);
+
+                state.hasCopy = false;
+                state.settled = true;
+                continue;
+            }
+
+            auto position = libpd_undo_get_position(patch->getPointer());
+            if (position != state.undoPosition) {
+                // Still being edited, wait until it settles
+                state.undoPosition = position;
+                state.settled = false;
+            } else if (!state.settled || now - state.lastCopy > maxInterval) {
+                toCopy.emplace_back(&state, patch);
+            }
+        }
+
+        for (auto& [state, patch] : toCopy) {
+            write(state->file, patch->getCanvasBinary(), patch->getCurrentFile());
+
+            state->settled = true;
+            state->hasCopy = true;
+            state->lastCopy = now;
+        }
+    }
+
+    // Closed patches
+    for (auto& [cnv, state] : patchStates) {
+        if (!states.count(cnv) && state.hasCopy)
+            remove(state.file);
+    }
+
+    patchStates = std::move(states);
+}
+
+void Autosave::write(File const& file, MemoryBlock content, File const& location)
+{
+    writer.addJob([this, file, content = std::move(content), location]() {
+        auto hash = std::hash<std::string_view>()(std::string_view(static_cast<char const*>(content.getData()), content.getSize()));
+
+        auto& writtenHash = writtenHashes[file.getFullPathName()];
+        if (writtenHash == hash)
+            return;
+
+        file.getParentDirectory().createDirectory();
+
+        auto tempFile = file.withFileExtension("tmp");
+        {
+            FileOutputStream ostream(tempFile);
+            if (!ostream.openedOk())
+                return;
+
+            ostream.setPosition(0);
+            ostream.truncate();
+            ostream.writeString(location.getFullPathName());
+
+            GZIPCompressorOutputStream zipStream(ostream, 1);
+            zipStream.write(content.getData(), content.getSize());
+        }
+
+        // Replaces the previous copy in one go, so a crash while writing doesn't leave half a copy
+        if (tempFile.moveFileTo(file))
+            writtenHash = hash;
+    });
+}
+
+void Autosave::remove(File const& file)
+{
+    writer.addJob([this, file]() {
+        file.deleteFile();
+        writtenHashes.erase(file.getFullPathName());
+    });
+}
+
+void Autosave::recover()
+{
+    for (auto const& dir : getAutosaveDir().findChildFiles(File::findDirectories, false)) {
+        if (dir == sessionDir)
+            continue;
+
+        // Still in use by a running instance
+        InterProcessLock lock(getLockName(dir.getFileName()));
+        if (!lock.enter(0))
+            continue;
+
+        for (auto const& file : dir.findChildFiles(File::findFiles, false, "*.pdz")) {
+            FileInputStream istream(file);
+            if (!istream.openedOk())
+                continue;
+
+            auto location = File(istream.readString());
+
+            MemoryBlock content;
+            GZIPDecompressorInputStream zipStream(istream);
+            zipStream.readIntoMemoryBlock(content);
+
+            auto* patch = pd.loadPatch(content);
+            if (!patch)
+                continue;
+
+            auto name = location == File() ? String("Untitled Patcher") : location.getFileName();
+            patch->setTitle(name);
+
+            // Stays unsaved, so it's copied again until it is saved
+            auto* cnv = patch->getPointer();
+            pd.enqueueFunction([cnv]() { canvas_dirty(cnv, 1); });
+
+            pd.logMessage("Recovered unsaved changes to " + name);
+        }
+
+        dir.deleteRecursively();
+        lock.exit();
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+#include <JuceHeader.h>
+
+#include <unordered_map>
+
+class PlugDataAudioProcessor;
+
+// Keeps a copy of every patch with unsaved changes, to recover them after a crash
+//! @details The patches are checked every few seconds. Those that changed since the last check are
+//! left alone until they stop changing, then copied in pd's binary form under the audio lock.
+//! Hashing, compressing and writing the copy happen on a background thread, and copies with the same
+//! hash as the last one aren't written again. A copy is written next to the old one and moved in
+//! place, so there's always a complete copy. Copies go when their patch is saved or closed, and all
+//! of them when plugdata quits normally.
+class Autosave : private Timer {
+public:
+    explicit Autosave(PlugDataAudioProcessor& processor);
+    ~Autosave() override;
+
+    // Opens the copies left by sessions that didn't quit normally as unsaved patches
+    void recover();
+
+private:
+    void timerCallback() override;
+
+    void write(File const& file, MemoryBlock content, File const& location);
+    void remove(File const& file);
+
+    static File getAutosaveDir();
+    static String getLockName(String const& sessionId);
+
+    struct PatchState {
+        File file;
+        size_t undoPosition = 0;
+        bool settled = false;
+        bool hasCopy = false;
+        double lastCopy = 0.0;
+    };
+
+    // How often the patches are checked, a patch is copied once it didn't change for this long
+    static constexpr int checkInterval = 2000;
+
+    // Also copied this often while dirty, for changes that pd doesn't keep undo for
+    static constexpr double maxInterval = 60000.0;
+
+    PlugDataAudioProcessor& pd;
+
+    String sessionId = Uuid().toDashedString();
+    File sessionDir;
+
+    // Held while this session runs, copies in a folder whose lock can be taken are left by a crash
+    InterProcessLock sessionLock;
+
+    // Only used by the message thread
+    std::unordered_map<void*, PatchState> patchStates;
+    int nextFileIndex = 0;
+
+    // Only used by the writer thread
+    std::unordered_map<String, size_t> writtenHashes;
+
+    ThreadPool writer { 1 };
+};
@@ -1,34 +1,67 @@
 #pragma once
 #include <JuceHeader.h>
 
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+// Estimates string widths from a table of character widths
+//! @details Tables and exact widths are cached for the whole process, by typeface, style and height,
+//! so a zoomed font gets its own entry. Every instance and editor shares them, a table is only
+//! measured the first time any of them asks for that font.
 struct FastStringWidth {
 
     inline static constexpr uint64_t num_items = 1ul << (sizeof(char) * 8ul);
 
-    std::array<float, num_items> widths;
+    using Widths = std::array<float, num_items>;
+
+    std::shared_ptr<Widths const> widths;
 
-    FastStringWidth(Font font)
+    FastStringWidth(Font const& font)
+        : widths(getWidths(font))
     {
-        for (int i = 0; i < num_items; i++) {
-            widths[i] = font.getStringWidth(String(std::string(1, (char)i)));
-        }
     }
 
-    float getStringWidth(String text) const
+    float getStringWidth(String const& text) const
     {
         float totalWidth = 0.0f;
 
         auto* utf8 = text.toRawUTF8();
         auto numBytes = text.getNumBytesAsUTF8();
 
+        // Bytes of multibyte characters are above 127, they'd be negative as char
         for (int i = 0; i < numBytes; i++) {
-            totalWidth += widths[(int)utf8[i]];
+            totalWidth += (*widths)[static_cast<uint8>(utf8[i])];
         }
 
         // In real text, letters are slightly closer together
         return totalWidth * 0.8f;
     }
 
+    // Exact width of text, like Font::getStringWidthFloat, for text that gets measured over and over
+    static float getExactStringWidth(Font const& font, String const& text)
+    {
+        auto& cache = getCache();
+        auto key = getKey(font) + "\n" + text;
+
+        {
+            ScopedLock lock(cache.lock);
+            if (auto it = cache.exactWidths.find(key); it != cache.exactWidths.end())
+                return it->second;
+        }
+
+        auto width = font.getStringWidthFloat(text);
+
+        ScopedLock lock(cache.lock);
+
+        // Whatever is still used gets measured again after this
+        if (cache.exactWidths.size() >= maxExactWidths)
+            cache.exactWidths.clear();
+
+        cache.exactWidths.emplace(std::move(key), width);
+        return width;
+    }
+
     /*
     // some tests
     const String testString = "The quick brown fox jumps over the lazy dog";
@@ -36,4 +69,43 @@ struct FastStringWidth {
         std::cout << "accuracy:" << getStringWidth(testString) / font.getStringWidthFloat(testString) << std::endl;
 
     } */
+
+private:
+    inline static constexpr size_t maxExactWidths = 8192;
+
+    struct Cache {
+        CriticalSection lock;
+        std::map<String, std::shared_ptr<Widths const>> tables;
+        std::unordered_map<String, float> exactWidths;
+    };
+
+    static Cache& getCache()
+    {
+        static Cache cache;
+        return cache;
+    }
+
+    static String getKey(Font const& font)
+    {
+        return font.getTypefaceName() + "/" + font.getTypefaceStyle() + "/" + String(font.getHeight()) + "/" + String(font.getHorizontalScale());
+    }
+
+    static std::shared_ptr<Widths const> getWidths(Font const& font)
+    {
+        auto& cache = getCache();
+        auto key = getKey(font);
+
+        ScopedLock lock(cache.lock);
+
+        auto& table = cache.tables[key];
+        if (!table) {
+            auto widths = std::make_shared<Widths>();
+            for (int i = 0; i < num_items; i++) {
+                (*widths)[i] = font.getStringWidth(String(std::string(1, (char)i)));
+            }
+            table = std::move(widths);
+        }
+
+        return table;
+    }
 };
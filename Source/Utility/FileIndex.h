@@ -0,0 +1,339 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+#include <JuceHeader.h>
+
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+// Names of all files below a folder, searchable while typing
+//! @details The folder is scanned on a background thread. Every file name is split into trigrams,
+//! and every trigram keeps the list of files whose name contains it, so a query only looks at the
+//! files that have its rarest trigram. Folders that changed are rescanned without walking the rest.
+//! Searches run on the same thread and every new query cancels the previous one. While the first
+//! scan is still running, the results are updated whenever another batch of files was indexed.
+class FileIndex : private Thread
+    , private AsyncUpdater {
+public:
+    explicit FileIndex(String fileExtension)
+        : Thread("File index")
+        , extension(std::move(fileExtension))
+    {
+    }
+
+    ~FileIndex() override
+    {
+        cancelPendingUpdate();
+        stopThread(-1);
+    }
+
+    // Indexes everything below root, forgetting what was indexed before
+    void setRoot(File const& root)
+    {
+        {
+            ScopedLock const lock(inboxLock);
+            pendingRoot = root;
+            hasPendingRoot = true;
+            dirtyFolders.clear();
+        }
+
+        wake();
+    }
+
+    // Rescans the folder a file that changed is in
+    void fileChanged(File const& file)
+    {
+        {
+            ScopedLock const lock(inboxLock);
+            dirtyFolders.insert(file.getParentDirectory().getFullPathName());
+        }
+
+        wake();
+    }
+
+    // Results are passed to onResults on the message thread, possibly several times for the same query
+    void search(String const& query)
+    {
+        {
+            ScopedLock const lock(inboxLock);
+            pendingQuery = query.toLowerCase();
+            searchGeneration++;
+        }
+
+        wake();
+    }
+
+    std::function<void(Array<File> const&)> onResults;
+
+private:
+    struct Entry {
+        File file;
+        String name;
+    };
+
+    // Files that are scanned before the results are updated, during the first scan
+    static constexpr int batchSize = 2000;
+
+    // Folders can link to their parents, don't follow those forever
+    static constexpr int maxDepth = 16;
+
+    void wake()
+    {
+        if (!isThreadRunning())
+            startThread(3);
+
+        notify();
+    }
+
+    void run() override
+    {
+        while (!threadShouldExit()) {
+            File newRoot;
+            bool rootChanged;
+            std::set<String> folders;
+
+            {
+                ScopedLock const lock(inboxLock);
+                rootChanged = std::exchange(hasPendingRoot, false);
+                newRoot = pendingRoot;
+                std::swap(folders, dirtyFolders);
+            }
+
+            if (rootChanged) {
+                root = newRoot;
+                entries.clear();
+                knownFolders.clear();
+                scan(root, true);
+                indexChanged = true;
+            }
+
+            for (auto const& folder : folders)
+                rescan(File(folder));
+
+            if (indexChanged) {
+                rebuildTrigrams();
+                indexChanged = false;
+                searchedGeneration = -1;
+            }
+
+            if (searchedGeneration != searchGeneration.load())
+                runSearch();
+
+            wait(-1);
+        }
+    }
+
+    bool shouldStopScanning()
+    {
+        ScopedLock const lock(inboxLock);
+        return threadShouldExit() || hasPendingRoot;
+    }
+
+    void scan(File const& folder, bool isFirstScan, int depth = 0)
+    {
+        if (!folder.isDirectory() || depth > maxDepth)
+            return;
+
+        knownFolders.insert(folder.getFullPathName());
+
+        auto children = folder.findChildFiles(File::findFilesAndDirectories | File::ignoreHiddenFiles, false);
+        for (auto const& child : children) {
+            if (shouldStopScanning())
+                return;
+
+            if (child.isDirectory()) {
+                scan(child, isFirstScan, depth + 1);
+            } else if (child.hasFileExtension(extension)) {
+                entries.push_back({ child, child.getFileName().toLowerCase() });
+
+                // Show what we found so far, the first scan of a big library takes a while
+                if (isFirstScan && entries.size() % batchSize == 0) {
+                    rebuildTrigrams();
+                    runSearch();
+                }
+            }
+        }
+    }
+
+    void rescan(File const& folder)
+    {
+        auto const path = folder.getFullPathName();
+
+        // Only folders we already know, new ones are found when their parent is rescanned
+        if (!knownFolders.count(path))
+            return;
+
+        // Everything directly in this folder, and every subfolder that isn't there anymore
+        auto isGone = [&](String const& parent) {
+            return parent == path || (!File(parent).isDirectory() && parent.startsWith(path + File::getSeparatorString()));
+        };
+
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [&](Entry const& entry) {
+            return isGone(entry.file.getParentDirectory().getFullPathName());
+        }),
+            entries.end());
+
+        for (auto it = knownFolders.begin(); it != knownFolders.end();) {
+            if (*it != path && isGone(*it))
+                it = knownFolders.erase(it);
+            else
+                ++it;
+        }
+
+        if (!folder.isDirectory()) {
+            knownFolders.erase(path);
+            indexChanged = true;
+            return;
+        }
+
+        for (auto const& child : folder.findChildFiles(File::findFilesAndDirectories | File::ignoreHiddenFiles, false)) {
+            if (child.isDirectory()) {
+                if (!knownFolders.count(child.getFullPathName()))
+                    scan(child, false);
+            } else if (child.hasFileExtension(extension)) {
+                entries.push_back({ child, child.getFileName().toLowerCase() });
+            }
+        }
+
+        indexChanged = true;
+    }
+
+    static uint64 trigramKey(String::CharPointerType text)
+    {
+        auto const a = static_cast<uint64>(text.getAndAdvance());
+        auto const b = static_cast<uint64>(text.getAndAdvance());
+        auto const c = static_cast<uint64>(*text);
+        return (a << 42) | (b << 21) | c;
+    }
+
+    template<typename Callback>
+    static void forEachTrigram(String const& text, Callback&& callback)
+    {
+        auto const numTrigrams = text.length() - 2;
+        auto ptr = text.getCharPointer();
+
+        for (int i = 0; i < numTrigrams; i++) {
+            callback(trigramKey(ptr));
+            ++ptr;
+        }
+    }
+
+    void rebuildTrigrams()
+    {
+        trigrams.clear();
+
+        for (int i = 0; i < static_cast<int>(entries.size()); i++) {
+            forEachTrigram(entries[i].name, [&](uint64 key) {
+                auto& files = trigrams[key];
+
+                // The same trigram can appear more than once in a name
+                if (files.empty() || files.back() != i)
+                    files.push_back(i);
+            });
+        }
+    }
+
+    void runSearch()
+    {
+        String query;
+        int generation;
+
+        {
+            ScopedLock const lock(inboxLock);
+            query = pendingQuery;
+            generation = searchGeneration;
+        }
+
+        Array<File> found;
+
+        if (query.isNotEmpty()) {
+            auto check = [&](Entry const& entry) {
+                if (!entry.name.contains(query))
+                    return;
+
+                // Whole word matches come first
+                if (entry.name.containsWholeWord(query))
+                    found.insert(0, entry.file);
+                else
+                    found.add(entry.file);
+            };
+
+            if (query.length() < 3) {
+                for (int i = 0; i < static_cast<int>(entries.size()); i++) {
+                    if ((i & 1023) == 0 && generation != searchGeneration.load())
+                        return;
+
+                    check(entries[i]);
+                }
+            } else {
+                // Every match contains all trigrams of the query, so the rarest one narrows it down the most
+                std::vector<int> const* candidates = nullptr;
+                bool missing = false;
+
+                forEachTrigram(query, [&](uint64 key) {
+                    auto it = trigrams.find(key);
+                    if (it == trigrams.end())
+                        missing = true;
+                    else if (!candidates || it->second.size() < candidates->size())
+                        candidates = &it->second;
+                });
+
+                if (!missing && candidates) {
+                    for (size_t i = 0; i < candidates->size(); i++) {
+                        if ((i & 1023) == 0 && generation != searchGeneration.load())
+                            return;
+
+                        check(entries[(*candidates)[i]]);
+                    }
+                }
+            }
+        }
+
+        searchedGeneration = generation;
+
+        {
+            ScopedLock const lock(resultsLock);
+            results = std::move(found);
+        }
+
+        triggerAsyncUpdate();
+    }
+
+    void handleAsyncUpdate() override
+    {
+        Array<File> latest;
+
+        {
+            ScopedLock const lock(resultsLock);
+            latest = results;
+        }
+
+        if (onResults)
+            onResults(latest);
+    }
+
+    String const extension;
+
+    CriticalSection inboxLock;
+    File pendingRoot;
+    bool hasPendingRoot = false;
+    std::set<String> dirtyFolders;
+    String pendingQuery;
+    std::atomic<int> searchGeneration = 0;
+
+    // Only used by the index thread
+    File root;
+    std::vector<Entry> entries;
+    std::set<String> knownFolders;
+    std::unordered_map<uint64, std::vector<int>> trigrams;
+    bool indexChanged = false;
+    int searchedGeneration = -1;
+
+    CriticalSection resultsLock;
+    Array<File> results;
+};
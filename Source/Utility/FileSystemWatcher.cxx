@@ -165,14 +165,19 @@ public:
                 iNotifyEvent = (const struct inotify_event*)ptr;
                 Event e;
 
-                e.file = File {folder.getFullPathName() + '/' + iNotifyEvent->name};
-
-                     if (iNotifyEvent->mask & IN_CREATE)      e.fsEvent = FileSystemEvent::fileCreated;
-                else if (iNotifyEvent->mask & IN_CLOSE_WRITE) e.fsEvent = FileSystemEvent::fileUpdated;
-                else if (iNotifyEvent->mask & IN_MOVED_FROM)  e.fsEvent = FileSystemEvent::fileRenamedOldName;
-                else if (iNotifyEvent->mask & IN_MOVED_TO)    e.fsEvent = FileSystemEvent::fileRenamedNewName;
-                else if (iNotifyEvent->mask & IN_DELETE)      e.fsEvent = FileSystemEvent::fileDeleted;
-
+                // Events about the watched folder itself come without a name
+                e.file = iNotifyEvent->len > 0 ? File {folder.getFullPathName() + '/' + iNotifyEvent->name} : folder;
+
+                     if (iNotifyEvent->mask & IN_CREATE)                      e.fsEvent = FileSystemEvent::fileCreated;
+                else if (iNotifyEvent->mask & (IN_MODIFY | IN_ATTRIB))        e.fsEvent = FileSystemEvent::fileUpdated;
+                else if (iNotifyEvent->mask & IN_MOVED_FROM)                  e.fsEvent = FileSystemEvent::fileRenamedOldName;
+                else if (iNotifyEvent->mask & IN_MOVED_TO)                    e.fsEvent = FileSystemEvent::fileRenamedNewName;
+                else if (iNotifyEvent->mask & (IN_DELETE | IN_DELETE_SELF))   e.fsEvent = FileSystemEvent::fileDeleted;
+                else if (iNotifyEvent->mask & IN_MOVE_SELF)                   e.fsEvent = FileSystemEvent::fileRenamedOldName;
+                else continue;
+
+                // The events are handed to the message thread under this lock
+                ScopedLock sl (lock);
 
                 bool duplicateEvent = false;
                 for (auto existing : events)
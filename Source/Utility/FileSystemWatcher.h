@@ -53,6 +53,9 @@ public:
         fileRenamedNewName
     };
 
+    /** The last event of every file that changed */
+    using FileChanges = std::map<File, FileSystemEvent>;
+
     //==============================================================================
     /** Receives callbacks from the FileSystemWatcher when a file changes */
     class Listener : public Timer {
@@ -61,11 +64,30 @@ public:
 
         virtual void fsChangeCallback() = 0;
 
+        /* Called with every file that changed since the last callback, where all events
+           for the same file were merged into one. An empty set means that something
+           changed, but the backend couldn't tell what. Events that cancel each other
+           out, like a file that was created and deleted again, don't cause a callback
+           at all. By default this just calls
+           fsChangeCallback, override it to only update what changed */
+        virtual void fsFilesChanged(FileChanges const& changes)
+        {
+            ignoreUnused(changes);
+            fsChangeCallback();
+        }
+
         // group changes together
         void timerCallback()
         {
-            fsChangeCallback();
             stopTimer();
+
+            auto changes = std::exchange(pendingChanges, {});
+
+            // Only an empty set without any file events is an unknown change, otherwise they cancelled out
+            if (std::exchange(hadFileEvents, false) && changes.empty())
+                return;
+
+            fsFilesChanged(changes);
         }
         /* Called when any file in the listened to folder changes with the name of
            the folder that has changed. For example, use this for a file browser that
@@ -77,10 +99,39 @@ public:
 
         /* Called for each file that has changed and how it has changed. Use this callback
            if you need to reload a file when it's contents change */
-        void fileChanged(const File, FileSystemEvent)
+        void fileChanged(const File file, FileSystemEvent fsEvent)
         {
+            hadFileEvents = true;
+
+            auto it = pendingChanges.find(file);
+
+            if (it == pendingChanges.end()) {
+                pendingChanges.emplace(file, fsEvent);
+            } else {
+                auto const wasCreated = it->second == fileCreated || it->second == fileRenamedNewName;
+                auto const wasDeleted = it->second == fileDeleted || it->second == fileRenamedOldName;
+                auto const isCreated = fsEvent == fileCreated || fsEvent == fileRenamedNewName;
+                auto const isDeleted = fsEvent == fileDeleted || fsEvent == fileRenamedOldName;
+
+                // A file that came and went again never changed as far as the listener knows
+                if (wasCreated && isDeleted)
+                    pendingChanges.erase(it);
+                // Writing to a new file doesn't make it less new
+                else if (wasCreated && fsEvent == fileUpdated)
+                    return;
+                // Deleted and created again, like editors that save by replacing the file
+                else if (wasDeleted && isCreated)
+                    it->second = fileUpdated;
+                else
+                    it->second = fsEvent;
+            }
+
             startTimer(200);
         }
+
+    private:
+        FileChanges pendingChanges;
+        bool hadFileEvents = false;
     };
 
     /** Registers a listener to be told when things happen to the text.
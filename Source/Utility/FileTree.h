@@ -0,0 +1,151 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "FileSystemWatcher.h"
+
+// The folders that the document browsers show, shared by every browser in the process
+//! @details Use it through a SharedResourcePointer. A folder is listed the first time its entries are asked for
+//! and kept until it changes, so opening a folder again, or in another instance, doesn't touch the disk. The
+//! roots are watched, and a change only relists the folder it happened in, forgetting the folders below it that
+//! are gone. Listeners hear about changes once the tree is up to date. Only used from the message thread.
+class FileTree : private FileSystemWatcher::Listener {
+public:
+    struct Entry {
+        File file;
+        bool isDirectory;
+    };
+
+    struct Listener {
+        virtual ~Listener() = default;
+
+        // Called with the files that changed, like FileSystemWatcher::Listener::fsFilesChanged
+        virtual void treeChanged(FileSystemWatcher::FileChanges const& changes) = 0;
+    };
+
+    FileTree()
+    {
+        watcher.addListener(this);
+    }
+
+    ~FileTree() override
+    {
+        watcher.removeListener(this);
+    }
+
+    // Folders first, then files, both by name
+    std::vector<Entry> const& getEntries(File const& folder)
+    {
+        auto const path = folder.getFullPathName();
+        auto it = folders.find(path);
+        if (it == folders.end())
+            it = folders.emplace(path, list(folder)).first;
+
+        return it->second;
+    }
+
+    // Watches root for changes, if it isn't yet
+    void watch(File const& root)
+    {
+        if (!watcher.getWatchedFolders().contains(root))
+            watcher.addFolder(root);
+    }
+
+    // Updates the tree for files that changed without the watchers knowing, like the ones made by the browser itself
+    void filesChanged(FileSystemWatcher::FileChanges const& changes)
+    {
+        fsFilesChanged(changes);
+    }
+
+    void addListener(Listener* listener)
+    {
+        listeners.add(listener);
+    }
+
+    void removeListener(Listener* listener)
+    {
+        listeners.remove(listener);
+    }
+
+private:
+    static std::vector<Entry> list(File const& folder)
+    {
+        std::vector<Entry> entries;
+
+        for (auto const& child : RangedDirectoryIterator(folder, false, "*", File::findFilesAndDirectories | File::ignoreHiddenFiles))
+            entries.push_back({ child.getFile(), child.isDirectory() });
+
+        std::sort(entries.begin(), entries.end(), [](Entry const& a, Entry const& b) {
+            if (a.isDirectory != b.isDirectory)
+                return a.isDirectory;
+
+            return a.file.getFileName().compareNatural(b.file.getFileName()) < 0;
+        });
+
+        return entries;
+    }
+
+    // Lists a folder again, or forgets it and the folders below it when it's gone
+    void relist(String const& path)
+    {
+        auto it = folders.find(path);
+        if (it == folders.end())
+            return;
+
+        auto const folder = File(path);
+        if (folder.isDirectory()) {
+            it->second = list(folder);
+            return;
+        }
+
+        auto const below = path + File::getSeparatorString();
+        for (it = folders.begin(); it != folders.end();) {
+            if (it->first == path || it->first.startsWith(below))
+                it = folders.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    void fsChangeCallback() override
+    {
+        fsFilesChanged({});
+    }
+
+    void fsFilesChanged(FileSystemWatcher::FileChanges const& changes) override
+    {
+        std::set<String> changed;
+
+        // Without knowing what changed, everything that was listed is listed again
+        if (changes.empty()) {
+            for (auto const& [path, entries] : folders)
+                changed.insert(path);
+        }
+
+        for (auto const& [file, fsEvent] : changes) {
+            changed.insert(file.getFullPathName());
+            changed.insert(file.getParentDirectory().getFullPathName());
+        }
+
+        for (auto const& path : changed)
+            relist(path);
+
+        listeners.call([&changes](Listener& l) { l.treeChanged(changes); });
+    }
+
+    std::unordered_map<String, std::vector<Entry>> folders;
+    FileSystemWatcher watcher;
+    ListenerList<Listener> listeners;
+
+    JUCE_DECLARE_NON_COPYABLE(FileTree)
+};
@@ -0,0 +1,97 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+#include <JuceHeader.h>
+
+// Extracts parts of the zipped filesystem that is embedded in the binary, writing only what changed
+//! @details Every folder that is extracted gets a manifest with a stamp of the names, sizes and times
+//! of the zip entries it came from. If the stamp still matches the embedded zip, nothing but the
+//! manifest is read from disk. Otherwise, only the files that are missing, or whose size or time
+//! differ from their entry, are written, so that upgrading or repairing an install doesn't unpack
+//! everything again. Extractions are serialised within the process, so plugin
+//! instances that start at the same time don't write the same files.
+class FilesystemExtractor {
+public:
+    FilesystemExtractor(void const* data, size_t size)
+        : stream(data, size, false)
+        , zip(stream)
+    {
+    }
+
+    // Extracts all entries below prefix into target, returns the number of files that were written
+    int extract(String const& prefix, File const& target, std::function<bool()> const& shouldExit = nullptr)
+    {
+        auto const manifestFile = target.getChildFile(manifestName);
+
+        Array<int> entries;
+        uint64 stamp = 0;
+
+        for (int i = 0; i < zip.getNumEntries(); i++) {
+            auto const* entry = zip.getEntry(i);
+            if (!entry->filename.startsWith(prefix) || entry->filename.endsWithChar('/'))
+                continue;
+
+            entries.add(i);
+            stamp = stamp * 31 + static_cast<uint64>(entry->filename.hashCode64()) + static_cast<uint64>(entry->uncompressedSize) * 7 + static_cast<uint64>(entry->fileTime.toMilliseconds());
+        }
+
+        auto const stampString = String::toHexString(static_cast<int64>(stamp));
+
+        auto const isUpToDate = [&]() {
+            return target.isDirectory() && manifestFile.loadFileAsString().trim() == stampString;
+        };
+
+        if (isUpToDate())
+            return 0;
+
+        // Another instance may have extracted it while we were waiting
+        static CriticalSection extractionLock;
+        ScopedLock const lock(extractionLock);
+
+        if (isUpToDate())
+            return 0;
+
+        int numWritten = 0;
+
+        for (auto i : entries) {
+            // The stamp isn't updated, so the next run continues where this one stopped
+            if (shouldExit && shouldExit())
+                return numWritten;
+
+            auto const* entry = zip.getEntry(i);
+            auto const file = target.getChildFile(entry->filename.substring(prefix.length()));
+
+            // Files are written with the time of their entry, anything else was changed or is outdated
+            if (!file.existsAsFile() || file.getSize() != static_cast<int64>(entry->uncompressedSize) || file.getLastModificationTime() != entry->fileTime) {
+                std::unique_ptr<InputStream> input(zip.createStreamForEntry(i));
+                if (!input || !file.getParentDirectory().createDirectory())
+                    continue;
+
+                {
+                    FileOutputStream output(file);
+                    if (!output.openedOk() || !output.setPosition(0) || !output.truncate())
+                        continue;
+
+                    output.writeFromInputStream(*input, -1);
+                }
+
+                // Only after closing it, so writing can't touch the time again
+                file.setLastModificationTime(entry->fileTime);
+                numWritten++;
+            }
+        }
+
+        manifestFile.replaceWithText(stampString);
+        return numWritten;
+    }
+
+private:
+    static constexpr char const* manifestName = ".manifest";
+
+    MemoryInputStream stream;
+    ZipFile zip;
+};
@@ -0,0 +1,67 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+#include <JuceHeader.h>
+
+#include "PowerSource.h"
+
+// What the editors of the process have in common when they choose their frame rate, see FrameScheduler
+//! @details Use it through a SharedResourcePointer. Any mouse event on one of our windows counts as
+//! interaction, the power source is checked every few seconds. Only used from the message thread.
+class FrameRateGovernor : private MouseListener
+    , private Timer {
+public:
+    // The editors stay at their full rate for this long after the last mouse event, in ms
+    static constexpr double interactionTimeout = 3000.0;
+
+    static constexpr int powerSourceInterval = 10000;
+
+    FrameRateGovernor()
+    {
+        Desktop::getInstance().addGlobalMouseListener(this);
+        onBattery = PowerSource::isOnBattery();
+        startTimer(powerSourceInterval);
+    }
+
+    ~FrameRateGovernor() override
+    {
+        Desktop::getInstance().removeGlobalMouseListener(this);
+    }
+
+    bool isInteracting() const
+    {
+        return Time::getMillisecondCounterHiRes() - lastInteraction < interactionTimeout;
+    }
+
+    bool isOnBattery() const
+    {
+        return onBattery;
+    }
+
+private:
+    void interacted()
+    {
+        lastInteraction = Time::getMillisecondCounterHiRes();
+    }
+
+    void mouseMove(MouseEvent const&) override { interacted(); }
+    void mouseDown(MouseEvent const&) override { interacted(); }
+    void mouseDrag(MouseEvent const&) override { interacted(); }
+    void mouseWheelMove(MouseEvent const&, MouseWheelDetails const&) override { interacted(); }
+    void mouseMagnify(MouseEvent const&, float) override { interacted(); }
+
+    void timerCallback() override
+    {
+        onBattery = PowerSource::isOnBattery();
+    }
+
+    // Starts out as interacting, so the first editor opens at full rate
+    double lastInteraction = Time::getMillisecondCounterHiRes();
+    bool onBattery = false;
+
+    JUCE_DECLARE_NON_COPYABLE(FrameRateGovernor)
+};
@@ -0,0 +1,205 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "../Pd/PdAudioStats.h"
+#include "FrameRateGovernor.h"
+
+// One timer for the periodic updates of the editor's components
+//! @details Only used from the message thread. Clients register with the rate they want to be
+//! updated at, the scheduler ticks at the display rate and updates the clients that are due.
+//! Clients that read pd's state do so in readAudioState(), which is called for all of them in
+//! one go under a single acquisition of the audio lock. frameUpdate() follows without the lock.
+//! No frames are updated while isPaused returns true, the clients catch up on the next frame after.
+//! The frame rate is lowered while the editor is hidden or minimised, while plugdata isn't the
+//! foreground process, on battery, and for a while after the audio callback got close to its
+//! deadline. Interaction brings it back to full rate, unless the editor is hidden. Clients keep
+//! their intervals, they're just updated on the nearest frame.
+class FrameScheduler : private Timer {
+public:
+    static constexpr int framesPerSecond = 60;
+
+    // Lowered frame rates, the lowest one that applies is used
+    static constexpr int batteryFramesPerSecond = 30;
+    static constexpr int audioPressureFramesPerSecond = 20;
+    static constexpr int backgroundFramesPerSecond = 15;
+    static constexpr int hiddenFramesPerSecond = 4;
+
+    // How long the rate stays down after a near miss or overrun of the audio callback, in ms
+    static constexpr double audioPressureHold = 3000.0;
+
+    class Client {
+    public:
+        virtual ~Client() = default;
+
+        // Called with the audio lock held, only copy what's needed and return
+        virtual void readAudioState() {};
+
+        // Called after the audio state of every due client was read
+        virtual void frameUpdate() = 0;
+    };
+
+    FrameScheduler(Component const& editorComponent, pd::CallbackLock const* audioLock, pd::AudioStats const& audioStats, std::function<bool()> isPausedCallback)
+        : editor(editorComponent)
+        , lock(audioLock)
+        , stats(audioStats)
+        , isPaused(std::move(isPausedCallback))
+    {
+    }
+
+    ~FrameScheduler() override
+    {
+        stopTimer();
+    }
+
+    // Adds the client, or changes its interval when it's already registered
+    // An interval of 0 updates it every frame
+    void addClient(Client* client, int intervalMs, bool readsAudioState = false)
+    {
+        auto now = Time::getMillisecondCounterHiRes();
+
+        for (auto& entry : clients) {
+            if (entry.client == client) {
+                entry.nextDue += intervalMs - entry.interval;
+                entry.interval = intervalMs;
+                entry.readsAudioState = readsAudioState;
+                return;
+            }
+        }
+
+        clients.push_back({ client, intervalMs, now + intervalMs, readsAudioState });
+
+        if (!isTimerRunning())
+            startTimerHz(frameRate);
+    }
+
+    void removeClient(Client* client)
+    {
+        clients.erase(std::remove_if(clients.begin(), clients.end(), [client](auto const& entry) { return entry.client == client; }), clients.end());
+
+        // It might be removed by an update earlier in the same frame
+        for (auto& dueClient : due) {
+            if (dueClient.client == client)
+                dueClient.client = nullptr;
+        }
+
+        if (clients.empty())
+            stopTimer();
+    }
+
+    // Called when the frame rate changed, for updates that don't go through the scheduler
+    std::function<void(int)> onFrameRateChange;
+
+private:
+    struct Entry {
+        Client* client;
+        int interval;
+        double nextDue;
+        bool readsAudioState;
+    };
+
+    int chooseFrameRate(double now) const
+    {
+        if (!editor.isShowing())
+            return hiddenFramesPerSecond;
+
+        if (governor->isInteracting())
+            return framesPerSecond;
+
+        auto rate = framesPerSecond;
+        if (now < audioPressureUntil)
+            rate = std::min(rate, audioPressureFramesPerSecond);
+        if (!Process::isForegroundProcess())
+            rate = std::min(rate, backgroundFramesPerSecond);
+        if (governor->isOnBattery())
+            rate = std::min(rate, batteryFramesPerSecond);
+
+        return rate;
+    }
+
+    void updateFrameRate(double now)
+    {
+        // The counts also go down when the stats are reset
+        auto const misses = stats.getNumNearMisses() + stats.getNumXruns();
+        if (misses > lastMisses)
+            audioPressureUntil = now + audioPressureHold;
+        lastMisses = misses;
+
+        auto const rate = chooseFrameRate(now);
+        if (rate == frameRate)
+            return;
+
+        frameRate = rate;
+        startTimerHz(frameRate);
+
+        if (onFrameRateChange)
+            onFrameRateChange(frameRate);
+    }
+
+    void timerCallback() override
+    {
+        auto const now = Time::getMillisecondCounterHiRes();
+        updateFrameRate(now);
+
+        if (isPaused && isPaused())
+            return;
+
+        // Half a frame early still counts, otherwise intervals would round up to the next frame
+        auto const slack = 500.0 / frameRate;
+
+        due.clear();
+        bool needsLock = false;
+
+        for (auto& entry : clients) {
+            if (entry.nextDue - slack > now)
+                continue;
+
+            // Don't try to catch up after a stall
+            entry.nextDue = std::max(entry.nextDue + entry.interval, now);
+
+            due.push_back(entry);
+            needsLock = needsLock || entry.readsAudioState;
+        }
+
+        if (due.empty())
+            return;
+
+        if (needsLock) {
+            lock->enter();
+            for (auto& entry : due) {
+                if (entry.client && entry.readsAudioState)
+                    entry.client->readAudioState();
+            }
+            lock->exit();
+        }
+
+        for (auto& entry : due) {
+            if (entry.client)
+                entry.client->frameUpdate();
+        }
+
+        due.clear();
+    }
+
+    Component const& editor;
+    pd::CallbackLock const* lock;
+    pd::AudioStats const& stats;
+    std::function<bool()> isPaused;
+
+    SharedResourcePointer<FrameRateGovernor> governor;
+    int frameRate = framesPerSecond;
+    int64 lastMisses = 0;
+    double audioPressureUntil = 0.0;
+
+    std::vector<Entry> clients;
+    std::vector<Entry> due;
+};
@@ -0,0 +1,391 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "HelpPreview.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "LookAndFeel.h"
+
+JUCE_IMPLEMENT_SINGLETON(HelpPreviewCache)
+
+HelpPreviewCache::HelpPreviewCache()
+{
+    auto usage = StringArray::fromLines(getUsageFile().loadFileAsString());
+
+    std::vector<std::pair<int, File>> mostOpened;
+    for (auto const& line : usage) {
+        auto count = line.upToFirstOccurrenceOf("\t", false, false).getIntValue();
+        auto path = line.fromFirstOccurrenceOf("\t", false, false);
+
+        if (count <= 0 || !File::isAbsolutePath(path))
+            continue;
+
+        openCounts[path] = count;
+        mostOpened.emplace_back(count, File(path));
+    }
+
+    std::sort(mostOpened.begin(), mostOpened.end(), [](auto const& a, auto const& b) { return a.first > b.first; });
+    if (mostOpened.size() > numPreloaded)
+        mostOpened.resize(numPreloaded);
+
+    for (auto const& [count, file] : mostOpened) {
+        if (file.existsAsFile())
+            load(file, [](std::shared_ptr<Preview const>) {});
+    }
+}
+
+HelpPreviewCache::~HelpPreviewCache()
+{
+    clearSingletonInstance();
+}
+
+void HelpPreviewCache::load(File const& file, std::function<void(std::shared_ptr<Preview const>)> onLoaded)
+{
+    auto const path = file.getFullPathName();
+    auto const modified = file.getLastModificationTime();
+
+    if (entries.size() >= maxEntries && entries.find(path) == entries.end()) {
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (!it->second.isLoading)
+                it = entries.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    auto& entry = entries[path];
+
+    if (entry.isLoading && entry.modified == modified) {
+        entry.waiting.push_back(std::move(onLoaded));
+        return;
+    }
+
+    if (!entry.isLoading && entry.modified == modified && entry.preview) {
+        onLoaded(entry.preview);
+        return;
+    }
+
+    entry.modified = modified;
+    entry.preview = nullptr;
+    entry.thumbnail = Image();
+    entry.isLoading = true;
+    entry.waiting.push_back(std::move(onLoaded));
+
+    tasks->add([file, path, modified]() {
+        std::shared_ptr<Preview const> preview;
+        if (file.existsAsFile())
+            preview = parse(file.loadFileAsString());
+
+        // The cache might be gone by the time the message thread gets to it
+        MessageManager::callAsync([path, modified, preview]() {
+            if (auto* cache = HelpPreviewCache::getInstanceWithoutCreating())
+                cache->finishLoading(path, modified, preview);
+        });
+    }, TaskPool::Low);
+}
+
+void HelpPreviewCache::finishLoading(String const& path, Time modified, std::shared_ptr<Preview const> preview)
+{
+    auto it = entries.find(path);
+    if (it == entries.end())
+        return;
+
+    auto& entry = it->second;
+
+    // The file changed while it was parsed, the newer one is on its way
+    if (entry.modified != modified)
+        return;
+
+    entry.preview = preview;
+    entry.isLoading = false;
+
+    // Callbacks might load more previews, which can move the entry
+    auto waiting = std::move(entry.waiting);
+    entry.waiting.clear();
+
+    for (auto& callback : waiting)
+        callback(preview);
+}
+
+Image HelpPreviewCache::getThumbnail(File const& file, Preview const& preview, Rectangle<int> maxSize, Colour background, Colour foreground)
+{
+    auto it = entries.find(file.getFullPathName());
+    if (it == entries.end() || it->second.preview.get() != &preview)
+        return render(preview, maxSize, background, foreground);
+
+    auto& entry = it->second;
+    auto fits = entry.thumbnail.isValid() && entry.thumbnail.getWidth() <= maxSize.getWidth() && entry.thumbnail.getHeight() <= maxSize.getHeight();
+
+    // Drawn again when the theme changed
+    if (!fits || entry.thumbnailBackground != background) {
+        entry.thumbnail = render(preview, maxSize, background, foreground);
+        entry.thumbnailBackground = background;
+    }
+
+    return entry.thumbnail;
+}
+
+void HelpPreviewCache::noteOpened(File const& file)
+{
+    openCounts[file.getFullPathName()]++;
+    saveUsage();
+}
+
+void HelpPreviewCache::saveUsage()
+{
+    std::vector<std::pair<int, String>> counts;
+    for (auto const& [path, count] : openCounts)
+        counts.emplace_back(count, path);
+
+    std::sort(counts.begin(), counts.end(), [](auto const& a, auto const& b) { return a.first > b.first; });
+    if (counts.size() > maxRemembered)
+        counts.resize(maxRemembered);
+
+    String usage;
+    for (auto const& [count, path] : counts)
+        usage << count << "\t" << path << "\n";
+
+    tasks->add([usage, version = ++usageVersion]() {
+        static CriticalSection writeLock;
+        static int lastWritten = 0;
+
+        ScopedLock lock(writeLock);
+        if (version < lastWritten)
+            return;
+
+        lastWritten = version;
+        getUsageFile().replaceWithText(usage);
+    }, TaskPool::Low);
+}
+
+File HelpPreviewCache::getUsageFile()
+{
+    // Next to the settings
+    return File::getSpecialLocation(File::SpecialLocationType::userApplicationDataDirectory).getChildFile("PlugData").getChildFile("HelpUsage.txt");
+}
+
+Rectangle<int> HelpPreviewCache::Preview::getArea() const
+{
+    Rectangle<int> area;
+    for (auto const& box : boxes) {
+        if (box.kind != Hidden)
+            area = area.isEmpty() ? box.bounds : area.getUnion(box.bounds);
+    }
+
+    return area;
+}
+
+std::shared_ptr<HelpPreviewCache::Preview const> HelpPreviewCache::parse(String const& content)
+{
+    auto preview = std::make_shared<Preview>();
+
+    auto unescape = [](String const& text) {
+        return text.replace("\\,", ",").replace("\\;", ";").replace("\\$", "$").replace("\\\\", "\\");
+    };
+
+    auto charWidth = [&preview]() { return jmax(4, roundToInt(preview->fontSize * 0.6f)); };
+    auto boxHeight = [&preview]() { return preview->fontSize + 8; };
+
+    auto addBox = [&](Preview::Kind kind, StringArray const& tokens, int firstTextToken, int widthInChars) {
+        auto text = unescape(tokens.joinIntoString(" ", firstTextToken));
+
+        auto width = widthInChars > 0 ? widthInChars : jlimit(3, 60, text.length());
+        auto lines = widthInChars > 0 || kind == Preview::Comment ? jmax(1, (text.length() + width - 1) / width) : 1;
+
+        auto bounds = Rectangle<int>(tokens[2].getIntValue(), tokens[3].getIntValue(), width * charWidth() + 4, lines * (boxHeight() - 6) + 6);
+        preview->boxes.push_back({ kind, bounds, text });
+    };
+
+    // The bounds of a graph on parent, from the coords of the subpatch that's being read
+    Rectangle<int> graphBounds;
+    int depth = 0;
+
+    auto const* data = content.toRawUTF8();
+    auto const size = static_cast<int>(std::strlen(data));
+
+    int start = 0;
+    for (int i = 0; i < size; i++) {
+        if (data[i] != ';' || (i > 0 && data[i - 1] == '\\'))
+            continue;
+
+        auto record = String::fromUTF8(data + start, i - start).replaceCharacters("\r\n\t", "   ").trim();
+        start = i + 1;
+
+        // A fixed width, as in "#X obj 10 10 osc~, f 12"
+        int widthInChars = 0;
+        auto comma = record.lastIndexOf(", f ");
+        if (comma > 0 && record[comma - 1] != '\\') {
+            widthInChars = record.substring(comma + 4).getIntValue();
+            record = record.substring(0, comma);
+        }
+
+        StringArray tokens;
+        tokens.addTokens(record, " ", "");
+        tokens.removeEmptyStrings();
+
+        if (tokens.size() < 2)
+            continue;
+
+        auto const& type = tokens[0];
+        auto const& what = tokens[1];
+
+        if (type == "#N" && what == "canvas") {
+            depth++;
+            if (depth == 1 && tokens.size() >= 7)
+                preview->fontSize = jlimit(8, 36, tokens[6].getIntValue());
+            else if (depth == 2)
+                graphBounds = {};
+
+            continue;
+        }
+
+        if (type != "#X")
+            continue;
+
+        if (what == "restore") {
+            if (depth == 2 && tokens.size() >= 4) {
+                if (!graphBounds.isEmpty())
+                    preview->boxes.push_back({ Preview::Graph, graphBounds.withPosition(tokens[2].getIntValue(), tokens[3].getIntValue()), unescape(tokens.joinIntoString(" ", 4)) });
+                else
+                    addBox(Preview::ObjectBox, tokens, 4, widthInChars);
+            }
+
+            depth = jmax(0, depth - 1);
+            continue;
+        }
+
+        if (depth == 2 && what == "coords" && tokens.size() >= 9 && tokens[8].getIntValue() != 0) {
+            graphBounds = { 0, 0, tokens[6].getIntValue(), tokens[7].getIntValue() };
+            continue;
+        }
+
+        if (depth != 1)
+            continue;
+
+        if (what == "connect" && tokens.size() >= 6) {
+            preview->connections.push_back({ tokens[2].getIntValue(), tokens[3].getIntValue(), tokens[4].getIntValue(), tokens[5].getIntValue() });
+        } else if (what == "obj" && tokens.size() >= 4) {
+            addBox(Preview::ObjectBox, tokens, 4, widthInChars);
+        } else if (what == "msg" && tokens.size() >= 4) {
+            addBox(Preview::MessageBox, tokens, 4, widthInChars);
+        } else if (what == "text" && tokens.size() >= 4) {
+            addBox(Preview::Comment, tokens, 4, widthInChars);
+        } else if ((what == "floatatom" || what == "symbolatom" || what == "listbox") && tokens.size() >= 5) {
+            auto width = tokens[4].getIntValue();
+            addBox(Preview::AtomBox, StringArray { type, what, tokens[2], tokens[3], what == "floatatom" ? "0" : "" }, 4, width > 0 ? width : 5);
+        } else if (what == "scalar") {
+            preview->boxes.push_back({ Preview::Hidden, {}, {} });
+        }
+    }
+
+    return preview;
+}
+
+Image HelpPreviewCache::render(Preview const& preview, Rectangle<int> maxSize, Colour background, Colour foreground)
+{
+    auto area = preview.getArea().expanded(8);
+    if (area.isEmpty())
+        return Image();
+
+    auto scale = jmin(1.0f, maxSize.getWidth() / static_cast<float>(area.getWidth()), maxSize.getHeight() / static_cast<float>(area.getHeight()));
+    auto width = jmax(1, roundToInt(area.getWidth() * scale));
+    auto height = jmax(1, roundToInt(area.getHeight() * scale));
+
+    Image image(Image::ARGB, width, height, true);
+    Graphics g(image);
+
+    g.fillAll(background);
+    g.addTransform(AffineTransform::translation(-area.getX(), -area.getY()).scaled(scale));
+
+    g.setColour(foreground.withAlpha(0.6f));
+    for (auto const& connection : preview.connections) {
+        if (!isPositiveAndBelow(connection.outObject, preview.boxes.size()) || !isPositiveAndBelow(connection.inObject, preview.boxes.size()))
+            continue;
+
+        auto const& out = preview.boxes[connection.outObject].bounds;
+        auto const& in = preview.boxes[connection.inObject].bounds;
+
+        // The number of iolets isn't known without pd, so they are spaced evenly from the left
+        auto start = Point<float>(jmin(out.getX() + 4 + connection.outlet * 14, out.getRight() - 4), out.getBottom());
+        auto end = Point<float>(jmin(in.getX() + 4 + connection.inlet * 14, in.getRight() - 4), in.getY());
+        g.drawLine({ start, end }, 1.0f);
+    }
+
+    g.setFont(static_cast<float>(preview.fontSize));
+
+    for (auto const& box : preview.boxes) {
+        auto bounds = box.bounds.toFloat();
+
+        switch (box.kind) {
+        case Preview::Hidden:
+            continue;
+        case Preview::Comment:
+            g.setColour(foreground.withAlpha(0.7f));
+            g.drawFittedText(box.text, box.bounds.reduced(2, 0), Justification::topLeft, 64);
+            continue;
+        case Preview::MessageBox: {
+            Path flag;
+            flag.startNewSubPath(bounds.getTopLeft());
+            flag.lineTo(bounds.getRight() + 4, bounds.getY());
+            flag.lineTo(bounds.getRight(), bounds.getY() + 4);
+            flag.lineTo(bounds.getRight(), bounds.getBottom() - 4);
+            flag.lineTo(bounds.getRight() + 4, bounds.getBottom());
+            flag.lineTo(bounds.getBottomLeft());
+            flag.closeSubPath();
+
+            g.setColour(foreground);
+            g.strokePath(flag, PathStrokeType(1.0f));
+            break;
+        }
+        default:
+            g.setColour(foreground);
+            g.drawRect(bounds, 1.0f);
+            break;
+        }
+
+        g.drawFittedText(box.text, box.bounds.reduced(2, 0), Justification::centredLeft, 8);
+    }
+
+    return image;
+}
+
+HelpPreviewComponent::HelpPreviewComponent(Image image, String const& name, std::function<void()> onOpen)
+    : thumbnail(std::move(image))
+    , title(name)
+{
+    openButton.setConnectedEdges(12);
+    openButton.onClick = [this, onOpen]() {
+        // Closes the callout this is in, so it's the last thing to do
+        auto open = onOpen;
+        if (auto* callout = findParentComponentOfClass<CallOutBox>())
+            callout->dismiss();
+
+        open();
+    };
+
+    addAndMakeVisible(openButton);
+
+    setSize(jmax(200, thumbnail.getWidth()), headerHeight + jmax(40, thumbnail.getHeight()));
+}
+
+void HelpPreviewComponent::paint(Graphics& g)
+{
+    g.setColour(findColour(PlugDataColour::panelTextColourId));
+    g.drawText(title, getLocalBounds().removeFromTop(headerHeight).reduced(6, 0), Justification::centredLeft);
+
+    auto area = getLocalBounds().withTrimmedTop(headerHeight);
+    if (thumbnail.isValid())
+        g.drawImageAt(thumbnail, area.getX() + (area.getWidth() - thumbnail.getWidth()) / 2, area.getY());
+    else
+        g.drawText("Nothing to show", area, Justification::centred);
+}
+
+void HelpPreviewComponent::resized()
+{
+    openButton.setBounds(getLocalBounds().removeFromTop(headerHeight).removeFromRight(60).reduced(2, 4));
+}
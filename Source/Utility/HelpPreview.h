@@ -0,0 +1,117 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+#include <JuceHeader.h>
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "TaskPool.h"
+
+// Help patches read in the background, to preview them without opening them in pd
+//! @details Only used from the message thread. A preview is the boxes, comments and connections of the
+//! main canvas of a help patch, read from its file without pd, so nothing is created and no DSP runs.
+//! Previews are kept by path and modification time. How often each help file was opened is kept in a
+//! file next to the settings, the most opened ones are parsed in the background when the cache is
+//! created, so their previews are ready when they're asked for.
+class HelpPreviewCache : public DeletedAtShutdown {
+public:
+    struct Preview {
+        enum Kind {
+            ObjectBox,
+            MessageBox,
+            AtomBox,
+            Comment,
+            Graph,
+            Hidden // scalars, only there so connections can refer to objects by index
+        };
+
+        struct Box {
+            Kind kind;
+            Rectangle<int> bounds;
+            String text;
+        };
+
+        struct Connection {
+            int outObject, outlet, inObject, inlet;
+        };
+
+        // In pd's order, like the indices of the connections
+        std::vector<Box> boxes;
+        std::vector<Connection> connections;
+        int fontSize = 12;
+
+        Rectangle<int> getArea() const;
+    };
+
+    HelpPreviewCache();
+    ~HelpPreviewCache() override;
+
+    // Calls onLoaded with the preview, or nullptr if the file can't be read
+    // Called straight away when the preview is cached, otherwise once it was parsed
+    void load(File const& file, std::function<void(std::shared_ptr<Preview const>)> onLoaded);
+
+    // The preview of file drawn in the given colours, no larger than maxSize
+    Image getThumbnail(File const& file, Preview const& preview, Rectangle<int> maxSize, Colour background, Colour foreground);
+
+    // Counts an opened help file, the most opened ones are parsed ahead of time
+    void noteOpened(File const& file);
+
+    JUCE_DECLARE_SINGLETON(HelpPreviewCache, false)
+
+private:
+    struct Entry {
+        Time modified;
+        std::shared_ptr<Preview const> preview;
+        bool isLoading = false;
+        std::vector<std::function<void(std::shared_ptr<Preview const>)>> waiting;
+
+        Image thumbnail;
+        Colour thumbnailBackground;
+    };
+
+    static std::shared_ptr<Preview const> parse(String const& content);
+    static Image render(Preview const& preview, Rectangle<int> maxSize, Colour background, Colour foreground);
+
+    void finishLoading(String const& path, Time modified, std::shared_ptr<Preview const> preview);
+    void saveUsage();
+
+    static File getUsageFile();
+
+    // Number of help files parsed ahead of time, and number of help files whose use is remembered
+    static constexpr int numPreloaded = 16;
+    static constexpr int maxRemembered = 256;
+
+    // When it's full, the previews that aren't being parsed are dropped
+    static constexpr size_t maxEntries = 128;
+
+    std::unordered_map<String, Entry> entries;
+    std::unordered_map<String, int> openCounts;
+
+    // Written in the order they were saved, a write that comes after a newer one is skipped
+    int usageVersion = 0;
+
+    SharedResourcePointer<TaskPool> tasks;
+};
+
+// A preview of a help patch, with a button to open it
+class HelpPreviewComponent : public Component {
+public:
+    HelpPreviewComponent(Image thumbnail, String const& title, std::function<void()> onOpen);
+
+    void paint(Graphics& g) override;
+    void resized() override;
+
+private:
+    static constexpr int headerHeight = 28;
+
+    Image thumbnail;
+    String title;
+    TextButton openButton { "Open" };
+};
@@ -0,0 +1,107 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "ImageFileCache.h"
+
+JUCE_IMPLEMENT_SINGLETON(ImageFileCache)
+
+ImageFileCache::~ImageFileCache()
+{
+    clearSingletonInstance();
+}
+
+void ImageFileCache::load(File const& file, std::function<void(Image)> onLoaded)
+{
+    removeUnused();
+
+    auto const path = file.getFullPathName();
+    auto const modified = file.getLastModificationTime();
+    auto& entry = entries[path];
+
+    if (entry.isLoading && entry.modified == modified) {
+        entry.waiting.push_back(std::move(onLoaded));
+        return;
+    }
+
+    if (!entry.isLoading && entry.modified == modified && entry.image.isValid()) {
+        onLoaded(entry.image);
+        return;
+    }
+
+    entry.modified = modified;
+    entry.image = Image();
+    entry.scaled.clear();
+    entry.isLoading = true;
+    entry.waiting.push_back(std::move(onLoaded));
+
+    tasks->add([file, path, modified]() {
+        auto image = ImageFileFormat::loadFrom(file);
+
+        // The cache might be gone by the time the message thread gets to it
+        MessageManager::callAsync([path, modified, image]() {
+            if (auto* cache = ImageFileCache::getInstanceWithoutCreating())
+                cache->finishLoading(path, modified, image);
+        });
+    }, TaskPool::Low);
+}
+
+void ImageFileCache::finishLoading(String const& path, Time modified, Image image)
+{
+    auto it = entries.find(path);
+    if (it == entries.end())
+        return;
+
+    auto& entry = it->second;
+
+    // The file changed while it was decoded, the newer one is on its way
+    if (entry.modified != modified)
+        return;
+
+    entry.image = image;
+    entry.isLoading = false;
+
+    // Callbacks might load more images, which can move the entry
+    auto waiting = std::move(entry.waiting);
+    entry.waiting.clear();
+
+    for (auto& callback : waiting)
+        callback(image);
+}
+
+Image ImageFileCache::getScaled(File const& file, Image const& image, float scale)
+{
+    auto const percent = roundToInt(scale * 100.0f);
+    if (percent == 100 || !image.isValid())
+        return image;
+
+    auto it = entries.find(file.getFullPathName());
+    if (it == entries.end() || it->second.image != image)
+        return image;
+
+    auto& scaled = it->second.scaled;
+    if (auto found = scaled.find(percent); found != scaled.end())
+        return found->second;
+
+    if (scaled.size() >= maxScaledCopies)
+        scaled.clear();
+
+    auto const width = jmax(1, roundToInt(image.getWidth() * percent / 100.0f));
+    auto const height = jmax(1, roundToInt(image.getHeight() * percent / 100.0f));
+    return scaled[percent] = image.rescaled(width, height, Graphics::highResamplingQuality);
+}
+
+void ImageFileCache::removeUnused()
+{
+    for (auto it = entries.begin(); it != entries.end();) {
+        auto& entry = it->second;
+
+        // Only the cache holds it
+        if (!entry.isLoading && entry.image.getReferenceCount() <= 1)
+            it = entries.erase(it);
+        else
+            ++it;
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+#include <JuceHeader.h>
+
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "TaskPool.h"
+
+// Images from files, decoded in the background and shared by everything that shows the same file
+//! @details Only used from the message thread. Images are kept by path and modification time, so a
+//! file that changed on disk is decoded again. Images share their pixels, an image is dropped from the
+//! cache once nothing outside the cache holds it anymore. Copies scaled for a zoom level are made once
+//! and kept with the image, so it doesn't have to be resampled on every paint.
+class ImageFileCache : public DeletedAtShutdown {
+public:
+    ~ImageFileCache() override;
+
+    // Calls onLoaded with the image, or an invalid image if the file can't be read
+    // Called straight away when the image is cached, otherwise once it was decoded
+    void load(File const& file, std::function<void(Image)> onLoaded);
+
+    // A copy of the image of file, scaled for drawing at the given scale
+    Image getScaled(File const& file, Image const& image, float scale);
+
+    JUCE_DECLARE_SINGLETON(ImageFileCache, false)
+
+private:
+    struct Entry {
+        Time modified;
+        Image image;
+        bool isLoading = false;
+        std::vector<std::function<void(Image)>> waiting;
+
+        // By scale in percent
+        std::map<int, Image> scaled;
+    };
+
+    void finishLoading(String const& path, Time modified, Image image);
+    void removeUnused();
+
+    // Only a few zoom levels are in use at a time
+    static constexpr size_t maxScaledCopies = 4;
+
+    std::unordered_map<String, Entry> entries;
+
+    SharedResourcePointer<TaskPool> tasks;
+};
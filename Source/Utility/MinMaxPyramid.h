@@ -0,0 +1,115 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+#include <JuceHeader.h>
+
+#include <vector>
+
+// Minimum and maximum of a table at halving resolutions, to draw large tables quickly
+//! @details The first level summarises blocks of blockSize samples, every next level combines
+//! two blocks of the level below. The range of any part of the table is then found from at most
+//! two blocks per level, plus the samples at its unaligned edges. The summary of a changed range
+//! can be updated without looking at the rest of the table.
+class MinMaxPyramid {
+public:
+    static constexpr int blockSize = 64;
+
+    int size() const
+    {
+        return numSamples;
+    }
+
+    void rebuild(float const* data, int newSize)
+    {
+        numSamples = newSize;
+        levels.clear();
+
+        auto numBlocks = (numSamples + blockSize - 1) / blockSize;
+        while (numBlocks > 0) {
+            levels.emplace_back(static_cast<size_t>(numBlocks));
+            if (numBlocks == 1)
+                break;
+
+            numBlocks = (numBlocks + 1) / 2;
+        }
+
+        update(data, 0, numSamples);
+    }
+
+    // Summarises samples start to end again, after they have been changed
+    void update(float const* data, int start, int end)
+    {
+        start = jmax(start, 0);
+        end = jmin(end, numSamples);
+        if (start >= end || levels.empty())
+            return;
+
+        auto first = start / blockSize;
+        auto last = (end - 1) / blockSize;
+
+        auto& blocks = levels[0];
+        for (int b = first; b <= last; b++) {
+            auto const blockStart = b * blockSize;
+            auto const blockEnd = jmin(blockStart + blockSize, numSamples);
+            blocks[b] = FloatVectorOperations::findMinAndMax(data + blockStart, blockEnd - blockStart);
+        }
+
+        for (size_t level = 1; level < levels.size(); level++) {
+            auto const& below = levels[level - 1];
+            auto& above = levels[level];
+
+            first /= 2;
+            last /= 2;
+
+            for (int b = first; b <= last; b++) {
+                auto const left = static_cast<size_t>(2 * b);
+                above[b] = left + 1 < below.size() ? below[left].getUnionWith(below[left + 1]) : below[left];
+            }
+        }
+    }
+
+    // Range of samples start to end, data has to be the table this was built from
+    Range<float> getRange(float const* data, int start, int end) const
+    {
+        start = jmax(start, 0);
+        end = jmin(end, numSamples);
+        if (start >= end)
+            return {};
+
+        auto result = Range<float>::emptyRange(data[start]);
+
+        // The unaligned edges are read from the table itself
+        auto const alignedStart = jmin(end, (start + blockSize - 1) / blockSize * blockSize);
+        auto const alignedEnd = jmax(alignedStart, end / blockSize * blockSize);
+
+        for (int i = start; i < alignedStart; i++)
+            result = result.getUnionWith(data[i]);
+        for (int i = alignedEnd; i < end; i++)
+            result = result.getUnionWith(data[i]);
+
+        auto first = alignedStart / blockSize;
+        auto last = alignedEnd / blockSize;
+
+        for (size_t level = 0; level < levels.size() && first < last; level++) {
+            auto const& blocks = levels[level];
+
+            if (first & 1)
+                result = result.getUnionWith(blocks[first++]);
+            if (last & 1)
+                result = result.getUnionWith(blocks[--last]);
+
+            first /= 2;
+            last /= 2;
+        }
+
+        return result;
+    }
+
+private:
+    int numSamples = 0;
+    std::vector<std::vector<Range<float>>> levels;
+};
@@ -120,8 +120,6 @@ Point<int> ObjectGrid::handleMouseDrag(Object* toDrag, Point<int> dragOffset, Re
 
 Point<int> ObjectGrid::performVerticalSnap(Object* toDrag, Point<int> dragOffset, Rectangle<int> viewBounds)
 {
-    auto* cnv = toDrag->cnv;
-
     if (snapped[0]) {
         if (std::abs(position[0].y - dragOffset.y) > range) {
             clear(false);
@@ -131,30 +129,15 @@ Point<int> ObjectGrid::performVerticalSnap(Object* toDrag, Point<int> dragOffset
         return { dragOffset.x, position[0].y };
     }
 
-    for (auto* object : cnv->objects) {
-        if (cnv->isSelected(object))
-            continue; // don't look at selected objects
-
-        if (!viewBounds.intersects(object->getBounds()))
-            continue; // if the object is out of viewport bounds
+    updateIndex(toDrag, viewBounds);
 
-        auto b1 = object->getBounds().reduced(Object::margin);
-        auto b2 = toDrag->getBounds().withPosition(toDrag->mouseDownPos + dragOffset).reduced(Object::margin);
+    auto b2 = toDrag->getBounds().withPosition(toDrag->mouseDownPos + dragOffset).reduced(Object::margin);
+    int const targets[3] = { b2.getY(), b2.getCentreY(), b2.getBottom() };
 
-        start[0] = object;
-        end[0] = toDrag;
-
-        if (trySnap(b1.getY() - b2.getY())) {
-            orientation[0] = SnappedLeft;
-            return setState(true, totalSnaps, Point<int>(0, b1.getY() - b2.getY()) + dragOffset, object, toDrag, false);
-        }
-        if (trySnap(b1.getCentreY() - b2.getCentreY())) {
-            orientation[0] = SnappedCentre;
-            return setState(true, totalSnaps, Point<int>(0, b1.getCentreY() - b2.getCentreY()) + dragOffset, object, toDrag, false);
-        }
-        if (trySnap(b1.getBottom() - b2.getBottom())) {
-            orientation[0] = SnappedRight;
-            return setState(true, totalSnaps, Point<int>(0, b1.getBottom() - b2.getBottom()) + dragOffset, object, toDrag, false);
+    for (auto snapOrientation : { SnappedLeft, SnappedCentre, SnappedRight }) {
+        if (auto const* edge = findEdge(false, snapOrientation, targets[snapOrientation])) {
+            orientation[0] = snapOrientation;
+            return setState(true, totalSnaps, Point<int>(0, edge->position - targets[snapOrientation]) + dragOffset, edge->object, toDrag, false);
         }
     }
 
@@ -214,43 +197,81 @@ Point<int> ObjectGrid::performHorizontalSnap(Object* toDrag, Point<int> dragOffs
         }
     }
 
-    for (auto* object : cnv->objects) {
+    updateIndex(toDrag, viewBounds);
+
+    auto b2 = toDrag->getBounds().withPosition(toDrag->mouseDownPos + dragOffset).reduced(Object::margin);
+    int const targets[3] = { b2.getX(), b2.getCentreX(), b2.getRight() };
+
+    for (auto snapOrientation : { SnappedLeft, SnappedCentre, SnappedRight }) {
+        if (auto const* edge = findEdge(true, snapOrientation, targets[snapOrientation])) {
+            orientation[1] = snapOrientation;
+            return setState(true, totalSnaps, Point<int>(edge->position - targets[snapOrientation], 0) + dragOffset, edge->object, toDrag, true);
+        }
+    }
+
+    return dragOffset;
+}
+
+void ObjectGrid::updateIndex(Object* toDrag, Rectangle<int> viewBounds)
+{
+    if (toDrag == indexedFor && viewBounds == indexedArea)
+        return;
+
+    indexedFor = toDrag;
+    indexedArea = viewBounds;
+
+    for (auto& axis : edges) {
+        for (auto& list : axis)
+            list.clear();
+    }
+
+    auto* cnv = toDrag->cnv;
+
+    // Only look at objects in the viewport
+    Array<Object*> visibleObjects;
+    cnv->getObjectIndex().query(viewBounds, visibleObjects);
+
+    for (auto* object : visibleObjects) {
         if (cnv->isSelected(object))
             continue; // don't look at selected objects
 
-        if (!viewBounds.intersects(object->getBounds()))
-            continue; // if the object is out of viewport bounds
+        auto b = object->getBounds().reduced(Object::margin);
 
-        auto b1 = object->getBounds().reduced(Object::margin);
-        auto b2 = toDrag->getBounds().withPosition(toDrag->mouseDownPos + dragOffset).reduced(Object::margin);
+        edges[0][SnappedLeft].push_back({ b.getY(), object });
+        edges[0][SnappedCentre].push_back({ b.getCentreY(), object });
+        edges[0][SnappedRight].push_back({ b.getBottom(), object });
+        edges[1][SnappedLeft].push_back({ b.getX(), object });
+        edges[1][SnappedCentre].push_back({ b.getCentreX(), object });
+        edges[1][SnappedRight].push_back({ b.getRight(), object });
+    }
 
-        start[1] = object;
-        end[1] = toDrag;
+    for (auto& axis : edges) {
+        for (auto& list : axis)
+            std::sort(list.begin(), list.end());
+    }
+}
 
-        auto t = b1.getY() < b2.getY() ? b1 : b2;
-        auto b = b1.getY() > b2.getY() ? b1 : b2;
-        auto r = b1.getX() < b2.getX() ? b1 : b2;
-        auto l = b1.getX() > b2.getX() ? b1 : b2;
+ObjectGrid::Edge const* ObjectGrid::findEdge(bool horizontal, SnapOrientation snapOrientation, int target) const
+{
+    auto const& list = edges[horizontal][snapOrientation];
 
-        if (trySnap(b1.getX() - b2.getX())) {
-            orientation[1] = SnappedLeft;
-            return setState(true, totalSnaps, Point<int>(b1.getX() - b2.getX(), 0) + dragOffset, object, toDrag, true);
-        }
-        if (trySnap(b1.getCentreX() - b2.getCentreX())) {
-            orientation[1] = SnappedCentre;
-            return setState(true, totalSnaps, Point<int>(b1.getCentreX() - b2.getCentreX(), 0) + dragOffset, object, toDrag, true);
-        }
-        if (trySnap(b1.getRight() - b2.getRight())) {
-            orientation[1] = SnappedRight;
-            return setState(true, totalSnaps, Point<int>(b1.getRight() - b2.getRight(), 0) + dragOffset, object, toDrag, true);
-        }
+    Edge const* nearest = nullptr;
+    for (auto it = std::lower_bound(list.begin(), list.end(), Edge { target - tolerance + 1, nullptr }); it != list.end() && it->position < target + tolerance; ++it) {
+        if (!it->object)
+            continue;
+
+        if (!nearest || std::abs(it->position - target) < std::abs(nearest->position - target))
+            nearest = &*it;
     }
 
-    return dragOffset;
+    return nearest;
 }
 
 Point<int> ObjectGrid::handleMouseUp(Point<int> dragOffset)
 {
+    // The next drag can move other objects
+    indexedFor = nullptr;
+
     if (snapped[1]) {
         dragOffset.x = position[1].x;
         clear(1);
@@ -1,6 +1,8 @@
 #pragma once
 #include <JuceHeader.h>
 
+#include <vector>
+
 enum GridType {
     NotSnappedToGrid = 0,
     HorizontalSnap = 1,
@@ -57,4 +59,24 @@ private:
     Point<int> performHorizontalSnap(Object* toDrag, Point<int> dragOffset, Rectangle<int> viewBounds);
 
     bool trySnap(int distance);
+
+    // Edges and centres of the objects that can be snapped to, sorted by position
+    //! @details Built when a drag starts, for the objects in view that aren't selected. Those don't move
+    //! while dragging, so it only has to be built again when the view moves.
+    struct Edge {
+        int position;
+        Component::SafePointer<Object> object;
+
+        bool operator<(Edge const& other) const { return position < other.position; }
+    };
+
+    // By axis (vertical, horizontal) and by SnappedLeft, SnappedCentre and SnappedRight
+    std::vector<Edge> edges[2][3];
+    Rectangle<int> indexedArea;
+    Object* indexedFor = nullptr;
+
+    void updateIndex(Object* toDrag, Rectangle<int> viewBounds);
+
+    // The edge closest to position within the snapping tolerance, or nullptr
+    Edge const* findEdge(bool horizontal, SnapOrientation orientation, int position) const;
 };
@@ -0,0 +1,416 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "Oversampler.h"
+
+namespace {
+
+// The filters that come with JUCE
+class JuceOversampler : public Oversampler {
+public:
+    JuceOversampler(int numChannels, int factor, dsp::Oversampling<float>::FilterType type)
+        // Integer latency, so what we report to the host is exact
+        : oversampling(static_cast<size_t>(numChannels), static_cast<size_t>(factor), type, true, true)
+    {
+    }
+
+    void initProcessing(size_t maximumNumberOfSamplesBeforeOversampling) override
+    {
+        oversampling.initProcessing(maximumNumberOfSamplesBeforeOversampling);
+    }
+
+    void reset() override
+    {
+        oversampling.reset();
+    }
+
+    dsp::AudioBlock<float> processSamplesUp(dsp::AudioBlock<float const> const& inputBlock) override
+    {
+        return oversampling.processSamplesUp(inputBlock);
+    }
+
+    void processSamplesDown(dsp::AudioBlock<float>& outputBlock) override
+    {
+        oversampling.processSamplesDown(outputBlock);
+    }
+
+    float getLatencyInSamples() const override
+    {
+        return oversampling.getLatencyInSamples();
+    }
+
+private:
+    dsp::Oversampling<float> oversampling;
+};
+
+// A 2x stage with a windowed-sinc half-band filter
+//! @details Every other tap of a half-band filter is zero, apart from the centre tap, which
+//! is 0.5. Upsampling therefore computes the even output samples with the non-zero taps and
+//! the odd ones are just the delayed input. Downsampling filters the even input samples and
+//! adds half of the delayed odd ones. Each tap is applied to the whole block at once, with the
+//! channel history kept in front of the block, so there's no per-sample ring buffer indexing.
+struct HalfBandStage {
+    explicit HalfBandStage(int numTapsPerPhase)
+        : halfLength(numTapsPerPhase)
+    {
+        // Non-zero taps of a half-band filter with 4 * halfLength - 1 taps
+        auto const centre = getCentre();
+        auto const length = 2 * centre + 1;
+        float sum = 0.0f;
+
+        for (int m = 0; m < getNumTaps(); m++) {
+            auto const n = 2 * m;
+            auto const x = static_cast<double>(n - centre) * 0.5;
+            auto const sinc = std::sin(MathConstants<double>::pi * x) / (MathConstants<double>::pi * x);
+
+            // Blackman window
+            auto const phase = MathConstants<double>::twoPi * n / (length - 1);
+            auto const window = 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase);
+
+            coefficients.push_back(static_cast<float>(0.5 * sinc * window));
+            sum += coefficients.back();
+        }
+
+        // The even taps add up to 0.5 at DC, the centre tap provides the other half
+        for (auto& coefficient : coefficients)
+            coefficient *= 0.5f / sum;
+    }
+
+    int getNumTaps() const
+    {
+        return 2 * halfLength;
+    }
+
+    int getCentre() const
+    {
+        return 2 * halfLength - 1;
+    }
+
+    void prepare(int numChannels, int maxInputSamples)
+    {
+        auto const history = getNumTaps() - 1;
+
+        output.setSize(numChannels, maxInputSamples * 2);
+        upHistory.setSize(numChannels, history + maxInputSamples);
+        evenHistory.setSize(numChannels, history + maxInputSamples);
+        oddHistory.setSize(numChannels, halfLength + maxInputSamples);
+        scratch.setSize(1, maxInputSamples);
+    }
+
+    void reset()
+    {
+        output.clear();
+        upHistory.clear();
+        evenHistory.clear();
+        oddHistory.clear();
+    }
+
+    // Reads numSamples from input, writes twice as many to output
+    void up(int ch, float const* input, int numSamples)
+    {
+        auto const history = getNumTaps() - 1;
+        auto* x = upHistory.getWritePointer(ch);
+        auto* even = scratch.getWritePointer(0);
+        auto* y = output.getWritePointer(ch);
+
+        FloatVectorOperations::copy(x + history, input, numSamples);
+
+        // Upsampling by zero-stuffing halves the level, so the taps count twice here
+        FloatVectorOperations::clear(even, numSamples);
+        for (int m = 0; m < getNumTaps(); m++)
+            FloatVectorOperations::addWithMultiply(even, x + history - m, 2.0f * coefficients[m], numSamples);
+
+        auto const* odd = x + history - (halfLength - 1);
+        for (int i = 0; i < numSamples; i++) {
+            y[2 * i] = even[i];
+            y[2 * i + 1] = odd[i];
+        }
+
+        keepHistory(x, history, numSamples);
+    }
+
+    // Reads numSamples * 2 from output, writes numSamples to destination
+    void down(int ch, float* destination, int numSamples)
+    {
+        auto const history = getNumTaps() - 1;
+        auto* even = evenHistory.getWritePointer(ch);
+        auto* odd = oddHistory.getWritePointer(ch);
+        auto const* z = output.getReadPointer(ch);
+
+        for (int i = 0; i < numSamples; i++) {
+            even[history + i] = z[2 * i];
+            odd[halfLength + i] = z[2 * i + 1];
+        }
+
+        FloatVectorOperations::copyWithMultiply(destination, odd, 0.5f, numSamples);
+        for (int m = 0; m < getNumTaps(); m++)
+            FloatVectorOperations::addWithMultiply(destination, even + history - m, coefficients[m], numSamples);
+
+        keepHistory(even, history, numSamples);
+        keepHistory(odd, halfLength, numSamples);
+    }
+
+    static void keepHistory(float* buffer, int history, int numSamples)
+    {
+        // The source and destination can overlap for blocks shorter than the history
+        std::memmove(buffer, buffer + numSamples, static_cast<size_t>(history) * sizeof(float));
+    }
+
+    int const halfLength;
+    std::vector<float> coefficients;
+
+    AudioBuffer<float> output;
+    AudioBuffer<float> upHistory;
+    AudioBuffer<float> evenHistory;
+    AudioBuffer<float> oddHistory;
+    AudioBuffer<float> scratch;
+};
+
+// Cascade of 2x half-band stages
+class PolyphaseOversampler : public Oversampler {
+public:
+    PolyphaseOversampler(int channels, int factor)
+        : numChannels(channels)
+    {
+        for (int i = 0; i < factor; i++) {
+            // The first stage has the narrowest transition band relative to its rate
+            stages.add(new HalfBandStage(i == 0 ? 16 : 8));
+        }
+    }
+
+    void initProcessing(size_t maximumNumberOfSamplesBeforeOversampling) override
+    {
+        auto numSamples = static_cast<int>(maximumNumberOfSamplesBeforeOversampling);
+
+        for (auto* stage : stages) {
+            stage->prepare(numChannels, numSamples);
+            numSamples *= 2;
+        }
+
+        reset();
+    }
+
+    void reset() override
+    {
+        for (auto* stage : stages)
+            stage->reset();
+    }
+
+    dsp::AudioBlock<float> processSamplesUp(dsp::AudioBlock<float const> const& inputBlock) override
+    {
+        auto const channels = jmin(numChannels, static_cast<int>(inputBlock.getNumChannels()));
+        auto numSamples = static_cast<int>(inputBlock.getNumSamples());
+
+        for (int ch = 0; ch < channels; ch++) {
+            auto const* input = inputBlock.getChannelPointer(static_cast<size_t>(ch));
+            auto samples = numSamples;
+
+            for (auto* stage : stages) {
+                stage->up(ch, input, samples);
+                input = stage->output.getReadPointer(ch);
+                samples *= 2;
+            }
+        }
+
+        numSamples <<= stages.size();
+
+        if (stages.isEmpty())
+            return {};
+
+        return dsp::AudioBlock<float>(stages.getLast()->output).getSubsetChannelBlock(0, static_cast<size_t>(channels)).getSubBlock(0, static_cast<size_t>(numSamples));
+    }
+
+    void processSamplesDown(dsp::AudioBlock<float>& outputBlock) override
+    {
+        auto const channels = jmin(numChannels, static_cast<int>(outputBlock.getNumChannels()));
+        auto const numSamples = static_cast<int>(outputBlock.getNumSamples());
+
+        for (int ch = 0; ch < channels; ch++) {
+            for (int i = stages.size() - 1; i >= 0; i--) {
+                auto* destination = i == 0 ? outputBlock.getChannelPointer(static_cast<size_t>(ch)) : stages[i - 1]->output.getWritePointer(ch);
+                stages[i]->down(ch, destination, numSamples << i);
+            }
+        }
+    }
+
+    float getLatencyInSamples() const override
+    {
+        float latency = 0.0f;
+        float rate = 1.0f;
+
+        for (auto* stage : stages) {
+            rate *= 2.0f;
+            // Up and down both delay by the centre of the filter, at the oversampled rate
+            latency += 2.0f * stage->getCentre() / rate;
+        }
+
+        return latency;
+    }
+
+private:
+    int const numChannels;
+    OwnedArray<HalfBandStage> stages;
+};
+
+// Cascade of 2x half-band stages, going down to pd's rate first and back up afterwards
+//! @details stages[0] is the one at pd's rate. The input FIFO keeps the samples that don't make up
+//! a sample at pd's rate yet, the output FIFO starts with factor - 1 samples of silence so it always
+//! has enough for the host's block.
+class PolyphaseUndersampler : public Undersampler {
+public:
+    PolyphaseUndersampler(int channels, int factor)
+        : numChannels(channels)
+        , ratio(1 << factor)
+    {
+        for (int i = 0; i < factor; i++) {
+            stages.add(new HalfBandStage(i == 0 ? 16 : 8));
+        }
+    }
+
+    void initProcessing(size_t maximumNumberOfHostSamples) override
+    {
+        auto const maxHostSamples = static_cast<int>(maximumNumberOfHostSamples);
+        auto const maxSamples = (maxHostSamples + ratio - 1) / ratio;
+        auto numStageSamples = maxSamples;
+
+        for (auto* stage : stages) {
+            stage->prepare(numChannels, numStageSamples);
+            numStageSamples *= 2;
+        }
+
+        input.setSize(numChannels, ratio - 1 + maxHostSamples);
+        output.setSize(numChannels, ratio - 1 + maxHostSamples);
+        block.setSize(numChannels, maxSamples);
+
+        reset();
+    }
+
+    void reset() override
+    {
+        for (auto* stage : stages)
+            stage->reset();
+
+        input.clear();
+        output.clear();
+        block.clear();
+
+        inputSamples = 0;
+        outputSamples = ratio - 1;
+        numSamples = 0;
+    }
+
+    dsp::AudioBlock<float> processSamplesDown(dsp::AudioBlock<float const> const& inputBlock) override
+    {
+        auto const channels = jmin(numChannels, static_cast<int>(inputBlock.getNumChannels()));
+        auto const hostSamples = static_cast<int>(inputBlock.getNumSamples());
+
+        numSamples = (inputSamples + hostSamples) / ratio;
+        auto const used = numSamples * ratio;
+
+        for (int ch = 0; ch < channels; ch++) {
+            auto* fifo = input.getWritePointer(ch);
+            FloatVectorOperations::copy(fifo + inputSamples, inputBlock.getChannelPointer(static_cast<size_t>(ch)), hostSamples);
+            FloatVectorOperations::copy(stages.getLast()->output.getWritePointer(ch), fifo, used);
+
+            for (int i = stages.size() - 1; i >= 0; i--) {
+                auto* destination = i == 0 ? block.getWritePointer(ch) : stages[i - 1]->output.getWritePointer(ch);
+                stages[i]->down(ch, destination, numSamples << i);
+            }
+
+            // What's left over waits for the next block
+            std::memmove(fifo, fifo + used, static_cast<size_t>(inputSamples + hostSamples - used) * sizeof(float));
+        }
+
+        inputSamples += hostSamples - used;
+
+        return dsp::AudioBlock<float>(block).getSubsetChannelBlock(0, static_cast<size_t>(channels)).getSubBlock(0, static_cast<size_t>(numSamples));
+    }
+
+    void processSamplesUp(dsp::AudioBlock<float>& outputBlock) override
+    {
+        auto const channels = jmin(numChannels, static_cast<int>(outputBlock.getNumChannels()));
+        auto const hostSamples = static_cast<int>(outputBlock.getNumSamples());
+        auto const produced = numSamples * ratio;
+
+        for (int ch = 0; ch < channels; ch++) {
+            auto const* samples = block.getReadPointer(ch);
+            auto count = numSamples;
+
+            for (auto* stage : stages) {
+                stage->up(ch, samples, count);
+                samples = stage->output.getReadPointer(ch);
+                count *= 2;
+            }
+
+            auto* fifo = output.getWritePointer(ch);
+            FloatVectorOperations::copy(fifo + outputSamples, samples, produced);
+            FloatVectorOperations::copy(outputBlock.getChannelPointer(static_cast<size_t>(ch)), fifo, hostSamples);
+            std::memmove(fifo, fifo + hostSamples, static_cast<size_t>(outputSamples + produced - hostSamples) * sizeof(float));
+        }
+
+        outputSamples += produced - hostSamples;
+    }
+
+    float getLatencyInSamples() const override
+    {
+        auto latency = static_cast<float>(ratio - 1);
+        float scale = 1.0f;
+
+        // Down and up both delay by the centre of the filter, at the stage's higher rate
+        for (int i = stages.size() - 1; i >= 0; i--) {
+            latency += 2.0f * stages[i]->getCentre() * scale;
+            scale *= 2.0f;
+        }
+
+        return latency;
+    }
+
+private:
+    int const numChannels;
+    int const ratio;
+    OwnedArray<HalfBandStage> stages;
+
+    AudioBuffer<float> input;
+    AudioBuffer<float> output;
+    AudioBuffer<float> block;
+
+    int inputSamples = 0;
+    int outputSamples = 0;
+
+    // At pd's rate, of the block that processSamplesDown returned last
+    int numSamples = 0;
+};
+
+} // namespace
+
+std::unique_ptr<Oversampler> Oversampler::create(Engine engine, int numChannels, int factor)
+{
+    switch (engine) {
+    case FIREquiripple:
+        return std::make_unique<JuceOversampler>(numChannels, factor, dsp::Oversampling<float>::filterHalfBandFIREquiripple);
+    case Polyphase:
+        return std::make_unique<PolyphaseOversampler>(numChannels, factor);
+    default:
+        return std::make_unique<JuceOversampler>(numChannels, factor, dsp::Oversampling<float>::filterHalfBandPolyphaseIIR);
+    }
+}
+
+std::unique_ptr<Undersampler> Undersampler::create(int numChannels, int factor)
+{
+    return std::make_unique<PolyphaseUndersampler>(numChannels, factor);
+}
+
+String Oversampler::getEngineName(Engine engine)
+{
+    switch (engine) {
+    case FIREquiripple:
+        return "Linear phase (FIR)";
+    case Polyphase:
+        return "Polyphase (SIMD)";
+    default:
+        return "Low latency (IIR)";
+    }
+}
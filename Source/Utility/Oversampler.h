@@ -0,0 +1,63 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+#include <JuceHeader.h>
+
+// Up- and downsamples the audio around pd, with a choice of filters
+//! @details IIR is the cheapest and has the lowest latency, but isn't linear phase.
+//! FIREquiripple is linear phase, at the cost of more CPU and latency.
+//! Polyphase is a linear phase half-band filter that only computes the non-zero taps,
+//! one tap at a time over the whole block, so the work is done by the vectorised
+//! FloatVectorOperations.
+class Oversampler {
+public:
+    enum Engine {
+        IIR,
+        FIREquiripple,
+        Polyphase,
+        numEngines
+    };
+
+    virtual ~Oversampler() = default;
+
+    static std::unique_ptr<Oversampler> create(Engine engine, int numChannels, int factor);
+    static String getEngineName(Engine engine);
+
+    virtual void initProcessing(size_t maximumNumberOfSamplesBeforeOversampling) = 0;
+    virtual void reset() = 0;
+
+    // Returns the oversampled block, which can be processed in place
+    virtual dsp::AudioBlock<float> processSamplesUp(dsp::AudioBlock<float const> const& inputBlock) = 0;
+    virtual void processSamplesDown(dsp::AudioBlock<float>& outputBlock) = 0;
+
+    // Latency of up- and downsampling together, in samples at the original rate
+    virtual float getLatencyInSamples() const = 0;
+};
+
+// Runs pd at a fraction of the host's rate, the reverse of Oversampler
+//! @details Uses the same half-band stages as the polyphase oversampler, so the factor is a power of two.
+//! Host blocks that aren't a multiple of the factor are evened out by a FIFO on each side, which adds
+//! up to factor - 1 samples of latency, so any block size works.
+class Undersampler {
+public:
+    virtual ~Undersampler() = default;
+
+    static std::unique_ptr<Undersampler> create(int numChannels, int factor);
+
+    virtual void initProcessing(size_t maximumNumberOfHostSamples) = 0;
+    virtual void reset() = 0;
+
+    // Returns the input at the lower rate, which can be processed in place
+    // It can be empty when the host's block was too short for a single sample
+    virtual dsp::AudioBlock<float> processSamplesDown(dsp::AudioBlock<float const> const& inputBlock) = 0;
+
+    // Brings the block returned by processSamplesDown back to the host's rate
+    virtual void processSamplesUp(dsp::AudioBlock<float>& outputBlock) = 0;
+
+    // Latency of the filters and FIFOs together, in samples at the host's rate
+    virtual float getLatencyInSamples() const = 0;
+};
@@ -0,0 +1,293 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+#include <JuceHeader.h>
+
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+// Developer overlay that times the editor's paint passes and shows what they repainted
+//! @details Only used from the message thread. Components call begin() and end() around their
+//! paint routines, the time in between minus the time of the components nested in it is booked
+//! on the type the component passed. JUCE doesn't tell which rectangles were invalidated, so
+//! every paint pass is flashed over its clip bounds, like JUCE_ENABLE_REPAINT_DEBUGGING does,
+//! and the clip of every profiled component that painted in it is outlined.
+class PaintProfiler : public Component, public Timer {
+public:
+    // Seconds between two updates of the numbers
+    static constexpr double interval = 0.5;
+
+    PaintProfiler()
+    {
+        setInterceptsMouseClicks(false, false);
+        stack.reserve(16);
+        frameSamples.reserve(512);
+        frameAreas.reserve(512);
+    }
+
+    ~PaintProfiler() override
+    {
+        if (active == this)
+            active = nullptr;
+    }
+
+    void setActive(bool shouldBeActive)
+    {
+        if (shouldBeActive) {
+            active = this;
+            clear();
+            setVisible(true);
+            toFront(false);
+            startTimer(roundToInt(interval * 1000.0));
+        } else {
+            if (active == this)
+                active = nullptr;
+
+            stopTimer();
+            setVisible(false);
+        }
+
+        // Everything below has to be painted once without the flashes
+        if (auto* parent = getParentComponent())
+            parent->repaint();
+    }
+
+    bool isActive() const
+    {
+        return active == this;
+    }
+
+    // Called first in the paint routine of the component that owns the overlay
+    static void beginFrame()
+    {
+        if (active && !active->inFrame) {
+            active->inFrame = true;
+            active->frameStart = Time::getHighResolutionTicks();
+        }
+    }
+
+    // Returns false if nothing is measured, end() must only be called if it returned true
+    static bool begin(Component& component, Graphics& g, std::type_info const& type)
+    {
+        if (!active)
+            return false;
+
+        beginFrame();
+
+        active->frameAreas.push_back(active->getLocalArea(&component, g.getClipBounds()));
+        active->stack.push_back({ std::type_index(type), Time::getHighResolutionTicks(), 0 });
+        return true;
+    }
+
+    static bool begin(Component& component, Graphics& g)
+    {
+        return begin(component, g, typeid(component));
+    }
+
+    static void end()
+    {
+        if (!active || active->stack.empty())
+            return;
+
+        auto const entry = active->stack.back();
+        active->stack.pop_back();
+
+        auto const elapsed = Time::getHighResolutionTicks() - entry.start;
+        if (!active->stack.empty())
+            active->stack.back().nested += elapsed;
+
+        active->frameSamples.push_back({ entry.type, elapsed - entry.nested });
+    }
+
+    // Profiles the paint routine of the scope it's in
+    class Scope {
+    public:
+        Scope(Component& component, Graphics& g)
+            : measured(begin(component, g))
+        {
+        }
+
+        ~Scope()
+        {
+            if (measured)
+                end();
+        }
+
+    private:
+        bool const measured;
+
+        JUCE_DECLARE_NON_COPYABLE(Scope)
+    };
+
+    void paint(Graphics& g) override
+    {
+        auto const frameEnd = Time::getHighResolutionTicks();
+        auto const clip = g.getClipBounds();
+
+        // Repainting the numbers repaints whatever is below them, that's not what we're after
+        if (!statsBounds.contains(clip)) {
+            if (inFrame)
+                recordFrame(frameEnd - frameStart);
+
+            auto const colour = Colour::fromHSV(Random::getSystemRandom().nextFloat(), 0.9f, 0.9f, 1.0f);
+            g.setColour(colour.withAlpha(0.12f));
+            g.fillRect(clip);
+
+            g.setColour(colour.withAlpha(0.6f));
+            for (auto const& area : frameAreas)
+                g.drawRect(area);
+        }
+
+        inFrame = false;
+        stack.clear();
+        frameSamples.clear();
+        frameAreas.clear();
+
+        paintStats(g);
+    }
+
+    void resized() override
+    {
+        statsBounds = Rectangle<int>(8, 48, statsWidth, (numStatsLines + 2) * lineHeight);
+    }
+
+    void timerCallback() override
+    {
+        auto const now = Time::getHighResolutionTicks();
+        auto const seconds = Time::highResolutionTicksToSeconds(now - intervalStart);
+        intervalStart = now;
+
+        if (seconds <= 0.0)
+            return;
+
+        lines.clearQuick();
+
+        auto const frameSeconds = Time::highResolutionTicksToSeconds(intervalFrameTicks);
+        lines.add(String(intervalFrames / seconds, 1) + " frames/s, " + String(intervalFrames ? 1000.0 * frameSeconds / intervalFrames : 0.0, 2) + " ms avg, " + String(1000.0 * Time::highResolutionTicksToSeconds(intervalMaxFrameTicks), 2) + " ms max");
+        lines.add(String(100.0 * frameSeconds / seconds, 1) + "% of the message thread painting");
+
+        std::vector<std::pair<std::type_index, TypeStats>> sorted(intervalStats.begin(), intervalStats.end());
+        std::sort(sorted.begin(), sorted.end(), [](auto const& a, auto const& b) { return a.second.ticks > b.second.ticks; });
+
+        int64 bookedTicks = 0;
+        for (auto const& [type, stats] : sorted) {
+            bookedTicks += stats.ticks;
+            if (lines.size() >= numStatsLines - 1 || stats.paints == 0)
+                continue;
+
+            auto const micros = 1e6 * Time::highResolutionTicksToSeconds(stats.ticks);
+            lines.add(getTypeName(type).paddedRight(' ', 22) + String(stats.paints / seconds, 0).paddedLeft(' ', 6) + "/s" + String(micros / stats.paints, 1).paddedLeft(' ', 9) + " us" + String(micros / 1000.0, 2).paddedLeft(' ', 8) + " ms");
+        }
+
+        lines.add(String("Other").paddedRight(' ', 22) + String(1000.0 * Time::highResolutionTicksToSeconds(jmax<int64>(0, intervalFrameTicks - bookedTicks)), 2).paddedLeft(' ', 25) + " ms");
+
+        intervalFrames = 0;
+        intervalFrameTicks = 0;
+        intervalMaxFrameTicks = 0;
+        for (auto& [type, stats] : intervalStats)
+            stats = {};
+
+        repaint(statsBounds);
+    }
+
+private:
+    struct StackEntry {
+        std::type_index type;
+        int64 start;
+        int64 nested;
+    };
+
+    struct Sample {
+        std::type_index type;
+        int64 ticks;
+    };
+
+    struct TypeStats {
+        int paints = 0;
+        int64 ticks = 0;
+    };
+
+    static constexpr int statsWidth = 400;
+    static constexpr int lineHeight = 14;
+    static constexpr int numStatsLines = 14;
+
+    void clear()
+    {
+        inFrame = false;
+        stack.clear();
+        frameSamples.clear();
+        frameAreas.clear();
+        intervalStats.clear();
+        intervalFrames = 0;
+        intervalFrameTicks = 0;
+        intervalMaxFrameTicks = 0;
+        intervalStart = Time::getHighResolutionTicks();
+        lines.clearQuick();
+    }
+
+    void recordFrame(int64 ticks)
+    {
+        intervalFrames++;
+        intervalFrameTicks += ticks;
+        intervalMaxFrameTicks = jmax(intervalMaxFrameTicks, ticks);
+
+        for (auto const& sample : frameSamples) {
+            auto& stats = intervalStats[sample.type];
+            stats.paints++;
+            stats.ticks += sample.ticks;
+        }
+    }
+
+    void paintStats(Graphics& g)
+    {
+        if (!g.clipRegionIntersects(statsBounds))
+            return;
+
+        g.setColour(Colours::black.withAlpha(0.75f));
+        g.fillRoundedRectangle(statsBounds.toFloat(), 4.0f);
+
+        g.setColour(Colours::white);
+        g.setFont(Font(Font::getDefaultMonospacedFontName(), 11.0f, Font::plain));
+
+        auto area = statsBounds.reduced(8, lineHeight / 2);
+        for (auto const& line : lines)
+            g.drawText(line, area.removeFromTop(lineHeight), Justification::centredLeft, false);
+    }
+
+    // Class name without the mangling, "13KeyboardObject" with gcc and clang, "struct KeyboardObject" with msvc
+    String const& getTypeName(std::type_index type)
+    {
+        auto it = typeNames.find(type);
+        if (it != typeNames.end())
+            return it->second;
+
+        auto name = String(type.name()).fromLastOccurrenceOf(" ", false, false);
+        name = name.trimCharactersAtStart("0123456789");
+        return typeNames.emplace(type, name).first->second;
+    }
+
+    inline static PaintProfiler* active = nullptr;
+
+    bool inFrame = false;
+    int64 frameStart = 0;
+    std::vector<StackEntry> stack;
+    std::vector<Sample> frameSamples;
+    std::vector<Rectangle<int>> frameAreas;
+
+    std::unordered_map<std::type_index, TypeStats> intervalStats;
+    std::unordered_map<std::type_index, String> typeNames;
+    int intervalFrames = 0;
+    int64 intervalFrameTicks = 0;
+    int64 intervalMaxFrameTicks = 0;
+    int64 intervalStart = 0;
+
+    Rectangle<int> statsBounds;
+    StringArray lines;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PaintProfiler)
+};
@@ -0,0 +1,58 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "PowerSource.h"
+
+#if JUCE_WINDOWS
+// Declared here, windows.h doesn't go well with JuceHeader
+struct PowerSourceSystemPowerStatus {
+    unsigned char ACLineStatus;
+    unsigned char BatteryFlag;
+    unsigned char BatteryLifePercent;
+    unsigned char SystemStatusFlag;
+    unsigned long BatteryLifeTime;
+    unsigned long BatteryFullLifeTime;
+};
+
+extern "C" __declspec(dllimport) int __stdcall GetSystemPowerStatus(PowerSourceSystemPowerStatus*);
+#elif JUCE_MAC
+#include <IOKit/ps/IOPowerSources.h>
+#include <IOKit/ps/IOPSKeys.h>
+#endif
+
+namespace PowerSource {
+
+bool isOnBattery()
+{
+#if JUCE_WINDOWS
+    PowerSourceSystemPowerStatus status;
+    return GetSystemPowerStatus(&status) && status.ACLineStatus == 0;
+#elif JUCE_MAC
+    auto info = IOPSCopyPowerSourcesInfo();
+    if (!info)
+        return false;
+
+    // Not retained, it goes with the info
+    auto type = IOPSGetProvidingPowerSourceType(info);
+    auto const onBattery = type && CFStringCompare(type, CFSTR(kIOPSBatteryPowerValue), 0) == kCFCompareEqualTo;
+
+    CFRelease(info);
+    return onBattery;
+#elif JUCE_LINUX || JUCE_BSD
+    // A battery that discharges means nothing else powers the computer
+    for (auto const& supply : File("/sys/class/power_supply").findChildFiles(File::findDirectories, false)) {
+        if (supply.getChildFile("type").loadFileAsString().trim() == "Battery"
+            && supply.getChildFile("status").loadFileAsString().trim() == "Discharging")
+            return true;
+    }
+
+    return false;
+#else
+    return false;
+#endif
+}
+
+} // namespace PowerSource
@@ -0,0 +1,16 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+#include <JuceHeader.h>
+
+namespace PowerSource {
+
+// Whether the computer runs on its battery, false when it has none or it can't tell
+//! @details Asks the system every time, don't call it more often than every few seconds
+bool isOnBattery();
+
+} // namespace PowerSource
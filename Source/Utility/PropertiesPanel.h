@@ -37,6 +37,9 @@ struct PropertiesPanel : public PropertyPanel {
         }
 
         void refresh() override {};
+
+        // Shows and edits another value of the same kind, without building the component again
+        virtual void referTo(Value& value) {};
     };
 
     struct ComboComponent : public Property {
@@ -53,6 +56,11 @@ struct PropertiesPanel : public PropertyPanel {
             addAndMakeVisible(comboBox);
         }
 
+        void referTo(Value& value) override
+        {
+            comboBox.getSelectedIdAsValue().referTo(value);
+        }
+
         void resized() override
         {
             comboBox.setBounds(getLocalBounds().removeFromRight(getWidth() / (2 - hideLabel)));
@@ -110,6 +118,12 @@ struct PropertiesPanel : public PropertyPanel {
             addAndMakeVisible(comboBox);
         }
 
+        void referTo(Value& value) override
+        {
+            fontValue.referTo(value);
+            comboBox.setText(value.toString(), dontSendNotification);
+        }
+
         void setFont(String fontName)
         {
             fontValue.setValue(fontValue);
@@ -128,6 +142,7 @@ struct PropertiesPanel : public PropertyPanel {
     struct BoolComponent : public Property {
         BoolComponent(String const& propertyName, Value& value, int idx, std::vector<String> options)
             : Property(propertyName, idx)
+            , options(options)
         {
             toggleButton.setClickingTogglesState(true);
 
@@ -140,7 +155,18 @@ struct PropertiesPanel : public PropertyPanel {
 
             addAndMakeVisible(toggleButton);
 
-            toggleButton.onClick = [this, value, options]() mutable { toggleButton.setButtonText(toggleButton.getToggleState() ? options[1] : options[0]); };
+            toggleButton.onClick = [this]() { updateText(); };
+        }
+
+        void referTo(Value& value) override
+        {
+            toggleButton.getToggleStateValue().referTo(value);
+            updateText();
+        }
+
+        void updateText()
+        {
+            toggleButton.setButtonText(toggleButton.getToggleState() ? options[1] : options[0]);
         }
 
         void resized() override
@@ -150,14 +176,16 @@ struct PropertiesPanel : public PropertyPanel {
 
     private:
         TextButton toggleButton;
+        std::vector<String> options;
     };
 
     struct ColourComponent : public Property
         , public ChangeListener {
         ColourComponent(String const& propertyName, Value& value, int idx)
             : Property(propertyName, idx)
-            , currentColour(value)
         {
+            currentColour.referTo(value);
+
             String strValue = currentColour.toString();
             if (strValue.length() > 2) {
                 button.setButtonText(String("#") + strValue.substring(2).toUpperCase());
@@ -180,6 +208,12 @@ struct PropertiesPanel : public PropertyPanel {
             };
         }
 
+        void referTo(Value& value) override
+        {
+            currentColour.referTo(value);
+            updateColour();
+        }
+
         void updateColour()
         {
             auto colour = Colour::fromString(currentColour.toString());
@@ -215,11 +249,11 @@ struct PropertiesPanel : public PropertyPanel {
 
     private:
         TextButton button;
-        Value& currentColour;
+        Value currentColour;
     };
 
     struct RangeComponent : public Property {
-        Value& property;
+        Value property;
 
         DraggableNumber minLabel, maxLabel;
 
@@ -227,22 +261,18 @@ struct PropertiesPanel : public PropertyPanel {
 
         RangeComponent(String propertyName, Value& value, int idx)
             : Property(propertyName, idx)
-            , property(value)
             , minLabel(false)
             , maxLabel(false)
         {
-            min = value.getValue().getArray()->getReference(0);
-            max = value.getValue().getArray()->getReference(1);
-
             addAndMakeVisible(minLabel);
             minLabel.setEditableOnClick(true);
             minLabel.addMouseListener(this, true);
-            minLabel.setText(String(min), dontSendNotification);
 
             addAndMakeVisible(maxLabel);
             maxLabel.setEditableOnClick(true);
             maxLabel.addMouseListener(this, true);
-            maxLabel.setText(String(max), dontSendNotification);
+
+            referTo(value);
 
             auto setMinimum = [this](float value) {
                 min = value;
@@ -269,6 +299,17 @@ struct PropertiesPanel : public PropertyPanel {
             };
         }
 
+        void referTo(Value& value) override
+        {
+            property.referTo(value);
+
+            min = value.getValue().getArray()->getReference(0);
+            max = value.getValue().getArray()->getReference(1);
+
+            minLabel.setText(String(min), dontSendNotification);
+            maxLabel.setText(String(max), dontSendNotification);
+        }
+
         void resized() override
         {
             auto bounds = getLocalBounds().removeFromRight(getWidth() / (2 - hideLabel));
@@ -280,12 +321,13 @@ struct PropertiesPanel : public PropertyPanel {
     template<typename T>
     struct EditableComponent : public Property {
         std::unique_ptr<Label> label;
-        Value& property;
+        Value property;
 
         EditableComponent(String propertyName, Value& value, int idx)
             : Property(propertyName, idx)
-            , property(value)
         {
+            property.referTo(value);
+
             if constexpr (std::is_arithmetic<T>::value) {
                 label = std::make_unique<DraggableNumber>(std::is_integral<T>::value);
 
@@ -314,6 +356,12 @@ struct PropertiesPanel : public PropertyPanel {
             };
         }
 
+        void referTo(Value& value) override
+        {
+            property.referTo(value);
+            label->getTextValue().referTo(property);
+        }
+
         void resized() override
         {
             label->setBounds(getLocalBounds().removeFromRight(getWidth() / (2 - hideLabel)));
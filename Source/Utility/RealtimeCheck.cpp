@@ -0,0 +1,419 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "RealtimeCheck.h"
+
+#if PLUGDATA_REALTIME_CHECK
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if JUCE_WINDOWS
+extern "C" __declspec(dllimport) unsigned short __stdcall RtlCaptureStackBackTrace(unsigned long, unsigned long, void**, unsigned long*);
+#else
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// glibc declares the allocation and mutex functions noexcept, the definitions have to match.
+// The flags are read by the allocation hooks, initial-exec TLS is used so that reading them
+// can't allocate.
+#if defined(__GLIBC__)
+#define REALTIME_CHECK_GLIBC 1
+#define REALTIME_CHECK_NOEXCEPT noexcept
+#define REALTIME_CHECK_TLS __attribute__((tls_model("initial-exec")))
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+#else
+#define REALTIME_CHECK_GLIBC 0
+#define REALTIME_CHECK_NOEXCEPT
+#define REALTIME_CHECK_TLS
+#endif
+
+// Hidden, so calls from the plugin bind to these hooks and the host keeps the real functions.
+// Not possible for the allocation functions, which the compiler declares itself
+#if JUCE_WINDOWS
+#define REALTIME_CHECK_HIDDEN
+#else
+#define REALTIME_CHECK_HIDDEN __attribute__((visibility("hidden")))
+#endif
+
+namespace {
+
+// Depth of the audio callbacks the thread is in, and whether it's reporting, so what a report
+// does itself isn't reported
+thread_local int callbackDepth REALTIME_CHECK_TLS = 0;
+thread_local bool reporting REALTIME_CHECK_TLS = false;
+
+struct Violation {
+    static constexpr int maxFrames = 32;
+
+    // 0 while free, 1 while a thread fills it in, 2 when it can be read
+    std::atomic<int> state = 0;
+
+    char const* what = nullptr;
+    uint64 hash = 0;
+    int numFrames = 0;
+    void* frames[maxFrames] = {};
+
+    std::atomic<int64> count = 0;
+    int64 reportedCount = 0; // Only touched by flush
+};
+
+// Places beyond this many aren't recorded, only counted
+constexpr int numViolations = 128;
+Violation violations[numViolations];
+std::atomic<int64> numDropped = 0;
+
+// report() and the hook that called it
+constexpr int skippedFrames = 2;
+
+int captureFrames(void** frames, int maxFrames)
+{
+#if JUCE_WINDOWS
+    return RtlCaptureStackBackTrace(0, static_cast<unsigned long>(maxFrames), frames, nullptr);
+#else
+    return backtrace(frames, maxFrames);
+#endif
+}
+
+bool shouldCheck()
+{
+    return callbackDepth > 0 && !reporting;
+}
+
+void report(char const* what)
+{
+    reporting = true;
+
+    void* frames[Violation::maxFrames];
+    auto const numFrames = captureFrames(frames, Violation::maxFrames);
+
+    // The same kind of violation from the same place is only recorded once
+    auto hash = static_cast<uint64>(reinterpret_cast<pointer_sized_uint>(what));
+    for (int i = skippedFrames; i < numFrames; i++)
+        hash = (hash ^ static_cast<uint64>(reinterpret_cast<pointer_sized_uint>(frames[i]))) * 1099511628211ull;
+
+    for (int i = 0; i < numViolations; i++) {
+        auto& violation = violations[(hash + static_cast<uint64>(i)) % numViolations];
+        auto state = violation.state.load(std::memory_order_acquire);
+
+        if (state == 0 && violation.state.compare_exchange_strong(state, 1, std::memory_order_acquire)) {
+            violation.what = what;
+            violation.hash = hash;
+            violation.numFrames = numFrames;
+            std::copy(frames, frames + numFrames, violation.frames);
+            violation.count.store(1, std::memory_order_relaxed);
+            violation.state.store(2, std::memory_order_release);
+
+            reporting = false;
+            return;
+        }
+
+        if (state == 2 && violation.hash == hash) {
+            violation.count.fetch_add(1, std::memory_order_relaxed);
+
+            reporting = false;
+            return;
+        }
+    }
+
+    numDropped.fetch_add(1, std::memory_order_relaxed);
+    reporting = false;
+}
+
+String getStackTrace(Violation const& violation)
+{
+    String trace;
+
+#if JUCE_WINDOWS
+    // Look the addresses up with the pdb
+    for (int i = skippedFrames; i < violation.numFrames; i++)
+        trace << "  0x" << String::toHexString(static_cast<int64>(reinterpret_cast<pointer_sized_int>(violation.frames[i]))) << "\n";
+#else
+    if (auto** symbols = backtrace_symbols(violation.frames, violation.numFrames)) {
+        for (int i = skippedFrames; i < violation.numFrames; i++)
+            trace << "  " << symbols[i] << "\n";
+
+        std::free(symbols);
+    }
+#endif
+
+    return trace.trimEnd();
+}
+
+void* allocate(std::size_t size)
+{
+#if REALTIME_CHECK_GLIBC
+    return __libc_malloc(size);
+#else
+    return std::malloc(size);
+#endif
+}
+
+void deallocate(void* ptr)
+{
+#if REALTIME_CHECK_GLIBC
+    __libc_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+#if !JUCE_WINDOWS
+// The next definition of a hooked function, the one we'd have called without the hook
+template <typename Function>
+Function resolve(char const* name)
+{
+    return reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+}
+#endif
+
+} // namespace
+
+namespace RealtimeCheck {
+
+ScopedAudioCallback::ScopedAudioCallback(bool nonRealtime)
+    : checked(!nonRealtime)
+{
+    if (checked)
+        callbackDepth++;
+}
+
+ScopedAudioCallback::~ScopedAudioCallback()
+{
+    if (checked)
+        callbackDepth--;
+}
+
+void flush(std::function<void(String const&)> const& log)
+{
+    // Places that keep going wrong are reported again now and then, not on every call
+    static double lastRepeatReport = 0.0;
+    auto const now = Time::getMillisecondCounterHiRes();
+    auto const reportRepeats = now - lastRepeatReport > 5000.0;
+
+    for (auto& violation : violations) {
+        if (violation.state.load(std::memory_order_acquire) != 2)
+            continue;
+
+        auto const count = violation.count.load(std::memory_order_relaxed);
+        if (count == violation.reportedCount)
+            continue;
+
+        if (violation.reportedCount == 0) {
+            log("Not real-time safe, " + String(violation.what) + " on the audio thread:\n" + getStackTrace(violation));
+        } else if (reportRepeats) {
+            log(String(violation.what) + " on the audio thread happened " + String(count - violation.reportedCount) + " more times at the place reported before");
+        } else {
+            continue;
+        }
+
+        violation.reportedCount = count;
+    }
+
+    static int64 reportedDropped = 0;
+    if (auto const dropped = numDropped.load(std::memory_order_relaxed); dropped != reportedDropped && reportRepeats) {
+        log(String(dropped - reportedDropped) + " real-time violations weren't recorded, there were too many different places");
+        reportedDropped = dropped;
+    }
+
+    if (reportRepeats)
+        lastRepeatReport = now;
+}
+
+} // namespace RealtimeCheck
+
+void* operator new(std::size_t size)
+{
+    if (shouldCheck())
+        report("operator new");
+
+    if (auto* ptr = allocate(size ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    if (shouldCheck())
+        report("operator new[]");
+
+    if (auto* ptr = allocate(size ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (ptr && shouldCheck())
+        report("operator delete");
+
+    deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    if (ptr && shouldCheck())
+        report("operator delete[]");
+
+    deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    if (ptr && shouldCheck())
+        report("operator delete");
+
+    deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    if (ptr && shouldCheck())
+        report("operator delete[]");
+
+    deallocate(ptr);
+}
+
+extern "C" {
+
+#if REALTIME_CHECK_GLIBC
+void* malloc(size_t size) REALTIME_CHECK_NOEXCEPT
+{
+    if (shouldCheck())
+        report("malloc");
+
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) REALTIME_CHECK_NOEXCEPT
+{
+    if (shouldCheck())
+        report("calloc");
+
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) REALTIME_CHECK_NOEXCEPT
+{
+    if (shouldCheck())
+        report("realloc");
+
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) REALTIME_CHECK_NOEXCEPT
+{
+    if (ptr && shouldCheck())
+        report("free");
+
+    __libc_free(ptr);
+}
+#endif
+
+#if !JUCE_WINDOWS
+// Taking a free mutex is fine, having to wait for one isn't
+REALTIME_CHECK_HIDDEN int pthread_mutex_lock(pthread_mutex_t* mutex) REALTIME_CHECK_NOEXCEPT
+{
+    static auto const next = resolve<int (*)(pthread_mutex_t*)>("pthread_mutex_lock");
+    static auto const tryLock = resolve<int (*)(pthread_mutex_t*)>("pthread_mutex_trylock");
+
+    if (shouldCheck()) {
+        if (tryLock(mutex) == 0)
+            return 0;
+
+        report("waiting for a lock");
+    }
+
+    return next(mutex);
+}
+
+REALTIME_CHECK_HIDDEN int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex)
+{
+    static auto const next = resolve<int (*)(pthread_cond_t*, pthread_mutex_t*)>("pthread_cond_wait");
+
+    if (shouldCheck())
+        report("waiting for a condition");
+
+    return next(condition, mutex);
+}
+
+REALTIME_CHECK_HIDDEN ssize_t read(int fd, void* buffer, size_t size)
+{
+    static auto const next = resolve<ssize_t (*)(int, void*, size_t)>("read");
+
+    if (shouldCheck())
+        report("read");
+
+    return next(fd, buffer, size);
+}
+
+REALTIME_CHECK_HIDDEN ssize_t write(int fd, void const* buffer, size_t size)
+{
+    static auto const next = resolve<ssize_t (*)(int, void const*, size_t)>("write");
+
+    if (shouldCheck())
+        report("write");
+
+    return next(fd, buffer, size);
+}
+
+REALTIME_CHECK_HIDDEN FILE* fopen(char const* path, char const* mode)
+{
+    static auto const next = resolve<FILE* (*)(char const*, char const*)>("fopen");
+
+    if (shouldCheck())
+        report("fopen");
+
+    return next(path, mode);
+}
+
+REALTIME_CHECK_HIDDEN int fclose(FILE* file)
+{
+    static auto const next = resolve<int (*)(FILE*)>("fclose");
+
+    if (shouldCheck())
+        report("fclose");
+
+    return next(file);
+}
+
+REALTIME_CHECK_HIDDEN int usleep(useconds_t microseconds)
+{
+    static auto const next = resolve<int (*)(useconds_t)>("usleep");
+
+    if (shouldCheck())
+        report("usleep");
+
+    return next(microseconds);
+}
+
+REALTIME_CHECK_HIDDEN int nanosleep(timespec const* duration, timespec* remaining)
+{
+    static auto const next = resolve<int (*)(timespec const*, timespec*)>("nanosleep");
+
+    if (shouldCheck())
+        report("nanosleep");
+
+    return next(duration, remaining);
+}
+#endif
+
+} // extern "C"
+
+#endif
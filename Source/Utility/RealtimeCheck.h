@@ -0,0 +1,55 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+#include <JuceHeader.h>
+
+// Debug mode that reports everything on the audio thread that isn't real-time safe
+//! @details Enabled with the PLUGDATA_REALTIME_CHECK build option. Inside a ScopedAudioCallback,
+//! allocations, waiting for a lock that someone else holds, and blocking system calls are
+//! recorded with the stack they came from. Which hooks exist depends on the platform:
+//! - everywhere: operator new and delete
+//! - glibc: malloc, calloc, realloc and free
+//! - Linux and macOS: pthread_mutex_lock when the mutex is taken, pthread_cond_wait, read,
+//!   write, fopen, fclose, usleep and nanosleep
+//! The lock, I/O and sleep hooks are hidden symbols, so they see calls from our own code,
+//! including libpd and the externals, and nothing else. The allocation hooks can't be hidden,
+//! the compiler declares them itself with default visibility. They are exported, so
+//! they also replace the allocator of the host when it resolves to us first, and may miss our
+//! own calls in a plugin that is loaded after the host's allocator. They only report on the
+//! audio thread inside a ScopedAudioCallback either way.
+//! Every place is only reported once, later occurrences are counted.
+namespace RealtimeCheck {
+
+#if PLUGDATA_REALTIME_CHECK
+
+class ScopedAudioCallback {
+public:
+    // Offline rendering may block, so nothing is checked then
+    explicit ScopedAudioCallback(bool nonRealtime = false);
+    ~ScopedAudioCallback();
+
+private:
+    bool const checked;
+
+    JUCE_DECLARE_NON_COPYABLE(ScopedAudioCallback)
+};
+
+// Called on the message thread, logs the new violations with their stack trace
+void flush(std::function<void(String const&)> const& log);
+
+#else
+
+class ScopedAudioCallback {
+public:
+    explicit ScopedAudioCallback(bool = false) { }
+};
+
+inline void flush(std::function<void(String const&)> const&) { }
+
+#endif
+
+} // namespace RealtimeCheck
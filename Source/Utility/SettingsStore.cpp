@@ -0,0 +1,131 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "SettingsStore.h"
+
+JUCE_IMPLEMENT_SINGLETON(SettingsStore)
+
+SettingsStore::SettingsStore()
+    : Thread("Settings Writer")
+{
+    startThread();
+}
+
+SettingsStore::~SettingsStore()
+{
+    stopThread(-1);
+    writePending();
+    clearSingletonInstance();
+}
+
+void SettingsStore::save(File const& file, ValueTree const& settings, Listener* source)
+{
+    // The tree can only be read from this thread, so serialise it here
+    {
+        ScopedLock lock(pendingLock);
+        pending = Write { file, settings.toXmlString() };
+    }
+
+    notify();
+
+    listeners.call([source, &settings](Listener& l) {
+        if (&l != source)
+            l.settingsChanged(settings);
+    });
+}
+
+void SettingsStore::flush()
+{
+    writePending();
+}
+
+bool SettingsStore::wasChangedOutside(File const& file) const
+{
+    {
+        ScopedLock lock(pendingLock);
+        if (pending && pending->file == file)
+            return false;
+    }
+
+    ScopedLock lock(writeLock);
+    return file != lastFile || file.getLastModificationTime() != lastModified || file.getSize() != lastSize;
+}
+
+void SettingsStore::addListener(Listener* listener)
+{
+    listeners.add(listener);
+}
+
+void SettingsStore::removeListener(Listener* listener)
+{
+    listeners.remove(listener);
+}
+
+void SettingsStore::applyChanges(ValueTree target, ValueTree const& source)
+{
+    for (int i = target.getNumProperties(); --i >= 0;) {
+        auto const name = target.getPropertyName(i);
+        if (!source.hasProperty(name))
+            target.removeProperty(name, nullptr);
+    }
+
+    // Setting a property to the value it has doesn't notify anyone
+    for (int i = 0; i < source.getNumProperties(); i++) {
+        auto const name = source.getPropertyName(i);
+        target.setProperty(name, source.getProperty(name), nullptr);
+    }
+
+    for (int i = 0; i < source.getNumChildren(); i++) {
+        auto const child = source.getChild(i);
+
+        if (i >= target.getNumChildren()) {
+            target.appendChild(child.createCopy(), nullptr);
+        } else if (target.getChild(i).hasType(child.getType())) {
+            applyChanges(target.getChild(i), child);
+        } else {
+            target.removeChild(i, nullptr);
+            target.addChild(child.createCopy(), i, nullptr);
+        }
+    }
+
+    while (target.getNumChildren() > source.getNumChildren())
+        target.removeChild(target.getNumChildren() - 1, nullptr);
+}
+
+void SettingsStore::run()
+{
+    while (!threadShouldExit()) {
+        wait(-1);
+
+        // Every save restarts the wait
+        while (!threadShouldExit() && wait(debounceMs)) { }
+
+        writePending();
+    }
+}
+
+void SettingsStore::writePending()
+{
+    ScopedLock writing(writeLock);
+
+    std::optional<Write> write;
+    {
+        ScopedLock lock(pendingLock);
+        std::swap(write, pending);
+    }
+
+    if (!write)
+        return;
+
+    // The temporary file is moved over the old one, so nobody reads a half-written file
+    TemporaryFile temporary(write->file);
+    if (!temporary.getFile().replaceWithText(write->xml) || !temporary.overwriteTargetFileWithTemporary())
+        return;
+
+    lastFile = write->file;
+    lastModified = write->file.getLastModificationTime();
+    lastSize = write->file.getSize();
+}
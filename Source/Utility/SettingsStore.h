@@ -0,0 +1,73 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+#include <JuceHeader.h>
+
+#include <optional>
+
+// Writes the settings of every instance in the process, and tells the other instances what changed
+//! @details Saves are collected on a background thread and written once no new save came in for a
+//! while, so a burst of changes ends up as one write. The file is written next to the old one and
+//! then moved over it, so it's never seen half-written. Instances in the same process get the new
+//! settings straight away through their Listener, instead of reading the file back when it changes.
+//! save() and the listeners are only used from the message thread, flush() from any thread.
+class SettingsStore : public DeletedAtShutdown
+    , private Thread {
+public:
+    class Listener {
+    public:
+        virtual ~Listener() = default;
+
+        // Another instance saved its settings, only apply what differs
+        virtual void settingsChanged(ValueTree const& newSettings) = 0;
+    };
+
+    SettingsStore();
+    ~SettingsStore() override;
+
+    // Queues settings to be written to file, and sends them to every listener except source
+    void save(File const& file, ValueTree const& settings, Listener* source);
+
+    // Writes what's queued right away
+    void flush();
+
+    // Whether the contents of file are other than what was last written here
+    // A file with a write still queued counts as ours, since what's queued is newer
+    bool wasChangedOutside(File const& file) const;
+
+    void addListener(Listener* listener);
+    void removeListener(Listener* listener);
+
+    // Makes target the same as source, only changing what differs
+    // Children are kept where their type matches, so listeners and links to them stay intact
+    static void applyChanges(ValueTree target, ValueTree const& source);
+
+    JUCE_DECLARE_SINGLETON(SettingsStore, false)
+
+private:
+    struct Write {
+        File file;
+        String xml;
+    };
+
+    void run() override;
+    void writePending();
+
+    // How long it has to be quiet before the settings are written
+    static constexpr int debounceMs = 500;
+
+    ListenerList<Listener> listeners;
+
+    CriticalSection pendingLock;
+    std::optional<Write> pending;
+
+    // Held while writing, so flush() and the thread don't write at once
+    CriticalSection writeLock;
+    File lastFile;
+    Time lastModified;
+    int64 lastSize = -1;
+};
@@ -0,0 +1,143 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+#include <JuceHeader.h>
+
+#include <unordered_map>
+#include <vector>
+
+// Uniform grid of buckets, to find the items in an area without looking at all of them
+//! @details Every item is stored in all cells its bounds overlap. Moving an item only touches
+//! the cells of its old and new bounds, so the index can be kept up to date while dragging.
+template<typename T>
+class SpatialIndex
+{
+public:
+    explicit SpatialIndex(int size = 128)
+        : cellSize(size)
+    {
+    }
+
+    void clear()
+    {
+        cells.clear();
+        items.clear();
+    }
+
+    // Adds the item, or moves it if it's already in the index
+    void insert(T* item, Rectangle<int> bounds)
+    {
+        auto it = items.find(item);
+        if (it != items.end())
+        {
+            if (it->second == bounds)
+                return;
+
+            removeFromCells(item, it->second);
+            it->second = bounds;
+        }
+        else
+        {
+            items.emplace(item, bounds);
+        }
+
+        forEachCell(bounds, [&](int64 key) {
+            cells[key].push_back({ item, bounds });
+        });
+    }
+
+    void remove(T* item)
+    {
+        auto it = items.find(item);
+        if (it == items.end())
+            return;
+
+        removeFromCells(item, it->second);
+        items.erase(it);
+    }
+
+    // Every item whose bounds intersect area, each item is only added once
+    void query(Rectangle<int> area, Array<T*>& found, Array<Rectangle<int>>* bounds = nullptr) const
+    {
+        forEachCell(area, [&](int64 key) {
+            auto it = cells.find(key);
+            if (it == cells.end())
+                return;
+
+            for (auto const& [item, itemBounds] : it->second)
+            {
+                if (!itemBounds.intersects(area))
+                    continue;
+
+                // An item can be in several of the cells we look at, only report
+                // it from the cell that has the top left corner of the overlap
+                auto const overlap = itemBounds.getIntersection(area);
+                if (cellKey(floorDiv(overlap.getX()), floorDiv(overlap.getY())) != key)
+                    continue;
+
+                found.add(item);
+                if (bounds)
+                    bounds->add(itemBounds);
+            }
+        });
+    }
+
+private:
+    void removeFromCells(T* item, Rectangle<int> bounds)
+    {
+        forEachCell(bounds, [&](int64 key) {
+            auto it = cells.find(key);
+            if (it == cells.end())
+                return;
+
+            auto& cell = it->second;
+            for (size_t i = 0; i < cell.size(); i++)
+            {
+                if (cell[i].first == item)
+                {
+                    cell[i] = cell.back();
+                    cell.pop_back();
+                    break;
+                }
+            }
+
+            if (cell.empty())
+                cells.erase(it);
+        });
+    }
+
+    template<typename Callback>
+    void forEachCell(Rectangle<int> area, Callback&& callback) const
+    {
+        auto const x1 = floorDiv(area.getX());
+        auto const y1 = floorDiv(area.getY());
+        auto const x2 = floorDiv(area.getRight());
+        auto const y2 = floorDiv(area.getBottom());
+
+        for (int x = x1; x <= x2; x++)
+        {
+            for (int y = y1; y <= y2; y++)
+            {
+                callback(cellKey(x, y));
+            }
+        }
+    }
+
+    static int64 cellKey(int x, int y)
+    {
+        return (static_cast<int64>(x) << 32) | static_cast<uint32>(y);
+    }
+
+    int floorDiv(int value) const
+    {
+        return value >= 0 ? value / cellSize : -((-value + cellSize - 1) / cellSize);
+    }
+
+    int const cellSize;
+    std::unordered_map<int64, std::vector<std::pair<T*, Rectangle<int>>>> cells;
+    std::unordered_map<T*, Rectangle<int>> items;
+};
@@ -1,8 +1,12 @@
 
 // Suggestions component that shows up when objects are edited
+//! @details The rows are a fixed set of buttons that are reused for every query. Suggestions that
+//! complete the typed text are found right away, the fuzzy matches are added asynchronously, so
+//! typing is never held up by them. Extending the query only searches what the last one matched.
 class SuggestionComponent : public Component
     , public KeyListener
-    , public TextEditor::InputFilter {
+    , public TextEditor::InputFilter
+    , private AsyncUpdater {
 
     class Suggestion : public TextButton {
         int idx = 0;
@@ -26,6 +30,9 @@ class SuggestionComponent : public Component
 
         void setText(String const& name, String const& description, bool icon)
         {
+            if (name == getButtonText() && description == objectDescription && icon == drawIcon)
+                return;
+
             objectDescription = description;
             setButtonText(name);
             type = name.contains("~") ? 1 : 0;
@@ -145,6 +152,7 @@ public:
     {
         currentBox = object;
         openedEditor = editor;
+        narrowing = {};
 
         setTransform(object->cnv->main.getTransform());
 
@@ -191,6 +199,9 @@ public:
 
         openedEditor = nullptr;
         currentBox = nullptr;
+
+        cancelPendingUpdate();
+        narrowing = {};
     }
 
     void move(int offset, int setto = -1)
@@ -310,12 +321,14 @@ private:
         constrainer.setSizeLimits(150, 100, 500, 400);
         resized();
 
-        auto& library = currentBox->cnv->pd->objectLibrary;
+        auto& library = *currentBox->cnv->pd->objectLibrary;
+        auto documentation = library.getSnapshot();
 
         // If there's a space, open arguments panel
         if ((e.getText() + mutableInput).contains(" ")) {
             state = ShowingArguments;
-            auto found = library.getArguments()[typedText.upToFirstOccurrenceOf(" ", false, false)];
+            auto argumentsIt = documentation->arguments.find(typedText.upToFirstOccurrenceOf(" ", false, false));
+            auto found = argumentsIt != documentation->arguments.end() ? argumentsIt->second : pd::Arguments();
             for (int i = 0; i < std::min<int>(buttons.size(), static_cast<int>(found.size())); i++) {
                 auto& [type, description, init] = found[i];
                 buttons[i]->setText(type, description, false);
@@ -340,32 +353,19 @@ private:
 
         buttons[currentidx]->setToggleState(true, dontSendNotification);
 
-        // Update suggestions
-        auto found = library.autocomplete(typedText.toStdString());
-
-        numOptions = static_cast<int>(found.size());
-
-        for (int i = 0; i < std::min<int>(buttons.size(), numOptions); i++) {
-            auto& [name, autocomplete] = found[i];
-
-            auto descriptions = library.getObjectDescriptions();
-
-            if (descriptions.find(name) != descriptions.end()) {
-                buttons[i]->setText(name, descriptions[name], true);
-            } else {
-                buttons[i]->setText(name, "", true);
-            }
-            buttons[i]->setInterceptsMouseClicks(true, false);
-        }
-
-        for (int i = numOptions; i < buttons.size(); i++)
-            buttons[i]->setText("", "", false);
-
-        resized();
+        // Update suggestions, the fuzzy matches follow once typing pauses
+        auto found = library.autocomplete(typedText, false);
+        showSuggestions(found, *documentation);
 
         // Get length of user-typed text
         int textlen = e.getText().substring(0, start).length();
 
+        pendingQuery = typedText;
+        if (textlen > 0 && static_cast<int>(found.size()) < pd::Library::maxSuggestions)
+            triggerAsyncUpdate();
+        else
+            cancelPendingUpdate();
+
         if (found.empty() || textlen == 0) {
             state = Hidden;
             setVisible(false);
@@ -384,9 +384,17 @@ private:
         currentidx = (currentidx + numButtons) % numButtons;
 
         // Retrieve best suggestion
-        auto const& fullName = found[currentidx].first;
+        auto const& [fullName, canComplete] = found[currentidx];
 
         state = ShowingObjects;
+
+        // Keyword and fuzzy matches are only shown, they can't complete the typed text
+        if (!canComplete || !fullName.startsWith(typedText)) {
+            setVisible(true);
+            highlightEnd = 0;
+            return mutableInput;
+        }
+
         if (fullName.length() > textlen) {
             mutableInput = fullName.substring(textlen);
         }
@@ -397,6 +405,47 @@ private:
         return mutableInput;
     }
 
+    void showSuggestions(pd::Suggestions const& found, pd::LibrarySnapshot const& documentation)
+    {
+        numOptions = static_cast<int>(found.size());
+
+        for (int i = 0; i < std::min<int>(buttons.size(), numOptions); i++) {
+            auto& [name, autocomplete] = found[i];
+
+            auto description = documentation.objectDescriptions.find(name);
+            if (description != documentation.objectDescriptions.end()) {
+                buttons[i]->setText(name, description->second, true);
+            } else {
+                buttons[i]->setText(name, "", true);
+            }
+            buttons[i]->setInterceptsMouseClicks(true, false);
+        }
+
+        for (int i = numOptions; i < buttons.size(); i++)
+            buttons[i]->setText("", "", false);
+
+        resized();
+    }
+
+    void handleAsyncUpdate() override
+    {
+        if (!currentBox || !openedEditor || state == ShowingArguments)
+            return;
+
+        auto& library = *currentBox->cnv->pd->objectLibrary;
+        auto found = library.autocomplete(pendingQuery, true, &narrowing);
+
+        if (found.empty())
+            return;
+
+        showSuggestions(found, *library.getSnapshot());
+
+        if (state == Hidden) {
+            state = ShowingObjects;
+            setVisible(true);
+        }
+    }
+
     enum SugesstionState {
         Hidden,
         ShowingObjects,
@@ -406,6 +455,9 @@ private:
     int numOptions = 0;
     int currentidx = 0;
 
+    String pendingQuery;
+    pd::ObjectIndex::Narrowing narrowing;
+
     std::unique_ptr<Viewport> port;
     std::unique_ptr<Component> buttonholder;
     OwnedArray<Suggestion> buttons;
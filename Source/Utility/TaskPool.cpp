@@ -0,0 +1,120 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "TaskPool.h"
+
+struct TaskPool::Worker : public Thread {
+    Worker(TaskPool& parent, int workerIndex)
+        : Thread("Background Worker")
+        , pool(parent)
+        , index(workerIndex)
+    {
+    }
+
+    void run() override
+    {
+        Task task;
+
+        while (!threadShouldExit()) {
+            if (pool.takeTask(index, task)) {
+                if (!task.token.isCancelled())
+                    task.function();
+
+                task = {};
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(pool.sleepLock);
+            pool.wakeUp.wait(lock, [this]() { return pool.shouldExit || pool.numQueued.load() > 0; });
+        }
+    }
+
+    TaskPool& pool;
+    int const index;
+
+    // Guards the queues, other workers take from them too
+    std::mutex lock;
+    std::deque<Task> queues[numPriorities];
+};
+
+TaskPool::TaskPool()
+{
+    // Leaves the rest of the machine to the audio thread and pd's worker pool
+    auto const numWorkers = jlimit(1, 4, SystemStats::getNumCpus() / 2);
+
+    for (int i = 0; i < numWorkers; i++)
+        workers.add(new Worker(*this, i))->startThread(3);
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepLock);
+        shouldExit = true;
+    }
+
+    for (auto* worker : workers)
+        worker->signalThreadShouldExit();
+
+    wakeUp.notify_all();
+
+    for (auto* worker : workers)
+        worker->stopThread(-1);
+}
+
+TaskPool::CancellationToken TaskPool::add(std::function<void()> task, Priority priority, CancellationToken token)
+{
+    auto* worker = workers[static_cast<int>(static_cast<uint32>(nextWorker++) % static_cast<uint32>(workers.size()))];
+
+    {
+        std::lock_guard<std::mutex> lock(worker->lock);
+        worker->queues[priority].push_back({ std::move(task), token });
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleepLock);
+        numQueued++;
+    }
+
+    wakeUp.notify_one();
+    return token;
+}
+
+bool TaskPool::takeTask(int workerIndex, Task& task)
+{
+    if (numQueued.load() == 0)
+        return false;
+
+    for (int priority = 0; priority < numPriorities; priority++) {
+        // Own queue from the front, the others from the back
+        for (int i = 0; i < workers.size(); i++) {
+            auto* worker = workers[(workerIndex + i) % workers.size()];
+            auto& queue = worker->queues[priority];
+
+            std::lock_guard<std::mutex> lock(worker->lock);
+            if (queue.empty())
+                continue;
+
+            if (i == 0) {
+                task = std::move(queue.front());
+                queue.pop_front();
+            } else {
+                task = std::move(queue.back());
+                queue.pop_back();
+            }
+
+            numQueued--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int TaskPool::getNumWorkers() const
+{
+    return workers.size();
+}
@@ -0,0 +1,99 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// Background threads shared by everything in the process that works in the background
+//! @details Use it through a SharedResourcePointer. There are only a few workers however many instances are
+//! open, and they run below normal priority, so background work doesn't compete with the audio thread.
+//! Every worker has a queue for each priority. New tasks go to the queues of the workers in turn, a worker
+//! without work takes tasks from the others, the highest priority first. Tasks that were cancelled before they
+//! started are skipped, a running task can check its token to stop early. Tasks that didn't start by the time
+//! the pool is deleted are dropped, the ones that are running are waited for.
+class TaskPool {
+public:
+    enum Priority {
+        High,
+        Normal,
+        Low,
+        numPriorities
+    };
+
+    // Shared by a task and whoever started it, copies refer to the same task
+    class CancellationToken {
+    public:
+        void cancel() { cancelled->store(true); }
+        bool isCancelled() const { return cancelled->load(); }
+
+    private:
+        std::shared_ptr<std::atomic<bool>> cancelled = std::make_shared<std::atomic<bool>>(false);
+    };
+
+    TaskPool();
+    ~TaskPool();
+
+    // Runs task on one of the workers, returns token so it can be cancelled
+    CancellationToken add(std::function<void()> task, Priority priority = Normal, CancellationToken token = {});
+
+    // Calls fn(index) for every index in [0, count), on the workers and the calling thread
+    // Returns once all are done, so the calling thread helps even when the workers are busy
+    template<typename Callable>
+    void parallelFor(int count, Callable&& fn, Priority priority = Normal)
+    {
+        struct Batch {
+            std::atomic<int> next = 0;
+            std::atomic<int> done = 0;
+        };
+
+        auto batch = std::make_shared<Batch>();
+        auto runTasks = [batch, count, &fn]() {
+            for (auto i = batch->next++; i < count; i = batch->next++) {
+                fn(i);
+                batch->done++;
+            }
+        };
+
+        // Helpers that start after everything was claimed return straight away, they never touch fn
+        for (int i = 1; i < jmin(count, getNumWorkers() + 1); i++)
+            add(runTasks, priority);
+
+        runTasks();
+
+        while (batch->done.load() < count)
+            Thread::yield();
+    }
+
+    int getNumWorkers() const;
+
+private:
+    struct Task {
+        std::function<void()> function;
+        CancellationToken token;
+    };
+
+    struct Worker;
+
+    // Takes a task from the worker's own queues, or else from the other workers
+    bool takeTask(int workerIndex, Task& task);
+
+    OwnedArray<Worker> workers;
+    std::atomic<int> nextWorker = 0;
+
+    std::mutex sleepLock;
+    std::condition_variable wakeUp;
+    std::atomic<int> numQueued = 0;
+    bool shouldExit = false;
+
+    JUCE_DECLARE_NON_COPYABLE(TaskPool)
+};
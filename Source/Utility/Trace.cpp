@@ -0,0 +1,183 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#include "Trace.h"
+
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+struct Event {
+    char const* name;
+    int64 start;
+    int64 end;
+};
+
+struct ThreadBuffer {
+    static constexpr uint64 capacity = 1 << 15;
+
+    ThreadBuffer()
+    {
+        events.allocate(capacity, true);
+    }
+
+    HeapBlock<Event> events;
+    std::atomic<uint64> count = 0;
+
+    char name[64] = {};
+};
+
+struct Registry {
+    // Threads beyond this many aren't traced
+    static constexpr int numBuffers = 64;
+
+    std::atomic<ThreadBuffer*> buffers[numBuffers] = {};
+    std::atomic<int> numClaimed = 0;
+    std::atomic<bool> allocated = false;
+
+    CriticalSection allocationLock;
+};
+
+Registry& getRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+thread_local ThreadBuffer* threadBuffer = nullptr;
+thread_local bool threadUntraced = false;
+
+ThreadBuffer* claimBuffer()
+{
+    if (threadBuffer || threadUntraced)
+        return threadBuffer;
+
+    auto& registry = getRegistry();
+    auto const index = registry.numClaimed.fetch_add(1);
+    if (index >= Registry::numBuffers) {
+        threadUntraced = true;
+        return nullptr;
+    }
+
+    threadBuffer = registry.buffers[index].load(std::memory_order_acquire);
+
+    if (MessageManager::existsAndIsCurrentThread()) {
+        std::strcpy(threadBuffer->name, "Message thread");
+    } else if (auto* thread = Thread::getCurrentThread()) {
+        thread->getThreadName().copyToUTF8(threadBuffer->name, sizeof(threadBuffer->name));
+    } else {
+        std::snprintf(threadBuffer->name, sizeof(threadBuffer->name), "Thread %d", index + 1);
+    }
+
+    return threadBuffer;
+}
+
+String toMicroseconds(int64 ticks)
+{
+    return String(Time::highResolutionTicksToSeconds(ticks) * 1e6, 3);
+}
+
+} // namespace
+
+namespace Trace {
+
+void setEnabled(bool shouldBeEnabled)
+{
+    auto& registry = getRegistry();
+
+    if (shouldBeEnabled && !registry.allocated) {
+        const ScopedLock lock(registry.allocationLock);
+        if (!registry.allocated) {
+            for (auto& buffer : registry.buffers)
+                buffer.store(new ThreadBuffer, std::memory_order_release);
+
+            registry.allocated = true;
+        }
+    }
+
+    enabled = shouldBeEnabled;
+}
+
+void setThreadName(char const* name)
+{
+    if (!isEnabled())
+        return;
+
+    if (auto* buffer = claimBuffer(); buffer && std::strcmp(buffer->name, name) != 0)
+        std::strncpy(buffer->name, name, sizeof(buffer->name) - 1);
+}
+
+void record(char const* name, int64 start, int64 end)
+{
+    auto* buffer = claimBuffer();
+    if (!buffer)
+        return;
+
+    auto const index = buffer->count.load(std::memory_order_relaxed);
+    buffer->events[index & (ThreadBuffer::capacity - 1)] = { name, start, end };
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+void clear()
+{
+    auto& registry = getRegistry();
+    auto const numClaimed = jmin(registry.numClaimed.load(), Registry::numBuffers);
+
+    // Only moves the start of the ring, a zone that is being written can still show up
+    for (int i = 0; i < numClaimed; i++) {
+        auto* buffer = registry.buffers[i].load(std::memory_order_acquire);
+        buffer->count = 0;
+    }
+}
+
+bool writeChromeTrace(File const& file)
+{
+    auto& registry = getRegistry();
+    auto const numClaimed = jmin(registry.numClaimed.load(), Registry::numBuffers);
+
+    // Copy the rings first, so the threads can't overwrite what we're writing
+    std::vector<std::vector<Event>> threads(static_cast<size_t>(numClaimed));
+    int64 origin = std::numeric_limits<int64>::max();
+
+    for (int i = 0; i < numClaimed; i++) {
+        auto* buffer = registry.buffers[i].load(std::memory_order_acquire);
+        auto const count = buffer->count.load(std::memory_order_acquire);
+        auto const first = count > ThreadBuffer::capacity ? count - ThreadBuffer::capacity : 0;
+
+        auto& events = threads[static_cast<size_t>(i)];
+        events.reserve(static_cast<size_t>(count - first));
+        for (auto n = first; n < count; n++)
+            events.push_back(buffer->events[n & (ThreadBuffer::capacity - 1)]);
+
+        for (auto const& event : events)
+            origin = jmin(origin, event.start);
+    }
+
+    MemoryOutputStream json;
+    json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    bool first = true;
+    auto separator = [&first]() { return std::exchange(first, false) ? "\n" : ",\n"; };
+
+    for (int i = 0; i < numClaimed; i++) {
+        auto* buffer = registry.buffers[i].load(std::memory_order_acquire);
+        json << separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << (i + 1)
+             << ",\"args\":{\"name\":" << JSON::toString(String::fromUTF8(buffer->name)) << "}}";
+
+        for (auto const& event : threads[static_cast<size_t>(i)]) {
+            json << separator() << "{\"name\":" << JSON::toString(event.name) << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << (i + 1)
+                 << ",\"ts\":" << toMicroseconds(event.start - origin) << ",\"dur\":" << toMicroseconds(event.end - event.start) << "}";
+        }
+    }
+
+    json << "\n]}\n";
+
+    return file.replaceWithData(json.getData(), json.getDataSize());
+}
+
+} // namespace Trace
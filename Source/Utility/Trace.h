@@ -0,0 +1,59 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+#include <JuceHeader.h>
+
+// Records scoped zones of every thread, so GUI hitches can be lined up with audio dropouts
+//! @details Each thread writes into a ring of its own, claimed from a pool that is allocated
+//! when tracing is first enabled, so a zone never locks or allocates. When the ring is full the
+//! oldest zones are overwritten. Zone names must be string literals, they are stored as pointers.
+//! The trace is written as Chrome's JSON trace format, which Perfetto opens as well.
+namespace Trace {
+
+inline std::atomic<bool> enabled = false;
+
+void setEnabled(bool shouldBeEnabled);
+
+inline bool isEnabled()
+{
+    return enabled.load(std::memory_order_acquire);
+}
+
+// Name of the calling thread in the trace, instead of the name JUCE knows it by
+void setThreadName(char const* name);
+
+void record(char const* name, int64 start, int64 end);
+
+// Clears all recorded zones
+void clear();
+
+bool writeChromeTrace(File const& file);
+
+class Zone {
+public:
+    explicit Zone(char const* zoneName)
+        : name(zoneName)
+        , start(isEnabled() ? Time::getHighResolutionTicks() : 0)
+    {
+    }
+
+    ~Zone()
+    {
+        if (start)
+            record(name, start, Time::getHighResolutionTicks());
+    }
+
+private:
+    char const* name;
+    int64 const start;
+
+    JUCE_DECLARE_NON_COPYABLE(Zone)
+};
+
+} // namespace Trace
+
+#define TRACE_ZONE(name) Trace::Zone JUCE_JOIN_MACRO(traceZone, __LINE__)(name)
@@ -0,0 +1,55 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+
+// Hands the newest value from one writer thread to one reader thread, without locking
+//! @details The writer fills its own buffer and swaps it with the middle one when done. The
+//! reader swaps its buffer with the middle one when a new value was published. Neither side
+//! ever waits for the other, and the reader always gets a complete value.
+template<typename T>
+class TripleBuffer {
+public:
+    // Writer side, fill this and then call publish()
+    T& getWriteBuffer()
+    {
+        return buffers[back];
+    }
+
+    void publish()
+    {
+        back = middle.exchange(back | freshBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // True while the last published value hasn't been read yet
+    bool hasUnreadValue() const
+    {
+        return middle.load(std::memory_order_relaxed) & freshBit;
+    }
+
+    // Reader side, returns the newest value, or nullptr if nothing was published since the last call
+    T const* read()
+    {
+        if (!hasUnreadValue())
+            return nullptr;
+
+        front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+        return &buffers[front];
+    }
+
+private:
+    static constexpr int freshBit = 4;
+    static constexpr int indexMask = 3;
+
+    std::array<T, 3> buffers;
+
+    int back = 0;
+    int front = 1;
+    std::atomic<int> middle = 2;
+};
@@ -0,0 +1,45 @@
+/*
+ // Copyright (c) 2022 Timothy Schoen
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+ */
+
+#pragma once
+
+#include "TripleBuffer.h"
+
+// Hands what an object shows from the audio thread to its component, without the audio lock
+//! @details The audio thread fills a frame from the pd object after a block, in
+//! GUIObject::updateFromAudioThread() of an object that was added with addAudioThreadObject(). The
+//! component reads the newest frame when it draws. Only objects with a component are added, so
+//! nothing is copied while no editor is open. Frames can be made every block, or only once the last
+//! one was read, for frames that are too big to copy that often.
+template<typename Frame>
+class VisualTap {
+public:
+    explicit VisualTap(bool waitForReader = false)
+        : onlyWhenRead(waitForReader)
+    {
+    }
+
+    // Audio thread, calls fill with the frame to write, unless no new frame is wanted yet
+    template<typename Fill>
+    void publish(Fill&& fill)
+    {
+        if (onlyWhenRead && frames.hasUnreadValue())
+            return;
+
+        fill(frames.getWriteBuffer());
+        frames.publish();
+    }
+
+    // The newest frame, or nullptr if there's no new one since the last call
+    Frame const* read()
+    {
+        return frames.read();
+    }
+
+private:
+    bool const onlyWhenRead;
+    TripleBuffer<Frame> frames;
+};
@@ -24,6 +24,7 @@
 #include <juce_audio_devices/juce_audio_devices.h>
 #include <juce_audio_plugin_client/juce_audio_plugin_client.h>
 #include <juce_dsp/juce_dsp.h>
+#include <juce_opengl/juce_opengl.h>
 
 #include "BinaryData.h"
 
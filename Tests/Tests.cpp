@@ -5,6 +5,14 @@
 #define Rectangle juce::Rectangle
 
 #include <PluginProcessor.h>
+#include <Canvas.h>
+#include <Connection.h>
+
+extern "C" {
+#include <m_pd.h>
+#include <g_canvas.h>
+#include "x_libpd_mod_utils.h"
+}
 
 
 #include <juce_core/system/juce_TargetPlatform.h>
@@ -77,3 +85,549 @@ TEST_CASE("Create and delete objects", "[name]")
     
     StopApplicationAfter(1500);
 }
+
+namespace {
+
+// Keeps the floats of the last message it got, connected to an outlet to see what an object sends
+struct Catcher {
+    t_object obj;
+    std::vector<t_float>* received;
+};
+
+t_object* newCatcher(std::vector<t_float>* received)
+{
+    static t_class* catcherClass = nullptr;
+    if (!catcherClass) {
+        catcherClass = class_new(gensym("plugdata_test_catcher"), nullptr, nullptr, sizeof(Catcher), CLASS_DEFAULT, A_NULL);
+        class_addfloat(catcherClass, reinterpret_cast<t_method>(+[](Catcher* x, t_float f) {
+            *x->received = { f };
+        }));
+        class_addlist(catcherClass, reinterpret_cast<t_method>(+[](Catcher* x, t_symbol*, int argc, t_atom* argv) {
+            x->received->clear();
+            for (int i = 0; i < argc; i++)
+                x->received->push_back(atom_getfloat(argv + i));
+        }));
+    }
+
+    auto* catcher = reinterpret_cast<Catcher*>(pd_new(catcherClass));
+    catcher->received = received;
+    return &catcher->obj;
+}
+
+std::vector<t_atom> toAtoms(std::vector<t_float> const& values)
+{
+    std::vector<t_atom> atoms(values.size());
+    for (size_t i = 0; i < values.size(); i++)
+        SETFLOAT(&atoms[i], values[i]);
+
+    return atoms;
+}
+
+// Sends values to a zl object, returns what its left and right outlets sent back
+std::pair<std::vector<t_float>, std::vector<t_float>> sendToZl(PlugDataPluginEditor* editor, String const& name, std::vector<t_atom> atoms)
+{
+    auto& patch = editor->getCurrentCanvas()->patch;
+    auto* zl = static_cast<t_object*>(patch.createObject(name, 20, 20));
+
+    std::vector<t_float> left, right;
+    {
+        const pd::CallbackLock::ScopedLockType lock(*editor->pd.getCallbackLock());
+        editor->pd.setThis();
+
+        auto* leftCatcher = newCatcher(&left);
+        auto* rightCatcher = newCatcher(&right);
+        obj_connect(zl, 0, leftCatcher, 0);
+        if (obj_noutlets(zl) > 1)
+            obj_connect(zl, 1, rightCatcher, 0);
+
+        pd_list(&zl->ob_pd, &s_list, static_cast<int>(atoms.size()), atoms.data());
+
+        obj_disconnect(zl, 0, leftCatcher, 0);
+        if (obj_noutlets(zl) > 1)
+            obj_disconnect(zl, 1, rightCatcher, 0);
+
+        pd_free(&leftCatcher->ob_pd);
+        pd_free(&rightCatcher->ob_pd);
+    }
+
+    patch.removeObject(zl);
+    return { left, right };
+}
+
+// The right outlet has the input index of every sorted value
+void checkSorted(std::vector<t_float> const& input, std::vector<t_float> const& sorted, std::vector<t_float> const& indices, bool descending)
+{
+    auto expected = input;
+    std::sort(expected.begin(), expected.end());
+    if (descending)
+        std::reverse(expected.begin(), expected.end());
+
+    REQUIRE(sorted == expected);
+    REQUIRE(indices.size() == input.size());
+
+    std::vector<bool> seen(input.size(), false);
+    for (size_t i = 0; i < indices.size(); i++) {
+        auto const index = static_cast<size_t>(indices[i]);
+        REQUIRE(index < input.size());
+        REQUIRE(!seen[index]);
+        seen[index] = true;
+        REQUIRE(input[index] == sorted[i]);
+    }
+}
+
+} // namespace
+
+TEST_CASE("zl sort and median", "[cyclone]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=]() {
+        std::vector<std::vector<t_float>> inputs = {
+            { 3, 1, 2, 1, 3, 0.5f },
+            { 42 },
+            std::vector<t_float>(4000, 7), // all equal, this went quadratic before
+        };
+
+        // Few distinct values, many of each, and an organ pipe, which is bad for simple pivots
+        std::vector<t_float> fewValues, organPipe;
+        for (int i = 0; i < 4000; i++) {
+            fewValues.push_back(static_cast<t_float>((i * 7919) % 3));
+            organPipe.push_back(static_cast<t_float>(i < 2000 ? i : 4000 - i));
+        }
+        inputs.push_back(fewValues);
+        inputs.push_back(organPipe);
+
+        for (auto const& input : inputs) {
+            auto [sorted, indices] = sendToZl(editor, "zl 4096 sort", toAtoms(input));
+            checkSorted(input, sorted, indices, false);
+
+            auto [reversed, reversedIndices] = sendToZl(editor, "zl 4096 sort -1", toAtoms(input));
+            checkSorted(input, reversed, reversedIndices, true);
+        }
+
+        REQUIRE(sendToZl(editor, "zl median", toAtoms({ 5, 1, 3 })).first == std::vector<t_float> { 3 });
+        REQUIRE(sendToZl(editor, "zl median", toAtoms({ 4, 1, 3, 2 })).first == std::vector<t_float> { 2.5f });
+        REQUIRE(sendToZl(editor, "zl 4096 median", toAtoms(std::vector<t_float>(4001, 7))).first == std::vector<t_float> { 7 });
+        REQUIRE(sendToZl(editor, "zl 4096 median", toAtoms(fewValues)).first == std::vector<t_float> { 1 });
+
+        // Symbols are left out of the median
+        std::vector<t_atom> mixed(5);
+        SETSYMBOL(&mixed[0], gensym("b"));
+        SETFLOAT(&mixed[1], 3);
+        SETSYMBOL(&mixed[2], gensym("a"));
+        SETFLOAT(&mixed[3], 1);
+        SETFLOAT(&mixed[4], 2);
+        REQUIRE(sendToZl(editor, "zl median", mixed).first == std::vector<t_float> { 2 });
+    });
+
+    StopApplicationAfter(1500);
+}
+
+namespace {
+
+// Plays samples into the signal inlet it's connected to, so an object gets exactly the input a test wants
+struct SignalPlayer {
+    t_object obj;
+    std::vector<t_float> const* samples;
+    size_t position;
+};
+
+// Keeps every sample that comes into its signal inlet
+struct SignalRecorder {
+    t_object obj;
+    t_float f;
+    std::vector<t_float>* recorded;
+};
+
+t_class* signalPlayerClass = nullptr;
+t_class* signalRecorderClass = nullptr;
+
+t_int* signalPlayerPerform(t_int* w)
+{
+    auto* x = reinterpret_cast<SignalPlayer*>(w[1]);
+    auto* out = reinterpret_cast<t_sample*>(w[2]);
+    auto const n = static_cast<int>(w[3]);
+    for (int i = 0; i < n; i++)
+        out[i] = x->samples && x->position < x->samples->size() ? (*x->samples)[x->position++] : 0;
+
+    return w + 4;
+}
+
+t_int* signalRecorderPerform(t_int* w)
+{
+    auto* x = reinterpret_cast<SignalRecorder*>(w[1]);
+    auto* in = reinterpret_cast<t_sample*>(w[2]);
+    auto const n = static_cast<int>(w[3]);
+    x->recorded->insert(x->recorded->end(), in, in + n);
+
+    return w + 4;
+}
+
+void setupSignalTestClasses()
+{
+    if (signalPlayerClass)
+        return;
+
+    signalPlayerClass = class_new(gensym("plugdata_test_player~"), reinterpret_cast<t_newmethod>(+[]() -> void* {
+        auto* x = reinterpret_cast<SignalPlayer*>(pd_new(signalPlayerClass));
+        x->samples = nullptr;
+        x->position = 0;
+        outlet_new(&x->obj, &s_signal);
+        return x;
+    }),
+        nullptr, sizeof(SignalPlayer), CLASS_NOINLET, A_NULL);
+    class_addmethod(signalPlayerClass, reinterpret_cast<t_method>(+[](SignalPlayer* x, t_signal** sp) {
+        dsp_add(signalPlayerPerform, 3, x, sp[0]->s_vec, static_cast<t_int>(sp[0]->s_n));
+    }),
+        gensym("dsp"), A_CANT, A_NULL);
+
+    signalRecorderClass = class_new(gensym("plugdata_test_recorder~"), reinterpret_cast<t_newmethod>(+[]() -> void* {
+        auto* x = reinterpret_cast<SignalRecorder*>(pd_new(signalRecorderClass));
+        x->f = 0;
+        x->recorded = nullptr;
+        return x;
+    }),
+        nullptr, sizeof(SignalRecorder), CLASS_DEFAULT, A_NULL);
+    CLASS_MAINSIGNALIN(signalRecorderClass, SignalRecorder, f);
+    class_addmethod(signalRecorderClass, reinterpret_cast<t_method>(+[](SignalRecorder* x, t_signal** sp) {
+        dsp_add(signalRecorderPerform, 3, x, sp[0]->s_vec, static_cast<t_int>(sp[0]->s_n));
+    }),
+        gensym("dsp"), A_CANT, A_NULL);
+}
+
+// Runs an object in a subpatch that's switched off, so the audio callback leaves it alone, one block of 64
+// samples per bang to its [switch~]. Before each block, messages can be sent to the object
+// Returns everything its left outlet sent
+std::vector<t_float> runSignalObject(PlugDataPluginEditor* editor, String const& name, std::vector<t_float> const& input, int numBlocks, std::function<void(t_pd*, int)> const& beforeBlock)
+{
+    auto& patch = editor->getCurrentCanvas()->patch;
+    auto* canvas = static_cast<t_canvas*>(patch.createObject("pd signaltest", 20, 20));
+
+    std::vector<t_float> recorded;
+    {
+        const pd::CallbackLock::ScopedLockType lock(*editor->pd.getCallbackLock());
+        editor->pd.setThis();
+        setupSignalTestClasses();
+
+        auto newObject = [canvas](String const& text) {
+            auto const line = "0 0 " + text;
+            auto* buf = binbuf_new();
+            binbuf_text(buf, line.toRawUTF8(), line.getNumBytesAsUTF8());
+            pd_typedmess(&canvas->gl_pd, gensym("obj"), binbuf_getnatom(buf), binbuf_getvec(buf));
+            binbuf_free(buf);
+            return reinterpret_cast<t_object*>(pd_newest());
+        };
+
+        auto* blockSwitch = newObject("switch~ 64");
+        auto* player = reinterpret_cast<SignalPlayer*>(newObject("plugdata_test_player~"));
+        auto* object = newObject(name);
+        auto* recorder = reinterpret_cast<SignalRecorder*>(newObject("plugdata_test_recorder~"));
+        REQUIRE(object);
+
+        player->samples = &input;
+        recorder->recorded = &recorded;
+        if (obj_issignalinlet(object, 0))
+            obj_connect(&player->obj, 0, object, 0);
+        obj_connect(object, 0, &recorder->obj, 0);
+
+        // Builds the DSP chain again, with the subpatch in it
+        auto const dspState = canvas_suspend_dsp();
+        canvas_resume_dsp(1);
+
+        for (int block = 0; block < numBlocks; block++) {
+            beforeBlock(&object->ob_pd, block);
+            pd_bang(&blockSwitch->ob_pd);
+        }
+
+        canvas_suspend_dsp();
+        canvas_resume_dsp(dspState);
+    }
+
+    patch.removeObject(canvas);
+    return recorded;
+}
+
+void sendMessage(t_pd* object, char const* selector, std::vector<t_float> const& values)
+{
+    auto atoms = toAtoms(values);
+    pd_typedmess(object, gensym(selector), static_cast<int>(atoms.size()), atoms.data());
+}
+
+} // namespace
+
+TEST_CASE("function~ at breakpoint ties", "[else]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=]() {
+        // Breakpoints at 0, 0.25, 0.25, 0.5 and 1, the function jumps from 1 to 0.5 at 0.25
+        // An input on a breakpoint stays in the segment the input before it was in, the expected output
+        // is what function~ gave when it still walked the breakpoints one at a time
+        std::vector<t_float> input = {
+            0, 0.1f, 0.25f, 0.25f, 0.3f, 0.25f, 0.2f, 0.25f, 0.5f, 0.5f, 0.25f, 0.75f, 1, 1.5f, 1,
+            0.5f, 0.25f, 0, -0.5f, 0.25f, 0.6f, 0.25f, 0.125f, 0.375f, 0.25f, 1, 0.25f, 0.5f, 0.4f, 0.5f,
+            0.9f, 0.5f, 0.25f, 0.24f, 0.26f, 0.25f, 0.75f, 0.5f, 0, 0.5f, 1, 0.25f, 0, 1
+        };
+        std::vector<t_float> linear = {
+            0, 0.4f, 1, 1, 0.45f, 0.5f, 0.8f, 1, 0.25f, 0.25f, 0.5f, 0.5f, 0.75f, 0.75f, 0.75f,
+            0.25f, 0.5f, 0, 0, 1, 0.35f, 0.5f, 0.5f, 0.375f, 0.5f, 0.75f, 0.5f, 0.25f, 0.35f, 0.25f,
+            0.65f, 0.25f, 0.5f, 0.96f, 0.49f, 0.5f, 0.5f, 0.25f, 0, 0.25f, 0.75f, 0.5f, 0, 0.75f
+        };
+        // The same after "expl 1 1 3 -2"
+        std::vector<t_float> curved = {
+            0, 0.4f, 1, 1, 0.378f, 0.5f, 0.8f, 1, 0.25f, 0.25f, 0.5f, 0.625f, 0.75f, 0.75f, 0.75f,
+            0.25f, 0.5f, 0, 0, 1, 0.43f, 0.5f, 0.5f, 0.28125f, 0.5f, 0.75f, 0.5f, 0.25f, 0.266f, 0.25f,
+            0.73f, 0.25f, 0.5f, 0.96f, 0.471184015f, 0.5f, 0.625f, 0.25f, 0, 0.25f, 0.75f, 0.5f, 0, 0.75f
+        };
+
+        // Both blocks get the same input, the rest of each is the last value
+        std::vector<t_float> played;
+        for (int block = 0; block < 2; block++) {
+            played.insert(played.end(), input.begin(), input.end());
+            played.resize((block + 1) * 64, input.back());
+        }
+
+        auto output = runSignalObject(editor, "function~ 0 1 1 0 0.5 1 0.25 2 0.75", played, 2, [](t_pd* function, int block) {
+            if (block == 1)
+                sendMessage(function, "expl", { 1, 1, 3, -2 });
+        });
+
+        REQUIRE(output.size() == 128);
+        for (size_t i = 0; i < input.size(); i++) {
+            INFO("input " << input[i] << " at sample " << i);
+            CHECK(output[i] == Catch::Approx(linear[i]).margin(1e-6));
+            CHECK(output[64 + i] == Catch::Approx(curved[i]).margin(1e-6));
+        }
+    });
+
+    StopApplicationAfter(1500);
+}
+
+TEST_CASE("curve~, line~ and envgen~ ramps", "[cyclone][else]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=]() {
+        // Durations that come to a whole number of samples, so the ramps end on the same sample at any sample rate
+        auto ms = [](int numSamples) {
+            float const ksr = sys_getsr() * 0.001;
+            return static_cast<float>(numSamples / ksr);
+        };
+
+        // Samples of what the objects gave when they still worked out their ramps one sample at a time
+        auto checkSamples = [](std::vector<t_float> const& output, std::vector<std::pair<int, float>> const& expected) {
+            for (auto const& [index, value] : expected) {
+                INFO("sample " << index);
+                REQUIRE(index < static_cast<int>(output.size()));
+                CHECK(output[index] == Catch::Approx(value).margin(1e-6));
+            }
+        };
+
+        // Up to 1 in 150 samples, then down to -0.5 in 100, across block boundaries
+        auto line = runSignalObject(editor, "cyclone/line~ 0", {}, 5, [ms](t_pd* object, int block) {
+            if (block == 0)
+                sendMessage(object, "list", { 1, ms(150), -0.5f, ms(100) });
+        });
+        checkSamples(line, {
+            { 0, 0 }, { 16, 0.106666677f }, { 32, 0.213333264f }, { 48, 0.319999844f }, { 63, 0.419999748f },
+            { 64, 0.426666677f }, { 65, 0.433333337f }, { 80, 0.533333242f }, { 96, 0.639999807f },
+            { 112, 0.746666372f }, { 127, 0.846666276f }, { 128, 0.853333354f }, { 129, 0.860000014f },
+            { 144, 0.959999919f }, { 149, 0.99333322f }, { 150, 1 }, { 151, 0.985000014f }, { 160, 0.850000143f },
+            { 176, 0.610000372f }, { 191, 0.385000587f }, { 192, 0.370000005f }, { 193, 0.355000019f },
+            { 208, 0.130000114f }, { 224, -0.109999888f }, { 240, -0.349999785f }, { 249, -0.484999657f },
+            { 250, -0.5f }, { 251, -0.5f }, { 256, -0.5f }, { 272, -0.5f }, { 288, -0.5f }, { 304, -0.5f } });
+
+        // The same segments, curved both ways
+        auto curve = runSignalObject(editor, "curve~", {}, 5, [ms](t_pd* object, int block) {
+            if (block == 0)
+                sendMessage(object, "list", { 1, ms(150), 0.5f, -0.5f, ms(100), -0.5f });
+        });
+        checkSamples(curve, {
+            { 0, 0 }, { 16, 0.0222807843f }, { 32, 0.052372627f }, { 48, 0.0930138752f }, { 63, 0.143968105f },
+            { 64, 0.147902876f }, { 65, 0.151912242f }, { 80, 0.222034514f }, { 96, 0.32215476f }, { 112, 0.457374513f },
+            { 127, 0.62690717f }, { 128, 0.639998734f }, { 129, 0.653338552f }, { 144, 0.886646211f },
+            { 149, 0.980209589f }, { 150, 1 }, { 151, 0.955679357f }, { 160, 0.608290017f }, { 176, 0.171521723f },
+            { 191, -0.0927916244f }, { 192, -0.10675294f }, { 193, -0.120326385f }, { 208, -0.284047842f },
+            { 224, -0.397006333f }, { 240, -0.46897465f }, { 249, -0.497275829f }, { 250, -0.5f }, { 251, -0.5f },
+            { 256, -0.5f }, { 272, -0.5f }, { 288, -0.5f }, { 304, -0.5f } });
+
+        // A gate from sample 10 to 200 runs the attack and decay, holds the sustain point and then releases
+        std::vector<t_float> gate(6 * 64, 0);
+        std::fill(gate.begin() + 10, gate.begin() + 200, 1);
+        auto envelope = runSignalObject(editor, "envgen~", gate, 6, [ms](t_pd* object, int block) {
+            if (block == 0) {
+                sendMessage(object, "set", { 0, ms(100), 1, ms(50), 0.4f, ms(60), 0.2f, ms(40), 0 });
+                sendMessage(object, "suspoint", { 2 });
+            }
+        });
+        checkSamples(envelope, {
+            { 0, 0 }, { 9, 0 }, { 10, 0 }, { 11, 0.00999999978f }, { 16, 0.0599999987f }, { 32, 0.219999999f },
+            { 48, 0.379999995f }, { 64, 0.540000021f }, { 80, 0.699999988f }, { 96, 0.860000014f }, { 109, 0.99000001f },
+            { 110, 1 }, { 111, 1 }, { 112, 1 }, { 128, 1 }, { 144, 1 }, { 160, 1 }, { 176, 1 }, { 192, 1 }, { 199, 1 },
+            { 200, 0.986666679f }, { 201, 0.973333359f }, { 208, 0.879999995f }, { 224, 0.666666627f },
+            { 240, 0.453333318f }, { 256, 0.24000001f }, { 258, 0.213333309f }, { 259, 0.199999988f },
+            { 260, 0.194999993f }, { 272, 0.13499999f }, { 288, 0.0549999923f }, { 298, 0.00499999523f }, { 299, 0 },
+            { 300, 0 }, { 304, 0 }, { 320, 0 }, { 336, 0 }, { 352, 0 }, { 368, 0 } });
+    });
+
+    StopApplicationAfter(1500);
+}
+
+// Timings of editor operations on generated patches of several sizes
+// These are hidden, so they don't slow down the normal test run. To get the timings as XML or JSON, run:
+// Tests "[benchmark]" --reporter xml::out=benchmarks.xml
+// Every benchmark is reported with its samples, mean and standard deviation.
+
+namespace {
+
+struct GeneratedPatch {
+    std::vector<pd::Patch::ObjectDescription> objects;
+    std::vector<pd::Patch::ConnectionDescription> connections;
+
+    // The patch as pd's copy buffer has it, for pasting
+    String getText() const
+    {
+        String text;
+        for (auto const& object : objects)
+            text << "#X obj " << object.x << " " << object.y << " " << object.name << ";\n";
+        for (auto const& connection : connections)
+            text << "#X connect " << connection.src << " " << connection.nout << " " << connection.sink << " " << connection.nin << ";\n";
+
+        return text;
+    }
+};
+
+constexpr int rowsPerColumn = 25;
+
+// Columns of math objects, each one is connected to the one below it and to its neighbour in
+// the next column, so plenty of connections cross other objects
+GeneratedPatch generatePatch(int numObjects)
+{
+    GeneratedPatch patch;
+    for (int i = 0; i < numObjects; i++) {
+        auto const column = i / rowsPerColumn;
+        auto const row = i % rowsPerColumn;
+        patch.objects.push_back({ i % 2 ? "* 2" : "+ 1", 20 + column * 80, 20 + row * 40 });
+
+        if (row + 1 < rowsPerColumn && i + 1 < numObjects)
+            patch.connections.push_back({ i, 0, i + 1, 0 });
+        if (i + rowsPerColumn < numObjects)
+            patch.connections.push_back({ i, 0, i + rowsPerColumn, 1 });
+    }
+
+    return patch;
+}
+
+Canvas* createFixture(PlugDataPluginEditor* editor, GeneratedPatch const& fixture)
+{
+    auto* cnv = editor->getCurrentCanvas();
+    for (auto* object : cnv->patch.getObjects())
+        cnv->patch.removeObject(object);
+
+    cnv->patch.createObjects(fixture.objects, fixture.connections);
+    cnv->synchronise();
+    return cnv;
+}
+
+void selectObjects(Canvas* cnv, int numObjects)
+{
+    cnv->deselectAll();
+    for (int i = 0; i < jmin(numObjects, cnv->objects.size()); i++)
+        cnv->setSelected(cnv->objects[i], true);
+}
+
+} // namespace
+
+TEST_CASE("Editor benchmarks", "[.][benchmark]")
+{
+    StartApplication;
+
+    MessageManager::callAsync([=]() {
+        for (auto const numObjects : { 100, 1000, 4000 }) {
+            auto const size = std::to_string(numObjects) + " objects";
+            auto const fixture = generatePatch(numObjects);
+            auto* cnv = createFixture(editor, fixture);
+
+            REQUIRE(cnv->objects.size() == numObjects);
+
+            BENCHMARK("synchronise, " + size)
+            {
+                cnv->synchronise();
+            };
+
+            BENCHMARK("findPath for every connection, " + size)
+            {
+                for (auto* connection : cnv->connections) {
+                    connection->invalidateRoute();
+                    connection->findPath();
+                }
+            };
+
+            SystemClipboard::copyTextToClipboard(generatePatch(1000).getText());
+            BENCHMARK_ADVANCED("paste 1000 objects, " + size)(Catch::Benchmark::Chronometer meter)
+            {
+                meter.measure([cnv]() { cnv->pasteSelection(); });
+                for (int i = 0; i < meter.runs(); i++)
+                    cnv->undo();
+            };
+
+            BENCHMARK_ADVANCED("duplicate 1000 objects, " + size)(Catch::Benchmark::Chronometer meter)
+            {
+                selectObjects(cnv, 1000);
+                meter.measure([cnv]() { cnv->duplicateSelection(); });
+                cnv->deselectAll();
+                for (int i = 0; i < meter.runs(); i++)
+                    cnv->undo();
+            };
+
+            // Takes long enough for every sample to be a single run, the selection is gone after one
+            BENCHMARK_ADVANCED("encapsulate half, " + size)(Catch::Benchmark::Chronometer meter)
+            {
+                selectObjects(cnv, numObjects / 2);
+                meter.measure([cnv]() { cnv->encapsulateSelection(); });
+                for (int i = 0; i < meter.runs(); i++)
+                    cnv->undo();
+            };
+
+            // One undo step made of a move for every object
+            std::vector<void*> toMove;
+            for (auto* object : cnv->objects)
+                toMove.push_back(object->getPointer());
+
+            cnv->patch.performUndoSequence("move", [glist = cnv->patch.getPointer(), toMove]() {
+                for (auto* object : toMove) {
+                    glist_noselect(glist);
+                    glist_select(glist, &static_cast<t_object*>(object)->te_g);
+                    libpd_moveselection(glist, 10, 0);
+                }
+                glist_noselect(glist);
+            });
+            cnv->synchronise();
+
+            BENCHMARK("undo and redo " + std::to_string(numObjects) + " moves")
+            {
+                cnv->undo();
+                cnv->redo();
+            };
+        }
+
+        auto& library = *editor->pd.objectLibrary;
+
+        // The library is loaded on its own thread
+        for (int i = 0; i < 100 && library.autocomplete("metro").empty(); i++)
+            Thread::sleep(100);
+
+        REQUIRE(!library.autocomplete("metro").empty());
+
+        BENCHMARK("autocomplete")
+        {
+            size_t numSuggestions = 0;
+            for (auto const* query : { "m", "me", "metro", "osc~", "lop", "pack", "t b f", "xyzzy" })
+                numSuggestions += library.autocomplete(query).size();
+
+            return numSuggestions;
+        };
+    });
+
+    StopApplicationAfter(500);
+}